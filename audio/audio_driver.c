@@ -477,6 +477,62 @@ bool audio_driver_find_driver(const char *audio_drv,
    return true;
 }
 
+/**
+ * audio_driver_latency_add_drc:
+ *
+ * Records one rate control reading in the rolling fill and
+ * rate_adjust histograms.  @direction is where rate_adjust sits
+ * between 1 - delta (-1.0) and 1 + delta (1.0).
+ **/
+static void audio_driver_latency_add_drc(audio_latency_state_t *lat,
+      unsigned avail, size_t buffer_size, double direction)
+{
+   int fill_idx = buffer_size
+      ? (int)((1.0 - (double)avail / buffer_size)
+            * AUDIO_LATENCY_FILL_BUCKETS)
+      : 0;
+   int rate_idx = (int)((direction + 1.0) * 0.5
+         * AUDIO_LATENCY_RATE_BUCKETS);
+
+   fill_idx = MAX(0, MIN(fill_idx, AUDIO_LATENCY_FILL_BUCKETS - 1));
+   rate_idx = MAX(0, MIN(rate_idx, AUDIO_LATENCY_RATE_BUCKETS - 1));
+
+   if (lat->hist_count == AUDIO_LATENCY_SAMPLES)
+   {
+      lat->fill_hist[lat->fill_sample[lat->hist_next]]--;
+      lat->rate_hist[lat->rate_sample[lat->hist_next]]--;
+   }
+   else
+      lat->hist_count++;
+   lat->fill_sample[lat->hist_next] = (uint8_t)fill_idx;
+   lat->rate_sample[lat->hist_next] = (uint8_t)rate_idx;
+   lat->fill_hist[fill_idx]++;
+   lat->rate_hist[rate_idx]++;
+   lat->hist_next                   = (lat->hist_next + 1)
+      % AUDIO_LATENCY_SAMPLES;
+   lat->queue_free                  = avail;
+   lat->queue_time                  = cpu_features_get_time_usec();
+}
+
+/**
+ * audio_driver_latency_add_flush:
+ *
+ * Records the stage times of one audio_driver_flush(), taken when
+ * the core's batch arrived, when it was ready for the driver and
+ * when the driver's write returned.
+ **/
+static void audio_driver_latency_add_flush(audio_latency_state_t *lat,
+      retro_time_t arrival, retro_time_t processed, retro_time_t written,
+      size_t frames)
+{
+   audio_flush_record_t *rec = &lat->flush[
+      lat->flushes++ % AUDIO_LATENCY_SAMPLES];
+   rec->arrival              = arrival;
+   rec->process_usec         = (uint32_t)MAX(processed - arrival, 0);
+   rec->write_usec           = (uint32_t)MAX(written - processed, 0);
+   rec->frames               = (uint32_t)frames;
+}
+
 /**
  * Writes audio samples to audio driver's output.
  * Will first perform DSP processing (if enabled) and resampling.
@@ -539,6 +595,8 @@ static double audio_driver_compute_rate_adjust(audio_driver_state_t *audio_st)
    audio_st->free_samples_buf[write_idx] = avail;
    audio_st->cached_rate_adjust          = rate_adjust;
    audio_st->samples_since_drc           = 0;
+   audio_driver_latency_add_drc(&audio_st->latency,
+         (unsigned)MAX(avail, 0), audio_st->buffer_size, direction);
    return rate_adjust;
 }
 
@@ -586,6 +644,7 @@ static void audio_driver_flush(audio_driver_state_t *audio_st,
       bool is_slowmotion, bool is_fastforward)
 {
    struct resampler_data src_data;
+   retro_time_t arrival, processed;
    const audio_driver_t *audio    = audio_st->current_audio;
    float audio_volume_gain        =
          (audio_st->mute_enable || audio_st->flags & AUDIO_FLAG_MUTED)
@@ -603,6 +662,8 @@ static void audio_driver_flush(audio_driver_state_t *audio_st,
       return;
    }
 
+   arrival = cpu_features_get_time_usec();
+
    /* Fast path: if driver handles resampling and no DSP/mixer is active,
     * bypass software resampling entirely. An active in-process MIDI synth
     * also disables the fast path, since its PCM is mixed into the float
@@ -639,11 +700,19 @@ static void audio_driver_flush(audio_driver_state_t *audio_st,
          rate_adjust                *= slowmotion_ratio;
 
       /* Note: mute/volume is not applied here - driver must handle or ignore */
+      processed = cpu_features_get_time_usec();
       audio->write_raw(audio_st->context_audio_data,
             data, frames, input_rate, rate_adjust, audio_volume_gain);
+      audio_driver_latency_add_flush(&audio_st->latency, arrival,
+            processed, cpu_features_get_time_usec(), frames);
       return;
    }
 
+   /* Each stage below makes its own pass over the whole batch.  Carrying
+    * L1-sized chunks through all of them was tried: it cuts the
+    * batch-sized buffer traffic from about 42 KB to 13 KB for a 735
+    * frame batch, but measured no faster, since a batch already stays
+    * in cache and the resampler dominates the cost. */
    src_data.data_out                 = NULL;
    src_data.output_frames            = 0;
    /* We'll assign a proper output to the resampler later in this function */
@@ -895,8 +964,11 @@ static void audio_driver_flush(audio_driver_state_t *audio_st,
          output_frames       *= sizeof(int16_t);  /* Unit: bytes */
       }
 
+      processed = cpu_features_get_time_usec();
       audio->write(audio_st->context_audio_data,
             output_data, output_frames * 2);
+      audio_driver_latency_add_flush(&audio_st->latency, arrival,
+            processed, cpu_features_get_time_usec(), samples >> 1);
    }
 }
 
@@ -1134,6 +1206,8 @@ bool audio_driver_init_internal(void *settings_data, bool audio_cb_inited)
    audio_driver_st.samples_since_drc  = 0;
    audio_driver_update_drc_threshold(&audio_driver_st);
 
+   memset(&audio_driver_st.latency, 0, sizeof(audio_driver_st.latency));
+
 #ifdef HAVE_AUDIOMIXER
    audio_mixer_init(settings->uints.audio_output_sample_rate);
 #endif
@@ -2230,6 +2304,82 @@ bool audio_compute_buffer_statistics(audio_statistics_t *stats)
    return true;
 }
 
+static int audio_latency_cmp(const void *a, const void *b)
+{
+   uint32_t x = *(const uint32_t*)a;
+   uint32_t y = *(const uint32_t*)b;
+   return (x > y) - (x < y);
+}
+
+/* Sorts @values in place and returns the value @percent of them
+ * are within. */
+static uint32_t audio_latency_percentile(uint32_t *values,
+      unsigned count, unsigned percent)
+{
+   unsigned idx = (count * percent + 99) / 100;
+   if (!count)
+      return 0;
+   qsort(values, count, sizeof(*values), audio_latency_cmp);
+   return values[MAX(idx, 1) - 1];
+}
+
+bool audio_driver_get_latency_stats(audio_latency_stats_t *stats)
+{
+   unsigned i;
+   uint32_t process[AUDIO_LATENCY_SAMPLES];
+   uint32_t writes[AUDIO_LATENCY_SAMPLES];
+   uint32_t interval[AUDIO_LATENCY_SAMPLES];
+   audio_driver_state_t *audio_st   = &audio_driver_st;
+   const audio_latency_state_t *lat = &audio_st->latency;
+   unsigned count                   = (unsigned)MIN(lat->flushes,
+         AUDIO_LATENCY_SAMPLES);
+   unsigned intervals               = 0;
+   /* Oldest record kept */
+   unsigned first                   = (unsigned)((lat->flushes - count)
+         % AUDIO_LATENCY_SAMPLES);
+
+   if (!count)
+      return false;
+
+   for (i = 0; i < count; i++)
+   {
+      const audio_flush_record_t *rec =
+         &lat->flush[(first + i) % AUDIO_LATENCY_SAMPLES];
+      process[i] = rec->process_usec;
+      writes[i]  = rec->write_usec;
+      if (i)
+         interval[intervals++] = (uint32_t)MAX(rec->arrival
+               - lat->flush[(first + i - 1) % AUDIO_LATENCY_SAMPLES].arrival,
+               0);
+   }
+
+   stats->last          = lat->flush[(lat->flushes - 1)
+      % AUDIO_LATENCY_SAMPLES];
+   stats->flushes       = lat->flushes;
+   stats->queue_time    = lat->queue_time;
+   stats->queue_free    = lat->queue_free;
+   stats->buffer_size   = (unsigned)audio_st->buffer_size;
+   stats->rate_adjust   = (audio_st->flags & AUDIO_FLAG_CONTROL)
+      ? audio_st->cached_rate_adjust : 1.0;
+   /* Same scaling as audio_driver_compute_rate_adjust() */
+   stats->rate_delta    = (audio_st->src_ratio_orig > 1.0)
+      ? audio_st->rate_control_delta / audio_st->src_ratio_orig
+      : audio_st->rate_control_delta;
+   stats->hist_samples  = lat->hist_count;
+   memcpy(stats->fill_hist, lat->fill_hist, sizeof(stats->fill_hist));
+   memcpy(stats->rate_hist, lat->rate_hist, sizeof(stats->rate_hist));
+
+   stats->interval_p50  = audio_latency_percentile(interval, intervals, 50);
+   stats->interval_p95  = audio_latency_percentile(interval, intervals, 95);
+   stats->process_p50   = audio_latency_percentile(process, count, 50);
+   stats->process_p95   = audio_latency_percentile(process, count, 95);
+   stats->process_max   = process[count - 1];
+   stats->write_p50     = audio_latency_percentile(writes, count, 50);
+   stats->write_p95     = audio_latency_percentile(writes, count, 95);
+   stats->write_max     = writes[count - 1];
+   return true;
+}
+
 #ifdef HAVE_MENU
 void audio_driver_menu_sample(void)
 {
@@ -44,8 +44,66 @@
 
 #define AUDIO_BUFFER_FREE_SAMPLES_COUNT (8 * 1024)
 
+/* Flushes and rate control samples kept for the latency statistics */
+#define AUDIO_LATENCY_SAMPLES      128
+/* Buffer fill in 5% steps */
+#define AUDIO_LATENCY_FILL_BUCKETS 20
+/* rate_adjust from 1 - delta to 1 + delta in 10% of delta steps */
+#define AUDIO_LATENCY_RATE_BUCKETS 20
+
 RETRO_BEGIN_DECLS
 
+/* One audio_driver_flush(); times in microseconds */
+typedef struct audio_flush_record
+{
+   /* When the core's batch reached the flush */
+   retro_time_t arrival;
+   /* s16 conversion, DSP, resampling and mixing */
+   uint32_t process_usec;
+   /* Spent in the driver's write or write_raw */
+   uint32_t write_usec;
+   uint32_t frames;
+} audio_flush_record_t;
+
+/* Rolling latency statistics, kept whether or not anybody asks.
+ * The fill and rate_adjust histograms only move while rate
+ * control is active, since that is when write_avail() is read. */
+typedef struct audio_latency_state
+{
+   audio_flush_record_t flush[AUDIO_LATENCY_SAMPLES];
+   uint64_t flushes;
+   /* Last write_avail() reading and when it was taken */
+   retro_time_t queue_time;
+   unsigned queue_free;
+   /* Bucket of each of the last AUDIO_LATENCY_SAMPLES readings */
+   uint8_t fill_sample[AUDIO_LATENCY_SAMPLES];
+   uint8_t rate_sample[AUDIO_LATENCY_SAMPLES];
+   uint16_t fill_hist[AUDIO_LATENCY_FILL_BUCKETS];
+   uint16_t rate_hist[AUDIO_LATENCY_RATE_BUCKETS];
+   uint16_t hist_count;
+   uint16_t hist_next;
+} audio_latency_state_t;
+
+/* Snapshot of audio_latency_state_t for reporting */
+typedef struct audio_latency_stats
+{
+   audio_flush_record_t last;
+   uint64_t flushes;
+   retro_time_t queue_time;
+   double rate_adjust;
+   /* Full scale of the rate histogram: rate_adjust - 1 at its ends */
+   double rate_delta;
+   /* Over the last AUDIO_LATENCY_SAMPLES flushes */
+   uint32_t interval_p50, interval_p95;
+   uint32_t process_p50, process_p95, process_max;
+   uint32_t write_p50, write_p95, write_max;
+   unsigned queue_free;
+   unsigned buffer_size;
+   unsigned hist_samples;
+   uint16_t fill_hist[AUDIO_LATENCY_FILL_BUCKETS];
+   uint16_t rate_hist[AUDIO_LATENCY_RATE_BUCKETS];
+} audio_latency_stats_t;
+
 #ifdef HAVE_AUDIOMIXER
 typedef struct audio_mixer_stream
 {
@@ -299,6 +357,8 @@ typedef struct
    double   cached_rate_adjust;        /* last computed factor; default 1.0 */
    size_t   samples_since_drc;         /* int16 samples submitted since last update */
    size_t   drc_threshold_int16s;      /* one frame's worth of stereo int16 at the current rate */
+
+   audio_latency_state_t latency;
 } audio_driver_state_t;
 
 bool audio_driver_enable_callback(void);
@@ -379,6 +439,15 @@ bool audio_driver_is_ai_service_speech_running(void);
  **/
 bool audio_compute_buffer_statistics(audio_statistics_t *stats);
 
+/**
+ * audio_driver_get_latency_stats:
+ *
+ * Fills @stats from the rolling per-flush timings and the buffer
+ * fill and rate_adjust histograms.  Returns false before the first
+ * flush since the driver was initialised.
+ **/
+bool audio_driver_get_latency_stats(audio_latency_stats_t *stats);
+
 bool audio_driver_init_internal(void *data, bool audio_cb_inited);
 
 bool audio_driver_deinit(void);
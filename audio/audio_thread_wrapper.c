@@ -17,7 +17,10 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <queues/fifo_queue.h>
+#include <retro_miscellaneous.h>
+#include <retro_timers.h>
+#include <retro_atomic.h>
+#include <retro_spsc.h>
 #include <rthreads/rthreads.h>
 
 #include "audio_thread_wrapper.h"
@@ -35,6 +38,22 @@ typedef struct audio_thread
    const char *device;
    unsigned *new_rate;
 
+   /* Samples written by the producer, drained into the wrapped
+    * driver by the audio thread.  drain_buf holds what was last
+    * read out of the ring and not yet accepted by the driver. */
+   retro_spsc_t ring;
+   uint8_t *drain_buf;
+   size_t drain_pos;
+   size_t drain_len;
+
+   /* Statistics; each counter has a single writer. */
+   retro_atomic_size_t underruns;
+   retro_atomic_size_t overruns;
+   retro_atomic_size_t fill[AUDIO_THREAD_FILL_BUCKETS];
+
+   /* alive && !stopped, readable without the lock. */
+   retro_atomic_int_t running;
+
    int inited;
 
    /* Initialization options. */
@@ -48,9 +67,71 @@ typedef struct audio_thread
    bool is_paused;
    bool is_shutdown;
    bool use_float;
+   bool flowing;
 
 } audio_thread_t;
 
+/* Call with thr->lock held. */
+static void audio_thread_set_running(audio_thread_t *thr)
+{
+   retro_atomic_store_release_int(&thr->running,
+         (thr->alive && !thr->stopped) ? 1 : 0);
+}
+
+/**
+ * Hands samples from the ring to the wrapped driver.
+ * Only ever called on the audio thread, which makes it
+ * the single consumer of the ring.
+ */
+static void audio_thread_drain(audio_thread_t *thr)
+{
+   ssize_t written;
+
+   if (thr->drain_pos == thr->drain_len)
+   {
+      size_t bucket;
+      size_t avail  = retro_spsc_read_avail(&thr->ring);
+
+      if (!avail)
+      {
+         /* Count each time the stream runs dry,
+          * not every poll of an empty ring. */
+         if (thr->flowing)
+            retro_atomic_fetch_add_size(&thr->underruns, 1);
+         thr->flowing = false;
+         retro_sleep(1);
+         return;
+      }
+
+      /* One sample per block drained, so idle polls
+       * don't pile up in the bottom bucket. */
+      bucket         = MIN(avail * AUDIO_THREAD_FILL_BUCKETS
+            / thr->ring.capacity, AUDIO_THREAD_FILL_BUCKETS - 1);
+      retro_atomic_fetch_add_size(&thr->fill[bucket], 1);
+
+      thr->flowing   = true;
+      thr->drain_len = retro_spsc_read(&thr->ring, thr->drain_buf, avail);
+      thr->drain_pos = 0;
+   }
+
+   written = thr->driver->write(thr->driver_data,
+         thr->drain_buf + thr->drain_pos,
+         thr->drain_len - thr->drain_pos);
+
+   if (written < 0)
+   {
+      thr->drain_pos = thr->drain_len;
+      slock_lock(thr->lock);
+      thr->alive = false;
+      audio_thread_set_running(thr);
+      scond_signal(thr->cond);
+      slock_unlock(thr->lock);
+      return;
+   }
+
+   thr->drain_pos += (size_t)written;
+}
+
 /**
  * The thread that manages the life of the audio driver.
  * The wrapped audio driver lives and dies with this function.
@@ -84,34 +165,41 @@ static void audio_thread_loop(void *data)
 
    for (;;)
    {
-      slock_lock(thr->lock);
-
-      if (!thr->alive)
+      /* Only take the lock when the stream has to change state. */
+      if (!retro_atomic_load_acquire_int(&thr->running))
       {
-         scond_signal(thr->cond);
-         thr->stopped_ack = true;
-         slock_unlock(thr->lock);
-         break;
-      }
+         slock_lock(thr->lock);
 
-      if (thr->stopped)
-      {
-         thr->driver->stop(thr->driver_data);
-         while (thr->stopped)
+         if (!thr->alive)
          {
-            /* If we stop right after start,
-             * we might not be able to properly ack.
-             * Signal in the loop instead. */
-            thr->stopped_ack = true;
             scond_signal(thr->cond);
+            thr->stopped_ack = true;
+            slock_unlock(thr->lock);
+            break;
+         }
 
-            scond_wait(thr->cond, thr->lock);
+         if (thr->stopped)
+         {
+            thr->driver->stop(thr->driver_data);
+            while (thr->stopped)
+            {
+               /* If we stop right after start,
+                * we might not be able to properly ack.
+                * Signal in the loop instead. */
+               thr->stopped_ack = true;
+               scond_signal(thr->cond);
+
+               scond_wait(thr->cond, thr->lock);
+            }
+            thr->driver->start(thr->driver_data, thr->is_shutdown);
          }
-         thr->driver->start(thr->driver_data, thr->is_shutdown);
+
+         slock_unlock(thr->lock);
+         continue;
       }
 
-      slock_unlock(thr->lock);
       audio_driver_callback();
+      audio_thread_drain(thr);
    }
 
    thr->driver->free(thr->driver_data);
@@ -132,6 +220,7 @@ static void audio_thread_block(audio_thread_t *thr)
    slock_lock(thr->lock);
    thr->stopped_ack = false;
    thr->stopped = true;
+   audio_thread_set_running(thr);
    scond_signal(thr->cond);
 
    /* Wait until audio driver actually goes to sleep. */
@@ -152,10 +241,40 @@ static void audio_thread_unblock(audio_thread_t *thr)
 
    slock_lock(thr->lock); /* Prevent the audio thread from touching this flag... */
    thr->stopped = false; /* ...so that the main thread can do it. */
+   audio_thread_set_running(thr);
    scond_signal(thr->cond); /* Then let the audio thread know that it's okay to resume. */
    slock_unlock(thr->lock); /* "As you were." */
 }
 
+/* Holds half of the configured latency, so that a producer
+ * which is not on the audio thread cannot add more than that
+ * on top of the driver's own buffer. */
+static bool audio_thread_init_ring(audio_thread_t *thr)
+{
+   unsigned rate = (thr->new_rate && *thr->new_rate)
+      ? *thr->new_rate : thr->out_rate;
+   size_t frames = (size_t)rate * thr->latency / 2000;
+   size_t bytes  = frames * 2
+      * (thr->use_float ? sizeof(float) : sizeof(int16_t));
+
+   if (!retro_spsc_init(&thr->ring, MAX(bytes, 4096)))
+      return false;
+   if (!(thr->drain_buf = (uint8_t*)malloc(thr->ring.capacity)))
+      return false;
+   return true;
+}
+
+static void audio_thread_read_stats(audio_thread_t *thr,
+      audio_thread_stats_t *stats)
+{
+   unsigned i;
+   stats->capacity  = thr->ring.capacity;
+   stats->underruns = retro_atomic_load_acquire_size(&thr->underruns);
+   stats->overruns  = retro_atomic_load_acquire_size(&thr->overruns);
+   for (i = 0; i < AUDIO_THREAD_FILL_BUCKETS; i++)
+      stats->fill[i] = retro_atomic_load_acquire_size(&thr->fill[i]);
+}
+
 static void audio_thread_free(void *data)
 {
    audio_thread_t *thr = (audio_thread_t*)data;
@@ -168,6 +287,7 @@ static void audio_thread_free(void *data)
       slock_lock(thr->lock); /* Let the audio thread finish what it's doing... */
       thr->stopped = false; /* Then stop it. "You're fired." */
       thr->alive   = false;
+      audio_thread_set_running(thr);
       scond_signal(thr->cond); /* Let the thread know it's okay to continue */
       slock_unlock(thr->lock); /* At this point, it will exit its loop. */
 
@@ -176,6 +296,23 @@ static void audio_thread_free(void *data)
        * (It will call the wrapped driver's free() function.) */
    }
 
+   if (thr->drain_buf)
+   {
+      audio_thread_stats_t stats;
+      audio_thread_read_stats(thr, &stats);
+      RARCH_LOG("[Audio] Thread ring: %u bytes, %u underruns, "
+            "%u overruns, fill %u/%u/%u/%u/%u/%u/%u/%u.\n",
+            (unsigned)stats.capacity,
+            (unsigned)stats.underruns,
+            (unsigned)stats.overruns,
+            (unsigned)stats.fill[0], (unsigned)stats.fill[1],
+            (unsigned)stats.fill[2], (unsigned)stats.fill[3],
+            (unsigned)stats.fill[4], (unsigned)stats.fill[5],
+            (unsigned)stats.fill[6], (unsigned)stats.fill[7]);
+      free(thr->drain_buf);
+   }
+   retro_spsc_free(&thr->ring);
+
    if (thr->lock)
       slock_free(thr->lock);
    if (thr->cond)
@@ -249,21 +386,50 @@ static bool audio_thread_use_float(void *data)
    return thr->use_float;
 }
 
+/**
+ * Producer side of the ring; never takes a lock.
+ *
+ * Cores using the audio callback produce on the audio thread
+ * itself, which is also the consumer, so a full ring is drained
+ * into the driver right away and the driver's blocking write
+ * keeps pacing the core.  Any other thread waits for room while
+ * the stream is running and drops what does not fit otherwise.
+ * Either way there must only be one producing thread.
+ */
 static ssize_t audio_thread_write(void *data, const void *s, size_t len)
 {
-   ssize_t _len;
+   const uint8_t *src  = (const uint8_t*)s;
+   size_t remaining    = len;
+   bool overrun        = false;
    audio_thread_t *thr = (audio_thread_t*)data;
-   if (!thr)
+   if (!thr || !thr->drain_buf)
       return 0;
-   _len = thr->driver->write(thr->driver_data, s, len);
-   if (_len < 0)
+
+   for (;;)
    {
-      slock_lock(thr->lock);
-      thr->alive = false;
-      scond_signal(thr->cond);
-      slock_unlock(thr->lock);
+      size_t _len  = retro_spsc_write(&thr->ring, src, remaining);
+      src         += _len;
+      remaining   -= _len;
+      if (!remaining)
+         break;
+
+      if (!overrun)
+         retro_atomic_fetch_add_size(&thr->overruns, 1);
+      overrun = true;
+
+      if (sthread_isself(thr->thread))
+      {
+         audio_thread_drain(thr);
+         if (!thr->alive)
+            return -1;
+      }
+      else if (retro_atomic_load_acquire_int(&thr->running))
+         retro_sleep(1);
+      else
+         break;
    }
-   return _len;
+
+   return (ssize_t)(len - remaining);
 }
 
 static const audio_driver_t audio_thread = {
@@ -282,6 +448,16 @@ static const audio_driver_t audio_thread = {
    NULL
 };
 
+bool audio_thread_get_stats(const audio_driver_t *driver, void *data,
+      audio_thread_stats_t *stats)
+{
+   audio_thread_t *thr = (audio_thread_t*)data;
+   if (driver != &audio_thread || !thr || !thr->drain_buf)
+      return false;
+   audio_thread_read_stats(thr, stats);
+   return true;
+}
+
 /**
  * audio_init_thread:
  * @out_driver                : output driver
@@ -303,6 +479,7 @@ bool audio_init_thread(const audio_driver_t **out_driver,
       unsigned *new_rate, unsigned latency,
       unsigned block_frames, const audio_driver_t *drv)
 {
+   unsigned i;
    audio_thread_t *thr = (audio_thread_t*)calloc(1, sizeof(*thr));
    if (!thr)
       return false;
@@ -321,6 +498,11 @@ bool audio_init_thread(const audio_driver_t **out_driver,
 
    thr->alive          = true;
    thr->stopped        = true;
+   retro_atomic_int_init(&thr->running, 0);
+   retro_atomic_size_init(&thr->underruns, 0);
+   retro_atomic_size_init(&thr->overruns, 0);
+   for (i = 0; i < AUDIO_THREAD_FILL_BUCKETS; i++)
+      retro_atomic_size_init(&thr->fill[i], 0);
 
    if (!(thr->thread   = sthread_create(audio_thread_loop, thr)))
       goto error;
@@ -334,6 +516,11 @@ bool audio_init_thread(const audio_driver_t **out_driver,
    if (thr->inited < 0) /* Thread failed. */
       goto error;
 
+   /* The thread stays parked until the driver is started,
+    * so the ring can still be set up from here. */
+   if (!audio_thread_init_ring(thr))
+      goto error;
+
    *out_driver         = &audio_thread;
    *out_data           = thr;
    return true;
@@ -21,6 +21,18 @@
 
 #include "audio_driver.h"
 
+#define AUDIO_THREAD_FILL_BUCKETS 8
+
+typedef struct audio_thread_stats
+{
+   size_t capacity;  /* Ring size in bytes. */
+   size_t underruns; /* Times the ring ran dry while audio was flowing. */
+   size_t overruns;  /* Writes that found the ring full. */
+   /* How full the ring was each time the audio thread
+    * drained a block from it, in eighths of capacity. */
+   size_t fill[AUDIO_THREAD_FILL_BUCKETS];
+} audio_thread_stats_t;
+
 /**
  * audio_init_thread:
  * @out_driver                : output driver
@@ -42,4 +54,15 @@ bool audio_init_thread(const audio_driver_t **out_driver, void **out_data,
       unsigned block_frames,
       const audio_driver_t *driver);
 
+/**
+ * audio_thread_get_stats:
+ * @driver                    : current audio driver
+ * @data                      : current audio driver data
+ * @stats                     : filled with the ring statistics
+ *
+ * Returns: false if @driver is not the threaded wrapper.
+ **/
+bool audio_thread_get_stats(const audio_driver_t *driver, void *data,
+      audio_thread_stats_t *stats);
+
 #endif
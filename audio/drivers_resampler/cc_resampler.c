@@ -18,10 +18,6 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-#ifdef __SSE__
-#include <xmmintrin.h>
-#endif
-
 #include <retro_inline.h>
 #include <retro_miscellaneous.h>
 #include <memalign.h>
@@ -37,7 +33,7 @@
  * setting 0 doesn't use a polynom
  * setting 1 uses P(X) = X - (3/4)*X^3 + (1/4)*X^5
  *
- * only 0 and 1 are implemented for SSE and NEON currently
+ * only 0 and 1 are implemented for SSE, AVX and NEON currently
  *
  * the MIPS_ARCH_ALLEGREX target doesnt require this setting since it has
  * native support for the required functions so it will always use full precision.
@@ -47,6 +43,23 @@
 #define CC_RESAMPLER_PRECISION 1
 #endif
 
+/* Only precisions 0 and 1 have vector kernels, anything else
+ * runs the C ones.  The AVX kernels are built regardless of the
+ * baseline -m flags and picked at init from the SIMD mask. */
+#if (CC_RESAMPLER_PRECISION < 2) && !defined(_MIPS_ARCH_ALLEGREX)
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define CC_RESAMPLER_SSE
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define CC_RESAMPLER_AVX
+#define CC_TARGET_AVX __attribute__((target("avx")))
+#endif
+#elif defined(HAVE_ARM_NEON_ASM_OPTIMIZATIONS)
+#define CC_RESAMPLER_NEON
+#endif
+#endif
+
 typedef struct rarch_CC_resampler
 {
    void (*process)(void *re, struct resampler_data *data);
@@ -172,99 +185,200 @@ static void *resampler_CC_init(const struct resampler_config *config,
 }
 #else
 
-#if defined(__SSE__)
-#define CC_RESAMPLER_IDENT "SSE"
+/* C version.  Not optimized, and not bit-exact with the vector
+ * kernels, which work in single precision throughout. */
 
-static void resampler_CC_downsample(void *re_, struct resampler_data *data)
+#if (CC_RESAMPLER_PRECISION > 4)
+static INLINE float cc_int(float x, float b)
 {
-   rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
+   float val = x * b * M_PI + sinf(x * b * M_PI);
+   return (val > M_PI) ? M_PI : (val < -M_PI) ? -M_PI : val;
+}
 
+#define cc_kernel(x, b)    ((cc_int((x) + 0.5, (b)) - cc_int((x) - 0.5, (b))) / (2.0 * M_PI))
+#else
+static INLINE float cc_int(float x, float b)
+{
+   float val = x * b;
+#if (CC_RESAMPLER_PRECISION > 0)
+   val = val*(1 - 0.25 * val * val * (3.0 - val * val));
+#endif
+   return (val > 0.5) ? 0.5 : (val < -0.5) ? -0.5 : val;
+}
+
+#define cc_kernel(x, b)    ((cc_int((x) + 0.5, (b)) - cc_int((x) - 0.5, (b))))
+#endif
+
+static INLINE void add_to(const audio_frame_float_t *source,
+      audio_frame_float_t *target, float ratio)
+{
+   target->l += source->l * ratio;
+   target->r += source->r * ratio;
+}
+
+static void resampler_CC_downsample_c(void *re_, struct resampler_data *data)
+{
+   rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
    audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
-   audio_frame_float_t *inp_max = (audio_frame_float_t*)(inp + data->input_frames);
+   audio_frame_float_t *inp_max = (audio_frame_float_t*)
+      (inp + data->input_frames);
    audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
-   float ratio                  = 1.0 / data->ratio;
-   float b                      = data->ratio; /* cutoff frequency. */
+   float                  ratio = 1.0 / data->ratio;
+   float                      b = data->ratio; /* cutoff frequency. */
 
-   __m128 vec_previous          = _mm_loadu_ps((float*)&re->buffer[0]);
-   __m128 vec_current           = _mm_loadu_ps((float*)&re->buffer[2]);
+   while (inp != inp_max)
+   {
+      add_to(inp, re->buffer + 0, cc_kernel(re->distance, b));
+      add_to(inp, re->buffer + 1, cc_kernel(re->distance - ratio, b));
+      add_to(inp, re->buffer + 2, cc_kernel(re->distance - ratio - ratio, b));
+
+      re->distance++;
+      inp++;
+
+      if (re->distance > (ratio + 0.5))
+      {
+         *outp = re->buffer[0];
+
+         re->buffer[0] = re->buffer[1];
+         re->buffer[1] = re->buffer[2];
+
+         re->buffer[2].l = 0.0;
+         re->buffer[2].r = 0.0;
+
+         re->distance -= ratio;
+         outp++;
+      }
+   }
+
+   data->output_frames = outp - (audio_frame_float_t*)data->data_out;
+}
+
+static void resampler_CC_upsample_c(void *re_, struct resampler_data *data)
+{
+   rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
+   audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
+   audio_frame_float_t *inp_max = (audio_frame_float_t*)
+      (inp + data->input_frames);
+   audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
+   float                      b = float_min(data->ratio, 1.00); /* cutoff frequency. */
+   float                  ratio = 1.0 / data->ratio;
 
    while (inp != inp_max)
    {
-      __m128 vec_ww1, vec_ww2;
-      __m128 vec_w_previous;
-      __m128 vec_w_current;
-      __m128 vec_in;
-      __m128 vec_ratio =
-         _mm_mul_ps(_mm_set_ps1(ratio), _mm_set_ps(3.0, 2.0, 1.0, 0.0));
-      __m128 vec_w     = _mm_sub_ps(_mm_set_ps1(re->distance), vec_ratio);
+      re->buffer[0] = re->buffer[1];
+      re->buffer[1] = re->buffer[2];
+      re->buffer[2] = re->buffer[3];
+      re->buffer[3] = *inp;
 
-      __m128 vec_w1    = _mm_add_ps(vec_w , _mm_set_ps1(0.5));
-      __m128 vec_w2    = _mm_sub_ps(vec_w , _mm_set_ps1(0.5));
+      while (re->distance < 1.0)
+      {
+         int i;
 
-      __m128 vec_b     = _mm_set_ps1(b);
+         outp->l = 0.0;
+         outp->r = 0.0;
 
-      vec_w1           = _mm_mul_ps(vec_w1, vec_b);
-      vec_w2           = _mm_mul_ps(vec_w2, vec_b);
+         for (i = 0; i < 4; i++)
+         {
+            float temp = cc_kernel(re->distance + 1.0 - i, b);
+            outp->l   += re->buffer[i].l * temp;
+            outp->r   += re->buffer[i].r * temp;
+         }
 
-      (void)vec_ww1;
-      (void)vec_ww2;
+         re->distance += ratio;
+         outp++;
+      }
+
+      re->distance -= 1.0;
+      inp++;
+   }
+
+   data->output_frames = outp - (audio_frame_float_t*)data->data_out;
+}
+
+#ifdef CC_RESAMPLER_SSE
+/* Weights of the four taps for the distances in w. */
+static INLINE __m128 cc_weights_sse(__m128 w, __m128 b)
+{
+   __m128 w1 = _mm_mul_ps(_mm_add_ps(w, _mm_set_ps1(0.5f)), b);
+   __m128 w2 = _mm_mul_ps(_mm_sub_ps(w, _mm_set_ps1(0.5f)), b);
 
 #if (CC_RESAMPLER_PRECISION > 0)
-      vec_ww1 = _mm_mul_ps(vec_w1, vec_w1);
-      vec_ww2 = _mm_mul_ps(vec_w2, vec_w2);
+   __m128 ww1 = _mm_mul_ps(w1, w1);
+   __m128 ww2 = _mm_mul_ps(w2, w2);
 
-      vec_ww1 = _mm_mul_ps(vec_ww1, _mm_sub_ps(_mm_set_ps1(3.0),vec_ww1));
-      vec_ww2 = _mm_mul_ps(vec_ww2, _mm_sub_ps(_mm_set_ps1(3.0),vec_ww2));
+   ww1 = _mm_mul_ps(ww1, _mm_sub_ps(_mm_set_ps1(3.0f), ww1));
+   ww2 = _mm_mul_ps(ww2, _mm_sub_ps(_mm_set_ps1(3.0f), ww2));
 
-      vec_ww1 = _mm_mul_ps(_mm_set_ps1(1.0/4.0), vec_ww1);
-      vec_ww2 = _mm_mul_ps(_mm_set_ps1(1.0/4.0), vec_ww2);
+   ww1 = _mm_mul_ps(_mm_set_ps1(0.25f), ww1);
+   ww2 = _mm_mul_ps(_mm_set_ps1(0.25f), ww2);
 
-      vec_w1  = _mm_mul_ps(vec_w1, _mm_sub_ps(_mm_set_ps1(1.0), vec_ww1));
-      vec_w2  = _mm_mul_ps(vec_w2, _mm_sub_ps(_mm_set_ps1(1.0), vec_ww2));
+   w1  = _mm_mul_ps(w1, _mm_sub_ps(_mm_set_ps1(1.0f), ww1));
+   w2  = _mm_mul_ps(w2, _mm_sub_ps(_mm_set_ps1(1.0f), ww2));
 #endif
 
-      vec_w1  = _mm_min_ps(vec_w1, _mm_set_ps1( 0.5));
-      vec_w2  = _mm_min_ps(vec_w2, _mm_set_ps1( 0.5));
-      vec_w1  = _mm_max_ps(vec_w1, _mm_set_ps1(-0.5));
-      vec_w2  = _mm_max_ps(vec_w2, _mm_set_ps1(-0.5));
-      vec_w   = _mm_sub_ps(vec_w1, vec_w2);
+   w1  = _mm_max_ps(_mm_min_ps(w1, _mm_set_ps1(0.5f)), _mm_set_ps1(-0.5f));
+   w2  = _mm_max_ps(_mm_min_ps(w2, _mm_set_ps1(0.5f)), _mm_set_ps1(-0.5f));
+
+   return _mm_sub_ps(w1, w2);
+}
 
-      vec_w_previous =
-         _mm_shuffle_ps(vec_w,vec_w,_MM_SHUFFLE(1, 1, 0, 0));
-      vec_w_current  =
-         _mm_shuffle_ps(vec_w,vec_w,_MM_SHUFFLE(3, 3, 2, 2));
+static void resampler_CC_downsample_sse(void *re_, struct resampler_data *data)
+{
+   rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
+
+   audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
+   audio_frame_float_t *inp_max = (audio_frame_float_t*)(inp + data->input_frames);
+   audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
+   float ratio                  = 1.0 / data->ratio;
+   float b                      = data->ratio; /* cutoff frequency. */
+   float distance               = re->distance;
 
-      vec_in = _mm_loadl_pi(_mm_setzero_ps(),(__m64*)inp);
-      vec_in = _mm_shuffle_ps(vec_in,vec_in,_MM_SHUFFLE(1, 0, 1, 0));
+   __m128 vec_previous          = _mm_loadu_ps((float*)&re->buffer[0]);
+   __m128 vec_current           = _mm_loadu_ps((float*)&re->buffer[2]);
+   __m128 vec_ratio             =
+      _mm_mul_ps(_mm_set_ps1(ratio), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+   __m128 vec_b                 = _mm_set_ps1(b);
 
-      vec_previous =
+   while (inp != inp_max)
+   {
+      __m128 vec_w = cc_weights_sse(
+            _mm_sub_ps(_mm_set_ps1(distance), vec_ratio), vec_b);
+      __m128 vec_w_previous =
+         _mm_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(1, 1, 0, 0));
+      __m128 vec_w_current  =
+         _mm_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(3, 3, 2, 2));
+      __m128 vec_in = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)inp);
+      vec_in        = _mm_shuffle_ps(vec_in, vec_in, _MM_SHUFFLE(1, 0, 1, 0));
+
+      vec_previous  =
          _mm_add_ps(vec_previous, _mm_mul_ps(vec_in, vec_w_previous));
-      vec_current  =
+      vec_current   =
          _mm_add_ps(vec_current, _mm_mul_ps(vec_in, vec_w_current));
 
-      re->distance++;
+      distance++;
       inp++;
 
-      if (re->distance > (ratio + 0.5))
+      if (distance > (ratio + 0.5))
       {
          _mm_storel_pi((__m64*)outp, vec_previous);
          vec_previous =
-            _mm_shuffle_ps(vec_previous,vec_current,_MM_SHUFFLE(1, 0, 3, 2));
+            _mm_shuffle_ps(vec_previous, vec_current, _MM_SHUFFLE(1, 0, 3, 2));
          vec_current  =
-            _mm_shuffle_ps(vec_current,_mm_setzero_ps(),_MM_SHUFFLE(1, 0, 3, 2));
+            _mm_shuffle_ps(vec_current, _mm_setzero_ps(), _MM_SHUFFLE(1, 0, 3, 2));
 
-         re->distance -= ratio;
+         distance -= ratio;
          outp++;
       }
    }
 
    _mm_storeu_ps((float*)&re->buffer[0], vec_previous);
-   _mm_storeu_ps((float*)&re->buffer[2],  vec_current);
+   _mm_storeu_ps((float*)&re->buffer[2], vec_current);
 
+   re->distance        = distance;
    data->output_frames = outp - (audio_frame_float_t*)data->data_out;
 }
 
-static void resampler_CC_upsample(void *re_, struct resampler_data *data)
+static void resampler_CC_upsample_sse(void *re_, struct resampler_data *data)
 {
    rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
    audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
@@ -272,213 +386,240 @@ static void resampler_CC_upsample(void *re_, struct resampler_data *data)
    audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
    float b                      = float_min(data->ratio, 1.00); /* cutoff frequency. */
    float ratio                  = 1.0 / data->ratio;
+   float distance               = re->distance;
    __m128 vec_previous          = _mm_loadu_ps((float*)&re->buffer[0]);
    __m128 vec_current           = _mm_loadu_ps((float*)&re->buffer[2]);
+   __m128 vec_taps              = _mm_set_ps(-2.0f, -1.0f, 0.0f, 1.0f);
+   __m128 vec_b                 = _mm_set_ps1(b);
 
    while (inp != inp_max)
    {
-      __m128 vec_in = _mm_loadl_pi(_mm_setzero_ps(),(__m64*)inp);
-      vec_previous =
-         _mm_shuffle_ps(vec_previous,vec_current,_MM_SHUFFLE(1, 0, 3, 2));
-      vec_current  =
-         _mm_shuffle_ps(vec_current,vec_in,_MM_SHUFFLE(1, 0, 3, 2));
+      __m128 vec_in = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)inp);
+      vec_previous  =
+         _mm_shuffle_ps(vec_previous, vec_current, _MM_SHUFFLE(1, 0, 3, 2));
+      vec_current   =
+         _mm_shuffle_ps(vec_current, vec_in, _MM_SHUFFLE(1, 0, 3, 2));
 
-      while (re->distance < 1.0)
+      while (distance < 1.0f)
       {
-         __m128 vec_w_previous, vec_w_current, vec_out;
-#if (CC_RESAMPLER_PRECISION > 0)
-         __m128 vec_ww1, vec_ww2;
-#endif
-         __m128 vec_w =
-            _mm_add_ps(_mm_set_ps1(re->distance), _mm_set_ps(-2.0, -1.0, 0.0, 1.0));
-
-         __m128 vec_w1 = _mm_add_ps(vec_w , _mm_set_ps1(0.5));
-         __m128 vec_w2 = _mm_sub_ps(vec_w , _mm_set_ps1(0.5));
-
-         __m128 vec_b = _mm_set_ps1(b);
-         vec_w1 = _mm_mul_ps(vec_w1, vec_b);
-         vec_w2 = _mm_mul_ps(vec_w2, vec_b);
-
-#if (CC_RESAMPLER_PRECISION > 0)
-         vec_ww1 = _mm_mul_ps(vec_w1, vec_w1);
-         vec_ww2 = _mm_mul_ps(vec_w2, vec_w2);
-
-         vec_ww1 = _mm_mul_ps(vec_ww1,_mm_sub_ps(_mm_set_ps1(3.0),vec_ww1));
-         vec_ww2 = _mm_mul_ps(vec_ww2,_mm_sub_ps(_mm_set_ps1(3.0),vec_ww2));
-
-         vec_ww1 = _mm_mul_ps(_mm_set_ps1(1.0 / 4.0), vec_ww1);
-         vec_ww2 = _mm_mul_ps(_mm_set_ps1(1.0 / 4.0), vec_ww2);
-
-         vec_w1  = _mm_mul_ps(vec_w1, _mm_sub_ps(_mm_set_ps1(1.0), vec_ww1));
-         vec_w2  = _mm_mul_ps(vec_w2, _mm_sub_ps(_mm_set_ps1(1.0), vec_ww2));
-#endif
-
-         vec_w1  = _mm_min_ps(vec_w1, _mm_set_ps1( 0.5));
-         vec_w2  = _mm_min_ps(vec_w2, _mm_set_ps1( 0.5));
-         vec_w1  = _mm_max_ps(vec_w1, _mm_set_ps1(-0.5));
-         vec_w2  = _mm_max_ps(vec_w2, _mm_set_ps1(-0.5));
-
-         vec_w   = _mm_sub_ps(vec_w1, vec_w2);
-
-         vec_w_previous = _mm_shuffle_ps(vec_w,vec_w,_MM_SHUFFLE(1, 1, 0, 0));
-         vec_w_current  = _mm_shuffle_ps(vec_w,vec_w,_MM_SHUFFLE(3, 3, 2, 2));
-
-         vec_out =  _mm_mul_ps(vec_previous, vec_w_previous);
-         vec_out = _mm_add_ps(vec_out, _mm_mul_ps(vec_current, vec_w_current));
-         vec_out =
-            _mm_add_ps(vec_out, _mm_shuffle_ps(vec_out,vec_out,_MM_SHUFFLE(3, 2, 3, 2)));
-
-         _mm_storel_pi((__m64*)outp,vec_out);
-
-         re->distance += ratio;
+         __m128 vec_w = cc_weights_sse(
+               _mm_add_ps(_mm_set_ps1(distance), vec_taps), vec_b);
+         __m128 vec_w_previous =
+            _mm_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(1, 1, 0, 0));
+         __m128 vec_w_current  =
+            _mm_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(3, 3, 2, 2));
+         __m128 vec_out = _mm_add_ps(
+               _mm_mul_ps(vec_previous, vec_w_previous),
+               _mm_mul_ps(vec_current,  vec_w_current));
+         vec_out        = _mm_add_ps(vec_out,
+               _mm_shuffle_ps(vec_out, vec_out, _MM_SHUFFLE(3, 2, 3, 2)));
+
+         _mm_storel_pi((__m64*)outp, vec_out);
+
+         distance += ratio;
          outp++;
       }
 
-      re->distance -= 1.0;
+      distance -= 1.0f;
       inp++;
    }
 
    _mm_storeu_ps((float*)&re->buffer[0], vec_previous);
-   _mm_storeu_ps((float*)&re->buffer[2],  vec_current);
+   _mm_storeu_ps((float*)&re->buffer[2], vec_current);
 
+   re->distance        = distance;
    data->output_frames = outp - (audio_frame_float_t*)data->data_out;
 }
+#endif
 
-#elif defined(HAVE_ARM_NEON_ASM_OPTIMIZATIONS)
-
-#define CC_RESAMPLER_IDENT "NEON"
-
-size_t resampler_CC_downsample_neon(float *outp, const float *inp,
-      rarch_CC_resampler_t* re_, size_t input_frames, float ratio);
-size_t resampler_CC_upsample_neon  (float *outp, const float *inp,
-      rarch_CC_resampler_t* re_, size_t input_frames, float ratio);
-
-static void resampler_CC_downsample(void *re_, struct resampler_data *data)
+#ifdef CC_RESAMPLER_AVX
+/* cc_weights_sse() for two sets of distances at once. */
+CC_TARGET_AVX
+static INLINE __m256 cc_weights_avx(__m256 w, __m256 b)
 {
-   data->output_frames = resampler_CC_downsample_neon(
-         data->data_out, data->data_in, (struct rarch_CC_resampler*)re_, data->input_frames, data->ratio);
-}
+   __m256 w1 = _mm256_mul_ps(_mm256_add_ps(w, _mm256_set1_ps(0.5f)), b);
+   __m256 w2 = _mm256_mul_ps(_mm256_sub_ps(w, _mm256_set1_ps(0.5f)), b);
 
-static void resampler_CC_upsample(void *re_, struct resampler_data *data)
-{
-   data->output_frames = resampler_CC_upsample_neon(
-         data->data_out, data->data_in, (struct rarch_CC_resampler*)re_, data->input_frames, data->ratio);
-}
+#if (CC_RESAMPLER_PRECISION > 0)
+   __m256 ww1 = _mm256_mul_ps(w1, w1);
+   __m256 ww2 = _mm256_mul_ps(w2, w2);
 
-#else
+   ww1 = _mm256_mul_ps(ww1, _mm256_sub_ps(_mm256_set1_ps(3.0f), ww1));
+   ww2 = _mm256_mul_ps(ww2, _mm256_sub_ps(_mm256_set1_ps(3.0f), ww2));
 
-/* C reference version. Not optimized. */
+   ww1 = _mm256_mul_ps(_mm256_set1_ps(0.25f), ww1);
+   ww2 = _mm256_mul_ps(_mm256_set1_ps(0.25f), ww2);
 
-#define CC_RESAMPLER_IDENT "C"
+   w1  = _mm256_mul_ps(w1, _mm256_sub_ps(_mm256_set1_ps(1.0f), ww1));
+   w2  = _mm256_mul_ps(w2, _mm256_sub_ps(_mm256_set1_ps(1.0f), ww2));
+#endif
 
-#if (CC_RESAMPLER_PRECISION > 4)
-static INLINE float cc_int(float x, float b)
-{
-   float val = x * b * M_PI + sinf(x * b * M_PI);
-   return (val > M_PI) ? M_PI : (val < -M_PI) ? -M_PI : val;
-}
+   w1  = _mm256_max_ps(_mm256_min_ps(w1, _mm256_set1_ps(0.5f)),
+         _mm256_set1_ps(-0.5f));
+   w2  = _mm256_max_ps(_mm256_min_ps(w2, _mm256_set1_ps(0.5f)),
+         _mm256_set1_ps(-0.5f));
 
-#define cc_kernel(x, b)    ((cc_int((x) + 0.5, (b)) - cc_int((x) - 0.5, (b))) / (2.0 * M_PI))
-#else
-static INLINE float cc_int(float x, float b)
-{
-   float val = x * b;
-#if (CC_RESAMPLER_PRECISION > 0)
-   val = val*(1 - 0.25 * val * val * (3.0 - val * val));
-#endif
-   return (val > 0.5) ? 0.5 : (val < -0.5) ? -0.5 : val;
+   return _mm256_sub_ps(w1, w2);
 }
 
-#define cc_kernel(x, b)    ((cc_int((x) + 0.5, (b)) - cc_int((x) - 0.5, (b))))
-#endif
-
-static INLINE void add_to(const audio_frame_float_t *source,
-      audio_frame_float_t *target, float ratio)
+CC_TARGET_AVX
+static INLINE __m256 cc_pair_avx(__m128 lo, __m128 hi)
 {
-   target->l += source->l * ratio;
-   target->r += source->r * ratio;
+   return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
 }
 
-static void resampler_CC_downsample(void *re_, struct resampler_data *data)
+/* Works out the weights for two input frames at once whenever
+ * no output frame falls between them, the usual case for the
+ * ratios downsampling is picked for. */
+CC_TARGET_AVX
+static void resampler_CC_downsample_avx(void *re_, struct resampler_data *data)
 {
    rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
    audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
-   audio_frame_float_t *inp_max = (audio_frame_float_t*)
-      (inp + data->input_frames);
+   audio_frame_float_t *inp_max = (audio_frame_float_t*)(inp + data->input_frames);
    audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
-   float                  ratio = 1.0 / data->ratio;
-   float                      b = data->ratio; /* cutoff frequency. */
+   float ratio                  = 1.0 / data->ratio;
+   float b                      = data->ratio; /* cutoff frequency. */
+   float distance               = re->distance;
+
+   __m128 vec_previous          = _mm_loadu_ps((float*)&re->buffer[0]);
+   __m128 vec_current           = _mm_loadu_ps((float*)&re->buffer[2]);
+   __m128 vec_ratio             =
+      _mm_mul_ps(_mm_set_ps1(ratio), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+   __m256 vec_ratio2            = cc_pair_avx(vec_ratio, vec_ratio);
+   __m256 vec_b                 = _mm256_set1_ps(b);
 
    while (inp != inp_max)
    {
-      add_to(inp, re->buffer + 0, cc_kernel(re->distance, b));
-      add_to(inp, re->buffer + 1, cc_kernel(re->distance - ratio, b));
-      add_to(inp, re->buffer + 2, cc_kernel(re->distance - ratio - ratio, b));
-
-      re->distance++;
-      inp++;
-
-      if (re->distance > (ratio + 0.5))
+      int n;
+      float next   = distance + 1.0f;
+      int frames   = (inp + 1 != inp_max && !(next > (ratio + 0.5))) ? 2 : 1;
+      __m256 vec_w = cc_weights_avx(_mm256_sub_ps(
+               cc_pair_avx(_mm_set_ps1(distance), _mm_set_ps1(next)),
+               vec_ratio2), vec_b);
+
+      for (n = 0; n < frames; n++)
       {
-         *outp = re->buffer[0];
+         __m128 w = n ? _mm256_extractf128_ps(vec_w, 1)
+                      : _mm256_castps256_ps128(vec_w);
+         __m128 vec_in = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)inp);
+         vec_in        = _mm_shuffle_ps(vec_in, vec_in, _MM_SHUFFLE(1, 0, 1, 0));
 
-         re->buffer[0] = re->buffer[1];
-         re->buffer[1] = re->buffer[2];
+         vec_previous  = _mm_add_ps(vec_previous, _mm_mul_ps(vec_in,
+                  _mm_shuffle_ps(w, w, _MM_SHUFFLE(1, 1, 0, 0))));
+         vec_current   = _mm_add_ps(vec_current, _mm_mul_ps(vec_in,
+                  _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 2, 2))));
 
-         re->buffer[2].l = 0.0;
-         re->buffer[2].r = 0.0;
+         distance++;
+         inp++;
+      }
 
-         re->distance -= ratio;
+      if (distance > (ratio + 0.5))
+      {
+         _mm_storel_pi((__m64*)outp, vec_previous);
+         vec_previous =
+            _mm_shuffle_ps(vec_previous, vec_current, _MM_SHUFFLE(1, 0, 3, 2));
+         vec_current  =
+            _mm_shuffle_ps(vec_current, _mm_setzero_ps(), _MM_SHUFFLE(1, 0, 3, 2));
+
+         distance -= ratio;
          outp++;
       }
    }
 
+   _mm_storeu_ps((float*)&re->buffer[0], vec_previous);
+   _mm_storeu_ps((float*)&re->buffer[2], vec_current);
+
+   re->distance        = distance;
    data->output_frames = outp - (audio_frame_float_t*)data->data_out;
 }
 
-static void resampler_CC_upsample(void *re_, struct resampler_data *data)
+/* Works out two output frames at once while both fall before
+ * the next input frame. */
+CC_TARGET_AVX
+static void resampler_CC_upsample_avx(void *re_, struct resampler_data *data)
 {
    rarch_CC_resampler_t *re     = (rarch_CC_resampler_t*)re_;
    audio_frame_float_t *inp     = (audio_frame_float_t*)data->data_in;
-   audio_frame_float_t *inp_max = (audio_frame_float_t*)
-      (inp + data->input_frames);
+   audio_frame_float_t *inp_max = (audio_frame_float_t*)(inp + data->input_frames);
    audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
-   float                      b = float_min(data->ratio, 1.00); /* cutoff frequency. */
-   float                  ratio = 1.0 / data->ratio;
+   float b                      = float_min(data->ratio, 1.00); /* cutoff frequency. */
+   float ratio                  = 1.0 / data->ratio;
+   float distance               = re->distance;
+   __m128 vec_previous          = _mm_loadu_ps((float*)&re->buffer[0]);
+   __m128 vec_current           = _mm_loadu_ps((float*)&re->buffer[2]);
+   __m128 vec_taps              = _mm_set_ps(-2.0f, -1.0f, 0.0f, 1.0f);
+   __m256 vec_taps2             = cc_pair_avx(vec_taps, vec_taps);
+   __m256 vec_b                 = _mm256_set1_ps(b);
 
    while (inp != inp_max)
    {
-      re->buffer[0] = re->buffer[1];
-      re->buffer[1] = re->buffer[2];
-      re->buffer[2] = re->buffer[3];
-      re->buffer[3] = *inp;
-
-      while (re->distance < 1.0)
+      __m256 vec_previous2, vec_current2;
+      __m128 vec_in = _mm_loadl_pi(_mm_setzero_ps(), (__m64*)inp);
+      vec_previous  =
+         _mm_shuffle_ps(vec_previous, vec_current, _MM_SHUFFLE(1, 0, 3, 2));
+      vec_current   =
+         _mm_shuffle_ps(vec_current, vec_in, _MM_SHUFFLE(1, 0, 3, 2));
+      vec_previous2 = cc_pair_avx(vec_previous, vec_previous);
+      vec_current2  = cc_pair_avx(vec_current,  vec_current);
+
+      while (distance < 1.0f)
       {
-         int i;
-
-         outp->l = 0.0;
-         outp->r = 0.0;
+         float next     = distance + ratio;
+         __m256 vec_w   = cc_weights_avx(_mm256_add_ps(
+                  cc_pair_avx(_mm_set_ps1(distance), _mm_set_ps1(next)),
+                  vec_taps2), vec_b);
+         __m256 vec_out = _mm256_add_ps(
+               _mm256_mul_ps(vec_previous2,
+                  _mm256_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(1, 1, 0, 0))),
+               _mm256_mul_ps(vec_current2,
+                  _mm256_shuffle_ps(vec_w, vec_w, _MM_SHUFFLE(3, 3, 2, 2))));
+         vec_out        = _mm256_add_ps(vec_out, _mm256_shuffle_ps(
+                  vec_out, vec_out, _MM_SHUFFLE(3, 2, 3, 2)));
+
+         _mm_storel_pi((__m64*)outp, _mm256_castps256_ps128(vec_out));
+         distance = next;
+         outp++;
 
-         for (i = 0; i < 4; i++)
-         {
-            float temp = cc_kernel(re->distance + 1.0 - i, b);
-            outp->l   += re->buffer[i].l * temp;
-            outp->r   += re->buffer[i].r * temp;
-         }
+         if (!(distance < 1.0f))
+            break;
 
-         re->distance += ratio;
+         _mm_storel_pi((__m64*)outp, _mm256_extractf128_ps(vec_out, 1));
+         distance += ratio;
          outp++;
       }
 
-      re->distance -= 1.0;
+      distance -= 1.0f;
       inp++;
    }
 
+   _mm_storeu_ps((float*)&re->buffer[0], vec_previous);
+   _mm_storeu_ps((float*)&re->buffer[2], vec_current);
+
+   re->distance        = distance;
    data->output_frames = outp - (audio_frame_float_t*)data->data_out;
 }
 #endif
 
+#ifdef CC_RESAMPLER_NEON
+size_t resampler_CC_downsample_neon(float *outp, const float *inp,
+      rarch_CC_resampler_t* re_, size_t input_frames, float ratio);
+size_t resampler_CC_upsample_neon  (float *outp, const float *inp,
+      rarch_CC_resampler_t* re_, size_t input_frames, float ratio);
+
+static void resampler_CC_downsample_neon_wrap(void *re_, struct resampler_data *data)
+{
+   data->output_frames = resampler_CC_downsample_neon(
+         data->data_out, data->data_in, (struct rarch_CC_resampler*)re_, data->input_frames, data->ratio);
+}
+
+static void resampler_CC_upsample_neon_wrap(void *re_, struct resampler_data *data)
+{
+   data->output_frames = resampler_CC_upsample_neon(
+         data->data_out, data->data_in, (struct rarch_CC_resampler*)re_, data->input_frames, data->ratio);
+}
+#endif
+
 static void resampler_CC_process(void *re_, struct resampler_data *data)
 {
    rarch_CC_resampler_t *re = (rarch_CC_resampler_t*)re_;
@@ -492,14 +633,10 @@ static void *resampler_CC_init(const struct resampler_config *config,
       resampler_simd_mask_t mask)
 {
    int i;
+   bool downsample          = bandwidth_mod < 0.75;
    rarch_CC_resampler_t *re = (rarch_CC_resampler_t*)
       memalign_alloc(32, sizeof(rarch_CC_resampler_t));
 
-   /* TODO: lookup if NEON support can be detected at
-    * runtime and a funcptr set at runtime for either
-    * C codepath or NEON codepath. This will help out
-    * Android. */
-   (void)mask;
    (void)config;
    if (!re)
       return NULL;
@@ -512,16 +649,36 @@ static void *resampler_CC_init(const struct resampler_config *config,
 
    /* Variations of data->ratio around 0.75 are safer
     * than around 1.0 for both up/downsampler. */
-   if (bandwidth_mod < 0.75)
+   re->distance = downsample ? 0.0 : 2.0;
+   re->process  = downsample ? resampler_CC_downsample_c
+                             : resampler_CC_upsample_c;
+
+   /* Widest kernel the CPU has (mask is cpu_features_get()). */
+#ifdef CC_RESAMPLER_AVX
+   if (mask & RESAMPLER_SIMD_AVX)
+   {
+      re->process = downsample ? resampler_CC_downsample_avx
+                               : resampler_CC_upsample_avx;
+      return re;
+   }
+#endif
+#ifdef CC_RESAMPLER_SSE
+   if (mask & RESAMPLER_SIMD_SSE)
    {
-      re->process = resampler_CC_downsample;
-      re->distance = 0.0;
+      re->process = downsample ? resampler_CC_downsample_sse
+                               : resampler_CC_upsample_sse;
+      return re;
    }
-   else
+#endif
+#ifdef CC_RESAMPLER_NEON
+   if (mask & RESAMPLER_SIMD_NEON)
    {
-      re->process = resampler_CC_upsample;
-      re->distance = 2.0;
+      re->process = downsample ? resampler_CC_downsample_neon_wrap
+                               : resampler_CC_upsample_neon_wrap;
+      return re;
    }
+#endif
+   (void)mask;
 
    return re;
 }
@@ -134,8 +134,10 @@ static bool command_get_arg(const char *tok,
          if (*argument != ' ' && *argument != '\0')
             return false;
 
+         /* Without an argument, point at the terminator rather
+          * than past it. */
          if (arg)
-            *arg = argument + 1;
+            *arg = *argument ? argument + 1 : argument;
 
          if (index)
             *index = i;
@@ -955,6 +957,162 @@ bool command_seek_replay(command_t *cmd, const char *arg)
 #endif
 }
 
+/* Replies with
+ * "GET_REWIND_STATS <entries> <hot used> <hot capacity>
+ *  <cold entries> <cold used> <cold capacity>
+ *  <cold raw bytes> <cold compressed bytes> <keyframes>",
+ * all in bytes; the cold fields are 0 unless
+ * rewind_compress is active. */
+bool command_get_rewind_stats(command_t *cmd, const char *arg)
+{
+#ifdef HAVE_REWIND
+   char reply[256];
+   size_t _len;
+   struct state_manager_stats stats;
+   runloop_state_t *runloop_st = runloop_state_get_ptr();
+
+   if (!state_manager_get_stats(&runloop_st->rewind_st, &stats))
+   {
+      cmd->replier(cmd, "GET_REWIND_STATS NO\n", 20);
+      return false;
+   }
+
+   _len = snprintf(reply, sizeof(reply),
+         "GET_REWIND_STATS %u %llu %llu %u %llu %llu %llu %llu %u\n",
+         stats.entries,
+         (unsigned long long)stats.hot_used,
+         (unsigned long long)stats.hot_capacity,
+         stats.cold_entries,
+         (unsigned long long)stats.cold_used,
+         (unsigned long long)stats.cold_capacity,
+         (unsigned long long)stats.cold_raw_bytes,
+         (unsigned long long)stats.cold_comp_bytes,
+         stats.keyframes);
+   cmd->replier(cmd, reply, _len);
+   return true;
+#else
+   cmd->replier(cmd, "GET_REWIND_STATS NO\n", 20);
+   return false;
+#endif
+}
+
+/* With no argument, replies with
+ * "GET_AUDIO_STATS <flushes> <arrival> <frames> <process> <write>
+ *  <interval p50> <interval p95> <process p50> <process p95>
+ *  <process max> <write p50> <write p95> <write max>
+ *  <queue time> <queue free> <buffer size> <rate_adjust>",
+ * for the last flush and the last AUDIO_LATENCY_SAMPLES of them.
+ * Times are microseconds, <arrival> and <queue time> on the
+ * cpu_features_get_time_usec() clock; <queue free> is the last
+ * write_avail() reading, in bytes like <buffer size>.
+ *
+ * "FILL" replies with "GET_AUDIO_STATS FILL <samples>" and how
+ * many of the last rate control readings fell in each 5% of
+ * buffer fill; "RATE" with "GET_AUDIO_STATS RATE <samples>
+ * <delta>" and the same over rate_adjust, from 1 - delta to
+ * 1 + delta in tenths of delta. */
+bool command_get_audio_stats(command_t *cmd, const char *arg)
+{
+   char reply[512];
+   size_t _len;
+   unsigned i;
+   audio_latency_stats_t stats;
+
+   if (!audio_driver_get_latency_stats(&stats))
+   {
+      cmd->replier(cmd, "GET_AUDIO_STATS NO\n", 19);
+      return false;
+   }
+
+   if (string_is_equal(arg, "FILL") || string_is_equal(arg, "RATE"))
+   {
+      bool fill              = (arg[0] == 'F');
+      const uint16_t *hist   = fill ? stats.fill_hist : stats.rate_hist;
+      unsigned buckets       = fill
+         ? AUDIO_LATENCY_FILL_BUCKETS : AUDIO_LATENCY_RATE_BUCKETS;
+
+      _len = snprintf(reply, sizeof(reply), "GET_AUDIO_STATS %s %u",
+            arg, stats.hist_samples);
+      if (!fill)
+         _len += snprintf(reply + _len, sizeof(reply) - _len, " %.6f",
+               stats.rate_delta);
+      for (i = 0; i < buckets; i++)
+         _len += snprintf(reply + _len, sizeof(reply) - _len, " %u",
+               (unsigned)hist[i]);
+      _len += snprintf(reply + _len, sizeof(reply) - _len, "\n");
+   }
+   else if (string_is_empty(arg))
+      _len = snprintf(reply, sizeof(reply),
+            "GET_AUDIO_STATS %llu %lld %u %u %u %u %u %u %u %u %u %u %u"
+            " %lld %u %u %.6f\n",
+            (unsigned long long)stats.flushes,
+            (long long)stats.last.arrival,
+            stats.last.frames,
+            stats.last.process_usec,
+            stats.last.write_usec,
+            stats.interval_p50,
+            stats.interval_p95,
+            stats.process_p50,
+            stats.process_p95,
+            stats.process_max,
+            stats.write_p50,
+            stats.write_p95,
+            stats.write_max,
+            (long long)stats.queue_time,
+            stats.queue_free,
+            stats.buffer_size,
+            stats.rate_adjust);
+   else
+   {
+      cmd->replier(cmd, "GET_AUDIO_STATS NO\n", 19);
+      return false;
+   }
+
+   cmd->replier(cmd, reply, MIN(_len, sizeof(reply) - 1));
+   return true;
+}
+
+bool command_rewind_seek(command_t *cmd, const char *arg)
+{
+#ifdef HAVE_REWIND
+   char reply[64];
+   size_t _len;
+   char *endptr                = NULL;
+   settings_t *settings        = config_get_ptr();
+   runloop_state_t *runloop_st = runloop_state_get_ptr();
+   unsigned granularity        = settings->uints.rewind_granularity;
+   unsigned long frames        = strtoul(arg, &endptr, 10);
+   unsigned steps              = 0;
+
+   if (!granularity)
+      granularity              = 1;
+
+   /* Unlike the rewind hotkey, a seek does not tell netplay to
+    * resync, so it would leave the peers desynced. */
+   if (     endptr != arg
+#ifdef HAVE_CHEEVOS
+         && !rcheevos_hardcore_active()
+#endif
+#ifdef HAVE_NETWORKING
+         && !netplay_driver_ctl(RARCH_NETPLAY_CTL_IS_ENABLED, NULL)
+#endif
+      )
+      steps = state_manager_seek_rewind(&runloop_st->rewind_st,
+            (unsigned)((frames + granularity - 1) / granularity));
+
+   if (steps)
+      _len = snprintf(reply, sizeof(reply), "REWIND_SEEK %u\n",
+            steps * granularity);
+   else
+      _len = strlcpy(reply, "REWIND_SEEK NO\n", sizeof(reply));
+   cmd->replier(cmd, reply, _len);
+   return steps != 0;
+#else
+   cmd->replier(cmd, "REWIND_SEEK NO\n", 15);
+   return false;
+#endif
+}
+
 bool command_save_savefiles(command_t *cmd, const char* arg)
 {
    char reply[4];
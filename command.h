@@ -438,6 +438,9 @@ bool command_load_state_slot(command_t *cmd, const char* arg);
 bool command_save_state_slot(command_t* cmd, const char* arg);
 bool command_play_replay_slot(command_t *cmd, const char* arg);
 bool command_seek_replay(command_t *cmd, const char *arg);
+bool command_get_rewind_stats(command_t *cmd, const char *arg);
+bool command_rewind_seek(command_t *cmd, const char *arg);
+bool command_get_audio_stats(command_t *cmd, const char *arg);
 bool command_save_savefiles(command_t *cmd, const char* arg);
 bool command_load_savefiles(command_t *cmd, const char* arg);
 #ifdef HAVE_CHEEVOS
@@ -469,6 +472,9 @@ static const struct cmd_action_map action_map[] = {
    { "SAVE_STATE_SLOT",command_save_state_slot, "<slot number>"},
    { "PLAY_REPLAY_SLOT",command_play_replay_slot, "<slot number>"},
    { "SEEK_REPLAY",command_seek_replay, "<frame number>"},
+   { "GET_REWIND_STATS",command_get_rewind_stats, "No argument"},
+   { "REWIND_SEEK",command_rewind_seek, "<frames back>"},
+   { "GET_AUDIO_STATS",command_get_audio_stats, "[FILL|RATE]"},
 
    { "SAVE_FILES", command_save_savefiles, "No argument"},
    { "LOAD_FILES", command_load_savefiles, "No argument"},
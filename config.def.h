@@ -510,6 +510,10 @@
 #define DEFAULT_VIDEO_OVERSCAN_CORRECTION_BOTTOM 0
 #endif
 
+/* Run the CPU video filter on its own threads while the core
+ * runs the next frame, at the cost of one frame of latency. */
+#define DEFAULT_VIDEO_FILTER_PIPELINED false
+
 /* Smooths picture. */
 #if defined(_3DS) || defined(GEKKO) || defined(HW_RVL) || defined(PSP) || defined(VITA) || defined(SN_TARGET_PSP2) || defined(PS2) || defined(_XBOX) || defined(DINGUX)
 #define DEFAULT_VIDEO_SMOOTH true
@@ -1354,6 +1358,21 @@
 #define DEFAULT_REWIND_GRANULARITY 1
 #endif
 
+/* Offloads rewind patch generation to a worker thread.
+ * The main thread only serializes the core; diffing and
+ * appending to the rewind buffer happen in the background.
+ * Costs one extra savestate-sized block of memory. */
+#define DEFAULT_REWIND_ASYNC false
+
+/* Splits the rewind buffer into a small raw tier and a
+ * larger tier that a worker thread fills with zstd-
+ * recompressed copies of the oldest patches. */
+#define DEFAULT_REWIND_COMPRESS false
+
+/* Store a full state every N rewind entries, so seeking
+ * (REWIND_SEEK) replays at most N patches. 0 = off. */
+#define DEFAULT_REWIND_KEYFRAME_INTERVAL 0
+
 /* Pause gameplay when window loses focus. */
 #define DEFAULT_PAUSE_NONACTIVE true
 
@@ -1455,6 +1474,10 @@
  * deterministic but in some cores produces janky results depending on
  * when inputs are processed. */
 #define DEFAULT_REPLAY_CHECKPOINT_DESERIALIZE true
+/* Specifies whether replay checkpoints are compressed against the
+ * previous checkpoint rather than on their own.  Makes replays with
+ * checkpoints much smaller, but needs a zstd-enabled build to play. */
+#define DEFAULT_REPLAY_CHECKPOINT_DICTIONARY false
 
 /* Automatically saves a savestate at the end of RetroArch's lifetime.
  * The path is $SRAM_PATH.auto.
@@ -1514,6 +1537,18 @@
 /* Hide warning messages when using the Run Ahead feature. */
 #define DEFAULT_RUN_AHEAD_HIDE_WARNINGS false
 
+/* When using the Run Ahead feature with a single instance,
+ * keep the predicted frames while the input does not change. */
+#define DEFAULT_RUN_AHEAD_INCREMENTAL false
+
+/* When using the Run Ahead feature with a secondary instance,
+ * run the secondary instance on its own thread. */
+#define DEFAULT_RUN_AHEAD_SECONDARY_THREADED false
+
+/* Pick the Run Ahead frame count automatically from the measured
+ * cost of each frame, up to the configured count. */
+#define DEFAULT_RUN_AHEAD_FRAMES_AUTO false
+
 /* Enable stdin/network command interface. */
 #define DEFAULT_NETWORK_CMD_ENABLE false
 #define DEFAULT_NETWORK_CMD_PORT 55355
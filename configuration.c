@@ -1687,6 +1687,7 @@ static struct config_path_setting *populate_settings_path(
    SETTING_PATH("cheat_database_path",           settings->paths.path_cheat_database, false, NULL, true);
    SETTING_PATH("system_directory",              settings->paths.directory_system, true, NULL, true);
    SETTING_PATH("cache_directory",               settings->paths.directory_cache, false, NULL, true);
+   SETTING_PATH("rewind_dump_directory",         settings->paths.directory_rewind_dump, false, NULL, true);
    SETTING_PATH("audio_dsp_plugin",              settings->paths.path_audio_dsp_plugin, false, NULL, true);
    SETTING_PATH("audio_filter_dir",              settings->paths.directory_audio_filter, true, NULL, true);
    SETTING_PATH("video_shader_dir",              settings->paths.directory_video_shader, true, NULL, true);
@@ -1831,15 +1832,21 @@ static struct config_bool_setting *populate_settings_bool(
    SETTING_BOOL("auto_screenshot_filename",      &settings->bools.auto_screenshot_filename, true, DEFAULT_AUTO_SCREENSHOT_FILENAME, false);
    SETTING_BOOL("suspend_screensaver_enable",    &settings->bools.ui_suspend_screensaver_enable, true, true, false);
    SETTING_BOOL("video_filter_enable",           &settings->bools.video_filter_enable, true, true, false);
+   SETTING_BOOL("video_filter_pipelined",        &settings->bools.video_filter_pipelined, true, DEFAULT_VIDEO_FILTER_PIPELINED, false);
    SETTING_BOOL("apply_cheats_after_toggle",     &settings->bools.apply_cheats_after_toggle, true, DEFAULT_APPLY_CHEATS_AFTER_TOGGLE, false);
    SETTING_BOOL("apply_cheats_after_load",       &settings->bools.apply_cheats_after_load, true, DEFAULT_APPLY_CHEATS_AFTER_LOAD, false);
    SETTING_BOOL("rewind_enable",                 &settings->bools.rewind_enable, true, DEFAULT_REWIND_ENABLE, false);
+   SETTING_BOOL("rewind_async",                  &settings->bools.rewind_async, true, DEFAULT_REWIND_ASYNC, false);
+   SETTING_BOOL("rewind_compress",               &settings->bools.rewind_compress, true, DEFAULT_REWIND_COMPRESS, false);
    SETTING_BOOL("fastforward_frameskip",         &settings->bools.fastforward_frameskip, true, DEFAULT_FASTFORWARD_FRAMESKIP, false);
    SETTING_BOOL("vrr_runloop_enable",            &settings->bools.vrr_runloop_enable, true, DEFAULT_VRR_RUNLOOP_ENABLE, false);
    SETTING_BOOL("menu_throttle_framerate",       &settings->bools.menu_throttle_framerate, true, true, false);
    SETTING_BOOL("run_ahead_enabled",             &settings->bools.run_ahead_enabled, true, false, false);
    SETTING_BOOL("run_ahead_secondary_instance",  &settings->bools.run_ahead_secondary_instance, true, DEFAULT_RUN_AHEAD_SECONDARY_INSTANCE, false);
    SETTING_BOOL("run_ahead_hide_warnings",       &settings->bools.run_ahead_hide_warnings, true, DEFAULT_RUN_AHEAD_HIDE_WARNINGS, false);
+   SETTING_BOOL("run_ahead_incremental",         &settings->bools.run_ahead_incremental, true, DEFAULT_RUN_AHEAD_INCREMENTAL, false);
+   SETTING_BOOL("run_ahead_secondary_threaded",  &settings->bools.run_ahead_secondary_threaded, true, DEFAULT_RUN_AHEAD_SECONDARY_THREADED, false);
+   SETTING_BOOL("run_ahead_frames_auto",         &settings->bools.run_ahead_frames_auto, true, DEFAULT_RUN_AHEAD_FRAMES_AUTO, false);
    SETTING_BOOL("preemptive_frames_enable",      &settings->bools.preemptive_frames_enable, true, false, false);
 #if HAVE_MENU
    SETTING_BOOL("kiosk_mode_enable",             &settings->bools.kiosk_mode_enable, true, DEFAULT_KIOSK_MODE_ENABLE, false);
@@ -2318,6 +2325,7 @@ static struct config_bool_setting *populate_settings_bool(
 #endif
 #ifdef HAVE_BSV_MOVIE
    SETTING_BOOL("replay_checkpoint_deserialize", &settings->bools.replay_checkpoint_deserialize,  true, DEFAULT_REPLAY_CHECKPOINT_DESERIALIZE, false);
+   SETTING_BOOL("replay_checkpoint_dictionary",  &settings->bools.replay_checkpoint_dictionary,   true, DEFAULT_REPLAY_CHECKPOINT_DICTIONARY, false);
 #endif
 
 #ifdef ANDROID
@@ -2469,6 +2477,7 @@ static struct config_uint_setting *populate_settings_uint(
    SETTING_UINT("autosave_interval",             &settings->uints.autosave_interval,  true, DEFAULT_AUTOSAVE_INTERVAL, false);
    SETTING_UINT("savestate_automatic_interval",  &settings->uints.savestate_automatic_interval, true, DEFAULT_SAVESTATE_AUTOMATIC_INTERVAL, false);
    SETTING_UINT("rewind_granularity",            &settings->uints.rewind_granularity, true, DEFAULT_REWIND_GRANULARITY, false);
+   SETTING_UINT("rewind_keyframe_interval",      &settings->uints.rewind_keyframe_interval, true, DEFAULT_REWIND_KEYFRAME_INTERVAL, false);
    SETTING_UINT("rewind_buffer_size_step",       &settings->uints.rewind_buffer_size_step, true, DEFAULT_REWIND_BUFFER_SIZE_STEP, false);
    SETTING_UINT("run_ahead_frames",              &settings->uints.run_ahead_frames, true, DEFAULT_RUN_AHEAD_FRAMES,  false);
    SETTING_UINT("replay_max_keep",               &settings->uints.replay_max_keep, true, DEFAULT_REPLAY_MAX_KEEP, false);
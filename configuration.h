@@ -241,6 +241,7 @@ typedef struct settings
       unsigned frontend_log_level;
       unsigned libretro_log_level;
       unsigned rewind_granularity;
+      unsigned rewind_keyframe_interval;
       unsigned rewind_buffer_size_step;
       unsigned autosave_interval;
       unsigned savestate_automatic_interval;
@@ -629,6 +630,7 @@ typedef struct settings
       char directory_bottom_assets[DIR_MAX_LENGTH];
 #endif
       char log_dir[DIR_MAX_LENGTH];
+      char directory_rewind_dump[DIR_MAX_LENGTH];
 
 #ifdef HAVE_TEST_DRIVERS
       char test_input_file_joypad[PATH_MAX_LENGTH];
@@ -707,6 +709,7 @@ typedef struct settings
       bool video_memory_show;
       bool video_msg_bgcolor_enable;
       bool video_filter_enable;
+      bool video_filter_pipelined;
 #ifdef _3DS
       bool video_3ds_lcd_bottom;
 #endif
@@ -1062,6 +1065,8 @@ typedef struct settings
       bool history_list_enable;
       bool playlist_entry_rename;
       bool rewind_enable;
+      bool rewind_async;
+      bool rewind_compress;
       bool fastforward_frameskip;
       bool vrr_runloop_enable;
       bool menu_throttle_framerate;
@@ -1070,6 +1075,9 @@ typedef struct settings
       bool run_ahead_enabled;
       bool run_ahead_secondary_instance;
       bool run_ahead_hide_warnings;
+      bool run_ahead_incremental;
+      bool run_ahead_secondary_threaded;
+      bool run_ahead_frames_auto;
       bool preemptive_frames_enable;
       bool pause_nonactive;
       bool pause_on_disconnect;
@@ -1175,6 +1183,7 @@ typedef struct settings
       bool gamemode_enable;
 #ifdef HAVE_BSV_MOVIE
       bool replay_checkpoint_deserialize;
+      bool replay_checkpoint_dictionary;
 #endif
 
 #ifdef _3DS
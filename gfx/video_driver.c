@@ -28,6 +28,7 @@
 #endif
 
 #include <gfx/video_frame.h>
+#include <gfx/scaler/pixconv.h>
 
 #include "../config.def.h"
 
@@ -42,6 +43,7 @@
 
 #ifdef HAVE_THREADS
 #include "video_thread_wrapper.h"
+#include "../audio/audio_thread_wrapper.h"
 #endif
 
 #ifdef HAVE_MENU
@@ -1725,21 +1727,185 @@ retro_proc_address_t video_driver_get_proc_address(const char *sym)
 }
 
 #ifdef HAVE_VIDEO_FILTER
+/* Pipelined softfilter: the core's frame is copied to 'input' and
+ * filtered on the softfilter's threads into the next 'output' slot
+ * while the core runs the frame after it.  Whatever was filtered the
+ * frame before is presented in the meantime, so the picture is
+ * always one frame late. */
+#define VIDEO_FILTER_PIPE_FRAMES 2
+
+struct video_filter_pipe
+{
+   void *input_buf;
+   void *input;               /* within input_buf */
+   void *output[VIDEO_FILTER_PIPE_FRAMES];
+   size_t input_size;
+   size_t output_pitch;       /* of the frame in flight */
+   unsigned output_width;
+   unsigned output_height;
+   unsigned slot;             /* output[] the frame in flight goes to */
+   retro_time_t filter_time;  /* it took to filter the last frame */
+   retro_time_t wait_time;    /* spent waiting for it */
+   bool pending;
+};
+
+static void *video_driver_filter_buffer_alloc(size_t len)
+{
+#ifdef _3DS
+   return linearMemAlign(len, 0x80);
+#else
+   return malloc(len);
+#endif
+}
+
+static void video_driver_filter_buffer_free(void *buf)
+{
+   if (!buf)
+      return;
+#ifdef _3DS
+   linearFree(buf);
+#else
+   free(buf);
+#endif
+}
+
+static void video_driver_filter_pipe_free(video_driver_state_t *video_st)
+{
+   unsigned i;
+   struct video_filter_pipe *pipe = video_st->state_pipe;
+
+   if (!pipe)
+      return;
+
+   if (video_st->state_filter)
+      rarch_softfilter_wait(video_st->state_filter);
+
+   free(pipe->input_buf);
+   for (i = 0; i < VIDEO_FILTER_PIPE_FRAMES; i++)
+      video_driver_filter_buffer_free(pipe->output[i]);
+   free(pipe);
+   video_st->state_pipe = NULL;
+}
+
+static bool video_driver_filter_pipe_init(video_driver_state_t *video_st)
+{
+   unsigned i, width, height;
+   size_t margin;
+   struct video_filter_pipe *pipe   = NULL;
+   struct retro_game_geometry *geom = &video_st->av_info.geometry;
+   size_t in_bpp                    =
+      (video_st->pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+      ? sizeof(uint32_t) : sizeof(uint16_t);
+
+   rarch_softfilter_get_max_output_size(video_st->state_filter,
+         &width, &height);
+
+   if (!(pipe = (struct video_filter_pipe*)calloc(1, sizeof(*pipe))))
+      return false;
+   video_st->state_pipe = pipe;
+
+   /* Filters may look a row and a few pixels past the edges of
+    * the frame, which the core's own buffer usually has room for. */
+   margin               = (size_t)(geom->max_width + 16) * in_bpp;
+   pipe->input_size     = (size_t)geom->max_width * geom->max_height * in_bpp;
+   if (!(pipe->input_buf = calloc(1, pipe->input_size + 2 * margin)))
+      goto error;
+   pipe->input          = (uint8_t*)pipe->input_buf + margin;
+   for (i = 0; i < VIDEO_FILTER_PIPE_FRAMES; i++)
+   {
+      if (!(pipe->output[i] = video_driver_filter_buffer_alloc(
+               (size_t)width * height * video_st->state_out_bpp)))
+         goto error;
+   }
+
+   RARCH_LOG("[Video] Softfilter pipelined, frames are shown one frame late.\n");
+   return true;
+
+error:
+   RARCH_ERR("[Video] Failed to allocate softfilter pipeline.\n");
+   video_driver_filter_pipe_free(video_st);
+   return false;
+}
+
+/* Hands the frame to the softfilter and returns the one filtered the
+ * frame before, or NULL if there is none yet.  With 'data' NULL the
+ * frame in flight is only finished and returned. */
+static const void *video_driver_filter_pipe_frame(
+      video_driver_state_t *video_st,
+      const void *data, unsigned *width, unsigned *height, size_t *pitch)
+{
+   unsigned y;
+   size_t in_pitch;
+   unsigned out_width             = 0;
+   unsigned out_height            = 0;
+   size_t out_pitch               = 0;
+   const void *out                = NULL;
+   struct video_filter_pipe *pipe = video_st->state_pipe;
+   rarch_softfilter_t *filt       = video_st->state_filter;
+
+   if (pipe->pending)
+   {
+      retro_time_t start = cpu_features_get_time_usec();
+      rarch_softfilter_wait(filt);
+      pipe->wait_time    = cpu_features_get_time_usec() - start;
+      pipe->filter_time  = rarch_softfilter_get_process_time(filt);
+      pipe->pending      = false;
+      out                = pipe->output[pipe->slot];
+      out_width          = pipe->output_width;
+      out_height         = pipe->output_height;
+      out_pitch          = pipe->output_pitch;
+   }
+
+   if (data)
+   {
+      in_pitch = *width * ((video_st->pix_fmt == RETRO_PIXEL_FORMAT_XRGB8888)
+            ? sizeof(uint32_t) : sizeof(uint16_t));
+
+      if (in_pitch * *height > pipe->input_size)
+      {
+         /* Larger than the core said its frames would get; filter
+          * it the old way. */
+         rarch_softfilter_get_output_size(filt,
+               &out_width, &out_height, *width, *height);
+         out_pitch = out_width * video_st->state_out_bpp;
+         rarch_softfilter_process(filt, video_st->state_buffer,
+               out_pitch, data, *width, *height, *pitch);
+         out       = video_st->state_buffer;
+      }
+      else
+      {
+         /* The core may reuse its frame as soon as this returns. */
+         for (y = 0; y < *height; y++)
+            memcpy((uint8_t*)pipe->input + y * in_pitch,
+                  (const uint8_t*)data + y * *pitch, in_pitch);
+
+         pipe->slot         = (pipe->slot + 1) % VIDEO_FILTER_PIPE_FRAMES;
+         rarch_softfilter_get_output_size(filt,
+               &pipe->output_width, &pipe->output_height, *width, *height);
+         pipe->output_pitch = pipe->output_width * video_st->state_out_bpp;
+         pipe->pending      = true;
+         rarch_softfilter_process_async(filt,
+               pipe->output[pipe->slot], pipe->output_pitch,
+               pipe->input, *width, *height, in_pitch);
+      }
+   }
+
+   *width  = out_width;
+   *height = out_height;
+   *pitch  = out_pitch;
+   return out;
+}
+
 void video_driver_filter_free(void)
 {
    video_driver_state_t *video_st                 = &video_driver_st;
+
+   video_driver_filter_pipe_free(video_st);
    if (video_st->state_filter)
       rarch_softfilter_free(video_st->state_filter);
    video_st->state_filter    = NULL;
 
-   if (video_st->state_buffer)
-   {
-#ifdef _3DS
-      linearFree(video_st->state_buffer);
-#else
-      free(video_st->state_buffer);
-#endif
-   }
+   video_driver_filter_buffer_free(video_st->state_buffer);
    video_st->state_buffer    = NULL;
 
    video_st->state_scale     = 0;
@@ -3487,6 +3653,11 @@ void video_driver_build_info(video_frame_info_t *video_info)
    video_info->runahead_second_instance    = settings->bools.run_ahead_secondary_instance;
    video_info->preemptive_frames           = settings->bools.preemptive_frames_enable;
    video_info->runahead_frames             = settings->uints.run_ahead_frames;
+#ifdef HAVE_RUNAHEAD
+   if (     settings->bools.run_ahead_frames_auto
+         && runloop_st->runahead_stats.frames)
+      video_info->runahead_frames          = runloop_st->runahead_stats.frames;
+#endif
    video_info->fps_show                    = settings->bools.video_fps_show;
    video_info->filter_enable               = settings->bools.video_filter_enable;
    video_info->memory_show                 = settings->bools.video_memory_show;
@@ -3941,6 +4112,12 @@ bool video_driver_init_internal(bool *video_is_threaded, bool verbosity_enabled)
       cached_frame_lock = slock_new();
 #endif
 
+   /* Pixel conversions for screenshots, recording and the
+    * software-converting drivers. */
+   pixconv_init_simd();
+   RARCH_LOG("[Video] Pixel conversion kernels: %s.\n",
+         pixconv_impl_name(pixconv_get_impl()));
+
    max_dim   = MAX(geom->max_width, geom->max_height);
    scale     = next_pow2(max_dim) / RARCH_SCALE_BASE;
    scale     = MAX(scale, 1);
@@ -4815,34 +4992,67 @@ void video_driver_frame(const void *data, unsigned width,
             pitch, runloop_idle);
 
 #ifdef HAVE_VIDEO_FILTER
-   if (settings->bools.video_filter_enable && render_frame && data && video_st->state_filter)
+   /* Follows the setting, so that it can be flipped in-game. */
+   if (     video_st->state_filter
+         && settings->bools.video_filter_pipelined != !!video_st->state_pipe)
+   {
+      if (video_st->state_pipe)
+         video_driver_filter_pipe_free(video_st);
+      else if (!video_driver_filter_pipe_init(video_st))
+         configuration_set_bool(settings,
+               settings->bools.video_filter_pipelined, false);
+   }
+
+   if (     settings->bools.video_filter_enable
+         && render_frame
+         && video_st->state_filter
+         && (data || (video_st->state_pipe && video_st->state_pipe->pending)))
    {
+      const void *output                                = NULL;
       unsigned output_width                             = 0;
       unsigned output_height                            = 0;
-      unsigned output_pitch                             = 0;
+      size_t output_pitch                               = 0;
 
-      rarch_softfilter_get_output_size(video_st->state_filter,
-            &output_width, &output_height, width, height);
+      if (video_st->state_pipe)
+      {
+         output_width  = width;
+         output_height = height;
+         output_pitch  = pitch;
+         output        = video_driver_filter_pipe_frame(video_st, data,
+               &output_width, &output_height, &output_pitch);
+      }
+      else
+      {
+         rarch_softfilter_get_output_size(video_st->state_filter,
+               &output_width, &output_height, width, height);
 
-      output_pitch = (output_width) * video_st->state_out_bpp;
+         output_pitch = (output_width) * video_st->state_out_bpp;
 
-      rarch_softfilter_process(video_st->state_filter,
-            video_st->state_buffer, output_pitch,
-            data, width, height, pitch);
+         rarch_softfilter_process(video_st->state_filter,
+               video_st->state_buffer, output_pitch,
+               data, width, height, pitch);
+
+         output       = video_st->state_buffer;
+      }
 
-      if (     video_info.post_filter_record
+      if (     output
+            && video_info.post_filter_record
             && recording_st->data
             && recording_st->driver
             && recording_st->driver->push_video)
          recording_dump_frame(
-               video_st->state_buffer,
+               output,
                output_width, output_height, output_pitch,
                runloop_idle);
 
-      data   = video_st->state_buffer;
-      width  = output_width;
-      height = output_height;
-      pitch  = output_pitch;
+      /* Nothing has come out of the pipeline yet: a duped frame. */
+      data   = output;
+      if (output)
+      {
+         width  = output_width;
+         height = output_height;
+         pitch  = output_pitch;
+      }
    }
 #endif
 
@@ -5007,6 +5217,42 @@ void video_driver_frame(const void *data, unsigned width,
                audio_stats.close_to_blocking,
                audio_stats.samples);
 
+#ifdef HAVE_THREADS
+         {
+            audio_thread_stats_t thread_stats;
+            audio_driver_state_t *audio_st = audio_state_get_ptr();
+            if (     __len < sizeof(video_info.stat_text)
+                  && audio_thread_get_stats(audio_st->current_audio,
+                     audio_st->context_audio_data, &thread_stats))
+            {
+               unsigned i;
+               size_t drains = 0;
+               for (i = 0; i < AUDIO_THREAD_FILL_BUCKETS; i++)
+                  drains += thread_stats.fill[i];
+               if (!drains)
+                  drains = 1;
+               /* TODO/FIXME - localize */
+               __len += snprintf(video_info.stat_text + __len,
+                     sizeof(video_info.stat_text) - __len,
+                     " Thread Ring: %5u KB\n"
+                     " - Underruns: %6u\n"
+                     " - Overruns:  %6u\n"
+                     " - Fill %%:",
+                     (unsigned)(thread_stats.capacity / 1024),
+                     (unsigned)thread_stats.underruns,
+                     (unsigned)thread_stats.overruns);
+               for (i = 0; i < AUDIO_THREAD_FILL_BUCKETS
+                     && __len < sizeof(video_info.stat_text); i++)
+                  __len += snprintf(video_info.stat_text + __len,
+                        sizeof(video_info.stat_text) - __len, " %u",
+                        (unsigned)(100 * thread_stats.fill[i] / drains));
+               if (__len < sizeof(video_info.stat_text))
+                  __len += strlcpy(video_info.stat_text + __len, "\n",
+                        sizeof(video_info.stat_text) - __len);
+            }
+         }
+#endif
+
          /* TODO/FIXME - localize */
          __len += strlcpy(video_info.stat_text + __len, "LATENCY\n",
                sizeof(video_info.stat_text) - __len);
@@ -5015,6 +5261,27 @@ void video_driver_frame(const void *data, unsigned width,
                " Core:        %5.2f ms\n",
                runloop_st->core_run_time / 1000.0f);
 
+#ifdef HAVE_VIDEO_FILTER
+         if (video_st->state_filter && settings->bools.video_filter_enable)
+         {
+            __len += snprintf(video_info.stat_text + __len, sizeof(video_info.stat_text) - __len,
+                  " Softfilter:  %5.2f ms\n",
+                  (video_st->state_pipe
+                   ? video_st->state_pipe->filter_time
+                   : rarch_softfilter_get_process_time(video_st->state_filter))
+                  / 1000.0f);
+
+            /* The filter runs alongside the core instead, but what
+             * is on screen is a frame older for it. */
+            if (video_st->state_pipe)
+               __len += snprintf(video_info.stat_text + __len, sizeof(video_info.stat_text) - __len,
+                     " - Pipelined: %2u frame\n"
+                     " - Wait:      %5.2f ms\n",
+                     VIDEO_FILTER_PIPE_FRAMES - 1,
+                     video_st->state_pipe->wait_time / 1000.0f);
+         }
+#endif
+
          if (video_info.scanline_sync)
             __len += snprintf(video_info.stat_text + __len, sizeof(video_info.stat_text) - __len,
                   " Scanline:    %5d\n",
@@ -5047,6 +5314,14 @@ void video_driver_frame(const void *data, unsigned width,
                   " - Preemptive Frames\n",
                   video_info.runahead_frames);
 
+#ifdef HAVE_RUNAHEAD
+         if (     (video_info.runahead || video_info.preemptive_frames)
+               && __len < sizeof(video_info.stat_text))
+            __len += runahead_stats_print(runloop_st,
+                  video_info.stat_text + __len,
+                  sizeof(video_info.stat_text) - __len);
+#endif
+
          /* Tracked length of stat_text; consumed by driver frame()
           * callbacks instead of strlen on every frame. */
          video_info.stat_text_len = __len;
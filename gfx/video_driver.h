@@ -809,6 +809,7 @@ typedef struct
 #ifdef HAVE_VIDEO_FILTER
    rarch_softfilter_t *state_filter;
    void               *state_buffer;
+   struct video_filter_pipe *state_pipe;
 #endif
    void *data;
    video_driver_t *current_video;
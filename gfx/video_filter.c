@@ -36,6 +36,20 @@
 #include "video_filter.h"
 #include "video_filters/softfilter.h"
 
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#include <retro_atomic.h>
+
+#if defined(RETRO_ATOMIC_LOCK_FREE)
+#define SOFTFILTER_HAVE_POOL
+#endif
+#endif
+
+/* Filters that can split a frame are asked for this many row slices
+ * per thread, so a thread that falls behind leaves its share to the
+ * others instead of holding up the whole frame. */
+#define SOFTFILTER_SLICES_PER_THREAD 4
+
 struct rarch_soft_plug
 {
 #ifdef HAVE_DYLIB
@@ -58,51 +72,369 @@ struct rarch_softfilter
    enum retro_pixel_format pix_fmt, out_pix_fmt;
 
    struct softfilter_work_packet *packets;
+   unsigned num_packets;
    unsigned threads;
 
+#ifdef SOFTFILTER_HAVE_POOL
+   struct softfilter_pool *pool;
+#endif
 #ifdef HAVE_THREADS
-   struct filter_thread_data *thread_data;
+   struct softfilter_async *async;
 #endif
+
+   retro_time_t process_time;
 };
 
-#ifdef HAVE_THREADS
-#include <rthreads/rthreads.h>
+#ifdef SOFTFILTER_HAVE_POOL
+/* Waits poll this many times before parking on a condition
+ * variable, unless there are not enough cores to go round. */
+#define SOFTFILTER_POOL_SPINS 2048
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define SOFTFILTER_POOL_RELAX() __asm__ __volatile__("pause")
+#elif defined(__GNUC__) && (defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7))
+#define SOFTFILTER_POOL_RELAX() __asm__ __volatile__("yield")
+#else
+#define SOFTFILTER_POOL_RELAX() ((void)0)
+#endif
 
-struct filter_thread_data
+/* One set of helper threads per filter chain.  Every frame is a
+ * generation: the caller publishes the packets, bumps 'generation'
+ * and then works through the packets itself alongside the helpers,
+ * each side claiming the next packet from 'next'.  Waits spin for
+ * a while before they park, so that back-to-back frames need not
+ * go through the scheduler at all. */
+struct softfilter_pool
 {
-   sthread_t *thread;
-   const struct softfilter_work_packet *packet;
-   scond_t *cond;
+   sthread_t **workers;
+   unsigned num_workers;
+   unsigned spins;                  /* 0 with more threads than cores */
+
    slock_t *lock;
+   scond_t *wake;                   /* generation moved, or die */
+   scond_t *idle;                   /* remaining or active hit zero */
+   unsigned sleepers;               /* workers parked on wake */
+
+   const struct softfilter_work_packet *packets;
    void *userdata;
+   unsigned num_packets;
+
+   retro_atomic_int_t generation;
+   retro_atomic_int_t next;         /* next packet to claim */
+   retro_atomic_int_t remaining;    /* packets not yet finished */
+   retro_atomic_int_t active;       /* workers still in the generation */
+   retro_atomic_int_t die;
+};
+
+static void softfilter_pool_signal_idle(struct softfilter_pool *pool)
+{
+   slock_lock(pool->lock);
+   scond_broadcast(pool->idle);
+   slock_unlock(pool->lock);
+}
+
+static void softfilter_pool_run(struct softfilter_pool *pool)
+{
+   for (;;)
+   {
+      const struct softfilter_work_packet *packet;
+      int i = retro_atomic_fetch_add_int(&pool->next, 1);
+      if (i >= (int)pool->num_packets)
+         break;
+
+      packet = &pool->packets[i];
+      if (packet->work)
+         packet->work(pool->userdata, packet->thread_data);
+
+      if (retro_atomic_fetch_sub_int(&pool->remaining, 1) == 1)
+         softfilter_pool_signal_idle(pool);
+   }
+}
+
+/* Waits for *counter to drop to zero. */
+static void softfilter_pool_wait_idle(struct softfilter_pool *pool,
+      retro_atomic_int_t *counter)
+{
+   unsigned spins;
+
+   for (spins = 0; spins < pool->spins; spins++)
+   {
+      if (!retro_atomic_load_acquire_int(counter))
+         return;
+      SOFTFILTER_POOL_RELAX();
+   }
+
+   slock_lock(pool->lock);
+   while (retro_atomic_load_acquire_int(counter))
+      scond_wait(pool->idle, pool->lock);
+   slock_unlock(pool->lock);
+}
+
+static void softfilter_pool_worker(void *data)
+{
+   struct softfilter_pool *pool = (struct softfilter_pool*)data;
+   /* Not the current generation: the first frame may already have
+    * been published by the time this thread gets going. */
+   int seen                     = 0;
+
+   for (;;)
+   {
+      unsigned spins;
+      int generation = seen;
+
+      for (spins = 0; spins < pool->spins; spins++)
+      {
+         if ((generation = retro_atomic_load_acquire_int(
+                     &pool->generation)) != seen)
+            break;
+         SOFTFILTER_POOL_RELAX();
+      }
+
+      if (generation == seen)
+      {
+         slock_lock(pool->lock);
+         while ((generation = retro_atomic_load_acquire_int(
+                     &pool->generation)) == seen)
+         {
+            pool->sleepers++;
+            scond_wait(pool->wake, pool->lock);
+            pool->sleepers--;
+         }
+         slock_unlock(pool->lock);
+      }
+
+      if (retro_atomic_load_acquire_int(&pool->die))
+         break;
+
+      seen = generation;
+      softfilter_pool_run(pool);
+
+      if (retro_atomic_fetch_sub_int(&pool->active, 1) == 1)
+         softfilter_pool_signal_idle(pool);
+   }
+}
+
+static void softfilter_pool_free(struct softfilter_pool *pool)
+{
+   unsigned i;
+
+   if (!pool)
+      return;
+
+   if (pool->lock)
+   {
+      retro_atomic_store_release_int(&pool->die, 1);
+      slock_lock(pool->lock);
+      retro_atomic_fetch_add_int(&pool->generation, 1);
+      scond_broadcast(pool->wake);
+      slock_unlock(pool->lock);
+   }
+
+   for (i = 0; i < pool->num_workers; i++)
+      sthread_join(pool->workers[i]);
+
+   if (pool->wake)
+      scond_free(pool->wake);
+   if (pool->idle)
+      scond_free(pool->idle);
+   if (pool->lock)
+      slock_free(pool->lock);
+   free(pool->workers);
+   free(pool);
+}
+
+static struct softfilter_pool *softfilter_pool_new(unsigned num_workers)
+{
+   struct softfilter_pool *pool = (struct softfilter_pool*)
+      calloc(1, sizeof(*pool));
+   if (!pool)
+      return NULL;
+
+   retro_atomic_int_init(&pool->generation, 0);
+   retro_atomic_int_init(&pool->next, 0);
+   retro_atomic_int_init(&pool->remaining, 0);
+   retro_atomic_int_init(&pool->active, 0);
+   retro_atomic_int_init(&pool->die, 0);
+
+   /* A spinning thread would only take time from the one it is
+    * waiting for if they had to share a core. */
+   if (cpu_features_get_core_amount() > num_workers)
+      pool->spins = SOFTFILTER_POOL_SPINS;
+
+   if (     !(pool->workers = (sthread_t**)
+            calloc(num_workers, sizeof(*pool->workers)))
+         || !(pool->lock    = slock_new())
+         || !(pool->wake    = scond_new())
+         || !(pool->idle    = scond_new()))
+      goto error;
+
+   for (; pool->num_workers < num_workers; pool->num_workers++)
+   {
+      if (!(pool->workers[pool->num_workers] = sthread_create(
+               softfilter_pool_worker, pool)))
+         goto error;
+   }
+
+   return pool;
+
+error:
+   softfilter_pool_free(pool);
+   return NULL;
+}
+
+static void softfilter_pool_process(struct softfilter_pool *pool,
+      const struct softfilter_work_packet *packets, unsigned num_packets,
+      void *userdata)
+{
+   /* Workers left over from the previous frame may still be on
+    * their way out of it; normally they are long gone. */
+   softfilter_pool_wait_idle(pool, &pool->active);
+
+   pool->packets     = packets;
+   pool->num_packets = num_packets;
+   pool->userdata    = userdata;
+   retro_atomic_store_release_int(&pool->next, 0);
+   retro_atomic_store_release_int(&pool->remaining, (int)num_packets);
+   retro_atomic_store_release_int(&pool->active, (int)pool->num_workers);
+
+   slock_lock(pool->lock);
+   retro_atomic_fetch_add_int(&pool->generation, 1);
+   if (pool->sleepers)
+      scond_broadcast(pool->wake);
+   slock_unlock(pool->lock);
+
+   softfilter_pool_run(pool);
+   softfilter_pool_wait_idle(pool, &pool->remaining);
+}
+#endif
+
+#ifdef HAVE_THREADS
+/* Runs frames for rarch_softfilter_process_async() on a thread of
+ * its own, which then takes the caller's place in the pool, so that
+ * the caller can go back to running the core.  One frame at a time:
+ * 'pending' is set by the caller and cleared here once the frame is
+ * written out. */
+struct softfilter_async
+{
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+
+   void *output;
+   const void *input;
+   size_t output_stride;
+   size_t input_stride;
+   unsigned width;
+   unsigned height;
+
+   bool pending;
    bool die;
-   bool done;
 };
+#endif
+
+static void softfilter_run_packets(rarch_softfilter_t *filt)
+{
+   unsigned i;
 
-static void filter_thread_loop(void *data)
+#ifdef SOFTFILTER_HAVE_POOL
+   if (filt->pool)
+   {
+      softfilter_pool_process(filt->pool, filt->packets,
+            filt->num_packets, filt->impl_data);
+      return;
+   }
+#endif
+
+   for (i = 0; i < filt->num_packets; i++)
+      filt->packets[i].work(filt->impl_data, filt->packets[i].thread_data);
+}
+
+static void softfilter_process_frame(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height,
+      size_t input_stride)
+{
+   retro_time_t start = cpu_features_get_time_usec();
+
+   if (filt->impl && filt->impl->get_work_packets)
+      filt->impl->get_work_packets(filt->impl_data, filt->packets,
+            output, output_stride, input, width, height, input_stride);
+
+   softfilter_run_packets(filt);
+
+   filt->process_time = cpu_features_get_time_usec() - start;
+}
+
+#ifdef HAVE_THREADS
+static void softfilter_async_thread(void *data)
 {
-   struct filter_thread_data *thr = (struct filter_thread_data*)data;
+   rarch_softfilter_t       *filt  = (rarch_softfilter_t*)data;
+   struct softfilter_async  *async = filt->async;
 
+   slock_lock(async->lock);
    for (;;)
    {
-      bool die;
-      slock_lock(thr->lock);
-      while (thr->done && !thr->die)
-         scond_wait(thr->cond, thr->lock);
-      die = thr->die;
-      slock_unlock(thr->lock);
-
-      if (die)
+      while (!async->pending && !async->die)
+         scond_wait(async->cond, async->lock);
+      if (async->die)
          break;
 
-      if (thr->packet && thr->packet->work)
-         thr->packet->work(thr->userdata, thr->packet->thread_data);
+      slock_unlock(async->lock);
+      softfilter_process_frame(filt,
+            async->output, async->output_stride,
+            async->input, async->width, async->height,
+            async->input_stride);
+      slock_lock(async->lock);
+
+      async->pending = false;
+      scond_broadcast(async->cond);
+   }
+   slock_unlock(async->lock);
+}
+
+static void softfilter_async_free(rarch_softfilter_t *filt)
+{
+   struct softfilter_async *async = filt->async;
+
+   if (!async)
+      return;
+
+   if (async->thread)
+   {
+      slock_lock(async->lock);
+      while (async->pending)
+         scond_wait(async->cond, async->lock);
+      async->die = true;
+      scond_broadcast(async->cond);
+      slock_unlock(async->lock);
+      sthread_join(async->thread);
+   }
+
+   if (async->cond)
+      scond_free(async->cond);
+   if (async->lock)
+      slock_free(async->lock);
+   free(async);
+   filt->async = NULL;
+}
+
+static bool softfilter_async_init(rarch_softfilter_t *filt)
+{
+   struct softfilter_async *async = (struct softfilter_async*)
+      calloc(1, sizeof(*async));
+
+   if (!(filt->async = async))
+      return false;
 
-      slock_lock(thr->lock);
-      thr->done = true;
-      scond_signal(thr->cond);
-      slock_unlock(thr->lock);
+   if (     !(async->lock   = slock_new())
+         || !(async->cond   = scond_new())
+         || !(async->thread = sthread_create(softfilter_async_thread, filt)))
+   {
+      softfilter_async_free(filt);
+      return false;
    }
+
+   return true;
 }
 #endif
 
@@ -136,7 +468,7 @@ static bool create_softfilter_graph(rarch_softfilter_t *filt,
       softfilter_simd_mask_t cpu_features,
       unsigned threads)
 {
-   unsigned input_fmts, input_fmt, output_fmts;
+   unsigned input_fmts, input_fmt, output_fmts, slices;
    struct config_file_userdata userdata;
    char key[64], name[64];
    name[0] = '\0';
@@ -204,58 +536,55 @@ static bool create_softfilter_graph(rarch_softfilter_t *filt,
    filt->max_width = max_width;
    filt->max_height = max_height;
 
+   if (threads == RARCH_SOFTFILTER_THREADS_AUTO)
+      threads = cpu_features_get_core_amount();
+#ifdef SOFTFILTER_HAVE_POOL
+   slices = threads > 1 ? threads * SOFTFILTER_SLICES_PER_THREAD : 1;
+#else
+   /* Packets would only run one after another anyway. */
+   threads = 1;
+   slices  = 1;
+#endif
+
    filt->impl_data = filt->impl->create(
          &softfilter_config, input_fmt, input_fmt, max_width, max_height,
-         threads != RARCH_SOFTFILTER_THREADS_AUTO ? threads :
-         cpu_features_get_core_amount(), cpu_features,
-         &userdata);
+         slices, cpu_features, &userdata);
    if (!filt->impl_data)
    {
       RARCH_ERR("[SoftFilter] Failed to create softfilter state.\n");
       return false;
    }
 
-   threads = filt->impl->query_num_threads(filt->impl_data);
-   if (!threads)
+   /* Filters report how many packets they split a frame into,
+    * which may well be fewer than they were offered. */
+   slices = filt->impl->query_num_threads(filt->impl_data);
+   if (!slices)
    {
       RARCH_ERR("[SoftFilter] Invalid number of threads.\n");
       return false;
    }
 
-   filt->threads = threads;
-   RARCH_LOG("[SoftFilter] Using %u threads for softfilter.\n", threads);
+   filt->num_packets = slices;
+   filt->threads     = MIN(threads, slices);
+   RARCH_LOG("[SoftFilter] Using %u threads and %u slices for softfilter.\n",
+         filt->threads, slices);
 
    filt->packets = (struct softfilter_work_packet*)
-      calloc(threads, sizeof(*filt->packets));
+      calloc(slices, sizeof(*filt->packets));
    if (!filt->packets)
    {
       RARCH_ERR("[SoftFilter] Failed to allocate softfilter packets.\n");
       return false;
    }
 
-#ifdef HAVE_THREADS
+#ifdef SOFTFILTER_HAVE_POOL
+   /* The thread calling rarch_softfilter_process() is the last one. */
    if (filt->threads > 1)
    {
-      unsigned i;
-      if (!(filt->thread_data = (struct filter_thread_data*)
-         calloc(threads, sizeof(*filt->thread_data))))
-         return false;
-
-      for (i = 0; i < threads; i++)
+      if (!(filt->pool = softfilter_pool_new(filt->threads - 1)))
       {
-         filt->thread_data[i].userdata = filt->impl_data;
-         filt->thread_data[i].done     = true;
-
-         filt->thread_data[i].lock     = slock_new();
-         if (!filt->thread_data[i].lock)
-            return false;
-         filt->thread_data[i].cond     = scond_new();
-         if (!filt->thread_data[i].cond)
-            return false;
-         filt->thread_data[i].thread   = sthread_create(
-               filter_thread_loop, &filt->thread_data[i]);
-         if (!filt->thread_data[i].thread)
-            return false;
+         RARCH_ERR("[SoftFilter] Failed to start softfilter threads.\n");
+         return false;
       }
    }
 #endif
@@ -483,6 +812,13 @@ void rarch_softfilter_free(rarch_softfilter_t *filt)
    if (!filt)
       return;
 
+#ifdef HAVE_THREADS
+   softfilter_async_free(filt);
+#endif
+#ifdef SOFTFILTER_HAVE_POOL
+   softfilter_pool_free(filt->pool);
+#endif
+
    free(filt->packets);
    if (filt->impl && filt->impl_data)
       filt->impl->destroy(filt->impl_data);
@@ -496,25 +832,6 @@ void rarch_softfilter_free(rarch_softfilter_t *filt)
    free(filt->plugs);
 #endif
 
-#ifdef HAVE_THREADS
-   if (filt->threads > 1)
-   {
-      for (i = 0; i < filt->threads; i++)
-      {
-         if (!filt->thread_data[i].thread)
-            continue;
-         slock_lock(filt->thread_data[i].lock);
-         filt->thread_data[i].die = true;
-         scond_signal(filt->thread_data[i].cond);
-         slock_unlock(filt->thread_data[i].lock);
-         sthread_join(filt->thread_data[i].thread);
-         slock_free(filt->thread_data[i].lock);
-         scond_free(filt->thread_data[i].cond);
-      }
-      free(filt->thread_data);
-   }
-#endif
-
    if (filt->conf)
       config_file_free(filt->conf);
 
@@ -548,40 +865,72 @@ void rarch_softfilter_process(rarch_softfilter_t *filt,
       const void *input, unsigned width, unsigned height,
       size_t input_stride)
 {
-   unsigned i;
-
    if (!filt)
       return;
 
-   if (filt->impl && filt->impl->get_work_packets)
-      filt->impl->get_work_packets(filt->impl_data, filt->packets,
-            output, output_stride, input, width, height, input_stride);
+   /* The packets and the pool belong to whoever runs the frame. */
+   rarch_softfilter_wait(filt);
+   softfilter_process_frame(filt, output, output_stride,
+         input, width, height, input_stride);
+}
 
+bool rarch_softfilter_process_async(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height,
+      size_t input_stride)
+{
 #ifdef HAVE_THREADS
-   if (filt->threads > 1)
+   struct softfilter_async *async;
+
+   if (!filt)
+      return false;
+
+   rarch_softfilter_wait(filt);
+
+   if (!filt->async && !softfilter_async_init(filt))
    {
-      /* Fire off workers */
-      for (i = 0; i < filt->threads; i++)
-      {
-         filt->thread_data[i].packet = &filt->packets[i];
-         slock_lock(filt->thread_data[i].lock);
-         filt->thread_data[i].done = false;
-         scond_signal(filt->thread_data[i].cond);
-         slock_unlock(filt->thread_data[i].lock);
-      }
+      RARCH_WARN("[SoftFilter] Failed to start softfilter thread, "
+            "filtering in the foreground.\n");
+      softfilter_process_frame(filt, output, output_stride,
+            input, width, height, input_stride);
+      return false;
+   }
 
-      /* Wait for workers */
-      for (i = 0; i < filt->threads; i++)
-      {
-         slock_lock(filt->thread_data[i].lock);
-         while (!filt->thread_data[i].done)
-            scond_wait(filt->thread_data[i].cond, filt->thread_data[i].lock);
-         slock_unlock(filt->thread_data[i].lock);
-      }
+   async                = filt->async;
+   slock_lock(async->lock);
+   async->output        = output;
+   async->output_stride = output_stride;
+   async->input         = input;
+   async->width         = width;
+   async->height        = height;
+   async->input_stride  = input_stride;
+   async->pending       = true;
+   scond_broadcast(async->cond);
+   slock_unlock(async->lock);
+   return true;
+#else
+   rarch_softfilter_process(filt, output, output_stride,
+         input, width, height, input_stride);
+   return false;
+#endif
+}
+
+void rarch_softfilter_wait(rarch_softfilter_t *filt)
+{
+#ifdef HAVE_THREADS
+   struct softfilter_async *async = filt ? filt->async : NULL;
+
+   if (!async)
       return;
-   }
+
+   slock_lock(async->lock);
+   while (async->pending)
+      scond_wait(async->cond, async->lock);
+   slock_unlock(async->lock);
 #endif
+}
 
-   for (i = 0; i < filt->threads; i++)
-      filt->packets[i].work(filt->impl_data, filt->packets[i].thread_data);
+retro_time_t rarch_softfilter_get_process_time(rarch_softfilter_t *filt)
+{
+   return filt ? filt->process_time : 0;
 }
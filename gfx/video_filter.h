@@ -19,6 +19,7 @@
 
 #include <stddef.h>
 
+#include <boolean.h>
 #include <libretro.h>
 #include <retro_common_api.h>
 
@@ -50,6 +51,23 @@ void rarch_softfilter_process(rarch_softfilter_t *filt,
       void *output, size_t output_stride,
       const void *input, unsigned width, unsigned height, size_t input_stride);
 
+/* Starts filtering a frame on a thread of the filter's own and
+ * returns straight away; 'input' and 'output' have to stay put until
+ * rarch_softfilter_wait() has returned.  Only one frame is in flight
+ * at a time, so this waits for the previous one first.  Returns false
+ * if the frame had to be filtered before returning after all. */
+bool rarch_softfilter_process_async(rarch_softfilter_t *filt,
+      void *output, size_t output_stride,
+      const void *input, unsigned width, unsigned height, size_t input_stride);
+
+/* Waits for the frame started by rarch_softfilter_process_async(),
+ * if there is one. */
+void rarch_softfilter_wait(rarch_softfilter_t *filt);
+
+/* Microseconds it took to filter the last frame, wherever it ran.
+ * Not to be called with a frame in flight. */
+retro_time_t rarch_softfilter_get_process_time(rarch_softfilter_t *filt);
+
 const char *rarch_softfilter_get_name(void *data);
 
 RETRO_END_DECLS
@@ -34,6 +34,7 @@
 */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -60,16 +61,70 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels copy the run of blocks from 'in' on where no
+ * rotation of FILTRO would touch a pixel, and return its length.
+ * The scalar code takes the block after that. */
+typedef unsigned (*twoxbr_flat_rgb565_t)(uint16_t *out, unsigned dst_stride,
+      const uint16_t *in, unsigned nextline, unsigned width);
+typedef unsigned (*twoxbr_flat_xrgb8888_t)(uint32_t *out, unsigned dst_stride,
+      const uint32_t *in, unsigned nextline, unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   twoxbr_flat_rgb565_t flat_rgb565;
+   twoxbr_flat_xrgb8888_t flat_xrgb8888;
+   unsigned simd_bytes;
    uint16_t RGBtoYUV[65536];
    uint16_t tbl_5_to_8[32];
    uint16_t tbl_6_to_8[64];
 };
 
+/* Each FILTRO rotation only does anything when PE differs from both
+ * of its two edge neighbours, so a block where that holds for none
+ * of the four comes out as PE four times over. */
+#define twoxbr_simd_flat(isa, bits, type) \
+static SOFTFILTER_TARGET_##isa unsigned twoxbr_flat_##isa##_##bits( \
+      type *out, unsigned dst_stride, const type *in, \
+      unsigned nextline, unsigned width) \
+{ \
+   const unsigned n = sizeof(sf_##isa##_t) / sizeof(type); \
+   unsigned x       = 0; \
+   for (; x + n <= width; x += n) \
+   { \
+      sf_##isa##_t lo, hi; \
+      sf_##isa##_t PE = sf_##isa##_load(in + x); \
+      sf_##isa##_t eB = sf_##isa##_eq##bits(PE, sf_##isa##_load(in + x - nextline)); \
+      sf_##isa##_t eD = sf_##isa##_eq##bits(PE, sf_##isa##_load(in + x - 1)); \
+      sf_##isa##_t eF = sf_##isa##_eq##bits(PE, sf_##isa##_load(in + x + 1)); \
+      sf_##isa##_t eH = sf_##isa##_eq##bits(PE, sf_##isa##_load(in + x + nextline)); \
+      /* Some rotation has both neighbours different unless every \
+       * pair of adjacent ones has one that is equal. */ \
+      if (sf_##isa##_any(sf_##isa##_xor(sf_##isa##_and( \
+                  sf_##isa##_and(sf_##isa##_or(eH, eF), sf_##isa##_or(eF, eB)), \
+                  sf_##isa##_and(sf_##isa##_or(eB, eD), sf_##isa##_or(eD, eH))), \
+               sf_##isa##_eq##bits(PE, PE)))) \
+         break; \
+      sf_##isa##_zip##bits(PE, PE, &lo, &hi); \
+      sf_##isa##_store(out + 2 * x,                  lo); \
+      sf_##isa##_store(out + 2 * x + n,              hi); \
+      sf_##isa##_store(out + dst_stride + 2 * x,     lo); \
+      sf_##isa##_store(out + dst_stride + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+twoxbr_simd_flat(sse2, 16, uint16_t)
+twoxbr_simd_flat(sse2, 32, uint32_t)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+twoxbr_simd_flat(avx2, 16, uint16_t)
+twoxbr_simd_flat(avx2, 32, uint32_t)
+#endif
+
 static unsigned twoxbr_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_RGB565 | SOFTFILTER_FMT_XRGB8888;
@@ -226,7 +281,6 @@ static void *twoxbr_generic_create(const struct softfilter_config *config,
       unsigned threads, softfilter_simd_mask_t simd, void *userdata)
 {
    struct filter_data *filt = (struct filter_data*)calloc(1, sizeof(*filt));
-   (void)simd;
    (void)config;
    (void)userdata;
    if (!filt)
@@ -243,6 +297,23 @@ static void *twoxbr_generic_create(const struct softfilter_config *config,
 
    SetupFormat(filt);
 
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+   {
+      filt->flat_rgb565   = twoxbr_flat_sse2_16;
+      filt->flat_xrgb8888 = twoxbr_flat_sse2_32;
+      filt->simd_bytes    = SF_SSE2_BYTES;
+   }
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+   {
+      filt->flat_rgb565   = twoxbr_flat_avx2_16;
+      filt->flat_xrgb8888 = twoxbr_flat_avx2_32;
+      filt->simd_bytes    = SF_AVX2_BYTES;
+   }
+#endif
+
    return filt;
 }
 
@@ -556,41 +627,59 @@ static void twoxbr_generic_xrgb8888(void *data, unsigned width, unsigned height,
       uint32_t *in  = (uint32_t*)src;
       uint32_t *out = (uint32_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      for (finish = width; finish; )
       {
-         uint32_t E[4];
-         uint32_t ex, e, i, ke, ki, ex2, ex3, px;
-         uint32_t A1 = *(in - nextline - nextline - 1);
-         uint32_t B1 = *(in - nextline - nextline);
-         uint32_t C1 = *(in - nextline - nextline + 1);
-         uint32_t A0 = *(in - nextline - 2);
-         uint32_t PA = *(in - nextline - 1);
-         uint32_t PB = *(in - nextline);
-         uint32_t PC = *(in - nextline + 1);
-         uint32_t C4 = *(in - nextline + 2);
-         uint32_t D0 = *(in - 2);
-         uint32_t PD = *(in - 1);
-         uint32_t PE = *(in);
-         uint32_t PF = *(in + 1);
-         uint32_t F4 = *(in + 2);
-         uint32_t G0 = *(in + nextline - 2);
-         uint32_t PG = *(in + nextline - 1);
-         uint32_t PH = *(in + nextline);
-         uint32_t _PI = *(in + nextline + 1);
-         uint32_t I4 = *(in + nextline + 2);
-         uint32_t G5 = *(in + nextline + nextline - 1);
-         uint32_t H5 = *(in + nextline + nextline);
-         uint32_t I5 = *(in + nextline + nextline + 1);
-
-         /*
-          * Map of the pixels:          A1 B1 C1
-          *                          A0 PA PB PC C4
-          *                          D0 PD PE PF F4
-          *                          G0 PG PH _PI I4
-          *                             G5 H5 I5
-          */
-
-         twoxbr_function(FILTRO_RGB8888, filt);
+         /* Pixels left to the scalar code */
+         unsigned run = finish;
+
+         if (filt->flat_xrgb8888)
+         {
+            unsigned x = filt->flat_xrgb8888(out, dst_stride,
+                  in, nextline, finish);
+            in        += x;
+            out       += 2 * x;
+            finish    -= x;
+            run        = filt->simd_bytes / sizeof(uint32_t);
+            if (run > finish)
+               run     = finish;
+         }
+
+         for (; run; run--, finish--)
+         {
+            uint32_t E[4];
+            uint32_t ex, e, i, ke, ki, ex2, ex3, px;
+            uint32_t A1 = *(in - nextline - nextline - 1);
+            uint32_t B1 = *(in - nextline - nextline);
+            uint32_t C1 = *(in - nextline - nextline + 1);
+            uint32_t A0 = *(in - nextline - 2);
+            uint32_t PA = *(in - nextline - 1);
+            uint32_t PB = *(in - nextline);
+            uint32_t PC = *(in - nextline + 1);
+            uint32_t C4 = *(in - nextline + 2);
+            uint32_t D0 = *(in - 2);
+            uint32_t PD = *(in - 1);
+            uint32_t PE = *(in);
+            uint32_t PF = *(in + 1);
+            uint32_t F4 = *(in + 2);
+            uint32_t G0 = *(in + nextline - 2);
+            uint32_t PG = *(in + nextline - 1);
+            uint32_t PH = *(in + nextline);
+            uint32_t _PI = *(in + nextline + 1);
+            uint32_t I4 = *(in + nextline + 2);
+            uint32_t G5 = *(in + nextline + nextline - 1);
+            uint32_t H5 = *(in + nextline + nextline);
+            uint32_t I5 = *(in + nextline + nextline + 1);
+
+            /*
+             * Map of the pixels:          A1 B1 C1
+             *                          A0 PA PB PC C4
+             *                          D0 PD PE PF F4
+             *                          G0 PG PH _PI I4
+             *                             G5 H5 I5
+             */
+
+            twoxbr_function(FILTRO_RGB8888, filt);
+         }
       }
 
       src += src_stride;
@@ -615,41 +704,59 @@ static void twoxbr_generic_rgb565(void *data, unsigned width, unsigned height,
       uint16_t *in  = (uint16_t*)src;
       uint16_t *out = (uint16_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      for (finish = width; finish; )
       {
-         uint16_t E[4];
-         uint16_t ex, e, i, ke, ki, ex2, ex3, px;
-         uint16_t A1 = *(in - nextline - nextline - 1);
-         uint16_t B1 = *(in - nextline - nextline);
-         uint16_t C1 = *(in - nextline - nextline + 1);
-         uint16_t A0 = *(in - nextline - 2);
-         uint16_t PA = *(in - nextline - 1);
-         uint16_t PB = *(in - nextline);
-         uint16_t PC = *(in - nextline + 1);
-         uint16_t C4 = *(in - nextline + 2);
-         uint16_t D0 = *(in - 2);
-         uint16_t PD = *(in - 1);
-         uint16_t PE = *(in);
-         uint16_t PF = *(in + 1);
-         uint16_t F4 = *(in + 2);
-         uint16_t G0 = *(in + nextline - 2);
-         uint16_t PG = *(in + nextline - 1);
-         uint16_t PH = *(in + nextline);
-         uint16_t _PI = *(in + nextline + 1);
-         uint16_t I4 = *(in + nextline + 2);
-         uint16_t G5 = *(in + nextline + nextline - 1);
-         uint16_t H5 = *(in + nextline + nextline);
-         uint16_t I5 = *(in + nextline + nextline + 1);
-
-         /*
-          * Map of the pixels:          A1 B1 C1
-          *                          A0 PA PB PC C4
-          *                          D0 PD PE PF F4
-          *                          G0 PG PH _PI I4
-          *                             G5 H5 I5
-          */
-
-         twoxbr_function(FILTRO_RGB565, filt);
+         /* Pixels left to the scalar code */
+         unsigned run = finish;
+
+         if (filt->flat_rgb565)
+         {
+            unsigned x = filt->flat_rgb565(out, dst_stride,
+                  in, nextline, finish);
+            in        += x;
+            out       += 2 * x;
+            finish    -= x;
+            run        = filt->simd_bytes / sizeof(uint16_t);
+            if (run > finish)
+               run     = finish;
+         }
+
+         for (; run; run--, finish--)
+         {
+            uint16_t E[4];
+            uint16_t ex, e, i, ke, ki, ex2, ex3, px;
+            uint16_t A1 = *(in - nextline - nextline - 1);
+            uint16_t B1 = *(in - nextline - nextline);
+            uint16_t C1 = *(in - nextline - nextline + 1);
+            uint16_t A0 = *(in - nextline - 2);
+            uint16_t PA = *(in - nextline - 1);
+            uint16_t PB = *(in - nextline);
+            uint16_t PC = *(in - nextline + 1);
+            uint16_t C4 = *(in - nextline + 2);
+            uint16_t D0 = *(in - 2);
+            uint16_t PD = *(in - 1);
+            uint16_t PE = *(in);
+            uint16_t PF = *(in + 1);
+            uint16_t F4 = *(in + 2);
+            uint16_t G0 = *(in + nextline - 2);
+            uint16_t PG = *(in + nextline - 1);
+            uint16_t PH = *(in + nextline);
+            uint16_t _PI = *(in + nextline + 1);
+            uint16_t I4 = *(in + nextline + 2);
+            uint16_t G5 = *(in + nextline + nextline - 1);
+            uint16_t H5 = *(in + nextline + nextline);
+            uint16_t I5 = *(in + nextline + nextline + 1);
+
+            /*
+             * Map of the pixels:          A1 B1 C1
+             *                          A0 PA PB PC C4
+             *                          D0 PD PE PF F4
+             *                          G0 PG PH _PI I4
+             *                             G5 H5 I5
+             */
+
+            twoxbr_function(FILTRO_RGB565, filt);
+         }
       }
 
       src += src_stride;
@@ -15,6 +15,7 @@
  */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,13 +40,155 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels fill whole blocks of a row from x = 0
+ * and return how many pixels they did. */
+typedef unsigned (*twoxsai_row_rgb565_t)(uint16_t *out, unsigned dst_stride,
+      const uint16_t *in, unsigned nextline, unsigned width);
+typedef unsigned (*twoxsai_row_xrgb8888_t)(uint32_t *out, unsigned dst_stride,
+      const uint32_t *in, unsigned nextline, unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   twoxsai_row_rgb565_t row_rgb565;
+   twoxsai_row_xrgb8888_t row_xrgb8888;
 };
 
+/* twoxsai_function() with every branch worked out for the whole
+ * vector and the results picked per lane.  The interpolations fit in
+ * a lane, so they come out exactly as the scalar ones do.
+ *
+ * twoxsai_result(A, B, C, D) is (B == C && B == D) - (A == C && A == D)
+ * written the other way round, and with all-ones for true the vector
+ * difference of the two masks is that same number. */
+#define twoxsai_simd_interpolate(isa, bits, A, B, hi, lo) \
+   sf_##isa##_add##bits(sf_##isa##_add##bits( \
+      sf_##isa##_srl##bits(sf_##isa##_and(A, hi), 1), \
+      sf_##isa##_srl##bits(sf_##isa##_and(B, hi), 1)), \
+      sf_##isa##_and(sf_##isa##_and(A, B), lo))
+
+#define twoxsai_simd_interpolate2(isa, bits, A, B, C, D, hi, lo) \
+   sf_##isa##_add##bits(sf_##isa##_add##bits( \
+      sf_##isa##_add##bits( \
+         sf_##isa##_srl##bits(sf_##isa##_and(A, hi), 2), \
+         sf_##isa##_srl##bits(sf_##isa##_and(B, hi), 2)), \
+      sf_##isa##_add##bits( \
+         sf_##isa##_srl##bits(sf_##isa##_and(C, hi), 2), \
+         sf_##isa##_srl##bits(sf_##isa##_and(D, hi), 2))), \
+      sf_##isa##_and(sf_##isa##_srl##bits(sf_##isa##_add##bits( \
+         sf_##isa##_add##bits(sf_##isa##_and(A, lo), sf_##isa##_and(B, lo)), \
+         sf_##isa##_add##bits(sf_##isa##_and(C, lo), sf_##isa##_and(D, lo))), 2), lo))
+
+/* Both equal to X */
+#define twoxsai_simd_eq2(isa, bits, X, Y, Z) \
+   sf_##isa##_and(sf_##isa##_eq##bits(X, Y), sf_##isa##_eq##bits(X, Z))
+
+#define twoxsai_simd_row(isa, bits, type, hi1, lo1, hi2, lo2) \
+static SOFTFILTER_TARGET_##isa unsigned twoxsai_row_##isa##_##bits( \
+      type *out, unsigned dst_stride, const type *in, \
+      unsigned nextline, unsigned width) \
+{ \
+   const unsigned n  = sizeof(sf_##isa##_t) / sizeof(type); \
+   sf_##isa##_t mhi1 = sf_##isa##_set##bits(hi1); \
+   sf_##isa##_t mlo1 = sf_##isa##_set##bits(lo1); \
+   sf_##isa##_t mhi2 = sf_##isa##_set##bits(hi2); \
+   sf_##isa##_t mlo2 = sf_##isa##_set##bits(lo2); \
+   sf_##isa##_t zero = sf_##isa##_set##bits(0); \
+   sf_##isa##_t ones = sf_##isa##_eq##bits(zero, zero); \
+   unsigned x        = 0; \
+   for (; x + n <= width; x += n) \
+   { \
+      sf_##isa##_t lo, hi, r, Pa, Pb, Qa, Qb; \
+      sf_##isa##_t case1, case2, case3, case4, sel_a, sel_b; \
+      sf_##isa##_t product, product1, product2; \
+      const type *p       = in + x; \
+      sf_##isa##_t colorI = sf_##isa##_load(p - nextline - 1); \
+      sf_##isa##_t colorE = sf_##isa##_load(p - nextline + 0); \
+      sf_##isa##_t colorF = sf_##isa##_load(p - nextline + 1); \
+      sf_##isa##_t colorJ = sf_##isa##_load(p - nextline + 2); \
+      sf_##isa##_t colorG = sf_##isa##_load(p - 1); \
+      sf_##isa##_t colorA = sf_##isa##_load(p + 0); \
+      sf_##isa##_t colorB = sf_##isa##_load(p + 1); \
+      sf_##isa##_t colorK = sf_##isa##_load(p + 2); \
+      sf_##isa##_t colorH = sf_##isa##_load(p + nextline - 1); \
+      sf_##isa##_t colorC = sf_##isa##_load(p + nextline + 0); \
+      sf_##isa##_t colorD = sf_##isa##_load(p + nextline + 1); \
+      sf_##isa##_t colorL = sf_##isa##_load(p + nextline + 2); \
+      sf_##isa##_t colorM = sf_##isa##_load(p + nextline + nextline - 1); \
+      sf_##isa##_t colorN = sf_##isa##_load(p + nextline + nextline + 0); \
+      sf_##isa##_t colorO = sf_##isa##_load(p + nextline + nextline + 1); \
+      sf_##isa##_t AD     = sf_##isa##_eq##bits(colorA, colorD); \
+      sf_##isa##_t BC     = sf_##isa##_eq##bits(colorB, colorC); \
+      sf_##isa##_t IAB    = twoxsai_simd_interpolate(isa, bits, colorA, colorB, mhi1, mlo1); \
+      sf_##isa##_t IAC    = twoxsai_simd_interpolate(isa, bits, colorA, colorC, mhi1, mlo1); \
+      sf_##isa##_t I2     = twoxsai_simd_interpolate2(isa, bits, colorA, colorB, colorC, colorD, mhi2, mlo2); \
+      case1 = sf_##isa##_andnot(AD, BC); \
+      case2 = sf_##isa##_andnot(BC, AD); \
+      case3 = sf_##isa##_and(AD, BC); \
+      case4 = sf_##isa##_xor(sf_##isa##_or(AD, BC), ones); \
+      /* The conditions shared by the A == D and the general case */ \
+      Pa    = sf_##isa##_andnot(sf_##isa##_and(twoxsai_simd_eq2(isa, bits, colorA, colorC, colorF), \
+               sf_##isa##_eq##bits(colorB, colorJ)), sf_##isa##_eq##bits(colorB, colorE)); \
+      Pb    = sf_##isa##_andnot(sf_##isa##_and(twoxsai_simd_eq2(isa, bits, colorB, colorE, colorD), \
+               sf_##isa##_eq##bits(colorA, colorI)), sf_##isa##_eq##bits(colorA, colorF)); \
+      Qa    = sf_##isa##_andnot(sf_##isa##_and(twoxsai_simd_eq2(isa, bits, colorA, colorB, colorH), \
+               sf_##isa##_eq##bits(colorC, colorM)), sf_##isa##_eq##bits(colorG, colorC)); \
+      Qb    = sf_##isa##_andnot(sf_##isa##_and(twoxsai_simd_eq2(isa, bits, colorC, colorG, colorD), \
+               sf_##isa##_eq##bits(colorA, colorI)), sf_##isa##_eq##bits(colorA, colorH)); \
+      sel_a = sf_##isa##_or( \
+            sf_##isa##_and(case1, sf_##isa##_or(Pa, sf_##isa##_and( \
+               sf_##isa##_eq##bits(colorA, colorE), sf_##isa##_eq##bits(colorB, colorL)))), \
+            sf_##isa##_and(case4, Pa)); \
+      sel_b = sf_##isa##_or( \
+            sf_##isa##_and(case2, sf_##isa##_or(Pb, sf_##isa##_and( \
+               sf_##isa##_eq##bits(colorB, colorF), sf_##isa##_eq##bits(colorA, colorH)))), \
+            sf_##isa##_andnot(sf_##isa##_and(case4, Pb), Pa)); \
+      product  = sf_##isa##_sel(sel_a, colorA, sf_##isa##_sel(sel_b, colorB, IAB)); \
+      sel_a = sf_##isa##_or( \
+            sf_##isa##_and(case1, sf_##isa##_or(Qa, sf_##isa##_and( \
+               sf_##isa##_eq##bits(colorA, colorG), sf_##isa##_eq##bits(colorC, colorO)))), \
+            sf_##isa##_and(case4, Qa)); \
+      sel_b = sf_##isa##_or( \
+            sf_##isa##_and(case2, sf_##isa##_or(Qb, sf_##isa##_and( \
+               sf_##isa##_eq##bits(colorC, colorH), sf_##isa##_eq##bits(colorA, colorF)))), \
+            sf_##isa##_andnot(sf_##isa##_and(case4, Qb), Qa)); \
+      product1 = sf_##isa##_sel(sel_a, colorA, sf_##isa##_sel(sel_b, colorC, IAC)); \
+      r     = sf_##isa##_sub##bits( \
+               twoxsai_simd_eq2(isa, bits, colorA, colorG, colorE), \
+               twoxsai_simd_eq2(isa, bits, colorB, colorG, colorE)); \
+      r     = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+               twoxsai_simd_eq2(isa, bits, colorB, colorK, colorF), \
+               twoxsai_simd_eq2(isa, bits, colorA, colorK, colorF))); \
+      r     = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+               twoxsai_simd_eq2(isa, bits, colorB, colorH, colorN), \
+               twoxsai_simd_eq2(isa, bits, colorA, colorH, colorN))); \
+      r     = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+               twoxsai_simd_eq2(isa, bits, colorA, colorL, colorO), \
+               twoxsai_simd_eq2(isa, bits, colorB, colorL, colorO))); \
+      sel_a = sf_##isa##_or(case1, sf_##isa##_and(case3, sf_##isa##_gt##bits(r, zero))); \
+      sel_b = sf_##isa##_or(case2, sf_##isa##_and(case3, sf_##isa##_gt##bits(zero, r))); \
+      product2 = sf_##isa##_sel(sel_a, colorA, sf_##isa##_sel(sel_b, colorB, I2)); \
+      sf_##isa##_zip##bits(colorA, product, &lo, &hi); \
+      sf_##isa##_store(out + 2 * x,     lo); \
+      sf_##isa##_store(out + 2 * x + n, hi); \
+      sf_##isa##_zip##bits(product1, product2, &lo, &hi); \
+      sf_##isa##_store(out + dst_stride + 2 * x,     lo); \
+      sf_##isa##_store(out + dst_stride + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+twoxsai_simd_row(sse2, 16, uint16_t, 0xF7DE, 0x0821, 0xE79C, 0x1863)
+twoxsai_simd_row(sse2, 32, uint32_t, 0xFEFEFEFE, 0x01010101, 0xFCFCFCFC, 0x03030303)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+twoxsai_simd_row(avx2, 16, uint16_t, 0xF7DE, 0x0821, 0xE79C, 0x1863)
+twoxsai_simd_row(avx2, 32, uint32_t, 0xFEFEFEFE, 0x01010101, 0xFCFCFCFC, 0x03030303)
+#endif
+
 static unsigned twoxsai_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_RGB565 | SOFTFILTER_FMT_XRGB8888;
@@ -80,6 +223,21 @@ static void *twoxsai_generic_create(const struct softfilter_config *config,
     * so force single threaded operation... */
    filt->threads = 1;
    filt->in_fmt  = in_fmt;
+
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+   {
+      filt->row_rgb565   = twoxsai_row_sse2_16;
+      filt->row_xrgb8888 = twoxsai_row_sse2_32;
+   }
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+   {
+      filt->row_rgb565   = twoxsai_row_avx2_16;
+      filt->row_xrgb8888 = twoxsai_row_avx2_32;
+   }
+#endif
    return filt;
 }
 
@@ -207,7 +365,8 @@ static void twoxsai_generic_destroy(void *data)
          out += 2
 #endif
 
-static void twoxsai_generic_xrgb8888(unsigned width, unsigned height,
+static void twoxsai_generic_xrgb8888(twoxsai_row_xrgb8888_t row,
+      unsigned width, unsigned height,
       int first, int last, uint32_t *src,
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
@@ -219,7 +378,16 @@ static void twoxsai_generic_xrgb8888(unsigned width, unsigned height,
       uint32_t *in  = (uint32_t*)src;
       uint32_t *out = (uint32_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      finish = width;
+      if (row)
+      {
+         unsigned x = row(out, dst_stride, in, nextline, width);
+         in        += x;
+         out       += 2 * x;
+         finish    -= x;
+      }
+
+      for (; finish; finish -= 1)
       {
          twoxsai_declare_variables(uint32_t, in, nextline);
 
@@ -239,7 +407,8 @@ static void twoxsai_generic_xrgb8888(unsigned width, unsigned height,
    }
 }
 
-static void twoxsai_generic_rgb565(unsigned width, unsigned height,
+static void twoxsai_generic_rgb565(twoxsai_row_rgb565_t row,
+      unsigned width, unsigned height,
       int first, int last, uint16_t *src,
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
@@ -251,7 +420,16 @@ static void twoxsai_generic_rgb565(unsigned width, unsigned height,
       uint16_t *in  = (uint16_t*)src;
       uint16_t *out = (uint16_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      finish = width;
+      if (row)
+      {
+         unsigned x = row(out, dst_stride, in, nextline, width);
+         in        += x;
+         out       += 2 * x;
+         finish    -= x;
+      }
+
+      for (; finish; finish -= 1)
       {
          twoxsai_declare_variables(uint16_t, in, nextline);
 
@@ -273,13 +451,14 @@ static void twoxsai_generic_rgb565(unsigned width, unsigned height,
 
 static void twoxsai_work_cb_rgb565(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr =
       (struct softfilter_thread_data*)thread_data;
    uint16_t *input                    = (uint16_t*)thr->in_data;
    uint16_t *output                   = (uint16_t*)thr->out_data;
    unsigned width                     = thr->width;
    unsigned height                    = thr->height;
-   twoxsai_generic_rgb565(width, height,
+   twoxsai_generic_rgb565(filt->row_rgb565, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_RGB565),
          output,
@@ -288,13 +467,14 @@ static void twoxsai_work_cb_rgb565(void *data, void *thread_data)
 
 static void twoxsai_work_cb_xrgb8888(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr =
       (struct softfilter_thread_data*)thread_data;
    uint32_t *input                    = (uint32_t*)thr->in_data;
    uint32_t *output                   = (uint32_t*)thr->out_data;
    unsigned width                     = thr->width;
    unsigned height                    = thr->height;
-   twoxsai_generic_xrgb8888(width, height,
+   twoxsai_generic_xrgb8888(filt->row_xrgb8888, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_XRGB8888),
          output,
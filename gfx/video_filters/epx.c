@@ -15,6 +15,7 @@
  */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -41,13 +42,61 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels fill the middle pixels x in [1, n) of a row
+ * and return n. */
+typedef unsigned (*epx_row_rgb565_t)(uint16_t *dst1, uint16_t *dst2,
+      const uint16_t *src, const uint16_t *up, const uint16_t *down,
+      unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   epx_row_rgb565_t row_rgb565;
 };
 
+#define epx_simd_row(isa) \
+static SOFTFILTER_TARGET_##isa unsigned epx_row_##isa( \
+      uint16_t *dst1, uint16_t *dst2, const uint16_t *src, \
+      const uint16_t *up, const uint16_t *down, unsigned width) \
+{ \
+   const unsigned n = sizeof(sf_##isa##_t) / sizeof(uint16_t); \
+   unsigned x       = 1; \
+   for (; x + n < width; x += n) \
+   { \
+      sf_##isa##_t lo, hi; \
+      sf_##isa##_t colorA = sf_##isa##_load(src + x - 1); \
+      sf_##isa##_t colorX = sf_##isa##_load(src + x); \
+      sf_##isa##_t colorC = sf_##isa##_load(src + x + 1); \
+      sf_##isa##_t colorB = sf_##isa##_load(down + x); \
+      sf_##isa##_t colorD = sf_##isa##_load(up + x); \
+      /* Lanes where every output is colorX */ \
+      sf_##isa##_t flat   = sf_##isa##_or(sf_##isa##_eq16(colorA, colorC), \
+            sf_##isa##_eq16(colorB, colorD)); \
+      sf_##isa##_zip16( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq16(colorD, colorA), flat), colorD, colorX), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq16(colorC, colorD), flat), colorC, colorX), \
+            &lo, &hi); \
+      sf_##isa##_store(dst1 + 2 * x,     lo); \
+      sf_##isa##_store(dst1 + 2 * x + n, hi); \
+      sf_##isa##_zip16( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq16(colorA, colorB), flat), colorA, colorX), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq16(colorB, colorC), flat), colorB, colorX), \
+            &lo, &hi); \
+      sf_##isa##_store(dst2 + 2 * x,     lo); \
+      sf_##isa##_store(dst2 + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+epx_simd_row(sse2)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+epx_simd_row(avx2)
+#endif
+
 static unsigned epx_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_RGB565;
@@ -81,6 +130,15 @@ static void *epx_generic_create(const struct softfilter_config *config,
    }
    filt->threads            = 1;
    filt->in_fmt             = in_fmt;
+
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+      filt->row_rgb565      = epx_row_sse2;
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+      filt->row_rgb565      = epx_row_avx2;
+#endif
    return filt;
 }
 
@@ -103,7 +161,8 @@ static void epx_generic_destroy(void *data)
    free(filt);
 }
 
-static void epx_generic_rgb565 (unsigned width, unsigned height,
+static void epx_generic_rgb565 (epx_row_rgb565_t row,
+      unsigned width, unsigned height,
       int first, int lsat, uint16_t *src,
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
@@ -139,8 +198,23 @@ static void epx_generic_rgb565 (unsigned width, unsigned height,
 
       dP1++;
       dP2++;
+      w = width - 2;
+
+      if (row)
+      {
+         unsigned x = row(dst, dst + dst_stride, src,
+               src - src_stride, src + src_stride, width);
+         colorX     = src[x - 1];
+         colorC     = src[x];
+         sP         = src + x;
+         uP         = src - src_stride + x;
+         lP         = src + src_stride + x;
+         dP1        = (uint32_t *) dst + x;
+         dP2        = (uint32_t *) (dst + dst_stride) + x;
+         w          = width - 1 - x;
+      }
 
-      for (w = width - 2; w; w--)
+      for (; w; w--)
       {
          colorA = colorX;
          colorX = colorC;
@@ -191,6 +265,7 @@ static void epx_generic_rgb565 (unsigned width, unsigned height,
 
 static void epx_work_cb_rgb565(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr =
       (struct softfilter_thread_data*)thread_data;
    uint16_t *input  = (uint16_t*)thr->in_data;
@@ -198,7 +273,7 @@ static void epx_work_cb_rgb565(void *data, void *thread_data)
    unsigned width   = thr->width;
    unsigned height  = thr->height;
 
-   epx_generic_rgb565(width, height,
+   epx_generic_rgb565(filt->row_rgb565, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_RGB565),
          output,
@@ -15,6 +15,7 @@
  */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 
 #ifdef RARCH_INTERNAL
@@ -38,13 +39,80 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels fill x in [1, n) of a row and return n;
+ * the edge pixels are left to the scalar code. */
+typedef unsigned (*lq2x_row_rgb565_t)(uint16_t *out0, uint16_t *out1,
+      const uint16_t *src, const uint16_t *prev, const uint16_t *next,
+      unsigned width);
+typedef unsigned (*lq2x_row_xrgb8888_t)(uint32_t *out0, uint32_t *out1,
+      const uint32_t *src, const uint32_t *prev, const uint32_t *next,
+      unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   lq2x_row_rgb565_t row_rgb565;
+   lq2x_row_xrgb8888_t row_xrgb8888;
 };
 
+/* (C + A - ((C ^ A) & 0x0821)) >> 1 never carries out of 16 bits,
+ * and is the same as this. */
+#define lq2x_blend_16(isa, C, A) \
+   sf_##isa##_add16(sf_##isa##_srl16(sf_##isa##_and( \
+      sf_##isa##_xor(C, A), sf_##isa##_set16(0xF7DE)), 1), sf_##isa##_and(C, A))
+
+/* The 32-bit sum wraps just as the scalar one does. */
+#define lq2x_blend_32(isa, C, A) \
+   sf_##isa##_srl32(sf_##isa##_sub32(sf_##isa##_add32(C, A), \
+      sf_##isa##_and(sf_##isa##_xor(C, A), sf_##isa##_set32(0x0421))), 1)
+
+#define lq2x_simd_row(isa, bits, type) \
+static SOFTFILTER_TARGET_##isa unsigned lq2x_row_##isa##_##bits( \
+      type *out0, type *out1, const type *src, \
+      const type *prev, const type *next, unsigned width) \
+{ \
+   const unsigned n = sizeof(sf_##isa##_t) / sizeof(type); \
+   unsigned x       = 1; \
+   for (; x + n < width; x += n) \
+   { \
+      sf_##isa##_t lo, hi, CA, CE; \
+      sf_##isa##_t A    = sf_##isa##_load(prev + x); \
+      sf_##isa##_t B    = sf_##isa##_load(src + x - 1); \
+      sf_##isa##_t C    = sf_##isa##_load(src + x); \
+      sf_##isa##_t D    = sf_##isa##_load(src + x + 1); \
+      sf_##isa##_t E    = sf_##isa##_load(next + x); \
+      /* Lanes where every output is C */ \
+      sf_##isa##_t flat = sf_##isa##_or(sf_##isa##_eq##bits(A, E), \
+            sf_##isa##_eq##bits(B, D)); \
+      CA                = lq2x_blend_##bits(isa, C, A); \
+      CE                = lq2x_blend_##bits(isa, C, E); \
+      sf_##isa##_zip##bits( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(A, B), flat), CA, C), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(A, D), flat), CA, C), \
+            &lo, &hi); \
+      sf_##isa##_store(out0 + 2 * x,     lo); \
+      sf_##isa##_store(out0 + 2 * x + n, hi); \
+      sf_##isa##_zip##bits( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(E, B), flat), CE, C), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(E, D), flat), CE, C), \
+            &lo, &hi); \
+      sf_##isa##_store(out1 + 2 * x,     lo); \
+      sf_##isa##_store(out1 + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+lq2x_simd_row(sse2, 16, uint16_t)
+lq2x_simd_row(sse2, 32, uint32_t)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+lq2x_simd_row(avx2, 16, uint16_t)
+lq2x_simd_row(avx2, 32, uint32_t)
+#endif
+
 static unsigned lq2x_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_RGB565 | SOFTFILTER_FMT_XRGB8888;
@@ -79,6 +147,21 @@ static void *lq2x_generic_create(const struct softfilter_config *config,
     * so force single threaded operation... */
    filt->threads = 1;
    filt->in_fmt  = in_fmt;
+
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+   {
+      filt->row_rgb565   = lq2x_row_sse2_16;
+      filt->row_xrgb8888 = lq2x_row_sse2_32;
+   }
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+   {
+      filt->row_rgb565   = lq2x_row_avx2_16;
+      filt->row_xrgb8888 = lq2x_row_avx2_32;
+   }
+#endif
    return filt;
 }
 
@@ -101,11 +184,42 @@ static void lq2x_generic_destroy(void *data)
    free(filt);
 }
 
-static void lq2x_generic_rgb565(unsigned width, unsigned height,
+static void lq2x_scalar_rgb565(uint16_t *out0, uint16_t *out1,
+      const uint16_t *src, const uint16_t *prev, const uint16_t *next,
+      unsigned x, unsigned end, unsigned width)
+{
+   for (; x < end; x++)
+   {
+      uint16_t A = prev[x];
+      uint16_t B = (x > 0) ? src[x - 1] : src[x];
+      uint16_t C = src[x];
+      uint16_t D = (x < width - 1) ? src[x + 1] : src[x];
+      uint16_t E = next[x];
+      uint16_t c = C;
+
+      if (A != E && B != D)
+      {
+         out0[2 * x]     = (A == B ? ((C + A - ((C ^ A) & 0x0821)) >> 1) : c);
+         out0[2 * x + 1] = (A == D ? ((C + A - ((C ^ A) & 0x0821)) >> 1) : c);
+         out1[2 * x]     = (E == B ? ((C + E - ((C ^ E) & 0x0821)) >> 1) : c);
+         out1[2 * x + 1] = (E == D ? ((C + E - ((C ^ E) & 0x0821)) >> 1) : c);
+      }
+      else
+      {
+         out0[2 * x]     = c;
+         out0[2 * x + 1] = c;
+         out1[2 * x]     = c;
+         out1[2 * x + 1] = c;
+      }
+   }
+}
+
+static void lq2x_generic_rgb565(lq2x_row_rgb565_t row,
+      unsigned width, unsigned height,
       int first, int last, uint16_t *src,
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
-   unsigned x, y;
+   unsigned y;
    uint16_t *out0 = (uint16_t*)dst;
    uint16_t *out1 = (uint16_t*)(dst + dst_stride);
 
@@ -113,43 +227,58 @@ static void lq2x_generic_rgb565(unsigned width, unsigned height,
    {
       int prevline = (y == 0 ? 0 : src_stride);
       int nextline = (y == height - 1 || last) ? 0 : src_stride;
+      unsigned x   = 1;
+
+      if (row)
+         x = row(out0, out1, src, src - prevline, src + nextline, width);
+
+      lq2x_scalar_rgb565(out0, out1, src, src - prevline, src + nextline,
+            0, 1, width);
+      lq2x_scalar_rgb565(out0, out1, src, src - prevline, src + nextline,
+            x, width, width);
+
+      src  += src_stride;
+      out0 += dst_stride + dst_stride;
+      out1 += dst_stride + dst_stride;
+   }
+}
 
-      for (x = 0; x < width; x++)
+static void lq2x_scalar_xrgb8888(uint32_t *out0, uint32_t *out1,
+      const uint32_t *src, const uint32_t *prev, const uint32_t *next,
+      unsigned x, unsigned end, unsigned width)
+{
+   for (; x < end; x++)
+   {
+      uint32_t A = prev[x];
+      uint32_t B = (x > 0) ? src[x - 1] : src[x];
+      uint32_t C = src[x];
+      uint32_t D = (x < width - 1) ? src[x + 1] : src[x];
+      uint32_t E = next[x];
+      uint32_t c = C;
+
+      if (A != E && B != D)
       {
-         uint16_t A = *(src - prevline);
-         uint16_t B = (x > 0) ? *(src - 1) : *src;
-         uint16_t C = *src;
-         uint16_t D = (x < width - 1) ? *(src + 1) : *src;
-         uint16_t E = *(src++ + nextline);
-         uint16_t c = C;
-
-         if (A != E && B != D)
-         {
-            *out0++ = (A == B ? ((C + A - ((C ^ A) & 0x0821)) >> 1) : c);
-            *out0++ = (A == D ? ((C + A - ((C ^ A) & 0x0821)) >> 1) : c);
-            *out1++ = (E == B ? ((C + E - ((C ^ E) & 0x0821)) >> 1) : c);
-            *out1++ = (E == D ? ((C + E - ((C ^ E) & 0x0821)) >> 1) : c);
-         }
-         else
-         {
-            *out0++ = c;
-            *out0++ = c;
-            *out1++ = c;
-            *out1++ = c;
-         }
+         out0[2 * x]     = (A == B ? (C + A - ((C ^ A) & 0x0421)) >> 1 : c);
+         out0[2 * x + 1] = (A == D ? (C + A - ((C ^ A) & 0x0421)) >> 1 : c);
+         out1[2 * x]     = (E == B ? (C + E - ((C ^ E) & 0x0421)) >> 1 : c);
+         out1[2 * x + 1] = (E == D ? (C + E - ((C ^ E) & 0x0421)) >> 1 : c);
+      }
+      else
+      {
+         out0[2 * x]     = c;
+         out0[2 * x + 1] = c;
+         out1[2 * x]     = c;
+         out1[2 * x + 1] = c;
       }
-
-      src  += src_stride - width;
-      out0 += dst_stride + dst_stride - (width << 1);
-      out1 += dst_stride + dst_stride - (width << 1);
    }
 }
 
-static void lq2x_generic_xrgb8888(unsigned width, unsigned height,
+static void lq2x_generic_xrgb8888(lq2x_row_xrgb8888_t row,
+      unsigned width, unsigned height,
       int first, int last, uint32_t *src,
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
-   unsigned x, y;
+   unsigned y;
    uint32_t *out0 = (uint32_t*)dst;
    uint32_t *out1 = (uint32_t*)(dst + dst_stride);
 
@@ -157,47 +286,32 @@ static void lq2x_generic_xrgb8888(unsigned width, unsigned height,
    {
       int prevline = (y == 0 ? 0 : src_stride);
       int nextline = (y == height - 1 || last) ? 0 : src_stride;
+      unsigned x   = 1;
 
-      for (x = 0; x < width; x++)
-      {
-         uint32_t A = *(src - prevline);
-         uint32_t B = (x > 0) ? *(src - 1) : *src;
-         uint32_t C = *src;
-         uint32_t D = (x < width - 1) ? *(src + 1) : *src;
-         uint32_t E = *(src++ + nextline);
-         uint32_t c = C;
-
-         if (A != E && B != D)
-         {
-            *out0++ = (A == B ? (C + A - ((C ^ A) & 0x0421)) >> 1 : c);
-            *out0++ = (A == D ? (C + A - ((C ^ A) & 0x0421)) >> 1 : c);
-            *out1++ = (E == B ? (C + E - ((C ^ E) & 0x0421)) >> 1 : c);
-            *out1++ = (E == D ? (C + E - ((C ^ E) & 0x0421)) >> 1 : c);
-         }
-         else
-         {
-            *out0++ = c;
-            *out0++ = c;
-            *out1++ = c;
-            *out1++ = c;
-         }
-      }
+      if (row)
+         x = row(out0, out1, src, src - prevline, src + nextline, width);
+
+      lq2x_scalar_xrgb8888(out0, out1, src, src - prevline, src + nextline,
+            0, 1, width);
+      lq2x_scalar_xrgb8888(out0, out1, src, src - prevline, src + nextline,
+            x, width, width);
 
-      src += src_stride - width;
-      out0 += dst_stride + dst_stride - (width << 1);
-      out1 += dst_stride + dst_stride - (width << 1);
+      src  += src_stride;
+      out0 += dst_stride + dst_stride;
+      out1 += dst_stride + dst_stride;
    }
 }
 
 static void lq2x_work_cb_rgb565(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr =
       (struct softfilter_thread_data*)thread_data;
    uint16_t *input                    = (uint16_t*)thr->in_data;
    uint16_t *output                   = (uint16_t*)thr->out_data;
    unsigned width                     = thr->width;
    unsigned height                    = thr->height;
-   lq2x_generic_rgb565(width, height,
+   lq2x_generic_rgb565(filt->row_rgb565, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_RGB565),
          output,
@@ -206,13 +320,14 @@ static void lq2x_work_cb_rgb565(void *data, void *thread_data)
 
 static void lq2x_work_cb_xrgb8888(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr =
       (struct softfilter_thread_data*)thread_data;
    uint32_t *input                    = (uint32_t*)thr->in_data;
    uint32_t *output                   = (uint32_t*)thr->out_data;
    unsigned width                     = thr->width;
    unsigned height                    = thr->height;
-   lq2x_generic_xrgb8888(width, height,
+   lq2x_generic_xrgb8888(filt->row_xrgb8888, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_XRGB8888),
          output,
@@ -1317,7 +1317,7 @@ static void *ntsc_crt_create(const struct softfilter_config *config,
     filt->in_fmt  = in_fmt;
 
     /* Allocate CRT output buffer: RGB (3 bpp) */
-    out_buf = (unsigned char*)malloc(max_width * max_height * 3);
+    out_buf = (unsigned char*)calloc(max_width * max_height, 3);
     if (!out_buf) { free(filt->workers); free(filt); return NULL; }
 
     filt->out_buf   = out_buf;
@@ -17,6 +17,7 @@
 /* Compile: gcc -o scale2x.so -shared scale2x.c -std=c99 -O3 -Wall -pedantic -fPIC */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -39,13 +40,67 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels fill x in [1, n) of a row and return n;
+ * the edge pixels are left to the scalar code. */
+typedef unsigned (*scale2x_row_xrgb8888_t)(uint32_t *out0, uint32_t *out1,
+      const uint32_t *in, const uint32_t *prev, const uint32_t *next,
+      unsigned width);
+typedef unsigned (*scale2x_row_rgb565_t)(uint16_t *out0, uint16_t *out1,
+      const uint16_t *in, const uint16_t *prev, const uint16_t *next,
+      unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   scale2x_row_xrgb8888_t row_xrgb8888;
+   scale2x_row_rgb565_t row_rgb565;
 };
 
+#define scale2x_simd_row(isa, bits, type) \
+static SOFTFILTER_TARGET_##isa unsigned scale2x_row_##isa##_##bits( \
+      type *out0, type *out1, const type *in, \
+      const type *prev, const type *next, unsigned width) \
+{ \
+   const unsigned n = sizeof(sf_##isa##_t) / sizeof(type); \
+   unsigned x       = 1; \
+   for (; x + n < width; x += n) \
+   { \
+      sf_##isa##_t lo, hi; \
+      sf_##isa##_t A    = sf_##isa##_load(prev + x); \
+      sf_##isa##_t B    = sf_##isa##_load(in + x - 1); \
+      sf_##isa##_t C    = sf_##isa##_load(in + x); \
+      sf_##isa##_t D    = sf_##isa##_load(in + x + 1); \
+      sf_##isa##_t E    = sf_##isa##_load(next + x); \
+      /* Lanes where every output is C */ \
+      sf_##isa##_t flat = sf_##isa##_or(sf_##isa##_eq##bits(A, E), \
+            sf_##isa##_eq##bits(B, D)); \
+      sf_##isa##_zip##bits( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(A, B), flat), A, C), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(A, D), flat), A, C), \
+            &lo, &hi); \
+      sf_##isa##_store(out0 + 2 * x,     lo); \
+      sf_##isa##_store(out0 + 2 * x + n, hi); \
+      sf_##isa##_zip##bits( \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(E, B), flat), E, C), \
+            sf_##isa##_sel(sf_##isa##_andnot(sf_##isa##_eq##bits(E, D), flat), E, C), \
+            &lo, &hi); \
+      sf_##isa##_store(out1 + 2 * x,     lo); \
+      sf_##isa##_store(out1 + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+scale2x_simd_row(sse2, 32, uint32_t)
+scale2x_simd_row(sse2, 16, uint16_t)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+scale2x_simd_row(avx2, 32, uint32_t)
+scale2x_simd_row(avx2, 16, uint16_t)
+#endif
+
 static unsigned scale2x_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_XRGB8888 | SOFTFILTER_FMT_RGB565;
@@ -79,6 +134,21 @@ static void *scale2x_generic_create(const struct softfilter_config *config,
     * so force single threaded operation... */
    filt->threads = 1;
    filt->in_fmt  = in_fmt;
+
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+   {
+      filt->row_xrgb8888 = scale2x_row_sse2_32;
+      filt->row_rgb565   = scale2x_row_sse2_16;
+   }
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+   {
+      filt->row_xrgb8888 = scale2x_row_avx2_32;
+      filt->row_rgb565   = scale2x_row_avx2_16;
+   }
+#endif
    return filt;
 }
 
@@ -99,99 +169,131 @@ static void scale2x_generic_destroy(void *data)
    free(filt);
 }
 
+static void scale2x_scalar_xrgb8888(uint32_t *out0, uint32_t *out1,
+      const uint32_t *in, const uint32_t *prev, const uint32_t *next,
+      unsigned x, unsigned end, unsigned width)
+{
+   for (; x < end; x++)
+   {
+      /* Get sample points */
+      uint32_t A = prev[x];
+      uint32_t B = (x > 0) ? in[x - 1] : in[x];
+      uint32_t C = in[x];
+      uint32_t D = (x < width - 1) ? in[x + 1] : in[x];
+      uint32_t E = next[x];
+
+      /* Apply pixel expansion algorithm */
+      if (A != E && B != D)
+      {
+         out0[2 * x]     = (A == B ? A : C);
+         out0[2 * x + 1] = (A == D ? A : C);
+         out1[2 * x]     = (E == B ? E : C);
+         out1[2 * x + 1] = (E == D ? E : C);
+      }
+      else
+      {
+         out0[2 * x]     = C;
+         out0[2 * x + 1] = C;
+         out1[2 * x]     = C;
+         out1[2 * x + 1] = C;
+      }
+   }
+}
+
 static void scale2x_work_cb_xrgb8888(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr = (struct softfilter_thread_data*)thread_data;
    uint32_t in_stride                 = (uint32_t)(thr->in_pitch >> 2);
    uint32_t out_stride                = (uint32_t)(thr->out_pitch >> 2);
    const uint32_t *input              = (const uint32_t*)thr->in_data;
    uint32_t *output0                  = (uint32_t*)thr->out_data;
    uint32_t *output1                  = (uint32_t*)thr->out_data + out_stride;
-   uint16_t x, y;
+   unsigned y;
 
    for (y = 0; y < thr->height; y++)
    {
       /* Determine offsets of previous/next source lines */
-      uint32_t line_prev = (y == 0)               ? 0 : in_stride;
-      uint32_t line_next = (y == thr->height - 1) ? 0 : in_stride;
+      const uint32_t *prev = input - ((y == 0)               ? 0 : in_stride);
+      const uint32_t *next = input + ((y == thr->height - 1) ? 0 : in_stride);
+      unsigned x           = 1;
+
+      if (filt->row_xrgb8888)
+         x = filt->row_xrgb8888(output0, output1, input,
+               prev, next, thr->width);
 
-      for (x = 0; x < thr->width; x++)
+      scale2x_scalar_xrgb8888(output0, output1, input, prev, next,
+            0, 1, thr->width);
+      scale2x_scalar_xrgb8888(output0, output1, input, prev, next,
+            x, thr->width, thr->width);
+
+      input   += in_stride;
+      output0 += out_stride << 1;
+      output1 += out_stride << 1;
+   }
+}
+
+static void scale2x_scalar_rgb565(uint16_t *out0, uint16_t *out1,
+      const uint16_t *in, const uint16_t *prev, const uint16_t *next,
+      unsigned x, unsigned end, unsigned width)
+{
+   for (; x < end; x++)
+   {
+      /* Get sample points */
+      uint16_t A = prev[x];
+      uint16_t B = (x > 0) ? in[x - 1] : in[x];
+      uint16_t C = in[x];
+      uint16_t D = (x < width - 1) ? in[x + 1] : in[x];
+      uint16_t E = next[x];
+
+      /* Apply pixel expansion algorithm */
+      if (A != E && B != D)
       {
-         /* Get sample points */
-         uint32_t A = *(input - line_prev);
-         uint32_t B = (x > 0) ? *(input - 1) : *input;
-         uint32_t C = *input;
-         uint32_t D = (x < thr->width - 1) ? *(input + 1) : *input;
-         uint32_t E = *(input++ + line_next);
-
-         /* Apply pixel expansion algorithm */
-         if (A != E && B != D)
-         {
-            *output0++ = (A == B ? A : C);
-            *output0++ = (A == D ? A : C);
-            *output1++ = (E == B ? E : C);
-            *output1++ = (E == D ? E : C);
-         }
-         else
-         {
-            *output0++ = C;
-            *output0++ = C;
-            *output1++ = C;
-            *output1++ = C;
-         }
+         out0[2 * x]     = (A == B ? A : C);
+         out0[2 * x + 1] = (A == D ? A : C);
+         out1[2 * x]     = (E == B ? E : C);
+         out1[2 * x + 1] = (E == D ? E : C);
+      }
+      else
+      {
+         out0[2 * x]     = C;
+         out0[2 * x + 1] = C;
+         out1[2 * x]     = C;
+         out1[2 * x + 1] = C;
       }
-
-      input   += in_stride - thr->width;
-      output0 += (out_stride << 1) - (thr->width << 1);
-      output1 += (out_stride << 1) - (thr->width << 1);
    }
 }
 
 static void scale2x_work_cb_rgb565(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr = (struct softfilter_thread_data*)thread_data;
    uint32_t in_stride                 = (uint32_t)(thr->in_pitch >> 1);
    uint32_t out_stride                = (uint32_t)(thr->out_pitch >> 1);
    const uint16_t *input              = (const uint16_t*)thr->in_data;
    uint16_t *output0                  = (uint16_t*)thr->out_data;
    uint16_t *output1                  = (uint16_t*)thr->out_data + out_stride;
-   uint16_t x, y;
+   unsigned y;
 
    for (y = 0; y < thr->height; y++)
    {
       /* Determine offsets of previous/next source lines */
-      uint32_t line_prev = (y == 0)               ? 0 : in_stride;
-      uint32_t line_next = (y == thr->height - 1) ? 0 : in_stride;
+      const uint16_t *prev = input - ((y == 0)               ? 0 : in_stride);
+      const uint16_t *next = input + ((y == thr->height - 1) ? 0 : in_stride);
+      unsigned x           = 1;
 
-      for (x = 0; x < thr->width; x++)
-      {
-         /* Get sample points */
-         uint16_t A = *(input - line_prev);
-         uint16_t B = (x > 0) ? *(input - 1) : *input;
-         uint16_t C = *input;
-         uint16_t D = (x < thr->width - 1) ? *(input + 1) : *input;
-         uint16_t E = *(input++ + line_next);
-
-         /* Apply pixel expansion algorithm */
-         if (A != E && B != D)
-         {
-            *output0++ = (A == B ? A : C);
-            *output0++ = (A == D ? A : C);
-            *output1++ = (E == B ? E : C);
-            *output1++ = (E == D ? E : C);
-         }
-         else
-         {
-            *output0++ = C;
-            *output0++ = C;
-            *output1++ = C;
-            *output1++ = C;
-         }
-      }
+      if (filt->row_rgb565)
+         x = filt->row_rgb565(output0, output1, input,
+               prev, next, thr->width);
+
+      scale2x_scalar_rgb565(output0, output1, input, prev, next,
+            0, 1, thr->width);
+      scale2x_scalar_rgb565(output0, output1, input, prev, next,
+            x, thr->width, thr->width);
 
-      input   += in_stride - thr->width;
-      output0 += (out_stride << 1) - (thr->width << 1);
-      output1 += (out_stride << 1) - (thr->width << 1);
+      input   += in_stride;
+      output0 += out_stride << 1;
+      output1 += out_stride << 1;
    }
 }
 
@@ -0,0 +1,151 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTFILTER_SIMD_H__
+#define SOFTFILTER_SIMD_H__
+
+/* A handful of integer vector operations, the same for every
+ * instruction set, so that a filter can write its pixel kernel once
+ * as a macro and stamp it out per instruction set.  Pixels are
+ * 16-bit (RGB565) or 32-bit (XRGB8888) lanes; comparisons return
+ * all-ones lanes for true.
+ *
+ * For each instruction set 'isa' that this build can emit, the
+ * header defines SOFTFILTER_HAVE_<ISA>, a vector type sf_<isa>_t,
+ * SF_<ISA>_BYTES, a function attribute SOFTFILTER_TARGET_<isa> and
+ * the functions below.  The AVX2 ones are compiled for AVX2 whatever
+ * the baseline -m flags, so filters have to check the SIMD mask
+ * before they call them.
+ *
+ *   load, store          unaligned
+ *   set16, set32         broadcast
+ *   and, or, xor
+ *   andnot(a, b)         a & ~b
+ *   sel(m, a, b)         m ? a : b
+ *   eq16, eq32           ==
+ *   gt16, gt32           signed >
+ *   add16, add32, sub16, sub32
+ *   srl16, srl32         logical right shift by a constant
+ *   zip16, zip32         interleave a and b, lo then hi in memory order
+ *   any                  true if any bit is set
+ */
+
+#include <stdint.h>
+#include <retro_inline.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTFILTER_HAVE_SSE2
+#endif
+
+#if defined(SOFTFILTER_HAVE_SSE2)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define SOFTFILTER_HAVE_AVX2
+#define SOFTFILTER_TARGET_avx2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#define SOFTFILTER_HAVE_AVX2
+#define SOFTFILTER_TARGET_avx2
+#endif
+#endif
+
+#define SOFTFILTER_TARGET_sse2
+
+#ifdef SOFTFILTER_HAVE_SSE2
+typedef __m128i sf_sse2_t;
+#define SF_SSE2_BYTES 16
+
+static INLINE sf_sse2_t sf_sse2_load(const void *p) { return _mm_loadu_si128((const __m128i*)p); }
+static INLINE void sf_sse2_store(void *p, sf_sse2_t v) { _mm_storeu_si128((__m128i*)p, v); }
+static INLINE sf_sse2_t sf_sse2_set16(uint16_t v) { return _mm_set1_epi16((short)v); }
+static INLINE sf_sse2_t sf_sse2_set32(uint32_t v) { return _mm_set1_epi32((int)v); }
+static INLINE sf_sse2_t sf_sse2_and(sf_sse2_t a, sf_sse2_t b) { return _mm_and_si128(a, b); }
+static INLINE sf_sse2_t sf_sse2_or(sf_sse2_t a, sf_sse2_t b) { return _mm_or_si128(a, b); }
+static INLINE sf_sse2_t sf_sse2_xor(sf_sse2_t a, sf_sse2_t b) { return _mm_xor_si128(a, b); }
+static INLINE sf_sse2_t sf_sse2_andnot(sf_sse2_t a, sf_sse2_t b) { return _mm_andnot_si128(b, a); }
+static INLINE sf_sse2_t sf_sse2_sel(sf_sse2_t m, sf_sse2_t a, sf_sse2_t b)
+{
+   return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+static INLINE sf_sse2_t sf_sse2_eq16(sf_sse2_t a, sf_sse2_t b) { return _mm_cmpeq_epi16(a, b); }
+static INLINE sf_sse2_t sf_sse2_eq32(sf_sse2_t a, sf_sse2_t b) { return _mm_cmpeq_epi32(a, b); }
+static INLINE sf_sse2_t sf_sse2_gt16(sf_sse2_t a, sf_sse2_t b) { return _mm_cmpgt_epi16(a, b); }
+static INLINE sf_sse2_t sf_sse2_gt32(sf_sse2_t a, sf_sse2_t b) { return _mm_cmpgt_epi32(a, b); }
+static INLINE sf_sse2_t sf_sse2_add16(sf_sse2_t a, sf_sse2_t b) { return _mm_add_epi16(a, b); }
+static INLINE sf_sse2_t sf_sse2_add32(sf_sse2_t a, sf_sse2_t b) { return _mm_add_epi32(a, b); }
+static INLINE sf_sse2_t sf_sse2_sub16(sf_sse2_t a, sf_sse2_t b) { return _mm_sub_epi16(a, b); }
+static INLINE sf_sse2_t sf_sse2_sub32(sf_sse2_t a, sf_sse2_t b) { return _mm_sub_epi32(a, b); }
+#define sf_sse2_srl16(v, n) _mm_srli_epi16((v), (n))
+#define sf_sse2_srl32(v, n) _mm_srli_epi32((v), (n))
+static INLINE void sf_sse2_zip16(sf_sse2_t a, sf_sse2_t b, sf_sse2_t *lo, sf_sse2_t *hi)
+{
+   *lo = _mm_unpacklo_epi16(a, b);
+   *hi = _mm_unpackhi_epi16(a, b);
+}
+static INLINE void sf_sse2_zip32(sf_sse2_t a, sf_sse2_t b, sf_sse2_t *lo, sf_sse2_t *hi)
+{
+   *lo = _mm_unpacklo_epi32(a, b);
+   *hi = _mm_unpackhi_epi32(a, b);
+}
+static INLINE int sf_sse2_any(sf_sse2_t m) { return _mm_movemask_epi8(m) != 0; }
+#endif
+
+#ifdef SOFTFILTER_HAVE_AVX2
+typedef __m256i sf_avx2_t;
+#define SF_AVX2_BYTES 32
+
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_load(const void *p) { return _mm256_loadu_si256((const __m256i*)p); }
+static INLINE SOFTFILTER_TARGET_avx2 void sf_avx2_store(void *p, sf_avx2_t v) { _mm256_storeu_si256((__m256i*)p, v); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_set16(uint16_t v) { return _mm256_set1_epi16((short)v); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_set32(uint32_t v) { return _mm256_set1_epi32((int)v); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_and(sf_avx2_t a, sf_avx2_t b) { return _mm256_and_si256(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_or(sf_avx2_t a, sf_avx2_t b) { return _mm256_or_si256(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_xor(sf_avx2_t a, sf_avx2_t b) { return _mm256_xor_si256(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_andnot(sf_avx2_t a, sf_avx2_t b) { return _mm256_andnot_si256(b, a); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_sel(sf_avx2_t m, sf_avx2_t a, sf_avx2_t b)
+{
+   return _mm256_blendv_epi8(b, a, m);
+}
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_eq16(sf_avx2_t a, sf_avx2_t b) { return _mm256_cmpeq_epi16(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_eq32(sf_avx2_t a, sf_avx2_t b) { return _mm256_cmpeq_epi32(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_gt16(sf_avx2_t a, sf_avx2_t b) { return _mm256_cmpgt_epi16(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_gt32(sf_avx2_t a, sf_avx2_t b) { return _mm256_cmpgt_epi32(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_add16(sf_avx2_t a, sf_avx2_t b) { return _mm256_add_epi16(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_add32(sf_avx2_t a, sf_avx2_t b) { return _mm256_add_epi32(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_sub16(sf_avx2_t a, sf_avx2_t b) { return _mm256_sub_epi16(a, b); }
+static INLINE SOFTFILTER_TARGET_avx2 sf_avx2_t sf_avx2_sub32(sf_avx2_t a, sf_avx2_t b) { return _mm256_sub_epi32(a, b); }
+#define sf_avx2_srl16(v, n) _mm256_srli_epi16((v), (n))
+#define sf_avx2_srl32(v, n) _mm256_srli_epi32((v), (n))
+/* The unpacks work within each 128-bit half. */
+static INLINE SOFTFILTER_TARGET_avx2 void sf_avx2_zip16(sf_avx2_t a, sf_avx2_t b, sf_avx2_t *lo, sf_avx2_t *hi)
+{
+   __m256i l = _mm256_unpacklo_epi16(a, b);
+   __m256i h = _mm256_unpackhi_epi16(a, b);
+   *lo       = _mm256_permute2x128_si256(l, h, 0x20);
+   *hi       = _mm256_permute2x128_si256(l, h, 0x31);
+}
+static INLINE SOFTFILTER_TARGET_avx2 void sf_avx2_zip32(sf_avx2_t a, sf_avx2_t b, sf_avx2_t *lo, sf_avx2_t *hi)
+{
+   __m256i l = _mm256_unpacklo_epi32(a, b);
+   __m256i h = _mm256_unpackhi_epi32(a, b);
+   *lo       = _mm256_permute2x128_si256(l, h, 0x20);
+   *hi       = _mm256_permute2x128_si256(l, h, 0x31);
+}
+static INLINE SOFTFILTER_TARGET_avx2 int sf_avx2_any(sf_avx2_t m) { return !_mm256_testz_si256(m, m); }
+#endif
+
+#endif
@@ -17,6 +17,7 @@
 /* Compile: gcc -o supereagle.so -shared supereagle.c -std=c99 -O3 -Wall -pedantic -fPIC */
 
 #include "softfilter.h"
+#include "softfilter_simd.h"
 #include <stdlib.h>
 
 #ifdef RARCH_INTERNAL
@@ -40,13 +41,148 @@ struct softfilter_thread_data
    int last;
 };
 
+/* Vector kernels fill whole blocks of a row from x = 0
+ * and return how many pixels they did. */
+typedef unsigned (*supereagle_row_rgb565_t)(uint16_t *out, unsigned dst_stride,
+      const uint16_t *in, unsigned nextline, unsigned width);
+typedef unsigned (*supereagle_row_xrgb8888_t)(uint32_t *out, unsigned dst_stride,
+      const uint32_t *in, unsigned nextline, unsigned width);
+
 struct filter_data
 {
    unsigned threads;
    struct softfilter_thread_data *workers;
    unsigned in_fmt;
+   supereagle_row_rgb565_t row_rgb565;
+   supereagle_row_xrgb8888_t row_xrgb8888;
 };
 
+/* supereagle_function() with every branch worked out for the whole
+ * vector and the results picked per lane.  The interpolations fit in
+ * a lane, so they come out exactly as the scalar ones do, and
+ * 'r' adds up the supereagle_result() terms as 2xSaI's does. */
+#define supereagle_simd_interpolate(isa, bits, A, B) \
+   sf_##isa##_add##bits(sf_##isa##_add##bits( \
+      sf_##isa##_srl##bits(sf_##isa##_and(A, mhi1), 1), \
+      sf_##isa##_srl##bits(sf_##isa##_and(B, mhi1), 1)), \
+      sf_##isa##_and(sf_##isa##_and(A, B), mlo1))
+
+/* interpolate2(A, A, A, B) */
+#define supereagle_simd_interpolate2(isa, bits, A, B) \
+   sf_##isa##_add##bits(sf_##isa##_add##bits( \
+      sf_##isa##_add##bits( \
+         sf_##isa##_srl##bits(sf_##isa##_and(A, mhi2), 2), \
+         sf_##isa##_srl##bits(sf_##isa##_and(A, mhi2), 2)), \
+      sf_##isa##_add##bits( \
+         sf_##isa##_srl##bits(sf_##isa##_and(A, mhi2), 2), \
+         sf_##isa##_srl##bits(sf_##isa##_and(B, mhi2), 2))), \
+      sf_##isa##_and(sf_##isa##_srl##bits(sf_##isa##_add##bits( \
+         sf_##isa##_add##bits(sf_##isa##_and(A, mlo2), sf_##isa##_and(A, mlo2)), \
+         sf_##isa##_add##bits(sf_##isa##_and(A, mlo2), sf_##isa##_and(B, mlo2))), 2), mlo2))
+
+/* Both equal to X */
+#define supereagle_simd_eq2(isa, bits, X, Y, Z) \
+   sf_##isa##_and(sf_##isa##_eq##bits(X, Y), sf_##isa##_eq##bits(X, Z))
+
+#define supereagle_simd_row(isa, bits, type, hi1, lo1, hi2, lo2) \
+static SOFTFILTER_TARGET_##isa unsigned supereagle_row_##isa##_##bits( \
+      type *out, unsigned dst_stride, const type *in, \
+      unsigned nextline, unsigned width) \
+{ \
+   const unsigned n  = sizeof(sf_##isa##_t) / sizeof(type); \
+   sf_##isa##_t mhi1 = sf_##isa##_set##bits(hi1); \
+   sf_##isa##_t mlo1 = sf_##isa##_set##bits(lo1); \
+   sf_##isa##_t mhi2 = sf_##isa##_set##bits(hi2); \
+   sf_##isa##_t mlo2 = sf_##isa##_set##bits(lo2); \
+   sf_##isa##_t zero = sf_##isa##_set##bits(0); \
+   unsigned x        = 0; \
+   for (; x + n <= width; x += n) \
+   { \
+      sf_##isa##_t lo, hi, r, c1, c2, c3, c4, r_pos, r_neg; \
+      sf_##isa##_t I25, I56, I23, I26, I53; \
+      sf_##isa##_t product1a, product1b, product2a, product2b; \
+      const type *p        = in + x; \
+      sf_##isa##_t colorB1 = sf_##isa##_load(p - nextline + 0); \
+      sf_##isa##_t colorB2 = sf_##isa##_load(p - nextline + 1); \
+      sf_##isa##_t color4  = sf_##isa##_load(p - 1); \
+      sf_##isa##_t color5  = sf_##isa##_load(p + 0); \
+      sf_##isa##_t color6  = sf_##isa##_load(p + 1); \
+      sf_##isa##_t colorS2 = sf_##isa##_load(p + 2); \
+      sf_##isa##_t color1  = sf_##isa##_load(p + nextline - 1); \
+      sf_##isa##_t color2  = sf_##isa##_load(p + nextline + 0); \
+      sf_##isa##_t color3  = sf_##isa##_load(p + nextline + 1); \
+      sf_##isa##_t colorS1 = sf_##isa##_load(p + nextline + 2); \
+      sf_##isa##_t colorA1 = sf_##isa##_load(p + nextline + nextline + 0); \
+      sf_##isa##_t colorA2 = sf_##isa##_load(p + nextline + nextline + 1); \
+      sf_##isa##_t eq26    = sf_##isa##_eq##bits(color2, color6); \
+      sf_##isa##_t eq53    = sf_##isa##_eq##bits(color5, color3); \
+      c1        = sf_##isa##_andnot(eq26, eq53); \
+      c2        = sf_##isa##_andnot(eq53, eq26); \
+      c3        = sf_##isa##_and(eq26, eq53); \
+      c4        = sf_##isa##_andnot(sf_##isa##_andnot( \
+                     sf_##isa##_eq##bits(zero, zero), eq26), eq53); \
+      r         = sf_##isa##_sub##bits( \
+                     supereagle_simd_eq2(isa, bits, color6, color1, colorA1), \
+                     supereagle_simd_eq2(isa, bits, color5, color1, colorA1)); \
+      r         = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+                     supereagle_simd_eq2(isa, bits, color6, color4, colorB1), \
+                     supereagle_simd_eq2(isa, bits, color5, color4, colorB1))); \
+      r         = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+                     supereagle_simd_eq2(isa, bits, color6, colorA2, colorS1), \
+                     supereagle_simd_eq2(isa, bits, color5, colorA2, colorS1))); \
+      r         = sf_##isa##_add##bits(r, sf_##isa##_sub##bits( \
+                     supereagle_simd_eq2(isa, bits, color6, colorB2, colorS2), \
+                     supereagle_simd_eq2(isa, bits, color5, colorB2, colorS2))); \
+      r_pos     = sf_##isa##_and(c3, sf_##isa##_gt##bits(r, zero)); \
+      r_neg     = sf_##isa##_and(c3, sf_##isa##_gt##bits(zero, r)); \
+      I25       = supereagle_simd_interpolate(isa, bits, color2, color5); \
+      I56       = supereagle_simd_interpolate(isa, bits, color5, color6); \
+      I23       = supereagle_simd_interpolate(isa, bits, color2, color3); \
+      I26       = supereagle_simd_interpolate(isa, bits, color2, color6); \
+      I53       = supereagle_simd_interpolate(isa, bits, color5, color3); \
+      product1a = sf_##isa##_sel(c1, \
+            sf_##isa##_sel(sf_##isa##_or(sf_##isa##_eq##bits(color1, color2), \
+                  sf_##isa##_eq##bits(color6, colorB2)), \
+               supereagle_simd_interpolate(isa, bits, color2, I25), I56), \
+            sf_##isa##_sel(c4, supereagle_simd_interpolate2(isa, bits, color5, I26), \
+               sf_##isa##_sel(r_pos, I56, color5))); \
+      product1b = sf_##isa##_sel(c2, \
+            sf_##isa##_sel(sf_##isa##_or(sf_##isa##_eq##bits(colorB1, color5), \
+                  sf_##isa##_eq##bits(color3, colorS1)), \
+               supereagle_simd_interpolate(isa, bits, color5, I56), I56), \
+            sf_##isa##_sel(c4, supereagle_simd_interpolate2(isa, bits, color6, I53), \
+               sf_##isa##_sel(r_neg, I56, color2))); \
+      product2a = sf_##isa##_sel(c2, \
+            sf_##isa##_sel(sf_##isa##_or(sf_##isa##_eq##bits(color3, colorA2), \
+                  sf_##isa##_eq##bits(color4, color5)), \
+               supereagle_simd_interpolate(isa, bits, color5, I25), I23), \
+            sf_##isa##_sel(c4, supereagle_simd_interpolate2(isa, bits, color2, I53), \
+               sf_##isa##_sel(r_neg, I56, color2))); \
+      product2b = sf_##isa##_sel(c1, \
+            sf_##isa##_sel(sf_##isa##_or(sf_##isa##_eq##bits(color6, colorS2), \
+                  sf_##isa##_eq##bits(color2, colorA1)), \
+               supereagle_simd_interpolate(isa, bits, color2, I23), I23), \
+            sf_##isa##_sel(c4, supereagle_simd_interpolate2(isa, bits, color3, I26), \
+               sf_##isa##_sel(r_pos, I56, color5))); \
+      sf_##isa##_zip##bits(product1a, product1b, &lo, &hi); \
+      sf_##isa##_store(out + 2 * x,     lo); \
+      sf_##isa##_store(out + 2 * x + n, hi); \
+      sf_##isa##_zip##bits(product2a, product2b, &lo, &hi); \
+      sf_##isa##_store(out + dst_stride + 2 * x,     lo); \
+      sf_##isa##_store(out + dst_stride + 2 * x + n, hi); \
+   } \
+   return x; \
+}
+
+#ifdef SOFTFILTER_HAVE_SSE2
+supereagle_simd_row(sse2, 16, uint16_t, 0xF7DE, 0x0821, 0xE79C, 0x1863)
+supereagle_simd_row(sse2, 32, uint32_t, 0xFEFEFEFE, 0x01010101, 0xFCFCFCFC, 0x03030303)
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+supereagle_simd_row(avx2, 16, uint16_t, 0xF7DE, 0x0821, 0xE79C, 0x1863)
+supereagle_simd_row(avx2, 32, uint32_t, 0xFEFEFEFE, 0x01010101, 0xFCFCFCFC, 0x03030303)
+#endif
+
 static unsigned supereagle_generic_input_fmts(void)
 {
    return SOFTFILTER_FMT_RGB565 | SOFTFILTER_FMT_XRGB8888;
@@ -78,6 +214,21 @@ static void *supereagle_generic_create(const struct softfilter_config *config,
    }
    filt->threads = 1;
    filt->in_fmt  = in_fmt;
+
+#ifdef SOFTFILTER_HAVE_SSE2
+   if (simd & SOFTFILTER_SIMD_SSE2)
+   {
+      filt->row_rgb565   = supereagle_row_sse2_16;
+      filt->row_xrgb8888 = supereagle_row_sse2_32;
+   }
+#endif
+#ifdef SOFTFILTER_HAVE_AVX2
+   if (simd & SOFTFILTER_SIMD_AVX2)
+   {
+      filt->row_rgb565   = supereagle_row_avx2_16;
+      filt->row_xrgb8888 = supereagle_row_avx2_32;
+   }
+#endif
    return filt;
 }
 
@@ -210,7 +361,8 @@ static void supereagle_generic_destroy(void *data)
          out += 2
 #endif
 
-static void supereagle_generic_xrgb8888(unsigned width, unsigned height,
+static void supereagle_generic_xrgb8888(supereagle_row_xrgb8888_t row,
+      unsigned width, unsigned height,
       int first, int last, uint32_t *src,
       unsigned src_stride, uint32_t *dst, unsigned dst_stride)
 {
@@ -222,7 +374,16 @@ static void supereagle_generic_xrgb8888(unsigned width, unsigned height,
       uint32_t *in  = (uint32_t*)src;
       uint32_t *out = (uint32_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      finish = width;
+      if (row)
+      {
+         unsigned x = row(out, dst_stride, in, nextline, width);
+         in        += x;
+         out       += 2 * x;
+         finish    -= x;
+      }
+
+      for (; finish; finish -= 1)
       {
          supereagle_declare_variables(uint32_t, in, nextline);
          supereagle_function(supereagle_result, supereagle_interpolate_xrgb8888, supereagle_interpolate2_xrgb8888);
@@ -233,7 +394,8 @@ static void supereagle_generic_xrgb8888(unsigned width, unsigned height,
    }
 }
 
-static void supereagle_generic_rgb565(unsigned width, unsigned height,
+static void supereagle_generic_rgb565(supereagle_row_rgb565_t row,
+      unsigned width, unsigned height,
       int first, int last, uint16_t *src,
       unsigned src_stride, uint16_t *dst, unsigned dst_stride)
 {
@@ -245,7 +407,16 @@ static void supereagle_generic_rgb565(unsigned width, unsigned height,
       uint16_t *in  = (uint16_t*)src;
       uint16_t *out = (uint16_t*)dst;
 
-      for (finish = width; finish; finish -= 1)
+      finish = width;
+      if (row)
+      {
+         unsigned x = row(out, dst_stride, in, nextline, width);
+         in        += x;
+         out       += 2 * x;
+         finish    -= x;
+      }
+
+      for (; finish; finish -= 1)
       {
          supereagle_declare_variables(uint16_t, in, nextline);
          supereagle_function(supereagle_result, supereagle_interpolate_rgb565, supereagle_interpolate2_rgb565);
@@ -258,13 +429,14 @@ static void supereagle_generic_rgb565(unsigned width, unsigned height,
 
 static void supereagle_work_cb_rgb565(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr = (struct softfilter_thread_data*)thread_data;
    uint16_t *input  = (uint16_t*)thr->in_data;
    uint16_t *output = (uint16_t*)thr->out_data;
    unsigned width   = thr->width;
    unsigned height  = thr->height;
 
-   supereagle_generic_rgb565(width, height,
+   supereagle_generic_rgb565(filt->row_rgb565, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_RGB565),
          output,
@@ -273,13 +445,14 @@ static void supereagle_work_cb_rgb565(void *data, void *thread_data)
 
 static void supereagle_work_cb_xrgb8888(void *data, void *thread_data)
 {
+   struct filter_data *filt           = (struct filter_data*)data;
    struct softfilter_thread_data *thr = (struct softfilter_thread_data*)thread_data;
    uint32_t *input  = (uint32_t*)thr->in_data;
    uint32_t *output = (uint32_t*)thr->out_data;
    unsigned width   = thr->width;
    unsigned height  = thr->height;
 
-   supereagle_generic_xrgb8888(width, height,
+   supereagle_generic_xrgb8888(filt->row_xrgb8888, width, height,
          thr->first, thr->last, input,
          (unsigned)(thr->in_pitch / SOFTFILTER_BPP_XRGB8888),
          output,
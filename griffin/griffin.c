@@ -628,6 +628,9 @@ INPUT
 #include "../input/input_driver.c"
 #ifdef HAVE_BSV_MOVIE
 #include "../input/bsv/bsvmovie.c"
+#include "../input/bsv/bsvindex.c"
+#include "../input/bsv/bsvdict.c"
+#include "../input/bsv/bsvstatestream.c"
 #include "../input/bsv/uint32s_index.c"
 #endif
 #include "../input/input_keymaps.c"
@@ -1137,6 +1140,7 @@ CONFIGURATION
 STATE MANAGER
 ============================================================ */
 #ifdef HAVE_REWIND
+#include "../state_manager_raw.c"
 #include "../state_manager.c"
 #endif
 
@@ -1273,6 +1277,7 @@ THREAD
 #endif
 
 #include "../libretro-common/rthreads/rthreads.c"
+#include "../libretro-common/rthreads/tpool.c"
 #include "../gfx/video_thread_wrapper.c"
 #include "../audio/audio_thread_wrapper.c"
 #endif
@@ -1704,14 +1709,6 @@ ANDROID PLAY FEATURE DELIVERY
 #include "../play_feature_delivery/play_feature_delivery.c"
 #endif
 
-
-/*============================================================
-FFMPEG
-============================================================ */
-#ifdef HAVE_FFMPEG
-#include "../libretro-common/rthreads/tpool.c"
-#endif
-
 /*============================================================
 STEAM INTEGRATION USING MIST
 ============================================================ */
@@ -0,0 +1,212 @@
+/**
+ *  RetroArch - A frontend for libretro.
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with RetroArch. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/* REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT.
+ *
+ * Consecutive checkpoints are mostly the same bytes, so each one is
+ * compressed with the state of the previous checkpoint as a zstd
+ * prefix (a raw-content, single-use dictionary), with the window
+ * opened up far enough and long-distance matching on so that the
+ * whole previous state can be matched against.
+ *
+ * The reference is named by the file offset of its checkpoint data,
+ * which the writer and every reader agree on.  Both keep the states
+ * of the last two checkpoints they wrote or read, so readers going
+ * through the file in order, seeks (which decode every checkpoint
+ * from the start) and rewinding across one checkpoint all find the
+ * reference.  A writer whose reference has been truncated away
+ * writes a self-contained frame instead.  The zstd frame checksum is
+ * on, so a wrong reference fails to decode rather than producing a
+ * corrupt state. */
+
+#ifdef HAVE_ZSTD
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_endianness.h>
+#include <zstd.h>
+
+#include "bsvmovie.h"
+#include "../../verbosity.h"
+
+#define BSV_DICT_LEVEL 3
+
+void bsv_movie_dict_clear(bsv_movie_t *movie)
+{
+   movie->dict_size[0] = 0;
+   movie->dict_size[1] = 0;
+}
+
+void bsv_movie_dict_truncate(bsv_movie_t *movie, int64_t pos)
+{
+   int i;
+   for (i = 0; i < 2; i++)
+      if (movie->dict_size[i] && movie->dict_pos[i] >= pos)
+         movie->dict_size[i] = 0;
+}
+
+void bsv_movie_dict_free(bsv_movie_t *movie)
+{
+   free(movie->dict_state[0]);
+   free(movie->dict_state[1]);
+   movie->dict_state[0] = NULL;
+   movie->dict_state[1] = NULL;
+   bsv_movie_dict_clear(movie);
+   ZSTD_freeCCtx(movie->zstd_cctx);
+   ZSTD_freeDCtx(movie->zstd_dctx);
+   movie->zstd_cctx = NULL;
+   movie->zstd_dctx = NULL;
+}
+
+bool bsv_movie_dict_store(bsv_movie_t *movie, int64_t pos,
+      const uint8_t *state, size_t size)
+{
+   int slot;
+   uint8_t *buf;
+   if (!size)
+      return false;
+   /* Same checkpoint again (after a rewind), else an empty slot,
+    * else the older of the two. */
+   if (movie->dict_size[0] && movie->dict_pos[0] == pos)
+      slot = 0;
+   else if (movie->dict_size[1] && movie->dict_pos[1] == pos)
+      slot = 1;
+   else if (!movie->dict_size[0])
+      slot = 0;
+   else if (!movie->dict_size[1])
+      slot = 1;
+   else
+      slot = movie->dict_pos[0] < movie->dict_pos[1] ? 0 : 1;
+
+   movie->dict_size[slot] = 0;
+   if (!(buf = (uint8_t*)realloc(movie->dict_state[slot], size)))
+      return false;
+   movie->dict_state[slot] = buf;
+   memcpy(movie->dict_state[slot], state, size);
+   movie->dict_size[slot] = size;
+   movie->dict_pos[slot]  = pos;
+   return true;
+}
+
+size_t bsv_movie_dict_bound(size_t src_size)
+{
+   return sizeof(int64_t) + ZSTD_compressBound(src_size);
+}
+
+/* Window large enough to reach from the end of src back to
+ * the start of the prefix. */
+static int bsv_movie_dict_window_log(size_t prefix_size, size_t src_size)
+{
+   ZSTD_bounds bounds = ZSTD_cParam_getBounds(ZSTD_c_windowLog);
+   size_t span        = prefix_size + src_size;
+   int log            = bounds.lowerBound;
+   while (log < bounds.upperBound && ((size_t)1 << log) < span)
+      log++;
+   return log;
+}
+
+int64_t bsv_movie_dict_compress(bsv_movie_t *movie, int64_t pos,
+      const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity)
+{
+   size_t ret;
+   int64_t ref_pos  = -1;
+   int64_t ref_le;
+   int slot         = -1;
+   int i;
+
+   if (dst_capacity < sizeof(int64_t))
+      return -1;
+   if (!movie->zstd_cctx && !(movie->zstd_cctx = ZSTD_createCCtx()))
+      return -1;
+
+   /* The latest checkpoint before this one. */
+   for (i = 0; i < 2; i++)
+      if (     movie->dict_size[i] && movie->dict_pos[i] < pos
+            && (slot < 0 || movie->dict_pos[i] > movie->dict_pos[slot]))
+         slot = i;
+   if (slot >= 0)
+      ref_pos = movie->dict_pos[slot];
+   ref_le = swap_if_big64(ref_pos);
+   memcpy(dst, &ref_le, sizeof(ref_le));
+
+   ZSTD_CCtx_reset(movie->zstd_cctx, ZSTD_reset_session_and_parameters);
+   ZSTD_CCtx_setParameter(movie->zstd_cctx, ZSTD_c_compressionLevel, BSV_DICT_LEVEL);
+   ZSTD_CCtx_setParameter(movie->zstd_cctx, ZSTD_c_checksumFlag, 1);
+   if (slot >= 0)
+   {
+      ZSTD_CCtx_setParameter(movie->zstd_cctx, ZSTD_c_windowLog,
+            bsv_movie_dict_window_log(movie->dict_size[slot], src_size));
+      ZSTD_CCtx_setParameter(movie->zstd_cctx,
+            ZSTD_c_enableLongDistanceMatching, 1);
+      ZSTD_CCtx_refPrefix(movie->zstd_cctx,
+            movie->dict_state[slot], movie->dict_size[slot]);
+   }
+   ret = ZSTD_compress2(movie->zstd_cctx, dst + sizeof(int64_t),
+         dst_capacity - sizeof(int64_t), src, src_size);
+   if (ZSTD_isError(ret))
+   {
+      RARCH_ERR("[Replay] Checkpoint compression failed: %s\n",
+            ZSTD_getErrorName(ret));
+      return -1;
+   }
+   return (int64_t)(sizeof(int64_t) + ret);
+}
+
+bool bsv_movie_dict_decompress(bsv_movie_t *movie,
+      const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size)
+{
+   size_t ret;
+   int64_t ref_pos;
+   int slot = -1;
+
+   if (src_size < sizeof(int64_t))
+      return false;
+   if (!movie->zstd_dctx && !(movie->zstd_dctx = ZSTD_createDCtx()))
+      return false;
+   memcpy(&ref_pos, src, sizeof(ref_pos));
+   ref_pos = swap_if_big64(ref_pos);
+
+   ZSTD_DCtx_reset(movie->zstd_dctx, ZSTD_reset_session_and_parameters);
+   if (ref_pos >= 0)
+   {
+      if (movie->dict_size[0] && movie->dict_pos[0] == ref_pos)
+         slot = 0;
+      else if (movie->dict_size[1] && movie->dict_pos[1] == ref_pos)
+         slot = 1;
+      else
+      {
+         RARCH_ERR("[Replay] Checkpoint refers to checkpoint at %lld, "
+               "which was not read.\n", (long long)ref_pos);
+         return false;
+      }
+      ZSTD_DCtx_setParameter(movie->zstd_dctx, ZSTD_d_windowLogMax,
+            ZSTD_dParam_getBounds(ZSTD_d_windowLogMax).upperBound);
+      ZSTD_DCtx_refPrefix(movie->zstd_dctx,
+            movie->dict_state[slot], movie->dict_size[slot]);
+   }
+   ret = ZSTD_decompressDCtx(movie->zstd_dctx, dst, dst_size,
+         src + sizeof(int64_t), src_size - sizeof(int64_t));
+   if (ZSTD_isError(ret) || ret != dst_size)
+   {
+      RARCH_ERR("[Replay] Checkpoint decompression failed: %s\n",
+            ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "short output");
+      return false;
+   }
+   return true;
+}
+#endif
@@ -0,0 +1,434 @@
+/**
+ *  RetroArch - A frontend for libretro.
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with RetroArch. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/* Seek index for replays.
+ *
+ * Frame records are variable length and only carry a back
+ * reference, so finding frame N used to mean walking every record
+ * from the start of the file.  The index keeps the offset of every
+ * record and the numbers of the records holding a checkpoint, so
+ * both lookups are binary searches.
+ *
+ * It is appended to while recording, extended on demand by walking
+ * the records past index_end for files that were not recorded in
+ * this session, and written to a sidecar file (the replay path plus
+ * REPLAY_INDEX_EXTENSION) when the movie is freed so the walk is
+ * only ever done once per file.  The sidecar is ignored unless it
+ * matches the replay's identifier and current size. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_endianness.h>
+#include <array/rbuf.h>
+#include <streams/interface_stream.h>
+#include <streams/file_stream.h>
+#include <file/file_path.h>
+
+#include "bsvmovie.h"
+#include "../../verbosity.h"
+
+#define REPLAY_INDEX_MAGIC    0x49565342 /* "BSVI" */
+#define REPLAY_INDEX_VERSION  1
+
+/* Sidecar layout, all little-endian:
+ *   uint32_t magic, version
+ *   int64_t  identifier, replay size, min_file_pos
+ *   uint64_t record count, checkpoint count
+ *   int64_t  record offsets[record count]
+ *   uint64_t checkpoint records[checkpoint count] */
+#define REPLAY_INDEX_HEADER_LEN (2 * sizeof(uint32_t) + 5 * sizeof(uint64_t))
+
+bool bsv_movie_peek_frame_info(bsv_movie_t *movie, uint8_t *token, uint64_t *len)
+{
+   uint8_t keycount;
+   uint16_t event_count;
+   uint8_t tok;
+   int64_t pos;
+   bool ret = false;
+   if (!movie || movie->version == 0)
+      return false;
+   pos = intfstream_tell(movie->file);
+   if (movie->version > 1 &&
+         intfstream_seek(movie->file, sizeof(uint32_t), SEEK_CUR) < 0)
+      goto end;
+   if (intfstream_read(movie->file, &keycount, 1) != 1)
+      goto end;
+   if (intfstream_seek(movie->file, sizeof(bsv_key_data_t)*keycount, SEEK_CUR) < 0)
+      goto end;
+   if (intfstream_read(movie->file, &event_count, 2) != 2)
+      goto end;
+   event_count = swap_if_big16(event_count);
+   if (intfstream_seek(movie->file, sizeof(bsv_input_data_t)*event_count, SEEK_CUR) < 0)
+      goto end;
+   if (intfstream_read(movie->file, &tok, 1) != 1)
+      goto end;
+   if (len)
+   {
+      if (tok == REPLAY_TOKEN_CHECKPOINT_FRAME)
+      {
+         uint64_t state_length;
+         if (intfstream_read(movie->file, &(state_length), sizeof(uint64_t)) != sizeof(uint64_t))
+            goto end;
+         state_length = swap_if_big64(state_length);
+         if (intfstream_seek(movie->file, state_length, SEEK_CUR) < 0)
+            goto end;
+      }
+      else if (tok == REPLAY_TOKEN_CHECKPOINT2_FRAME)
+      {
+         uint32_t state_length;
+         /* Skip compression, encoding, uncompressed unencoded size, uncompressed encoded size */
+         if (intfstream_seek(movie->file, 2+2*sizeof(uint32_t), SEEK_CUR) < 0)
+            goto end;
+         /* Read compressed encoded size */
+         if (intfstream_read(movie->file, &(state_length), sizeof(uint32_t)) != sizeof(uint32_t))
+            goto end;
+         state_length = swap_if_big32(state_length);
+         /* Seek past the state data */
+         if (intfstream_seek(movie->file, state_length, SEEK_CUR) < 0)
+            goto end;
+      }
+      /* We are already at the end of the frame */
+      else if (tok == REPLAY_TOKEN_REGULAR_FRAME) { }
+      else
+      {
+         RARCH_LOG("[Replay] Unrecognized frame token type %c\n", tok);
+         goto end;
+      }
+   }
+   ret = true;
+ end:
+   if (ret)
+   {
+      if (token)
+         *token = tok;
+      if (len)
+         *len = intfstream_tell(movie->file) - pos;
+   }
+   if (intfstream_seek(movie->file, pos, SEEK_SET) < 0)
+      return false;
+   return ret;
+}
+
+void bsv_movie_index_clear(bsv_movie_t *movie)
+{
+   RBUF_CLEAR(movie->record_pos);
+   RBUF_CLEAR(movie->checkpoint_records);
+   movie->index_end   = movie->min_file_pos;
+   movie->index_dirty = true;
+}
+
+void bsv_movie_index_free(bsv_movie_t *movie)
+{
+   RBUF_FREE(movie->record_pos);
+   RBUF_FREE(movie->checkpoint_records);
+   free(movie->index_path);
+   movie->index_path = NULL;
+}
+
+void bsv_movie_index_truncate(bsv_movie_t *movie, int64_t pos)
+{
+   size_t count = RBUF_LEN(movie->record_pos);
+   size_t keep  = count;
+   size_t cps;
+
+   if (movie->index_end <= pos)
+      return;
+   /* Records starting at or past pos are gone, and so is the
+    * last one left if it ran past pos. */
+   while (keep > 0 && movie->record_pos[keep - 1] >= pos)
+      keep--;
+   if (keep > 0 && (keep < count
+            ? movie->record_pos[keep] : movie->index_end) > pos)
+      keep--;
+   movie->index_end = keep < count
+      ? movie->record_pos[keep] : (int64_t)movie->min_file_pos;
+   RBUF_RESIZE(movie->record_pos, keep);
+
+   cps = RBUF_LEN(movie->checkpoint_records);
+   while (cps > 0 && movie->checkpoint_records[cps - 1] >= keep)
+      cps--;
+   RBUF_RESIZE(movie->checkpoint_records, cps);
+   movie->index_dirty = true;
+}
+
+void bsv_movie_index_push(bsv_movie_t *movie, int64_t pos, int64_t end,
+      bool checkpoint)
+{
+   size_t record;
+   bsv_movie_index_truncate(movie, pos);
+   /* If the index lags behind the file it is caught up
+    * by the next bsv_movie_index_extend() instead. */
+   if (movie->index_end != pos)
+      return;
+   record = RBUF_LEN(movie->record_pos);
+   RBUF_PUSH(movie->record_pos, pos);
+   if (RBUF_LEN(movie->record_pos) != record + 1)
+      return;
+   if (checkpoint)
+      RBUF_PUSH(movie->checkpoint_records, (uint64_t)record);
+   movie->index_end   = end;
+   movie->index_dirty = true;
+}
+
+bool bsv_movie_index_extend(bsv_movie_t *movie, uint64_t records)
+{
+   uint8_t tok;
+   uint64_t len;
+   int64_t initial_pos;
+
+   if (!movie || movie->version == 0)
+      return false;
+   if (RBUF_LEN(movie->record_pos) >= records)
+      return true;
+
+   initial_pos = intfstream_tell(movie->file);
+   intfstream_seek(movie->file, movie->index_end, SEEK_SET);
+   while (     RBUF_LEN(movie->record_pos) < records
+         && bsv_movie_peek_frame_info(movie, &tok, &len))
+   {
+      size_t count = RBUF_LEN(movie->record_pos);
+      bsv_movie_index_push(movie, movie->index_end,
+            movie->index_end + (int64_t)len,
+               tok == REPLAY_TOKEN_CHECKPOINT_FRAME
+            || tok == REPLAY_TOKEN_CHECKPOINT2_FRAME);
+      if (     RBUF_LEN(movie->record_pos) == count
+            || intfstream_seek(movie->file, movie->index_end, SEEK_SET) < 0)
+         break;
+   }
+   intfstream_seek(movie->file, initial_pos, SEEK_SET);
+   return RBUF_LEN(movie->record_pos) >= records;
+}
+
+int64_t bsv_movie_index_find_record(const bsv_movie_t *movie, int64_t pos)
+{
+   size_t lo = 0;
+   size_t hi = RBUF_LEN(movie->record_pos);
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+      if (movie->record_pos[mid] < pos)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   if (lo < RBUF_LEN(movie->record_pos) && movie->record_pos[lo] == pos)
+      return (int64_t)lo;
+   return -1;
+}
+
+size_t bsv_movie_index_checkpoints_before(const bsv_movie_t *movie,
+      uint64_t record)
+{
+   size_t lo = 0;
+   size_t hi = RBUF_LEN(movie->checkpoint_records);
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+      if (movie->checkpoint_records[mid] < record)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}
+
+int64_t bsv_movie_index_checkpoint_before(const bsv_movie_t *movie,
+      int64_t frame, bool paused)
+{
+   /* Skip to prev would prefer to go back at least 30 frames
+      if rewinding when not paused, but won't skip over more
+      than one checkpoint while going backwards. */
+   const int64_t prev_skip_min_distance = 30;
+   size_t before, far;
+
+   if (frame <= 0)
+      return -1;
+   before = bsv_movie_index_checkpoints_before(movie, (uint64_t)frame);
+   if (paused)
+      return before > 0 ? (int64_t)movie->checkpoint_records[before - 1] : -1;
+   far    = frame > prev_skip_min_distance
+      ? bsv_movie_index_checkpoints_before(movie,
+            (uint64_t)(frame - prev_skip_min_distance + 1))
+      : 0;
+   /* With two or more checkpoints closer than that, settle
+      for the second-closest one. */
+   if (before - far >= 2)
+      return (int64_t)movie->checkpoint_records[before - 2];
+   return far > 0 ? (int64_t)movie->checkpoint_records[far - 1] : -1;
+}
+
+bool bsv_movie_find_checkpoint_before(bsv_movie_t *movie, int64_t frame,
+      bool paused, int64_t *cp_pos_out, int64_t *cp_frame_out)
+{
+   int64_t cp_pos = -1, cp_frame = -1;
+   if (!movie || movie->version == 0)
+      return false;
+   /* Only records before the target frame matter. */
+   if (frame > 0)
+      bsv_movie_index_extend(movie, (uint64_t)frame);
+   cp_frame = bsv_movie_index_checkpoint_before(movie, frame, paused);
+   if (cp_frame >= 0)
+      cp_pos = movie->record_pos[cp_frame];
+   if (cp_pos_out)
+      *cp_pos_out = cp_pos;
+   if (cp_frame_out)
+      *cp_frame_out = cp_frame;
+   return cp_frame >= 0;
+}
+
+bool bsv_movie_index_load(bsv_movie_t *movie, const char *path)
+{
+   uint8_t *ptr;
+   uint32_t magic, version;
+   int64_t identifier, size, min_file_pos, prev;
+   uint64_t records, checkpoints, i;
+   void *data  = NULL;
+   int64_t len = 0;
+   bool ret    = false;
+
+   if (     !movie || movie->version == 0 || !path
+         || !path_is_valid(path)
+         || !filestream_read_file(path, &data, &len)
+         || len < (int64_t)REPLAY_INDEX_HEADER_LEN)
+      goto end;
+
+   ptr = (uint8_t*)data;
+   memcpy(&magic,        ptr, sizeof(magic));        ptr += sizeof(magic);
+   memcpy(&version,      ptr, sizeof(version));      ptr += sizeof(version);
+   memcpy(&identifier,   ptr, sizeof(identifier));   ptr += sizeof(identifier);
+   memcpy(&size,         ptr, sizeof(size));         ptr += sizeof(size);
+   memcpy(&min_file_pos, ptr, sizeof(min_file_pos)); ptr += sizeof(min_file_pos);
+   memcpy(&records,      ptr, sizeof(records));      ptr += sizeof(records);
+   memcpy(&checkpoints,  ptr, sizeof(checkpoints));  ptr += sizeof(checkpoints);
+   magic        = swap_if_big32(magic);
+   version      = swap_if_big32(version);
+   identifier   = swap_if_big64(identifier);
+   size         = swap_if_big64(size);
+   min_file_pos = swap_if_big64(min_file_pos);
+   records      = swap_if_big64(records);
+   checkpoints  = swap_if_big64(checkpoints);
+
+   /* Only trust an index written for this exact file. */
+   if (     magic        != REPLAY_INDEX_MAGIC
+         || version      != REPLAY_INDEX_VERSION
+         || identifier   != movie->identifier
+         || min_file_pos != (int64_t)movie->min_file_pos
+         || size         != intfstream_get_size(movie->file)
+         || records      == 0
+         || checkpoints  >  records
+         || records      >  (uint64_t)(len - REPLAY_INDEX_HEADER_LEN) / sizeof(int64_t)
+         || (uint64_t)(len - REPLAY_INDEX_HEADER_LEN)
+            != (records + checkpoints) * sizeof(int64_t))
+      goto end;
+
+   bsv_movie_index_clear(movie);
+   if (     !RBUF_TRYFIT(movie->record_pos, records)
+         || !RBUF_TRYFIT(movie->checkpoint_records, checkpoints))
+      goto end;
+
+   prev = min_file_pos - 1;
+   for (i = 0; i < records; i++, ptr += sizeof(int64_t))
+   {
+      int64_t pos;
+      memcpy(&pos, ptr, sizeof(pos));
+      pos = swap_if_big64(pos);
+      if (pos <= prev || pos >= size || (i == 0 && pos != min_file_pos))
+         goto end;
+      RBUF_PUSH(movie->record_pos, pos);
+      prev = pos;
+   }
+   prev = -1;
+   for (i = 0; i < checkpoints; i++, ptr += sizeof(uint64_t))
+   {
+      uint64_t record;
+      memcpy(&record, ptr, sizeof(record));
+      record = swap_if_big64(record);
+      if ((int64_t)record <= prev || record >= records)
+         goto end;
+      RBUF_PUSH(movie->checkpoint_records, record);
+      prev = (int64_t)record;
+   }
+   movie->index_end   = size;
+   movie->index_dirty = false;
+   ret                = true;
+
+end:
+   if (!ret && movie && movie->version > 0)
+      bsv_movie_index_clear(movie);
+   free(data);
+   return ret;
+}
+
+bool bsv_movie_index_save(bsv_movie_t *movie, const char *path)
+{
+   uint8_t *buf, *ptr;
+   uint32_t magic, version;
+   int64_t identifier, size, min_file_pos;
+   uint64_t records, checkpoints, i;
+   size_t buf_len;
+   bool ret;
+
+   if (!movie || movie->version == 0 || !path || !movie->index_dirty)
+      return false;
+   /* Partial indexes are not worth keeping; the next session
+    * would have to walk the rest of the file anyway. */
+   size    = intfstream_get_size(movie->file);
+   records = RBUF_LEN(movie->record_pos);
+   if (records == 0 || movie->index_end != size)
+      return false;
+
+   checkpoints = RBUF_LEN(movie->checkpoint_records);
+   buf_len     = REPLAY_INDEX_HEADER_LEN
+      + (size_t)(records + checkpoints) * sizeof(int64_t);
+   if (!(buf = ptr = (uint8_t*)malloc(buf_len)))
+      return false;
+
+   magic        = swap_if_big32(REPLAY_INDEX_MAGIC);
+   version      = swap_if_big32(REPLAY_INDEX_VERSION);
+   identifier   = swap_if_big64(movie->identifier);
+   min_file_pos = swap_if_big64((int64_t)movie->min_file_pos);
+   size         = swap_if_big64(size);
+   memcpy(ptr, &magic,        sizeof(magic));        ptr += sizeof(magic);
+   memcpy(ptr, &version,      sizeof(version));      ptr += sizeof(version);
+   memcpy(ptr, &identifier,   sizeof(identifier));   ptr += sizeof(identifier);
+   memcpy(ptr, &size,         sizeof(size));         ptr += sizeof(size);
+   memcpy(ptr, &min_file_pos, sizeof(min_file_pos)); ptr += sizeof(min_file_pos);
+   records     = swap_if_big64(records);
+   checkpoints = swap_if_big64(checkpoints);
+   memcpy(ptr, &records,      sizeof(records));      ptr += sizeof(records);
+   memcpy(ptr, &checkpoints,  sizeof(checkpoints));  ptr += sizeof(checkpoints);
+
+   for (i = 0; i < RBUF_LEN(movie->record_pos); i++, ptr += sizeof(int64_t))
+   {
+      int64_t pos = swap_if_big64(movie->record_pos[i]);
+      memcpy(ptr, &pos, sizeof(pos));
+   }
+   for (i = 0; i < RBUF_LEN(movie->checkpoint_records); i++, ptr += sizeof(uint64_t))
+   {
+      uint64_t record = swap_if_big64(movie->checkpoint_records[i]);
+      memcpy(ptr, &record, sizeof(record));
+   }
+
+   if ((ret = filestream_write_file(path, buf, (int64_t)buf_len)))
+      movie->index_dirty = false;
+   else
+      RARCH_WARN("[Replay] Could not write replay index \"%s\".\n", path);
+   free(buf);
+   return ret;
+}
@@ -17,6 +17,7 @@
 
 #include "bsvmovie.h"
 #include <retro_endianness.h>
+#include <array/rbuf.h>
 #include <stdint.h>
 #include "../input_driver.h"
 #include "../../retroarch.h"
@@ -42,38 +43,9 @@
 #include <zstd.h>
 #endif
 
-#define BSV_IFRAME_START_TOKEN 0x00
-/* after START:
-   frame counter uint
-   state size (uncompressed) uint
-   new block and new superblock data (see below)
-   superblock seq (see below)
- */
-#define BSV_IFRAME_NEW_BLOCK_TOKEN 0x01
-/* after NEW_BLOCK:
-   index uint
-   binary
- */
-#define BSV_IFRAME_NEW_SUPERBLOCK_TOKEN 0x02
-/* after NEW_SUPERBLOCK:
-   index uint
-   array of uints
-*/
-#define BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN 0x03
-/* after SUPERBLOCK_SEQ:
-   array of uints
-   */
-
-/* Later, tokens for pframes */
-
 /* Forward declarations */
 void bsv_movie_free(bsv_movie_t*);
 
-#ifdef HAVE_STATESTREAM
-int64_t bsv_movie_write_deduped_state(bsv_movie_t *movie, uint8_t *state, size_t state_size, uint8_t *output, size_t output_capacity);
-bool bsv_movie_read_deduped_state(bsv_movie_t *movie, uint8_t *encoded, size_t encoded_size);
-#endif
-
 static void bsv_movie_scan_to(bsv_movie_t *movie, int64_t pos)
 {
    if (!movie || movie->version == 0)
@@ -86,175 +58,92 @@ static void bsv_movie_scan_to(bsv_movie_t *movie, int64_t pos)
    }
 }
 
+/* Counterpart to bsv_movie_scan_to() for a target the index
+ * knows about: rather than reading every record on the way, only
+ * the checkpoints between the current position and the target are
+ * read, since incremental checkpoints build on the block index left
+ * behind by the previous ones.  Leaves the movie in the same state
+ * the scan would have. */
+static bool bsv_movie_scan_to_record(bsv_movie_t *movie, int64_t record)
+{
+   size_t i;
+   int64_t f, first;
+   int64_t from = bsv_movie_index_find_record(movie,
+         intfstream_tell(movie->file));
+   if (from < 1 || from > record)
+      return false;
+   for (i = bsv_movie_index_checkpoints_before(movie, (uint64_t)from);
+        i < RBUF_LEN(movie->checkpoint_records)
+        && (int64_t)movie->checkpoint_records[i] < record;
+        i++)
+   {
+      int64_t cp = (int64_t)movie->checkpoint_records[i];
+      intfstream_seek(movie->file, movie->record_pos[cp], SEEK_SET);
+      movie->frame_counter = cp - 1;
+      if (!bsv_movie_read_next_events(movie, REPLAY_CPBEHAVIOR_UPDATE, false))
+         return false;
+   }
+   first = MAX(from, record - 1 - (int64_t)movie->frame_mask);
+   for (f = first; f < record; f++)
+      movie->frame_pos[f & movie->frame_mask] = movie->record_pos[f + 1];
+   movie->frame_counter = record - 1;
+   intfstream_seek(movie->file, movie->record_pos[record], SEEK_SET);
+   return true;
+}
+
 static bool bsv_movie_seek_to_pos_impl(bsv_movie_t *movie, int64_t pos)
 {
    /* TODO/FIXME:
       1. fix under "no previous replay" while recording
       2. fix under "some previous replay" while recording
     */
-   int64_t movie_pos;
+   int64_t movie_pos, record;
    if (!movie || movie->version == 0)
       return false;
    movie_pos = intfstream_tell(movie->file);
    if (pos == movie_pos)
       return true;
+   record = bsv_movie_index_find_record(movie, pos);
    /* assume file is at a frame boundary and frame is at a checkpoint boundary. */
    if (pos < movie_pos)
-      /* TODO: this could be made more efficient with backrefs if we
-         had a way to scan backwards; we wouldn't need to reset to go
-         backwards. */
       /* It seems strange, but we want `reset_playback` here and not
          `reset_recording`, even if the movie is in record mode. This
          is because we don't want to re-serialize the initial state or
          whatever and act "as if" we just started recording. */
       bsv_movie_reset_playback(movie);
-   if (pos != movie_pos)
+   if (record < 1 || !bsv_movie_scan_to_record(movie, record))
       bsv_movie_scan_to(movie, pos);
    return bsv_movie_read_next_events(movie, REPLAY_CPBEHAVIOR_DESERIALIZE, false);
 }
 
-static bool bsv_movie_peek_frame_info(bsv_movie_t *movie, uint8_t *token, uint64_t *len)
+static bool bsv_movie_skip_to_next_checkpoint_impl(bsv_movie_t *movie)
 {
-   uint8_t keycount;
-   uint16_t event_count;
-   uint8_t tok;
-   int64_t pos;
-   bool ret = false;
+   size_t cp;
+   int64_t record;
    if (!movie || movie->version == 0)
       return false;
-   pos = intfstream_tell(movie->file);
-   if (movie->version > 1 &&
-         intfstream_seek(movie->file, sizeof(uint32_t), SEEK_CUR) < 0)
-      goto end;
-   if (intfstream_read(movie->file, &keycount, 1) != 1)
-      goto end;
-   if (intfstream_seek(movie->file, sizeof(bsv_key_data_t)*keycount, SEEK_CUR) < 0)
-      goto end;
-   if (intfstream_read(movie->file, &event_count, 2) != 2)
-      goto end;
-   event_count = swap_if_big16(event_count);
-   if (intfstream_seek(movie->file, sizeof(bsv_input_data_t)*event_count, SEEK_CUR) < 0)
-      goto end;
-   if (intfstream_read(movie->file, &tok, 1) != 1)
-      goto end;
-   if (len)
-   {
-      if (tok == REPLAY_TOKEN_CHECKPOINT_FRAME)
-      {
-         uint64_t state_length;
-         if (intfstream_read(movie->file, &(state_length), sizeof(uint64_t)) != sizeof(uint64_t))
-            goto end;
-         state_length = swap_if_big64(state_length);
-         if (intfstream_seek(movie->file, state_length, SEEK_CUR) < 0)
-            goto end;
-      }
-      else if (tok == REPLAY_TOKEN_CHECKPOINT2_FRAME)
-      {
-         uint32_t state_length;
-         /* Skip compression, encoding, uncompressed unencoded size, uncompressed encoded size */
-         if (intfstream_seek(movie->file, 2+2*sizeof(uint32_t), SEEK_CUR) < 0)
-            goto end;
-         /* Read compressed encoded size */
-         if (intfstream_read(movie->file, &(state_length), sizeof(uint32_t)) != sizeof(uint32_t))
-            goto end;
-         /* Seek past the state data */
-         if (intfstream_seek(movie->file, state_length, SEEK_CUR) < 0)
-            goto end;
-      }
-      /* We are already at the end of the frame */
-      else if (tok == REPLAY_TOKEN_REGULAR_FRAME) { }
-      else
-      {
-         RARCH_LOG("[Replay] Unrecognized frame token type %c\n", token);
-         goto end;
-      }
-   }
-   ret = true;
- end:
-   if (ret)
+   record = bsv_movie_index_find_record(movie, intfstream_tell(movie->file));
+   cp     = bsv_movie_index_checkpoints_before(movie, (uint64_t)MAX(record, 0));
+   /* Not indexed that far yet; finish the index and look again. */
+   if (record < 0 || cp == RBUF_LEN(movie->checkpoint_records))
    {
-      if (token)
-         *token = tok;
-      if (len)
-         *len = intfstream_tell(movie->file) - pos;
+      bsv_movie_index_extend(movie, UINT64_MAX);
+      record = bsv_movie_index_find_record(movie, intfstream_tell(movie->file));
+      cp     = bsv_movie_index_checkpoints_before(movie, (uint64_t)MAX(record, 0));
+      if (record < 0 || cp == RBUF_LEN(movie->checkpoint_records))
+         return false;
    }
-   if (intfstream_seek(movie->file, pos, SEEK_SET) < 0)
-      return false;
-   return ret;
-}
-
-static bool bsv_movie_skip_to_next_checkpoint_impl(bsv_movie_t *movie)
-{
-   uint8_t tok = REPLAY_TOKEN_INVALID;
-   uint64_t frame_len;
-   int64_t cp_pos, initial_pos;
-   if (!movie || movie->version == 0)
-      return false;
-   initial_pos = intfstream_tell(movie->file);
-   /* scan forward until peek shows a checkpoint or checkpoint2 */
-   while (bsv_movie_peek_frame_info(movie, &tok, &frame_len)
-         && (     tok != REPLAY_TOKEN_INVALID
-               && tok != REPLAY_TOKEN_CHECKPOINT_FRAME
-               && tok != REPLAY_TOKEN_CHECKPOINT2_FRAME))
-      intfstream_seek(movie->file, frame_len, SEEK_CUR);
-   if (tok == REPLAY_TOKEN_INVALID)
-      return false;
-   cp_pos = intfstream_tell(movie->file);
-   intfstream_seek(movie->file, initial_pos, SEEK_SET);
-   return bsv_movie_seek_to_pos_impl(movie, cp_pos);
+   return bsv_movie_seek_to_pos_impl(movie,
+         movie->record_pos[movie->checkpoint_records[cp]]);
 }
 
 static bool movie_find_checkpoint_before(bsv_movie_t *movie, int64_t frame,
       bool consider_paused, int64_t *cp_pos_out, int64_t *cp_frame_out)
 {
-   uint8_t tok;
-   uint64_t frame_len;
    runloop_state_t *runloop_st = runloop_state_get_ptr();
    bool paused = !!(runloop_st->flags & RUNLOOP_FLAG_PAUSED) || consider_paused;
-   /* Skip to prev would prefer to go back at least 30 frames
-      if rewinding when not paused, but won't skip over more
-      than one checkpoint while going backwards. */
-   const int64_t prev_skip_min_distance    = 30;
-   int64_t target_frame = frame, cur_frame = 0;
-   int64_t initial_pos, cp_pos = -1, cp_frame = -1;
-   int64_t maybe_last_frame = -1, maybe_last_pos = -1;
-   if (!movie || movie->version == 0)
-      return false;
-   initial_pos = intfstream_tell(movie->file);
-   /* Find the right checkpoint to jump to.
-      In the future, backrefs could be used to make this faster */
-   intfstream_seek(movie->file, movie->min_file_pos, SEEK_SET);
-   while (cur_frame < target_frame && bsv_movie_peek_frame_info(movie, &tok, &frame_len))
-   {
-      if (tok == REPLAY_TOKEN_INVALID)
-         break;
-      if (tok == REPLAY_TOKEN_CHECKPOINT_FRAME || tok == REPLAY_TOKEN_CHECKPOINT2_FRAME)
-      {
-         if (target_frame - cur_frame >= prev_skip_min_distance || paused)
-         {
-            cp_pos   = intfstream_tell(movie->file);
-            cp_frame = cur_frame;
-         }
-         else
-         {
-            if (maybe_last_pos > 0)
-            {
-               cp_pos   = maybe_last_pos;
-               cp_frame = maybe_last_frame;
-            }
-            maybe_last_pos   = intfstream_tell(movie->file);
-            maybe_last_frame = cur_frame;
-         }
-      }
-      cur_frame += 1;
-      intfstream_seek(movie->file, frame_len, SEEK_CUR);
-   }
-   if (cp_pos_out)
-      *cp_pos_out = cp_pos;
-   if (cp_frame_out)
-      *cp_frame_out = cp_frame;
-   intfstream_seek(movie->file, initial_pos, SEEK_SET);
-   return cp_frame;
+   return bsv_movie_find_checkpoint_before(movie, frame, paused,
+         cp_pos_out, cp_frame_out);
 }
 
 
@@ -314,13 +203,13 @@ bool bsv_movie_reset_playback(bsv_movie_t *handle)
    else if (vsn >= 2)
    {
       uint8_t compression, encoding;
-#ifdef HAVE_STATESTREAM
       uint32_t commit_settings = header[REPLAY_HEADER_CHECKPOINT_CONFIG_INDEX];
+      handle->checkpoint_compression = (commit_settings >> 8) & 0x000000FF;
+#ifdef HAVE_STATESTREAM
       uint32_t superblock_size = swap_if_big32(header[REPLAY_HEADER_SUPERBLOCK_SIZE_INDEX]);
       uint32_t block_size      = swap_if_big32(header[REPLAY_HEADER_BLOCK_SIZE_INDEX]);
       handle->commit_interval  = commit_settings >> 24;
       handle->commit_threshold = (commit_settings >> 16) & 0x000000FF;
-      handle->checkpoint_compression = (commit_settings >> 8) & 0x000000FF;
       if (handle->superblocks)
          uint32s_index_free(handle->superblocks);
       handle->superblocks = uint32s_index_new(superblock_size,handle->commit_interval,handle->commit_threshold);
@@ -341,6 +230,13 @@ bool bsv_movie_reset_recording(bsv_movie_t *handle)
 {
    size_t state_size, state_size_;
    uint8_t compression   = handle->checkpoint_compression;
+#ifdef HAVE_ZSTD
+   /* Nothing to refer to yet, and keeping the initial state in a
+      format older versions know lets them still play the replay. */
+   if (compression == REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT)
+      compression = REPLAY_CHECKPOINT2_COMPRESSION_ZSTD;
+   bsv_movie_dict_clear(handle);
+#endif
 #if HAVE_STATESTREAM
    uint8_t encoding      = REPLAY_CHECKPOINT2_ENCODING_STATESTREAM;
    /* If recording, we simply reset
@@ -360,6 +256,7 @@ bool bsv_movie_reset_recording(bsv_movie_t *handle)
    handle->frame_counter = 0;
    state_size = 2 + bsv_movie_write_checkpoint(handle, compression, encoding);
    handle->min_file_pos = intfstream_tell(handle->file);
+   bsv_movie_index_clear(handle);
    /* Have to write initial state size header too */
    state_size_ = swap_if_big32(state_size);
    intfstream_seek(handle->file, 3*sizeof(uint32_t), SEEK_SET);
@@ -419,7 +316,10 @@ void bsv_movie_frame_rewind(void)
          uint32s_index_remove_after(handle->blocks, 0);
 #endif
       if (recording)
+      {
          intfstream_truncate(handle->file, (int)handle->min_file_pos);
+         bsv_movie_index_truncate(handle, handle->min_file_pos);
+      }
       else
          bsv_movie_read_next_events(handle, REPLAY_CPBEHAVIOR_DESERIALIZE, true);
    }
@@ -444,7 +344,10 @@ void bsv_movie_frame_rewind(void)
 #endif
       intfstream_seek(handle->file, (int)handle->frame_pos[handle->frame_counter & handle->frame_mask], SEEK_SET);
       if (recording)
+      {
          intfstream_truncate(handle->file, intfstream_tell(handle->file));
+         bsv_movie_index_truncate(handle, intfstream_tell(handle->file));
+      }
       else
          bsv_movie_read_next_events(handle, REPLAY_CPBEHAVIOR_DESERIALIZE, true);
    }
@@ -523,6 +426,14 @@ bool bsv_movie_load_checkpoint(bsv_movie_t *handle, uint8_t compression,
    input_driver_state_t *input_st = input_state_get_ptr();
    uint8_t *compressed_data = NULL, *encoded_data = NULL;
    bool ret = true;
+#ifdef HAVE_ZSTD
+   /* Identifies this checkpoint as a compression reference */
+   int64_t payload_pos = intfstream_tell(handle->file);
+   bool keep_reference = handle->checkpoint_compression
+      == REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT;
+#else
+   bool keep_reference = false;
+#endif
    if (intfstream_read(handle->file, &(size),
                sizeof(uint32_t)) != sizeof(uint32_t))
    {
@@ -547,9 +458,12 @@ bool bsv_movie_load_checkpoint(bsv_movie_t *handle, uint8_t compression,
    size         = swap_if_big32(size);
    encoded_size = swap_if_big32(encoded_size);
    compressed_encoded_size = swap_if_big32(compressed_encoded_size);
+   /* Raw checkpoints only need decoding to be deserialized,
+      unless later checkpoints are compressed against them. */
    if (       checkpoint_behavior == REPLAY_CPBEHAVIOR_SKIP
          || ((checkpoint_behavior == REPLAY_CPBEHAVIOR_UPDATE)
-         &&    encoding == REPLAY_CHECKPOINT2_ENCODING_RAW))
+         &&    encoding == REPLAY_CHECKPOINT2_ENCODING_RAW
+         &&   !keep_reference))
    {
       intfstream_seek(handle->file, compressed_encoded_size, SEEK_CUR);
       goto exit;
@@ -620,6 +534,16 @@ bool bsv_movie_load_checkpoint(bsv_movie_t *handle, uint8_t compression,
                }
             break;
          }
+      case REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT:
+         encoded_data = (uint8_t*)malloc(encoded_size);
+         if (!encoded_data || !bsv_movie_dict_decompress(handle,
+                  compressed_data, compressed_encoded_size,
+                  encoded_data, encoded_size))
+         {
+            ret = false;
+            goto exit;
+         }
+         break;
 #endif
       default:
          RARCH_WARN("[Replay] Unrecognized compression scheme %d\n", compression);
@@ -652,6 +576,10 @@ bool bsv_movie_load_checkpoint(bsv_movie_t *handle, uint8_t compression,
          ret = false;
          goto exit;
    }
+#ifdef HAVE_ZSTD
+   if (keep_reference)
+      bsv_movie_dict_store(handle, payload_pos, handle->cur_save, size);
+#endif
    if (checkpoint_behavior != REPLAY_CPBEHAVIOR_DESERIALIZE)
       goto exit;
    handle->checkpoint_ready = true;
@@ -675,6 +603,9 @@ int64_t bsv_movie_write_checkpoint(bsv_movie_t *handle, uint8_t compression, uin
    uint8_t *encoded_data = NULL, *compressed_encoded_data = NULL;
    bool owns_encoded = false, owns_compressed_encoded = false;
    retro_ctx_serialize_info_t serial_info;
+#ifdef HAVE_ZSTD
+   int64_t payload_pos = intfstream_tell(handle->file);
+#endif
    serial_info.size = core_serialize_size();
    if (handle->cur_save_size < serial_info.size)
    {
@@ -702,8 +633,14 @@ int64_t bsv_movie_write_checkpoint(bsv_movie_t *handle, uint8_t compression, uin
          encoded_size = (uint32_t)(serial_info.size + serial_info.size / 2);
          encoded_data = (uint8_t*)malloc(encoded_size);
          owns_encoded = true;
-         encoded_size = (uint32_t)bsv_movie_write_deduped_state(handle, (uint8_t*)serial_info.data,
-               serial_info.size, encoded_data, encoded_size);
+         {
+            int64_t written = bsv_movie_write_deduped_state(handle,
+                  (uint8_t*)serial_info.data, serial_info.size,
+                  encoded_data, encoded_size);
+            if (written < 0)
+               goto exit;
+            encoded_size = (uint32_t)written;
+         }
          break;
 #endif
       default:
@@ -748,6 +685,25 @@ int64_t bsv_movie_write_checkpoint(bsv_movie_t *handle, uint8_t compression, uin
          compressed_encoded_size = (uint32_t)compressed_encoded_size_zstd;
          break;
       }
+      case REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT:
+      {
+         int64_t compressed_encoded_size_dict;
+         size_t capacity         = bsv_movie_dict_bound(encoded_size);
+         compressed_encoded_data = (uint8_t*)malloc(capacity);
+         owns_compressed_encoded = true;
+         if (!compressed_encoded_data)
+            goto exit;
+         compressed_encoded_size_dict = bsv_movie_dict_compress(handle,
+               payload_pos, encoded_data, encoded_size,
+               compressed_encoded_data, capacity);
+         if (compressed_encoded_size_dict < 0)
+         {
+            ret = -1;
+            goto exit;
+         }
+         compressed_encoded_size = (uint32_t)compressed_encoded_size_dict;
+         break;
+      }
 #endif
       default:
          RARCH_WARN("[Replay] Unrecognized compression scheme %d\n", compression);
@@ -782,6 +738,11 @@ int64_t bsv_movie_write_checkpoint(bsv_movie_t *handle, uint8_t compression, uin
       goto exit;
    }
    ret = 3 * sizeof(uint32_t) + compressed_encoded_size;
+#ifdef HAVE_ZSTD
+   if (handle->checkpoint_compression == REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT)
+      bsv_movie_dict_store(handle, payload_pos,
+            (const uint8_t*)serial_info.data, serial_info.size);
+#endif
 exit:
    size_swap              = handle->cur_save_size;
    handle->cur_save_size  = handle->last_save_size;
@@ -1035,6 +996,11 @@ void bsv_movie_next_frame(input_driver_state_t *input_st)
       size_t last_pos        = handle->frame_pos[(MAX(handle->frame_counter,2)-2) & handle->frame_mask];
       size_t cur_pos         = intfstream_tell(handle->file);
       uint32_t back_distance = swap_if_big32((uint32_t)(cur_pos-last_pos));
+      bool checkpoint        = false;
+#ifdef HAVE_ZSTD
+      /* Checkpoints from here on are about to be overwritten */
+      bsv_movie_dict_truncate(handle, cur_pos);
+#endif
       /* write backref */
       intfstream_write(handle->file, &back_distance, sizeof(uint32_t));
       /* write key events, frame is over */
@@ -1066,6 +1032,7 @@ void bsv_movie_next_frame(input_driver_state_t *input_st)
          uint8_t encoding    = REPLAY_CHECKPOINT2_ENCODING_RAW;
 #endif
          input_st->bsv_movie_state.flags &= ~BSV_FLAG_MOVIE_FORCE_CHECKPOINT;
+         checkpoint = true;
          /* "next frame is a checkpoint" */
          intfstream_write(handle->file, (uint8_t *)(&frame_tok), sizeof(uint8_t));
          /* compression and encoding schemes */
@@ -1088,6 +1055,8 @@ void bsv_movie_next_frame(input_driver_state_t *input_st)
          running a frame to get the updated image, then will pause
          again" state. */
       intfstream_truncate(handle->file, intfstream_tell(handle->file));
+      bsv_movie_index_push(handle, cur_pos, intfstream_tell(handle->file),
+            checkpoint);
    }
    else /* either playback or seeking while recording */
    {
@@ -1455,6 +1424,10 @@ bool replay_set_serialized_data(void *buf)
 #endif
             intfstream_rewind(handle->file);
             intfstream_write(handle->file, header, loaded_len);
+            bsv_movie_index_clear(handle);
+#ifdef HAVE_ZSTD
+            bsv_movie_dict_clear(handle);
+#endif
             /* also need to update/reinit frame_pos,
                frame_counter--rewind won't work properly unless we do. */
             /* TODO: in the future, if same_timeline, don't clear
@@ -1477,7 +1450,13 @@ bool replay_set_serialized_data(void *buf)
             /* TODO use backrefs to help here */
             bsv_movie_scan_from_start(handle, loaded_len);
             if (recording)
+            {
                intfstream_truncate(handle->file, loaded_len);
+               bsv_movie_index_truncate(handle, loaded_len);
+#ifdef HAVE_ZSTD
+               bsv_movie_dict_truncate(handle, loaded_len);
+#endif
+            }
          }
       }
       else
@@ -1545,359 +1524,6 @@ int16_t bsv_movie_read_state(input_driver_state_t *input_st,
    return 0;
 }
 
-#ifdef HAVE_STATESTREAM
-int64_t bsv_movie_write_deduped_state(bsv_movie_t *movie, uint8_t *state,
-      size_t state_size, uint8_t *output, size_t output_capacity)
-{
-   uint32_t i;
-   int64_t encoded_size;
-   size_t superblock, block;
-   static uint32_t skipped_blocks     = 0;
-   static uint32_t memcmps            = 0, hashes = 0;
-   static uint32_t reused_blocks      = 0;
-   static uint32_t reused_superblocks = 0;
-   static uint32_t total_blocks       = 0;
-   static uint32_t total_superblocks  = 0;
-   static uint32_t total_checkpoints  = 0;
-   static uint32_t total_kbs_input    = 0;
-   static uint32_t total_kbs_written  = 0;
-   static retro_perf_tick_t total_encode_micros = 0;
-   retro_perf_tick_t start     = cpu_features_get_time_usec();
-   size_t block_byte_size      = movie->blocks->object_size*4;
-   size_t superblock_size      = movie->superblocks->object_size;
-   size_t superblock_byte_size = superblock_size*block_byte_size;
-   size_t superblock_count     = state_size / superblock_byte_size + (state_size % superblock_byte_size != 0);
-   uint32_t *superblock_buf    = (uint32_t*)calloc(superblock_size, sizeof(uint32_t));
-   uint8_t *padded_block       = NULL;
-   intfstream_t *out_stream    = intfstream_open_writable_memory(output,
-         RETRO_VFS_FILE_ACCESS_READ_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE,
-         output_capacity);
-   bool can_compare_saves = movie->cur_save_valid && movie->last_save
-      && movie->last_save_size >= state_size;
-   if (movie->last_save_size < state_size)
-   {
-      free(movie->superblock_seq);
-      movie->superblock_seq = NULL;
-   }
-   if (!movie->superblock_seq)
-   {
-      movie->cur_save_valid = false;
-      movie->superblock_seq = (uint32_t*)calloc(superblock_count, sizeof(uint32_t));
-   }
-   rmsgpack_write_int(out_stream, BSV_IFRAME_START_TOKEN);
-   rmsgpack_write_int(out_stream, movie->frame_counter);
-   for (superblock = 0; superblock < superblock_count; superblock++)
-   {
-      uint32s_insert_result_t found_block;
-      total_superblocks++;
-      for (block = 0; block < superblock_size; block++)
-      {
-         size_t block_start = superblock*superblock_byte_size+block*block_byte_size;
-         size_t block_end = MIN(block_start + block_byte_size, state_size);
-         if (block_start > state_size)
-         {
-            /* pad superblocks with zero blocks */
-            found_block.index  = 0;
-            found_block.is_new = false;
-         }
-         else if (   can_compare_saves
-                  && (++memcmps)
-                  && memcmp(movie->last_save + block_start,
-                         state + block_start,
-                         block_end-block_start) == 0)
-         {
-            skipped_blocks++;
-            found_block.index = uint32s_index_get(movie->superblocks,
-                  movie->superblock_seq[superblock])[block];
-            found_block.is_new = false;
-            /* bump usage count */
-            uint32s_index_bump_count(movie->blocks, found_block.index);
-         }
-         else if (block_start + block_byte_size > state_size)
-         {
-            if (!padded_block)
-               padded_block = (uint8_t*)calloc(block_byte_size, sizeof(uint8_t));
-            else
-               memset(padded_block + (state_size-block_start),
-                     0, block_byte_size-(state_size-block_start));
-            memcpy(padded_block, state+block_start, state_size - block_start);
-            found_block = uint32s_index_insert(movie->blocks,
-                  (uint32_t*)padded_block,
-                  movie->frame_counter);
-            hashes++;
-         }
-         else
-         {
-            hashes++;
-            found_block = uint32s_index_insert(movie->blocks,
-                  (uint32_t*)(state+block_start),
-                  movie->frame_counter);
-         }
-         total_blocks++;
-
-         if (found_block.is_new)
-         {
-            /* write "here is a new block" and new block to file */
-            rmsgpack_write_int(out_stream, BSV_IFRAME_NEW_BLOCK_TOKEN);
-            rmsgpack_write_int(out_stream, found_block.index);
-            /* Cast is fine, a single block can't be super big */
-            rmsgpack_write_bin(out_stream, state+block_start, (uint32_t)block_byte_size);
-         }
-         else
-            reused_blocks++;
-         superblock_buf[block] = found_block.index;
-      }
-      found_block = uint32s_index_insert(movie->superblocks, superblock_buf, movie->frame_counter);
-      if (found_block.is_new)
-      {
-         /* write "here is a new superblock" and new superblock to file */
-         rmsgpack_write_int(out_stream, BSV_IFRAME_NEW_SUPERBLOCK_TOKEN);
-         rmsgpack_write_int(out_stream, found_block.index);
-         /* Cast is fine, a single superblock can't be billions of blocks long */
-         rmsgpack_write_array_header(out_stream, (uint32_t)superblock_size);
-         for (i = 0; i < superblock_size; i++)
-            rmsgpack_write_int(out_stream, superblock_buf[i]);
-      }
-      else
-         reused_superblocks++;
-      movie->superblock_seq[superblock] = found_block.index;
-   }
-   uint32s_index_commit(movie->blocks);
-   /* Superblocks are small enough that there's no real benefit to garbage collecting them */
-   /* uint32s_index_commit(movie->superblocks); */
-   /* write "here is the superblock seq" and superblock seq to file */
-   rmsgpack_write_int(out_stream, BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN);
-   /* Cast is fine, we won't have billions of superblocks */
-   rmsgpack_write_array_header(out_stream, (uint32_t)superblock_count);
-   for (i = 0; i < superblock_count; i++)
-       rmsgpack_write_int(out_stream, movie->superblock_seq[i]);
-   free(superblock_buf);
-   if (padded_block)
-     free(padded_block);
-   movie->cur_save_valid = true;
-   total_checkpoints++;
-   total_encode_micros += cpu_features_get_time_usec() - start;
-   total_kbs_input     += state_size / 1024;
-   encoded_size         = intfstream_tell(out_stream);
-   total_kbs_written   += encoded_size / 1024;
-   RARCH_DBG("[STATESTREAM] Encode stats at checkpoint %d: %d blocks (%d reused, %d skipped [%d checks], %d distinct [%d hashes])\n", total_checkpoints, total_blocks, reused_blocks, skipped_blocks, memcmps, uint32s_index_count(movie->blocks), hashes);
-   RARCH_DBG("[STATESTREAM] %d superblocks (%d reused, %d distinct); unencoded size (KB) %d, encoded size (KB) %d; net time (secs) %f\n", total_superblocks, reused_superblocks, uint32s_index_count(movie->superblocks), total_kbs_input, total_kbs_written, ((float)total_encode_micros) / (float)1000000.0);
-   intfstream_close(out_stream);
-   free(out_stream);
-   return encoded_size;
-}
-
-bool bsv_movie_read_deduped_state(bsv_movie_t *movie, uint8_t *encoded, size_t encoded_size)
-{
-   size_t i;
-   struct rmsgpack_dom_value item;
-   static retro_perf_tick_t total_decode_micros = 0;
-   static retro_perf_tick_t total_decode_count  = 0;
-   retro_perf_tick_t start = cpu_features_get_time_usec();
-   bool ret                = false;
-   size_t state_size       = movie->cur_save_size;
-   struct rmsgpack_dom_reader_state *reader_state = rmsgpack_dom_reader_state_new();
-   size_t block_byte_size      = movie->blocks->object_size*4;
-   size_t superblock_byte_size = movie->superblocks->object_size*block_byte_size;
-   intfstream_t *read_mem      = intfstream_open_memory(encoded,
-         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE, encoded_size);
-   /* NULL-check reader_state: rmsgpack_dom_reader_state_new can
-    * now return NULL on OOM.  Bailing to 'exit' hits the
-    * rmsgpack_dom_reader_state_free call at the cleanup label
-    * (which now tolerates NULL) and returns false; the user-
-    * visible outcome is 'STATESTREAM decode failed' which
-    * matches the existing error paths for a malformed frame. */
-   if (!reader_state)
-   {
-      RARCH_ERR("[STATESTREAM] failed to allocate reader state\n");
-      goto exit;
-   }
-   if (state_size > movie->last_save_size && movie->superblock_seq)
-   {
-      free(movie->superblock_seq);
-      movie->superblock_seq = NULL;
-   }
-   if (!movie->cur_save) {
-      RARCH_ERR("[STATESTREAM] movie has no current serialized save\n");
-      goto exit;
-   }
-   total_decode_count++;
-   rmsgpack_dom_read_with(read_mem, &item, reader_state);
-   if (item.type != RDT_INT && item.type != RDT_UINT)
-   {
-      RARCH_ERR("[STATESTREAM] start token type is wrong\n");
-      goto exit;
-   }
-   if (item.val.uint_ != BSV_IFRAME_START_TOKEN)
-   {
-      RARCH_ERR("[STATESTREAM] start token value is wrong\n");
-      goto exit;
-   }
-   rmsgpack_dom_read_with(read_mem, &item, reader_state);
-   if (item.type != RDT_INT && item.type != RDT_UINT)
-   {
-      RARCH_ERR("[STATESTREAM] frame counter type is wrong\n");
-      goto exit;
-   }
-   /*frame_counter = item.val.uint_;*/
-   while (rmsgpack_dom_read_with(read_mem, &item, reader_state) >= 0)
-   {
-      size_t len;
-      uint32_t index, *superblock;
-      if (item.type != RDT_INT && item.type != RDT_UINT)
-      {
-         RARCH_ERR("[STATESTREAM] state update chunk token type is wrong\n");
-         goto exit;
-      }
-      switch(item.val.uint_)
-      {
-         case BSV_IFRAME_NEW_BLOCK_TOKEN:
-            rmsgpack_dom_read_with(read_mem, &item, reader_state);
-            if (item.type != RDT_INT && item.type != RDT_UINT)
-            {
-               RARCH_ERR("[STATESTREAM] new block index type is wrong\n");
-               goto exit;
-            }
-            /* Block indexes must be 32bit */
-            index = (uint32_t)item.val.uint_;
-            rmsgpack_dom_read_with(read_mem, &item, reader_state);
-            if (item.type != RDT_BINARY)
-            {
-               RARCH_ERR("[STATESTREAM] new block value type is wrong\n");
-               rmsgpack_dom_value_free(&item);
-               goto exit;
-            }
-            if (item.val.binary.len != block_byte_size)
-            {
-               RARCH_ERR("[STATESTREAM] new block binary length is wrong: %d vs %d\n",
-                     item.val.binary.len, block_byte_size);
-               rmsgpack_dom_value_free(&item);
-               goto exit;
-            }
-            if (!uint32s_index_insert_exact(movie->blocks, index,
-                     (uint32_t *)item.val.binary.buff, movie->frame_counter))
-            {
-               RARCH_ERR("[STATESTREAM] couldn't insert new block at right index %d\n", index);
-               rmsgpack_dom_value_free(&item);
-               goto exit;
-            }
-            /* do not free binary rmsgpack item since insert_exact takes over its allocation */
-            break;
-         case BSV_IFRAME_NEW_SUPERBLOCK_TOKEN:
-            rmsgpack_dom_read_with(read_mem, &item, reader_state);
-            if (item.type != RDT_INT && item.type != RDT_UINT)
-            {
-               RARCH_ERR("[STATESTREAM] new superblock index type is wrong\n");
-               goto exit;
-            }
-            /* Block indices are 32-bit */
-            index = (uint32_t)item.val.uint_;
-            if (rmsgpack_dom_read_with(read_mem, &item, reader_state) < 0)
-            {
-               RARCH_ERR("[STATESTREAM] array read failed\n");
-               goto exit;
-            }
-            if (item.type != RDT_ARRAY)
-            {
-               RARCH_ERR("[STATESTREAM] new superblock contents type is wrong\n");
-               goto exit;
-            }
-            if (item.val.array.len != movie->superblocks->object_size)
-            {
-               RARCH_ERR("[STATESTREAM] new superblock contents length is wrong\n");
-               goto exit;
-            }
-            len        = movie->superblocks->object_size;
-            superblock = (uint32_t*)calloc(len, sizeof(uint32_t));
-
-            for (i = 0; i < len; i++)
-            {
-               struct rmsgpack_dom_value inner_item = item.val.array.items[i];
-               /* assert(inner_item.type == RDT_INT || inner_item.type == RDT_UINT); */
-               /* Superblock indices are 32-bit */
-               superblock[i] = (uint32_t)inner_item.val.uint_;
-            }
-            if (!uint32s_index_insert_exact(movie->superblocks, index, superblock, movie->frame_counter))
-            {
-               RARCH_ERR("[STATESTREAM] new superblock couldn't be inserted at right index\n");
-               rmsgpack_dom_value_free(&item);
-               free(superblock);
-               goto exit;
-            }
-            /* Do not free superblock since insert_exact takes over its allocation */
-            rmsgpack_dom_value_free(&item);
-            break;
-         case BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN:
-            rmsgpack_dom_read_with(read_mem, &item, reader_state);
-            if (item.type != RDT_ARRAY)
-            {
-               RARCH_ERR("[STATESTREAM] superblock seq type is wrong\n");
-               goto exit;
-            }
-            len = item.val.array.len;
-            if (!movie->superblock_seq)
-               movie->superblock_seq = (uint32_t*)calloc(len, sizeof(uint32_t));
-            for (i = 0; i < len; i++)
-            {
-               size_t j;
-               uint32_t *superblock;
-               struct rmsgpack_dom_value inner_item = item.val.array.items[i];
-               /* assert(inner_item.type == RDT_INT || inner_item.type == RDT_UINT); */
-               /* Superblock indices are 32-bit */
-               uint32_t superblock_idx = (uint32_t)inner_item.val.uint_;
-               /* if this superblock is the same as last time, no need to scan the blocks. */
-               if (movie->cur_save_valid && movie->cur_save && superblock_idx == movie->superblock_seq[i])
-               {
-                  superblock = uint32s_index_get(movie->superblocks, movie->superblock_seq[i]);
-                  uint32s_index_bump_count(movie->superblocks, movie->superblock_seq[i]);
-                  /* We do need to increment all the involved block counts though */
-                  for (j = 0; j < movie->superblocks->object_size; j++)
-                     uint32s_index_bump_count(movie->blocks, superblock[j]);
-                  continue;
-               }
-               movie->superblock_seq[i] = superblock_idx;
-               superblock = uint32s_index_get(movie->superblocks, superblock_idx);
-               uint32s_index_bump_count(movie->superblocks, superblock_idx);
-               for (j = 0; j < movie->superblocks->object_size; j++)
-               {
-                  uint8_t *block;
-                  uint32_t block_idx = superblock[j];
-                  size_t block_start = MIN(i*superblock_byte_size+j*block_byte_size, state_size);
-                  size_t block_end = MIN(block_start+block_byte_size, state_size);
-                  /* This (==) can only happen in the last superblock, if it was padded with extra blocks. */
-                  if (block_end <= block_start)
-                     break;
-                  block = (uint8_t *)uint32s_index_get(movie->blocks, block_idx);
-                  uint32s_index_bump_count(movie->blocks, block_idx);
-                  memcpy(movie->cur_save+block_start, (uint8_t*)block, block_end-block_start);
-               }
-            }
-            rmsgpack_dom_value_free(&item);
-            ret = true;
-            goto exit;
-         default:
-            RARCH_ERR("[STATESTREAM] state update chunk token value is invalid: %d @ %x\n", item.val.uint_, intfstream_tell(read_mem));
-            goto exit;
-      }
-   }
-exit:
-   uint32s_index_commit(movie->blocks);
-   /* Superblocks are small enough that there's no real benefit to garbage collecting them */
-   /* uint32s_index_commit(movie->superblocks); */
-   rmsgpack_dom_reader_state_free(reader_state);
-   intfstream_close(read_mem);
-   free(read_mem);
-   if (!ret)
-   {
-      RARCH_ERR("[STATESTREAM] made it to end without superblock seq\n");
-      return false;
-   }
-   total_decode_micros += cpu_features_get_time_usec() - start;
-   RARCH_DBG("[STATESTREAM] Total statestream decodes %d ; net time (secs): %f\n", total_decode_count, (double)total_decode_micros / (1000000.0));
-   return ret;
-}
-#endif
-
 bool movie_commit_checkpoint(input_driver_state_t *input_st)
 {
    if (!input_st->bsv_movie_state_handle)
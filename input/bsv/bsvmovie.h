@@ -41,6 +41,27 @@
 #define REPLAY_FORMAT_VERSION            2
 #define REPLAY_MAGIC                     0x42535632
 
+/* Appended to the replay path to name its seek index. */
+#define REPLAY_INDEX_EXTENSION           ".idx"
+
+#ifdef HAVE_STATESTREAM
+#define REPLAY_DEFAULT_COMMIT_INTERVAL 4
+#define REPLAY_DEFAULT_COMMIT_THRESHOLD 2
+
+/* Superblock and block sizes for incremental savestates. */
+#define DEFAULT_SUPERBLOCK_SIZE 16  /* measured in blocks */
+#define DEFAULT_BLOCK_SIZE      16384 /* measured in bytes  */
+
+#define SMALL_STATE_THRESHOLD (1<<20) /* states < 1MB are "small" and are tuned differently */
+#define SMALL_SUPERBLOCK_SIZE 16  /* measured in blocks */
+#define SMALL_BLOCK_SIZE      128 /* measured in bytes  */
+
+/* Block hashing for checkpoints of states this large or
+ * larger is spread over movie->hash_pool, if there is one. */
+#define PARALLEL_HASH_THRESHOLD SMALL_STATE_THRESHOLD
+#define PARALLEL_HASH_MAX_THREADS 8
+#endif
+
 RETRO_BEGIN_DECLS
 
 void bsv_movie_poll(input_driver_state_t *input_st);
@@ -58,6 +79,52 @@ bool bsv_movie_load_checkpoint(bsv_movie_t *movie,
 int64_t bsv_movie_write_checkpoint(bsv_movie_t *movie,
       uint8_t compression, uint8_t encoding);
 
+bool bsv_movie_peek_frame_info(bsv_movie_t *movie,
+      uint8_t *token, uint64_t *len);
+
+/* Seek index over the frame records, see bsvindex.c. */
+void bsv_movie_index_clear(bsv_movie_t *movie);
+void bsv_movie_index_free(bsv_movie_t *movie);
+void bsv_movie_index_truncate(bsv_movie_t *movie, int64_t pos);
+void bsv_movie_index_push(bsv_movie_t *movie, int64_t pos, int64_t end,
+      bool checkpoint);
+bool bsv_movie_index_extend(bsv_movie_t *movie, uint64_t records);
+int64_t bsv_movie_index_find_record(const bsv_movie_t *movie, int64_t pos);
+size_t bsv_movie_index_checkpoints_before(const bsv_movie_t *movie,
+      uint64_t record);
+int64_t bsv_movie_index_checkpoint_before(const bsv_movie_t *movie,
+      int64_t frame, bool paused);
+/* Checkpoint a seek to 'frame' starts from, extending the index
+ * as far as needed; false if there is none. */
+bool bsv_movie_find_checkpoint_before(bsv_movie_t *movie, int64_t frame,
+      bool paused, int64_t *cp_pos_out, int64_t *cp_frame_out);
+bool bsv_movie_index_load(bsv_movie_t *movie, const char *path);
+bool bsv_movie_index_save(bsv_movie_t *movie, const char *path);
+
+#ifdef HAVE_ZSTD
+/* Reference states for REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT,
+ * see bsvdict.c. */
+void bsv_movie_dict_clear(bsv_movie_t *movie);
+void bsv_movie_dict_truncate(bsv_movie_t *movie, int64_t pos);
+void bsv_movie_dict_free(bsv_movie_t *movie);
+bool bsv_movie_dict_store(bsv_movie_t *movie, int64_t pos,
+      const uint8_t *state, size_t size);
+size_t bsv_movie_dict_bound(size_t src_size);
+int64_t bsv_movie_dict_compress(bsv_movie_t *movie, int64_t pos,
+      const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+bool bsv_movie_dict_decompress(bsv_movie_t *movie,
+      const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_size);
+#endif
+
+#ifdef HAVE_STATESTREAM
+/* Incremental (block-deduplicated) checkpoint codec,
+ * see bsvstatestream.c. */
+int64_t bsv_movie_write_deduped_state(bsv_movie_t *movie, uint8_t *state,
+      size_t state_size, uint8_t *output, size_t output_capacity);
+bool bsv_movie_read_deduped_state(bsv_movie_t *movie,
+      uint8_t *encoded, size_t encoded_size);
+#endif
+
 RETRO_END_DECLS
 
 #endif /* __BSV_MOVIE__H */
@@ -0,0 +1,535 @@
+/**
+ *  RetroArch - A frontend for libretro.
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with RetroArch. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifdef HAVE_STATESTREAM
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <streams/interface_stream.h>
+#ifdef HAVE_THREADS
+#include <rthreads/tpool.h>
+#endif
+
+#include "bsvmovie.h"
+#include "uint32s_index.h"
+#include "../../libretro-db/rmsgpack.h"
+#include "../../libretro-db/rmsgpack_dom.h"
+#include "../../verbosity.h"
+
+#define BSV_IFRAME_START_TOKEN 0x00
+/* after START:
+   frame counter uint
+   state size (uncompressed) uint
+   new block and new superblock data (see below)
+   superblock seq (see below)
+ */
+#define BSV_IFRAME_NEW_BLOCK_TOKEN 0x01
+/* after NEW_BLOCK:
+   index uint
+   binary
+ */
+#define BSV_IFRAME_NEW_SUPERBLOCK_TOKEN 0x02
+/* after NEW_SUPERBLOCK:
+   index uint
+   array of uints
+*/
+#define BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN 0x03
+/* after SUPERBLOCK_SEQ:
+   array of uints
+   */
+
+/* Later, tokens for pframes */
+
+/* How each block of a checkpoint is handled, decided up front
+ * so that the expensive part (comparing and hashing) can run on
+ * several threads while the index is still updated in order. */
+enum bsv_block_kind
+{
+   BSV_BLOCK_PAD = 0, /* past the end of the state: all-zeros block */
+   BSV_BLOCK_SAME,    /* unchanged since the last checkpoint */
+   BSV_BLOCK_PARTIAL, /* straddles the end of the state */
+   BSV_BLOCK_HASHED   /* full block, hash precomputed */
+};
+
+struct bsv_block_job
+{
+   const bsv_movie_t *movie;
+   const uint8_t *state;
+   uint8_t *kinds;
+   uint32_t *hashes;
+   size_t state_size;
+   size_t first, last; /* block range, global block numbers */
+   bool can_compare_saves;
+};
+
+/* Only reads the movie and the state, so any number of these
+ * may run at once on disjoint block ranges. */
+static void bsv_movie_classify_blocks(void *data)
+{
+   size_t n;
+   struct bsv_block_job *job = (struct bsv_block_job*)data;
+   size_t block_byte_size    = job->movie->blocks->object_size*4;
+   for (n = job->first; n < job->last; n++)
+   {
+      size_t block_start = n*block_byte_size;
+      size_t block_end   = MIN(block_start + block_byte_size, job->state_size);
+      if (block_start > job->state_size)
+         job->kinds[n]  = BSV_BLOCK_PAD;
+      else if (   job->can_compare_saves
+               && memcmp(job->movie->last_save + block_start,
+                      job->state + block_start,
+                      block_end-block_start) == 0)
+         job->kinds[n]  = BSV_BLOCK_SAME;
+      else if (block_start + block_byte_size > job->state_size)
+         job->kinds[n]  = BSV_BLOCK_PARTIAL;
+      else
+      {
+         job->kinds[n]  = BSV_BLOCK_HASHED;
+         job->hashes[n] = uint32s_index_hash(job->movie->blocks,
+               (const uint32_t*)(job->state + block_start));
+      }
+   }
+}
+
+#ifdef HAVE_THREADS
+#define BSV_BLOCK_JOBS (PARALLEL_HASH_MAX_THREADS*4)
+
+/* Classifies every block in 'whole' on the hash pool and
+ * waits for the result. */
+static void bsv_movie_classify_blocks_parallel(const struct bsv_block_job *whole)
+{
+   size_t i;
+   struct bsv_block_job jobs[BSV_BLOCK_JOBS];
+   size_t count = whole->last - whole->first;
+   size_t per   = (count + BSV_BLOCK_JOBS - 1) / BSV_BLOCK_JOBS;
+   bool queued  = false;
+   for (i = 0; i < BSV_BLOCK_JOBS; i++)
+   {
+      jobs[i]       = *whole;
+      jobs[i].first = MIN(whole->first + i*per, whole->last);
+      jobs[i].last  = MIN(jobs[i].first + per, whole->last);
+      if (jobs[i].first == jobs[i].last)
+         break;
+      if (tpool_add_work(whole->movie->hash_pool,
+               bsv_movie_classify_blocks, &jobs[i]))
+         queued = true;
+      else /* do it here rather than lose it */
+         bsv_movie_classify_blocks(&jobs[i]);
+   }
+   if (queued)
+      tpool_wait(whole->movie->hash_pool);
+}
+#endif
+
+int64_t bsv_movie_write_deduped_state(bsv_movie_t *movie, uint8_t *state,
+      size_t state_size, uint8_t *output, size_t output_capacity)
+{
+   uint32_t i;
+   int64_t encoded_size;
+   size_t superblock, block;
+   struct bsv_block_job job;
+   static uint32_t skipped_blocks     = 0;
+   static uint32_t memcmps            = 0, hashes = 0;
+   static uint32_t reused_blocks      = 0;
+   static uint32_t reused_superblocks = 0;
+   static uint32_t total_blocks       = 0;
+   static uint32_t total_superblocks  = 0;
+   static uint32_t total_checkpoints  = 0;
+   static uint32_t total_kbs_input    = 0;
+   static uint32_t total_kbs_written  = 0;
+   static retro_perf_tick_t total_encode_micros = 0;
+   retro_perf_tick_t start     = cpu_features_get_time_usec();
+   size_t block_byte_size      = movie->blocks->object_size*4;
+   size_t superblock_size      = movie->superblocks->object_size;
+   size_t superblock_byte_size = superblock_size*block_byte_size;
+   size_t superblock_count     = state_size / superblock_byte_size + (state_size % superblock_byte_size != 0);
+   size_t block_count          = superblock_count*superblock_size;
+   uint32_t *superblock_buf    = (uint32_t*)calloc(superblock_size, sizeof(uint32_t));
+   uint8_t *block_kinds        = (uint8_t*)malloc(block_count);
+   uint32_t *block_hashes      = (uint32_t*)malloc(block_count*sizeof(uint32_t));
+   uint8_t *padded_block       = NULL;
+   bool classified             = false;
+   intfstream_t *out_stream    = intfstream_open_writable_memory(output,
+         RETRO_VFS_FILE_ACCESS_READ_WRITE, RETRO_VFS_FILE_ACCESS_HINT_NONE,
+         output_capacity);
+   bool can_compare_saves = movie->cur_save_valid && movie->last_save
+      && movie->last_save_size >= state_size;
+   if (!superblock_buf || !block_kinds || !block_hashes || !out_stream)
+   {
+      RARCH_ERR("[STATESTREAM] failed to allocate encoder buffers\n");
+      free(superblock_buf);
+      free(block_kinds);
+      free(block_hashes);
+      if (out_stream)
+      {
+         intfstream_close(out_stream);
+         free(out_stream);
+      }
+      return -1;
+   }
+   if (movie->last_save_size < state_size)
+   {
+      free(movie->superblock_seq);
+      movie->superblock_seq = NULL;
+   }
+   if (!movie->superblock_seq)
+   {
+      movie->cur_save_valid = false;
+      movie->superblock_seq = (uint32_t*)calloc(superblock_count, sizeof(uint32_t));
+   }
+   job.movie             = movie;
+   job.state             = state;
+   job.kinds             = block_kinds;
+   job.hashes            = block_hashes;
+   job.state_size        = state_size;
+   job.can_compare_saves = can_compare_saves;
+#ifdef HAVE_THREADS
+   /* Large states get all their blocks compared and hashed up
+    * front on the pool; the results are then merged into the
+    * index in block order below, exactly as the serial path
+    * does, so the encoded checkpoint is the same either way. */
+   if (movie->hash_pool && state_size >= PARALLEL_HASH_THRESHOLD)
+   {
+      job.first  = 0;
+      job.last   = block_count;
+      bsv_movie_classify_blocks_parallel(&job);
+      classified = true;
+   }
+#endif
+   rmsgpack_write_int(out_stream, BSV_IFRAME_START_TOKEN);
+   rmsgpack_write_int(out_stream, movie->frame_counter);
+   for (superblock = 0; superblock < superblock_count; superblock++)
+   {
+      uint32s_insert_result_t found_block;
+      total_superblocks++;
+      if (!classified)
+      {
+         /* One superblock at a time, so it is still in cache for
+          * the inserts */
+         job.first = superblock*superblock_size;
+         job.last  = job.first + superblock_size;
+         bsv_movie_classify_blocks(&job);
+      }
+      for (block = 0; block < superblock_size; block++)
+      {
+         size_t n           = superblock*superblock_size+block;
+         size_t block_start = n*block_byte_size;
+         if (can_compare_saves && block_kinds[n] != BSV_BLOCK_PAD)
+            memcmps++;
+         switch (block_kinds[n])
+         {
+            case BSV_BLOCK_PAD:
+               /* pad superblocks with zero blocks */
+               found_block.index  = 0;
+               found_block.is_new = false;
+               break;
+            case BSV_BLOCK_SAME:
+               skipped_blocks++;
+               found_block.index = uint32s_index_get(movie->superblocks,
+                     movie->superblock_seq[superblock])[block];
+               found_block.is_new = false;
+               /* bump usage count */
+               uint32s_index_bump_count(movie->blocks, found_block.index);
+               break;
+            case BSV_BLOCK_PARTIAL:
+               if (!padded_block)
+                  padded_block = (uint8_t*)calloc(block_byte_size, sizeof(uint8_t));
+               else
+                  memset(padded_block + (state_size-block_start),
+                        0, block_byte_size-(state_size-block_start));
+               memcpy(padded_block, state+block_start, state_size - block_start);
+               found_block = uint32s_index_insert(movie->blocks,
+                     (uint32_t*)padded_block,
+                     movie->frame_counter);
+               hashes++;
+               break;
+            default:
+               hashes++;
+               found_block = uint32s_index_insert_hashed(movie->blocks,
+                     (uint32_t*)(state+block_start), block_hashes[n],
+                     movie->frame_counter);
+               break;
+         }
+         total_blocks++;
+
+         if (found_block.is_new)
+         {
+            /* write "here is a new block" and new block to file */
+            rmsgpack_write_int(out_stream, BSV_IFRAME_NEW_BLOCK_TOKEN);
+            rmsgpack_write_int(out_stream, found_block.index);
+            /* Cast is fine, a single block can't be super big */
+            rmsgpack_write_bin(out_stream, state+block_start, (uint32_t)block_byte_size);
+         }
+         else
+            reused_blocks++;
+         superblock_buf[block] = found_block.index;
+      }
+      found_block = uint32s_index_insert(movie->superblocks, superblock_buf, movie->frame_counter);
+      if (found_block.is_new)
+      {
+         /* write "here is a new superblock" and new superblock to file */
+         rmsgpack_write_int(out_stream, BSV_IFRAME_NEW_SUPERBLOCK_TOKEN);
+         rmsgpack_write_int(out_stream, found_block.index);
+         /* Cast is fine, a single superblock can't be billions of blocks long */
+         rmsgpack_write_array_header(out_stream, (uint32_t)superblock_size);
+         for (i = 0; i < superblock_size; i++)
+            rmsgpack_write_int(out_stream, superblock_buf[i]);
+      }
+      else
+         reused_superblocks++;
+      movie->superblock_seq[superblock] = found_block.index;
+   }
+   uint32s_index_commit(movie->blocks);
+   /* Superblocks are small enough that there's no real benefit to garbage collecting them */
+   /* uint32s_index_commit(movie->superblocks); */
+   /* write "here is the superblock seq" and superblock seq to file */
+   rmsgpack_write_int(out_stream, BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN);
+   /* Cast is fine, we won't have billions of superblocks */
+   rmsgpack_write_array_header(out_stream, (uint32_t)superblock_count);
+   for (i = 0; i < superblock_count; i++)
+       rmsgpack_write_int(out_stream, movie->superblock_seq[i]);
+   free(superblock_buf);
+   free(block_kinds);
+   free(block_hashes);
+   if (padded_block)
+     free(padded_block);
+   movie->cur_save_valid = true;
+   total_checkpoints++;
+   total_encode_micros += cpu_features_get_time_usec() - start;
+   total_kbs_input     += state_size / 1024;
+   encoded_size         = intfstream_tell(out_stream);
+   total_kbs_written   += encoded_size / 1024;
+   RARCH_DBG("[STATESTREAM] Encode stats at checkpoint %d: %d blocks (%d reused, %d skipped [%d checks], %d distinct [%d hashes])\n", total_checkpoints, total_blocks, reused_blocks, skipped_blocks, memcmps, uint32s_index_count(movie->blocks), hashes);
+   RARCH_DBG("[STATESTREAM] %d superblocks (%d reused, %d distinct); unencoded size (KB) %d, encoded size (KB) %d; net time (secs) %f\n", total_superblocks, reused_superblocks, uint32s_index_count(movie->superblocks), total_kbs_input, total_kbs_written, ((float)total_encode_micros) / (float)1000000.0);
+   intfstream_close(out_stream);
+   free(out_stream);
+   return encoded_size;
+}
+
+bool bsv_movie_read_deduped_state(bsv_movie_t *movie, uint8_t *encoded, size_t encoded_size)
+{
+   size_t i;
+   struct rmsgpack_dom_value item;
+   static retro_perf_tick_t total_decode_micros = 0;
+   static retro_perf_tick_t total_decode_count  = 0;
+   retro_perf_tick_t start = cpu_features_get_time_usec();
+   bool ret                = false;
+   size_t state_size       = movie->cur_save_size;
+   struct rmsgpack_dom_reader_state *reader_state = rmsgpack_dom_reader_state_new();
+   size_t block_byte_size      = movie->blocks->object_size*4;
+   size_t superblock_byte_size = movie->superblocks->object_size*block_byte_size;
+   intfstream_t *read_mem      = intfstream_open_memory(encoded,
+         RETRO_VFS_FILE_ACCESS_READ, RETRO_VFS_FILE_ACCESS_HINT_NONE, encoded_size);
+   /* NULL-check reader_state: rmsgpack_dom_reader_state_new can
+    * now return NULL on OOM.  Bailing to 'exit' hits the
+    * rmsgpack_dom_reader_state_free call at the cleanup label
+    * (which now tolerates NULL) and returns false; the user-
+    * visible outcome is 'STATESTREAM decode failed' which
+    * matches the existing error paths for a malformed frame. */
+   if (!reader_state)
+   {
+      RARCH_ERR("[STATESTREAM] failed to allocate reader state\n");
+      goto exit;
+   }
+   if (state_size > movie->last_save_size && movie->superblock_seq)
+   {
+      free(movie->superblock_seq);
+      movie->superblock_seq = NULL;
+   }
+   if (!movie->cur_save) {
+      RARCH_ERR("[STATESTREAM] movie has no current serialized save\n");
+      goto exit;
+   }
+   total_decode_count++;
+   rmsgpack_dom_read_with(read_mem, &item, reader_state);
+   if (item.type != RDT_INT && item.type != RDT_UINT)
+   {
+      RARCH_ERR("[STATESTREAM] start token type is wrong\n");
+      goto exit;
+   }
+   if (item.val.uint_ != BSV_IFRAME_START_TOKEN)
+   {
+      RARCH_ERR("[STATESTREAM] start token value is wrong\n");
+      goto exit;
+   }
+   rmsgpack_dom_read_with(read_mem, &item, reader_state);
+   if (item.type != RDT_INT && item.type != RDT_UINT)
+   {
+      RARCH_ERR("[STATESTREAM] frame counter type is wrong\n");
+      goto exit;
+   }
+   /*frame_counter = item.val.uint_;*/
+   while (rmsgpack_dom_read_with(read_mem, &item, reader_state) >= 0)
+   {
+      size_t len;
+      uint32_t index, *superblock;
+      if (item.type != RDT_INT && item.type != RDT_UINT)
+      {
+         RARCH_ERR("[STATESTREAM] state update chunk token type is wrong\n");
+         goto exit;
+      }
+      switch(item.val.uint_)
+      {
+         case BSV_IFRAME_NEW_BLOCK_TOKEN:
+            rmsgpack_dom_read_with(read_mem, &item, reader_state);
+            if (item.type != RDT_INT && item.type != RDT_UINT)
+            {
+               RARCH_ERR("[STATESTREAM] new block index type is wrong\n");
+               goto exit;
+            }
+            /* Block indexes must be 32bit */
+            index = (uint32_t)item.val.uint_;
+            rmsgpack_dom_read_with(read_mem, &item, reader_state);
+            if (item.type != RDT_BINARY)
+            {
+               RARCH_ERR("[STATESTREAM] new block value type is wrong\n");
+               rmsgpack_dom_value_free(&item);
+               goto exit;
+            }
+            if (item.val.binary.len != block_byte_size)
+            {
+               RARCH_ERR("[STATESTREAM] new block binary length is wrong: %d vs %d\n",
+                     item.val.binary.len, block_byte_size);
+               rmsgpack_dom_value_free(&item);
+               goto exit;
+            }
+            if (!uint32s_index_insert_exact(movie->blocks, index,
+                     (uint32_t *)item.val.binary.buff, movie->frame_counter))
+            {
+               RARCH_ERR("[STATESTREAM] couldn't insert new block at right index %d\n", index);
+               rmsgpack_dom_value_free(&item);
+               goto exit;
+            }
+            /* do not free binary rmsgpack item since insert_exact takes over its allocation */
+            break;
+         case BSV_IFRAME_NEW_SUPERBLOCK_TOKEN:
+            rmsgpack_dom_read_with(read_mem, &item, reader_state);
+            if (item.type != RDT_INT && item.type != RDT_UINT)
+            {
+               RARCH_ERR("[STATESTREAM] new superblock index type is wrong\n");
+               goto exit;
+            }
+            /* Block indices are 32-bit */
+            index = (uint32_t)item.val.uint_;
+            if (rmsgpack_dom_read_with(read_mem, &item, reader_state) < 0)
+            {
+               RARCH_ERR("[STATESTREAM] array read failed\n");
+               goto exit;
+            }
+            if (item.type != RDT_ARRAY)
+            {
+               RARCH_ERR("[STATESTREAM] new superblock contents type is wrong\n");
+               goto exit;
+            }
+            if (item.val.array.len != movie->superblocks->object_size)
+            {
+               RARCH_ERR("[STATESTREAM] new superblock contents length is wrong\n");
+               goto exit;
+            }
+            len        = movie->superblocks->object_size;
+            superblock = (uint32_t*)calloc(len, sizeof(uint32_t));
+
+            for (i = 0; i < len; i++)
+            {
+               struct rmsgpack_dom_value inner_item = item.val.array.items[i];
+               /* assert(inner_item.type == RDT_INT || inner_item.type == RDT_UINT); */
+               /* Superblock indices are 32-bit */
+               superblock[i] = (uint32_t)inner_item.val.uint_;
+            }
+            if (!uint32s_index_insert_exact(movie->superblocks, index, superblock, movie->frame_counter))
+            {
+               RARCH_ERR("[STATESTREAM] new superblock couldn't be inserted at right index\n");
+               rmsgpack_dom_value_free(&item);
+               free(superblock);
+               goto exit;
+            }
+            /* Do not free superblock since insert_exact takes over its allocation */
+            rmsgpack_dom_value_free(&item);
+            break;
+         case BSV_IFRAME_SUPERBLOCK_SEQ_TOKEN:
+            rmsgpack_dom_read_with(read_mem, &item, reader_state);
+            if (item.type != RDT_ARRAY)
+            {
+               RARCH_ERR("[STATESTREAM] superblock seq type is wrong\n");
+               goto exit;
+            }
+            len = item.val.array.len;
+            if (!movie->superblock_seq)
+               movie->superblock_seq = (uint32_t*)calloc(len, sizeof(uint32_t));
+            for (i = 0; i < len; i++)
+            {
+               size_t j;
+               uint32_t *superblock;
+               struct rmsgpack_dom_value inner_item = item.val.array.items[i];
+               /* assert(inner_item.type == RDT_INT || inner_item.type == RDT_UINT); */
+               /* Superblock indices are 32-bit */
+               uint32_t superblock_idx = (uint32_t)inner_item.val.uint_;
+               /* if this superblock is the same as last time, no need to scan the blocks. */
+               if (movie->cur_save_valid && movie->cur_save && superblock_idx == movie->superblock_seq[i])
+               {
+                  superblock = uint32s_index_get(movie->superblocks, movie->superblock_seq[i]);
+                  uint32s_index_bump_count(movie->superblocks, movie->superblock_seq[i]);
+                  /* We do need to increment all the involved block counts though */
+                  for (j = 0; j < movie->superblocks->object_size; j++)
+                     uint32s_index_bump_count(movie->blocks, superblock[j]);
+                  continue;
+               }
+               movie->superblock_seq[i] = superblock_idx;
+               superblock = uint32s_index_get(movie->superblocks, superblock_idx);
+               uint32s_index_bump_count(movie->superblocks, superblock_idx);
+               for (j = 0; j < movie->superblocks->object_size; j++)
+               {
+                  uint8_t *block;
+                  uint32_t block_idx = superblock[j];
+                  size_t block_start = MIN(i*superblock_byte_size+j*block_byte_size, state_size);
+                  size_t block_end = MIN(block_start+block_byte_size, state_size);
+                  /* This (==) can only happen in the last superblock, if it was padded with extra blocks. */
+                  if (block_end <= block_start)
+                     break;
+                  block = (uint8_t *)uint32s_index_get(movie->blocks, block_idx);
+                  uint32s_index_bump_count(movie->blocks, block_idx);
+                  memcpy(movie->cur_save+block_start, (uint8_t*)block, block_end-block_start);
+               }
+            }
+            rmsgpack_dom_value_free(&item);
+            ret = true;
+            goto exit;
+         default:
+            RARCH_ERR("[STATESTREAM] state update chunk token value is invalid: %d @ %x\n", item.val.uint_, intfstream_tell(read_mem));
+            goto exit;
+      }
+   }
+exit:
+   uint32s_index_commit(movie->blocks);
+   /* Superblocks are small enough that there's no real benefit to garbage collecting them */
+   /* uint32s_index_commit(movie->superblocks); */
+   rmsgpack_dom_reader_state_free(reader_state);
+   intfstream_close(read_mem);
+   free(read_mem);
+   if (!ret)
+   {
+      RARCH_ERR("[STATESTREAM] made it to end without superblock seq\n");
+      return false;
+   }
+   total_decode_micros += cpu_features_get_time_usec() - start;
+   RARCH_DBG("[STATESTREAM] Total statestream decodes %d ; net time (secs): %f\n", total_decode_count, (double)total_decode_micros / (1000000.0));
+   return ret;
+}
+#endif
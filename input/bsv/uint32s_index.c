@@ -18,159 +18,317 @@
 #ifdef HAVE_STATESTREAM
 #include "uint32s_index.h"
 #include <string.h>
-#include <array/rhmap.h>
+#include <retro_inline.h>
+#include <memalign.h>
 #include <array/rbuf.h>
 #include "../../verbosity.h"
 
 #define XXH_INLINE_ALL
 #include <xxHash/xxhash.h>
 
-#define HASHMAP_CAP 65536
 #define uint32s_hash_bytes(bytes, len) XXH32(bytes,len,0)
 
-uint32s_index_t *uint32s_index_new(size_t object_size,
-      uint8_t commit_interval, uint8_t commit_threshold)
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define UINT32S_SSE2
+#endif
+
+/* Control bytes. A full slot holds the low 7 bits of its
+ * hash (top bit clear); both special values have the top
+ * bit set, so "empty or deleted" is a single sign test. */
+#define UINT32S_CTRL_EMPTY   0x80
+#define UINT32S_CTRL_DELETED 0xFE
+#define UINT32S_MIN_GROUPS   64
+
+#define UINT32S_H1(hash) ((hash) >> 7)
+#define UINT32S_H2(hash) ((uint8_t)((hash) & 0x7F))
+
+/* Returns a bitmask with bit i set if byte i of the group
+ * equals 'tag'. */
+static INLINE uint32_t uint32s_group_match(const uint8_t *group, uint8_t tag)
 {
-   uint32_t *zeros         = (uint32_t*)calloc(object_size, sizeof(uint32_t));
-   uint32s_index_t *index  = (uint32s_index_t *)malloc(sizeof(uint32s_index_t));
-   index->object_size      = object_size;
-   index->index            = NULL;
-   RHMAP_FIT(index->index, HASHMAP_CAP);
-   index->objects          = NULL;
-   index->counts           = NULL;
-   index->hashes           = NULL;
-   index->additions        = NULL;
-   index->commit_interval  = commit_interval;
-   index->commit_threshold = commit_threshold;
-   /* transfers ownership of zero buffer */
-   uint32s_index_insert_exact(index, 0, zeros, 0);
-   RBUF_CLEAR(index->additions); /* scrap first addition, we never want to delete 0s during rewind */
-   return index;
+#if defined(UINT32S_SSE2)
+   __m128i ctrl = _mm_load_si128((const __m128i*)group);
+   return (uint32_t)_mm_movemask_epi8(
+         _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+#else
+   int i;
+   uint32_t mask = 0;
+   for (i = 0; i < UINT32S_GROUP_WIDTH; i++)
+      if (group[i] == tag)
+         mask |= 1 << i;
+   return mask;
+#endif
 }
 
-void uint32s_bucket_free(struct uint32s_bucket *bucket)
+/* Bit i set if byte i of the group is empty or deleted. */
+static INLINE uint32_t uint32s_group_match_free(const uint8_t *group)
 {
-   if (bucket->len > 3)
-      free(bucket->contents.vec.idxs);
+#if defined(UINT32S_SSE2)
+   return (uint32_t)_mm_movemask_epi8(
+         _mm_load_si128((const __m128i*)group));
+#else
+   int i;
+   uint32_t mask = 0;
+   for (i = 0; i < UINT32S_GROUP_WIDTH; i++)
+      if (group[i] & 0x80)
+         mask |= 1 << i;
+   return mask;
+#endif
 }
 
-bool uint32s_bucket_get(uint32s_index_t *index, struct uint32s_bucket *bucket, uint32_t *object, size_t size_bytes, uint32_t *out_idx)
+static INLINE unsigned uint32s_lowest_bit(uint32_t mask)
 {
-   uint32_t i;
-   uint32_t *coll = bucket->len < 4 ? bucket->contents.idxs : bucket->contents.vec.idxs;
-   for (i = 0; i < bucket->len; i++)
+#if defined(__GNUC__) || defined(__clang__)
+   return (unsigned)__builtin_ctz(mask);
+#else
+   unsigned i = 0;
+   while (!(mask & 1))
+   {
+      mask >>= 1;
+      i++;
+   }
+   return i;
+#endif
+}
+
+static bool uint32s_table_alloc(uint32s_index_t *index, uint32_t groups)
+{
+   size_t slots = (size_t)groups * UINT32S_GROUP_WIDTH;
+   /* The SSE2 group loads are aligned. */
+   uint8_t *ctrl = (uint8_t*)memalign_alloc(UINT32S_GROUP_WIDTH, slots);
+   struct uint32s_slot *slot_buf = (struct uint32s_slot*)
+      malloc(slots * sizeof(*slot_buf));
+   if (!ctrl || !slot_buf)
+   {
+      memalign_free(ctrl);
+      free(slot_buf);
+      return false;
+   }
+   memset(ctrl, UINT32S_CTRL_EMPTY, slots);
+   index->ctrl       = ctrl;
+   index->slots      = slot_buf;
+   index->group_mask = groups - 1;
+   index->used       = 0;
+   index->tombstones = 0;
+   return true;
+}
+
+/* Places (hash, idx, object) in the first free slot of its probe
+ * sequence. The caller guarantees there is room. */
+static void uint32s_table_place(uint32s_index_t *index,
+      uint32_t hash, uint32_t idx, uint32_t *object)
+{
+   uint32_t group = UINT32S_H1(hash) & index->group_mask;
+   uint32_t step  = 0;
+   for (;;)
    {
-      uint32_t idx = coll[i];
-      if (memcmp(index->objects[idx], object, size_bytes) == 0)
+      uint8_t *ctrl = index->ctrl + group * UINT32S_GROUP_WIDTH;
+      uint32_t mask = uint32s_group_match_free(ctrl);
+      if (mask)
       {
-         *out_idx = idx;
-         return true;
+         unsigned i   = uint32s_lowest_bit(mask);
+         uint32_t pos = group * UINT32S_GROUP_WIDTH + i;
+         if (ctrl[i] == UINT32S_CTRL_DELETED)
+            index->tombstones--;
+         ctrl[i]                  = UINT32S_H2(hash);
+         index->slots[pos].object = object;
+         index->slots[pos].hash   = hash;
+         index->slots[pos].idx    = idx;
+         index->used++;
+         return;
       }
+      /* Triangular probing visits every group once as
+       * long as the group count is a power of two. */
+      group = (group + ++step) & index->group_mask;
    }
-   return false;
 }
 
-void uint32s_bucket_expand(struct uint32s_bucket *bucket, uint32_t idx)
+/* Rebuilds the table with 'groups' groups, dropping all
+ * tombstones on the way. */
+static bool uint32s_table_rehash(uint32s_index_t *index, uint32_t groups)
 {
-   if (bucket->len < 3)
-      bucket->contents.idxs[bucket->len] = idx;
-   else if (bucket->len == 3)
+   size_t i;
+   uint8_t *old_ctrl              = index->ctrl;
+   struct uint32s_slot *old_slots = index->slots;
+   size_t old_slots_len           = ((size_t)index->group_mask + 1)
+      * UINT32S_GROUP_WIDTH;
+
+   if (!uint32s_table_alloc(index, groups))
    {
-      uint32_t *idxs = (uint32_t*)calloc(8, sizeof(uint32_t));
-      memcpy(idxs, bucket->contents.idxs, 3*sizeof(uint32_t));
-      bucket->contents.vec.cap  = 8;
-      bucket->contents.vec.idxs = idxs;
-      bucket->contents.vec.idxs[bucket->len] = idx;
+      index->ctrl  = old_ctrl;
+      index->slots = old_slots;
+      return false;
    }
-   else if (bucket->len < bucket->contents.vec.cap)
-      bucket->contents.vec.idxs[bucket->len] = idx;
-   else /* bucket->len == bucket->contents.vec.cap */
+
+   for (i = 0; i < old_slots_len; i++)
+      if (!(old_ctrl[i] & 0x80))
+         uint32s_table_place(index, old_slots[i].hash, old_slots[i].idx,
+               old_slots[i].object);
+
+   memalign_free(old_ctrl);
+   free(old_slots);
+   return true;
+}
+
+static void uint32s_table_add(uint32s_index_t *index,
+      uint32_t hash, uint32_t idx, uint32_t *object)
+{
+   uint32_t groups = index->group_mask + 1;
+   size_t cap      = (size_t)groups * UINT32S_GROUP_WIDTH;
+
+   /* Keep at least 1/8 of the slots empty so that probes for
+    * missing keys stay short; tombstones count against that.
+    * Only grow if most of the load is live entries, otherwise
+    * a same-size rehash is enough to clear the tombstones. */
+   if ((size_t)(index->used + index->tombstones + 1) * 8 > cap * 7)
    {
-      bucket->contents.vec.cap *= 2;
-      bucket->contents.vec.idxs = (uint32_t*)realloc(bucket->contents.vec.idxs, bucket->contents.vec.cap * sizeof(uint32_t));
-      bucket->contents.vec.idxs[bucket->len] = idx;
+      if ((size_t)index->used * 16 >= cap * 7)
+         groups *= 2;
+      if (!uint32s_table_rehash(index, groups))
+         RARCH_ERR("[STATESTREAM] Could not grow block index\n");
    }
-   bucket->len++;
+
+   uint32s_table_place(index, hash, idx, object);
 }
 
-bool uint32s_bucket_remove(struct uint32s_bucket *bucket, uint32_t idx)
+/* Looks up 'object' and returns its index in *out_idx. */
+static bool uint32s_table_find(uint32s_index_t *index, const uint32_t *object,
+      size_t size_bytes, uint32_t hash, uint32_t *out_idx)
 {
-   int i;
-   bool small     = bucket->len < 4;
-   uint32_t *coll = small ? bucket->contents.idxs : bucket->contents.vec.idxs;
-   if (idx == 0) /* never remove 0s pattern */
-      return false;
+   uint32_t group = UINT32S_H1(hash) & index->group_mask;
+   uint32_t step  = 0;
+   uint8_t tag    = UINT32S_H2(hash);
+   for (;;)
+   {
+      const uint8_t *ctrl = index->ctrl + group * UINT32S_GROUP_WIDTH;
+      uint32_t mask       = uint32s_group_match(ctrl, tag);
+      while (mask)
+      {
+         const struct uint32s_slot *slot = &index->slots[
+            group * UINT32S_GROUP_WIDTH + uint32s_lowest_bit(mask)];
+         if (     slot->hash == hash
+               && memcmp(slot->object, object, size_bytes) == 0)
+         {
+            *out_idx = slot->idx;
+            return true;
+         }
+         mask &= mask - 1;
+      }
+      /* An empty slot means no probe ever continued past this
+       * group, so the object is not in the table. */
+      if (uint32s_group_match(ctrl, UINT32S_CTRL_EMPTY))
+         return false;
+      group = (group + ++step) & index->group_mask;
+   }
+}
 
-   for (i = 0; i < (int)bucket->len; i++)
+static bool uint32s_table_remove(uint32s_index_t *index,
+      uint32_t hash, uint32_t idx)
+{
+   uint32_t group = UINT32S_H1(hash) & index->group_mask;
+   uint32_t step  = 0;
+   uint8_t tag    = UINT32S_H2(hash);
+   for (;;)
    {
-      if (coll[i] == idx)
+      uint8_t *ctrl  = index->ctrl + group * UINT32S_GROUP_WIDTH;
+      uint32_t mask  = uint32s_group_match(ctrl, tag);
+      uint32_t empty = uint32s_group_match(ctrl, UINT32S_CTRL_EMPTY);
+      while (mask)
       {
-         memmove((uint8_t*)(coll+i), (uint8_t*)(coll+i+1), (bucket->len-(i+1))*sizeof(uint32_t));
-         bucket->len--;
-         if (bucket->len == 3)
+         unsigned i = uint32s_lowest_bit(mask);
+         if (index->slots[group * UINT32S_GROUP_WIDTH + i].idx == idx)
          {
-            memcpy(bucket->contents.idxs, coll, 3*sizeof(uint32_t));
-            free(coll);
+            /* If this group still has an empty slot nothing
+             * probes past it, so the slot can become empty
+             * again instead of leaving a tombstone. */
+            if (empty)
+               ctrl[i] = UINT32S_CTRL_EMPTY;
+            else
+            {
+               ctrl[i] = UINT32S_CTRL_DELETED;
+               index->tombstones++;
+            }
+            index->used--;
+            return true;
          }
-         return true;
+         mask &= mask - 1;
       }
+      if (empty)
+         return false;
+      group = (group + ++step) & index->group_mask;
    }
-   RARCH_ERR("[STATESTREAM] didn't find index %d during remove\n",idx);
-   return false;
+}
+
+static void uint32s_table_clear(uint32s_index_t *index)
+{
+   memset(index->ctrl, UINT32S_CTRL_EMPTY,
+         ((size_t)index->group_mask + 1) * UINT32S_GROUP_WIDTH);
+   index->used       = 0;
+   index->tombstones = 0;
+}
+
+uint32s_index_t *uint32s_index_new(size_t object_size,
+      uint8_t commit_interval, uint8_t commit_threshold)
+{
+   uint32_t *zeros         = (uint32_t*)calloc(object_size, sizeof(uint32_t));
+   uint32s_index_t *index  = (uint32s_index_t *)malloc(sizeof(uint32s_index_t));
+   index->object_size      = object_size;
+   if (!uint32s_table_alloc(index, UINT32S_MIN_GROUPS))
+   {
+      free(zeros);
+      free(index);
+      return NULL;
+   }
+   index->objects          = NULL;
+   index->counts           = NULL;
+   index->hashes           = NULL;
+   index->additions        = NULL;
+   index->commit_interval  = commit_interval;
+   index->commit_threshold = commit_threshold;
+   /* transfers ownership of zero buffer */
+   uint32s_index_insert_exact(index, 0, zeros, 0);
+   RBUF_CLEAR(index->additions); /* scrap first addition, we never want to delete 0s during rewind */
+   return index;
+}
+
+uint32_t uint32s_index_hash(const uint32s_index_t *index, const uint32_t *object)
+{
+   return uint32s_hash_bytes((const uint8_t *)object,
+         index->object_size * sizeof(uint32_t));
 }
 
 uint32s_insert_result_t uint32s_index_insert(uint32s_index_t *index, uint32_t *object, uint64_t frame)
+{
+   return uint32s_index_insert_hashed(index, object,
+         uint32s_index_hash(index, object), frame);
+}
+
+uint32s_insert_result_t uint32s_index_insert_hashed(uint32s_index_t *index, uint32_t *object, uint32_t hash, uint64_t frame)
 {
    uint32_t idx;
    uint32_t *copy;
-   struct uint32s_bucket *bucket;
    uint32s_insert_result_t result;
    size_t size_bytes      = index->object_size * sizeof(uint32_t);
-   uint32_t hash          = uint32s_hash_bytes((uint8_t *)object, size_bytes);
    uint32_t additions_len = RBUF_LEN(index->additions);
    result.index  = 0;
    result.is_new = false;
-   if (RHMAP_HAS(index->index, hash))
-   {
-      bucket = RHMAP_PTR(index->index, hash);
-      if (uint32s_bucket_get(index, bucket, object, size_bytes, &result.index))
-      {
-         if (index->objects[result.index])
-         {
-            result.is_new = false;
-            index->counts[result.index]++;
-            return result;
-         }
-
-         RARCH_LOG("[STATESTREAM] accessed collected index %d\n",result.index);
-      }
-      idx  = RBUF_LEN(index->objects);
-      copy = (uint32_t*)malloc(size_bytes);
-      memcpy(copy, object, size_bytes);
-      RBUF_PUSH(index->objects, copy);
-      RBUF_PUSH(index->counts, 1);
-      RBUF_PUSH(index->hashes, hash);
-      result.index = idx;
-      result.is_new = true;
-      uint32s_bucket_expand(bucket, idx);
-   }
-   else
+   /* Collected objects are removed from the table, so a hit
+    * is always live. */
+   if (uint32s_table_find(index, object, size_bytes, hash, &result.index))
    {
-      struct uint32s_bucket new_bucket;
-      idx  = RBUF_LEN(index->objects);
-      copy = (uint32_t*)malloc(size_bytes);
-      memcpy(copy, object, size_bytes);
-      RBUF_PUSH(index->objects, copy);
-      RBUF_PUSH(index->counts, 1);
-      RBUF_PUSH(index->hashes, hash);
-      new_bucket.len = 1;
-      new_bucket.contents.idxs[0] = idx;
-      new_bucket.contents.idxs[1] = 0;
-      new_bucket.contents.idxs[2] = 0;
-      RHMAP_SET(index->index, hash, new_bucket);
-      result.index = idx;
-      result.is_new = true;
+      index->counts[result.index]++;
+      return result;
    }
+   idx  = RBUF_LEN(index->objects);
+   copy = (uint32_t*)malloc(size_bytes);
+   memcpy(copy, object, size_bytes);
+   RBUF_PUSH(index->objects, copy);
+   RBUF_PUSH(index->counts, 1);
+   RBUF_PUSH(index->hashes, hash);
+   uint32s_table_add(index, hash, idx, copy);
+   result.index = idx;
+   result.is_new = true;
    if (additions_len == 0 || index->additions[additions_len-1].frame_counter < frame)
    {
       struct uint32s_frame_addition addition;
@@ -183,7 +341,6 @@ uint32s_insert_result_t uint32s_index_insert(uint32s_index_t *index, uint32_t *o
 
 bool uint32s_index_insert_exact(uint32s_index_t *index, uint32_t idx, uint32_t *object, uint64_t frame)
 {
-   struct uint32s_bucket *bucket;
    uint32_t hash;
    size_t size_bytes;
    uint32_t additions_len;
@@ -192,21 +349,7 @@ bool uint32s_index_insert_exact(uint32s_index_t *index, uint32_t idx, uint32_t *
    size_bytes = index->object_size * sizeof(uint32_t);
    hash = uint32s_hash_bytes((uint8_t *)object, size_bytes);
    additions_len = RBUF_LEN(index->additions);
-   if (RHMAP_HAS(index->index, hash))
-   {
-      uint32_t idx = 0;
-      bucket = RHMAP_PTR(index->index, hash);
-      uint32s_bucket_expand(bucket, idx);
-   }
-   else
-   {
-      struct uint32s_bucket new_bucket;
-      new_bucket.len = 1;
-      new_bucket.contents.idxs[0] = idx;
-      new_bucket.contents.idxs[1] = 0;
-      new_bucket.contents.idxs[2] = 0;
-      RHMAP_SET(index->index, hash, new_bucket);
-   }
+   uint32s_table_add(index, hash, idx, object);
    /* RARCH_LOG("[STATESTREAM] insert index %d\n",idx); */
    RBUF_PUSH(index->objects, object);
    RBUF_PUSH(index->counts, 1);
@@ -234,19 +377,12 @@ void uint32s_index_commit(uint32s_index_t *index)
    limit = cur.first_index;
    for (i = prev.first_index; i < limit; i++)
    {
-      struct uint32s_bucket *bucket;
-      if (index->counts[i] >= threshold)
+      if (index->counts[i] >= threshold || !index->objects[i])
          continue;
       free(index->objects[i]);
       index->objects[i] = NULL;
-      bucket = RHMAP_PTR(index->index, index->hashes[i]);
-      uint32s_bucket_remove(bucket, i);
-      if (bucket->len == 0)
-      {
-         uint32s_bucket_free(bucket);
-         if (!RHMAP_DEL(index->index, index->hashes[i]))
-            RARCH_ERR("[STATESTREAM] Trying to remove absent hash %x\n",index->hashes[i]);
-      }
+      if (!uint32s_table_remove(index, index->hashes[i], i))
+         RARCH_ERR("[STATESTREAM] Trying to remove absent hash %x\n",index->hashes[i]);
    }
 }
 
@@ -278,26 +414,20 @@ uint32_t *uint32s_index_get(uint32s_index_t *index, uint32_t which)
    return index->objects[which];
 }
 
-void uint32s_index_pop(uint32s_index_t *index)
+static void uint32s_index_pop(uint32s_index_t *index)
 {
    uint32_t idx  = RBUF_LEN(index->objects)-1;
    uint32_t hash = index->hashes[idx];
-   struct uint32s_bucket *bucket = RHMAP_PTR(index->index, hash);
-   uint32_t old_len = bucket->len;
-   if (old_len == 0) {
-      RARCH_ERR("[STATESTREAM] trying to pop from empty bucket\n");
-      return;
+   /* Already dropped from the table if it was collected. */
+   if (index->objects[idx])
+   {
+      if (!uint32s_table_remove(index, hash, idx))
+         RARCH_ERR("[STATESTREAM] Trying to remove absent hash %x\n",hash);
+      free(index->objects[idx]);
    }
    RBUF_RESIZE(index->objects, idx);
    RBUF_RESIZE(index->counts, idx);
    RBUF_RESIZE(index->hashes, idx);
-   uint32s_bucket_remove(bucket, idx);
-   if (old_len - 1 == 0)
-   {
-      uint32s_bucket_free(bucket);
-      if (!RHMAP_DEL(index->index, hash))
-         RARCH_ERR("[STATESTREAM] Trying to remove absent hash %x\n",hash);
-   }
 }
 
 /* goes backwards from end of additions */
@@ -318,12 +448,9 @@ void uint32s_index_remove_after(uint32s_index_t *index, uint64_t frame)
 /* removes all data from index */
 void uint32s_index_clear(uint32s_index_t *index)
 {
-   size_t i, cap;
+   size_t i;
    uint32_t *zeros = index->objects[0];
-   for(i = 0, cap = RHMAP_CAP(index->index); i != cap; i++)
-      if (RHMAP_KEY(index->index, i))
-         uint32s_bucket_free(&index->index[i]);
-   RHMAP_CLEAR(index->index);
+   uint32s_table_clear(index);
    /* don't dealloc all-zeros pattern */
    for(i = 1; i < RBUF_LEN(index->objects); i++)
       free(index->objects[i]);
@@ -337,13 +464,11 @@ void uint32s_index_clear(uint32s_index_t *index)
 
 void uint32s_index_free(uint32s_index_t *index)
 {
-   size_t i, cap;
+   size_t i;
    if (!index)
       return;
-   for(i = 0, cap = RHMAP_CAP(index->index); i != cap; i++)
-      if (RHMAP_KEY(index->index, i))
-         uint32s_bucket_free(&index->index[i]);
-   RHMAP_FREE(index->index);
+   memalign_free(index->ctrl);
+   free(index->slots);
    for(i = 0; i < RBUF_LEN(index->objects); i++)
       free(index->objects[i]);
    RBUF_FREE(index->objects);
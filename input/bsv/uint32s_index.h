@@ -26,16 +26,18 @@
 #include <boolean.h>
 #include <retro_common_api.h>
 
-struct uint32s_bucket
+#define UINT32S_GROUP_WIDTH 16
+
+/* One slot of the block lookup table. The full hash is kept
+ * next to the object index so that probing only has to touch
+ * the object itself on a genuine match, and the object pointer
+ * is kept too so that a match does not first have to load it
+ * from 'objects'. */
+struct uint32s_slot
 {
-   uint32_t len; /* if < 4, contents is idxs. */
-   union {
-     uint32_t idxs[3];
-     struct {
-       uint32_t cap;
-       uint32_t *idxs;
-     } vec;
-   } contents;
+   uint32_t *object;
+   uint32_t hash;
+   uint32_t idx;
 };
 
 struct uint32s_frame_addition
@@ -47,7 +49,15 @@ struct uint32s_frame_addition
 struct uint32s_index
 {
    size_t object_size; /* measured in ints */
-   struct uint32s_bucket *index; /* an rhmap of buckets for value->index lookup */
+   /* Open-addressing table for value->index lookup, probed a
+    * group of UINT32S_GROUP_WIDTH control bytes at a time. Each
+    * control byte is empty, deleted or the low 7 hash bits of
+    * the slot with the same position. */
+   uint8_t *ctrl;
+   struct uint32s_slot *slots;
+   uint32_t group_mask; /* number of groups - 1 */
+   uint32_t used;       /* live slots */
+   uint32_t tombstones; /* deleted slots */
    uint32_t **objects;   /* an rbuf of the actual buffers */
    uint32_t *counts;   /* an rbuf of the times each object was used */
    uint32_t *hashes;   /* an rbuf of each object's hash code */
@@ -69,6 +79,10 @@ RETRO_BEGIN_DECLS
 uint32s_index_t *uint32s_index_new(size_t object_size, uint8_t commit_interval, uint8_t commit_threshold);
 /* Does not take ownership of object */
 uint32s_insert_result_t uint32s_index_insert(uint32s_index_t *index, uint32_t *object, uint64_t frame);
+/* Hash used by the index; pure, so it may be called from any thread */
+uint32_t uint32s_index_hash(const uint32s_index_t *index, const uint32_t *object);
+/* As uint32s_index_insert, with hash precomputed by uint32s_index_hash */
+uint32s_insert_result_t uint32s_index_insert_hashed(uint32s_index_t *index, uint32_t *object, uint32_t hash, uint64_t frame);
 /* Does take ownership, requires idx is the exact next index and object not in index */
 bool uint32s_index_insert_exact(uint32s_index_t *index, uint32_t idx, uint32_t *object, uint64_t frame);
 /* Does not grant ownership of return value */
@@ -127,6 +127,10 @@
 #define REPLAY_CHECKPOINT2_COMPRESSION_NONE 0
 #define REPLAY_CHECKPOINT2_COMPRESSION_ZLIB 1
 #define REPLAY_CHECKPOINT2_COMPRESSION_ZSTD 2
+/* zstd, with the state of an earlier checkpoint as a raw-content
+   prefix dictionary.  The compressed data starts with the int64_t
+   file offset of that checkpoint's data, or -1 for none. */
+#define REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT 3
 
 /* Which encoding to use.
    RAW: Just raw checkpoint data, possibly compressed.
@@ -253,6 +257,16 @@ struct bsv_movie
    size_t frame_mask;
    uint64_t frame_counter;
 
+   /* Seek index, see bsvindex.c: file offset of every frame
+    * record and the numbers of the records that hold a
+    * checkpoint, covering the file up to index_end.  Saved
+    * next to the replay at index_path. */
+   int64_t *record_pos;
+   uint64_t *checkpoint_records;
+   int64_t index_end;
+   char *index_path;
+   bool index_dirty;
+
    /* Staging variables for events */
    uint8_t key_event_count;
    uint16_t input_event_count;
@@ -270,11 +284,27 @@ struct bsv_movie
    uint32s_index_t *superblocks;
    uint32s_index_t *blocks;
    uint32_t *superblock_seq;
+#ifdef HAVE_THREADS
+   /* Hashes the blocks of large checkpoints; may be NULL */
+   struct tpool *hash_pool;
+#endif
    uint8_t commit_interval, commit_threshold;
 #endif
 
    uint8_t checkpoint_compression, checkpoint_encoding;
 
+#ifdef HAVE_ZSTD
+   /* States of the two latest checkpoints written or read, keyed
+    * by the file offset of their data; the references for
+    * REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT.  A slot is empty
+    * while its size is 0. */
+   uint8_t *dict_state[2];
+   size_t dict_size[2];
+   int64_t dict_pos[2];
+   struct ZSTD_CCtx_s *zstd_cctx;
+   struct ZSTD_DCtx_s *zstd_dctx;
+#endif
+
    uint8_t *last_save, *cur_save;
    size_t last_save_size, cur_save_size;
 
@@ -377,6 +407,8 @@ typedef struct input_remote_state
 typedef struct input_list_element_t
 {
    int16_t *state;
+   /* Bitmap of the ids the core has asked for */
+   uint32_t *requested;
    unsigned port;
    unsigned device;
    unsigned index;
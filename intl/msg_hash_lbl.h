@@ -408,6 +408,10 @@ MSG_HASH(
    MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DESERIALIZE,
    MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DESERIALIZE_STR
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY,
+   MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY_STR
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_AUTO_OVERRIDES_ENABLE,
    MENU_ENUM_LABEL_AUTO_OVERRIDES_ENABLE_STR
@@ -3684,6 +3688,18 @@ MSG_HASH(
    MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS,
    MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS_STR
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL,
+   MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL_STR
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED,
+   MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED_STR
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO,
+   MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO_STR
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_RUN_AHEAD_FRAMES,
    MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_STR
@@ -4271,6 +4287,10 @@ MSG_HASH(
    MENU_ENUM_LABEL_VIDEO_FILTER_REMOVE,
    MENU_ENUM_LABEL_VIDEO_FILTER_REMOVE_STR
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED,
+   MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED_STR
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VIDEO_FILTER_DIR,
    MENU_ENUM_LABEL_VIDEO_FILTER_DIR_STR
@@ -1976,6 +1976,14 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_VIDEO_FILTER_REMOVE,
    "Unload any active CPU-powered video filter."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_VIDEO_FILTER_PIPELINED,
+   "Pipelined Video Filter"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_VIDEO_FILTER_PIPELINED,
+   "Run the CPU video filter in the background while the core runs the next frame. Frees up the core's frame time on slow devices, but every frame is shown one frame later."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_VIDEO_NOTCH_WRITE_OVER,
    "Enable fullscreen over notch in Android and iOS devices"
@@ -4532,6 +4540,30 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_RUN_AHEAD_HIDE_WARNINGS,
    "Hide the warning message that appears when using Run-Ahead and the core does not support save states."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_RUN_AHEAD_INCREMENTAL,
+   "Incremental Run-Ahead"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_RUN_AHEAD_INCREMENTAL,
+   "Keep the frames already run ahead while the input does not change, so only one new frame is run ahead each frame. Uses one save state of memory per Run-Ahead frame. Not used with a second instance or with cheats."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_RUN_AHEAD_SECONDARY_THREADED,
+   "Threaded Second Instance"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_RUN_AHEAD_SECONDARY_THREADED,
+   "Run the second instance of the core on its own thread, at the same time as the first. Cores that render in hardware or are not safe to run on another thread fall back to running both instances in turn."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_RUN_AHEAD_FRAMES_AUTO,
+   "Automatic Run-Ahead Frames"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_RUN_AHEAD_FRAMES_AUTO,
+   "Run ahead as many frames as fit in the frame time, up to the set number of frames. Measured from how long the core takes to run, save and load states. Uses the reserve found by Automatic Frame Delay when that is on."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_PREEMPT_FRAMES,
    "Number of Preemptive Frames"
@@ -4839,6 +4871,18 @@ MSG_HASH(
    MENU_ENUM_LABEL_HELP_REPLAY_CHECKPOINT_DESERIALIZE,
    "Whether to deserialize checkpoints stored in replays during regular playback. Should be set to true for most cores, but some may exhibit janky behavior when deserializing content."
    )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REPLAY_CHECKPOINT_DICTIONARY,
+   "Compress each checkpoint in new replays against the previous one."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REPLAY_CHECKPOINT_DICTIONARY,
+   "Replay: Checkpoint Dictionary Compression"
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_HELP_REPLAY_CHECKPOINT_DICTIONARY,
+   "Compress each checkpoint in new replays using the previous checkpoint as a dictionary. Replays with frequent checkpoints become much smaller, but can only be played back by versions that support this compression."
+   )
 MSG_HASH(
    MENU_ENUM_LABEL_VALUE_SAVESTATE_AUTO_INDEX,
    "Save State: Increment Index Automatically"
@@ -5195,6 +5239,30 @@ MSG_HASH(
    MENU_ENUM_SUBLABEL_REWIND_BUFFER_SIZE_STEP,
    "Each time the rewind buffer size value is increased or decreased, it will change by this amount."
    )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_ASYNC,
+   "Threaded Rewind Capture"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_ASYNC,
+   "Compress rewind states on a separate thread. Reduces frame time spikes with large save states at the cost of one extra save state worth of memory."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_KEYFRAME_INTERVAL,
+   "Rewind Keyframe Interval"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_KEYFRAME_INTERVAL,
+   "Store a full save state every this many rewind steps so that long jumps back in time only replay a few steps. 0 disables keyframes."
+   )
+MSG_HASH(
+   MENU_ENUM_LABEL_VALUE_REWIND_COMPRESS,
+   "Compress Older Rewind States"
+   )
+MSG_HASH(
+   MENU_ENUM_SUBLABEL_REWIND_COMPRESS,
+   "Keep only the most recent part of the rewind buffer uncompressed and recompress older states in the background. Allows rewinding much further back for the same buffer size."
+   )
 
 /* Settings > Frame Throttle > Frame Time Counter */
 
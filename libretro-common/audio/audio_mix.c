@@ -32,7 +32,25 @@
 #include <altivec.h>
 #endif
 
+/* The AVX2 kernels are built regardless of the baseline -m
+ * flags and only ever called after a runtime check, so a
+ * generic x86 build still gets them.  None of the kernels
+ * use FMA: a voice mixes to the same bits whichever of them
+ * runs, and the same as a chain of audio_mix_volume_C(). */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define AUDIO_MIX_AVX2
+#define AUDIO_MIX_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#define AUDIO_MIX_AVX2
+#define AUDIO_MIX_TARGET_AVX2
+#endif
+#endif
+
 #include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
 #include <audio/audio_mix.h>
 #include <streams/file_stream.h>
 #include <audio/conversion/float_to_s16.h>
@@ -78,6 +96,363 @@ void audio_mix_volume_SSE2(float *s, const float *in, float vol, size_t len)
 }
 #endif
 
+typedef void (*audio_mix_volume_t)(float *dst, const float *src,
+      float vol, size_t samples);
+typedef void (*audio_mix_volume_batch_t)(float *dst,
+      const float * const *src, const float *vol,
+      unsigned count, size_t samples);
+typedef void (*audio_mix_clamp_t)(float *buf, size_t samples);
+typedef void (*audio_mix_s16_t)(float *dst, const int16_t *src,
+      size_t frames, unsigned channels);
+
+/* s16 to float as (2 * s + 1) / 65535, the same mapping the
+ * mixer has always used for WAV files. */
+#define AUDIO_MIX_S16_SCALE  (2.0f / 65535.0f)
+#define AUDIO_MIX_S16_OFFSET (1.0f / 65535.0f)
+
+static void audio_mix_volume_batch_C(float *dst,
+      const float * const *src, const float *vol,
+      unsigned count, size_t samples)
+{
+   size_t i;
+   for (i = 0; i < samples; i++)
+   {
+      unsigned v;
+      float sum = dst[i];
+      for (v = 0; v < count; v++)
+         sum += src[v][i] * vol[v];
+      dst[i] = sum;
+   }
+}
+
+static void audio_mix_clamp_C(float *buf, size_t samples)
+{
+   size_t i;
+   for (i = 0; i < samples; i++)
+   {
+      if (buf[i] < -1.0f)
+         buf[i] = -1.0f;
+      else if (buf[i] > 1.0f)
+         buf[i] = 1.0f;
+   }
+}
+
+static void audio_mix_s16_to_float_stereo_C(float *dst,
+      const int16_t *src, size_t frames, unsigned channels)
+{
+   size_t i;
+   if (channels == 1)
+   {
+      for (i = 0; i < frames; i++)
+      {
+         float sample = src[i] * AUDIO_MIX_S16_SCALE + AUDIO_MIX_S16_OFFSET;
+         *dst++       = sample;
+         *dst++       = sample;
+      }
+   }
+   else
+   {
+      for (i = 0; i < frames * 2; i++)
+         dst[i] = src[i] * AUDIO_MIX_S16_SCALE + AUDIO_MIX_S16_OFFSET;
+   }
+}
+
+#ifdef __SSE2__
+static void audio_mix_volume_batch_SSE2(float *dst,
+      const float * const *src, const float *vol,
+      unsigned count, size_t samples)
+{
+   size_t i;
+
+   for (i = 0; i + 8 <= samples; i += 8)
+   {
+      unsigned v;
+      __m128 sum0 = _mm_loadu_ps(dst + i);
+      __m128 sum1 = _mm_loadu_ps(dst + i + 4);
+
+      for (v = 0; v < count; v++)
+      {
+         __m128 gain = _mm_set1_ps(vol[v]);
+         sum0        = _mm_add_ps(sum0,
+               _mm_mul_ps(_mm_loadu_ps(src[v] + i),     gain));
+         sum1        = _mm_add_ps(sum1,
+               _mm_mul_ps(_mm_loadu_ps(src[v] + i + 4), gain));
+      }
+
+      _mm_storeu_ps(dst + i,     sum0);
+      _mm_storeu_ps(dst + i + 4, sum1);
+   }
+
+   for (; i < samples; i++)
+   {
+      unsigned v;
+      float sum = dst[i];
+      for (v = 0; v < count; v++)
+         sum += src[v][i] * vol[v];
+      dst[i] = sum;
+   }
+}
+
+static void audio_mix_clamp_SSE2(float *buf, size_t samples)
+{
+   size_t i;
+   __m128 pos1 = _mm_set1_ps( 1.0f);
+   __m128 neg1 = _mm_set1_ps(-1.0f);
+
+   for (i = 0; i + 4 <= samples; i += 4)
+      _mm_storeu_ps(buf + i,
+            _mm_max_ps(_mm_min_ps(_mm_loadu_ps(buf + i), pos1), neg1));
+
+   audio_mix_clamp_C(buf + i, samples - i);
+}
+
+static void audio_mix_s16_to_float_stereo_SSE2(float *dst,
+      const int16_t *src, size_t frames, unsigned channels)
+{
+   size_t i;
+   size_t samples = frames * channels;
+   __m128 scale   = _mm_set1_ps(AUDIO_MIX_S16_SCALE);
+   __m128 offset  = _mm_set1_ps(AUDIO_MIX_S16_OFFSET);
+
+   for (i = 0; i + 8 <= samples; i += 8)
+   {
+      /* Sign-extend by unpacking into the high halves. */
+      __m128i in = _mm_loadu_si128((const __m128i*)(src + i));
+      __m128 lo  = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+                  _mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16)), scale), offset);
+      __m128 hi  = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(
+                  _mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16)), scale), offset);
+
+      if (channels == 1)
+      {
+         _mm_storeu_ps(dst + 2 * i,      _mm_unpacklo_ps(lo, lo));
+         _mm_storeu_ps(dst + 2 * i + 4,  _mm_unpackhi_ps(lo, lo));
+         _mm_storeu_ps(dst + 2 * i + 8,  _mm_unpacklo_ps(hi, hi));
+         _mm_storeu_ps(dst + 2 * i + 12, _mm_unpackhi_ps(hi, hi));
+      }
+      else
+      {
+         _mm_storeu_ps(dst + i,     lo);
+         _mm_storeu_ps(dst + i + 4, hi);
+      }
+   }
+
+   audio_mix_s16_to_float_stereo_C(dst + (channels == 1 ? 2 * i : i),
+         src + i, frames - i / channels, channels);
+}
+#endif
+
+#ifdef AUDIO_MIX_AVX2
+AUDIO_MIX_TARGET_AVX2
+static void audio_mix_volume_AVX2(float *dst, const float *src,
+      float vol, size_t samples)
+{
+   size_t i;
+   __m256 gain = _mm256_set1_ps(vol);
+
+   for (i = 0; i + 16 <= samples; i += 16)
+   {
+      __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i),     gain);
+      __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), gain);
+      _mm256_storeu_ps(dst + i,
+            _mm256_add_ps(_mm256_loadu_ps(dst + i),     a));
+      _mm256_storeu_ps(dst + i + 8,
+            _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), b));
+   }
+
+   for (; i < samples; i++)
+      dst[i] += src[i] * vol;
+}
+
+AUDIO_MIX_TARGET_AVX2
+static void audio_mix_volume_batch_AVX2(float *dst,
+      const float * const *src, const float *vol,
+      unsigned count, size_t samples)
+{
+   size_t i;
+
+   for (i = 0; i + 32 <= samples; i += 32)
+   {
+      unsigned v;
+      __m256 sum0 = _mm256_loadu_ps(dst + i);
+      __m256 sum1 = _mm256_loadu_ps(dst + i + 8);
+      __m256 sum2 = _mm256_loadu_ps(dst + i + 16);
+      __m256 sum3 = _mm256_loadu_ps(dst + i + 24);
+
+      for (v = 0; v < count; v++)
+      {
+         const float *in = src[v] + i;
+         __m256 gain     = _mm256_set1_ps(vol[v]);
+         sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(in),      gain));
+         sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(in + 8),  gain));
+         sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(_mm256_loadu_ps(in + 16), gain));
+         sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(_mm256_loadu_ps(in + 24), gain));
+      }
+
+      _mm256_storeu_ps(dst + i,      sum0);
+      _mm256_storeu_ps(dst + i + 8,  sum1);
+      _mm256_storeu_ps(dst + i + 16, sum2);
+      _mm256_storeu_ps(dst + i + 24, sum3);
+   }
+
+   for (; i < samples; i++)
+   {
+      unsigned v;
+      float sum = dst[i];
+      for (v = 0; v < count; v++)
+         sum += src[v][i] * vol[v];
+      dst[i] = sum;
+   }
+}
+
+AUDIO_MIX_TARGET_AVX2
+static void audio_mix_clamp_AVX2(float *buf, size_t samples)
+{
+   size_t i;
+   __m256 pos1 = _mm256_set1_ps( 1.0f);
+   __m256 neg1 = _mm256_set1_ps(-1.0f);
+
+   for (i = 0; i + 8 <= samples; i += 8)
+      _mm256_storeu_ps(buf + i, _mm256_max_ps(
+               _mm256_min_ps(_mm256_loadu_ps(buf + i), pos1), neg1));
+
+   audio_mix_clamp_C(buf + i, samples - i);
+}
+
+AUDIO_MIX_TARGET_AVX2
+static void audio_mix_s16_to_float_stereo_AVX2(float *dst,
+      const int16_t *src, size_t frames, unsigned channels)
+{
+   size_t i;
+   size_t samples = frames * channels;
+   __m256 scale   = _mm256_set1_ps(AUDIO_MIX_S16_SCALE);
+   __m256 offset  = _mm256_set1_ps(AUDIO_MIX_S16_OFFSET);
+
+   for (i = 0; i + 8 <= samples; i += 8)
+   {
+      __m256 f = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(
+                  _mm256_cvtepi16_epi32(
+                     _mm_loadu_si128((const __m128i*)(src + i)))),
+               scale), offset);
+
+      if (channels == 1)
+      {
+         /* Unpacking works per 128-bit lane, so put the lanes
+          * back in order afterwards. */
+         __m256 lo = _mm256_unpacklo_ps(f, f);
+         __m256 hi = _mm256_unpackhi_ps(f, f);
+         _mm256_storeu_ps(dst + 2 * i,     _mm256_permute2f128_ps(lo, hi, 0x20));
+         _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+      }
+      else
+         _mm256_storeu_ps(dst + i, f);
+   }
+
+   audio_mix_s16_to_float_stereo_C(dst + (channels == 1 ? 2 * i : i),
+         src + i, frames - i / channels, channels);
+}
+#endif
+
+static enum audio_mix_impl mix_impl_current           = AUDIO_MIX_IMPL_C;
+static audio_mix_volume_t mix_volume                  = audio_mix_volume_C;
+static audio_mix_volume_batch_t mix_volume_batch      = audio_mix_volume_batch_C;
+static audio_mix_clamp_t mix_clamp                    = audio_mix_clamp_C;
+static audio_mix_s16_t mix_s16_to_float_stereo        = audio_mix_s16_to_float_stereo_C;
+
+void audio_mix_volume(float *dst, const float *src, float vol, size_t samples)
+{
+   mix_volume(dst, src, vol, samples);
+}
+
+void audio_mix_volume_batch(float *dst, const float * const *src,
+      const float *vol, unsigned count, size_t samples)
+{
+   mix_volume_batch(dst, src, vol, count, samples);
+}
+
+void audio_mix_clamp(float *buf, size_t samples)
+{
+   mix_clamp(buf, samples);
+}
+
+void audio_mix_s16_to_float_stereo(float *dst, const int16_t *src,
+      size_t frames, unsigned channels)
+{
+   mix_s16_to_float_stereo(dst, src, frames, channels);
+}
+
+bool audio_mix_set_impl(enum audio_mix_impl impl)
+{
+   uint64_t cpu = cpu_features_get();
+
+   (void)cpu;
+
+   switch (impl)
+   {
+      case AUDIO_MIX_IMPL_C:
+         mix_volume              = audio_mix_volume_C;
+         mix_volume_batch        = audio_mix_volume_batch_C;
+         mix_clamp               = audio_mix_clamp_C;
+         mix_s16_to_float_stereo = audio_mix_s16_to_float_stereo_C;
+         break;
+#ifdef __SSE2__
+      case AUDIO_MIX_IMPL_SSE2:
+         mix_volume              = audio_mix_volume_SSE2;
+         mix_volume_batch        = audio_mix_volume_batch_SSE2;
+         mix_clamp               = audio_mix_clamp_SSE2;
+         mix_s16_to_float_stereo = audio_mix_s16_to_float_stereo_SSE2;
+         break;
+#endif
+#ifdef AUDIO_MIX_AVX2
+      case AUDIO_MIX_IMPL_AVX2:
+         if (     !(cpu & RETRO_SIMD_AVX)
+               || !(cpu & RETRO_SIMD_AVX2))
+            return false;
+         mix_volume              = audio_mix_volume_AVX2;
+         mix_volume_batch        = audio_mix_volume_batch_AVX2;
+         mix_clamp               = audio_mix_clamp_AVX2;
+         mix_s16_to_float_stereo = audio_mix_s16_to_float_stereo_AVX2;
+         break;
+#endif
+      default:
+         return false;
+   }
+
+   mix_impl_current = impl;
+   return true;
+}
+
+enum audio_mix_impl audio_mix_get_impl(void)
+{
+   return mix_impl_current;
+}
+
+const char *audio_mix_impl_name(enum audio_mix_impl impl)
+{
+   switch (impl)
+   {
+      case AUDIO_MIX_IMPL_C:
+         return "C";
+      case AUDIO_MIX_IMPL_SSE2:
+         return "SSE2";
+      case AUDIO_MIX_IMPL_AVX2:
+         return "AVX2";
+      default:
+         break;
+   }
+   return "unknown";
+}
+
+void audio_mix_init_simd(void)
+{
+   /* Widest first; set_impl rejects what the CPU can't run. */
+   if (audio_mix_set_impl(AUDIO_MIX_IMPL_AVX2))
+      return;
+   if (audio_mix_set_impl(AUDIO_MIX_IMPL_SSE2))
+      return;
+   audio_mix_set_impl(AUDIO_MIX_IMPL_C);
+}
+
 void audio_mix_free_chunk(audio_chunk_t *chunk)
 {
    if (!chunk)
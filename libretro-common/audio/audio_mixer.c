@@ -25,12 +25,16 @@
 #endif
 
 #include <audio/audio_mixer.h>
+#include <audio/audio_mix.h>
 #include <audio/audio_resampler.h>
 
 #ifdef HAVE_RWAV
 #include <formats/rwav.h>
 #endif
 #include <memalign.h>
+#include <retro_miscellaneous.h>
+#include <retro_atomic.h>
+#include <retro_spsc.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -67,17 +71,68 @@
 #include <rthreads/rthreads.h>
 #define AUDIO_MIXER_LOCK(voice)   slock_lock(voice->lock)
 #define AUDIO_MIXER_UNLOCK(voice) slock_unlock(voice->lock)
+#define AUDIO_MIXER_CACHE_LOCK()   slock_lock(s_pcm_cache.lock)
+#define AUDIO_MIXER_CACHE_UNLOCK() slock_unlock(s_pcm_cache.lock)
 #else
 #define AUDIO_MIXER_LOCK(voice)   do {} while(0)
 #define AUDIO_MIXER_UNLOCK(voice) do {} while(0)
+#define AUDIO_MIXER_CACHE_LOCK()   do {} while(0)
+#define AUDIO_MIXER_CACHE_UNLOCK() do {} while(0)
 #endif
 
 #define AUDIO_MIXER_MAX_VOICES      8
 #define AUDIO_MIXER_TEMP_BUFFER 8192
 
+/* Samples audio_mixer_mix() takes from each voice before mixing
+ * them all in one pass; small enough for the whole batch to
+ * stay in L1. */
+#define AUDIO_MIXER_MIX_CHUNK       512
+
+/* Decoded PCM queued ahead of the mixer for each streamed voice,
+ * about 340 ms at 48 kHz. */
+#define AUDIO_MIXER_STREAM_RING     (16384 * 2 * sizeof(float))
+/* How often the decode worker looks at the rings when the mixer
+ * does not wake it up first. */
+#define AUDIO_MIXER_WORKER_INTERVAL 5000
+/* Sounds that decode to at most AUDIO_MIXER_PCM_CACHE_MAX_SOUND
+ * bytes are decoded once and kept in a cache of
+ * AUDIO_MIXER_PCM_CACHE_SIZE bytes, least recently played first
+ * out, instead of being streamed.  With the decode worker about,
+ * it fills the cache and a sound is streamed until its entry is
+ * ready. */
+#define AUDIO_MIXER_PCM_CACHE_SIZE      (4 * 1024 * 1024)
+#define AUDIO_MIXER_PCM_CACHE_MAX_SOUND (AUDIO_MIXER_PCM_CACHE_SIZE / 4)
+
+enum audio_mixer_pcm_cache_state
+{
+   AUDIO_MIXER_PCM_CACHE_UNKNOWN = 0,
+   AUDIO_MIXER_PCM_CACHE_PENDING,    /* queued for the worker */
+   AUDIO_MIXER_PCM_CACHE_TOO_LONG
+};
+
+typedef struct audio_mixer_pcm_cache_entry
+{
+   const audio_mixer_sound_t *sound; /* NULL once the sound is destroyed */
+   float *pcm;
+   unsigned frames;
+   retro_atomic_int_t refs;          /* voices playing from pcm */
+   struct audio_mixer_pcm_cache_entry *prev;
+   struct audio_mixer_pcm_cache_entry *next;
+} audio_mixer_pcm_cache_entry_t;
+
+/* A sound left for the worker to decode into the cache. */
+typedef struct audio_mixer_pcm_cache_job
+{
+   audio_mixer_sound_t *sound;
+   char *resampler_ident;            /* NULL for the default */
+   enum resampler_quality quality;
+   struct audio_mixer_pcm_cache_job *next;
+} audio_mixer_pcm_cache_job_t;
+
 struct audio_mixer_sound
 {
    enum audio_mixer_type type;
+   enum audio_mixer_pcm_cache_state pcm_cache;
    void* user_data;
 
    union
@@ -133,6 +188,10 @@ struct audio_mixer_voice
    {
       struct
       {
+         /* The sound's own samples, or a cache entry's */
+         const float* pcm;
+         audio_mixer_pcm_cache_entry_t *cache;
+         unsigned frames;
          unsigned position;
       } wav;
 
@@ -143,8 +202,6 @@ struct audio_mixer_voice
          void       *resampler_data;
          const retro_resampler_t *resampler;
          float      *buffer;
-         unsigned    position;
-         unsigned    samples;
          unsigned    buf_samples;
          float       ratio;
       } ogg;
@@ -157,8 +214,6 @@ struct audio_mixer_voice
          drflac      *stream;
          void        *resampler_data;
          const retro_resampler_t *resampler;
-         unsigned    position;
-         unsigned    samples;
          unsigned    buf_samples;
          float       ratio;
       } flac;
@@ -171,8 +226,6 @@ struct audio_mixer_voice
          void        *resampler_data;
          const retro_resampler_t *resampler;
          float*      buffer;
-         unsigned    position;
-         unsigned    samples;
          unsigned    buf_samples;
          float       ratio;
       } mp3;
@@ -184,12 +237,23 @@ struct audio_mixer_voice
          int*              buffer;
          struct replay*    stream;
          struct module*    module;
-         unsigned          position;
-         unsigned          samples;
          unsigned          buf_samples;
       } mod;
 #endif
    } types;
+   /* Compressed formats are decoded ahead of the mixer into
+    * ring, by the decode worker when there is one and by the
+    * mixer itself otherwise.  Whichever decodes is the ring's
+    * producer, the mixer its consumer. */
+   struct
+   {
+      retro_spsc_t ring;
+      float *temp;                 /* one block straight from the decoder */
+      size_t block_bytes;          /* most one block can resample to */
+      retro_atomic_int_t active;   /* the worker may decode */
+      retro_atomic_int_t eos;      /* the last block is in ring */
+      retro_atomic_int_t repeats;  /* loops not yet reported */
+   } stream;
    audio_mixer_sound_t *sound;
    audio_mixer_stop_cb_t stop_cb;
    unsigned type;
@@ -197,14 +261,65 @@ struct audio_mixer_voice
    bool     repeat;
 #ifdef HAVE_THREADS
    slock_t *lock;
+   slock_t *decode_lock;           /* held while the worker decodes */
 #endif
 };
 
+/* Stop callbacks audio_mixer_mix() owes a voice once it has
+ * let go of the voices. */
+typedef struct
+{
+   audio_mixer_stop_cb_t stop_cb;
+   audio_mixer_sound_t *sound;
+   unsigned repeated;
+   bool finished;
+} audio_mixer_events_t;
+
 /* TODO/FIXME - static globals */
 static struct audio_mixer_voice s_voices[AUDIO_MIXER_MAX_VOICES] = {0};
 static unsigned s_rate = 0;
+/* Where a voice's samples are gathered when they cannot be
+ * mixed in place */
+static float s_mix_scratch[AUDIO_MIXER_MAX_VOICES][AUDIO_MIXER_MIX_CHUNK];
+
+static struct
+{
+   audio_mixer_pcm_cache_entry_t *head; /* most recently played */
+   audio_mixer_pcm_cache_entry_t *tail;
+   audio_mixer_pcm_cache_job_t *jobs;   /* oldest first */
+   const audio_mixer_sound_t *decoding; /* the worker's current job */
+   size_t bytes;
+#ifdef HAVE_THREADS
+   slock_t *lock;
+   slock_t *decode_lock;   /* held while the worker runs a job */
+#endif
+} s_pcm_cache;
+
+#ifdef HAVE_THREADS
+static struct
+{
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+   bool alive;
+} s_worker;
+#endif
 
 static void audio_mixer_release(audio_mixer_voice_t* voice);
+static bool audio_mixer_play_decoder(audio_mixer_sound_t* sound,
+      audio_mixer_voice_t* voice,
+      bool repeat, float volume,
+      const char *resampler_ident,
+      enum resampler_quality quality,
+      audio_mixer_stop_cb_t stop_cb);
+static unsigned audio_mixer_decode(audio_mixer_voice_t* voice,
+      const float **out);
+static void audio_mixer_stream_fill(audio_mixer_voice_t* voice,
+      size_t need);
+static void audio_mixer_pcm_cache_forget(const audio_mixer_sound_t *sound);
+#ifdef HAVE_THREADS
+static void audio_mixer_worker(void *data);
+#endif
 
 #ifdef HAVE_RWAV
 static bool wav_to_float(const rwav_t* wav, float** pcm, size_t len)
@@ -247,37 +362,9 @@ static bool wav_to_float(const rwav_t* wav, float** pcm, size_t len)
          }
       }
    }
-   else
-   {
-      /* TODO/FIXME note to leiradel - can we use audio/conversion/s16_to_float
-       * functions here? */
-
-      float sample       = 0.0f;
-      const int16_t *s16 = (const int16_t*)wav->samples;
-
-      if (wav->numchannels == 1)
-      {
-         for (i = wav->numsamples; i != 0; i--)
-         {
-            sample = (float)((int)*s16++ + 32768) / 65535.0f;
-            sample = sample * 2.0f - 1.0f;
-            *f++   = sample;
-            *f++   = sample;
-         }
-      }
-      else if (wav->numchannels == 2)
-      {
-         for (i = wav->numsamples; i != 0; i--)
-         {
-            sample = (float)((int)*s16++ + 32768) / 65535.0f;
-            sample = sample * 2.0f - 1.0f;
-            *f++   = sample;
-            sample = (float)((int)*s16++ + 32768) / 65535.0f;
-            sample = sample * 2.0f - 1.0f;
-            *f++   = sample;
-         }
-      }
-   }
+   else if (wav->numchannels == 1 || wav->numchannels == 2)
+      audio_mix_s16_to_float_stereo(f, (const int16_t*)wav->samples,
+            wav->numsamples, wav->numchannels);
 
    return true;
 }
@@ -326,6 +413,8 @@ void audio_mixer_init(unsigned rate)
 
    s_rate = rate;
 
+   audio_mix_init_simd();
+
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
    {
       audio_mixer_voice_t *voice = &s_voices[i];
@@ -334,14 +423,59 @@ void audio_mixer_init(unsigned rate)
 #ifdef HAVE_THREADS
       if (!voice->lock)
          voice->lock = slock_new();
+      if (!voice->decode_lock)
+         voice->decode_lock = slock_new();
 #endif
    }
+
+#ifdef HAVE_THREADS
+   if (!s_pcm_cache.lock)
+      s_pcm_cache.lock = slock_new();
+   if (!s_pcm_cache.decode_lock)
+      s_pcm_cache.decode_lock = slock_new();
+
+#ifdef HAVE_DR_FLAC
+   /* dr_flac sets its CPU flags on the first open, unlocked;
+    * do it here before the worker can open a sound as well. */
+   drflac__init_cpu_caps();
+#endif
+
+   /* Without the worker, the mixer decodes as it goes. */
+   if (!s_worker.thread)
+   {
+      if (!s_worker.lock)
+         s_worker.lock = slock_new();
+      if (!s_worker.cond)
+         s_worker.cond = scond_new();
+      s_worker.alive   = true;
+      if (s_worker.lock && s_worker.cond)
+         s_worker.thread = sthread_create(audio_mixer_worker, NULL);
+   }
+#endif
 }
 
 void audio_mixer_done(void)
 {
    unsigned i;
 
+#ifdef HAVE_THREADS
+   if (s_worker.thread)
+   {
+      slock_lock(s_worker.lock);
+      s_worker.alive = false;
+      scond_signal(s_worker.cond);
+      slock_unlock(s_worker.lock);
+      sthread_join(s_worker.thread);
+      s_worker.thread = NULL;
+   }
+   if (s_worker.cond)
+      scond_free(s_worker.cond);
+   if (s_worker.lock)
+      slock_free(s_worker.lock);
+   s_worker.cond = NULL;
+   s_worker.lock = NULL;
+#endif
+
    for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
    {
       audio_mixer_voice_t *voice = &s_voices[i];
@@ -351,9 +485,40 @@ void audio_mixer_done(void)
       AUDIO_MIXER_UNLOCK(voice);
 #ifdef HAVE_THREADS
       slock_free(voice->lock);
-      voice->lock = NULL;
+      slock_free(voice->decode_lock);
+      voice->lock        = NULL;
+      voice->decode_lock = NULL;
 #endif
    }
+
+   /* The sounds still waiting go back to being looked up afresh. */
+   while (s_pcm_cache.jobs)
+   {
+      audio_mixer_pcm_cache_job_t *job = s_pcm_cache.jobs;
+      s_pcm_cache.jobs      = job->next;
+      job->sound->pcm_cache = AUDIO_MIXER_PCM_CACHE_UNKNOWN;
+      free(job);
+   }
+
+   /* Sounds may outlive the mixer, so their entries only go
+    * along with the rest of the cache. */
+   while (s_pcm_cache.head)
+   {
+      audio_mixer_pcm_cache_entry_t *entry = s_pcm_cache.head;
+      s_pcm_cache.head = entry->next;
+      free(entry->pcm);
+      free(entry);
+   }
+   s_pcm_cache.tail  = NULL;
+   s_pcm_cache.bytes = 0;
+#ifdef HAVE_THREADS
+   if (s_pcm_cache.lock)
+      slock_free(s_pcm_cache.lock);
+   if (s_pcm_cache.decode_lock)
+      slock_free(s_pcm_cache.decode_lock);
+   s_pcm_cache.lock        = NULL;
+   s_pcm_cache.decode_lock = NULL;
+#endif
 }
 
 audio_mixer_sound_t* audio_mixer_load_wav(void *buffer, int32_t size,
@@ -499,6 +664,9 @@ void audio_mixer_destroy(audio_mixer_sound_t* sound)
    if (!sound)
       return;
 
+   if (sound->type != AUDIO_MIXER_TYPE_WAV)
+      audio_mixer_pcm_cache_forget(sound);
+
    switch (sound->type)
    {
       case AUDIO_MIXER_TYPE_WAV:
@@ -545,10 +713,20 @@ static bool audio_mixer_play_wav(audio_mixer_sound_t* sound,
       audio_mixer_voice_t* voice, bool repeat, float volume,
       audio_mixer_stop_cb_t stop_cb)
 {
+   voice->types.wav.pcm      = sound->types.wav.pcm;
+   voice->types.wav.frames   = sound->types.wav.frames;
+   voice->types.wav.cache    = NULL;
    voice->types.wav.position = 0;
    return true;
 }
 
+static void audio_mixer_release_wav(audio_mixer_voice_t* voice)
+{
+   /* The cache frees the entry once nothing plays from it. */
+   if (voice->types.wav.cache)
+      retro_atomic_fetch_sub_int(&voice->types.wav.cache->refs, 1);
+}
+
 #ifdef HAVE_STB_VORBIS
 static bool audio_mixer_play_ogg(
       audio_mixer_sound_t* sound,
@@ -607,8 +785,6 @@ static bool audio_mixer_play_ogg(
    voice->types.ogg.buf_samples    = samples;
    voice->types.ogg.ratio          = ratio;
    voice->types.ogg.stream         = stb_vorbis;
-   voice->types.ogg.position       = 0;
-   voice->types.ogg.samples        = 0;
 
    return true;
 
@@ -687,8 +863,6 @@ static bool audio_mixer_play_mod(
    voice->types.mod.buffer         = (int*)mod_buffer;
    voice->types.mod.buf_samples    = buf_samples;
    voice->types.mod.stream         = replay;
-   voice->types.mod.position       = 0;
-   voice->types.mod.samples        = 0; /* samples; */
 
    return true;
 
@@ -697,6 +871,7 @@ error:
       memalign_free(mod_buffer);
    if (module)
       dispose_module(module);
+   voice->types.mod.module = NULL;
    return false;
 
 }
@@ -707,6 +882,8 @@ static void audio_mixer_release_mod(audio_mixer_voice_t* voice)
       dispose_replay(voice->types.mod.stream);
    if (voice->types.mod.buffer)
       memalign_free(voice->types.mod.buffer);
+   if (voice->types.mod.module)
+      dispose_module(voice->types.mod.module);
 }
 #endif
 
@@ -780,8 +957,6 @@ static bool audio_mixer_play_flac(
    voice->types.flac.buf_samples    = samples;
    voice->types.flac.ratio          = ratio;
    voice->types.flac.stream         = dr_flac;
-   voice->types.flac.position       = 0;
-   voice->types.flac.samples        = 0;
 
    return true;
 
@@ -854,8 +1029,6 @@ static bool audio_mixer_play_mp3(
    voice->types.mp3.buffer         = (float*)mp3_buffer;
    voice->types.mp3.buf_samples    = samples;
    voice->types.mp3.ratio          = ratio;
-   voice->types.mp3.position       = 0;
-   voice->types.mp3.samples        = 0;
 
    return true;
 
@@ -876,513 +1049,962 @@ static void audio_mixer_release_mp3(audio_mixer_voice_t* voice)
 
 #endif
 
-audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound,
-      bool repeat, float volume,
-      const char *resampler_ident,
-      enum resampler_quality quality,
-      audio_mixer_stop_cb_t stop_cb)
+/* Samples in one block from the decoder, before resampling. */
+static unsigned audio_mixer_stream_temp_samples(audio_mixer_voice_t* voice)
 {
-   unsigned i;
-   bool res                   = false;
-   audio_mixer_voice_t* voice = s_voices;
-
-   if (!sound)
-      return NULL;
+#ifdef HAVE_IBXM
+   if (voice->type == AUDIO_MIXER_TYPE_MOD)
+      return voice->types.mod.buf_samples;
+#endif
+   return AUDIO_MIXER_TEMP_BUFFER;
+}
 
-   for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
+/* Samples one block can come out of the resampler as. */
+static unsigned audio_mixer_stream_block_samples(audio_mixer_voice_t* voice)
+{
+   switch (voice->type)
    {
-      if (voice->type != AUDIO_MIXER_TYPE_NONE)
-         continue;
-
-      AUDIO_MIXER_LOCK(voice);
-
-      if (voice->type != AUDIO_MIXER_TYPE_NONE)
-      {
-         AUDIO_MIXER_UNLOCK(voice);
-         continue;
-      }
-
-      /* claim the voice, also helps with cleanup on error */
-      voice->type = sound->type;
-
-      switch (sound->type)
-      {
-         case AUDIO_MIXER_TYPE_WAV:
-            res = audio_mixer_play_wav(sound, voice, repeat, volume, stop_cb);
-            break;
-         case AUDIO_MIXER_TYPE_OGG:
 #ifdef HAVE_STB_VORBIS
-            res = audio_mixer_play_ogg(sound, voice, repeat, volume,
-                  resampler_ident, quality, stop_cb);
-#endif
-            break;
-         case AUDIO_MIXER_TYPE_MOD:
-#ifdef HAVE_IBXM
-            res = audio_mixer_play_mod(sound, voice, repeat, volume, stop_cb);
+      case AUDIO_MIXER_TYPE_OGG:
+         return voice->types.ogg.buf_samples + 16;
 #endif
-            break;
-         case AUDIO_MIXER_TYPE_FLAC:
 #ifdef HAVE_DR_FLAC
-            res = audio_mixer_play_flac(sound, voice, repeat, volume,
-                  resampler_ident, quality, stop_cb);
+      case AUDIO_MIXER_TYPE_FLAC:
+         return voice->types.flac.buf_samples + 16;
 #endif
-            break;
-         case AUDIO_MIXER_TYPE_MP3:
 #ifdef HAVE_DR_MP3
-            res = audio_mixer_play_mp3(sound, voice, repeat, volume,
-                  resampler_ident, quality, stop_cb);
+      case AUDIO_MIXER_TYPE_MP3:
+         return voice->types.mp3.buf_samples + 16;
 #endif
-            break;
-         case AUDIO_MIXER_TYPE_NONE:
-            break;
-      }
-
-      break;
-   }
-
-   if (res)
-   {
-      voice->repeat   = repeat;
-      voice->volume   = volume;
-      voice->sound    = sound;
-      voice->stop_cb  = stop_cb;
-      AUDIO_MIXER_UNLOCK(voice);
-   }
-   else
-   {
-      if (i < AUDIO_MIXER_MAX_VOICES)
-      {
-         audio_mixer_release(voice);
-         AUDIO_MIXER_UNLOCK(voice);
-      }
-      voice = NULL;
+      default:
+         break;
    }
-
-   return voice;
+   return audio_mixer_stream_temp_samples(voice);
 }
 
-/* Need to hold lock for voice.  */
-static void audio_mixer_release(audio_mixer_voice_t* voice)
+/* Samples all of the voice's sound comes out of the resampler
+ * as, if its decoder can tell without decoding it, or 0. */
+static size_t audio_mixer_stream_length(audio_mixer_voice_t* voice)
 {
-   if (!voice)
-      return;
-
    switch (voice->type)
    {
 #ifdef HAVE_STB_VORBIS
       case AUDIO_MIXER_TYPE_OGG:
-         audio_mixer_release_ogg(voice);
-         break;
-#endif
-#ifdef HAVE_IBXM
-      case AUDIO_MIXER_TYPE_MOD:
-         audio_mixer_release_mod(voice);
-         break;
+         {
+            unsigned frames = stb_vorbis_stream_length_in_samples(
+                  voice->types.ogg.stream);
+            if (frames == 0xffffffff)
+               break;
+            return (size_t)(frames * voice->types.ogg.ratio) * 2;
+         }
 #endif
 #ifdef HAVE_DR_FLAC
       case AUDIO_MIXER_TYPE_FLAC:
-         audio_mixer_release_flac(voice);
-         break;
-#endif
-#ifdef HAVE_DR_MP3
-      case AUDIO_MIXER_TYPE_MP3:
-         audio_mixer_release_mp3(voice);
-         break;
+         return (size_t)(voice->types.flac.stream->totalPCMFrameCount
+               * voice->types.flac.ratio) * 2;
 #endif
       default:
          break;
    }
+   return 0;
+}
 
-   memset(&voice->types, 0, sizeof(voice->types));
-   voice->type = AUDIO_MIXER_TYPE_NONE;
+/* Sets up the buffers the decoders need, and the ring as well
+ * when 'ring' is set.  The voice's decoder must be open. */
+static bool audio_mixer_stream_alloc(audio_mixer_voice_t* voice, bool ring)
+{
+   size_t block_samples      = MAX(audio_mixer_stream_block_samples(voice),
+         audio_mixer_stream_temp_samples(voice));
+
+   voice->stream.block_bytes = block_samples * sizeof(float);
+   /* The worker may be looking at 'active' already. */
+   retro_atomic_store_release_int(&voice->stream.active, 0);
+   retro_atomic_store_release_int(&voice->stream.eos, 0);
+   retro_atomic_store_release_int(&voice->stream.repeats, 0);
+
+   if (!(voice->stream.temp = (float*)memalign_alloc(16,
+               ((audio_mixer_stream_temp_samples(voice) + 15) & ~15)
+               * sizeof(float))))
+      return false;
+
+   return !ring || retro_spsc_init(&voice->stream.ring,
+         MAX(AUDIO_MIXER_STREAM_RING, 2 * voice->stream.block_bytes));
 }
 
-void audio_mixer_stop(audio_mixer_voice_t* voice)
+static void audio_mixer_stream_free(audio_mixer_voice_t* voice)
 {
-   audio_mixer_stop_cb_t stop_cb = NULL;
-   audio_mixer_sound_t* sound    = NULL;
+#ifdef HAVE_THREADS
+   /* Wait for the worker to finish any block it is decoding. */
+   slock_lock(voice->decode_lock);
+#endif
+   retro_atomic_store_release_int(&voice->stream.active, 0);
+#ifdef HAVE_THREADS
+   slock_unlock(voice->decode_lock);
+#endif
 
-   if (voice)
-   {
-      AUDIO_MIXER_LOCK(voice);
-      stop_cb     = voice->stop_cb;
-      sound       = voice->sound;
+   retro_spsc_free(&voice->stream.ring);
+   if (voice->stream.temp)
+      memalign_free(voice->stream.temp);
+   voice->stream.temp        = NULL;
+   voice->stream.block_bytes = 0;
+}
 
-      audio_mixer_release(voice);
+/* Decodes the first block so the mixer has something to play
+ * straight away, then leaves the rest to the worker. */
+static bool audio_mixer_stream_start(audio_mixer_voice_t* voice)
+{
+   if (!audio_mixer_stream_alloc(voice, true))
+      return false;
 
-      AUDIO_MIXER_UNLOCK(voice);
+   audio_mixer_stream_fill(voice, 1);
+   retro_atomic_store_release_int(&voice->stream.active, 1);
+#ifdef HAVE_THREADS
+   if (s_worker.thread)
+      scond_signal(s_worker.cond);
+#endif
+   return true;
+}
 
-      if (stop_cb)
-         stop_cb(sound, AUDIO_MIXER_SOUND_STOPPED);
-   }
+/* Call with the cache lock held. */
+static void audio_mixer_pcm_cache_unlink(audio_mixer_pcm_cache_entry_t *entry)
+{
+   if (entry->prev)
+      entry->prev->next = entry->next;
+   else
+      s_pcm_cache.head  = entry->next;
+   if (entry->next)
+      entry->next->prev = entry->prev;
+   else
+      s_pcm_cache.tail  = entry->prev;
+   entry->prev = NULL;
+   entry->next = NULL;
 }
 
-static void audio_mixer_mix_wav(float* buffer, size_t num_frames,
-      audio_mixer_voice_t* voice,
-      float volume)
+/* Call with the cache lock held. */
+static void audio_mixer_pcm_cache_push(audio_mixer_pcm_cache_entry_t *entry)
+{
+   entry->prev       = NULL;
+   entry->next       = s_pcm_cache.head;
+   if (s_pcm_cache.head)
+      s_pcm_cache.head->prev = entry;
+   else
+      s_pcm_cache.tail       = entry;
+   s_pcm_cache.head  = entry;
+}
+
+/* Frees entries nothing plays from, starting with the least
+ * recently played, until 'bytes' more would fit.  Entries of
+ * destroyed sounds go regardless.  Call with the cache lock held. */
+static void audio_mixer_pcm_cache_evict(size_t bytes)
 {
-   int i;
-   unsigned buf_free                = (unsigned)(num_frames * 2);
-   const audio_mixer_sound_t* sound = voice->sound;
-   unsigned pcm_available           = sound->types.wav.frames
-      * 2 - voice->types.wav.position;
-   const float* pcm                 = sound->types.wav.pcm +
-      voice->types.wav.position;
-
-again:
-   if (pcm_available < buf_free)
+   audio_mixer_pcm_cache_entry_t *entry = s_pcm_cache.tail;
+
+   while (entry)
    {
-      for (i = pcm_available; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
+      audio_mixer_pcm_cache_entry_t *prev = entry->prev;
 
-      if (voice->repeat)
+      if (     (!entry->sound
+               || s_pcm_cache.bytes + bytes > AUDIO_MIXER_PCM_CACHE_SIZE)
+            && !retro_atomic_load_acquire_int(&entry->refs))
       {
-         if (voice->stop_cb)
-            voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
-
-         buf_free                  -= pcm_available;
-         pcm_available              = sound->types.wav.frames * 2;
-         pcm                        = sound->types.wav.pcm;
-         voice->types.wav.position  = 0;
-         goto again;
+         audio_mixer_pcm_cache_unlink(entry);
+         s_pcm_cache.bytes -= entry->frames * 2 * sizeof(float);
+         free(entry->pcm);
+         free(entry);
       }
 
-      if (voice->stop_cb)
-         voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
-
-      audio_mixer_release(voice);
+      entry = prev;
    }
-   else
-   {
-      for (i = buf_free; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
+}
 
-      voice->types.wav.position += buf_free;
+/* Call with the cache lock held. */
+static audio_mixer_pcm_cache_entry_t *audio_mixer_pcm_cache_find(
+      const audio_mixer_sound_t *sound)
+{
+   audio_mixer_pcm_cache_entry_t *entry = s_pcm_cache.head;
+
+   for (; entry; entry = entry->next)
+   {
+      if (entry->sound != sound)
+         continue;
+      audio_mixer_pcm_cache_unlink(entry);
+      audio_mixer_pcm_cache_push(entry);
+      retro_atomic_fetch_add_int(&entry->refs, 1);
+      return entry;
    }
+
+   return NULL;
 }
 
-#ifdef HAVE_STB_VORBIS
-static void audio_mixer_mix_ogg(float* buffer, size_t num_frames,
-      audio_mixer_voice_t* voice,
-      float volume)
+/* Decodes all of a sound that is short enough into the cache.
+ * Runs without any lock held, so that it never holds up the
+ * mixer. */
+static audio_mixer_pcm_cache_entry_t *audio_mixer_pcm_cache_decode(
+      audio_mixer_sound_t* sound,
+      const char *resampler_ident,
+      enum resampler_quality quality)
 {
-   int i;
-   float* temp_buffer = NULL;
-   unsigned buf_free                = (unsigned)(num_frames * 2);
-   unsigned temp_samples            = 0;
-   float* pcm                       = NULL;
+   audio_mixer_voice_t voice;
+   audio_mixer_pcm_cache_entry_t *entry = NULL;
+   float *pcm                           = NULL;
+   size_t samples                       = 0;
+   size_t capacity                      = 0;
+   bool too_long                        = false;
+   bool failed                          = false;
+
+   memset(&voice, 0, sizeof(voice));
+   voice.type  = sound->type;
+   voice.sound = sound;
+
+   if (     !audio_mixer_play_decoder(sound, &voice, false, 1.0f,
+               resampler_ident, quality, NULL)
+         || !audio_mixer_stream_alloc(&voice, false))
+   {
+      audio_mixer_release(&voice);
+      return NULL;
+   }
 
-   if (!voice->types.ogg.stream)
-      return;
+   /* Long sounds are streamed anyway; no need to decode them
+    * to find that out when the decoder knows their length. */
+   if (     audio_mixer_stream_length(&voice) * sizeof(float)
+         >  AUDIO_MIXER_PCM_CACHE_MAX_SOUND)
+      too_long = true;
 
-   if (voice->types.ogg.position == voice->types.ogg.samples)
+   while (!too_long)
    {
-again:
-      if (temp_buffer == NULL)
-         temp_buffer = (float*)malloc(AUDIO_MIXER_TEMP_BUFFER * sizeof(float));
+      const float *out = NULL;
+      unsigned _len    = audio_mixer_decode(&voice, &out);
 
-      temp_samples = stb_vorbis_get_samples_float_interleaved(
-            voice->types.ogg.stream, 2, temp_buffer,
-            AUDIO_MIXER_TEMP_BUFFER) * 2;
+      if (!_len)
+         break;
 
-      if (temp_samples == 0)
+      if ((samples + _len) * sizeof(float) > AUDIO_MIXER_PCM_CACHE_MAX_SOUND)
       {
-         if (voice->repeat)
-         {
-            if (voice->stop_cb)
-               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
-
-            stb_vorbis_seek_start(voice->types.ogg.stream);
-            goto again;
-         }
-
-         if (voice->stop_cb)
-            voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
-
-         audio_mixer_release(voice);
-         goto cleanup;
+         too_long = true;
+         break;
       }
 
-      if (voice->types.ogg.resampler)
+      if (samples + _len > capacity)
       {
-         struct resampler_data info;
-         info.data_in = temp_buffer;
-         info.data_out = voice->types.ogg.buffer;
-         info.input_frames = temp_samples / 2;
-         info.output_frames = 0;
-         info.ratio = voice->types.ogg.ratio;
-
-         voice->types.ogg.resampler->process(
-               voice->types.ogg.resampler_data, &info);
+         float *tmp;
+         capacity = MIN(MAX(capacity * 2, samples + _len),
+               AUDIO_MIXER_PCM_CACHE_MAX_SOUND / sizeof(float));
+         if (!(tmp = (float*)realloc(pcm, capacity * sizeof(float))))
+         {
+            failed = true;
+            break;
+         }
+         pcm = tmp;
       }
-      else
-         memcpy(voice->types.ogg.buffer, temp_buffer,
-               temp_samples * sizeof(float));
 
-      voice->types.ogg.position = 0;
-      voice->types.ogg.samples  = voice->types.ogg.buf_samples;
+      memcpy(pcm + samples, out, _len * sizeof(float));
+      samples += _len;
    }
 
-   pcm = voice->types.ogg.buffer + voice->types.ogg.position;
+   audio_mixer_release(&voice);
 
-   if (voice->types.ogg.samples < buf_free)
+   if (too_long || failed || samples < 2)
    {
-      for (i = voice->types.ogg.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
-
-      buf_free -= voice->types.ogg.samples;
-      goto again;
+      free(pcm);
+      if (too_long)
+      {
+         AUDIO_MIXER_CACHE_LOCK();
+         sound->pcm_cache = AUDIO_MIXER_PCM_CACHE_TOO_LONG;
+         AUDIO_MIXER_CACHE_UNLOCK();
+      }
+      return NULL;
    }
 
-   for (i = buf_free; i != 0; --i )
-      *buffer++ += *pcm++ * volume;
-
-   voice->types.ogg.position += buf_free;
-   voice->types.ogg.samples  -= buf_free;
+   AUDIO_MIXER_CACHE_LOCK();
+   /* Someone else may have got there first. */
+   if (!(entry = audio_mixer_pcm_cache_find(sound)))
+   {
+      audio_mixer_pcm_cache_evict(samples * sizeof(float));
+      if (     s_pcm_cache.bytes + samples * sizeof(float)
+                  <= AUDIO_MIXER_PCM_CACHE_SIZE
+            && (entry = (audio_mixer_pcm_cache_entry_t*)
+                  calloc(1, sizeof(*entry))))
+      {
+         entry->sound  = sound;
+         entry->pcm    = pcm;
+         entry->frames = (unsigned)(samples / 2);
+         retro_atomic_int_init(&entry->refs, 1);
+         audio_mixer_pcm_cache_push(entry);
+         s_pcm_cache.bytes += samples * sizeof(float);
+         pcm = NULL;
+      }
+   }
+   AUDIO_MIXER_CACHE_UNLOCK();
 
-cleanup:
-   if (temp_buffer != NULL)
-      free(temp_buffer);
+   free(pcm);
+   return entry;
 }
-#endif
 
-#ifdef HAVE_IBXM
-static void audio_mixer_mix_mod(float* buffer, size_t num_frames,
-      audio_mixer_voice_t* voice,
-      float volume)
+#ifdef HAVE_THREADS
+/* Leaves 'sound' for the worker to decode.  Call with the cache
+ * lock held. */
+static bool audio_mixer_pcm_cache_queue(audio_mixer_sound_t* sound,
+      const char *resampler_ident,
+      enum resampler_quality quality)
 {
-   int i;
-   float samplef                    = 0.0f;
-   unsigned temp_samples            = 0;
-   unsigned buf_free                = (unsigned)(num_frames * 2);
-   int* pcm                         = NULL;
+   audio_mixer_pcm_cache_job_t **tail = &s_pcm_cache.jobs;
+   size_t ident_len                   = resampler_ident
+         ? strlen(resampler_ident) + 1 : 0;
+   audio_mixer_pcm_cache_job_t *job   = (audio_mixer_pcm_cache_job_t*)
+         malloc(sizeof(*job) + ident_len);
+
+   if (!job)
+      return false;
 
-   if (voice->types.mod.samples == 0)
+   job->sound           = sound;
+   job->resampler_ident = NULL;
+   job->quality         = quality;
+   job->next            = NULL;
+   if (ident_len)
    {
-again:
-      temp_samples = replay_get_audio(
-            voice->types.mod.stream, voice->types.mod.buffer, 0 ) * 2;
+      job->resampler_ident = (char*)(job + 1);
+      memcpy(job->resampler_ident, resampler_ident, ident_len);
+   }
 
-      if (temp_samples == 0)
-      {
-         if (voice->repeat)
-         {
-            if (voice->stop_cb)
-               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
+   while (*tail)
+      tail = &(*tail)->next;
+   *tail            = job;
+   sound->pcm_cache = AUDIO_MIXER_PCM_CACHE_PENDING;
+   return true;
+}
 
-            replay_seek( voice->types.mod.stream, 0);
-            goto again;
-         }
+/* Decodes the oldest sound left for the worker into the cache.
+ * Returns false if there was none. */
+static bool audio_mixer_pcm_cache_run_job(void)
+{
+   audio_mixer_pcm_cache_entry_t *entry;
+   audio_mixer_pcm_cache_job_t *job;
 
-         if (voice->stop_cb)
-            voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
+   /* Taken before the job, so that audio_mixer_destroy() can
+    * wait on it for the sound to be let go. */
+   slock_lock(s_pcm_cache.decode_lock);
 
-         audio_mixer_release(voice);
-         return;
-      }
+   AUDIO_MIXER_CACHE_LOCK();
+   if ((job = s_pcm_cache.jobs))
+   {
+      s_pcm_cache.jobs     = job->next;
+      s_pcm_cache.decoding = job->sound;
+   }
+   AUDIO_MIXER_CACHE_UNLOCK();
 
-      voice->types.mod.position = 0;
-      voice->types.mod.samples  = temp_samples;
+   if (!job)
+   {
+      slock_unlock(s_pcm_cache.decode_lock);
+      return false;
    }
-   pcm = voice->types.mod.buffer + voice->types.mod.position;
 
-   if (voice->types.mod.samples < buf_free)
+   entry = audio_mixer_pcm_cache_decode(job->sound,
+         job->resampler_ident, job->quality);
+   if (entry)
+      retro_atomic_fetch_sub_int(&entry->refs, 1);
+
+   AUDIO_MIXER_CACHE_LOCK();
+   /* Looked up again on the next play, which finds the entry or,
+    * if it did not fit, queues the sound again. */
+   if (job->sound->pcm_cache == AUDIO_MIXER_PCM_CACHE_PENDING)
+      job->sound->pcm_cache = AUDIO_MIXER_PCM_CACHE_UNKNOWN;
+   s_pcm_cache.decoding = NULL;
+   AUDIO_MIXER_CACHE_UNLOCK();
+
+   slock_unlock(s_pcm_cache.decode_lock);
+   free(job);
+   return true;
+}
+#endif
+
+/* Returns the cache entry to play 'sound' from, holding a
+ * reference to it, or NULL if it is to be streamed.  With the
+ * worker about, a sound that is not in the cache yet is queued
+ * for it and streamed meanwhile; without, it is decoded here. */
+static audio_mixer_pcm_cache_entry_t *audio_mixer_pcm_cache_get(
+      audio_mixer_sound_t* sound,
+      const char *resampler_ident,
+      enum resampler_quality quality)
+{
+   audio_mixer_pcm_cache_entry_t *entry = NULL;
+   bool stream                          = false;
+
+   if (sound->type == AUDIO_MIXER_TYPE_WAV)
+      return NULL;
+
+   AUDIO_MIXER_CACHE_LOCK();
+   if (sound->pcm_cache != AUDIO_MIXER_PCM_CACHE_UNKNOWN)
+      stream = true;
+   else if (!(entry = audio_mixer_pcm_cache_find(sound)))
+   {
+#ifdef HAVE_THREADS
+      if (s_worker.thread)
+         stream = audio_mixer_pcm_cache_queue(sound,
+               resampler_ident, quality);
+#endif
+   }
+   AUDIO_MIXER_CACHE_UNLOCK();
+
+#ifdef HAVE_THREADS
+   if (stream && s_worker.thread)
+      scond_signal(s_worker.cond);
+#endif
+
+   if (entry || stream)
+      return entry;
+
+   return audio_mixer_pcm_cache_decode(sound, resampler_ident, quality);
+}
+
+/* Drops a destroyed sound from the cache.  Voices still
+ * playing from its entry keep it alive until they finish. */
+static void audio_mixer_pcm_cache_forget(const audio_mixer_sound_t *sound)
+{
+   audio_mixer_pcm_cache_entry_t *entry;
+   audio_mixer_pcm_cache_job_t **job;
+#ifdef HAVE_THREADS
+   bool decoding;
+#endif
+
+   AUDIO_MIXER_CACHE_LOCK();
+   for (job = &s_pcm_cache.jobs; *job; )
    {
-      for (i = voice->types.mod.samples; i != 0; i--)
+      audio_mixer_pcm_cache_job_t *next = (*job)->next;
+      if ((*job)->sound == sound)
       {
-         samplef     = ((float)(*pcm++) + 32768.0f) / 65535.0f;
-         samplef     = samplef * 2.0f - 1.0f;
-         *buffer++  += samplef * volume;
+         free(*job);
+         *job = next;
       }
-
-      buf_free -= voice->types.mod.samples;
-      goto again;
+      else
+         job  = &(*job)->next;
    }
+#ifdef HAVE_THREADS
+   decoding = s_pcm_cache.decoding == sound;
+#endif
+   AUDIO_MIXER_CACHE_UNLOCK();
 
-   for (i = buf_free; i != 0; --i )
+#ifdef HAVE_THREADS
+   /* The worker lets go of decode_lock once it is done with
+    * the sound. */
+   if (decoding)
    {
-      samplef     = ((float)(*pcm++) + 32768.0f) / 65535.0f;
-      samplef     = samplef * 2.0f - 1.0f;
-      *buffer++  += samplef * volume;
+      slock_lock(s_pcm_cache.decode_lock);
+      slock_unlock(s_pcm_cache.decode_lock);
    }
+#endif
 
-   voice->types.mod.position += buf_free;
-   voice->types.mod.samples  -= buf_free;
+   AUDIO_MIXER_CACHE_LOCK();
+   for (entry = s_pcm_cache.head; entry; entry = entry->next)
+      if (entry->sound == sound)
+         entry->sound = NULL;
+   audio_mixer_pcm_cache_evict(0);
+   AUDIO_MIXER_CACHE_UNLOCK();
 }
-#endif
 
-#ifdef HAVE_DR_FLAC
-static void audio_mixer_mix_flac(float* buffer, size_t num_frames,
+static bool audio_mixer_play_decoder(audio_mixer_sound_t* sound,
       audio_mixer_voice_t* voice,
-      float volume)
+      bool repeat, float volume,
+      const char *resampler_ident,
+      enum resampler_quality quality,
+      audio_mixer_stop_cb_t stop_cb)
 {
-   int i;
-   struct resampler_data info;
-   float temp_buffer[AUDIO_MIXER_TEMP_BUFFER] = { 0 };
-   unsigned buf_free                = (unsigned)(num_frames * 2);
-   unsigned temp_samples            = 0;
-   float *pcm                       = NULL;
+   switch (sound->type)
+   {
+      case AUDIO_MIXER_TYPE_WAV:
+         return audio_mixer_play_wav(sound, voice, repeat, volume, stop_cb);
+      case AUDIO_MIXER_TYPE_OGG:
+#ifdef HAVE_STB_VORBIS
+         return audio_mixer_play_ogg(sound, voice, repeat, volume,
+               resampler_ident, quality, stop_cb);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_MOD:
+#ifdef HAVE_IBXM
+         return audio_mixer_play_mod(sound, voice, repeat, volume, stop_cb);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_FLAC:
+#ifdef HAVE_DR_FLAC
+         return audio_mixer_play_flac(sound, voice, repeat, volume,
+               resampler_ident, quality, stop_cb);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_MP3:
+#ifdef HAVE_DR_MP3
+         return audio_mixer_play_mp3(sound, voice, repeat, volume,
+               resampler_ident, quality, stop_cb);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_NONE:
+         break;
+   }
+   return false;
+}
 
-   if (voice->types.flac.position == voice->types.flac.samples)
+audio_mixer_voice_t* audio_mixer_play(audio_mixer_sound_t* sound,
+      bool repeat, float volume,
+      const char *resampler_ident,
+      enum resampler_quality quality,
+      audio_mixer_stop_cb_t stop_cb)
+{
+   unsigned i;
+   bool res                             = false;
+   audio_mixer_voice_t* voice           = s_voices;
+   audio_mixer_pcm_cache_entry_t *cache = NULL;
+
+   if (!sound)
+      return NULL;
+
+   cache = audio_mixer_pcm_cache_get(sound, resampler_ident, quality);
+
+   for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
    {
-again:
-      /* drflac_read_pcm_frames_f32 takes a frame count and
-       * writes frame_count * channel_count floats into the
-       * output buffer.  Request at most AUDIO_MIXER_TEMP_BUFFER
-       * / 2 frames so a stereo FLAC fills temp_buffer[AUDIO_
-       * MIXER_TEMP_BUFFER] exactly, then multiply the return
-       * value by 2 to convert frame count to interleaved float
-       * count.  This matches the convention the downstream code
-       * (info.input_frames = temp_samples / 2, memcpy length
-       * of temp_samples * sizeof(float)) and the sibling mp3
-       * and ogg mix paths already use.
-       *
-       * Pre-patch this passed AUDIO_MIXER_TEMP_BUFFER as the
-       * frame count without the '/ 2' and stored the return as
-       * 'temp_samples' without the '* 2'.  For a stereo FLAC
-       * (by far the most common case) drflac wrote 2 *
-       * AUDIO_MIXER_TEMP_BUFFER = 16384 floats into a 8192-
-       * float stack buffer - a 32 KiB stack overflow.  Any
-       * stereo FLAC asset played through the mixer (cheevo
-       * unlock sounds, menu BGM, user-loaded content via the
-       * audio mixer playlist, etc.) corrupted the stack on
-       * every mix tick.  The downstream 'temp_samples / 2'
-       * and memcpy length were also off by 2x under the old
-       * convention, but the stack overflow hit first.
-       *
-       * For mono FLAC: the '* 2' overstates the float count by
-       * 2x, causing the memcpy / resampler to read
-       * uninitialised stack past the actual data.  That matches
-       * the pre-existing implicit stereo-only assumption of
-       * the FLAC/MP3/OGG mixer paths (voice->types.flac.
-       * buf_samples is sized as TEMP_BUFFER * ratio, with no
-       * per-channel adjustment) rather than introducing new
-       * mono handling here.  Fixing mono playback is a separate
-       * change. */
-      temp_samples = (unsigned)drflac_read_pcm_frames_f32(
-            voice->types.flac.stream,
-            AUDIO_MIXER_TEMP_BUFFER / 2, temp_buffer) * 2;
-      if (temp_samples == 0)
+      if (voice->type != AUDIO_MIXER_TYPE_NONE)
+         continue;
+
+      AUDIO_MIXER_LOCK(voice);
+
+      if (voice->type != AUDIO_MIXER_TYPE_NONE)
       {
-         if (voice->repeat)
-         {
-            if (voice->stop_cb)
-               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
+         AUDIO_MIXER_UNLOCK(voice);
+         continue;
+      }
 
-            drflac_seek_to_pcm_frame(voice->types.flac.stream,0);
-            goto again;
-         }
+      /* claim the voice, also helps with cleanup on error */
+      if (cache)
+      {
+         voice->type                = AUDIO_MIXER_TYPE_WAV;
+         voice->types.wav.pcm       = cache->pcm;
+         voice->types.wav.frames    = cache->frames;
+         voice->types.wav.cache     = cache;
+         voice->types.wav.position  = 0;
+         cache                      = NULL;
+         res                        = true;
+      }
+      else
+      {
+         voice->type = sound->type;
+         res         = audio_mixer_play_decoder(sound, voice, repeat,
+               volume, resampler_ident, quality, stop_cb);
+      }
 
-         if (voice->stop_cb)
-            voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
+      break;
+   }
+
+   if (cache)
+      retro_atomic_fetch_sub_int(&cache->refs, 1);
+
+   if (res)
+   {
+      voice->repeat   = repeat;
+      voice->volume   = volume;
+      voice->sound    = sound;
+      voice->stop_cb  = stop_cb;
+      if (voice->type != AUDIO_MIXER_TYPE_WAV)
+         res          = audio_mixer_stream_start(voice);
+   }
 
+   if (res)
+      AUDIO_MIXER_UNLOCK(voice);
+   else
+   {
+      if (i < AUDIO_MIXER_MAX_VOICES)
+      {
          audio_mixer_release(voice);
-         return;
+         AUDIO_MIXER_UNLOCK(voice);
       }
+      voice = NULL;
+   }
 
-      info.data_in              = temp_buffer;
-      info.data_out             = voice->types.flac.buffer;
-      info.input_frames         = temp_samples / 2;
-      info.output_frames        = 0;
-      info.ratio                = voice->types.flac.ratio;
+   return voice;
+}
 
-      if (voice->types.flac.resampler)
-         voice->types.flac.resampler->process(
-               voice->types.flac.resampler_data, &info);
-      else
-         memcpy(voice->types.flac.buffer, temp_buffer, temp_samples * sizeof(float));
-      voice->types.flac.position = 0;
-      voice->types.flac.samples  = voice->types.flac.buf_samples;
+/* Need to hold lock for voice.  */
+static void audio_mixer_release(audio_mixer_voice_t* voice)
+{
+   if (!voice)
+      return;
+
+   if (voice->type != AUDIO_MIXER_TYPE_WAV)
+      audio_mixer_stream_free(voice);
+
+   switch (voice->type)
+   {
+      case AUDIO_MIXER_TYPE_WAV:
+         audio_mixer_release_wav(voice);
+         break;
+#ifdef HAVE_STB_VORBIS
+      case AUDIO_MIXER_TYPE_OGG:
+         audio_mixer_release_ogg(voice);
+         break;
+#endif
+#ifdef HAVE_IBXM
+      case AUDIO_MIXER_TYPE_MOD:
+         audio_mixer_release_mod(voice);
+         break;
+#endif
+#ifdef HAVE_DR_FLAC
+      case AUDIO_MIXER_TYPE_FLAC:
+         audio_mixer_release_flac(voice);
+         break;
+#endif
+#ifdef HAVE_DR_MP3
+      case AUDIO_MIXER_TYPE_MP3:
+         audio_mixer_release_mp3(voice);
+         break;
+#endif
+      default:
+         break;
    }
 
-   pcm = voice->types.flac.buffer + voice->types.flac.position;
+   memset(&voice->types, 0, sizeof(voice->types));
+   voice->type = AUDIO_MIXER_TYPE_NONE;
+}
 
-   if (voice->types.flac.samples < buf_free)
+void audio_mixer_stop(audio_mixer_voice_t* voice)
+{
+   audio_mixer_stop_cb_t stop_cb = NULL;
+   audio_mixer_sound_t* sound    = NULL;
+
+   if (voice)
    {
-      for (i = voice->types.flac.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
+      AUDIO_MIXER_LOCK(voice);
+      stop_cb     = voice->stop_cb;
+      sound       = voice->sound;
 
-      buf_free -= voice->types.flac.samples;
-      goto again;
+      audio_mixer_release(voice);
+
+      AUDIO_MIXER_UNLOCK(voice);
+
+      if (stop_cb)
+         stop_cb(sound, AUDIO_MIXER_SOUND_STOPPED);
    }
+}
+
+#if defined(HAVE_STB_VORBIS) || defined(HAVE_DR_FLAC) || defined(HAVE_DR_MP3)
+/* Returns the number of samples the decoders below put in *out. */
+static unsigned audio_mixer_resample_block(
+      const retro_resampler_t *resampler, void *resampler_data,
+      float ratio, float *buffer, const float *in, unsigned samples,
+      const float **out)
+{
+   struct resampler_data info;
 
-   for (i = buf_free; i != 0; --i )
-      *buffer++ += *pcm++ * volume;
+   if (!resampler)
+   {
+      *out = in;
+      return samples;
+   }
 
-   voice->types.flac.position += buf_free;
-   voice->types.flac.samples  -= buf_free;
+   info.data_in       = in;
+   info.data_out      = buffer;
+   info.input_frames  = samples / 2;
+   info.output_frames = 0;
+   info.ratio         = ratio;
+
+   resampler->process(resampler_data, &info);
+
+   *out = buffer;
+   return (unsigned)(info.output_frames * 2);
+}
+#endif
+
+/* The decoders each produce one block of interleaved stereo
+ * float samples at the mixer's rate, going back to the start of
+ * a repeating voice when it runs out.  They return 0 once a
+ * voice that does not repeat has nothing left. */
+
+#ifdef HAVE_STB_VORBIS
+static unsigned audio_mixer_decode_ogg(audio_mixer_voice_t* voice,
+      const float **out)
+{
+   unsigned temp_samples = stb_vorbis_get_samples_float_interleaved(
+         voice->types.ogg.stream, 2, voice->stream.temp,
+         AUDIO_MIXER_TEMP_BUFFER) * 2;
+
+   if (temp_samples == 0 && voice->repeat)
+   {
+      stb_vorbis_seek_start(voice->types.ogg.stream);
+      retro_atomic_fetch_add_int(&voice->stream.repeats, 1);
+      temp_samples = stb_vorbis_get_samples_float_interleaved(
+            voice->types.ogg.stream, 2, voice->stream.temp,
+            AUDIO_MIXER_TEMP_BUFFER) * 2;
+   }
+
+   if (temp_samples == 0)
+      return 0;
+
+   return audio_mixer_resample_block(voice->types.ogg.resampler,
+         voice->types.ogg.resampler_data, voice->types.ogg.ratio,
+         voice->types.ogg.buffer, voice->stream.temp, temp_samples, out);
+}
+#endif
+
+#ifdef HAVE_IBXM
+static unsigned audio_mixer_decode_mod(audio_mixer_voice_t* voice,
+      const float **out)
+{
+   unsigned i;
+   float *temp           = voice->stream.temp;
+   const int *pcm        = voice->types.mod.buffer;
+   unsigned temp_samples = replay_get_audio(
+         voice->types.mod.stream, voice->types.mod.buffer, 0) * 2;
+
+   if (temp_samples == 0 && voice->repeat)
+   {
+      replay_seek(voice->types.mod.stream, 0);
+      retro_atomic_fetch_add_int(&voice->stream.repeats, 1);
+      temp_samples = replay_get_audio(
+            voice->types.mod.stream, voice->types.mod.buffer, 0) * 2;
+   }
+
+   for (i = 0; i < temp_samples; i++)
+   {
+      float samplef = ((float)pcm[i] + 32768.0f) / 65535.0f;
+      temp[i]       = samplef * 2.0f - 1.0f;
+   }
+
+   *out = temp;
+   return temp_samples;
+}
+#endif
+
+#ifdef HAVE_DR_FLAC
+static unsigned audio_mixer_decode_flac(audio_mixer_voice_t* voice,
+      const float **out)
+{
+   /* drflac_read_pcm_frames_f32 takes a frame count and writes
+    * frame_count * channel_count floats, so ask for half of
+    * temp's AUDIO_MIXER_TEMP_BUFFER floats.  Only stereo FLAC is
+    * accepted by audio_mixer_play_flac. */
+   unsigned temp_samples = (unsigned)drflac_read_pcm_frames_f32(
+         voice->types.flac.stream,
+         AUDIO_MIXER_TEMP_BUFFER / 2, voice->stream.temp) * 2;
+
+   if (temp_samples == 0 && voice->repeat)
+   {
+      drflac_seek_to_pcm_frame(voice->types.flac.stream, 0);
+      retro_atomic_fetch_add_int(&voice->stream.repeats, 1);
+      temp_samples = (unsigned)drflac_read_pcm_frames_f32(
+            voice->types.flac.stream,
+            AUDIO_MIXER_TEMP_BUFFER / 2, voice->stream.temp) * 2;
+   }
+
+   if (temp_samples == 0)
+      return 0;
+
+   return audio_mixer_resample_block(voice->types.flac.resampler,
+         voice->types.flac.resampler_data, voice->types.flac.ratio,
+         voice->types.flac.buffer, voice->stream.temp, temp_samples, out);
 }
 #endif
 
 #ifdef HAVE_DR_MP3
-static void audio_mixer_mix_mp3(float* buffer, size_t num_frames,
-      audio_mixer_voice_t* voice,
-      float volume)
+static unsigned audio_mixer_decode_mp3(audio_mixer_voice_t* voice,
+      const float **out)
 {
-   int i;
-   struct resampler_data info;
-   float temp_buffer[AUDIO_MIXER_TEMP_BUFFER] = { 0 };
-   unsigned buf_free                = (unsigned)(num_frames * 2);
-   unsigned temp_samples            = 0;
-   float* pcm                       = NULL;
+   unsigned temp_samples = (unsigned)drmp3_read_f32(
+         &voice->types.mp3.stream,
+         AUDIO_MIXER_TEMP_BUFFER / 2, voice->stream.temp) * 2;
 
-   if (voice->types.mp3.position == voice->types.mp3.samples)
+   if (temp_samples == 0 && voice->repeat)
    {
-again:
+      drmp3_seek_to_frame(&voice->types.mp3.stream, 0);
+      retro_atomic_fetch_add_int(&voice->stream.repeats, 1);
       temp_samples = (unsigned)drmp3_read_f32(
             &voice->types.mp3.stream,
-            AUDIO_MIXER_TEMP_BUFFER / 2, temp_buffer) * 2;
+            AUDIO_MIXER_TEMP_BUFFER / 2, voice->stream.temp) * 2;
+   }
+
+   if (temp_samples == 0)
+      return 0;
+
+   return audio_mixer_resample_block(voice->types.mp3.resampler,
+         voice->types.mp3.resampler_data, voice->types.mp3.ratio,
+         voice->types.mp3.buffer, voice->stream.temp, temp_samples, out);
+}
+#endif
+
+static unsigned audio_mixer_decode(audio_mixer_voice_t* voice,
+      const float **out)
+{
+   switch (voice->type)
+   {
+      case AUDIO_MIXER_TYPE_OGG:
+#ifdef HAVE_STB_VORBIS
+         return audio_mixer_decode_ogg(voice, out);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_MOD:
+#ifdef HAVE_IBXM
+         return audio_mixer_decode_mod(voice, out);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_FLAC:
+#ifdef HAVE_DR_FLAC
+         return audio_mixer_decode_flac(voice, out);
+#else
+         break;
+#endif
+      case AUDIO_MIXER_TYPE_MP3:
+#ifdef HAVE_DR_MP3
+         return audio_mixer_decode_mp3(voice, out);
+#else
+         break;
+#endif
+      default:
+         break;
+   }
+   return 0;
+}
+
+/* Decodes blocks into the ring until it holds at least 'need'
+ * bytes, it has no room for another block or the voice ends.
+ * Only one thread at a time may call this for a voice. */
+static void audio_mixer_stream_fill(audio_mixer_voice_t* voice,
+      size_t need)
+{
+   while (     !retro_atomic_load_acquire_int(&voice->stream.eos)
+         && retro_spsc_read_avail(&voice->stream.ring) < need
+         && retro_spsc_write_avail(&voice->stream.ring)
+            >= voice->stream.block_bytes)
+   {
+      const float *pcm = NULL;
+      unsigned samples = audio_mixer_decode(voice, &pcm);
 
-      if (temp_samples == 0)
+      if (samples == 0)
       {
-         if (voice->repeat)
-         {
-            if (voice->stop_cb)
-               voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_REPEATED);
+         retro_atomic_store_release_int(&voice->stream.eos, 1);
+         break;
+      }
 
-            drmp3_seek_to_frame(&voice->types.mp3.stream,0);
-            goto again;
-         }
+      retro_spsc_write(&voice->stream.ring, pcm, samples * sizeof(float));
+   }
+}
+
+/* Points at the voice's next 'samples' samples, which are
+ * copied into scratch where the sound loops or ends.  The
+ * pointer is good for as long as the voice stays locked. */
+static const float *audio_mixer_gather_wav(audio_mixer_voice_t* voice,
+      float *scratch, size_t samples, audio_mixer_events_t *events)
+{
+   size_t copied    = 0;
+   size_t available = voice->types.wav.frames * 2
+      - voice->types.wav.position;
+   const float *pcm = voice->types.wav.pcm + voice->types.wav.position;
 
-         if (voice->stop_cb)
-            voice->stop_cb(voice->sound, AUDIO_MIXER_SOUND_FINISHED);
+   if (available >= samples)
+   {
+      voice->types.wav.position += (unsigned)samples;
+      return pcm;
+   }
 
+   for (;;)
+   {
+      size_t _len = MIN(available, samples - copied);
+
+      memcpy(scratch + copied, pcm, _len * sizeof(float));
+      copied                    += _len;
+      voice->types.wav.position += (unsigned)_len;
+
+      if (copied == samples)
+         break;
+
+      if (!voice->repeat || !voice->types.wav.frames)
+      {
+         memset(scratch + copied, 0, (samples - copied) * sizeof(float));
+         events->finished = true;
          audio_mixer_release(voice);
-         return;
+         break;
       }
 
-      info.data_in              = temp_buffer;
-      info.data_out             = voice->types.mp3.buffer;
-      info.input_frames         = temp_samples / 2;
-      info.output_frames        = 0;
-      info.ratio                = voice->types.mp3.ratio;
-
-      if (voice->types.mp3.resampler)
-         voice->types.mp3.resampler->process(
-               voice->types.mp3.resampler_data, &info);
-      else
-         memcpy(voice->types.mp3.buffer, temp_buffer,
-               temp_samples * sizeof(float));
-      voice->types.mp3.position = 0;
-      voice->types.mp3.samples  = voice->types.mp3.buf_samples;
+      events->repeated++;
+      voice->types.wav.position = 0;
+      pcm                       = voice->types.wav.pcm;
+      available                 = voice->types.wav.frames * 2;
    }
 
-   pcm = voice->types.mp3.buffer + voice->types.mp3.position;
+   return scratch;
+}
+
+static const float *audio_mixer_gather_stream(audio_mixer_voice_t* voice,
+      float *scratch, size_t samples, audio_mixer_events_t *events)
+{
+   size_t _len;
+   size_t bytes = samples * sizeof(float);
 
-   if (voice->types.mp3.samples < buf_free)
+#ifdef HAVE_THREADS
+   if (!s_worker.thread)
+#endif
+      audio_mixer_stream_fill(voice, bytes);
+
+   _len = retro_spsc_read(&voice->stream.ring, scratch, bytes);
+
+   /* Running short before the worker has reached the end just
+    * leaves silence; the voice carries on once it catches up. */
+   if (_len < bytes)
    {
-      for (i = voice->types.mp3.samples; i != 0; i--)
-         *buffer++ += *pcm++ * volume;
+      memset((uint8_t*)scratch + _len, 0, bytes - _len);
 
-      buf_free -= voice->types.mp3.samples;
-      goto again;
+      if (     retro_atomic_load_acquire_int(&voice->stream.eos)
+            && !retro_spsc_read_avail(&voice->stream.ring))
+      {
+         events->finished = true;
+         audio_mixer_release(voice);
+         return scratch;
+      }
    }
 
-   for (i = buf_free; i != 0; --i )
-      *buffer++ += *pcm++ * volume;
+#ifdef HAVE_THREADS
+   if (s_worker.thread)
+      scond_signal(s_worker.cond);
+#endif
 
-   voice->types.mp3.position += buf_free;
-   voice->types.mp3.samples  -= buf_free;
+   return scratch;
+}
+
+#ifdef HAVE_THREADS
+static void audio_mixer_worker(void *data)
+{
+   slock_lock(s_worker.lock);
+
+   while (s_worker.alive)
+   {
+      unsigned i;
+      bool busy;
+
+      slock_unlock(s_worker.lock);
+
+      for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
+      {
+         audio_mixer_voice_t *voice = &s_voices[i];
+
+         if (!retro_atomic_load_acquire_int(&voice->stream.active))
+            continue;
+
+         slock_lock(voice->decode_lock);
+         if (retro_atomic_load_acquire_int(&voice->stream.active))
+            audio_mixer_stream_fill(voice, (size_t)-1);
+         slock_unlock(voice->decode_lock);
+      }
+
+      /* One sound at a time, so the streams are topped up in
+       * between. */
+      busy = audio_mixer_pcm_cache_run_job();
+
+      slock_lock(s_worker.lock);
+      if (s_worker.alive && !busy)
+         scond_wait_timeout(s_worker.cond, s_worker.lock,
+               AUDIO_MIXER_WORKER_INTERVAL);
+   }
+
+   slock_unlock(s_worker.lock);
 }
 #endif
 
@@ -1390,56 +2012,83 @@ void audio_mixer_mix(float* buffer, size_t num_frames,
       float volume_override, bool override)
 {
    unsigned i;
-   size_t j                   = 0;
-   float* sample              = NULL;
-   audio_mixer_voice_t* voice = s_voices;
-
-   for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
+   size_t pos;
+   size_t samples             = num_frames * 2;
+   audio_mixer_voice_t* voice = NULL;
+   audio_mixer_events_t events[AUDIO_MIXER_MAX_VOICES];
+
+   /* Every voice stays locked until the whole buffer is mixed,
+    * since the batches point straight into their PCM.  Stop
+    * callbacks wait until the voices are let go, as they may
+    * well play or stop a voice themselves. */
+   for (i = 0, voice = s_voices; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
    {
-      float volume;
-
       AUDIO_MIXER_LOCK(voice);
 
-      volume = (override) ? volume_override : voice->volume;
+      events[i].stop_cb  = voice->stop_cb;
+      events[i].sound    = voice->sound;
+      events[i].repeated = 0;
+      events[i].finished = false;
 
-      switch (voice->type)
+      if (     voice->type != AUDIO_MIXER_TYPE_NONE
+            && voice->type != AUDIO_MIXER_TYPE_WAV)
       {
-         case AUDIO_MIXER_TYPE_WAV:
-            audio_mixer_mix_wav(buffer, num_frames, voice, volume);
-            break;
-         case AUDIO_MIXER_TYPE_OGG:
-#ifdef HAVE_STB_VORBIS
-            audio_mixer_mix_ogg(buffer, num_frames, voice, volume);
-#endif
-            break;
-         case AUDIO_MIXER_TYPE_MOD:
-#ifdef HAVE_IBXM
-            audio_mixer_mix_mod(buffer, num_frames, voice, volume);
-#endif
-            break;
-         case AUDIO_MIXER_TYPE_FLAC:
-#ifdef HAVE_DR_FLAC
-            audio_mixer_mix_flac(buffer, num_frames, voice, volume);
-#endif
-            break;
+         int repeats = retro_atomic_load_acquire_int(&voice->stream.repeats);
+         if (repeats)
+         {
+            retro_atomic_fetch_sub_int(&voice->stream.repeats, repeats);
+            events[i].repeated = repeats;
+         }
+      }
+   }
+
+   for (pos = 0; pos < samples; pos += AUDIO_MIXER_MIX_CHUNK)
+   {
+      const float *src[AUDIO_MIXER_MAX_VOICES];
+      float vol[AUDIO_MIXER_MAX_VOICES];
+      unsigned count = 0;
+      size_t chunk   = MIN(samples - pos, AUDIO_MIXER_MIX_CHUNK);
+
+      for (i = 0, voice = s_voices; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
+      {
+         switch (voice->type)
+         {
+            case AUDIO_MIXER_TYPE_WAV:
+               src[count] = audio_mixer_gather_wav(voice,
+                     s_mix_scratch[i], chunk, &events[i]);
+               break;
+            case AUDIO_MIXER_TYPE_OGG:
+            case AUDIO_MIXER_TYPE_MOD:
+            case AUDIO_MIXER_TYPE_FLAC:
             case AUDIO_MIXER_TYPE_MP3:
-#ifdef HAVE_DR_MP3
-            audio_mixer_mix_mp3(buffer, num_frames, voice, volume);
-#endif
-            break;
-         case AUDIO_MIXER_TYPE_NONE:
-            break;
+               src[count] = audio_mixer_gather_stream(voice,
+                     s_mix_scratch[i], chunk, &events[i]);
+               break;
+            default:
+               continue;
+         }
+
+         vol[count++] = (override) ? volume_override : voice->volume;
       }
 
-      AUDIO_MIXER_UNLOCK(voice);
+      if (count)
+         audio_mix_volume_batch(buffer + pos, src, vol, count, chunk);
+      audio_mix_clamp(buffer + pos, chunk);
    }
 
-   for (j = 0, sample = buffer; j < num_frames * 2; j++, sample++)
+   for (i = 0, voice = s_voices; i < AUDIO_MIXER_MAX_VOICES; i++, voice++)
+      AUDIO_MIXER_UNLOCK(voice);
+
+   for (i = 0; i < AUDIO_MIXER_MAX_VOICES; i++)
    {
-      if (*sample < -1.0f)
-         *sample = -1.0f;
-      else if (*sample > 1.0f)
-         *sample = 1.0f;
+      if (!events[i].stop_cb)
+         continue;
+
+      for (; events[i].repeated; events[i].repeated--)
+         events[i].stop_cb(events[i].sound, AUDIO_MIXER_SOUND_REPEATED);
+
+      if (events[i].finished)
+         events[i].stop_cb(events[i].sound, AUDIO_MIXER_SOUND_FINISHED);
    }
 }
 
@@ -30,19 +30,19 @@
 #include <libretro_dspfilter.h>
 
 #include "fft/fft.c"
+#include "fft/convolver.c"
 
 struct eq_data
 {
-   fft_t *fft;
-   float *save;
-   float *block;
-   fft_complex_t *filter;
-   fft_complex_t *fftblock;
+   fft_convolver_t *conv;
    float buffer[8 * 1024];
    unsigned block_size;
-   unsigned block_ptr;
 };
 
+/* The convolver kernel is picked from the mask handed to
+ * dspfilter_get_implementation(). */
+static dspfilter_simd_mask_t eq_simd_mask;
+
 struct eq_gain
 {
    float freq;
@@ -55,67 +55,18 @@ static void eq_free(void *data)
    if (!eq)
       return;
 
-   fft_free(eq->fft);
-   free(eq->save);
-   free(eq->block);
-   free(eq->fftblock);
-   free(eq->filter);
+   fft_convolver_free(eq->conv);
    free(eq);
 }
 
 static void eq_process(void *data, struct dspfilter_output *output,
       const struct dspfilter_input *input)
 {
-   float *out;
-   const float *in;
-   unsigned input_frames;
    struct eq_data *eq = (struct eq_data*)data;
 
    output->samples    = eq->buffer;
-   output->frames     = 0;
-
-   out                = eq->buffer;
-   in                 = input->samples;
-   input_frames       = input->frames;
-
-   while (input_frames)
-   {
-      unsigned write_avail = eq->block_size - eq->block_ptr;
-
-      if (input_frames < write_avail)
-         write_avail = input_frames;
-
-      memcpy(eq->block + eq->block_ptr * 2, in, write_avail * 2 * sizeof(float));
-
-      in            += write_avail * 2;
-      input_frames  -= write_avail;
-      eq->block_ptr += write_avail;
-
-      /* Convolve a new block. */
-      if (eq->block_ptr == eq->block_size)
-      {
-         unsigned i, c;
-
-         for (c = 0; c < 2; c++)
-         {
-            fft_process_forward(eq->fft, eq->fftblock, eq->block + c, 2);
-            for (i = 0; i < 2 * eq->block_size; i++)
-               eq->fftblock[i] = fft_complex_mul(eq->fftblock[i], eq->filter[i]);
-            fft_process_inverse(eq->fft, out + c, eq->fftblock, 2);
-         }
-
-         /* Overlap add method, so add in saved block now. */
-         for (i = 0; i < 2 * eq->block_size; i++)
-            out[i]      += eq->save[i];
-
-         /* Save block for later. */
-         memcpy(eq->save, out + 2 * eq->block_size, 2 * eq->block_size * sizeof(float));
-
-         out            += eq->block_size * 2;
-         output->frames += eq->block_size;
-         eq->block_ptr   = 0;
-      }
-   }
+   output->frames     = fft_convolver_process(eq->conv,
+         eq->buffer, input->samples, input->frames);
 }
 
 static int gains_cmp(const void *a_, const void *b_)
@@ -190,25 +141,27 @@ static void generate_response(fft_complex_t *response,
    }
 }
 
-static void create_filter(struct eq_data *eq, unsigned size_log2,
-      struct eq_gain *gains, unsigned num_gains, double beta, const char *filter_path)
+static bool create_filter(struct eq_data *eq, unsigned size_log2,
+      unsigned partition_log2, struct eq_gain *gains, unsigned num_gains,
+      double beta, const char *filter_path)
 {
    int i;
    int half_block_size = eq->block_size >> 1;
    double window_mod   = 1.0 / kaiser_window_function(0.0, beta);
    fft_t *fft          = fft_new(size_log2);
    float *time_filter  = (float*)calloc(eq->block_size * 2 + 1, sizeof(*time_filter));
-   if (!fft || !time_filter)
+   fft_complex_t *response = (fft_complex_t*)calloc(eq->block_size + 1, sizeof(*response));
+   if (!fft || !time_filter || !response)
       goto end;
 
    /* Make sure bands are in correct order. */
    qsort(gains, num_gains, sizeof(*gains), gains_cmp);
 
    /* Compute desired filter response. */
-   generate_response(eq->filter, gains, num_gains, half_block_size);
+   generate_response(response, gains, num_gains, half_block_size);
 
    /* Get equivalent time-domain filter. */
-   fft_process_inverse(fft, time_filter, eq->filter, 1);
+   fft_process_inverse(fft, time_filter, response, 1);
 
    /* ifftshift() to create the correct linear phase filter.
     * The filter response was designed with zero phase, which
@@ -245,21 +198,24 @@ static void create_filter(struct eq_data *eq, unsigned size_log2,
    }
 #endif
 
-   /* Padded FFT to create our FFT filter.
+   /* Partitioned convolution with our filter.
     * Make our even-length filter odd by discarding the first coefficient.
     * For some interesting reason, this allows us to design an odd-length linear phase filter.
     */
-   fft_process_forward(eq->fft, eq->filter, time_filter + 1, 1);
+   eq->conv = fft_convolver_new(time_filter + 1, eq->block_size - 1,
+         partition_log2, eq_simd_mask);
 
 end:
    fft_free(fft);
    free(time_filter);
+   free(response);
+   return eq->conv != NULL;
 }
 
 static void *eq_init(const struct dspfilter_info *info,
       const struct dspfilter_config *config, void *userdata)
 {
-   int size_log2;
+   int size_log2, partition_log2;
    float beta;
    float *frequencies, *gain;
    unsigned num_freq, num_gain, i, size;
@@ -276,6 +232,11 @@ static void *eq_init(const struct dspfilter_info *info,
    config->get_int(userdata, "block_size_log2", &size_log2, 8);
    size = 1 << size_log2;
 
+   /* Frames go out one partition after they come in, whatever
+    * the block size.  Smaller partitions cost more CPU. */
+   config->get_int(userdata, "partition_size_log2", &partition_log2, 6);
+   partition_log2 = MAX(2, MIN(partition_log2, size_log2));
+
    config->get_float_array(userdata, "frequencies", &frequencies, &num_freq, default_freq, 2);
    config->get_float_array(userdata, "gains", &gain, &num_gain, default_gain, 2);
 
@@ -300,20 +261,9 @@ static void *eq_init(const struct dspfilter_info *info,
 
    eq->block_size = size;
 
-   eq->save       = (float*)calloc(    size, 2 * sizeof(*eq->save));
-   eq->block      = (float*)calloc(2 * size, 2 * sizeof(*eq->block));
-   eq->fftblock   = (fft_complex_t*)calloc(2 * size, sizeof(*eq->fftblock));
-   eq->filter     = (fft_complex_t*)calloc(2 * size, sizeof(*eq->filter));
-
-   /* Use an FFT which is twice the block size with zero-padding
-    * to make circular convolution => proper convolution.
-    */
-   eq->fft        = fft_new(size_log2 + 1);
-
-   if (!eq->fft || !eq->fftblock || !eq->save || !eq->block || !eq->filter)
+   if (!create_filter(eq, size_log2, partition_log2,
+            gains, num_gain, beta, filter_path))
       goto error;
-
-   create_filter(eq, size_log2, gains, num_gain, beta, filter_path);
    config->free(filter_path);
    filter_path = NULL;
 
@@ -321,6 +271,7 @@ static void *eq_init(const struct dspfilter_info *info,
    return eq;
 
 error:
+   config->free(filter_path);
    free(gains);
    eq_free(eq);
    return NULL;
@@ -342,6 +293,7 @@ static const struct dspfilter_implementation eq_plug = {
 
 const struct dspfilter_implementation *dspfilter_get_implementation(dspfilter_simd_mask_t mask)
 {
+   eq_simd_mask = mask;
    return &eq_plug;
 }
 
@@ -0,0 +1,766 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (convolver.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "convolver.h"
+
+#include <boolean.h>
+#include <retro_miscellaneous.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+/* The AVX kernel is built regardless of the baseline -m flags
+ * and only picked when the mask has the AVX bit, so a generic
+ * x86 build still gets it.  No kernel uses FMA. */
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define FFT_CONV_AVX
+#define FFT_CONV_TARGET_AVX __attribute__((target("avx")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#define FFT_CONV_AVX
+#define FFT_CONV_TARGET_AVX
+#endif
+#endif
+
+/* The FFT works on split real/imaginary arrays so every kernel
+ * can load four or eight bins at once.  The forward transform is
+ * radix-4 decimation in frequency and leaves its output in digit
+ * reversed order; the inverse is the matching decimation in time
+ * and takes that order back to natural.  Spectra are only ever
+ * multiplied bin by bin, so they are never reordered.  An odd
+ * log2 size ends (forward) or starts (inverse) with one radix-2
+ * pass.  The inverse is not scaled: the filter spectra carry the
+ * 1 / size instead.
+ *
+ * A radix-4 pass over groups of 4 * q bins takes twiddles
+ * w^j, w^2j and w^3j for j < q, w = exp(-2 pi i / 4q), laid out
+ * as 6 runs of q floats: w1 real, w1 imag, w2 real, ... */
+typedef void (*fft_conv_pass_t)(float *re, float *im,
+      unsigned size, unsigned q, const float *tw);
+
+typedef void (*fft_conv_mac_t)(float *acc_re, float *acc_im,
+      const float *x_re, const float *x_im,
+      const float *h_re, const float *h_im, unsigned size);
+
+struct fft_conv_kernel
+{
+   const char *name;
+   fft_conv_pass_t forward;
+   fft_conv_pass_t inverse;
+   fft_conv_mac_t mac;
+   /* Passes with q under this go to the C kernel. */
+   unsigned width;
+};
+
+struct fft_convolver
+{
+   const struct fft_conv_kernel *kernel;
+
+   float *twiddles;
+   unsigned *pass_q;
+   unsigned *pass_tw;
+   unsigned passes;
+   bool radix2;
+
+   /* Last two partitions of input, left in re and right in im. */
+   float *time_re;
+   float *time_im;
+   /* Spectra of the last 'parts' input blocks, 'fdl_pos' is the
+    * slot the next one goes into. */
+   float *fdl_re;
+   float *fdl_im;
+   float *filter_re;
+   float *filter_im;
+   float *acc_re;
+   float *acc_im;
+
+   unsigned size;
+   unsigned partition;
+   unsigned parts;
+   unsigned fdl_pos;
+   unsigned fill;
+};
+
+static void fft_conv_forward_C(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j++)
+      {
+         float t0r = r0[j] + r2[j];
+         float t0i = i0[j] + i2[j];
+         float t1r = r0[j] - r2[j];
+         float t1i = i0[j] - i2[j];
+         float t2r = r1[j] + r3[j];
+         float t2i = i1[j] + i3[j];
+         /* -i * (b - d) */
+         float t3r = i1[j] - i3[j];
+         float t3i = r3[j] - r1[j];
+         float y1r = t1r + t3r;
+         float y1i = t1i + t3i;
+         float y2r = t0r - t2r;
+         float y2i = t0i - t2i;
+         float y3r = t1r - t3r;
+         float y3i = t1i - t3i;
+
+         r0[j] = t0r + t2r;
+         i0[j] = t0i + t2i;
+         r1[j] = y1r * w1r[j] - y1i * w1i[j];
+         i1[j] = y1r * w1i[j] + y1i * w1r[j];
+         r2[j] = y2r * w2r[j] - y2i * w2i[j];
+         i2[j] = y2r * w2i[j] + y2i * w2r[j];
+         r3[j] = y3r * w3r[j] - y3i * w3i[j];
+         i3[j] = y3r * w3i[j] + y3i * w3r[j];
+      }
+   }
+}
+
+static void fft_conv_inverse_C(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j++)
+      {
+         /* Twiddles conjugated. */
+         float z1r = r1[j] * w1r[j] + i1[j] * w1i[j];
+         float z1i = i1[j] * w1r[j] - r1[j] * w1i[j];
+         float z2r = r2[j] * w2r[j] + i2[j] * w2i[j];
+         float z2i = i2[j] * w2r[j] - r2[j] * w2i[j];
+         float z3r = r3[j] * w3r[j] + i3[j] * w3i[j];
+         float z3i = i3[j] * w3r[j] - r3[j] * w3i[j];
+         float s0r = r0[j] + z2r;
+         float s0i = i0[j] + z2i;
+         float s1r = r0[j] - z2r;
+         float s1i = i0[j] - z2i;
+         float s2r = z1r + z3r;
+         float s2i = z1i + z3i;
+         /* i * (z1 - z3) */
+         float s3r = z3i - z1i;
+         float s3i = z1r - z3r;
+
+         r0[j] = s0r + s2r;
+         i0[j] = s0i + s2i;
+         r1[j] = s1r + s3r;
+         i1[j] = s1i + s3i;
+         r2[j] = s0r - s2r;
+         i2[j] = s0i - s2i;
+         r3[j] = s1r - s3r;
+         i3[j] = s1i - s3i;
+      }
+   }
+}
+
+static void fft_conv_mac_C(float *acc_re, float *acc_im,
+      const float *x_re, const float *x_im,
+      const float *h_re, const float *h_im, unsigned size)
+{
+   unsigned i;
+   for (i = 0; i < size; i++)
+   {
+      acc_re[i] += x_re[i] * h_re[i] - x_im[i] * h_im[i];
+      acc_im[i] += x_re[i] * h_im[i] + x_im[i] * h_re[i];
+   }
+}
+
+/* Same for both directions. */
+static void fft_conv_radix2(float *re, float *im, unsigned size)
+{
+   unsigned g;
+   for (g = 0; g < size; g += 2)
+   {
+      float ar = re[g], ai = im[g];
+      float br = re[g + 1], bi = im[g + 1];
+      re[g]     = ar + br;
+      im[g]     = ai + bi;
+      re[g + 1] = ar - br;
+      im[g + 1] = ai - bi;
+   }
+}
+
+#if defined(__SSE__)
+static void fft_conv_forward_SSE(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j += 4)
+      {
+         __m128 ar  = _mm_loadu_ps(r0 + j), ai = _mm_loadu_ps(i0 + j);
+         __m128 br  = _mm_loadu_ps(r1 + j), bi = _mm_loadu_ps(i1 + j);
+         __m128 cr  = _mm_loadu_ps(r2 + j), ci = _mm_loadu_ps(i2 + j);
+         __m128 dr  = _mm_loadu_ps(r3 + j), di = _mm_loadu_ps(i3 + j);
+         __m128 t0r = _mm_add_ps(ar, cr),   t0i = _mm_add_ps(ai, ci);
+         __m128 t1r = _mm_sub_ps(ar, cr),   t1i = _mm_sub_ps(ai, ci);
+         __m128 t2r = _mm_add_ps(br, dr),   t2i = _mm_add_ps(bi, di);
+         __m128 t3r = _mm_sub_ps(bi, di),   t3i = _mm_sub_ps(dr, br);
+         __m128 y1r = _mm_add_ps(t1r, t3r), y1i = _mm_add_ps(t1i, t3i);
+         __m128 y2r = _mm_sub_ps(t0r, t2r), y2i = _mm_sub_ps(t0i, t2i);
+         __m128 y3r = _mm_sub_ps(t1r, t3r), y3i = _mm_sub_ps(t1i, t3i);
+         __m128 wr, wi;
+
+         _mm_storeu_ps(r0 + j, _mm_add_ps(t0r, t2r));
+         _mm_storeu_ps(i0 + j, _mm_add_ps(t0i, t2i));
+
+         wr = _mm_loadu_ps(w1r + j);
+         wi = _mm_loadu_ps(w1i + j);
+         _mm_storeu_ps(r1 + j, _mm_sub_ps(_mm_mul_ps(y1r, wr), _mm_mul_ps(y1i, wi)));
+         _mm_storeu_ps(i1 + j, _mm_add_ps(_mm_mul_ps(y1r, wi), _mm_mul_ps(y1i, wr)));
+
+         wr = _mm_loadu_ps(w2r + j);
+         wi = _mm_loadu_ps(w2i + j);
+         _mm_storeu_ps(r2 + j, _mm_sub_ps(_mm_mul_ps(y2r, wr), _mm_mul_ps(y2i, wi)));
+         _mm_storeu_ps(i2 + j, _mm_add_ps(_mm_mul_ps(y2r, wi), _mm_mul_ps(y2i, wr)));
+
+         wr = _mm_loadu_ps(w3r + j);
+         wi = _mm_loadu_ps(w3i + j);
+         _mm_storeu_ps(r3 + j, _mm_sub_ps(_mm_mul_ps(y3r, wr), _mm_mul_ps(y3i, wi)));
+         _mm_storeu_ps(i3 + j, _mm_add_ps(_mm_mul_ps(y3r, wi), _mm_mul_ps(y3i, wr)));
+      }
+   }
+}
+
+static void fft_conv_inverse_SSE(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j += 4)
+      {
+         __m128 ar  = _mm_loadu_ps(r0 + j), ai = _mm_loadu_ps(i0 + j);
+         __m128 br  = _mm_loadu_ps(r1 + j), bi = _mm_loadu_ps(i1 + j);
+         __m128 cr  = _mm_loadu_ps(r2 + j), ci = _mm_loadu_ps(i2 + j);
+         __m128 dr  = _mm_loadu_ps(r3 + j), di = _mm_loadu_ps(i3 + j);
+         __m128 wr  = _mm_loadu_ps(w1r + j), wi = _mm_loadu_ps(w1i + j);
+         __m128 z1r = _mm_add_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+         __m128 z1i = _mm_sub_ps(_mm_mul_ps(bi, wr), _mm_mul_ps(br, wi));
+         __m128 z2r, z2i, z3r, z3i;
+         __m128 s0r, s0i, s1r, s1i, s2r, s2i, s3r, s3i;
+
+         wr  = _mm_loadu_ps(w2r + j);
+         wi  = _mm_loadu_ps(w2i + j);
+         z2r = _mm_add_ps(_mm_mul_ps(cr, wr), _mm_mul_ps(ci, wi));
+         z2i = _mm_sub_ps(_mm_mul_ps(ci, wr), _mm_mul_ps(cr, wi));
+         wr  = _mm_loadu_ps(w3r + j);
+         wi  = _mm_loadu_ps(w3i + j);
+         z3r = _mm_add_ps(_mm_mul_ps(dr, wr), _mm_mul_ps(di, wi));
+         z3i = _mm_sub_ps(_mm_mul_ps(di, wr), _mm_mul_ps(dr, wi));
+
+         s0r = _mm_add_ps(ar, z2r);
+         s0i = _mm_add_ps(ai, z2i);
+         s1r = _mm_sub_ps(ar, z2r);
+         s1i = _mm_sub_ps(ai, z2i);
+         s2r = _mm_add_ps(z1r, z3r);
+         s2i = _mm_add_ps(z1i, z3i);
+         s3r = _mm_sub_ps(z3i, z1i);
+         s3i = _mm_sub_ps(z1r, z3r);
+
+         _mm_storeu_ps(r0 + j, _mm_add_ps(s0r, s2r));
+         _mm_storeu_ps(i0 + j, _mm_add_ps(s0i, s2i));
+         _mm_storeu_ps(r1 + j, _mm_add_ps(s1r, s3r));
+         _mm_storeu_ps(i1 + j, _mm_add_ps(s1i, s3i));
+         _mm_storeu_ps(r2 + j, _mm_sub_ps(s0r, s2r));
+         _mm_storeu_ps(i2 + j, _mm_sub_ps(s0i, s2i));
+         _mm_storeu_ps(r3 + j, _mm_sub_ps(s1r, s3r));
+         _mm_storeu_ps(i3 + j, _mm_sub_ps(s1i, s3i));
+      }
+   }
+}
+
+/* 'size' is at least 8, so always a multiple of 4. */
+static void fft_conv_mac_SSE(float *acc_re, float *acc_im,
+      const float *x_re, const float *x_im,
+      const float *h_re, const float *h_im, unsigned size)
+{
+   unsigned i;
+   for (i = 0; i < size; i += 4)
+   {
+      __m128 xr = _mm_loadu_ps(x_re + i), xi = _mm_loadu_ps(x_im + i);
+      __m128 hr = _mm_loadu_ps(h_re + i), hi = _mm_loadu_ps(h_im + i);
+      _mm_storeu_ps(acc_re + i, _mm_add_ps(_mm_loadu_ps(acc_re + i),
+               _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi))));
+      _mm_storeu_ps(acc_im + i, _mm_add_ps(_mm_loadu_ps(acc_im + i),
+               _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr))));
+   }
+}
+
+static const struct fft_conv_kernel fft_conv_kernel_SSE = {
+   "SSE",
+   fft_conv_forward_SSE,
+   fft_conv_inverse_SSE,
+   fft_conv_mac_SSE,
+   4
+};
+#endif
+
+#ifdef FFT_CONV_AVX
+FFT_CONV_TARGET_AVX
+static void fft_conv_forward_AVX(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j += 8)
+      {
+         __m256 ar  = _mm256_loadu_ps(r0 + j), ai = _mm256_loadu_ps(i0 + j);
+         __m256 br  = _mm256_loadu_ps(r1 + j), bi = _mm256_loadu_ps(i1 + j);
+         __m256 cr  = _mm256_loadu_ps(r2 + j), ci = _mm256_loadu_ps(i2 + j);
+         __m256 dr  = _mm256_loadu_ps(r3 + j), di = _mm256_loadu_ps(i3 + j);
+         __m256 t0r = _mm256_add_ps(ar, cr),   t0i = _mm256_add_ps(ai, ci);
+         __m256 t1r = _mm256_sub_ps(ar, cr),   t1i = _mm256_sub_ps(ai, ci);
+         __m256 t2r = _mm256_add_ps(br, dr),   t2i = _mm256_add_ps(bi, di);
+         __m256 t3r = _mm256_sub_ps(bi, di),   t3i = _mm256_sub_ps(dr, br);
+         __m256 y1r = _mm256_add_ps(t1r, t3r), y1i = _mm256_add_ps(t1i, t3i);
+         __m256 y2r = _mm256_sub_ps(t0r, t2r), y2i = _mm256_sub_ps(t0i, t2i);
+         __m256 y3r = _mm256_sub_ps(t1r, t3r), y3i = _mm256_sub_ps(t1i, t3i);
+         __m256 wr, wi;
+
+         _mm256_storeu_ps(r0 + j, _mm256_add_ps(t0r, t2r));
+         _mm256_storeu_ps(i0 + j, _mm256_add_ps(t0i, t2i));
+
+         wr = _mm256_loadu_ps(w1r + j);
+         wi = _mm256_loadu_ps(w1i + j);
+         _mm256_storeu_ps(r1 + j, _mm256_sub_ps(_mm256_mul_ps(y1r, wr), _mm256_mul_ps(y1i, wi)));
+         _mm256_storeu_ps(i1 + j, _mm256_add_ps(_mm256_mul_ps(y1r, wi), _mm256_mul_ps(y1i, wr)));
+
+         wr = _mm256_loadu_ps(w2r + j);
+         wi = _mm256_loadu_ps(w2i + j);
+         _mm256_storeu_ps(r2 + j, _mm256_sub_ps(_mm256_mul_ps(y2r, wr), _mm256_mul_ps(y2i, wi)));
+         _mm256_storeu_ps(i2 + j, _mm256_add_ps(_mm256_mul_ps(y2r, wi), _mm256_mul_ps(y2i, wr)));
+
+         wr = _mm256_loadu_ps(w3r + j);
+         wi = _mm256_loadu_ps(w3i + j);
+         _mm256_storeu_ps(r3 + j, _mm256_sub_ps(_mm256_mul_ps(y3r, wr), _mm256_mul_ps(y3i, wi)));
+         _mm256_storeu_ps(i3 + j, _mm256_add_ps(_mm256_mul_ps(y3r, wi), _mm256_mul_ps(y3i, wr)));
+      }
+   }
+}
+
+FFT_CONV_TARGET_AVX
+static void fft_conv_inverse_AVX(float *re, float *im,
+      unsigned size, unsigned q, const float *tw)
+{
+   unsigned g, j;
+   const float *w1r = tw;
+   const float *w1i = tw + q;
+   const float *w2r = tw + 2 * q;
+   const float *w2i = tw + 3 * q;
+   const float *w3r = tw + 4 * q;
+   const float *w3i = tw + 5 * q;
+
+   for (g = 0; g < size; g += 4 * q)
+   {
+      float *r0 = re + g, *r1 = r0 + q, *r2 = r1 + q, *r3 = r2 + q;
+      float *i0 = im + g, *i1 = i0 + q, *i2 = i1 + q, *i3 = i2 + q;
+
+      for (j = 0; j < q; j += 8)
+      {
+         __m256 ar  = _mm256_loadu_ps(r0 + j), ai = _mm256_loadu_ps(i0 + j);
+         __m256 br  = _mm256_loadu_ps(r1 + j), bi = _mm256_loadu_ps(i1 + j);
+         __m256 cr  = _mm256_loadu_ps(r2 + j), ci = _mm256_loadu_ps(i2 + j);
+         __m256 dr  = _mm256_loadu_ps(r3 + j), di = _mm256_loadu_ps(i3 + j);
+         __m256 wr  = _mm256_loadu_ps(w1r + j), wi = _mm256_loadu_ps(w1i + j);
+         __m256 z1r = _mm256_add_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi));
+         __m256 z1i = _mm256_sub_ps(_mm256_mul_ps(bi, wr), _mm256_mul_ps(br, wi));
+         __m256 z2r, z2i, z3r, z3i;
+         __m256 s0r, s0i, s1r, s1i, s2r, s2i, s3r, s3i;
+
+         wr  = _mm256_loadu_ps(w2r + j);
+         wi  = _mm256_loadu_ps(w2i + j);
+         z2r = _mm256_add_ps(_mm256_mul_ps(cr, wr), _mm256_mul_ps(ci, wi));
+         z2i = _mm256_sub_ps(_mm256_mul_ps(ci, wr), _mm256_mul_ps(cr, wi));
+         wr  = _mm256_loadu_ps(w3r + j);
+         wi  = _mm256_loadu_ps(w3i + j);
+         z3r = _mm256_add_ps(_mm256_mul_ps(dr, wr), _mm256_mul_ps(di, wi));
+         z3i = _mm256_sub_ps(_mm256_mul_ps(di, wr), _mm256_mul_ps(dr, wi));
+
+         s0r = _mm256_add_ps(ar, z2r);
+         s0i = _mm256_add_ps(ai, z2i);
+         s1r = _mm256_sub_ps(ar, z2r);
+         s1i = _mm256_sub_ps(ai, z2i);
+         s2r = _mm256_add_ps(z1r, z3r);
+         s2i = _mm256_add_ps(z1i, z3i);
+         s3r = _mm256_sub_ps(z3i, z1i);
+         s3i = _mm256_sub_ps(z1r, z3r);
+
+         _mm256_storeu_ps(r0 + j, _mm256_add_ps(s0r, s2r));
+         _mm256_storeu_ps(i0 + j, _mm256_add_ps(s0i, s2i));
+         _mm256_storeu_ps(r1 + j, _mm256_add_ps(s1r, s3r));
+         _mm256_storeu_ps(i1 + j, _mm256_add_ps(s1i, s3i));
+         _mm256_storeu_ps(r2 + j, _mm256_sub_ps(s0r, s2r));
+         _mm256_storeu_ps(i2 + j, _mm256_sub_ps(s0i, s2i));
+         _mm256_storeu_ps(r3 + j, _mm256_sub_ps(s1r, s3r));
+         _mm256_storeu_ps(i3 + j, _mm256_sub_ps(s1i, s3i));
+      }
+   }
+}
+
+FFT_CONV_TARGET_AVX
+static void fft_conv_mac_AVX(float *acc_re, float *acc_im,
+      const float *x_re, const float *x_im,
+      const float *h_re, const float *h_im, unsigned size)
+{
+   unsigned i;
+
+   for (i = 0; i + 8 <= size; i += 8)
+   {
+      __m256 xr = _mm256_loadu_ps(x_re + i), xi = _mm256_loadu_ps(x_im + i);
+      __m256 hr = _mm256_loadu_ps(h_re + i), hi = _mm256_loadu_ps(h_im + i);
+      _mm256_storeu_ps(acc_re + i, _mm256_add_ps(_mm256_loadu_ps(acc_re + i),
+               _mm256_sub_ps(_mm256_mul_ps(xr, hr), _mm256_mul_ps(xi, hi))));
+      _mm256_storeu_ps(acc_im + i, _mm256_add_ps(_mm256_loadu_ps(acc_im + i),
+               _mm256_add_ps(_mm256_mul_ps(xr, hi), _mm256_mul_ps(xi, hr))));
+   }
+
+   for (; i < size; i++)
+   {
+      acc_re[i] += x_re[i] * h_re[i] - x_im[i] * h_im[i];
+      acc_im[i] += x_re[i] * h_im[i] + x_im[i] * h_re[i];
+   }
+}
+
+static const struct fft_conv_kernel fft_conv_kernel_AVX = {
+   "AVX",
+   fft_conv_forward_AVX,
+   fft_conv_inverse_AVX,
+   fft_conv_mac_AVX,
+   8
+};
+#endif
+
+static const struct fft_conv_kernel fft_conv_kernel_C = {
+   "C",
+   fft_conv_forward_C,
+   fft_conv_inverse_C,
+   fft_conv_mac_C,
+   1
+};
+
+static const struct fft_conv_kernel *fft_conv_pick_kernel(
+      dspfilter_simd_mask_t mask)
+{
+#ifdef FFT_CONV_AVX
+   if (mask & DSPFILTER_SIMD_AVX)
+      return &fft_conv_kernel_AVX;
+#endif
+#if defined(__SSE__)
+   if (mask & DSPFILTER_SIMD_SSE)
+      return &fft_conv_kernel_SSE;
+#endif
+   return &fft_conv_kernel_C;
+}
+
+static void fft_conv_forward(const fft_convolver_t *conv,
+      float *re, float *im)
+{
+   unsigned p;
+   for (p = 0; p < conv->passes; p++)
+   {
+      unsigned q = conv->pass_q[p];
+      (q < conv->kernel->width ? fft_conv_forward_C : conv->kernel->forward)(
+            re, im, conv->size, q, conv->twiddles + conv->pass_tw[p]);
+   }
+   if (conv->radix2)
+      fft_conv_radix2(re, im, conv->size);
+}
+
+static void fft_conv_inverse(const fft_convolver_t *conv,
+      float *re, float *im)
+{
+   unsigned p;
+   if (conv->radix2)
+      fft_conv_radix2(re, im, conv->size);
+   for (p = conv->passes; p-- > 0; )
+   {
+      unsigned q = conv->pass_q[p];
+      (q < conv->kernel->width ? fft_conv_inverse_C : conv->kernel->inverse)(
+            re, im, conv->size, q, conv->twiddles + conv->pass_tw[p]);
+   }
+}
+
+static bool fft_conv_build_passes(fft_convolver_t *conv, unsigned size_log2)
+{
+   unsigned p, j, k;
+   unsigned tw_len = 0;
+   unsigned n      = conv->size;
+
+   conv->passes    = size_log2 / 2;
+   conv->radix2    = (size_log2 & 1) != 0;
+   conv->pass_q    = (unsigned*)calloc(conv->passes, sizeof(*conv->pass_q));
+   conv->pass_tw   = (unsigned*)calloc(conv->passes, sizeof(*conv->pass_tw));
+   if (!conv->pass_q || !conv->pass_tw)
+      return false;
+
+   for (p = 0; p < conv->passes; p++, n >>= 2)
+   {
+      conv->pass_q[p]  = n >> 2;
+      conv->pass_tw[p] = tw_len;
+      tw_len          += 6 * (n >> 2);
+   }
+
+   if (!(conv->twiddles = (float*)malloc(tw_len * sizeof(*conv->twiddles))))
+      return false;
+
+   for (p = 0; p < conv->passes; p++)
+   {
+      unsigned q = conv->pass_q[p];
+      float *tw  = conv->twiddles + conv->pass_tw[p];
+
+      for (k = 1; k <= 3; k++)
+      {
+         for (j = 0; j < q; j++)
+         {
+            double phase = -2.0 * M_PI * (double)(j * k) / (4.0 * q);
+            tw[(2 * k - 2) * q + j] = (float)cos(phase);
+            tw[(2 * k - 1) * q + j] = (float)sin(phase);
+         }
+      }
+   }
+
+   return true;
+}
+
+fft_convolver_t *fft_convolver_new(const float *ir, unsigned ir_len,
+      unsigned partition_log2, dspfilter_simd_mask_t mask)
+{
+   unsigned p, i;
+   size_t spectra;
+   fft_convolver_t *conv = NULL;
+
+   if (!ir || !ir_len || partition_log2 < 2 || partition_log2 > 15)
+      return NULL;
+   if (!(conv = (fft_convolver_t*)calloc(1, sizeof(*conv))))
+      return NULL;
+
+   conv->kernel    = fft_conv_pick_kernel(mask);
+   conv->partition = 1 << partition_log2;
+   conv->size      = 2 * conv->partition;
+   conv->parts     = (ir_len + conv->partition - 1) / conv->partition;
+
+   if (!fft_conv_build_passes(conv, partition_log2 + 1))
+      goto error;
+
+   spectra         = (size_t)conv->parts * conv->size;
+   conv->time_re   = (float*)calloc(conv->size, sizeof(float));
+   conv->time_im   = (float*)calloc(conv->size, sizeof(float));
+   conv->acc_re    = (float*)calloc(conv->size, sizeof(float));
+   conv->acc_im    = (float*)calloc(conv->size, sizeof(float));
+   conv->fdl_re    = (float*)calloc(spectra, sizeof(float));
+   conv->fdl_im    = (float*)calloc(spectra, sizeof(float));
+   conv->filter_re = (float*)calloc(spectra, sizeof(float));
+   conv->filter_im = (float*)calloc(spectra, sizeof(float));
+
+   if (     !conv->time_re   || !conv->time_im
+         || !conv->acc_re    || !conv->acc_im
+         || !conv->fdl_re    || !conv->fdl_im
+         || !conv->filter_re || !conv->filter_im)
+      goto error;
+
+   /* Each partition is zero-padded to the FFT size, so the last
+    * half of every circular convolution is the linear one. */
+   for (p = 0; p < conv->parts; p++)
+   {
+      float *re    = conv->filter_re + (size_t)p * conv->size;
+      float *im    = conv->filter_im + (size_t)p * conv->size;
+      unsigned len = MIN(conv->partition, ir_len - p * conv->partition);
+
+      for (i = 0; i < len; i++)
+         re[i] = ir[p * conv->partition + i] / conv->size;
+      fft_conv_forward(conv, re, im);
+   }
+
+   return conv;
+
+error:
+   fft_convolver_free(conv);
+   return NULL;
+}
+
+void fft_convolver_free(fft_convolver_t *conv)
+{
+   if (!conv)
+      return;
+
+   free(conv->twiddles);
+   free(conv->pass_q);
+   free(conv->pass_tw);
+   free(conv->time_re);
+   free(conv->time_im);
+   free(conv->fdl_re);
+   free(conv->fdl_im);
+   free(conv->filter_re);
+   free(conv->filter_im);
+   free(conv->acc_re);
+   free(conv->acc_im);
+   free(conv);
+}
+
+static void fft_conv_block(fft_convolver_t *conv, float *out)
+{
+   unsigned p, i;
+   unsigned size      = conv->size;
+   unsigned partition = conv->partition;
+   float *x_re        = conv->fdl_re + (size_t)conv->fdl_pos * size;
+   float *x_im        = conv->fdl_im + (size_t)conv->fdl_pos * size;
+
+   memcpy(x_re, conv->time_re, size * sizeof(float));
+   memcpy(x_im, conv->time_im, size * sizeof(float));
+   fft_conv_forward(conv, x_re, x_im);
+
+   /* This block is the older half of the next one. */
+   memcpy(conv->time_re, conv->time_re + partition, partition * sizeof(float));
+   memcpy(conv->time_im, conv->time_im + partition, partition * sizeof(float));
+
+   /* Partition p of the filter meets the input from p blocks ago. */
+   memset(conv->acc_re, 0, size * sizeof(float));
+   memset(conv->acc_im, 0, size * sizeof(float));
+   for (p = 0; p < conv->parts; p++)
+   {
+      size_t slot = (size_t)((conv->fdl_pos + conv->parts - p)
+            % conv->parts) * size;
+      conv->kernel->mac(conv->acc_re, conv->acc_im,
+            conv->fdl_re + slot, conv->fdl_im + slot,
+            conv->filter_re + (size_t)p * size,
+            conv->filter_im + (size_t)p * size, size);
+   }
+
+   fft_conv_inverse(conv, conv->acc_re, conv->acc_im);
+
+   for (i = 0; i < partition; i++)
+   {
+      out[2 * i + 0] = conv->acc_re[partition + i];
+      out[2 * i + 1] = conv->acc_im[partition + i];
+   }
+
+   if (++conv->fdl_pos == conv->parts)
+      conv->fdl_pos = 0;
+}
+
+unsigned fft_convolver_process(fft_convolver_t *conv,
+      float *out, const float *in, unsigned frames)
+{
+   unsigned written = 0;
+
+   while (frames)
+   {
+      unsigned i;
+      unsigned avail = conv->partition - conv->fill;
+      float *re      = conv->time_re + conv->partition + conv->fill;
+      float *im      = conv->time_im + conv->partition + conv->fill;
+
+      if (frames < avail)
+         avail = frames;
+
+      for (i = 0; i < avail; i++)
+      {
+         re[i] = in[2 * i + 0];
+         im[i] = in[2 * i + 1];
+      }
+
+      in         += avail * 2;
+      frames     -= avail;
+      conv->fill += avail;
+
+      if (conv->fill == conv->partition)
+      {
+         fft_conv_block(conv, out);
+         out       += conv->partition * 2;
+         written   += conv->partition;
+         conv->fill = 0;
+      }
+   }
+
+   return written;
+}
+
+unsigned fft_convolver_partition_frames(const fft_convolver_t *conv)
+{
+   return conv->partition;
+}
+
+const char *fft_convolver_kernel_name(const fft_convolver_t *conv)
+{
+   return conv->kernel->name;
+}
@@ -0,0 +1,55 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (convolver.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef RARCH_FFT_CONVOLVER_H__
+#define RARCH_FFT_CONVOLVER_H__
+
+#include <libretro_dspfilter.h>
+
+/* Uniformly partitioned overlap-save convolution of interleaved
+ * stereo with one real impulse response.
+ *
+ * The impulse response is cut into partitions of 2^partition_log2
+ * taps, so a frame comes out one partition after it goes in however
+ * long the response is.  Both channels go through a single complex
+ * FFT, left in the real part and right in the imaginary part. */
+typedef struct fft_convolver fft_convolver_t;
+
+/* Picks the widest FFT kernel in 'mask' this build has.
+ * partition_log2 must be in [2, 15]. */
+fft_convolver_t *fft_convolver_new(const float *ir, unsigned ir_len,
+      unsigned partition_log2, dspfilter_simd_mask_t mask);
+
+void fft_convolver_free(fft_convolver_t *conv);
+
+/* Takes 'frames' interleaved stereo frames from 'in' and writes
+ * every partition they complete to 'out', which must have room
+ * for frames + partition - 1 frames.  Returns the frames written. */
+unsigned fft_convolver_process(fft_convolver_t *conv,
+      float *out, const float *in, unsigned frames);
+
+unsigned fft_convolver_partition_frames(const fft_convolver_t *conv);
+
+/* "AVX", "SSE" or "C". */
+const char *fft_convolver_kernel_name(const fft_convolver_t *conv);
+
+#endif
@@ -47,6 +47,28 @@
 #include <immintrin.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+/* The AVX2/FMA and AVX-512 kernels are built regardless of the
+ * baseline -m flags and only picked after a runtime check, so a
+ * generic x86 build still gets them.  The AVX2 kernel needs FMA3
+ * as well, which is a separate CPUID bit. */
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#include <cpuid.h>
+#define SINC_RESAMPLER_AVX2
+#define SINC_RESAMPLER_AVX512
+#define SINC_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define SINC_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#include <intrin.h>
+#define SINC_RESAMPLER_AVX2
+#define SINC_RESAMPLER_AVX512
+#define SINC_TARGET_AVX2
+#define SINC_TARGET_AVX512
+#endif
+#endif
+
 /* Rough SNR values for upsampling:
  * LOWEST: 40 dB
  * LOWER: 55 dB
@@ -64,6 +86,16 @@ enum sinc_window
    SINC_WINDOW_LANCZOS
 };
 
+enum sinc_kernel
+{
+   SINC_KERNEL_C      = 0,
+   SINC_KERNEL_SSE,
+   SINC_KERNEL_AVX,
+   SINC_KERNEL_AVX2,
+   SINC_KERNEL_AVX512,
+   SINC_KERNEL_NEON
+};
+
 /* For the little amount of taps we're using,
  * SSE1 is faster than AVX for some reason.
  * AVX code is kept here though as by increasing number
@@ -376,6 +408,291 @@ static void resampler_sinc_process_avx(void *re_, struct resampler_data *data)
 }
 #endif
 
+#ifdef SINC_RESAMPLER_AVX2
+/* FMA3 is CPUID leaf 1, ECX bit 12.  The SIMD mask has no bit for
+ * it; the OS support it needs is the same as AVX's, which the mask
+ * already checks. */
+static int sinc_cpu_has_fma(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+   int regs[4];
+   __cpuid(regs, 1);
+   return (regs[2] >> 12) & 1;
+#else
+   unsigned eax, ebx, ecx, edx;
+   if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      return 0;
+   return (ecx >> 12) & 1;
+#endif
+}
+
+/* Adds up the lanes of both accumulators and stores them
+ * as one stereo frame. */
+SINC_TARGET_AVX2
+static INLINE void sinc_store_frame_avx2(float *output,
+      __m256 sum_l, __m256 sum_r)
+{
+   /* hadd works on each 128-bit lane: after two of them
+    * both lanes hold their own { l, r, l, r } partial sums. */
+   __m256 sum = _mm256_hadd_ps(sum_l, sum_r);
+   __m128 res;
+   sum        = _mm256_hadd_ps(sum, sum);
+   res        = _mm_add_ps(_mm256_castps256_ps128(sum),
+         _mm256_extractf128_ps(sum, 1));
+   _mm_storel_pi((__m64*)output, res);
+}
+
+/* Taps are a multiple of 16 here; two accumulators per
+ * channel keep enough FMAs in flight to cover their latency. */
+SINC_TARGET_AVX2
+static void resampler_sinc_process_avx2_kaiser(void *re_, struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
+   uint32_t ratio                 = phases / data->ratio;
+   const float *input             = data->data_in;
+   float *output                  = data->data_out;
+   size_t frames                  = data->input_frames;
+   size_t out_frames              = 0;
+   unsigned taps                  = resamp->taps;
+   unsigned taps2                 = taps * 2;
+
+   while (frames)
+   {
+      SINC_PUSH_INPUT_SAMPLES(resamp, input, taps, phases, frames);
+
+      {
+         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
+         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
+         while (resamp->time < phases)
+         {
+            /* C89: all declarations at top of block */
+            int i;
+            unsigned phase     = resamp->time >> resamp->subphase_bits;
+            float *phase_table = resamp->phase_table + phase * taps2;
+            float *delta_table = phase_table + taps;
+            __m256 delta       = _mm256_set1_ps((float)
+                  (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
+            __m256 sum_l0      = _mm256_setzero_ps();
+            __m256 sum_r0      = _mm256_setzero_ps();
+            __m256 sum_l1      = _mm256_setzero_ps();
+            __m256 sum_r1      = _mm256_setzero_ps();
+
+            for (i = 0; i < (int)taps; i += 16)
+            {
+               __m256 sinc0 = _mm256_fmadd_ps(_mm256_load_ps(delta_table + i),
+                     delta, _mm256_load_ps(phase_table + i));
+               __m256 sinc1 = _mm256_fmadd_ps(_mm256_load_ps(delta_table + i + 8),
+                     delta, _mm256_load_ps(phase_table + i + 8));
+
+               sum_l0       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_l + i),     sinc0, sum_l0);
+               sum_r0       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_r + i),     sinc0, sum_r0);
+               sum_l1       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_l + i + 8), sinc1, sum_l1);
+               sum_r1       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_r + i + 8), sinc1, sum_r1);
+            }
+
+            sinc_store_frame_avx2(output,
+                  _mm256_add_ps(sum_l0, sum_l1), _mm256_add_ps(sum_r0, sum_r1));
+
+            output += 2;
+            out_frames++;
+            resamp->time += ratio;
+         }
+      }
+   }
+
+   data->output_frames = out_frames;
+}
+
+SINC_TARGET_AVX2
+static void resampler_sinc_process_avx2(void *re_, struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases    = 1 << (resamp->phase_bits + resamp->subphase_bits);
+   uint32_t ratio     = phases / data->ratio;
+   const float *input = data->data_in;
+   float *output      = data->data_out;
+   size_t frames      = data->input_frames;
+   size_t out_frames  = 0;
+   unsigned taps      = resamp->taps;
+
+   while (frames)
+   {
+      SINC_PUSH_INPUT_SAMPLES(resamp, input, taps, phases, frames);
+
+      {
+         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
+         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
+         while (resamp->time < phases)
+         {
+            /* C89: all declarations at top of block */
+            int i;
+            unsigned phase     = resamp->time >> resamp->subphase_bits;
+            float *phase_table = resamp->phase_table + phase * taps;
+            __m256 sum_l0      = _mm256_setzero_ps();
+            __m256 sum_r0      = _mm256_setzero_ps();
+            __m256 sum_l1      = _mm256_setzero_ps();
+            __m256 sum_r1      = _mm256_setzero_ps();
+
+            for (i = 0; i < (int)taps; i += 16)
+            {
+               __m256 sinc0 = _mm256_load_ps(phase_table + i);
+               __m256 sinc1 = _mm256_load_ps(phase_table + i + 8);
+
+               sum_l0       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_l + i),     sinc0, sum_l0);
+               sum_r0       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_r + i),     sinc0, sum_r0);
+               sum_l1       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_l + i + 8), sinc1, sum_l1);
+               sum_r1       = _mm256_fmadd_ps(_mm256_loadu_ps(buffer_r + i + 8), sinc1, sum_r1);
+            }
+
+            sinc_store_frame_avx2(output,
+                  _mm256_add_ps(sum_l0, sum_l1), _mm256_add_ps(sum_r0, sum_r1));
+
+            output += 2;
+            out_frames++;
+            resamp->time += ratio;
+         }
+      }
+   }
+
+   data->output_frames = out_frames;
+}
+#endif
+
+#ifdef SINC_RESAMPLER_AVX512
+SINC_TARGET_AVX512
+static INLINE void sinc_store_frame_avx512(float *output,
+      __m512 sum_l, __m512 sum_r)
+{
+   /* Fold to 256 bits with AVX-512F only (no DQ extract) */
+   __m256 l   = _mm256_add_ps(_mm512_castps512_ps256(sum_l),
+         _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum_l), 1)));
+   __m256 r   = _mm256_add_ps(_mm512_castps512_ps256(sum_r),
+         _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(sum_r), 1)));
+   __m256 sum = _mm256_hadd_ps(l, r);
+   __m128 res;
+   sum        = _mm256_hadd_ps(sum, sum);
+   res        = _mm_add_ps(_mm256_castps256_ps128(sum),
+         _mm256_extractf128_ps(sum, 1));
+   _mm_storel_pi((__m64*)output, res);
+}
+
+/* Taps are a multiple of 32 here. */
+SINC_TARGET_AVX512
+static void resampler_sinc_process_avx512_kaiser(void *re_, struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases                = 1 << (resamp->phase_bits + resamp->subphase_bits);
+   uint32_t ratio                 = phases / data->ratio;
+   const float *input             = data->data_in;
+   float *output                  = data->data_out;
+   size_t frames                  = data->input_frames;
+   size_t out_frames              = 0;
+   unsigned taps                  = resamp->taps;
+   unsigned taps2                 = taps * 2;
+
+   while (frames)
+   {
+      SINC_PUSH_INPUT_SAMPLES(resamp, input, taps, phases, frames);
+
+      {
+         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
+         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
+         while (resamp->time < phases)
+         {
+            /* C89: all declarations at top of block */
+            int i;
+            unsigned phase     = resamp->time >> resamp->subphase_bits;
+            float *phase_table = resamp->phase_table + phase * taps2;
+            float *delta_table = phase_table + taps;
+            __m512 delta       = _mm512_set1_ps((float)
+                  (resamp->time & resamp->subphase_mask) * resamp->subphase_mod);
+            __m512 sum_l0      = _mm512_setzero_ps();
+            __m512 sum_r0      = _mm512_setzero_ps();
+            __m512 sum_l1      = _mm512_setzero_ps();
+            __m512 sum_r1      = _mm512_setzero_ps();
+
+            for (i = 0; i < (int)taps; i += 32)
+            {
+               __m512 sinc0 = _mm512_fmadd_ps(_mm512_load_ps(delta_table + i),
+                     delta, _mm512_load_ps(phase_table + i));
+               __m512 sinc1 = _mm512_fmadd_ps(_mm512_load_ps(delta_table + i + 16),
+                     delta, _mm512_load_ps(phase_table + i + 16));
+
+               sum_l0       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_l + i),      sinc0, sum_l0);
+               sum_r0       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_r + i),      sinc0, sum_r0);
+               sum_l1       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_l + i + 16), sinc1, sum_l1);
+               sum_r1       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_r + i + 16), sinc1, sum_r1);
+            }
+
+            sinc_store_frame_avx512(output,
+                  _mm512_add_ps(sum_l0, sum_l1), _mm512_add_ps(sum_r0, sum_r1));
+
+            output += 2;
+            out_frames++;
+            resamp->time += ratio;
+         }
+      }
+   }
+
+   data->output_frames = out_frames;
+}
+
+SINC_TARGET_AVX512
+static void resampler_sinc_process_avx512(void *re_, struct resampler_data *data)
+{
+   rarch_sinc_resampler_t *resamp = (rarch_sinc_resampler_t*)re_;
+   unsigned phases    = 1 << (resamp->phase_bits + resamp->subphase_bits);
+   uint32_t ratio     = phases / data->ratio;
+   const float *input = data->data_in;
+   float *output      = data->data_out;
+   size_t frames      = data->input_frames;
+   size_t out_frames  = 0;
+   unsigned taps      = resamp->taps;
+
+   while (frames)
+   {
+      SINC_PUSH_INPUT_SAMPLES(resamp, input, taps, phases, frames);
+
+      {
+         const float *buffer_l    = resamp->buffer_l + resamp->ptr;
+         const float *buffer_r    = resamp->buffer_r + resamp->ptr;
+         while (resamp->time < phases)
+         {
+            /* C89: all declarations at top of block */
+            int i;
+            unsigned phase     = resamp->time >> resamp->subphase_bits;
+            float *phase_table = resamp->phase_table + phase * taps;
+            __m512 sum_l0      = _mm512_setzero_ps();
+            __m512 sum_r0      = _mm512_setzero_ps();
+            __m512 sum_l1      = _mm512_setzero_ps();
+            __m512 sum_r1      = _mm512_setzero_ps();
+
+            for (i = 0; i < (int)taps; i += 32)
+            {
+               __m512 sinc0 = _mm512_load_ps(phase_table + i);
+               __m512 sinc1 = _mm512_load_ps(phase_table + i + 16);
+
+               sum_l0       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_l + i),      sinc0, sum_l0);
+               sum_r0       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_r + i),      sinc0, sum_r0);
+               sum_l1       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_l + i + 16), sinc1, sum_l1);
+               sum_r1       = _mm512_fmadd_ps(_mm512_loadu_ps(buffer_r + i + 16), sinc1, sum_r1);
+            }
+
+            sinc_store_frame_avx512(output,
+                  _mm512_add_ps(sum_l0, sum_l1), _mm512_add_ps(sum_r0, sum_r1));
+
+            output += 2;
+            out_frames++;
+            resamp->time += ratio;
+         }
+      }
+   }
+
+   data->output_frames = out_frames;
+}
+#endif
+
 #if defined(__SSE__)
 static void resampler_sinc_process_sse_kaiser(void *re_, struct resampler_data *data)
 {
@@ -809,6 +1126,7 @@ static void *resampler_sinc_new(const struct resampler_config *config,
    size_t phase_elems             = 0;
    size_t elems                   = 0;
    unsigned enable_avx            = 0;
+   enum sinc_kernel kernel        = SINC_KERNEL_C;
    unsigned sidelobes             = 0;
    enum sinc_window window_type   = SINC_WINDOW_NONE;
    rarch_sinc_resampler_t *re     = (rarch_sinc_resampler_t*)
@@ -874,18 +1192,66 @@ static void *resampler_sinc_new(const struct resampler_config *config,
       re->taps = (unsigned)ceil(re->taps / bandwidth_mod);
    }
 
-   /* Be SIMD-friendly. */
+   /* Pick the kernel first, the taps are padded to what it
+    * consumes per iteration. */
+   if (enable_avx && (mask & RESAMPLER_SIMD_AVX512))
+   {
+#ifdef SINC_RESAMPLER_AVX512
+      kernel = SINC_KERNEL_AVX512;
+#endif
+   }
+   if (kernel == SINC_KERNEL_C && enable_avx
+         && (mask & RESAMPLER_SIMD_AVX) && (mask & RESAMPLER_SIMD_AVX2))
+   {
+#ifdef SINC_RESAMPLER_AVX2
+      if (sinc_cpu_has_fma())
+         kernel = SINC_KERNEL_AVX2;
+#endif
+   }
+   /* Kernels left out of this build fall through to the next */
+   if (kernel == SINC_KERNEL_C)
+   {
 #if defined(__AVX__)
-   if (enable_avx)
-      re->taps = (re->taps + 7) & ~7;
-   else
+      if (mask & RESAMPLER_SIMD_AVX && enable_avx)
+         kernel = SINC_KERNEL_AVX;
+      else
+#endif
+#if defined(__SSE__)
+      if (mask & RESAMPLER_SIMD_SSE)
+         kernel = SINC_KERNEL_SSE;
+      else
+#endif
+#if (defined(__ARM_NEON__) || defined(HAVE_NEON))
+      if (mask & RESAMPLER_SIMD_NEON)
+         kernel = SINC_KERNEL_NEON;
+      else
 #endif
+         kernel = SINC_KERNEL_C;
+   }
+
+   /* Be SIMD-friendly. */
+   switch (kernel)
    {
+      case SINC_KERNEL_AVX512:
+         re->taps = (re->taps + 31) & ~31;
+         break;
+      case SINC_KERNEL_AVX2:
+         re->taps = (re->taps + 15) & ~15;
+         break;
+      default:
+#if defined(__AVX__)
+         if (enable_avx)
+            re->taps = (re->taps + 7) & ~7;
+         else
+#endif
+         {
 #if (defined(__ARM_NEON__) || defined(HAVE_NEON))
-      re->taps = (re->taps + 7) & ~7;
+            re->taps = (re->taps + 7) & ~7;
 #else
-      re->taps = (re->taps + 3) & ~3;
+            re->taps = (re->taps + 3) & ~3;
 #endif
+         }
+         break;
    }
 
    phase_elems = ((1 << re->phase_bits) * re->taps);
@@ -921,34 +1287,50 @@ static void *resampler_sinc_new(const struct resampler_config *config,
    if (window_type == SINC_WINDOW_KAISER)
       sinc_resampler.process    = resampler_sinc_process_c_kaiser;
 
-   if (mask & RESAMPLER_SIMD_AVX && enable_avx)
+   switch (kernel)
    {
+      case SINC_KERNEL_AVX512:
+#ifdef SINC_RESAMPLER_AVX512
+         sinc_resampler.process    = resampler_sinc_process_avx512;
+         if (window_type == SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_avx512_kaiser;
+#endif
+         break;
+      case SINC_KERNEL_AVX2:
+#ifdef SINC_RESAMPLER_AVX2
+         sinc_resampler.process    = resampler_sinc_process_avx2;
+         if (window_type == SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_avx2_kaiser;
+#endif
+         break;
+      case SINC_KERNEL_AVX:
 #if defined(__AVX__)
-      sinc_resampler.process    = resampler_sinc_process_avx;
-      if (window_type == SINC_WINDOW_KAISER)
-         sinc_resampler.process = resampler_sinc_process_avx_kaiser;
+         sinc_resampler.process    = resampler_sinc_process_avx;
+         if (window_type == SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_avx_kaiser;
 #endif
-   }
-   else if (mask & RESAMPLER_SIMD_SSE)
-   {
+         break;
+      case SINC_KERNEL_SSE:
 #if defined(__SSE__)
-      sinc_resampler.process = resampler_sinc_process_sse;
-      if (window_type == SINC_WINDOW_KAISER)
-         sinc_resampler.process = resampler_sinc_process_sse_kaiser;
+         sinc_resampler.process = resampler_sinc_process_sse;
+         if (window_type == SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_sse_kaiser;
 #endif
-   }
-   else if (mask & RESAMPLER_SIMD_NEON)
-   {
+         break;
+      case SINC_KERNEL_NEON:
 #if (defined(__ARM_NEON__) || defined(HAVE_NEON))
 #ifdef HAVE_ARM_NEON_ASM_OPTIMIZATIONS
-      if (window_type != SINC_WINDOW_KAISER)
-         sinc_resampler.process = resampler_sinc_process_neon;
+         if (window_type != SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_neon;
 #else
-      sinc_resampler.process = resampler_sinc_process_neon;
-      if (window_type == SINC_WINDOW_KAISER)
-         sinc_resampler.process = resampler_sinc_process_neon_kaiser;
+         sinc_resampler.process = resampler_sinc_process_neon;
+         if (window_type == SINC_WINDOW_KAISER)
+            sinc_resampler.process = resampler_sinc_process_neon_kaiser;
 #endif
 #endif
+         break;
+      case SINC_KERNEL_C:
+         break;
    }
 
    return re;
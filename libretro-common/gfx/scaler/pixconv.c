@@ -33,513 +33,481 @@
 #define SCALER_NO_SIMD
 #endif
 
-#ifdef SCALER_NO_SIMD
-#undef __SSE2__
+/* The x86 kernels are built regardless of the baseline -m flags
+ * and only ever called after a runtime check, so a generic x86
+ * build still gets them.  All of them give the same bits as the
+ * C code. */
+#ifndef SCALER_NO_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define PIXCONV_SSE2
+#define PIXCONV_AVX2
+#define PIXCONV_TARGET_sse2 __attribute__((target("sse2")))
+#define PIXCONV_TARGET_avx2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#define PIXCONV_SSE2
+#define PIXCONV_AVX2
+#define PIXCONV_TARGET_sse2
+#define PIXCONV_TARGET_avx2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXCONV_SSE2
+#define PIXCONV_TARGET_sse2
+#endif
 #endif
 
-#if defined(__SSE2__)
-#include <emmintrin.h>
-#elif defined(__MMX__)
-#include <mmintrin.h>
-#elif (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
 #include <arm_neon.h>
+#define PIXCONV_NEON
+#endif
 #endif
 
-void conv_rgb565_0rgb1555(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
-{
-   int h;
-   const uint16_t *input   = (const uint16_t*)input_;
-   uint16_t *output        = (uint16_t*)output_;
+#include <features/features_cpu.h>
 
-#if defined(__SSE2__)
-   int max_width           = width - 7;
-   const __m128i hi_mask   = _mm_set1_epi16(0x7fe0);
-   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
-#endif
+#define YUV_SHIFT 6
+#define YUV_OFFSET (1 << (YUV_SHIFT - 1))
+#define YUV_MAT_Y (1 << 6)
+#define YUV_MAT_U_G (-22)
+#define YUV_MAT_U_B (113)
+#define YUV_MAT_V_R (90)
+#define YUV_MAT_V_G (-46)
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 1, input += in_stride >> 1)
+/* A vector kernel converts the start of a row and returns how many
+ * pixels it did; the C kernel for the same conversion then does the
+ * rest, from pixel 'w' up to 'width'. */
+typedef int (*pixconv_simd_t)(void *output, const void *input, int width);
+typedef void (*pixconv_c_t)(void *output, const void *input,
+      int w, int width);
+
+static void conv_rgb565_0rgb1555_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (; w < width; w++)
    {
-      int w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 8)
-      {
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i hi = _mm_and_si128(_mm_slli_epi16(in, 1), hi_mask);
-         __m128i lo = _mm_and_si128(in, lo_mask);
-         _mm_storeu_si128((__m128i*)(output + w), _mm_or_si128(hi, lo));
-      }
-#endif
+      uint16_t col = input[w];
+      uint16_t hi  = (col >> 1) & 0x7fe0;
+      uint16_t lo  = col & 0x1f;
+      output[w]    = hi | lo;
+   }
+}
 
-      for (; w < width; w++)
-      {
-         uint16_t col = input[w];
-         uint16_t hi  = (col >> 1) & 0x7fe0;
-         uint16_t lo  = col & 0x1f;
-         output[w]    = hi | lo;
-      }
+static void conv_0rgb1555_rgb565_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (; w < width; w++)
+   {
+      uint16_t col  = input[w];
+      uint16_t rg   = (col << 1) & ((0x1f << 11) | (0x1f << 6));
+      uint16_t b    = col & 0x1f;
+      uint16_t glow = (col >> 4) & (1 << 5);
+      output[w]     = rg | b | glow;
    }
 }
 
-void conv_0rgb1555_rgb565(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_0rgb1555_argb8888_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h;
-   const uint16_t *input   = (const uint16_t*)input_;
-   uint16_t *output        = (uint16_t*)output_;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
 
-#if defined(__SSE2__)
-   int max_width           = width - 7;
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 10) & 0x1f;
+      uint32_t g   = (col >>  5) & 0x1f;
+      uint32_t b   = (col >>  0) & 0x1f;
+      r            = (r << 3) | (r >> 2);
+      g            = (g << 3) | (g >> 2);
+      b            = (b << 3) | (b >> 2);
+
+      output[w]    = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+   }
+}
 
-   const __m128i hi_mask   = _mm_set1_epi16(
-         (int16_t)((0x1f << 11) | (0x1f << 6)));
-   const __m128i lo_mask   = _mm_set1_epi16(0x1f);
-   const __m128i glow_mask = _mm_set1_epi16(1 << 5);
-#endif
+static void conv_rgb565_argb8888_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 1, input += in_stride >> 1)
+   for (; w < width; w++)
    {
-      int w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 8)
-      {
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i rg   = _mm_and_si128(_mm_slli_epi16(in, 1), hi_mask);
-         __m128i b    = _mm_and_si128(in, lo_mask);
-         __m128i glow = _mm_and_si128(_mm_srli_epi16(in, 4), glow_mask);
-         _mm_storeu_si128((__m128i*)(output + w),
-               _mm_or_si128(rg, _mm_or_si128(b, glow)));
-      }
-#endif
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 11) & 0x1f;
+      uint32_t g   = (col >>  5) & 0x3f;
+      uint32_t b   = (col >>  0) & 0x1f;
+      r            = (r << 3) | (r >> 2);
+      g            = (g << 2) | (g >> 4);
+      b            = (b << 3) | (b >> 2);
+
+      output[w]    = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+   }
+}
+
+static void conv_rgb565_abgr8888_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
 
-      for (; w < width; w++)
-      {
-         uint16_t col  = input[w];
-         uint16_t rg   = (col << 1) & ((0x1f << 11) | (0x1f << 6));
-         uint16_t b    = col & 0x1f;
-         uint16_t glow = (col >> 4) & (1 << 5);
-         output[w]     = rg | b | glow;
-      }
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 11) & 0x1f;
+      uint32_t g   = (col >>  5) & 0x3f;
+      uint32_t b   = (col >>  0) & 0x1f;
+      r            = (r << 3) | (r >> 2);
+      g            = (g << 2) | (g >> 4);
+      b            = (b << 3) | (b >> 2);
+
+      output[w]    = (0xffu << 24) | (b << 16) | (g << 8) | (r << 0);
    }
 }
 
-void conv_0rgb1555_argb8888(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_rgba4444_argb8888_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h;
    const uint16_t *input = (const uint16_t*)input_;
    uint32_t *output      = (uint32_t*)output_;
 
-#ifdef __SSE2__
-   const __m128i pix_mask_r  = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_gb = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul15_mid   = _mm_set1_epi16(0x4200);
-   const __m128i mul15_hi    = _mm_set1_epi16(0x0210);
-   const __m128i a           = _mm_set1_epi16(0x00ff);
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 12) & 0xf;
+      uint32_t g   = (col >>  8) & 0xf;
+      uint32_t b   = (col >>  4) & 0xf;
+      uint32_t a   = (col >>  0) & 0xf;
+      r            = (r << 4) | r;
+      g            = (g << 4) | g;
+      b            = (b << 4) | b;
+      a            = (a << 4) | a;
+
+      output[w]    = (a << 24) | (r << 16) | (g << 8) | (b << 0);
+   }
+}
 
-   int max_width = width - 7;
-#endif
+static void conv_rgba4444_rgb565_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 1)
+   for (; w < width; w++)
    {
-      int w = 0;
-#ifdef __SSE2__
-      for (; w < max_width; w += 8)
-      {
-         __m128i res_lo_bg, res_hi_bg;
-         __m128i res_lo_ra, res_hi_ra;
-         __m128i res_lo, res_hi;
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i r = _mm_and_si128(in, pix_mask_r);
-         __m128i g = _mm_and_si128(in, pix_mask_gb);
-         __m128i b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_gb);
-
-         r = _mm_mulhi_epi16(r, mul15_hi);
-         g = _mm_mulhi_epi16(g, mul15_mid);
-         b = _mm_mulhi_epi16(b, mul15_mid);
-
-         res_lo_bg = _mm_unpacklo_epi8(b, g);
-         res_hi_bg = _mm_unpackhi_epi8(b, g);
-         res_lo_ra = _mm_unpacklo_epi8(r, a);
-         res_hi_ra = _mm_unpackhi_epi8(r, a);
-
-         res_lo = _mm_or_si128(res_lo_bg,
-               _mm_slli_si128(res_lo_ra, 2));
-         res_hi = _mm_or_si128(res_hi_bg,
-               _mm_slli_si128(res_hi_ra, 2));
-
-         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
-         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
-      }
-#endif
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 12) & 0xf;
+      uint32_t g   = (col >>  8) & 0xf;
+      uint32_t b   = (col >>  4) & 0xf;
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 10) & 0x1f;
-         uint32_t g   = (col >>  5) & 0x1f;
-         uint32_t b   = (col >>  0) & 0x1f;
-         r            = (r << 3) | (r >> 2);
-         g            = (g << 3) | (g >> 2);
-         b            = (b << 3) | (b >> 2);
-
-         output[w]    = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+      output[w]    = (r << 12) | (g << 7) | (b << 1);
    }
 }
 
-void conv_rgb565_argb8888(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_bgr24_argb8888_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h;
-   const uint16_t *input    = (const uint16_t*)input_;
-   uint32_t *output         = (uint32_t*)output_;
-
-#if defined(__SSE2__)
-   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
-   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
-   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
-   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
-   const __m128i a          = _mm_set1_epi16(0x00ff);
-
-   int max_width            = width - 7;
-#elif defined(__MMX__)
-   const __m64 pix_mask_r = _mm_set1_pi16(0x1f << 10);
-   const __m64 pix_mask_g = _mm_set1_pi16(0x3f << 5);
-   const __m64 pix_mask_b = _mm_set1_pi16(0x1f << 5);
-   const __m64 mul16_r    = _mm_set1_pi16(0x0210);
-   const __m64 mul16_g    = _mm_set1_pi16(0x2080);
-   const __m64 mul16_b    = _mm_set1_pi16(0x4200);
-   const __m64 a          = _mm_set1_pi16(0x00ff);
-
-   int max_width            = width - 3;
-#elif (defined(__ARM_NEON__) || defined(__ARM_NEON))
-   int max_width            = width - 7;
-#endif
+   const uint8_t *inp = (const uint8_t*)input_ + 3 * w;
+   uint32_t *output   = (uint32_t*)output_;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 1)
+   for (; w < width; w++)
    {
-      int w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 8)
-      {
-         __m128i res_lo, res_hi;
-         __m128i res_lo_bg, res_hi_bg, res_lo_ra, res_hi_ra;
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i        r = _mm_and_si128(_mm_srli_epi16(in, 1), pix_mask_r);
-         __m128i        g = _mm_and_si128(in, pix_mask_g);
-         __m128i        b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_b);
-
-         r                = _mm_mulhi_epi16(r, mul16_r);
-         g                = _mm_mulhi_epi16(g, mul16_g);
-         b                = _mm_mulhi_epi16(b, mul16_b);
-
-         res_lo_bg        = _mm_unpacklo_epi8(b, g);
-         res_hi_bg        = _mm_unpackhi_epi8(b, g);
-         res_lo_ra        = _mm_unpacklo_epi8(r, a);
-         res_hi_ra        = _mm_unpackhi_epi8(r, a);
-
-         res_lo           = _mm_or_si128(res_lo_bg,
-               _mm_slli_si128(res_lo_ra, 2));
-         res_hi           = _mm_or_si128(res_hi_bg,
-               _mm_slli_si128(res_hi_ra, 2));
-
-         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
-         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
-      }
-#elif defined(__MMX__)
-      for (; w < max_width; w += 4)
-      {
-         __m64 res_lo, res_hi;
-         __m64 res_lo_bg, res_hi_bg, res_lo_ra, res_hi_ra;
-         const __m64 in = *((__m64*)(input + w));
-         __m64          r = _mm_and_si64(_mm_srli_pi16(in, 1), pix_mask_r);
-         __m64          g = _mm_and_si64(in, pix_mask_g);
-         __m64          b = _mm_and_si64(_mm_slli_pi16(in, 5), pix_mask_b);
-
-         r                = _mm_mulhi_pi16(r, mul16_r);
-         g                = _mm_mulhi_pi16(g, mul16_g);
-         b                = _mm_mulhi_pi16(b, mul16_b);
-
-         res_lo_bg        = _mm_unpacklo_pi8(b, g);
-         res_hi_bg        = _mm_unpackhi_pi8(b, g);
-         res_lo_ra        = _mm_unpacklo_pi8(r, a);
-         res_hi_ra        = _mm_unpackhi_pi8(r, a);
-
-         res_lo           = _mm_or_si64(res_lo_bg,
-               _mm_slli_si64(res_lo_ra, 16));
-         res_hi           = _mm_or_si64(res_hi_bg,
-               _mm_slli_si64(res_hi_ra, 16));
-
-         *((__m64*)(output + w + 0)) = res_lo;
-         *((__m64*)(output + w + 2)) = res_hi;
-      }
-
-      _mm_empty();
-#elif (defined(__ARM_NEON__) || defined(__ARM_NEON))
-      for (; w < max_width; w += 8)
-      {
-         uint16x8_t in = vld1q_u16(input + w);
-
-         uint16x8_t r = vsriq_n_u16(in, in, 5);
-         uint16x8_t b = vsliq_n_u16(in, in, 5);
-         uint16x8_t g = vsriq_n_u16(b,  b,  6);
-
-         uint8x8x4_t res;
-         res.val[3] = vdup_n_u8(0xffu);
-         res.val[2] = vshrn_n_u16(r, 8);
-         res.val[1] = vshrn_n_u16(g, 8);
-         res.val[0] = vshrn_n_u16(b, 2);
-
-         vst4_u8((uint8_t*)(output + w), res);
-      }
-#endif
+      uint32_t b = *inp++;
+      uint32_t g = *inp++;
+      uint32_t r = *inp++;
+      output[w]  = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
+   }
+}
+
+static void conv_bgr24_rgb565_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint8_t *inp = (const uint8_t*)input_ + 3 * w;
+   uint16_t *output   = (uint16_t*)output_;
+
+   for (; w < width; w++)
+   {
+      uint16_t b = *inp++;
+      uint16_t g = *inp++;
+      uint16_t r = *inp++;
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 11) & 0x1f;
-         uint32_t g   = (col >>  5) & 0x3f;
-         uint32_t b   = (col >>  0) & 0x1f;
-         r            = (r << 3) | (r >> 2);
-         g            = (g << 2) | (g >> 4);
-         b            = (b << 3) | (b >> 2);
-
-         output[w]    = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+      output[w]  = ((r & 0x00F8) << 8) | ((g & 0x00FC) << 3) | ((b & 0x00F8) >> 3);
    }
 }
 
-void conv_rgb565_abgr8888(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_argb8888_0rgb1555_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h;
-   const uint16_t *input    = (const uint16_t*)input_;
-   uint32_t *output         = (uint32_t*)output_;
- #if defined(__SSE2__)
-   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
-   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
-   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
-   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
-   const __m128i a          = _mm_set1_epi16(0x00ff);
-    int max_width            = width - 7;
-#elif (defined(__ARM_NEON__) || defined(__ARM_NEON))
-   int max_width            = width - 7;
-#endif
-    for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 1)
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (; w < width; w++)
    {
-      int w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 8)
-      {
-         __m128i res_lo, res_hi;
-         __m128i res_lo_rg, res_hi_rg, res_lo_ba, res_hi_ba;
-         const __m128i in = _mm_loadu_si128((const __m128i*)(input + w));
-         __m128i        r = _mm_and_si128(_mm_srli_epi16(in, 1), pix_mask_r);
-         __m128i        g = _mm_and_si128(in, pix_mask_g);
-         __m128i        b = _mm_and_si128(_mm_slli_epi16(in, 5), pix_mask_b);
-         r                = _mm_mulhi_epi16(r, mul16_r);
-         g                = _mm_mulhi_epi16(g, mul16_g);
-         b                = _mm_mulhi_epi16(b, mul16_b);
-         /* Output byte order [r g b a] per pixel == ABGR uint32 LE,
-          * matching the scalar fallback below.  Pair (r,g) into the
-          * low half and (b,a) into the high half (shifted up 2 bytes),
-          * not (b,g) and (r,a) which would produce ARGB byte order. */
-         res_lo_rg        = _mm_unpacklo_epi8(r, g);
-         res_hi_rg        = _mm_unpackhi_epi8(r, g);
-         res_lo_ba        = _mm_unpacklo_epi8(b, a);
-         res_hi_ba        = _mm_unpackhi_epi8(b, a);
-         res_lo           = _mm_or_si128(res_lo_rg,
-               _mm_slli_si128(res_lo_ba, 2));
-         res_hi           = _mm_or_si128(res_hi_rg,
-               _mm_slli_si128(res_hi_ba, 2));
-         _mm_storeu_si128((__m128i*)(output + w + 0), res_lo);
-         _mm_storeu_si128((__m128i*)(output + w + 4), res_hi);
-      }
-#elif (defined(__ARM_NEON__) || defined(__ARM_NEON))
-      for (; w < max_width; w += 8)
-      {
-         uint16x8_t in = vld1q_u16(input + w);
-
-         uint16x8_t r = vsriq_n_u16(in, in, 5);
-         uint16x8_t b = vsliq_n_u16(in, in, 5);
-         uint16x8_t g = vsriq_n_u16(b,  b,  6);
-
-         uint8x8x4_t res;
-         res.val[3] = vdup_n_u8(0xffu);
-         res.val[2] = vshrn_n_u16(b, 2);
-         res.val[1] = vshrn_n_u16(g, 8);
-         res.val[0] = vshrn_n_u16(r, 8);
-
-         vst4_u8((uint8_t*)(output + w), res);
-      }
-#endif
-       for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 11) & 0x1f;
-         uint32_t g   = (col >>  5) & 0x3f;
-         uint32_t b   = (col >>  0) & 0x1f;
-         r            = (r << 3) | (r >> 2);
-         g            = (g << 2) | (g >> 4);
-         b            = (b << 3) | (b >> 2);
-         output[w]    = (0xffu << 24) | (b << 16) | (g << 8) | (r << 0);
-      }
+      uint32_t col = input[w];
+      uint16_t r   = (col >> 19) & 0x1f;
+      uint16_t g   = (col >> 11) & 0x1f;
+      uint16_t b   = (col >>  3) & 0x1f;
+      output[w]    = (r << 10) | (g << 5) | (b << 0);
    }
 }
 
-void conv_argb8888_rgba4444(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_argb8888_rgba4444_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h, w;
    const uint32_t *input = (const uint32_t*)input_;
    uint16_t *output      = (uint16_t*)output_;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 1)
+   for (; w < width; w++)
    {
-      for (w = 0; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 16) & 0xf;
-         uint32_t g   = (col >>  8) & 0xf;
-         uint32_t b   = (col) & 0xf;
-         uint32_t a   = (col >>  24) & 0xf;
-         r            = (r >> 4) | r;
-         g            = (g >> 4) | g;
-         b            = (b >> 4) | b;
-         a            = (a >> 4) | a;
-
-         output[w]    = (r << 12) | (g << 8) | (b << 4) | a;
-      }
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 20) & 0xf;
+      uint32_t g   = (col >> 12) & 0xf;
+      uint32_t b   = (col >>  4) & 0xf;
+      uint32_t a   = (col >> 28) & 0xf;
+
+      output[w]    = (r << 12) | (g << 8) | (b << 4) | a;
    }
 }
 
-void conv_rgba4444_argb8888(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_argb8888_rgb565_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h;
-   const uint16_t *input = (const uint16_t*)input_;
-   uint32_t *output      = (uint32_t*)output_;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
 
-#if defined(__MMX__)
-   const __m64 pix_mask_r = _mm_set1_pi16(0xf << 10);
-   const __m64 pix_mask_g = _mm_set1_pi16(0xf << 8);
-   const __m64 pix_mask_b = _mm_set1_pi16(0xf << 8);
-   const __m64 pix_mask_a = _mm_set1_pi16(0x000f);
-   const __m64 mul16_r    = _mm_set1_pi16(0x0440);
-   const __m64 mul16_g    = _mm_set1_pi16(0x1100);
-   const __m64 mul16_b    = _mm_set1_pi16(0x1100);
-   const __m64 mul_a      = _mm_set1_pi16(0x0011);
-
-   int max_width            = width - 3;
-#endif
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      uint16_t r   = (col >> 19) & 0x1f;
+      uint16_t g   = (col >> 10) & 0x3f;
+      uint16_t b   = (col >>  3) & 0x1f;
+      output[w]    = (r << 11) | (g << 5) | (b << 0);
+   }
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 1)
+static void conv_argb8888_bgr24_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *out          = (uint8_t*)output_ + 3 * w;
+
+   for (; w < width; w++)
    {
-      int w = 0;
-#if defined(__MMX__)
-      for (; w < max_width; w += 4)
-      {
-         __m64 res_lo, res_hi;
-         __m64 res_lo_bg, res_hi_bg, res_lo_ra, res_hi_ra;
-         const __m64 in = *((__m64*)(input + w));
-         __m64          r = _mm_and_si64(_mm_srli_pi16(in, 2), pix_mask_r);
-         __m64          g = _mm_and_si64(in, pix_mask_g);
-         __m64          b = _mm_and_si64(_mm_slli_pi16(in, 4), pix_mask_b);
-         /* Source is rgba4444 -- alpha is the low nibble of each 16-bit
-          * input word.  Expand 4-bit -> 8-bit via a*0x11 (== a<<4 | a),
-          * matching the scalar fallback. */
-         __m64          a = _mm_and_si64(in, pix_mask_a);
-
-         r                = _mm_mulhi_pi16(r, mul16_r);
-         g                = _mm_mulhi_pi16(g, mul16_g);
-         b                = _mm_mulhi_pi16(b, mul16_b);
-         a                = _mm_mullo_pi16(a, mul_a);
-
-         res_lo_bg        = _mm_unpacklo_pi8(b, g);
-         res_hi_bg        = _mm_unpackhi_pi8(b, g);
-         res_lo_ra        = _mm_unpacklo_pi8(r, a);
-         res_hi_ra        = _mm_unpackhi_pi8(r, a);
-
-         res_lo           = _mm_or_si64(res_lo_bg,
-               _mm_slli_si64(res_lo_ra, 16));
-         res_hi           = _mm_or_si64(res_hi_bg,
-               _mm_slli_si64(res_hi_ra, 16));
-
-         *((__m64*)(output + w + 0)) = res_lo;
-         *((__m64*)(output + w + 2)) = res_hi;
-      }
-
-      _mm_empty();
-#endif
+      uint32_t col = input[w];
+      *out++       = (uint8_t)(col >>  0);
+      *out++       = (uint8_t)(col >>  8);
+      *out++       = (uint8_t)(col >> 16);
+   }
+}
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 12) & 0xf;
-         uint32_t g   = (col >>  8) & 0xf;
-         uint32_t b   = (col >>  4) & 0xf;
-         uint32_t a   = (col >>  0) & 0xf;
-         r            = (r << 4) | r;
-         g            = (g << 4) | g;
-         b            = (b << 4) | b;
-         a            = (a << 4) | a;
-
-         output[w]    = (a << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+static void conv_abgr8888_bgr24_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *out          = (uint8_t*)output_ + 3 * w;
+
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      *out++       = (uint8_t)(col >> 16);
+      *out++       = (uint8_t)(col >>  8);
+      *out++       = (uint8_t)(col >>  0);
    }
 }
 
-void conv_rgba4444_rgb565(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static void conv_argb8888_abgr8888_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint32_t *input = (const uint32_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      output[w]    = ((col << 16) & 0xff0000) |
+         ((col >> 16) & 0xff) | (col & 0xff00ff00);
+   }
+}
+
+static void conv_0rgb1555_bgr24_c(void *output_, const void *input_,
+      int w, int width)
 {
-   int h, w;
    const uint16_t *input = (const uint16_t*)input_;
-   uint16_t *output      = (uint16_t*)output_;
+   uint8_t *out          = (uint8_t*)output_ + 3 * w;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 1, input += in_stride >> 1)
+   for (; w < width; w++)
+   {
+      uint32_t col = input[w];
+      uint32_t b   = (col >>  0) & 0x1f;
+      uint32_t g   = (col >>  5) & 0x1f;
+      uint32_t r   = (col >> 10) & 0x1f;
+      b            = (b << 3) | (b >> 2);
+      g            = (g << 3) | (g >> 2);
+      r            = (r << 3) | (r >> 2);
+
+      *out++       = b;
+      *out++       = g;
+      *out++       = r;
+   }
+}
+
+static void conv_rgb565_bgr24_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *out          = (uint8_t*)output_ + 3 * w;
+
+   for (; w < width; w++)
    {
-      for (w = 0; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 12) & 0xf;
-         uint32_t g   = (col >>  8) & 0xf;
-         uint32_t b   = (col >>  4) & 0xf;
-
-         output[w]    = (r << 12) | (g << 7) | (b << 1);
-      }
+      uint32_t col = input[w];
+      uint32_t r   = (col >> 11) & 0x1f;
+      uint32_t g   = (col >>  5) & 0x3f;
+      uint32_t b   = (col >>  0) & 0x1f;
+      r            = (r << 3) | (r >> 2);
+      g            = (g << 2) | (g >> 4);
+      b            = (b << 3) | (b >> 2);
+
+      *out++       = b;
+      *out++       = g;
+      *out++       = r;
    }
 }
 
-#if defined(__SSE2__)
+static void conv_yuyv_argb8888_c(void *output_, const void *input_,
+      int w, int width)
+{
+   const uint8_t *src = (const uint8_t*)input_ + 2 * w;
+   uint32_t *dst      = (uint32_t*)output_ + w;
+
+   /* Pixels come in pairs sharing U and V; an odd width only
+    * gets the first pixel of the last pair. */
+   for (; w < width; w += 2, src += 4, dst += 2)
+   {
+      int _y0    = src[0];
+      int  u     = src[1] - 128;
+      int _y1    = src[2];
+      int  v     = src[3] - 128;
+
+      uint8_t r0 = clamp_8bit((YUV_MAT_Y * _y0 +                   YUV_MAT_V_R * v + YUV_OFFSET) >> YUV_SHIFT);
+      uint8_t g0 = clamp_8bit((YUV_MAT_Y * _y0 + YUV_MAT_U_G * u + YUV_MAT_V_G * v + YUV_OFFSET) >> YUV_SHIFT);
+      uint8_t b0 = clamp_8bit((YUV_MAT_Y * _y0 + YUV_MAT_U_B * u                   + YUV_OFFSET) >> YUV_SHIFT);
+
+      uint8_t r1 = clamp_8bit((YUV_MAT_Y * _y1 +                   YUV_MAT_V_R * v + YUV_OFFSET) >> YUV_SHIFT);
+      uint8_t g1 = clamp_8bit((YUV_MAT_Y * _y1 + YUV_MAT_U_G * u + YUV_MAT_V_G * v + YUV_OFFSET) >> YUV_SHIFT);
+      uint8_t b1 = clamp_8bit((YUV_MAT_Y * _y1 + YUV_MAT_U_B * u                   + YUV_OFFSET) >> YUV_SHIFT);
+
+      dst[0]     = 0xff000000u | (r0 << 16) | (g0 << 8) | (b0 << 0);
+      if (w + 1 < width)
+         dst[1]  = 0xff000000u | (r1 << 16) | (g1 << 8) | (b1 << 0);
+   }
+}
+
+#ifdef PIXCONV_SSE2
+typedef __m128i pixconv_vec_sse2;
+
+#define PIXCONV_VEC16_sse2       8
+#define PIXCONV_BGR24_SLACK_sse2 0
+
+#define pixconv_load_sse2(p)     _mm_loadu_si128((const __m128i*)(p))
+#define pixconv_store_sse2(p, a) _mm_storeu_si128((__m128i*)(p), a)
+#define pixconv_set16_sse2(x)    _mm_set1_epi16((short)(x))
+#define pixconv_set32_sse2(x)    _mm_set1_epi32((int)(x))
+#define pixconv_and_sse2         _mm_and_si128
+#define pixconv_or_sse2          _mm_or_si128
+#define pixconv_adds16_sse2      _mm_adds_epi16
+#define pixconv_sub16_sse2       _mm_sub_epi16
+#define pixconv_mulhi16_sse2     _mm_mulhi_epi16
+#define pixconv_mullo16_sse2     _mm_mullo_epi16
+#define pixconv_slli16_sse2      _mm_slli_epi16
+#define pixconv_srli16_sse2      _mm_srli_epi16
+#define pixconv_srai16_sse2      _mm_srai_epi16
+#define pixconv_slli32_sse2      _mm_slli_epi32
+#define pixconv_srli32_sse2      _mm_srli_epi32
+#define pixconv_bslli_sse2       _mm_slli_si128
+#define pixconv_bsrli_sse2       _mm_srli_si128
+#define pixconv_unpacklo8_sse2   _mm_unpacklo_epi8
+#define pixconv_unpackhi8_sse2   _mm_unpackhi_epi8
+#define pixconv_unpacklo16_sse2  _mm_unpacklo_epi16
+#define pixconv_unpackhi16_sse2  _mm_unpackhi_epi16
+#define pixconv_packus16_sse2    _mm_packus_epi16
+#define pixconv_packs32_sse2     _mm_packs_epi32
+#define pixconv_order32_sse2(lo, hi)
+
+PIXCONV_TARGET_sse2
+static INLINE void pixconv_widen16_sse2(__m128i a, __m128i *lo, __m128i *hi)
+{
+   const __m128i zero = _mm_setzero_si128();
+   *lo = _mm_unpacklo_epi16(a, zero);
+   *hi = _mm_unpackhi_epi16(a, zero);
+}
+
+/* 32-bit lanes holding 16-bit values, packed into one vector.
+ * There is no unsigned 32-bit pack in SSE2, so the values are
+ * sign-extended first to get them through the signed one. */
+PIXCONV_TARGET_sse2
+static INLINE __m128i pixconv_narrow32_sse2(__m128i lo, __m128i hi)
+{
+   lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+   hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+   return _mm_packs_epi32(lo, hi);
+}
+
+/* 16 BGR24 pixels to 0RGB8888 with a zero top byte. */
+PIXCONV_TARGET_sse2
+static INLINE void pixconv_load_bgr24_sse2(const void *input, __m128i *v)
+{
+   const __m128i mask_0 = _mm_set_epi32(0, 0, 0, 0x00ffffff);
+   const __m128i mask_1 = _mm_set_epi32(0, 0, 0x00ffffff, 0);
+   const __m128i mask_2 = _mm_set_epi32(0, 0x00ffffff, 0, 0);
+   const __m128i mask_3 = _mm_set_epi32(0x00ffffff, 0, 0, 0);
+   const __m128i *in    = (const __m128i*)input;
+   __m128i a            = _mm_loadu_si128(in + 0);
+   __m128i b            = _mm_loadu_si128(in + 1);
+   __m128i c            = _mm_loadu_si128(in + 2);
+
+   v[0] = _mm_or_si128(
+         _mm_or_si128(_mm_and_si128(a, mask_0),
+            _mm_and_si128(_mm_slli_si128(a, 1), mask_1)),
+         _mm_or_si128(_mm_and_si128(_mm_slli_si128(a, 2), mask_2),
+            _mm_and_si128(_mm_slli_si128(a, 3), mask_3)));
+   v[1] = _mm_or_si128(
+         _mm_or_si128(_mm_and_si128(_mm_srli_si128(a, 12), mask_0),
+            _mm_and_si128(_mm_or_si128(_mm_srli_si128(a, 11),
+                  _mm_slli_si128(b, 5)), mask_1)),
+         _mm_or_si128(_mm_and_si128(_mm_slli_si128(b, 6), mask_2),
+            _mm_and_si128(_mm_slli_si128(b, 7), mask_3)));
+   v[2] = _mm_or_si128(
+         _mm_or_si128(_mm_and_si128(_mm_srli_si128(b, 8), mask_0),
+            _mm_and_si128(_mm_srli_si128(b, 7), mask_1)),
+         _mm_or_si128(_mm_and_si128(_mm_or_si128(_mm_srli_si128(b, 6),
+                  _mm_slli_si128(c, 10)), mask_2),
+            _mm_and_si128(_mm_slli_si128(c, 11), mask_3)));
+   v[3] = _mm_or_si128(
+         _mm_or_si128(_mm_and_si128(_mm_srli_si128(c, 4), mask_0),
+            _mm_and_si128(_mm_srli_si128(c, 3), mask_1)),
+         _mm_or_si128(_mm_and_si128(_mm_srli_si128(c, 2), mask_2),
+            _mm_and_si128(_mm_srli_si128(c, 1), mask_3)));
+}
+
 /* :( TODO: Make this saner. */
-static INLINE void store_bgr24_sse2(void *output, __m128i a,
-      __m128i b, __m128i c, __m128i d)
+PIXCONV_TARGET_sse2
+static INLINE void pixconv_store_bgr24_sse2(void *output, const __m128i *v)
 {
    const __m128i mask_0 = _mm_set_epi32(0, 0, 0, 0x00ffffff);
    const __m128i mask_1 = _mm_set_epi32(0, 0, 0x00ffffff, 0);
    const __m128i mask_2 = _mm_set_epi32(0, 0x00ffffff, 0, 0);
    const __m128i mask_3 = _mm_set_epi32(0x00ffffff, 0, 0, 0);
+   __m128i a            = v[0];
+   __m128i b            = v[1];
+   __m128i c            = v[2];
+   __m128i d            = v[3];
 
    __m128i a0 = _mm_and_si128(a, mask_0);
    __m128i a1 = _mm_srli_si128(_mm_and_si128(a, mask_1),  1);
@@ -576,503 +544,402 @@ static INLINE void store_bgr24_sse2(void *output, __m128i a,
          _mm_or_si128(c0, _mm_or_si128(c1, _mm_or_si128(c2,
                   _mm_or_si128(c3, _mm_or_si128(c4, c5))))));
 }
+
+#define PIXCONV_ISA sse2
+#include "pixconv_x86.h"
+#undef PIXCONV_ISA
 #endif
 
-void conv_0rgb1555_bgr24(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+#ifdef PIXCONV_AVX2
+typedef __m256i pixconv_vec_avx2;
+
+#define PIXCONV_VEC16_avx2       16
+/* pixconv_store_bgr24_avx2() writes 4 bytes past its 32 pixels. */
+#define PIXCONV_BGR24_SLACK_avx2 2
+
+#define pixconv_load_avx2(p)     _mm256_loadu_si256((const __m256i*)(p))
+#define pixconv_store_avx2(p, a) _mm256_storeu_si256((__m256i*)(p), a)
+#define pixconv_set16_avx2(x)    _mm256_set1_epi16((short)(x))
+#define pixconv_set32_avx2(x)    _mm256_set1_epi32((int)(x))
+#define pixconv_and_avx2         _mm256_and_si256
+#define pixconv_or_avx2          _mm256_or_si256
+#define pixconv_adds16_avx2      _mm256_adds_epi16
+#define pixconv_sub16_avx2       _mm256_sub_epi16
+#define pixconv_mulhi16_avx2     _mm256_mulhi_epi16
+#define pixconv_mullo16_avx2     _mm256_mullo_epi16
+#define pixconv_slli16_avx2      _mm256_slli_epi16
+#define pixconv_srli16_avx2      _mm256_srli_epi16
+#define pixconv_srai16_avx2      _mm256_srai_epi16
+#define pixconv_slli32_avx2      _mm256_slli_epi32
+#define pixconv_srli32_avx2      _mm256_srli_epi32
+#define pixconv_bslli_avx2       _mm256_slli_si256
+#define pixconv_bsrli_avx2       _mm256_srli_si256
+#define pixconv_unpacklo8_avx2   _mm256_unpacklo_epi8
+#define pixconv_unpackhi8_avx2   _mm256_unpackhi_epi8
+#define pixconv_unpacklo16_avx2  _mm256_unpacklo_epi16
+#define pixconv_unpackhi16_avx2  _mm256_unpackhi_epi16
+#define pixconv_packus16_avx2    _mm256_packus_epi16
+#define pixconv_packs32_avx2     _mm256_packs_epi32
+
+PIXCONV_TARGET_avx2
+static INLINE void pixconv_order32_avx2(__m256i *lo, __m256i *hi)
 {
-   int h;
-   const uint16_t *input     = (const uint16_t*)input_;
-   uint8_t *output           = (uint8_t*)output_;
+   __m256i a = *lo;
+   *lo       = _mm256_permute2x128_si256(a, *hi, 0x20);
+   *hi       = _mm256_permute2x128_si256(a, *hi, 0x31);
+}
 
-#if defined(__SSE2__)
-   const __m128i pix_mask_r  = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_gb = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul15_mid   = _mm_set1_epi16(0x4200);
-   const __m128i mul15_hi    = _mm_set1_epi16(0x0210);
-   const __m128i a           = _mm_set1_epi16(0x00ff);
+PIXCONV_TARGET_avx2
+static INLINE void pixconv_widen16_avx2(__m256i a, __m256i *lo, __m256i *hi)
+{
+   *lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(a));
+   *hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(a, 1));
+}
 
-   int max_width             = width - 15;
-#endif
+PIXCONV_TARGET_avx2
+static INLINE __m256i pixconv_narrow32_avx2(__m256i lo, __m256i hi)
+{
+   return _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xd8);
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride, input += in_stride >> 1)
-   {
-      uint8_t *out = output;
-      int   w = 0;
-
-#if defined(__SSE2__)
-      for (; w < max_width; w += 16, out += 48)
-      {
-         __m128i res_lo_bg0, res_lo_bg1, res_hi_bg0, res_hi_bg1,
-                 res_lo_ra0, res_lo_ra1, res_hi_ra0, res_hi_ra1,
-                 res_lo0, res_lo1, res_hi0, res_hi1;
-         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w + 0));
-         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 8));
-         __m128i r0        = _mm_and_si128(in0, pix_mask_r);
-         __m128i r1        = _mm_and_si128(in1, pix_mask_r);
-         __m128i g0        = _mm_and_si128(in0, pix_mask_gb);
-         __m128i g1        = _mm_and_si128(in1, pix_mask_gb);
-         __m128i b0        = _mm_and_si128(_mm_slli_epi16(in0, 5), pix_mask_gb);
-         __m128i b1        = _mm_and_si128(_mm_slli_epi16(in1, 5), pix_mask_gb);
-
-         r0                = _mm_mulhi_epi16(r0, mul15_hi);
-         r1                = _mm_mulhi_epi16(r1, mul15_hi);
-         g0                = _mm_mulhi_epi16(g0, mul15_mid);
-         g1                = _mm_mulhi_epi16(g1, mul15_mid);
-         b0                = _mm_mulhi_epi16(b0, mul15_mid);
-         b1                = _mm_mulhi_epi16(b1, mul15_mid);
-
-         res_lo_bg0        = _mm_unpacklo_epi8(b0, g0);
-         res_lo_bg1        = _mm_unpacklo_epi8(b1, g1);
-         res_hi_bg0        = _mm_unpackhi_epi8(b0, g0);
-         res_hi_bg1        = _mm_unpackhi_epi8(b1, g1);
-         res_lo_ra0        = _mm_unpacklo_epi8(r0, a);
-         res_lo_ra1        = _mm_unpacklo_epi8(r1, a);
-         res_hi_ra0        = _mm_unpackhi_epi8(r0, a);
-         res_hi_ra1        = _mm_unpackhi_epi8(r1, a);
-
-         res_lo0           = _mm_or_si128(res_lo_bg0,
-               _mm_slli_si128(res_lo_ra0, 2));
-         res_lo1           = _mm_or_si128(res_lo_bg1,
-               _mm_slli_si128(res_lo_ra1, 2));
-         res_hi0           = _mm_or_si128(res_hi_bg0,
-               _mm_slli_si128(res_hi_ra0, 2));
-         res_hi1           = _mm_or_si128(res_hi_bg1,
-               _mm_slli_si128(res_hi_ra1, 2));
-
-         /* Non-POT pixel sizes for the loss */
-         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
-      }
-#endif
+/* 32 BGR24 pixels to 0RGB8888 with a zero top byte.  The upper
+ * lane of each vector is loaded 8 bytes in rather than 12, so
+ * that nothing past the 96 bytes is read. */
+PIXCONV_TARGET_avx2
+static INLINE void pixconv_load_bgr24_avx2(const void *input, __m256i *v)
+{
+   int i;
+   const uint8_t *in  = (const uint8_t*)input;
+   const __m256i shuf = _mm256_setr_epi8(
+          0,  1,  2, -1,  3,  4,  5, -1,  6,  7,  8, -1,  9, 10, 11, -1,
+          4,  5,  6, -1,  7,  8,  9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t b   = (col >>  0) & 0x1f;
-         uint32_t g   = (col >>  5) & 0x1f;
-         uint32_t r   = (col >> 10) & 0x1f;
-         b            = (b << 3) | (b >> 2);
-         g            = (g << 3) | (g >> 2);
-         r            = (r << 3) | (r >> 2);
-
-         *out++       = b;
-         *out++       = g;
-         *out++       = r;
-      }
+   for (i = 0; i < 4; i++)
+   {
+      __m128i lo = _mm_loadu_si128((const __m128i*)(in + 24 * i));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(in + 24 * i + 8));
+      v[i]       = _mm256_shuffle_epi8(_mm256_inserti128_si256(
+               _mm256_castsi128_si256(lo), hi, 1), shuf);
    }
 }
 
-void conv_rgb565_bgr24(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+PIXCONV_TARGET_avx2
+static INLINE void pixconv_store_bgr24_avx2(void *output, const __m256i *v)
 {
-   int h;
-   const uint16_t *input    = (const uint16_t*)input_;
-   uint8_t *output          = (uint8_t*)output_;
-
-#if defined(__SSE2__)
-   const __m128i pix_mask_r = _mm_set1_epi16(0x1f << 10);
-   const __m128i pix_mask_g = _mm_set1_epi16(0x3f <<  5);
-   const __m128i pix_mask_b = _mm_set1_epi16(0x1f <<  5);
-   const __m128i mul16_r    = _mm_set1_epi16(0x0210);
-   const __m128i mul16_g    = _mm_set1_epi16(0x2080);
-   const __m128i mul16_b    = _mm_set1_epi16(0x4200);
-   const __m128i a          = _mm_set1_epi16(0x00ff);
-
-   int max_width            = width - 15;
+   int i;
+   uint8_t *out       = (uint8_t*)output;
+   const __m256i shuf = _mm256_setr_epi8(
+          0,  1,  2,  4,  5,  6,  8,  9, 10, 12, 13, 14, -1, -1, -1, -1,
+          0,  1,  2,  4,  5,  6,  8,  9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+   /* 12 bytes per lane, stored 16 at a time; each store's tail is
+    * overwritten by the next one, bar the last. */
+   for (i = 0; i < 4; i++)
+   {
+      __m256i s = _mm256_shuffle_epi8(v[i], shuf);
+      _mm_storeu_si128((__m128i*)(out + 24 * i),
+            _mm256_castsi256_si128(s));
+      _mm_storeu_si128((__m128i*)(out + 24 * i + 12),
+            _mm256_extracti128_si256(s, 1));
+   }
+}
+
+#define PIXCONV_ISA avx2
+#include "pixconv_x86.h"
+#undef PIXCONV_ISA
 #endif
 
-   for (h = 0; h < height; h++, output += out_stride, input += in_stride >> 1)
+#ifdef PIXCONV_NEON
+/* Only the two NEON loops the compile-time paths always had; the
+ * other conversions use the C kernels on NEON until vector ones can
+ * be built and checked against C on ARM.  vsri/vsli replicate the
+ * top bits of each channel into the bits below. */
+static int conv_rgb565_argb8888_neon(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (w = 0; w + 8 <= width; w += 8)
    {
-      uint8_t *out = output;
-      int        w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 16, out += 48)
-      {
-         __m128i res_lo_bg0, res_hi_bg0, res_lo_ra0, res_hi_ra0;
-         __m128i res_lo_bg1, res_hi_bg1, res_lo_ra1, res_hi_ra1;
-         __m128i res_lo0, res_hi0, res_lo1, res_hi1;
-         const __m128i in0 = _mm_loadu_si128((const __m128i*)(input + w));
-         const __m128i in1 = _mm_loadu_si128((const __m128i*)(input + w + 8));
-         __m128i r0 = _mm_and_si128(_mm_srli_epi16(in0, 1), pix_mask_r);
-         __m128i g0 = _mm_and_si128(in0, pix_mask_g);
-         __m128i b0 = _mm_and_si128(_mm_slli_epi16(in0, 5), pix_mask_b);
-         __m128i r1 = _mm_and_si128(_mm_srli_epi16(in1, 1), pix_mask_r);
-         __m128i g1 = _mm_and_si128(in1, pix_mask_g);
-         __m128i b1 = _mm_and_si128(_mm_slli_epi16(in1, 5), pix_mask_b);
-
-         r0         = _mm_mulhi_epi16(r0, mul16_r);
-         g0         = _mm_mulhi_epi16(g0, mul16_g);
-         b0         = _mm_mulhi_epi16(b0, mul16_b);
-         r1         = _mm_mulhi_epi16(r1, mul16_r);
-         g1         = _mm_mulhi_epi16(g1, mul16_g);
-         b1         = _mm_mulhi_epi16(b1, mul16_b);
-
-         res_lo_bg0 = _mm_unpacklo_epi8(b0, g0);
-         res_hi_bg0 = _mm_unpackhi_epi8(b0, g0);
-         res_lo_ra0 = _mm_unpacklo_epi8(r0, a);
-         res_hi_ra0 = _mm_unpackhi_epi8(r0, a);
-         res_lo_bg1 = _mm_unpacklo_epi8(b1, g1);
-         res_hi_bg1 = _mm_unpackhi_epi8(b1, g1);
-         res_lo_ra1 = _mm_unpacklo_epi8(r1, a);
-         res_hi_ra1 = _mm_unpackhi_epi8(r1, a);
-
-         res_lo0    = _mm_or_si128(res_lo_bg0,
-               _mm_slli_si128(res_lo_ra0, 2));
-         res_hi0    = _mm_or_si128(res_hi_bg0,
-               _mm_slli_si128(res_hi_ra0, 2));
-         res_lo1    = _mm_or_si128(res_lo_bg1,
-               _mm_slli_si128(res_lo_ra1, 2));
-         res_hi1    = _mm_or_si128(res_hi_bg1,
-               _mm_slli_si128(res_hi_ra1, 2));
-
-         store_bgr24_sse2(out, res_lo0, res_hi0, res_lo1, res_hi1);
-      }
-#endif
+      uint16x8_t in = vld1q_u16(input + w);
+
+      uint16x8_t r = vsriq_n_u16(in, in, 5);
+      uint16x8_t b = vsliq_n_u16(in, in, 5);
+      uint16x8_t g = vsriq_n_u16(b,  b,  6);
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint32_t r   = (col >> 11) & 0x1f;
-         uint32_t g   = (col >>  5) & 0x3f;
-         uint32_t b   = (col >>  0) & 0x1f;
-         r = (r << 3) | (r >> 2);
-         g = (g << 2) | (g >> 4);
-         b = (b << 3) | (b >> 2);
-
-         *out++ = b;
-         *out++ = g;
-         *out++ = r;
-      }
+      uint8x8x4_t res;
+      res.val[3] = vdup_n_u8(0xffu);
+      res.val[2] = vshrn_n_u16(r, 8);
+      res.val[1] = vshrn_n_u16(g, 8);
+      res.val[0] = vshrn_n_u16(b, 2);
+
+      vst4_u8((uint8_t*)(output + w), res);
    }
+
+   return w;
 }
 
-void conv_bgr24_argb8888(void *output_, const void *input_,
-      int width, int height,
-      int out_stride, int in_stride)
+static int conv_rgb565_abgr8888_neon(void *output_, const void *input_,
+      int width)
 {
-   int h, w;
-   const uint8_t *input = (const uint8_t*)input_;
-   uint32_t *output     = (uint32_t*)output_;
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride)
+   for (w = 0; w + 8 <= width; w += 8)
    {
-      const uint8_t *inp = input;
-      for (w = 0; w < width; w++)
-      {
-         uint32_t b = *inp++;
-         uint32_t g = *inp++;
-         uint32_t r = *inp++;
-         output[w]  = (0xffu << 24) | (r << 16) | (g << 8) | (b << 0);
-      }
+      uint16x8_t in = vld1q_u16(input + w);
+
+      uint16x8_t r = vsriq_n_u16(in, in, 5);
+      uint16x8_t b = vsliq_n_u16(in, in, 5);
+      uint16x8_t g = vsriq_n_u16(b,  b,  6);
+
+      uint8x8x4_t res;
+      res.val[3] = vdup_n_u8(0xffu);
+      res.val[2] = vshrn_n_u16(b, 2);
+      res.val[1] = vshrn_n_u16(g, 8);
+      res.val[0] = vshrn_n_u16(r, 8);
+
+      vst4_u8((uint8_t*)(output + w), res);
    }
+
+   return w;
 }
+#endif
+
+struct pixconv_kernels
+{
+   pixconv_simd_t rgb565_0rgb1555;
+   pixconv_simd_t _0rgb1555_rgb565;
+   pixconv_simd_t _0rgb1555_argb8888;
+   pixconv_simd_t rgb565_argb8888;
+   pixconv_simd_t rgb565_abgr8888;
+   pixconv_simd_t rgba4444_argb8888;
+   pixconv_simd_t rgba4444_rgb565;
+   pixconv_simd_t bgr24_argb8888;
+   pixconv_simd_t bgr24_rgb565;
+   pixconv_simd_t argb8888_0rgb1555;
+   pixconv_simd_t argb8888_rgba4444;
+   pixconv_simd_t argb8888_rgb565;
+   pixconv_simd_t argb8888_bgr24;
+   pixconv_simd_t abgr8888_bgr24;
+   pixconv_simd_t argb8888_abgr8888;
+   pixconv_simd_t _0rgb1555_bgr24;
+   pixconv_simd_t rgb565_bgr24;
+   pixconv_simd_t yuyv_argb8888;
+};
+
+/* C only: every row is left to the C kernels. */
+static const struct pixconv_kernels pixconv_kernels_c = { NULL };
+
+#define PIXCONV_KERNELS(isa) { \
+   conv_rgb565_0rgb1555_##isa, \
+   conv_0rgb1555_rgb565_##isa, \
+   conv_0rgb1555_argb8888_##isa, \
+   conv_rgb565_argb8888_##isa, \
+   conv_rgb565_abgr8888_##isa, \
+   conv_rgba4444_argb8888_##isa, \
+   conv_rgba4444_rgb565_##isa, \
+   conv_bgr24_argb8888_##isa, \
+   conv_bgr24_rgb565_##isa, \
+   conv_argb8888_0rgb1555_##isa, \
+   conv_argb8888_rgba4444_##isa, \
+   conv_argb8888_rgb565_##isa, \
+   conv_argb8888_bgr24_##isa, \
+   conv_abgr8888_bgr24_##isa, \
+   conv_argb8888_abgr8888_##isa, \
+   conv_0rgb1555_bgr24_##isa, \
+   conv_rgb565_bgr24_##isa, \
+   conv_yuyv_argb8888_##isa \
+}
+
+#ifdef PIXCONV_SSE2
+static const struct pixconv_kernels pixconv_kernels_sse2 = PIXCONV_KERNELS(sse2);
+#endif
+#ifdef PIXCONV_AVX2
+static const struct pixconv_kernels pixconv_kernels_avx2 = PIXCONV_KERNELS(avx2);
+#endif
+#ifdef PIXCONV_NEON
+static const struct pixconv_kernels pixconv_kernels_neon = {
+   NULL,
+   NULL,
+   NULL,
+   conv_rgb565_argb8888_neon,
+   conv_rgb565_abgr8888_neon
+};
+#endif
+
+/* Until pixconv_init_simd() runs, use what the build targets
+ * anyway, as the compile-time paths always did. */
+#if defined(PIXCONV_SSE2) && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+static enum pixconv_impl pixconv_impl_current          = PIXCONV_IMPL_SSE2;
+static const struct pixconv_kernels *pixconv_current   = &pixconv_kernels_sse2;
+#elif defined(PIXCONV_NEON)
+static enum pixconv_impl pixconv_impl_current          = PIXCONV_IMPL_NEON;
+static const struct pixconv_kernels *pixconv_current   = &pixconv_kernels_neon;
+#else
+static enum pixconv_impl pixconv_impl_current          = PIXCONV_IMPL_C;
+static const struct pixconv_kernels *pixconv_current   = &pixconv_kernels_c;
+#endif
 
-void conv_bgr24_rgb565(void *output_, const void *input_,
+static void pixconv_rows(pixconv_simd_t simd, pixconv_c_t c,
+      void *output_, const void *input_,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h, w;
+   int h;
    const uint8_t *input = (const uint8_t*)input_;
-   uint16_t *output     = (uint16_t*)output_;
+   uint8_t *output      = (uint8_t*)output_;
+
    for (h = 0; h < height;
          h++, output += out_stride, input += in_stride)
-   {
-      const uint8_t *inp = input;
-      for (w = 0; w < width; w++)
-      {
-         uint16_t b = *inp++;
-         uint16_t g = *inp++;
-         uint16_t r = *inp++;
-
-         output[w] = ((r & 0x00F8) << 8) | ((g&0x00FC) << 3) | ((b&0x00F8) >> 3);
-      }
-   }
+      c(output, input, simd ? simd(output, input, width) : 0, width);
 }
 
-void conv_argb8888_0rgb1555(void *output_, const void *input_,
+void conv_rgb565_0rgb1555(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h, w;
-   const uint32_t *input = (const uint32_t*)input_;
-   uint16_t *output      = (uint16_t*)output_;
+   pixconv_rows(pixconv_current->rgb565_0rgb1555, conv_rgb565_0rgb1555_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 1, input += in_stride >> 2)
-   {
-      for (w = 0; w < width; w++)
-      {
-         uint32_t col = input[w];
-         uint16_t r   = (col >> 19) & 0x1f;
-         uint16_t g   = (col >> 11) & 0x1f;
-         uint16_t b   = (col >>  3) & 0x1f;
-         output[w]    = (r << 10) | (g << 5) | (b << 0);
-      }
-   }
+void conv_0rgb1555_rgb565(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->_0rgb1555_rgb565, conv_0rgb1555_rgb565_c,
+         output, input, width, height, out_stride, in_stride);
 }
 
-void conv_argb8888_bgr24(void *output_, const void *input_,
+void conv_0rgb1555_argb8888(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h;
-   const uint32_t *input = (const uint32_t*)input_;
-   uint8_t *output       = (uint8_t*)output_;
+   pixconv_rows(pixconv_current->_0rgb1555_argb8888, conv_0rgb1555_argb8888_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-#if defined(__SSE2__)
-   int max_width = width - 15;
-#endif
+void conv_rgb565_argb8888(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->rgb565_argb8888, conv_rgb565_argb8888_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride, input += in_stride >> 2)
-   {
-      uint8_t *out = output;
-      int        w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 16, out += 48)
-      {
-         __m128i l0 = _mm_loadu_si128((const __m128i*)(input + w +  0));
-         __m128i l1 = _mm_loadu_si128((const __m128i*)(input + w +  4));
-         __m128i l2 = _mm_loadu_si128((const __m128i*)(input + w +  8));
-         __m128i l3 = _mm_loadu_si128((const __m128i*)(input + w + 12));
-         store_bgr24_sse2(out, l0, l1, l2, l3);
-      }
-#endif
+void conv_rgb565_abgr8888(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->rgb565_abgr8888, conv_rgb565_abgr8888_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         *out++       = (uint8_t)(col >>  0);
-         *out++       = (uint8_t)(col >>  8);
-         *out++       = (uint8_t)(col >> 16);
-      }
-   }
+void conv_rgba4444_argb8888(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->rgba4444_argb8888, conv_rgba4444_argb8888_c,
+         output, input, width, height, out_stride, in_stride);
 }
 
-#if defined(__SSE2__)
-static INLINE __m128i conv_shuffle_rb_epi32(__m128i c)
+void conv_rgba4444_rgb565(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
 {
-   /* SSSE3 plz */
-   const __m128i b_mask = _mm_set1_epi32(0x000000ff);
-   const __m128i g_mask = _mm_set1_epi32(0x0000ff00);
-   const __m128i r_mask = _mm_set1_epi32(0x00ff0000);
-   __m128i sl = _mm_and_si128(_mm_slli_epi32(c, 16), r_mask);
-   __m128i sr = _mm_and_si128(_mm_srli_epi32(c, 16), b_mask);
-   __m128i g  = _mm_and_si128(c, g_mask);
-   __m128i rb = _mm_or_si128(sl, sr);
-   return _mm_or_si128(g, rb);
+   pixconv_rows(pixconv_current->rgba4444_rgb565, conv_rgba4444_rgb565_c,
+         output, input, width, height, out_stride, in_stride);
 }
-#endif
 
-void conv_abgr8888_bgr24(void *output_, const void *input_,
+void conv_bgr24_argb8888(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h;
-   const uint32_t *input = (const uint32_t*)input_;
-   uint8_t *output       = (uint8_t*)output_;
+   pixconv_rows(pixconv_current->bgr24_argb8888, conv_bgr24_argb8888_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-#if defined(__SSE2__)
-   int max_width = width - 15;
-#endif
+void conv_bgr24_rgb565(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->bgr24_rgb565, conv_bgr24_rgb565_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride, input += in_stride >> 2)
-   {
-      uint8_t *out = output;
-      int        w = 0;
-#if defined(__SSE2__)
-      for (; w < max_width; w += 16, out += 48)
-      {
-		 __m128i a = _mm_loadu_si128((const __m128i*)(input + w +  0));
-		 __m128i b = _mm_loadu_si128((const __m128i*)(input + w +  4));
-		 __m128i c = _mm_loadu_si128((const __m128i*)(input + w +  8));
-		 __m128i d = _mm_loadu_si128((const __m128i*)(input + w + 12));
-         a = conv_shuffle_rb_epi32(a);
-         b = conv_shuffle_rb_epi32(b);
-         c = conv_shuffle_rb_epi32(c);
-         d = conv_shuffle_rb_epi32(d);
-         store_bgr24_sse2(out, a, b, c, d);
-      }
-#endif
+void conv_argb8888_0rgb1555(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->argb8888_0rgb1555, conv_argb8888_0rgb1555_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-      for (; w < width; w++)
-      {
-         uint32_t col = input[w];
-         *out++       = (uint8_t)(col >> 16);
-         *out++       = (uint8_t)(col >>  8);
-         *out++       = (uint8_t)(col >>  0);
-      }
-   }
+void conv_argb8888_rgba4444(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->argb8888_rgba4444, conv_argb8888_rgba4444_c,
+         output, input, width, height, out_stride, in_stride);
 }
 
-void conv_argb8888_abgr8888(void *output_, const void *input_,
+void conv_argb8888_rgb565(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h, w;
-   const uint32_t *input = (const uint32_t*)input_;
-   uint32_t *output      = (uint32_t*)output_;
+   pixconv_rows(pixconv_current->argb8888_rgb565, conv_argb8888_rgb565_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-   for (h = 0; h < height;
-         h++, output += out_stride >> 2, input += in_stride >> 2)
-   {
-      for (w = 0; w < width; w++)
-      {
-         uint32_t col = input[w];
-         output[w]    = ((col << 16) & 0xff0000) |
-            ((col >> 16) & 0xff) | (col & 0xff00ff00);
-      }
-   }
+void conv_argb8888_bgr24(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->argb8888_bgr24, conv_argb8888_bgr24_c,
+         output, input, width, height, out_stride, in_stride);
 }
 
-#define YUV_SHIFT 6
-#define YUV_OFFSET (1 << (YUV_SHIFT - 1))
-#define YUV_MAT_Y (1 << 6)
-#define YUV_MAT_U_G (-22)
-#define YUV_MAT_U_B (113)
-#define YUV_MAT_V_R (90)
-#define YUV_MAT_V_G (-46)
+void conv_abgr8888_bgr24(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->abgr8888_bgr24, conv_abgr8888_bgr24_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-void conv_yuyv_argb8888(void *output_, const void *input_,
+void conv_argb8888_abgr8888(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride)
 {
-   int h;
-   const uint8_t *input        = (const uint8_t*)input_;
-   uint32_t *output            = (uint32_t*)output_;
-
-#if defined(__SSE2__)
-   const __m128i mask_y        = _mm_set1_epi16(0xffu);
-   const __m128i mask_u        = _mm_set1_epi32(0xffu << 8);
-   const __m128i mask_v        = _mm_set1_epi32(0xffu << 24);
-   const __m128i chroma_offset = _mm_set1_epi16(128);
-   const __m128i round_offset  = _mm_set1_epi16(YUV_OFFSET);
-
-   const __m128i yuv_mul       = _mm_set1_epi16(YUV_MAT_Y);
-   const __m128i u_g_mul       = _mm_set1_epi16(YUV_MAT_U_G);
-   const __m128i u_b_mul       = _mm_set1_epi16(YUV_MAT_U_B);
-   const __m128i v_r_mul       = _mm_set1_epi16(YUV_MAT_V_R);
-   const __m128i v_g_mul       = _mm_set1_epi16(YUV_MAT_V_G);
-   const __m128i a             = _mm_cmpeq_epi16(
-         _mm_setzero_si128(), _mm_setzero_si128());
-#endif
+   pixconv_rows(pixconv_current->argb8888_abgr8888, conv_argb8888_abgr8888_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-   for (h = 0; h < height; h++, output += out_stride >> 2, input += in_stride)
-   {
-      const uint8_t *src = input;
-      uint32_t      *dst = output;
-      int              w = 0;
-
-#if defined(__SSE2__)
-      /* Each loop processes 16 pixels. */
-      for (; w + 16 <= width; w += 16, src += 32, dst += 16)
-      {
-         __m128i u, v, u0_g, u1_g, u0_b, u1_b, v0_r, v1_r, v0_g, v1_g,
-                 r0, g0, b0, r1, g1, b1;
-         __m128i res_lo_bg, res_hi_bg, res_lo_ra, res_hi_ra;
-         __m128i res0, res1, res2, res3;
-         __m128i yuv0 = _mm_loadu_si128((const __m128i*)(src +  0)); /* [Y0, U0, Y1, V0, Y2, U1, Y3, V1, ...] */
-         __m128i yuv1 = _mm_loadu_si128((const __m128i*)(src + 16)); /* [Y0, U0, Y1, V0, Y2, U1, Y3, V1, ...] */
-
-         __m128i _y0 = _mm_and_si128(yuv0, mask_y); /* [Y0, Y1, Y2, ...] (16-bit) */
-         __m128i u0 = _mm_and_si128(yuv0, mask_u); /* [0, U0, 0, 0, 0, U1, 0, 0, ...] */
-         __m128i v0 = _mm_and_si128(yuv0, mask_v); /* [0, 0, 0, V1, 0, , 0, V1, ...] */
-         __m128i _y1 = _mm_and_si128(yuv1, mask_y); /* [Y0, Y1, Y2, ...] (16-bit) */
-         __m128i u1 = _mm_and_si128(yuv1, mask_u); /* [0, U0, 0, 0, 0, U1, 0, 0, ...] */
-         __m128i v1 = _mm_and_si128(yuv1, mask_v); /* [0, 0, 0, V1, 0, , 0, V1, ...] */
-
-         /* Juggle around to get U and V in the same 16-bit format as Y. */
-         u0 = _mm_srli_si128(u0, 1);
-         v0 = _mm_srli_si128(v0, 3);
-         u1 = _mm_srli_si128(u1, 1);
-         v1 = _mm_srli_si128(v1, 3);
-         u = _mm_packs_epi32(u0, u1);
-         v = _mm_packs_epi32(v0, v1);
-
-         /* Apply YUV offsets (U, V) -= (-128, -128). */
-         u = _mm_sub_epi16(u, chroma_offset);
-         v = _mm_sub_epi16(v, chroma_offset);
-
-         /* Upscale chroma horizontally (nearest). */
-         u0 = _mm_unpacklo_epi16(u, u);
-         u1 = _mm_unpackhi_epi16(u, u);
-         v0 = _mm_unpacklo_epi16(v, v);
-         v1 = _mm_unpackhi_epi16(v, v);
-
-         /* Apply transformations. */
-         _y0 = _mm_mullo_epi16(_y0, yuv_mul);
-         _y1 = _mm_mullo_epi16(_y1, yuv_mul);
-         u0_g   = _mm_mullo_epi16(u0, u_g_mul);
-         u1_g   = _mm_mullo_epi16(u1, u_g_mul);
-         u0_b   = _mm_mullo_epi16(u0, u_b_mul);
-         u1_b   = _mm_mullo_epi16(u1, u_b_mul);
-         v0_r   = _mm_mullo_epi16(v0, v_r_mul);
-         v1_r   = _mm_mullo_epi16(v1, v_r_mul);
-         v0_g   = _mm_mullo_epi16(v0, v_g_mul);
-         v1_g   = _mm_mullo_epi16(v1, v_g_mul);
-
-         /* Add contibutions from the transformed components. */
-         r0 = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(_y0, v0_r),
-                  round_offset), YUV_SHIFT);
-         g0 = _mm_srai_epi16(_mm_adds_epi16(
-                  _mm_adds_epi16(_mm_adds_epi16(_y0, v0_g), u0_g), round_offset), YUV_SHIFT);
-         b0 = _mm_srai_epi16(_mm_adds_epi16(
-                  _mm_adds_epi16(_y0, u0_b), round_offset), YUV_SHIFT);
-
-         r1 = _mm_srai_epi16(_mm_adds_epi16(
-                  _mm_adds_epi16(_y1, v1_r), round_offset), YUV_SHIFT);
-         g1 = _mm_srai_epi16(_mm_adds_epi16(
-                  _mm_adds_epi16(_mm_adds_epi16(_y1, v1_g), u1_g), round_offset), YUV_SHIFT);
-         b1 = _mm_srai_epi16(_mm_adds_epi16(
-                  _mm_adds_epi16(_y1, u1_b), round_offset), YUV_SHIFT);
-
-         /* Saturate into 8-bit. */
-         r0 = _mm_packus_epi16(r0, r1);
-         g0 = _mm_packus_epi16(g0, g1);
-         b0 = _mm_packus_epi16(b0, b1);
-
-         /* Interleave into ARGB. */
-         res_lo_bg = _mm_unpacklo_epi8(b0, g0);
-         res_hi_bg = _mm_unpackhi_epi8(b0, g0);
-         res_lo_ra = _mm_unpacklo_epi8(r0, a);
-         res_hi_ra = _mm_unpackhi_epi8(r0, a);
-         res0 = _mm_unpacklo_epi16(res_lo_bg, res_lo_ra);
-         res1 = _mm_unpackhi_epi16(res_lo_bg, res_lo_ra);
-         res2 = _mm_unpacklo_epi16(res_hi_bg, res_hi_ra);
-         res3 = _mm_unpackhi_epi16(res_hi_bg, res_hi_ra);
-
-         _mm_storeu_si128((__m128i*)(dst +  0), res0);
-         _mm_storeu_si128((__m128i*)(dst +  4), res1);
-         _mm_storeu_si128((__m128i*)(dst +  8), res2);
-         _mm_storeu_si128((__m128i*)(dst + 12), res3);
-      }
-#endif
+void conv_0rgb1555_bgr24(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->_0rgb1555_bgr24, conv_0rgb1555_bgr24_c,
+         output, input, width, height, out_stride, in_stride);
+}
 
-      /* Finish off the rest (if any) in C. */
-      for (; w < width; w += 2, src += 4, dst += 2)
-      {
-         int _y0    = src[0];
-         int  u     = src[1] - 128;
-         int _y1    = src[2];
-         int  v     = src[3] - 128;
-
-         uint8_t r0 = clamp_8bit((YUV_MAT_Y * _y0 +                   YUV_MAT_V_R * v + YUV_OFFSET) >> YUV_SHIFT);
-         uint8_t g0 = clamp_8bit((YUV_MAT_Y * _y0 + YUV_MAT_U_G * u + YUV_MAT_V_G * v + YUV_OFFSET) >> YUV_SHIFT);
-         uint8_t b0 = clamp_8bit((YUV_MAT_Y * _y0 + YUV_MAT_U_B * u                   + YUV_OFFSET) >> YUV_SHIFT);
-
-         uint8_t r1 = clamp_8bit((YUV_MAT_Y * _y1 +                   YUV_MAT_V_R * v + YUV_OFFSET) >> YUV_SHIFT);
-         uint8_t g1 = clamp_8bit((YUV_MAT_Y * _y1 + YUV_MAT_U_G * u + YUV_MAT_V_G * v + YUV_OFFSET) >> YUV_SHIFT);
-         uint8_t b1 = clamp_8bit((YUV_MAT_Y * _y1 + YUV_MAT_U_B * u                   + YUV_OFFSET) >> YUV_SHIFT);
-
-         dst[0]     = 0xff000000u | (r0 << 16) | (g0 << 8) | (b0 << 0);
-         dst[1]     = 0xff000000u | (r1 << 16) | (g1 << 8) | (b1 << 0);
-      }
-   }
+void conv_rgb565_bgr24(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->rgb565_bgr24, conv_rgb565_bgr24_c,
+         output, input, width, height, out_stride, in_stride);
+}
+
+void conv_yuyv_argb8888(void *output, const void *input,
+      int width, int height,
+      int out_stride, int in_stride)
+{
+   pixconv_rows(pixconv_current->yuyv_argb8888, conv_yuyv_argb8888_c,
+         output, input, width, height, out_stride, in_stride);
 }
 
 void conv_copy(void *output_, const void *input_,
@@ -1091,3 +958,81 @@ void conv_copy(void *output_, const void *input_,
          h++, output += out_stride, input += in_stride)
       memcpy(output, input, copy_len);
 }
+
+bool pixconv_set_impl(enum pixconv_impl impl)
+{
+   uint64_t cpu = cpu_features_get();
+
+   (void)cpu;
+
+   switch (impl)
+   {
+      case PIXCONV_IMPL_C:
+         pixconv_current = &pixconv_kernels_c;
+         break;
+#ifdef PIXCONV_SSE2
+      case PIXCONV_IMPL_SSE2:
+         if (!(cpu & RETRO_SIMD_SSE2))
+            return false;
+         pixconv_current = &pixconv_kernels_sse2;
+         break;
+#endif
+#ifdef PIXCONV_AVX2
+      case PIXCONV_IMPL_AVX2:
+         if (     !(cpu & RETRO_SIMD_AVX)
+               || !(cpu & RETRO_SIMD_AVX2))
+            return false;
+         pixconv_current = &pixconv_kernels_avx2;
+         break;
+#endif
+#ifdef PIXCONV_NEON
+      case PIXCONV_IMPL_NEON:
+#if !defined(__aarch64__) && !defined(_M_ARM64)
+         if (!(cpu & RETRO_SIMD_NEON))
+            return false;
+#endif
+         pixconv_current = &pixconv_kernels_neon;
+         break;
+#endif
+      default:
+         return false;
+   }
+
+   pixconv_impl_current = impl;
+   return true;
+}
+
+enum pixconv_impl pixconv_get_impl(void)
+{
+   return pixconv_impl_current;
+}
+
+const char *pixconv_impl_name(enum pixconv_impl impl)
+{
+   switch (impl)
+   {
+      case PIXCONV_IMPL_C:
+         return "C";
+      case PIXCONV_IMPL_SSE2:
+         return "SSE2";
+      case PIXCONV_IMPL_AVX2:
+         return "AVX2";
+      case PIXCONV_IMPL_NEON:
+         return "NEON";
+      default:
+         break;
+   }
+   return "unknown";
+}
+
+void pixconv_init_simd(void)
+{
+   /* Widest first; set_impl rejects what the CPU can't run. */
+   if (pixconv_set_impl(PIXCONV_IMPL_AVX2))
+      return;
+   if (pixconv_set_impl(PIXCONV_IMPL_NEON))
+      return;
+   if (pixconv_set_impl(PIXCONV_IMPL_SSE2))
+      return;
+   pixconv_set_impl(PIXCONV_IMPL_C);
+}
@@ -0,0 +1,671 @@
+/* Copyright  (C) 2010-2020 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (pixconv_x86.h).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Row kernels shared by the SSE2 and AVX2 builds of pixconv.c.
+ *
+ * This file is included once per instruction set, with PIXCONV_ISA
+ * set to its suffix (sse2, avx2).  The PX_* primitives map onto the
+ * pixconv_*_<suffix> helpers that pixconv.c defines beforehand.  The
+ * 8-bit and 16-bit unpacks and packs work within 128-bit lanes, as
+ * they do in AVX2; PX_ORDER32 puts 32-bit pixels that went through
+ * them back in memory order.
+ *
+ * Every kernel converts as many whole blocks of a row as fit in
+ * 'width' and returns how many pixels that was; the C code in
+ * pixconv.c finishes the row. */
+
+#define PX_PASTE_(a, b)           a##_##b
+#define PX_PASTE(a, b)            PX_PASTE_(a, b)
+#define PX(name)                  PX_PASTE(name, PIXCONV_ISA)
+
+#define PX_VEC                    PX(pixconv_vec)
+#define PX_TARGET                 PX(PIXCONV_TARGET)
+/* 16-bit pixels per vector, and 32-bit ones. */
+#define PX_N16                    PX(PIXCONV_VEC16)
+#define PX_N32                    (PX_N16 / 2)
+#define PX_BGR24_SLACK            PX(PIXCONV_BGR24_SLACK)
+
+#define PX_LOAD                   PX(pixconv_load)
+#define PX_STORE                  PX(pixconv_store)
+#define PX_SET16                  PX(pixconv_set16)
+#define PX_SET32                  PX(pixconv_set32)
+#define PX_AND                    PX(pixconv_and)
+#define PX_OR                     PX(pixconv_or)
+#define PX_ADDS16                 PX(pixconv_adds16)
+#define PX_SUB16                  PX(pixconv_sub16)
+#define PX_MULHI16                PX(pixconv_mulhi16)
+#define PX_MULLO16                PX(pixconv_mullo16)
+#define PX_SLLI16                 PX(pixconv_slli16)
+#define PX_SRLI16                 PX(pixconv_srli16)
+#define PX_SRAI16                 PX(pixconv_srai16)
+#define PX_SLLI32                 PX(pixconv_slli32)
+#define PX_SRLI32                 PX(pixconv_srli32)
+#define PX_BSLLI                  PX(pixconv_bslli)
+#define PX_BSRLI                  PX(pixconv_bsrli)
+#define PX_UNPACKLO8              PX(pixconv_unpacklo8)
+#define PX_UNPACKHI8              PX(pixconv_unpackhi8)
+#define PX_UNPACKLO16             PX(pixconv_unpacklo16)
+#define PX_UNPACKHI16             PX(pixconv_unpackhi16)
+#define PX_PACKUS16               PX(pixconv_packus16)
+#define PX_PACKS32                PX(pixconv_packs32)
+#define PX_WIDEN16                PX(pixconv_widen16)
+#define PX_NARROW32               PX(pixconv_narrow32)
+#define PX_ORDER32                PX(pixconv_order32)
+#define PX_LOAD_BGR24             PX(pixconv_load_bgr24)
+#define PX_STORE_BGR24            PX(pixconv_store_bgr24)
+
+/* Expands the 5:5:5 channels of 16-bit pixels to 8 bits, left in
+ * the low byte of each 16-bit lane: the multiply-high by 0x0210 or
+ * 0x4200 of a channel at bit 10 or 5 is (c << 3) | (c >> 2). */
+PX_TARGET
+static INLINE void PX(pixconv_split_0rgb1555)(PX_VEC in,
+      PX_VEC *r, PX_VEC *g, PX_VEC *b)
+{
+   const PX_VEC pix_mask_r  = PX_SET16(0x1f << 10);
+   const PX_VEC pix_mask_gb = PX_SET16(0x1f <<  5);
+   const PX_VEC mul15_mid   = PX_SET16(0x4200);
+   const PX_VEC mul15_hi    = PX_SET16(0x0210);
+
+   *r = PX_MULHI16(PX_AND(in, pix_mask_r), mul15_hi);
+   *g = PX_MULHI16(PX_AND(in, pix_mask_gb), mul15_mid);
+   *b = PX_MULHI16(PX_AND(PX_SLLI16(in, 5), pix_mask_gb), mul15_mid);
+}
+
+/* Same for 5:6:5; 0x2080 gives (g << 2) | (g >> 4). */
+PX_TARGET
+static INLINE void PX(pixconv_split_rgb565)(PX_VEC in,
+      PX_VEC *r, PX_VEC *g, PX_VEC *b)
+{
+   const PX_VEC pix_mask_r  = PX_SET16(0x1f << 10);
+   const PX_VEC pix_mask_g  = PX_SET16(0x3f <<  5);
+   const PX_VEC pix_mask_b  = PX_SET16(0x1f <<  5);
+   const PX_VEC mul16_r     = PX_SET16(0x0210);
+   const PX_VEC mul16_g     = PX_SET16(0x2080);
+   const PX_VEC mul16_b     = PX_SET16(0x4200);
+
+   *r = PX_MULHI16(PX_AND(PX_SRLI16(in, 1), pix_mask_r), mul16_r);
+   *g = PX_MULHI16(PX_AND(in, pix_mask_g), mul16_g);
+   *b = PX_MULHI16(PX_AND(PX_SLLI16(in, 5), pix_mask_b), mul16_b);
+}
+
+/* Interleaves four 8-bit channels, one per 16-bit lane, into 32-bit
+ * pixels c0 | c1 << 8 | c2 << 16 | c3 << 24, in memory order. */
+PX_TARGET
+static INLINE void PX(pixconv_merge8888)(PX_VEC c0, PX_VEC c1,
+      PX_VEC c2, PX_VEC c3, PX_VEC *lo, PX_VEC *hi)
+{
+   *lo = PX_OR(PX_UNPACKLO8(c0, c1), PX_BSLLI(PX_UNPACKLO8(c2, c3), 2));
+   *hi = PX_OR(PX_UNPACKHI8(c0, c1), PX_BSLLI(PX_UNPACKHI8(c2, c3), 2));
+   PX_ORDER32(lo, hi);
+}
+
+/* 32-bit pixels to 5:6:5 in the low half of each lane. */
+PX_TARGET
+static INLINE PX_VEC PX(pixconv_pack_rgb565)(PX_VEC col)
+{
+   return PX_OR(PX_OR(
+            PX_AND(PX_SRLI32(col, 8), PX_SET32(0xf800)),
+            PX_AND(PX_SRLI32(col, 5), PX_SET32(0x07e0))),
+         PX_AND(PX_SRLI32(col, 3), PX_SET32(0x001f)));
+}
+
+/* Swaps the first and third byte of 32-bit pixels. */
+PX_TARGET
+static INLINE PX_VEC PX(pixconv_swap_rb)(PX_VEC col)
+{
+   return PX_OR(PX_OR(
+            PX_AND(PX_SLLI32(col, 16), PX_SET32(0x00ff0000)),
+            PX_AND(PX_SRLI32(col, 16), PX_SET32(0x000000ff))),
+         PX_AND(col, PX_SET32(0xff00ff00)));
+}
+
+PX_TARGET
+static int PX(conv_rgb565_0rgb1555)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+   const PX_VEC hi_mask  = PX_SET16(0x7fe0);
+   const PX_VEC lo_mask  = PX_SET16(0x1f);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      const PX_VEC in = PX_LOAD(input + w);
+      PX_STORE(output + w, PX_OR(PX_AND(PX_SRLI16(in, 1), hi_mask),
+               PX_AND(in, lo_mask)));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_0rgb1555_rgb565)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input  = (const uint16_t*)input_;
+   uint16_t *output       = (uint16_t*)output_;
+   const PX_VEC hi_mask   = PX_SET16((0x1f << 11) | (0x1f << 6));
+   const PX_VEC lo_mask   = PX_SET16(0x1f);
+   const PX_VEC glow_mask = PX_SET16(1 << 5);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      const PX_VEC in = PX_LOAD(input + w);
+      PX_VEC rg       = PX_AND(PX_SLLI16(in, 1), hi_mask);
+      PX_VEC b        = PX_AND(in, lo_mask);
+      PX_VEC glow     = PX_AND(PX_SRLI16(in, 4), glow_mask);
+      PX_STORE(output + w, PX_OR(rg, PX_OR(b, glow)));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_0rgb1555_argb8888)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+   const PX_VEC a        = PX_SET16(0x00ff);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC r, g, b, lo, hi;
+      PX(pixconv_split_0rgb1555)(PX_LOAD(input + w), &r, &g, &b);
+      PX(pixconv_merge8888)(b, g, r, a, &lo, &hi);
+      PX_STORE(output + w,          lo);
+      PX_STORE(output + w + PX_N32, hi);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_rgb565_argb8888)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+   const PX_VEC a        = PX_SET16(0x00ff);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC r, g, b, lo, hi;
+      PX(pixconv_split_rgb565)(PX_LOAD(input + w), &r, &g, &b);
+      PX(pixconv_merge8888)(b, g, r, a, &lo, &hi);
+      PX_STORE(output + w,          lo);
+      PX_STORE(output + w + PX_N32, hi);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_rgb565_abgr8888)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+   const PX_VEC a        = PX_SET16(0x00ff);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC r, g, b, lo, hi;
+      PX(pixconv_split_rgb565)(PX_LOAD(input + w), &r, &g, &b);
+      PX(pixconv_merge8888)(r, g, b, a, &lo, &hi);
+      PX_STORE(output + w,          lo);
+      PX_STORE(output + w + PX_N32, hi);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_rgba4444_argb8888)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+   const PX_VEC mask_r   = PX_SET32(0xf000);
+   const PX_VEC mask_g   = PX_SET32(0x0f00);
+   const PX_VEC mask_b   = PX_SET32(0x00f0);
+   const PX_VEC mask_a   = PX_SET32(0x000f);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC col[2];
+      PX_WIDEN16(PX_LOAD(input + w), &col[0], &col[1]);
+
+      for (i = 0; i < 2; i++)
+      {
+         /* Each nibble to the bottom of its byte, then doubled up. */
+         PX_VEC nib = PX_OR(PX_OR(
+                  PX_SLLI32(PX_AND(col[i], mask_r), 4),
+                  PX_AND(col[i], mask_g)), PX_OR(
+                  PX_SRLI32(PX_AND(col[i], mask_b), 4),
+                  PX_SLLI32(PX_AND(col[i], mask_a), 24)));
+         PX_STORE(output + w + i * PX_N32, PX_OR(nib, PX_SLLI32(nib, 4)));
+      }
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_rgba4444_rgb565)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+   const PX_VEC mask_r   = PX_SET16(0xf000);
+   const PX_VEC mask_g   = PX_SET16(0x0f00);
+   const PX_VEC mask_b   = PX_SET16(0x00f0);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      const PX_VEC in = PX_LOAD(input + w);
+      PX_STORE(output + w, PX_OR(PX_AND(in, mask_r), PX_OR(
+                  PX_SRLI16(PX_AND(in, mask_g), 1),
+                  PX_SRLI16(PX_AND(in, mask_b), 3))));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_bgr24_argb8888)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint8_t *input = (const uint8_t*)input_;
+   uint32_t *output     = (uint32_t*)output_;
+   const PX_VEC a       = PX_SET32(0xff000000);
+
+   for (w = 0; w + 2 * PX_N16 <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      PX_LOAD_BGR24(input + 3 * w, col);
+      for (i = 0; i < 4; i++)
+         PX_STORE(output + w + i * PX_N32, PX_OR(col[i], a));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_bgr24_rgb565)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint8_t *input = (const uint8_t*)input_;
+   uint16_t *output     = (uint16_t*)output_;
+
+   for (w = 0; w + 2 * PX_N16 <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      PX_LOAD_BGR24(input + 3 * w, col);
+      PX_STORE(output + w, PX_NARROW32(
+               PX(pixconv_pack_rgb565)(col[0]),
+               PX(pixconv_pack_rgb565)(col[1])));
+      PX_STORE(output + w + PX_N16, PX_NARROW32(
+               PX(pixconv_pack_rgb565)(col[2]),
+               PX(pixconv_pack_rgb565)(col[3])));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_argb8888_0rgb1555)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+   const PX_VEC mask_r   = PX_SET32(0x7c00);
+   const PX_VEC mask_g   = PX_SET32(0x03e0);
+   const PX_VEC mask_b   = PX_SET32(0x001f);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC col[2];
+      int i;
+
+      for (i = 0; i < 2; i++)
+      {
+         PX_VEC in = PX_LOAD(input + w + i * PX_N32);
+         col[i]    = PX_OR(PX_OR(
+                  PX_AND(PX_SRLI32(in, 9), mask_r),
+                  PX_AND(PX_SRLI32(in, 6), mask_g)),
+               PX_AND(PX_SRLI32(in, 3), mask_b));
+      }
+      PX_STORE(output + w, PX_NARROW32(col[0], col[1]));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_argb8888_rgba4444)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+   const PX_VEC mask_r   = PX_SET32(0xf000);
+   const PX_VEC mask_g   = PX_SET32(0x0f00);
+   const PX_VEC mask_b   = PX_SET32(0x00f0);
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+   {
+      PX_VEC col[2];
+      int i;
+
+      for (i = 0; i < 2; i++)
+      {
+         PX_VEC in = PX_LOAD(input + w + i * PX_N32);
+         col[i]    = PX_OR(PX_OR(
+                  PX_AND(PX_SRLI32(in, 8), mask_r),
+                  PX_AND(PX_SRLI32(in, 4), mask_g)), PX_OR(
+                  PX_AND(in, mask_b),
+                  PX_SRLI32(in, 28)));
+      }
+      PX_STORE(output + w, PX_NARROW32(col[0], col[1]));
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_argb8888_rgb565)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint16_t *output      = (uint16_t*)output_;
+
+   for (w = 0; w + PX_N16 <= width; w += PX_N16)
+      PX_STORE(output + w, PX_NARROW32(
+               PX(pixconv_pack_rgb565)(PX_LOAD(input + w)),
+               PX(pixconv_pack_rgb565)(PX_LOAD(input + w + PX_N32))));
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_argb8888_bgr24)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (w = 0; w + 2 * PX_N16 + PX_BGR24_SLACK <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      for (i = 0; i < 4; i++)
+         col[i] = PX_LOAD(input + w + i * PX_N32);
+      PX_STORE_BGR24(output + 3 * w, col);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_abgr8888_bgr24)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+
+   for (w = 0; w + 2 * PX_N16 + PX_BGR24_SLACK <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      for (i = 0; i < 4; i++)
+         col[i] = PX(pixconv_swap_rb)(PX_LOAD(input + w + i * PX_N32));
+      PX_STORE_BGR24(output + 3 * w, col);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_argb8888_abgr8888)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint32_t *input = (const uint32_t*)input_;
+   uint32_t *output      = (uint32_t*)output_;
+
+   for (w = 0; w + PX_N32 <= width; w += PX_N32)
+      PX_STORE(output + w, PX(pixconv_swap_rb)(PX_LOAD(input + w)));
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_0rgb1555_bgr24)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+   const PX_VEC a        = PX_SET16(0x00ff);
+
+   for (w = 0; w + 2 * PX_N16 + PX_BGR24_SLACK <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      for (i = 0; i < 2; i++)
+      {
+         PX_VEC r, g, b;
+         PX(pixconv_split_0rgb1555)(PX_LOAD(input + w + i * PX_N16),
+               &r, &g, &b);
+         PX(pixconv_merge8888)(b, g, r, a, &col[2 * i], &col[2 * i + 1]);
+      }
+      PX_STORE_BGR24(output + 3 * w, col);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_rgb565_bgr24)(void *output_, const void *input_,
+      int width)
+{
+   int w, i;
+   const uint16_t *input = (const uint16_t*)input_;
+   uint8_t *output       = (uint8_t*)output_;
+   const PX_VEC a        = PX_SET16(0x00ff);
+
+   for (w = 0; w + 2 * PX_N16 + PX_BGR24_SLACK <= width; w += 2 * PX_N16)
+   {
+      PX_VEC col[4];
+      for (i = 0; i < 2; i++)
+      {
+         PX_VEC r, g, b;
+         PX(pixconv_split_rgb565)(PX_LOAD(input + w + i * PX_N16),
+               &r, &g, &b);
+         PX(pixconv_merge8888)(b, g, r, a, &col[2 * i], &col[2 * i + 1]);
+      }
+      PX_STORE_BGR24(output + 3 * w, col);
+   }
+
+   return w;
+}
+
+PX_TARGET
+static int PX(conv_yuyv_argb8888)(void *output_, const void *input_,
+      int width)
+{
+   int w;
+   const uint8_t *input        = (const uint8_t*)input_;
+   uint32_t *output            = (uint32_t*)output_;
+   const PX_VEC mask_y         = PX_SET16(0xffu);
+   const PX_VEC mask_u         = PX_SET32(0xffu << 8);
+   const PX_VEC mask_v         = PX_SET32(0xffu << 24);
+   const PX_VEC chroma_offset  = PX_SET16(128);
+   const PX_VEC round_offset   = PX_SET16(YUV_OFFSET);
+   const PX_VEC yuv_mul        = PX_SET16(YUV_MAT_Y);
+   const PX_VEC u_g_mul        = PX_SET16(YUV_MAT_U_G);
+   const PX_VEC u_b_mul        = PX_SET16(YUV_MAT_U_B);
+   const PX_VEC v_r_mul        = PX_SET16(YUV_MAT_V_R);
+   const PX_VEC v_g_mul        = PX_SET16(YUV_MAT_V_G);
+   const PX_VEC a              = PX_SET16(0xffff);
+
+   /* Each loop processes two vectors of YUYV, 2 * PX_N16 pixels.
+    * None of the sums below can leave the 16-bit range, so the
+    * saturating adds give the same bits as the C code. */
+   for (w = 0; w + 2 * PX_N16 <= width; w += 2 * PX_N16)
+   {
+      PX_VEC u, v, u0_g, u1_g, u0_b, u1_b, v0_r, v1_r, v0_g, v1_g,
+             r0, g0, b0, r1, g1, b1;
+      PX_VEC res_lo_bg, res_hi_bg, res_lo_ra, res_hi_ra;
+      PX_VEC res0, res1, res2, res3;
+      const uint8_t *src = input + 2 * w;
+      PX_VEC yuv0        = PX_LOAD(src);           /* [Y0, U0, Y1, V0, Y2, U1, Y3, V1, ...] */
+      PX_VEC yuv1        = PX_LOAD(src + 2 * PX_N16);
+
+      PX_VEC _y0         = PX_AND(yuv0, mask_y);   /* [Y0, Y1, Y2, ...] (16-bit) */
+      PX_VEC u0          = PX_AND(yuv0, mask_u);   /* [0, U0, 0, 0, 0, U1, 0, 0, ...] */
+      PX_VEC v0          = PX_AND(yuv0, mask_v);   /* [0, 0, 0, V0, 0, 0, 0, V1, ...] */
+      PX_VEC _y1         = PX_AND(yuv1, mask_y);
+      PX_VEC u1          = PX_AND(yuv1, mask_u);
+      PX_VEC v1          = PX_AND(yuv1, mask_v);
+
+      /* Juggle around to get U and V in the same 16-bit format as Y.
+       * Within each 128-bit lane, the chroma of yuv0 ends up in the
+       * low half and that of yuv1 in the high half, which the unpacks
+       * below take back apart lane by lane to line up with _y0/_y1. */
+      u0  = PX_BSRLI(u0, 1);
+      v0  = PX_BSRLI(v0, 3);
+      u1  = PX_BSRLI(u1, 1);
+      v1  = PX_BSRLI(v1, 3);
+      u   = PX_PACKS32(u0, u1);
+      v   = PX_PACKS32(v0, v1);
+
+      /* Apply YUV offsets (U, V) -= (-128, -128). */
+      u   = PX_SUB16(u, chroma_offset);
+      v   = PX_SUB16(v, chroma_offset);
+
+      /* Upscale chroma horizontally (nearest). */
+      u0  = PX_UNPACKLO16(u, u);
+      u1  = PX_UNPACKHI16(u, u);
+      v0  = PX_UNPACKLO16(v, v);
+      v1  = PX_UNPACKHI16(v, v);
+
+      /* Apply transformations. */
+      _y0  = PX_MULLO16(_y0, yuv_mul);
+      _y1  = PX_MULLO16(_y1, yuv_mul);
+      u0_g = PX_MULLO16(u0, u_g_mul);
+      u1_g = PX_MULLO16(u1, u_g_mul);
+      u0_b = PX_MULLO16(u0, u_b_mul);
+      u1_b = PX_MULLO16(u1, u_b_mul);
+      v0_r = PX_MULLO16(v0, v_r_mul);
+      v1_r = PX_MULLO16(v1, v_r_mul);
+      v0_g = PX_MULLO16(v0, v_g_mul);
+      v1_g = PX_MULLO16(v1, v_g_mul);
+
+      /* Add contributions from the transformed components. */
+      r0 = PX_SRAI16(PX_ADDS16(PX_ADDS16(_y0, v0_r),
+               round_offset), YUV_SHIFT);
+      g0 = PX_SRAI16(PX_ADDS16(PX_ADDS16(PX_ADDS16(_y0, v0_g), u0_g),
+               round_offset), YUV_SHIFT);
+      b0 = PX_SRAI16(PX_ADDS16(PX_ADDS16(_y0, u0_b),
+               round_offset), YUV_SHIFT);
+
+      r1 = PX_SRAI16(PX_ADDS16(PX_ADDS16(_y1, v1_r),
+               round_offset), YUV_SHIFT);
+      g1 = PX_SRAI16(PX_ADDS16(PX_ADDS16(PX_ADDS16(_y1, v1_g), u1_g),
+               round_offset), YUV_SHIFT);
+      b1 = PX_SRAI16(PX_ADDS16(PX_ADDS16(_y1, u1_b),
+               round_offset), YUV_SHIFT);
+
+      /* Saturate into 8-bit. */
+      r0 = PX_PACKUS16(r0, r1);
+      g0 = PX_PACKUS16(g0, g1);
+      b0 = PX_PACKUS16(b0, b1);
+
+      /* Interleave into ARGB. */
+      res_lo_bg = PX_UNPACKLO8(b0, g0);
+      res_hi_bg = PX_UNPACKHI8(b0, g0);
+      res_lo_ra = PX_UNPACKLO8(r0, a);
+      res_hi_ra = PX_UNPACKHI8(r0, a);
+      res0      = PX_UNPACKLO16(res_lo_bg, res_lo_ra);
+      res1      = PX_UNPACKHI16(res_lo_bg, res_lo_ra);
+      res2      = PX_UNPACKLO16(res_hi_bg, res_hi_ra);
+      res3      = PX_UNPACKHI16(res_hi_bg, res_hi_ra);
+      PX_ORDER32(&res0, &res1);
+      PX_ORDER32(&res2, &res3);
+
+      PX_STORE(output + w,                   res0);
+      PX_STORE(output + w +     PX_N32,      res1);
+      PX_STORE(output + w + 2 * PX_N32,      res2);
+      PX_STORE(output + w + 3 * PX_N32,      res3);
+   }
+
+   return w;
+}
+
+#undef PX_PASTE_
+#undef PX_PASTE
+#undef PX
+#undef PX_VEC
+#undef PX_TARGET
+#undef PX_N16
+#undef PX_N32
+#undef PX_BGR24_SLACK
+#undef PX_LOAD
+#undef PX_STORE
+#undef PX_SET16
+#undef PX_SET32
+#undef PX_AND
+#undef PX_OR
+#undef PX_ADDS16
+#undef PX_SUB16
+#undef PX_MULHI16
+#undef PX_MULLO16
+#undef PX_SLLI16
+#undef PX_SRLI16
+#undef PX_SRAI16
+#undef PX_SLLI32
+#undef PX_SRLI32
+#undef PX_BSLLI
+#undef PX_BSRLI
+#undef PX_UNPACKLO8
+#undef PX_UNPACKHI8
+#undef PX_UNPACKLO16
+#undef PX_UNPACKHI16
+#undef PX_PACKUS16
+#undef PX_PACKS32
+#undef PX_WIDEN16
+#undef PX_NARROW32
+#undef PX_ORDER32
+#undef PX_LOAD_BGR24
+#undef PX_STORE_BGR24
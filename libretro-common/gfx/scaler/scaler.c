@@ -30,6 +30,36 @@
 #include <gfx/scaler/filter.h>
 #include <gfx/scaler/pixconv.h>
 
+#ifdef HAVE_THREADS
+#include <rthreads/tpool.h>
+#endif
+
+/* One band of output rows for scaler_ctx_scale_threaded(). */
+struct scaler_band
+{
+   const struct scaler_ctx *parent;
+
+   /* Copy of the parent, pointed at the band's own intermediate
+    * frame and vertical filter. Refreshed on every call. */
+   struct scaler_ctx ctx;
+   uint64_t *scaled_frame;
+   int *filter_pos;        /* Relative to src_first. */
+
+   int first;              /* Output rows of the band. */
+   int rows;
+   int src_first;          /* Source rows its vertical filter reads. */
+   int src_rows;
+   int in_first;           /* Source rows it converts to ARGB8888. */
+   int in_rows;
+
+   const void *input;
+   void *output;
+   const void *input_frame;
+   void *output_frame;
+   int input_stride;
+   int output_stride;
+};
+
 static bool allocate_frames(struct scaler_ctx *ctx)
 {
    uint64_t *scaled_frame = NULL;
@@ -269,8 +299,84 @@ bool scaler_ctx_gen_filter(struct scaler_ctx *ctx)
    return true;
 }
 
+static void scaler_bands_free(struct scaler_ctx *ctx)
+{
+   int i;
+
+   if (!ctx->bands)
+      return;
+
+   for (i = 0; i < ctx->num_bands; i++)
+   {
+      free(ctx->bands[i].scaled_frame);
+      free(ctx->bands[i].filter_pos);
+   }
+
+   free(ctx->bands);
+   ctx->bands     = NULL;
+   ctx->num_bands = 0;
+}
+
+static bool scaler_bands_init(struct scaler_ctx *ctx, int num_bands)
+{
+   int i, h;
+
+   scaler_bands_free(ctx);
+
+   if (!(ctx->bands = (struct scaler_band*)
+            calloc(num_bands, sizeof(*ctx->bands))))
+      return false;
+   ctx->num_bands = num_bands;
+
+   for (i = 0; i < num_bands; i++)
+   {
+      struct scaler_band *band = &ctx->bands[i];
+      int src_last             = 0;
+
+      band->parent    = ctx;
+      band->first     = ctx->out_height * i / num_bands;
+      band->rows      = ctx->out_height * (i + 1) / num_bands - band->first;
+      band->in_first  = ctx->in_height  * i / num_bands;
+      band->in_rows   = ctx->in_height  * (i + 1) / num_bands - band->in_first;
+
+      /* Only the generic filter path needs an intermediate frame. */
+      if (ctx->unscaled || ctx->scaler_special)
+         continue;
+
+      band->src_first = ctx->in_height;
+      for (h = band->first; h < band->first + band->rows; h++)
+      {
+         int pos = ctx->vert.filter_pos[h];
+         if (pos < band->src_first)
+            band->src_first = pos;
+         if (pos + ctx->vert.filter_len > src_last)
+            src_last = pos + ctx->vert.filter_len;
+      }
+      band->src_rows  = src_last - band->src_first;
+
+      band->filter_pos   = (int*)malloc(band->rows * sizeof(int));
+      band->scaled_frame = (uint64_t*)calloc(
+            (ctx->scaled.stride * band->src_rows) >> 3,
+            sizeof(uint64_t));
+
+      if (!band->filter_pos || !band->scaled_frame)
+      {
+         scaler_bands_free(ctx);
+         return false;
+      }
+
+      for (h = 0; h < band->rows; h++)
+         band->filter_pos[h] = ctx->vert.filter_pos[band->first + h]
+            - band->src_first;
+   }
+
+   return true;
+}
+
 void scaler_ctx_gen_reset(struct scaler_ctx *ctx)
 {
+   scaler_bands_free(ctx);
+
    if (ctx->horiz.filter)
       free(ctx->horiz.filter);
    if (ctx->horiz.filter_pos)
@@ -352,7 +458,7 @@ void scaler_ctx_scale(struct scaler_ctx *ctx,
       if (ctx->scaler_horiz)
          ctx->scaler_horiz(ctx, input_frame, input_stride);
       if (ctx->scaler_vert)
-         ctx->scaler_vert (ctx, output, output_stride);
+         ctx->scaler_vert (ctx, output_frame, output_stride);
    }
 
    if (ctx->out_fmt != SCALER_FMT_ARGB8888)
@@ -360,3 +466,147 @@ void scaler_ctx_scale(struct scaler_ctx *ctx,
             ctx->out_width, ctx->out_height,
             ctx->out_stride, ctx->output.stride);
 }
+
+/* First round of jobs: pixel conversion of the band's share of
+ * the input, which is all there is to do when unscaled. */
+static void scaler_band_convert(void *data)
+{
+   struct scaler_band *band     = (struct scaler_band*)data;
+   const struct scaler_ctx *ctx = band->parent;
+
+   if (ctx->unscaled)
+      ctx->direct_pixconv(
+            (uint8_t*)band->output + band->first * ctx->out_stride,
+            (const uint8_t*)band->input + band->first * ctx->in_stride,
+            ctx->out_width, band->rows,
+            ctx->out_stride, ctx->in_stride);
+   else
+      ctx->in_pixconv(
+            (uint8_t*)ctx->input.frame + band->in_first * ctx->input.stride,
+            (const uint8_t*)band->input + band->in_first * ctx->in_stride,
+            ctx->in_width, band->in_rows,
+            ctx->input.stride, ctx->in_stride);
+}
+
+static void scaler_band_scale(void *data)
+{
+   struct scaler_band *band     = (struct scaler_band*)data;
+   const struct scaler_ctx *ctx = band->parent;
+   uint8_t *output_frame        = (uint8_t*)band->output_frame
+      + band->first * band->output_stride;
+
+   if (ctx->scaler_special)
+      scaler_argb8888_point_rows(output_frame, band->input_frame,
+            ctx->out_width, ctx->out_height,
+            ctx->in_width, ctx->in_height,
+            band->output_stride, band->input_stride,
+            band->first, band->rows);
+   else
+   {
+      struct scaler_ctx *bctx = &band->ctx;
+
+      *bctx                   = *ctx;
+      bctx->scaled.frame      = band->scaled_frame;
+      bctx->scaled.height     = band->src_rows;
+      bctx->vert.filter       = ctx->vert.filter
+         + band->first * ctx->vert.filter_stride;
+      bctx->vert.filter_pos   = band->filter_pos;
+      bctx->out_height        = band->rows;
+
+      bctx->scaler_horiz(bctx, (const uint8_t*)band->input_frame
+            + band->src_first * band->input_stride, band->input_stride);
+      bctx->scaler_vert(bctx, output_frame, band->output_stride);
+   }
+
+   if (ctx->out_fmt != SCALER_FMT_ARGB8888)
+      ctx->out_pixconv(
+            (uint8_t*)band->output + band->first * ctx->out_stride,
+            (const uint8_t*)ctx->output.frame
+            + band->first * ctx->output.stride,
+            ctx->out_width, band->rows,
+            ctx->out_stride, ctx->output.stride);
+}
+
+/* Runs all but the last band on the pool and the last one here,
+ * then waits for the rest. */
+static void scaler_bands_run(struct scaler_ctx *ctx,
+      struct tpool *pool, void (*func)(void*))
+{
+   int i;
+
+   for (i = 0; i < ctx->num_bands - 1; i++)
+   {
+#ifdef HAVE_THREADS
+      if (pool && tpool_add_work(pool, func, &ctx->bands[i]))
+         continue;
+#endif
+      func(&ctx->bands[i]);
+   }
+
+   func(&ctx->bands[ctx->num_bands - 1]);
+
+#ifdef HAVE_THREADS
+   if (pool)
+      tpool_wait(pool);
+#endif
+}
+
+void scaler_ctx_scale_threaded(struct scaler_ctx *ctx,
+      void *output, const void *input,
+      struct tpool *pool, unsigned num_bands)
+{
+   int i;
+   const void *input_frame = input;
+   void *output_frame      = output;
+   int input_stride        = ctx->in_stride;
+   int output_stride       = ctx->out_stride;
+
+   if (num_bands > (unsigned)ctx->out_height)
+      num_bands = ctx->out_height;
+
+   /* Bands can only be told apart on the paths known here. */
+   if (     num_bands < 2
+         || (ctx->unscaled && !ctx->direct_pixconv)
+         || (ctx->scaler_special
+            && ctx->scaler_special != scaler_argb8888_point_special)
+         || (     ctx->num_bands != (int)num_bands
+               && !scaler_bands_init(ctx, num_bands)))
+   {
+      if (ctx->unscaled && ctx->direct_pixconv)
+         ctx->direct_pixconv(output, input,
+               ctx->out_width,  ctx->out_height,
+               ctx->out_stride, ctx->in_stride);
+      else
+         scaler_ctx_scale(ctx, output, input);
+      return;
+   }
+
+   if (ctx->in_fmt != SCALER_FMT_ARGB8888)
+   {
+      input_frame   = ctx->input.frame;
+      input_stride  = ctx->input.stride;
+   }
+
+   if (ctx->out_fmt != SCALER_FMT_ARGB8888)
+   {
+      output_frame  = ctx->output.frame;
+      output_stride = ctx->output.stride;
+   }
+
+   for (i = 0; i < ctx->num_bands; i++)
+   {
+      struct scaler_band *band = &ctx->bands[i];
+      band->input              = input;
+      band->output             = output;
+      band->input_frame        = input_frame;
+      band->output_frame       = output_frame;
+      band->input_stride       = input_stride;
+      band->output_stride      = output_stride;
+   }
+
+   if (ctx->unscaled || ctx->in_fmt != SCALER_FMT_ARGB8888)
+      scaler_bands_run(ctx, pool, scaler_band_convert);
+
+   if (!ctx->unscaled)
+      scaler_bands_run(ctx, pool, scaler_band_scale);
+}
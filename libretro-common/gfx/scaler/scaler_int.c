@@ -236,6 +236,17 @@ void scaler_argb8888_point_special(const struct scaler_ctx *ctx,
       int out_width, int out_height,
       int in_width, int in_height,
       int out_stride, int in_stride)
+{
+   scaler_argb8888_point_rows(output_, input_,
+         out_width, out_height, in_width, in_height,
+         out_stride, in_stride, 0, out_height);
+}
+
+void scaler_argb8888_point_rows(void *output_, const void *input_,
+      int out_width, int out_height,
+      int in_width, int in_height,
+      int out_stride, int in_stride,
+      int first_row, int num_rows)
 {
    int h, w;
    int x_pos             = (1 << 15) * in_width / out_width - (1 << 15);
@@ -250,7 +261,9 @@ void scaler_argb8888_point_special(const struct scaler_ctx *ctx,
    if (y_pos < 0)
       y_pos = 0;
 
-   for (h = 0; h < out_height; h++, y_pos += y_step, output += out_stride >> 2)
+   y_pos += first_row * y_step;
+
+   for (h = 0; h < num_rows; h++, y_pos += y_step, output += out_stride >> 2)
    {
       int               x = x_pos;
       const uint32_t *inp = input + (y_pos >> 16) * (in_stride >> 2);
@@ -33,6 +33,7 @@
 #include <unistd.h>
 #endif
 
+#include <boolean.h>
 #include <formats/rwav.h>
 #include <audio/audio_resampler.h>
 
@@ -55,17 +56,96 @@ typedef struct
    bool resample;
 } audio_chunk_t;
 
-#if defined(__SSE2__)
-#define audio_mix_volume           audio_mix_volume_SSE2
+enum audio_mix_impl
+{
+   AUDIO_MIX_IMPL_C = 0,
+   AUDIO_MIX_IMPL_SSE2,
+   AUDIO_MIX_IMPL_AVX2,
+   AUDIO_MIX_IMPL_LAST
+};
 
+#if defined(__SSE2__)
 void audio_mix_volume_SSE2(float *out,
       const float *in, float vol, size_t samples);
-#else
-#define audio_mix_volume           audio_mix_volume_C
 #endif
 
 void audio_mix_volume_C(float *dst, const float *src, float vol, size_t samples);
 
+/**
+ * audio_mix_volume:
+ * @dst                  : samples to mix into.
+ * @src                  : samples to add.
+ * @vol                  : gain applied to @src.
+ * @samples              : number of samples (not frames).
+ *
+ * Adds @src times @vol to @dst, with the kernels picked
+ * by audio_mix_init_simd().
+ **/
+void audio_mix_volume(float *dst, const float *src, float vol, size_t samples);
+
+/**
+ * audio_mix_volume_batch:
+ * @dst                  : samples to mix into.
+ * @src                  : @count buffers of @samples samples each.
+ * @vol                  : @count gains, one for each of @src.
+ * @count                : number of buffers to mix.
+ * @samples              : number of samples (not frames).
+ *
+ * Same as calling audio_mix_volume() for each of @src in
+ * turn, down to the rounding, but @dst is only loaded and
+ * stored once.
+ **/
+void audio_mix_volume_batch(float *dst, const float * const *src,
+      const float *vol, unsigned count, size_t samples);
+
+/**
+ * audio_mix_clamp:
+ * @buf                  : samples to clamp.
+ * @samples              : number of samples (not frames).
+ *
+ * Clamps @buf to [-1.0, 1.0].
+ **/
+void audio_mix_clamp(float *buf, size_t samples);
+
+/**
+ * audio_mix_s16_to_float_stereo:
+ * @dst                  : 2 * @frames float samples.
+ * @src                  : @frames * @channels s16 samples.
+ * @frames               : number of frames.
+ * @channels             : 1 or 2; mono is copied to both channels.
+ *
+ * Converts a whole s16 sound to the mixer's stereo float,
+ * mapping -32768 to -1.0 and 32767 to 1.0.
+ **/
+void audio_mix_s16_to_float_stereo(float *dst, const int16_t *src,
+      size_t frames, unsigned channels);
+
+/**
+ * audio_mix_init_simd:
+ *
+ * Selects the widest kernels supported by both the build
+ * and the host CPU (see cpu_features_get()).  Until it is
+ * called the C kernels are used.  Safe to call more than once.
+ **/
+void audio_mix_init_simd(void);
+
+/**
+ * audio_mix_set_impl:
+ * @impl                 : kernel set to use.
+ *
+ * Forces a specific kernel set. Mostly useful for
+ * benchmarking and testing.
+ *
+ * Returns: false if @impl was not compiled in or is
+ * not supported by the host CPU, in which case the
+ * current selection is left untouched.
+ **/
+bool audio_mix_set_impl(enum audio_mix_impl impl);
+
+enum audio_mix_impl audio_mix_get_impl(void);
+
+const char *audio_mix_impl_name(enum audio_mix_impl impl);
+
 void audio_mix_free_chunk(audio_chunk_t *chunk);
 
 audio_chunk_t* audio_mix_load_wav_file(const char *path, int sample_rate,
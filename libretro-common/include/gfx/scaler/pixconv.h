@@ -24,11 +24,25 @@
 #define __LIBRETRO_SDK_SCALER_PIXCONV_H__
 
 #include <clamping.h>
+#include <boolean.h>
 
 #include <retro_common_api.h>
 
 RETRO_BEGIN_DECLS
 
+enum pixconv_impl
+{
+   PIXCONV_IMPL_C = 0,
+   PIXCONV_IMPL_SSE2,
+   PIXCONV_IMPL_AVX2,
+   PIXCONV_IMPL_NEON,
+   PIXCONV_IMPL_LAST
+};
+
+/* All conversions take strides in bytes, which may be negative
+ * to flip the image.  Whichever kernel set is selected, they
+ * produce the same output as the C kernels. */
+
 void conv_0rgb1555_argb8888(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride);
@@ -105,6 +119,34 @@ void conv_copy(void *output, const void *input,
       int width, int height,
       int out_stride, int in_stride);
 
+/**
+ * pixconv_set_impl:
+ * @impl                 : kernel set to use.
+ *
+ * Forces a specific kernel set for all conversions. Mostly
+ * useful for benchmarking and testing.
+ *
+ * Returns: false if @impl was not compiled in or is
+ * not supported by the host CPU, in which case the
+ * current selection is left untouched.
+ **/
+bool pixconv_set_impl(enum pixconv_impl impl);
+
+enum pixconv_impl pixconv_get_impl(void);
+
+const char *pixconv_impl_name(enum pixconv_impl impl);
+
+/**
+ * pixconv_init_simd:
+ *
+ * Selects the widest kernels supported by both the build
+ * and the host CPU (see cpu_features_get()).  Until it is
+ * called, the kernels the build targets anyway are used
+ * (SSE2 on x86_64, NEON when built for it, otherwise C).
+ * Safe to call more than once.
+ **/
+void pixconv_init_simd(void);
+
 RETRO_END_DECLS
 
 #endif
@@ -59,6 +59,9 @@ struct scaler_filter
    int      filter_stride;
 };
 
+struct tpool;
+struct scaler_band;
+
 struct scaler_ctx
 {
    void (*scaler_horiz)(const struct scaler_ctx*,
@@ -73,6 +76,9 @@ struct scaler_ctx
    void (*direct_pixconv)(void*, const void*, int, int, int, int);
    struct scaler_filter horiz, vert;   /* ptr alignment */
 
+   /* Per-band state for scaler_ctx_scale_threaded(). */
+   struct scaler_band *bands;
+
    struct
    {
       uint32_t *frame;
@@ -101,6 +107,8 @@ struct scaler_ctx
    int out_height;
    int out_stride;
 
+   int num_bands;
+
    enum scaler_pix_fmt in_fmt;
    enum scaler_pix_fmt out_fmt;
    enum scaler_type scaler_type;
@@ -123,6 +131,34 @@ void scaler_ctx_gen_reset(struct scaler_ctx *ctx);
 void scaler_ctx_scale(struct scaler_ctx *ctx,
       void *output, const void *input);
 
+/**
+ * scaler_ctx_scale_threaded:
+ * @ctx          : pointer to scaler context object.
+ * @output       : pointer to output image.
+ * @input        : pointer to input image.
+ * @pool         : thread pool to run the bands on, or NULL.
+ * @num_bands    : number of horizontal bands to split the output into.
+ *
+ * Same as scaler_ctx_scale(), with the same output, but the image is
+ * cut into @num_bands bands of output rows which are scaled as separate
+ * jobs on @pool. Each band keeps its own intermediate frame and
+ * vertical filter, holding the source rows its filter taps reach, so
+ * that bands never share a buffer; a few source rows where bands meet
+ * get filtered twice.
+ *
+ * Pixel conversion of the input runs as a first round of jobs, as the
+ * bands read overlapping source rows.
+ *
+ * The band state is made on first use and kept in @ctx until
+ * scaler_ctx_gen_reset() or a different @num_bands. tpool_wait() is
+ * used to wait for the bands, so @pool should not be shared with
+ * unrelated work. Without HAVE_THREADS, or if @pool is NULL, the
+ * bands run one after the other on the calling thread.
+ **/
+void scaler_ctx_scale_threaded(struct scaler_ctx *ctx,
+      void *output, const void *input,
+      struct tpool *pool, unsigned num_bands);
+
 RETRO_END_DECLS
 
 #endif
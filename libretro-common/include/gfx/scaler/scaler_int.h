@@ -41,6 +41,14 @@ void scaler_argb8888_point_special(const struct scaler_ctx *ctx,
       int in_width, int in_height,
       int out_stride, int in_stride);
 
+/* Point scales output rows first_row to first_row + num_rows - 1 only,
+ * into output, which points at first_row. */
+void scaler_argb8888_point_rows(void *output, const void *input,
+      int out_width, int out_height,
+      int in_width, int in_height,
+      int out_stride, int in_stride,
+      int first_row, int num_rows);
+
 RETRO_END_DECLS
 
 #endif
@@ -0,0 +1,221 @@
+/* Benchmark and consistency check for scaler_ctx_scale_threaded() in
+ * libretro-common/gfx/scaler/scaler.c.
+ *
+ *   scaler_bench [seconds] [max threads]
+ *
+ * A few scales of the sort the frontend does (4K recordings brought
+ * down to 1080p, 1080p frames made into thumbnails, a small core
+ * frame blown up for recording) are run for each filter type with
+ * scaler_ctx_scale(), then with scaler_ctx_scale_threaded() on a pool
+ * of 1 up to 'max threads' (4 by default) threads, with as many bands
+ * as threads.  Every threaded output has to be byte for byte the same
+ * as the plain one, padding included.
+ *
+ * Milliseconds per frame are printed for each thread count, 'seconds'
+ * (0.05 by default) per scale and count.
+ *
+ * Exit status is non-zero if an output differs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <boolean.h>
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <rthreads/tpool.h>
+#include <gfx/scaler/scaler.h>
+
+/* Keeps every row aligned for 16-bit and 32-bit pixels. */
+#define PAD 12
+
+struct scale
+{
+   const char *name;
+   int in_width;
+   int in_height;
+   enum scaler_pix_fmt in_fmt;
+   unsigned in_bpp;
+   int out_width;
+   int out_height;
+   enum scaler_pix_fmt out_fmt;
+   unsigned out_bpp;
+};
+
+static const struct scale scales[] = {
+   { "2160p to 1080p",     3840, 2160, SCALER_FMT_ARGB8888, 4,
+                           1920, 1080, SCALER_FMT_BGR24,    3 },
+   { "1080p to thumbnail", 1920, 1080, SCALER_FMT_RGB565,   2,
+                            320,  180, SCALER_FMT_ARGB8888, 4 },
+   { "240p to 2160p",       320,  240, SCALER_FMT_RGB565,   2,
+                           3840, 2160, SCALER_FMT_BGR24,    3 },
+   { "1080p to 1080p",     1920, 1080, SCALER_FMT_RGB565,   2,
+                           1920, 1080, SCALER_FMT_ARGB8888, 4 }
+};
+
+static const struct
+{
+   const char *name;
+   enum scaler_type type;
+} types[] = {
+   { "point",    SCALER_TYPE_POINT    },
+   { "bilinear", SCALER_TYPE_BILINEAR },
+   { "sinc",     SCALER_TYPE_SINC     }
+};
+
+static const unsigned thread_counts[] = { 1, 2, 3, 4, 6, 8, 12, 16 };
+
+static uint32_t seed = 0x12345678;
+
+static uint8_t rand_u8(void)
+{
+   seed = seed * 1664525u + 1013904223u;
+   return (uint8_t)(seed >> 24);
+}
+
+static void scale_frame(struct scaler_ctx *ctx, void *out, const void *in,
+      tpool_t *pool, unsigned threads)
+{
+   if (pool)
+      scaler_ctx_scale_threaded(ctx, out, in, pool, threads);
+   else if (ctx->unscaled)
+      ctx->direct_pixconv(out, in, ctx->out_width, ctx->out_height,
+            ctx->out_stride, ctx->in_stride);
+   else
+      scaler_ctx_scale(ctx, out, in);
+}
+
+/* Milliseconds per frame, with 'pool' NULL for scaler_ctx_scale(). */
+static double bench(struct scaler_ctx *ctx, void *out, const void *in,
+      tpool_t *pool, unsigned threads, float seconds)
+{
+   unsigned frames = 0;
+   retro_time_t start, elapsed;
+
+   start = cpu_features_get_time_usec();
+   do
+   {
+      scale_frame(ctx, out, in, pool, threads);
+      frames++;
+      elapsed = cpu_features_get_time_usec() - start;
+   } while (elapsed < (retro_time_t)(seconds * 1000000.0f));
+
+   return (double)elapsed / frames / 1000.0;
+}
+
+static unsigned run(const struct scale *scale, enum scaler_type type,
+      const char *type_name, float seconds, unsigned max_threads)
+{
+   unsigned i;
+   size_t j, in_size, out_size;
+   uint8_t *in, *ref, *out;
+   struct scaler_ctx ctx;
+   unsigned fails = 0;
+
+   memset(&ctx, 0, sizeof(ctx));
+   ctx.in_width    = scale->in_width;
+   ctx.in_height   = scale->in_height;
+   ctx.in_stride   = scale->in_width  * scale->in_bpp  + PAD;
+   ctx.in_fmt      = scale->in_fmt;
+   ctx.out_width   = scale->out_width;
+   ctx.out_height  = scale->out_height;
+   ctx.out_stride  = scale->out_width * scale->out_bpp + PAD;
+   ctx.out_fmt     = scale->out_fmt;
+   ctx.scaler_type = type;
+
+   if (!scaler_ctx_gen_filter(&ctx))
+   {
+      printf("  %s %s: no filter\n", scale->name, type_name);
+      scaler_ctx_gen_reset(&ctx);
+      return 1;
+   }
+
+   in_size  = (size_t)ctx.in_stride  * ctx.in_height;
+   out_size = (size_t)ctx.out_stride * ctx.out_height;
+   in       = (uint8_t*)malloc(in_size);
+   ref      = (uint8_t*)malloc(out_size);
+   out      = (uint8_t*)malloc(out_size);
+
+   for (j = 0; j < in_size; j++)
+      in[j] = rand_u8();
+
+   memset(ref, 0xa5, out_size);
+   scale_frame(&ctx, ref, in, NULL, 1);
+
+   printf("%-20s %-8s %8.2f", scale->name, type_name,
+         bench(&ctx, out, in, NULL, 1, seconds));
+
+   for (i = 0; i < ARRAY_SIZE(thread_counts)
+         && thread_counts[i] <= max_threads; i++)
+   {
+      /* The caller scales a band itself. */
+      tpool_t *pool = tpool_create(thread_counts[i] > 1
+            ? thread_counts[i] - 1 : 1);
+
+      memset(out, 0xa5, out_size);
+      scale_frame(&ctx, out, in, pool, thread_counts[i]);
+      if (memcmp(out, ref, out_size))
+      {
+         printf(" MISMATCH");
+         fails++;
+      }
+      else
+         printf(" %8.2f", bench(&ctx, out, in, pool, thread_counts[i],
+                  seconds));
+
+      tpool_destroy(pool);
+   }
+   printf("\n");
+
+   scaler_ctx_gen_reset(&ctx);
+   free(out);
+   free(ref);
+   free(in);
+   return fails;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i, j;
+   unsigned failures    = 0;
+   unsigned max_threads = 4;
+   float seconds        = 0.05f;
+
+   if (argc > 1)
+      seconds = (float)atof(argv[1]);
+   if (argc > 2)
+      max_threads = (unsigned)atoi(argv[2]);
+   if (!max_threads)
+      max_threads = 1;
+
+   printf("%u cores, ms per frame\n%-20s %-8s %8s",
+         cpu_features_get_core_amount(), "scale", "filter", "plain");
+   for (i = 0; i < ARRAY_SIZE(thread_counts)
+         && thread_counts[i] <= max_threads; i++)
+      printf(" %7ut", thread_counts[i]);
+   printf("\n");
+
+   for (i = 0; i < ARRAY_SIZE(scales); i++)
+   {
+      for (j = 0; j < ARRAY_SIZE(types); j++)
+      {
+         failures += run(&scales[i], types[j].type, types[j].name,
+               seconds, max_threads);
+
+         /* Same size is a plain conversion, whatever the filter. */
+         if (     scales[i].in_width  == scales[i].out_width
+               && scales[i].in_height == scales[i].out_height)
+            break;
+      }
+   }
+
+   if (failures)
+   {
+      printf("%u FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,242 @@
+/* Copyright  (C) 2021 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (test_pixconv.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <check.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+#include <gfx/scaler/pixconv.h>
+
+#define SUITE_NAME "pixconv"
+
+#define GUARD 32
+#define PAD   12
+#define ROWS  3
+
+typedef void (*conv_t)(void *output, const void *input,
+      int width, int height, int out_stride, int in_stride);
+
+struct conversion
+{
+   conv_t conv;
+   unsigned in_bpp;
+   unsigned out_bpp;
+};
+
+static const struct conversion conversions[] = {
+   { conv_rgb565_0rgb1555,   2, 2 },
+   { conv_0rgb1555_rgb565,   2, 2 },
+   { conv_0rgb1555_argb8888, 2, 4 },
+   { conv_rgb565_argb8888,   2, 4 },
+   { conv_rgb565_abgr8888,   2, 4 },
+   { conv_rgba4444_argb8888, 2, 4 },
+   { conv_rgba4444_rgb565,   2, 2 },
+   { conv_bgr24_argb8888,    3, 4 },
+   { conv_bgr24_rgb565,      3, 2 },
+   { conv_argb8888_0rgb1555, 4, 2 },
+   { conv_argb8888_rgba4444, 4, 2 },
+   { conv_argb8888_rgb565,   4, 2 },
+   { conv_argb8888_bgr24,    4, 3 },
+   { conv_abgr8888_bgr24,    4, 3 },
+   { conv_argb8888_abgr8888, 4, 4 },
+   { conv_0rgb1555_bgr24,    2, 3 },
+   { conv_rgb565_bgr24,      2, 3 },
+   { conv_yuyv_argb8888,     2, 4 }
+};
+
+static uint16_t in16[0x10000];
+static uint32_t out32[0x10000];
+static uint16_t out16[0x10000];
+
+/* Converts ROWS rows of 'width' pixels with padded strides into a
+ * buffer with GUARD bytes of 0xa5 around it. */
+static uint8_t *convert(const struct conversion *c, const uint8_t *in,
+      int width, size_t *size)
+{
+   int in_stride  = width * c->in_bpp + PAD;
+   int out_stride = width * c->out_bpp + PAD;
+   uint8_t *out;
+
+   *size = (size_t)out_stride * ROWS + 2 * GUARD;
+   out   = (uint8_t*)malloc(*size);
+   memset(out, 0xa5, *size);
+   c->conv(out + GUARD, in, width, ROWS, out_stride, in_stride);
+   return out;
+}
+
+START_TEST (test_pixconv_impls_match_c)
+{
+   unsigned i, impl;
+   int width;
+   uint32_t seed = 0x12345678;
+
+   for (impl = PIXCONV_IMPL_C + 1; impl < PIXCONV_IMPL_LAST; impl++)
+   {
+      if (!pixconv_set_impl((enum pixconv_impl)impl))
+         continue;
+
+      for (i = 0; i < ARRAY_SIZE(conversions); i++)
+      {
+         for (width = 0; width < 80; width++)
+         {
+            size_t j, ref_size, out_size;
+            uint8_t *ref, *out;
+            size_t in_size = (size_t)(width * conversions[i].in_bpp + PAD)
+               * ROWS;
+            uint8_t *in    = (uint8_t*)malloc(in_size);
+
+            for (j = 0; j < in_size; j++)
+            {
+               seed  = seed * 1664525u + 1013904223u;
+               in[j] = (uint8_t)(seed >> 24);
+            }
+
+            pixconv_set_impl(PIXCONV_IMPL_C);
+            ref = convert(&conversions[i], in, width, &ref_size);
+            pixconv_set_impl((enum pixconv_impl)impl);
+            out = convert(&conversions[i], in, width, &out_size);
+
+            ck_assert_msg(!memcmp(out, ref, ref_size),
+                  "%s: conversion %u differs from C at width %d",
+                  pixconv_impl_name((enum pixconv_impl)impl), i, width);
+
+            free(out);
+            free(ref);
+            free(in);
+         }
+      }
+   }
+
+   pixconv_init_simd();
+}
+END_TEST
+
+START_TEST (test_pixconv_known_values)
+{
+   unsigned impl;
+   static const uint16_t rgb565[4]   = { 0xffff, 0xf800, 0x07e0, 0x001f };
+   static const uint32_t argb[4]     = { 0x80ff4020, 0x00000000, 0xffffffff, 0x12345678 };
+   static const uint8_t  bgr24[2][6] = {
+      { 0x10, 0x20, 0x30, 0xff, 0x00, 0x80 },
+      { 0x08, 0x04, 0xf8, 0x00, 0xff, 0x00 }
+   };
+
+   for (impl = PIXCONV_IMPL_C; impl < PIXCONV_IMPL_LAST; impl++)
+   {
+      uint32_t o32[4];
+      uint16_t o16[4];
+      uint8_t  o24[12];
+
+      if (!pixconv_set_impl((enum pixconv_impl)impl))
+         continue;
+
+      conv_rgb565_argb8888(o32, rgb565, 4, 1, sizeof(o32), sizeof(rgb565));
+      ck_assert_uint_eq(o32[0], 0xffffffff);
+      ck_assert_uint_eq(o32[1], 0xffff0000);
+      ck_assert_uint_eq(o32[2], 0xff00ff00);
+      ck_assert_uint_eq(o32[3], 0xff0000ff);
+
+      conv_argb8888_rgba4444(o16, argb, 4, 1, sizeof(o16), sizeof(argb));
+      ck_assert_uint_eq(o16[0], 0xf428);
+      ck_assert_uint_eq(o16[1], 0x0000);
+      ck_assert_uint_eq(o16[2], 0xffff);
+      ck_assert_uint_eq(o16[3], 0x3571);
+
+      conv_argb8888_rgb565(o16, argb, 4, 1, sizeof(o16), sizeof(argb));
+      ck_assert_uint_eq(o16[0], 0xfa04);
+      ck_assert_uint_eq(o16[2], 0xffff);
+
+      conv_argb8888_bgr24(o24, argb, 4, 1, sizeof(o24), sizeof(argb));
+      ck_assert_uint_eq(o24[0], 0x20);
+      ck_assert_uint_eq(o24[1], 0x40);
+      ck_assert_uint_eq(o24[2], 0xff);
+
+      /* Two rows of two pixels, with byte strides. */
+      conv_bgr24_rgb565(o16, bgr24, 2, 2, 2 * sizeof(uint16_t), 6);
+      ck_assert_uint_eq(o16[0], 0x3102);
+      ck_assert_uint_eq(o16[1], 0x801f);
+      ck_assert_uint_eq(o16[2], 0xf821);
+      ck_assert_uint_eq(o16[3], 0x07e0);
+   }
+
+   pixconv_init_simd();
+}
+END_TEST
+
+START_TEST (test_pixconv_round_trips)
+{
+   unsigned impl, i;
+
+   for (i = 0; i < 0x10000; i++)
+      in16[i] = (uint16_t)i;
+
+   for (impl = PIXCONV_IMPL_C; impl < PIXCONV_IMPL_LAST; impl++)
+   {
+      if (!pixconv_set_impl((enum pixconv_impl)impl))
+         continue;
+
+      /* Every 16-bit pixel survives a trip through 32 bits. */
+      conv_rgba4444_argb8888(out32, in16, 0x10000, 1, 0, 0);
+      conv_argb8888_rgba4444(out16, out32, 0x10000, 1, 0, 0);
+      ck_assert(!memcmp(out16, in16, sizeof(in16)));
+
+      conv_rgb565_argb8888(out32, in16, 0x10000, 1, 0, 0);
+      conv_argb8888_rgb565(out16, out32, 0x10000, 1, 0, 0);
+      ck_assert(!memcmp(out16, in16, sizeof(in16)));
+
+      conv_0rgb1555_argb8888(out32, in16, 0x10000, 1, 0, 0);
+      conv_argb8888_0rgb1555(out16, out32, 0x10000, 1, 0, 0);
+      for (i = 0; i < 0x10000; i++)
+         ck_assert_uint_eq(out16[i], i & 0x7fff);
+   }
+
+   pixconv_init_simd();
+}
+END_TEST
+
+Suite *create_suite(void)
+{
+   Suite *s = suite_create(SUITE_NAME);
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_pixconv_impls_match_c);
+   tcase_add_test(tc_core, test_pixconv_known_values);
+   tcase_add_test(tc_core, test_pixconv_round_trips);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
+
+int main(void)
+{
+   int num_fail;
+   Suite *s = create_suite();
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+   num_fail = srunner_ntests_failed(sr);
+   srunner_free(sr);
+   return (num_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,228 @@
+/* Copyright  (C) 2021 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (test_scaler.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <check.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <retro_miscellaneous.h>
+#include <rthreads/tpool.h>
+#include <gfx/scaler/scaler.h>
+
+#define SUITE_NAME "scaler"
+
+#define PAD 8
+
+struct size
+{
+   int in_width;
+   int in_height;
+   int out_width;
+   int out_height;
+};
+
+/* Down, up, mixed and same size, with odd sizes throughout. */
+static const struct size sizes[] = {
+   { 97, 61, 31, 17 },
+   { 31, 17, 97, 61 },
+   { 64, 40, 13, 57 },
+   { 45, 33, 45, 33 }
+};
+
+static const enum scaler_type types[] = {
+   SCALER_TYPE_POINT,
+   SCALER_TYPE_BILINEAR,
+   SCALER_TYPE_SINC
+};
+
+static const unsigned band_counts[] = { 1, 2, 3, 7, 64 };
+
+static unsigned bpp(enum scaler_pix_fmt fmt)
+{
+   switch (fmt)
+   {
+      case SCALER_FMT_BGR24:
+         return 3;
+      case SCALER_FMT_ARGB8888:
+      case SCALER_FMT_ABGR8888:
+         return 4;
+      default:
+         break;
+   }
+   return 2;
+}
+
+static void setup(struct scaler_ctx *ctx, const struct size *size,
+      enum scaler_type type,
+      enum scaler_pix_fmt in_fmt, enum scaler_pix_fmt out_fmt)
+{
+   memset(ctx, 0, sizeof(*ctx));
+   ctx->in_width    = size->in_width;
+   ctx->in_height   = size->in_height;
+   ctx->in_stride   = size->in_width  * bpp(in_fmt)  + PAD;
+   ctx->out_width   = size->out_width;
+   ctx->out_height  = size->out_height;
+   ctx->out_stride  = size->out_width * bpp(out_fmt) + PAD;
+   ctx->in_fmt      = in_fmt;
+   ctx->out_fmt     = out_fmt;
+   ctx->scaler_type = type;
+   ck_assert(scaler_ctx_gen_filter(ctx));
+}
+
+/* Scales the same noise with scaler_ctx_scale() and with every band
+ * count, on 'pool' or without one, and compares all of it, padding
+ * included. */
+static void check_bands(tpool_t *pool,
+      enum scaler_pix_fmt in_fmt, enum scaler_pix_fmt out_fmt)
+{
+   unsigned i, j, k, b;
+   uint32_t seed = 0x12345678;
+
+   for (i = 0; i < ARRAY_SIZE(sizes); i++)
+   {
+      for (j = 0; j < ARRAY_SIZE(types); j++)
+      {
+         struct scaler_ctx ctx;
+         size_t in_size, out_size;
+         uint8_t *in, *ref, *out;
+
+         setup(&ctx, &sizes[i], types[j], in_fmt, out_fmt);
+
+         in_size  = (size_t)ctx.in_stride  * ctx.in_height;
+         out_size = (size_t)ctx.out_stride * ctx.out_height;
+         in       = (uint8_t*)malloc(in_size);
+         ref      = (uint8_t*)malloc(out_size);
+         out      = (uint8_t*)malloc(out_size);
+
+         for (k = 0; k < in_size; k++)
+         {
+            seed  = seed * 1664525u + 1013904223u;
+            in[k] = (uint8_t)(seed >> 24);
+         }
+
+         memset(ref, 0xa5, out_size);
+         if (ctx.unscaled)
+            ctx.direct_pixconv(ref, in, ctx.out_width, ctx.out_height,
+                  ctx.out_stride, ctx.in_stride);
+         else
+            scaler_ctx_scale(&ctx, ref, in);
+
+         for (b = 0; b < ARRAY_SIZE(band_counts); b++)
+         {
+            /* Twice, as the bands are kept from the first call. */
+            for (k = 0; k < 2; k++)
+            {
+               memset(out, 0xa5, out_size);
+               scaler_ctx_scale_threaded(&ctx, out, in, pool,
+                     band_counts[b]);
+               ck_assert_msg(!memcmp(out, ref, out_size),
+                     "size %u, type %u, %u bands differ", i, j,
+                     band_counts[b]);
+            }
+         }
+
+         scaler_ctx_gen_reset(&ctx);
+         ck_assert_ptr_eq(ctx.bands, NULL);
+         free(out);
+         free(ref);
+         free(in);
+      }
+   }
+}
+
+START_TEST (test_scaler_bands_match)
+{
+   tpool_t *pool = tpool_create(3);
+
+   check_bands(pool, SCALER_FMT_ARGB8888, SCALER_FMT_ARGB8888);
+   check_bands(pool, SCALER_FMT_RGB565,   SCALER_FMT_ARGB8888);
+   check_bands(pool, SCALER_FMT_BGR24,    SCALER_FMT_BGR24);
+   check_bands(pool, SCALER_FMT_ARGB8888, SCALER_FMT_0RGB1555);
+
+   tpool_destroy(pool);
+}
+END_TEST
+
+START_TEST (test_scaler_bands_no_pool)
+{
+   check_bands(NULL, SCALER_FMT_RGB565, SCALER_FMT_BGR24);
+}
+END_TEST
+
+START_TEST (test_scaler_bilinear_converts_output)
+{
+   /* A flat colour has to stay that colour through the generic
+    * filter path, into a format other than ARGB8888. */
+   struct scaler_ctx ctx;
+   static const struct size size = { 8, 8, 5, 3 };
+   uint32_t in[8 * 8];
+   uint16_t out[5 * 3];
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(in); i++)
+      in[i] = 0xff00ff00;
+
+   setup(&ctx, &size, SCALER_TYPE_BILINEAR,
+         SCALER_FMT_ARGB8888, SCALER_FMT_0RGB1555);
+   ctx.in_stride  = 8 * sizeof(uint32_t);
+   ctx.out_stride = 5 * sizeof(uint16_t);
+
+   memset(out, 0, sizeof(out));
+   scaler_ctx_scale(&ctx, out, in);
+   for (i = 0; i < ARRAY_SIZE(out); i++)
+      ck_assert_uint_eq(out[i], 0x03e0);
+
+   memset(out, 0, sizeof(out));
+   scaler_ctx_scale_threaded(&ctx, out, in, NULL, 2);
+   for (i = 0; i < ARRAY_SIZE(out); i++)
+      ck_assert_uint_eq(out[i], 0x03e0);
+
+   scaler_ctx_gen_reset(&ctx);
+}
+END_TEST
+
+Suite *create_suite(void)
+{
+   Suite *s = suite_create(SUITE_NAME);
+
+   TCase *tc_core = tcase_create("Core");
+   tcase_add_test(tc_core, test_scaler_bands_match);
+   tcase_add_test(tc_core, test_scaler_bands_no_pool);
+   tcase_add_test(tc_core, test_scaler_bilinear_converts_output);
+   suite_add_tcase(s, tc_core);
+
+   return s;
+}
+
+int main(void)
+{
+   int num_fail;
+   Suite *s = create_suite();
+   SRunner *sr = srunner_create(s);
+   srunner_run_all(sr, CK_NORMAL);
+   num_fail = srunner_ntests_failed(sr);
+   srunner_free(sr);
+   return (num_fail == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
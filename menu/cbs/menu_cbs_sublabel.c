@@ -643,6 +643,7 @@ DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_onscreen_notifications_enable, MENU_
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_video_crop_overscan,           MENU_ENUM_SUBLABEL_VIDEO_CROP_OVERSCAN)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_video_filter,                  MENU_ENUM_SUBLABEL_VIDEO_FILTER)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_video_filter_remove,           MENU_ENUM_SUBLABEL_VIDEO_FILTER_REMOVE)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_video_filter_pipelined,        MENU_ENUM_SUBLABEL_VIDEO_FILTER_PIPELINED)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_netplay_nickname,              MENU_ENUM_SUBLABEL_NETPLAY_NICKNAME)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_cheevos_username,              MENU_ENUM_SUBLABEL_CHEEVOS_USERNAME)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_cheevos_password,              MENU_ENUM_SUBLABEL_CHEEVOS_PASSWORD)
@@ -782,6 +783,9 @@ DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_runahead_mode,                 MENU_
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_runahead_mode,                 MENU_ENUM_SUBLABEL_RUNAHEAD_MODE_NO_SECOND_INSTANCE)
 #endif
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_run_ahead_hide_warnings,       MENU_ENUM_SUBLABEL_RUN_AHEAD_HIDE_WARNINGS)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_run_ahead_incremental,         MENU_ENUM_SUBLABEL_RUN_AHEAD_INCREMENTAL)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_run_ahead_secondary_threaded,  MENU_ENUM_SUBLABEL_RUN_AHEAD_SECONDARY_THREADED)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_run_ahead_frames_auto,         MENU_ENUM_SUBLABEL_RUN_AHEAD_FRAMES_AUTO)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_run_ahead_frames,              MENU_ENUM_SUBLABEL_RUN_AHEAD_FRAMES)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_preempt_frames,                MENU_ENUM_SUBLABEL_PREEMPT_FRAMES)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_input_block_timeout,           MENU_ENUM_SUBLABEL_INPUT_BLOCK_TIMEOUT)
@@ -822,6 +826,9 @@ DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_settings,               MENU_
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_granularity,            MENU_ENUM_SUBLABEL_REWIND_GRANULARITY)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_buffer_size,            MENU_ENUM_SUBLABEL_REWIND_BUFFER_SIZE)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_buffer_size_step,       MENU_ENUM_SUBLABEL_REWIND_BUFFER_SIZE_STEP)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_async,                  MENU_ENUM_SUBLABEL_REWIND_ASYNC)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_compress,               MENU_ENUM_SUBLABEL_REWIND_COMPRESS)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_rewind_keyframe_interval,      MENU_ENUM_SUBLABEL_REWIND_KEYFRAME_INTERVAL)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_libretro_log_level,            MENU_ENUM_SUBLABEL_LIBRETRO_LOG_LEVEL)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_frontend_log_level,            MENU_ENUM_SUBLABEL_FRONTEND_LOG_LEVEL)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_perfcnt_enable,                MENU_ENUM_SUBLABEL_PERFCNT_ENABLE)
@@ -836,6 +843,7 @@ DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_savestate_automatic_interval,  MENU_
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_replay_max_keep,               MENU_ENUM_SUBLABEL_REPLAY_MAX_KEEP)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_replay_checkpoint_interval,    MENU_ENUM_SUBLABEL_REPLAY_CHECKPOINT_INTERVAL)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_replay_checkpoint_deserialize, MENU_ENUM_SUBLABEL_REPLAY_CHECKPOINT_DESERIALIZE)
+DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_replay_checkpoint_dictionary,  MENU_ENUM_SUBLABEL_REPLAY_CHECKPOINT_DICTIONARY)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_input_remap_binds_enable,      MENU_ENUM_SUBLABEL_INPUT_REMAP_BINDS_ENABLE)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_input_remap_sort_by_controller_enable,      MENU_ENUM_SUBLABEL_INPUT_REMAP_SORT_BY_CONTROLLER_ENABLE)
 DEFAULT_SUBLABEL_MACRO(action_bind_sublabel_input_autodetect_enable,       MENU_ENUM_SUBLABEL_INPUT_AUTODETECT_ENABLE)
@@ -4133,6 +4141,9 @@ int menu_cbs_init_bind_sublabel(menu_file_list_cbs_t *cbs,
          case MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DESERIALIZE:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_replay_checkpoint_deserialize);
             break;
+         case MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_replay_checkpoint_dictionary);
+            break;
          case MENU_ENUM_LABEL_SAVESTATE_MAX_KEEP:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_savestate_max_keep);
             break;
@@ -4178,6 +4189,15 @@ int menu_cbs_init_bind_sublabel(menu_file_list_cbs_t *cbs,
          case MENU_ENUM_LABEL_REWIND_BUFFER_SIZE_STEP:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_rewind_buffer_size_step);
             break;
+         case MENU_ENUM_LABEL_REWIND_ASYNC:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_rewind_async);
+            break;
+         case MENU_ENUM_LABEL_REWIND_COMPRESS:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_rewind_compress);
+            break;
+         case MENU_ENUM_LABEL_REWIND_KEYFRAME_INTERVAL:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_rewind_keyframe_interval);
+            break;
          case MENU_ENUM_LABEL_CORE_CHEAT_OPTIONS:
 #ifdef HAVE_CHEATS
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_core_cheat_options);
@@ -4320,6 +4340,15 @@ int menu_cbs_init_bind_sublabel(menu_file_list_cbs_t *cbs,
          case MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_run_ahead_hide_warnings);
             break;
+         case MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_run_ahead_incremental);
+            break;
+         case MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_run_ahead_secondary_threaded);
+            break;
+         case MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_run_ahead_frames_auto);
+            break;
          case MENU_ENUM_LABEL_RUN_AHEAD_FRAMES:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_run_ahead_frames);
             break;
@@ -4645,6 +4674,9 @@ int menu_cbs_init_bind_sublabel(menu_file_list_cbs_t *cbs,
          case MENU_ENUM_LABEL_VIDEO_FILTER_REMOVE:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_video_filter_remove);
             break;
+         case MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED:
+            BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_video_filter_pipelined);
+            break;
          case MENU_ENUM_LABEL_VIDEO_CROP_OVERSCAN:
             BIND_ACTION_SUBLABEL(cbs, action_bind_sublabel_video_crop_overscan);
             break;
@@ -8140,6 +8140,11 @@ unsigned menu_displaylist_build_list(
                      MENU_ENUM_LABEL_VIDEO_FILTER_REMOVE,
                      MENU_SETTING_ACTION_VIDEO_FILTER_REMOVE, 0, 0, NULL))
                   count++;
+
+            if (MENU_DISPLAYLIST_PARSE_SETTINGS_ENUM(list,
+                     MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED,
+                     PARSE_ONLY_BOOL, false) == 0)
+               count++;
 #endif
             if (MENU_DISPLAYLIST_PARSE_SETTINGS_ENUM(list,
                      MENU_ENUM_LABEL_VIDEO_NOTCH_WRITE_OVER,
@@ -10826,6 +10831,11 @@ unsigned menu_displaylist_build_list(
                {MENU_ENUM_LABEL_RUNAHEAD_MODE,                         PARSE_ONLY_UINT, false },
                {MENU_ENUM_LABEL_RUN_AHEAD_FRAMES,                      PARSE_ONLY_UINT, false },
                {MENU_ENUM_LABEL_PREEMPT_FRAMES,                        PARSE_ONLY_UINT, false },
+               {MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO,                 PARSE_ONLY_BOOL, false },
+               {MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL,                 PARSE_ONLY_BOOL, false },
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+               {MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED,          PARSE_ONLY_BOOL, false },
+#endif
                {MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS,               PARSE_ONLY_BOOL, false },
 #endif
                {MENU_ENUM_LABEL_AUDIO_LATENCY,                         PARSE_ONLY_UINT, true },
@@ -10912,6 +10922,17 @@ unsigned menu_displaylist_build_list(
                   case MENU_ENUM_LABEL_PREEMPT_FRAMES:
                      build_list[i].checked = runahead_supported && preempt_enabled;
                      break;
+                  case MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO:
+                     build_list[i].checked = runahead_supported && (runahead_enabled || preempt_enabled);
+                     break;
+                  case MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL:
+                     build_list[i].checked = runahead_supported && runahead_enabled
+                           && !settings->bools.run_ahead_secondary_instance;
+                     break;
+                  case MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED:
+                     build_list[i].checked = runahead_supported && runahead_enabled
+                           && settings->bools.run_ahead_secondary_instance;
+                     break;
                   case MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS:
                      build_list[i].checked = runahead_supported && (runahead_enabled || preempt_enabled);
                      break;
@@ -11243,6 +11264,9 @@ unsigned menu_displaylist_build_list(
                {MENU_ENUM_LABEL_REPLAY_MAX_KEEP,                    PARSE_ONLY_UINT, false},
                {MENU_ENUM_LABEL_REPLAY_CHECKPOINT_INTERVAL,         PARSE_ONLY_UINT, true},
                {MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DESERIALIZE,      PARSE_ONLY_BOOL, true},
+#ifdef HAVE_ZSTD
+               {MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY,       PARSE_ONLY_BOOL, true},
+#endif
                {MENU_ENUM_LABEL_SORT_SCREENSHOTS_BY_CONTENT_ENABLE, PARSE_ONLY_BOOL, true},
                {MENU_ENUM_LABEL_SCREENSHOTS_IN_CONTENT_DIR_ENABLE,  PARSE_ONLY_BOOL, true},
                {MENU_ENUM_LABEL_VIDEO_GPU_SCREENSHOT,               PARSE_ONLY_BOOL, false},
@@ -11981,6 +12005,13 @@ unsigned menu_displaylist_build_list(
                {MENU_ENUM_LABEL_REWIND_GRANULARITY,      PARSE_ONLY_UINT, true },
                {MENU_ENUM_LABEL_REWIND_BUFFER_SIZE,      PARSE_ONLY_SIZE, true },
                {MENU_ENUM_LABEL_REWIND_BUFFER_SIZE_STEP, PARSE_ONLY_UINT, true },
+#ifdef HAVE_THREADS
+               {MENU_ENUM_LABEL_REWIND_ASYNC,            PARSE_ONLY_BOOL, true },
+#endif
+#if defined(HAVE_THREADS) && defined(HAVE_ZSTD)
+               {MENU_ENUM_LABEL_REWIND_COMPRESS,         PARSE_ONLY_BOOL, true },
+#endif
+               {MENU_ENUM_LABEL_REWIND_KEYFRAME_INTERVAL,PARSE_ONLY_UINT, true },
                {MENU_ENUM_LABEL_AUDIO_REWIND_MUTE,       PARSE_ONLY_BOOL, true },
             };
 
@@ -12192,6 +12192,23 @@ static bool setting_append_list(
                   general_write_handler,
                   general_read_handler,
                   SD_FLAG_NONE);
+
+#ifdef HAVE_ZSTD
+            CONFIG_BOOL(
+                  list, list_info,
+                  &settings->bools.replay_checkpoint_dictionary,
+                  MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY,
+                  MENU_ENUM_LABEL_VALUE_REPLAY_CHECKPOINT_DICTIONARY,
+                  DEFAULT_REPLAY_CHECKPOINT_DICTIONARY,
+                  MENU_ENUM_LABEL_VALUE_OFF,
+                  MENU_ENUM_LABEL_VALUE_ON,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler,
+                  SD_FLAG_NONE);
+#endif
 #endif
 
             CONFIG_BOOL(
@@ -12625,6 +12642,58 @@ static bool setting_append_list(
             (*list)[list_info->index - 1].offset_by     = 1;
             menu_settings_list_current_add_range(list, list_info, 1, 100, 1, true, true);
 
+#ifdef HAVE_THREADS
+            CONFIG_BOOL(
+                  list, list_info,
+                  &settings->bools.rewind_async,
+                  MENU_ENUM_LABEL_REWIND_ASYNC,
+                  MENU_ENUM_LABEL_VALUE_REWIND_ASYNC,
+                  DEFAULT_REWIND_ASYNC,
+                  MENU_ENUM_LABEL_VALUE_OFF,
+                  MENU_ENUM_LABEL_VALUE_ON,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler,
+                  SD_FLAG_NONE);
+            MENU_SETTINGS_LIST_CURRENT_ADD_CMD(list, list_info, CMD_EVENT_REWIND_REINIT);
+#endif
+
+#if defined(HAVE_THREADS) && defined(HAVE_ZSTD)
+            CONFIG_BOOL(
+                  list, list_info,
+                  &settings->bools.rewind_compress,
+                  MENU_ENUM_LABEL_REWIND_COMPRESS,
+                  MENU_ENUM_LABEL_VALUE_REWIND_COMPRESS,
+                  DEFAULT_REWIND_COMPRESS,
+                  MENU_ENUM_LABEL_VALUE_OFF,
+                  MENU_ENUM_LABEL_VALUE_ON,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler,
+                  SD_FLAG_NONE);
+            MENU_SETTINGS_LIST_CURRENT_ADD_CMD(list, list_info, CMD_EVENT_REWIND_REINIT);
+#endif
+
+            CONFIG_UINT(
+                  list, list_info,
+                  &settings->uints.rewind_keyframe_interval,
+                  MENU_ENUM_LABEL_REWIND_KEYFRAME_INTERVAL,
+                  MENU_ENUM_LABEL_VALUE_REWIND_KEYFRAME_INTERVAL,
+                  DEFAULT_REWIND_KEYFRAME_INTERVAL,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler);
+            (*list)[list_info->index - 1].action_ok     = &setting_action_ok_uint;
+            (*list)[list_info->index - 1].offset_by     = 0;
+            menu_settings_list_current_add_range(list, list_info, 0, 3600, 30, true, true);
+            MENU_SETTINGS_LIST_CURRENT_ADD_CMD(list, list_info, CMD_EVENT_REWIND_REINIT);
+
          END_SUB_GROUP(list, list_info, parent_group);
          END_GROUP(list, list_info, parent_group);
          break;
@@ -14888,6 +14957,23 @@ static bool setting_append_list(
                   CMD_EVENT_VIDEO_FILTER_INIT);
             SETTINGS_DATA_LIST_CURRENT_ADD_FLAGS(list, list_info, SD_FLAG_LAKKA_ADVANCED);
 
+#ifdef HAVE_VIDEO_FILTER
+            CONFIG_BOOL(
+                  list, list_info,
+                  &settings->bools.video_filter_pipelined,
+                  MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED,
+                  MENU_ENUM_LABEL_VALUE_VIDEO_FILTER_PIPELINED,
+                  DEFAULT_VIDEO_FILTER_PIPELINED,
+                  MENU_ENUM_LABEL_VALUE_OFF,
+                  MENU_ENUM_LABEL_VALUE_ON,
+                  &group_info,
+                  &subgroup_info,
+                  parent_group,
+                  general_write_handler,
+                  general_read_handler,
+                  SD_FLAG_ADVANCED);
+#endif
+
             END_SUB_GROUP(list, list_info, parent_group);
             END_GROUP(list, list_info, parent_group);
          }
@@ -17286,6 +17372,56 @@ static bool setting_append_list(
                SD_FLAG_ADVANCED
                );
 
+         CONFIG_BOOL(
+               list, list_info,
+               &settings->bools.run_ahead_incremental,
+               MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL,
+               MENU_ENUM_LABEL_VALUE_RUN_AHEAD_INCREMENTAL,
+               DEFAULT_RUN_AHEAD_INCREMENTAL,
+               MENU_ENUM_LABEL_VALUE_OFF,
+               MENU_ENUM_LABEL_VALUE_ON,
+               &group_info,
+               &subgroup_info,
+               parent_group,
+               general_write_handler,
+               general_read_handler,
+               SD_FLAG_ADVANCED
+               );
+
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+         CONFIG_BOOL(
+               list, list_info,
+               &settings->bools.run_ahead_secondary_threaded,
+               MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED,
+               MENU_ENUM_LABEL_VALUE_RUN_AHEAD_SECONDARY_THREADED,
+               DEFAULT_RUN_AHEAD_SECONDARY_THREADED,
+               MENU_ENUM_LABEL_VALUE_OFF,
+               MENU_ENUM_LABEL_VALUE_ON,
+               &group_info,
+               &subgroup_info,
+               parent_group,
+               general_write_handler,
+               general_read_handler,
+               SD_FLAG_ADVANCED
+               );
+#endif
+
+         CONFIG_BOOL(
+               list, list_info,
+               &settings->bools.run_ahead_frames_auto,
+               MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO,
+               MENU_ENUM_LABEL_VALUE_RUN_AHEAD_FRAMES_AUTO,
+               DEFAULT_RUN_AHEAD_FRAMES_AUTO,
+               MENU_ENUM_LABEL_VALUE_OFF,
+               MENU_ENUM_LABEL_VALUE_ON,
+               &group_info,
+               &subgroup_info,
+               parent_group,
+               general_write_handler,
+               general_read_handler,
+               SD_FLAG_ADVANCED
+               );
+
          CONFIG_UINT(
                list, list_info,
                &settings->uints.run_ahead_frames,
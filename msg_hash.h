@@ -2376,6 +2376,9 @@ enum msg_hash_enums
    MENU_LABEL(REWIND_GRANULARITY),
    MENU_LABEL(REWIND_BUFFER_SIZE),
    MENU_LABEL(REWIND_BUFFER_SIZE_STEP),
+   MENU_LABEL(REWIND_ASYNC),
+   MENU_LABEL(REWIND_COMPRESS),
+   MENU_LABEL(REWIND_KEYFRAME_INTERVAL),
 
    MENU_LABEL(CHEAT_APPLY_CHANGES),
    MENU_LABEL(CHEAT_IDX),
@@ -2565,6 +2568,7 @@ enum msg_hash_enums
    MENU_LBL_H(SAVESTATE_AUTOMATIC_INTERVAL),
    MENU_LBL_H(REPLAY_CHECKPOINT_INTERVAL),
    MENU_LBL_H(REPLAY_CHECKPOINT_DESERIALIZE),
+   MENU_LBL_H(REPLAY_CHECKPOINT_DICTIONARY),
    MENU_LBL_H(CONFIG_SAVE_ON_EXIT),
    MENU_LBL_H(CONFIG_SAVE_MINIMAL),
    MENU_LABEL(REMAP_SAVE_ON_EXIT),
@@ -2761,6 +2765,9 @@ enum msg_hash_enums
    MENU_LABEL(SLOWMOTION_RATIO),
    MENU_LABEL(RUN_AHEAD_UNSUPPORTED),
    MENU_LABEL(RUN_AHEAD_HIDE_WARNINGS),
+   MENU_LABEL(RUN_AHEAD_INCREMENTAL),
+   MENU_LABEL(RUN_AHEAD_SECONDARY_THREADED),
+   MENU_LABEL(RUN_AHEAD_FRAMES_AUTO),
    MENU_LABEL(RUN_AHEAD_FRAMES),
    MENU_LABEL(PREEMPT_FRAMES),
    MENU_LABEL(INPUT_BLOCK_TIMEOUT),
@@ -3168,6 +3175,7 @@ enum msg_hash_enums
    MENU_LBL_H(VIDEO_FILTER),
    MENU_ENUM_LABEL_HELP_VIDEO_FILTER_BUILTIN,
    MENU_LABEL(VIDEO_FILTER_REMOVE),
+   MENU_LABEL(VIDEO_FILTER_PIPELINED),
    MENU_LABEL(PAL60_ENABLE),
 
    MENU_LABEL(RGUI_BROWSER_DIRECTORY),
@@ -111,6 +111,7 @@
 #define MENU_ENUM_LABEL_SAVESTATE_AUTOMATIC_INTERVAL_STR "savestate_automatic_interval"
 #define MENU_ENUM_LABEL_REPLAY_CHECKPOINT_INTERVAL_STR "replay_checkpoint_interval"
 #define MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DESERIALIZE_STR "replay_checkpoint_deserialize"
+#define MENU_ENUM_LABEL_REPLAY_CHECKPOINT_DICTIONARY_STR "replay_checkpoint_dictionary"
 #define MENU_ENUM_LABEL_AUTO_OVERRIDES_ENABLE_STR "auto_overrides_enable"
 #define MENU_ENUM_LABEL_AUTO_REMAPS_ENABLE_STR "auto_remaps_enable"
 #define MENU_ENUM_LABEL_INITIAL_DISK_CHANGE_ENABLE_STR "initial_disk_change_enable"
@@ -829,6 +830,9 @@
 #define MENU_ENUM_LABEL_REWIND_GRANULARITY_STR "rewind_granularity"
 #define MENU_ENUM_LABEL_REWIND_BUFFER_SIZE_STR "rewind_buffer_size"
 #define MENU_ENUM_LABEL_REWIND_BUFFER_SIZE_STEP_STR "rewind_buffer_size_step"
+#define MENU_ENUM_LABEL_REWIND_ASYNC_STR "rewind_async"
+#define MENU_ENUM_LABEL_REWIND_COMPRESS_STR "rewind_compress"
+#define MENU_ENUM_LABEL_REWIND_KEYFRAME_INTERVAL_STR "rewind_keyframe_interval"
 #define MENU_ENUM_LABEL_FRAME_THROTTLE_SETTINGS_STR "frame_throttle_settings"
 #define MENU_ENUM_LABEL_FRAME_TIME_COUNTER_SETTINGS_STR "frame_time_counter_settings"
 #define MENU_ENUM_LABEL_VRR_RUNLOOP_ENABLE_STR "vrr_runloop_enable"
@@ -923,6 +927,9 @@
 #define MENU_ENUM_LABEL_RUN_AHEAD_UNSUPPORTED_STR "run_ahead_unsupported"
 #define MENU_ENUM_LABEL_RUNAHEAD_MODE_STR "run_ahead_mode"
 #define MENU_ENUM_LABEL_RUN_AHEAD_HIDE_WARNINGS_STR "run_ahead_hide_warnings"
+#define MENU_ENUM_LABEL_RUN_AHEAD_INCREMENTAL_STR "run_ahead_incremental"
+#define MENU_ENUM_LABEL_RUN_AHEAD_SECONDARY_THREADED_STR "run_ahead_secondary_threaded"
+#define MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_AUTO_STR "run_ahead_frames_auto"
 #define MENU_ENUM_LABEL_RUN_AHEAD_FRAMES_STR "run_ahead_frames"
 #define MENU_ENUM_LABEL_PREEMPT_FRAMES_STR "preemptive_frames"
 #define MENU_ENUM_LABEL_SORT_SAVEFILES_ENABLE_STR "sort_savefiles_enable"
@@ -1067,6 +1074,7 @@
 #define MENU_ENUM_LABEL_VIDEO_DRIVER_NULL_STR "null"
 #define MENU_ENUM_LABEL_VIDEO_FILTER_STR "video_filter"
 #define MENU_ENUM_LABEL_VIDEO_FILTER_REMOVE_STR "video_filter_remove"
+#define MENU_ENUM_LABEL_VIDEO_FILTER_PIPELINED_STR "video_filter_pipelined"
 #define MENU_ENUM_LABEL_VIDEO_FILTER_DIR_STR "video_filter_dir"
 #define MENU_ENUM_LABEL_VIDEO_FILTER_FLICKER_STR "video_filter_flicker"
 #define MENU_ENUM_LABEL_VIDEO_FONT_ENABLE_STR "video_font_enable"
@@ -25,6 +25,7 @@
 #include <boolean.h>
 #include <queues/fifo_queue.h>
 #include <rthreads/rthreads.h>
+#include <rthreads/tpool.h>
 #include <gfx/scaler/scaler.h>
 #include <gfx/video_frame.h>
 #include <file/config_file.h>
@@ -110,6 +111,10 @@ struct ff_video_info
    AVFormatContext *format;
 
    struct scaler_ctx scaler;
+   /* Bands of the in-house scaler run here, see
+    * scaler_ctx_scale_threaded(). */
+   tpool_t *scaler_pool;
+   unsigned scaler_bands;
    struct SwsContext *sws;
    bool use_sws;
 };
@@ -505,6 +510,14 @@ static bool ffmpeg_init_video(ffmpeg_t *handle)
 
    video->codec->thread_count = params->threads;
 
+   /* The in-house scaler gets as many threads, counting the
+    * recording thread, which scales a band itself. */
+   if (!video->use_sws && params->threads > 1)
+   {
+      video->scaler_pool  = tpool_create(params->threads - 1);
+      video->scaler_bands = params->threads;
+   }
+
    if (params->video_qscale)
    {
       video->codec->flags |= AV_CODEC_FLAG_QSCALE;
@@ -1021,6 +1034,9 @@ static void ffmpeg_free(void *data)
 
    scaler_ctx_gen_reset(&handle->video.scaler);
 
+   if (handle->video.scaler_pool)
+      tpool_destroy(handle->video.scaler_pool);
+
    if (handle->video.sws)
       sws_freeContext(handle->video.sws);
 
@@ -1314,7 +1330,7 @@ static void ffmpeg_scale_input(ffmpeg_t *handle,
             handle->video.conv_frame->linesize);
    }
    else
-      video_frame_record_scale(
+      video_frame_record_scale_threaded(
             &handle->video.scaler,
             handle->video.conv_frame->data[0],
             vid->data,
@@ -1324,7 +1340,9 @@ static void ffmpeg_scale_input(ffmpeg_t *handle,
             vid->width,
             vid->height,
             vid->pitch,
-            shrunk);
+            shrunk,
+            handle->video.scaler_pool,
+            handle->video.scaler_bands);
 }
 
 static bool ffmpeg_push_video_thread(ffmpeg_t *handle,
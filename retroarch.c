@@ -3985,6 +3985,10 @@ bool command_event(enum event_command cmd, void *data)
          {
             bool rewind_enable        = settings->bools.rewind_enable;
             size_t rewind_buf_size    = settings->sizes.rewind_buffer_size;
+            bool rewind_async         = settings->bools.rewind_async;
+            bool rewind_compress      = settings->bools.rewind_compress;
+            unsigned rewind_keyframes = settings->uints.rewind_keyframe_interval;
+            const char *rewind_dump   = settings->paths.directory_rewind_dump;
             bool core_type_is_dummy   = runloop_st->current_core_type == CORE_TYPE_DUMMY;
 
             if (core_type_is_dummy)
@@ -4007,7 +4011,9 @@ bool command_event(enum event_command cmd, void *data)
 #endif
                {
                   state_manager_event_init(&runloop_st->rewind_st,
-                        (unsigned)rewind_buf_size);
+                        (unsigned)rewind_buf_size, rewind_async,
+                        rewind_compress, rewind_keyframes,
+                        rewind_dump);
                }
             }
          }
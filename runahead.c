@@ -29,9 +29,13 @@
 #endif
 
 #include <encodings/utf.h>
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
 #include <string/stdstring.h>
 #include <streams/file_stream.h>
 #include <time/rtime.h>
+#include <features/features_cpu.h>
 
 #include "configuration.h"
 #include "content.h"
@@ -41,24 +45,96 @@
 #include "audio/audio_driver.h"
 #include "gfx/video_driver.h"
 #include "paths.h"
+#include "performance_counters.h"
 #include "runloop.h"
 #include "verbosity.h"
+#ifdef HAVE_CHEATS
+#include "cheat_manager.h"
+#endif
 
-static int16_t input_state_get_last(unsigned port,
-      unsigned device, unsigned index, unsigned id)
+/* Granularity of the memory change check in incremental run-ahead */
+#define RUNAHEAD_PAGE_SIZE   4096
+/* Most memory descriptors checked, plus system RAM as a fallback */
+#define RUNAHEAD_MAX_REGIONS 32
+
+static struct retro_perf_counter runahead_frame_perf       = {0};
+static struct retro_perf_counter runahead_serialize_perf   = {0};
+static struct retro_perf_counter runahead_unserialize_perf = {0};
+
+/* Rolling cost histograms, see runahead_stats_t */
+
+static unsigned runahead_histogram_bucket(uint32_t usec)
 {
-   runloop_state_t      *runloop_st = runloop_state_get_ptr();
+   unsigned msb = 2;
+   unsigned idx;
+   if (usec < 4)
+      return usec;
+   while (usec >> (msb + 1))
+      msb++;
+   idx = 4 * (msb - 1) + ((usec >> (msb - 2)) & 3);
+   return MIN(idx, RUNAHEAD_STATS_BUCKETS - 1);
+}
 
-   if (runloop_st->input_state_list)
+/* Largest time that falls in bucket 'idx' */
+static uint32_t runahead_histogram_bucket_max(unsigned idx)
+{
+   if (idx < 4)
+      return idx;
+   return ((uint32_t)(5 + (idx & 3)) << (idx / 4 - 1)) - 1;
+}
+
+static void runahead_stats_add(runloop_state_t *runloop_st,
+      enum runahead_stat stat, retro_time_t usec)
+{
+   runahead_histogram_t *hist = &runloop_st->runahead_stats.hist[stat];
+   uint32_t sample            = usec > 0 ? (uint32_t)MIN(usec, UINT32_MAX) : 0;
+
+   if (hist->count == RUNAHEAD_STATS_SAMPLES)
+      hist->bucket[runahead_histogram_bucket(hist->sample[hist->next])]--;
+   else
+      hist->count++;
+   hist->sample[hist->next] = sample;
+   hist->bucket[runahead_histogram_bucket(sample)]++;
+   hist->next               = (hist->next + 1) % RUNAHEAD_STATS_SAMPLES;
+}
+
+/* Upper bound of the time 'percent' of the samples are within */
+static uint32_t runahead_stats_percentile(const runloop_state_t *runloop_st,
+      enum runahead_stat stat, unsigned percent)
+{
+   unsigned i;
+   const runahead_histogram_t *hist = &runloop_st->runahead_stats.hist[stat];
+   unsigned target                  = (hist->count * percent + 99) / 100;
+   unsigned seen                    = 0;
+
+   if (!hist->count)
+      return 0;
+   for (i = 0; i < RUNAHEAD_STATS_BUCKETS; i++)
+   {
+      seen += hist->bucket[i];
+      if (seen >= target)
+         return runahead_histogram_bucket_max(i);
+   }
+   return runahead_histogram_bucket_max(RUNAHEAD_STATS_BUCKETS - 1);
+}
+
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+static void runahead_thread_free(runloop_state_t *runloop_st);
+#endif
+
+static int16_t input_list_get_state(const my_list *list, unsigned port,
+      unsigned device, unsigned index, unsigned id)
+{
+   if (list)
    {
       int i;
       /* find list item */
-      for (i = 0; i < runloop_st->input_state_list->size; i++)
+      for (i = 0; i < list->size; i++)
       {
-         input_list_element *element =
-            (input_list_element*)runloop_st->input_state_list->data[i];
+         input_list_element *element = (input_list_element*)list->data[i];
 
-         if (     (element->port   == port)
+         if (     element
+               && (element->port   == port)
                && (element->device == device)
                && (element->index  == index))
          {
@@ -72,6 +148,13 @@ static int16_t input_state_get_last(unsigned port,
    return 0;
 }
 
+static int16_t input_state_get_last(unsigned port,
+      unsigned device, unsigned index, unsigned id)
+{
+   return input_list_get_state(runloop_state_get_ptr()->input_state_list,
+         port, device, index, id);
+}
+
 static void free_retro_ctx_load_content_info(struct
       retro_ctx_load_content_info *dest)
 {
@@ -186,6 +269,9 @@ static void strcat_alloc(char **dst, const char *s)
 void runahead_secondary_core_destroy(void *data)
 {
    runloop_state_t *runloop_st      = (runloop_state_t*)data;
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+   runahead_thread_free(runloop_st);
+#endif
    if (!runloop_st->secondary_lib_handle)
       return;
 
@@ -395,11 +481,192 @@ end:
    return NULL;
 }
 
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+/* Threaded second instance
+ *
+ * With a second instance, each frame runs the primary core for the
+ * real frame and then the secondary core for the predicted ones, one
+ * after the other.  The secondary's frames only depend on the state
+ * before the real frame and on the input, both known before the
+ * primary runs, so they can run on a worker thread at the same time:
+ * - input unchanged: the secondary runs one more frame, as it would
+ *   after the primary;
+ * - input changed: the primary's state from before its frame is
+ *   handed over and the secondary runs runahead_count + 1 frames
+ *   from it, the real frame included, with the new input.
+ * The predicted frame it presents is the same either way.
+ *
+ * The worker hands its last frame to the main thread, which draws
+ * it once both cores are done.  Its environment calls are answered
+ * on the worker from a short list of ones that are safe there; any
+ * other call, or a hardware rendered frame, makes the core run on
+ * the main thread again until the second instance is recreated. */
+
+/* Changed only under the lock, or by the main thread while the
+ * worker waits; the worker clears START when it is done. */
+enum runahead_thread_flags
+{
+   /* Main thread to worker: run the secondary core */
+   RUNAHEAD_THREAD_FLAG_START           = (1 << 0),
+   RUNAHEAD_THREAD_FLAG_QUIT            = (1 << 1),
+   /* Secondary core is running on the worker */
+   RUNAHEAD_THREAD_FLAG_RUNNING         = (1 << 2),
+   /* Secondary core is in step with the primary */
+   RUNAHEAD_THREAD_FLAG_SYNCED          = (1 << 3),
+   /* Core is not run on the worker */
+   RUNAHEAD_THREAD_FLAG_DISABLED        = (1 << 4)
+};
+
+/* Written by the worker while it runs; the main thread only
+ * touches them before START is set or after it is cleared. */
+enum runahead_worker_flags
+{
+   /* Secondary core is loading the handed over state */
+   RUNAHEAD_WORKER_FLAG_LOADING         = (1 << 0),
+   /* Secondary core is running the frame to be shown */
+   RUNAHEAD_WORKER_FLAG_PRESENT         = (1 << 1),
+   /* A frame to be shown was captured */
+   RUNAHEAD_WORKER_FLAG_FRAME           = (1 << 2),
+   RUNAHEAD_WORKER_FLAG_VARIABLE_UPDATE = (1 << 3),
+   /* Secondary core made a call that is not safe on the worker */
+   RUNAHEAD_WORKER_FLAG_UNSAFE          = (1 << 4),
+   RUNAHEAD_WORKER_FLAG_LOAD_FAILED     = (1 << 5)
+};
+
+/* A core option value as the primary core had it at the handover */
+struct runahead_option
+{
+   char *key;
+   char *value;
+   size_t index;
+};
+
+struct runahead_thread
+{
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+   /* Input the secondary core runs with */
+   my_list *input;
+   /* Core options the secondary core reads; the primary core
+    * and the menu can change the live ones during the run */
+   struct runahead_option *options;
+   const core_option_manager_t *options_src;
+   size_t num_options;
+   /* Primary state to start from, or NULL to carry on */
+   const void *state;
+   size_t state_size;
+   /* Copy of the frame to be shown; NULL data means a dupe */
+   void *frame;
+   size_t frame_capacity;
+   size_t frame_pitch;
+   unsigned frame_width;
+   unsigned frame_height;
+   bool frame_dupe;
+   /* Frames to run */
+   int frames;
+   /* Time the worker took, kept for the main thread's stats */
+   retro_time_t unserialize_time;
+   retro_time_t run_time;
+   /* First environment call refused on the worker */
+   unsigned unsafe_cmd;
+   uint8_t flags;
+   uint8_t worker_flags;
+};
+
+/* Environment calls of the secondary core while it runs on the
+ * worker.  The primary core and the menu may be using the
+ * frontend at the same time, so core options come from the copy
+ * made at the handover and only calls that read settings which
+ * do not change while a core runs are passed on. */
+static bool runahead_thread_environment(runloop_state_t *runloop_st,
+      runahead_thread_t *rt, unsigned cmd, void *data)
+{
+   switch (cmd)
+   {
+      case RETRO_ENVIRONMENT_GET_VARIABLE:
+         {
+            size_t i;
+            struct retro_variable *var = (struct retro_variable*)data;
+            if (!var)
+               return true;
+            var->value = NULL;
+            /* Unlike the frontend's handler, leaves the update flags
+             * alone; updates are handed over at the start of a run. */
+            if (string_is_empty(var->key))
+               return true;
+            for (i = 0; i < rt->num_options; i++)
+            {
+               if (string_is_equal(rt->options[i].key, var->key))
+               {
+                  var->value = rt->options[i].value;
+                  break;
+               }
+            }
+         }
+         return true;
+      case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+         if (data)
+            *(bool*)data = (rt->worker_flags & RUNAHEAD_WORKER_FLAG_VARIABLE_UPDATE)
+               ? true : false;
+         rt->worker_flags &= ~RUNAHEAD_WORKER_FLAG_VARIABLE_UPDATE;
+         return true;
+      case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE:
+         if (data)
+         {
+            int result = RETRO_AV_ENABLE_HARD_DISABLE_AUDIO;
+            if (rt->worker_flags & RUNAHEAD_WORKER_FLAG_PRESENT)
+               result |= RETRO_AV_ENABLE_VIDEO;
+            if (rt->worker_flags & RUNAHEAD_WORKER_FLAG_LOADING)
+               result |= RETRO_AV_ENABLE_FAST_SAVESTATES;
+            *(enum retro_av_enable_flags*)data = (enum retro_av_enable_flags)result;
+         }
+         return true;
+      case RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT:
+         if (data)
+            *(int*)data = (rt->worker_flags & RUNAHEAD_WORKER_FLAG_LOADING)
+               ? RETRO_SAVESTATE_CONTEXT_RUNAHEAD_SAME_BINARY
+               : RETRO_SAVESTATE_CONTEXT_NORMAL;
+         return true;
+      case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER:
+         /* Video driver memory belongs to the main thread;
+          * the core falls back to its own buffer */
+         return false;
+      case RETRO_ENVIRONMENT_GET_CAN_DUPE:
+      case RETRO_ENVIRONMENT_GET_OVERSCAN:
+      case RETRO_ENVIRONMENT_GET_LANGUAGE:
+      case RETRO_ENVIRONMENT_GET_INPUT_BITMASKS:
+      case RETRO_ENVIRONMENT_GET_LOG_INTERFACE:
+      case RETRO_ENVIRONMENT_GET_PERF_INTERFACE:
+      case RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_CORE_ASSETS_DIRECTORY:
+      case RETRO_ENVIRONMENT_GET_LIBRETRO_PATH:
+      case RETRO_ENVIRONMENT_GET_USERNAME:
+         return runloop_environment_cb(cmd, data);
+      default:
+         break;
+   }
+
+   if (!(rt->worker_flags & RUNAHEAD_WORKER_FLAG_UNSAFE))
+      rt->unsafe_cmd = cmd;
+   rt->worker_flags |= RUNAHEAD_WORKER_FLAG_UNSAFE;
+   return false;
+}
+#endif
+
 static bool runloop_environment_secondary_core_hook(
       unsigned cmd, void *data)
 {
    runloop_state_t *runloop_st    = runloop_state_get_ptr();
-   bool result                    = runloop_environment_cb(cmd, data);
+   bool result;
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+   if (     runloop_st->runahead_thread
+         && (runloop_st->runahead_thread->flags & RUNAHEAD_THREAD_FLAG_RUNNING))
+      return runahead_thread_environment(runloop_st,
+            runloop_st->runahead_thread, cmd, data);
+#endif
+   result                         = runloop_environment_cb(cmd, data);
 
    if (runloop_st->flags & RUNLOOP_FLAG_HAS_VARIABLE_UPDATE)
    {
@@ -557,9 +824,12 @@ static bool secondary_core_deserialize(runloop_state_t *runloop_st,
 
    if (secondary_core_ensure_exists(runloop_st, settings))
    {
+      retro_time_t start = cpu_features_get_time_usec();
       runloop_st->flags |=  RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
       ret                = runloop_st->secondary_core.retro_unserialize(data, len);
       runloop_st->flags &= ~RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
+      runahead_stats_add(runloop_st, RUNAHEAD_STAT_UNSERIALIZE,
+            cpu_features_get_time_usec() - start);
    }
    else
       runahead_secondary_core_destroy(runloop_st);
@@ -572,6 +842,7 @@ static void secondary_core_input_poll_null(void) { }
 
 static bool secondary_core_run_use_last_input(runloop_state_t *runloop_st)
 {
+   retro_time_t start;
    retro_input_poll_t old_poll_function;
    retro_input_state_t old_input_function;
 
@@ -592,7 +863,10 @@ static bool secondary_core_run_use_last_input(runloop_state_t *runloop_st)
    runloop_st->secondary_core.retro_set_input_state(
          runloop_st->secondary_callbacks.state_cb);
 
+   start                                    = cpu_features_get_time_usec();
    runloop_st->secondary_core.retro_run();
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_REPLAY,
+         cpu_features_get_time_usec() - start);
    runloop_st->secondary_callbacks.poll_cb  = old_poll_function;
    runloop_st->secondary_callbacks.state_cb = old_input_function;
 
@@ -772,8 +1046,12 @@ static void *input_list_element_constructor(void)
     * partial-failure through the constructor callback's return
     * type, so free the outer allocation and return NULL to match
     * the outer-OOM behaviour. */
-   if (!element->state)
+   element->requested          = (uint32_t*)calloc(
+         (NAME_MAX_LENGTH + 31) / 32, sizeof(uint32_t));
+   if (!element->state || !element->requested)
    {
+      free(element->state);
+      free(element->requested);
       free(ptr);
       return NULL;
    }
@@ -792,6 +1070,9 @@ static bool input_list_element_realloc(input_list_element *element,
        * then made the very next line '&element->state[element->
        * state_size]' perform pointer arithmetic on NULL (UB) and
        * the memset trap on a garbage address. */
+      size_t old_words   = (element->state_size + 31) / 32;
+      size_t new_words   = (new_size + 31) / 32;
+      uint32_t *requested;
       int16_t *tmp = (int16_t*)realloc(element->state,
             new_size * sizeof(int16_t));
       if (!tmp)
@@ -799,6 +1080,12 @@ static bool input_list_element_realloc(input_list_element *element,
       element->state = tmp;
       memset(&element->state[element->state_size], 0,
             (new_size - element->state_size) * sizeof(int16_t));
+      if (!(requested = (uint32_t*)realloc(element->requested,
+                  new_words * sizeof(uint32_t))))
+         return false;
+      element->requested = requested;
+      memset(&element->requested[old_words], 0,
+            (new_words - old_words) * sizeof(uint32_t));
       element->state_size = new_size;
    }
    return true;
@@ -822,6 +1109,7 @@ static void input_list_element_destructor(void* element_ptr)
       return;
 
    free(element->state);
+   free(element->requested);
    free(element_ptr);
 }
 
@@ -854,6 +1142,7 @@ static void runahead_input_state_set_last(
                && !input_list_element_expand(element, id))
             return;
          element->state[id] = value;
+         element->requested[id >> 5] |= 1u << (id & 31);
          return;
       }
    }
@@ -872,9 +1161,23 @@ static void runahead_input_state_set_last(
             && !input_list_element_expand(element, id))
          return;
       element->state[id]    = value;
+      element->requested[id >> 5] |= 1u << (id & 31);
    }
 }
 
+/* input_state_get_last() for predicted frames that may be kept:
+ * also notes the input as requested, so that it is checked for
+ * changes before the prediction is used. */
+static int16_t runahead_input_state_get_last_requested(unsigned port,
+      unsigned device, unsigned index, unsigned id)
+{
+   runloop_state_t *runloop_st = runloop_state_get_ptr();
+   int16_t value               = input_state_get_last(port, device, index, id);
+   if (id < 65536)
+      runahead_input_state_set_last(runloop_st, port, device, index, id, value);
+   return value;
+}
+
 static int16_t runahead_input_state_with_logging(unsigned port,
       unsigned device, unsigned index, unsigned id)
 {
@@ -1025,9 +1328,25 @@ static void runahead_remove_hooks(runloop_state_t *runloop_st)
    runahead_remove_input_state_hook(runloop_st);
 }
 
+static void runahead_chain_free(runloop_state_t *runloop_st)
+{
+   size_t i;
+   runahead_chain_t *chain = runloop_st->runahead_chain;
+
+   if (!chain)
+      return;
+
+   for (i = 0; i <= MAX_RUNAHEAD_FRAMES; i++)
+      free(chain->buffer[i]);
+   free(chain->page_hash);
+   free(chain);
+   runloop_st->runahead_chain = NULL;
+}
+
 static void runahead_destroy(runloop_state_t *runloop_st)
 {
    runahead_savestate_info_free(runloop_st);
+   runahead_chain_free(runloop_st);
    runahead_remove_hooks(runloop_st);
    runahead_clear_variables(runloop_st);
 }
@@ -1078,6 +1397,7 @@ static void runahead_err(runloop_state_t *runloop_st)
 {
    runloop_st->flags &= ~RUNLOOP_FLAG_RUNAHEAD_AVAILABLE;
    runahead_savestate_info_free(runloop_st);
+   runahead_chain_free(runloop_st);
    runahead_remove_hooks(runloop_st);
    runloop_st->runahead_save_state_size       = 0;
    runloop_st->flags                         |= RUNLOOP_FLAG_RUNAHEAD_SAVE_STATE_SIZE_KNOWN;
@@ -1110,7 +1430,15 @@ static bool runahead_save_state(runloop_state_t *runloop_st)
    retro_ctx_serialize_info_t *info = &runloop_st->runahead_savestate_info;
    if (info->data)
    {
-      if (core_serialize_special(info))
+      bool ret;
+      retro_time_t start = cpu_features_get_time_usec();
+      performance_counter_init(runahead_serialize_perf, "runahead_serialize");
+      performance_counter_start_plus(runloop_st->perfcnt_enable, runahead_serialize_perf);
+      ret = core_serialize_special(info);
+      performance_counter_stop_plus(runloop_st->perfcnt_enable, runahead_serialize_perf);
+      runahead_stats_add(runloop_st, RUNAHEAD_STAT_SERIALIZE,
+            cpu_features_get_time_usec() - start);
+      if (ret)
          return true;
       runahead_err(runloop_st);
    }
@@ -1119,9 +1447,16 @@ static bool runahead_save_state(runloop_state_t *runloop_st)
 
 static bool runahead_load_state(runloop_state_t *runloop_st)
 {
+   bool ret;
    retro_ctx_serialize_info_t *info = &runloop_st->runahead_savestate_info;
    bool last_dirty                  = (runloop_st->flags & RUNLOOP_FLAG_INPUT_IS_DIRTY) ? true : false;
-   bool ret                         = core_unserialize_special(info);
+   retro_time_t start               = cpu_features_get_time_usec();
+   performance_counter_init(runahead_unserialize_perf, "runahead_unserialize");
+   performance_counter_start_plus(runloop_st->perfcnt_enable, runahead_unserialize_perf);
+   ret                              = core_unserialize_special(info);
+   performance_counter_stop_plus(runloop_st->perfcnt_enable, runahead_unserialize_perf);
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_UNSERIALIZE,
+         cpu_features_get_time_usec() - start);
    if (last_dirty)
       runloop_st->flags             |=  RUNLOOP_FLAG_INPUT_IS_DIRTY;
    else
@@ -1150,19 +1485,445 @@ static bool runahead_load_state_secondary(runloop_state_t *runloop_st, settings_
 }
 #endif
 
-static void runahead_core_run_use_last_input(runloop_state_t *runloop_st)
+#if defined(HAVE_DYNAMIC) && defined(HAVE_THREADS)
+static void runahead_thread_frame(const void *data, unsigned width,
+      unsigned height, size_t pitch)
+{
+   runahead_thread_t *rt = runloop_state_get_ptr()->runahead_thread;
+
+   if (!(rt->worker_flags & RUNAHEAD_WORKER_FLAG_PRESENT))
+      return;
+   if (data == RETRO_HW_FRAME_BUFFER_VALID)
+   {
+      rt->worker_flags |= RUNAHEAD_WORKER_FLAG_UNSAFE;
+      return;
+   }
+
+   rt->frame_width  = width;
+   rt->frame_height = height;
+   rt->frame_pitch  = pitch;
+   rt->frame_dupe   = !data;
+   if (data)
+   {
+      size_t _len = (size_t)height * pitch;
+      if (_len > rt->frame_capacity)
+      {
+         void *frame = realloc(rt->frame, _len);
+         if (!frame)
+            return;
+         rt->frame          = frame;
+         rt->frame_capacity = _len;
+      }
+      memcpy(rt->frame, data, _len);
+   }
+   rt->worker_flags |= RUNAHEAD_WORKER_FLAG_FRAME;
+}
+
+static void runahead_thread_audio_sample(int16_t left, int16_t right) { }
+
+static size_t runahead_thread_audio_sample_batch(const int16_t *data,
+      size_t frames)
+{
+   return frames;
+}
+
+static int16_t runahead_thread_input_state(unsigned port,
+      unsigned device, unsigned index, unsigned id)
+{
+   return input_list_get_state(
+         runloop_state_get_ptr()->runahead_thread->input,
+         port, device, index, id);
+}
+
+static void runahead_thread_loop(void *data)
+{
+   runahead_thread_t *rt       = (runahead_thread_t*)data;
+   runloop_state_t *runloop_st = runloop_state_get_ptr();
+
+   slock_lock(rt->lock);
+   for (;;)
+   {
+      int i;
+      retro_time_t start;
+      while (!(rt->flags & (RUNAHEAD_THREAD_FLAG_START
+                          | RUNAHEAD_THREAD_FLAG_QUIT)))
+         scond_wait(rt->cond, rt->lock);
+      if (rt->flags & RUNAHEAD_THREAD_FLAG_QUIT)
+         break;
+      slock_unlock(rt->lock);
+
+      start = cpu_features_get_time_usec();
+      if (rt->state)
+      {
+         rt->worker_flags |=  RUNAHEAD_WORKER_FLAG_LOADING;
+         if (!runloop_st->secondary_core.retro_unserialize(
+                  rt->state, rt->state_size))
+            rt->worker_flags |= RUNAHEAD_WORKER_FLAG_LOAD_FAILED;
+         rt->worker_flags &= ~RUNAHEAD_WORKER_FLAG_LOADING;
+      }
+      rt->unserialize_time = cpu_features_get_time_usec() - start;
+      if (!(rt->worker_flags & RUNAHEAD_WORKER_FLAG_LOAD_FAILED))
+      {
+         for (i = 0; i < rt->frames; i++)
+         {
+            if (i == rt->frames - 1)
+               rt->worker_flags |= RUNAHEAD_WORKER_FLAG_PRESENT;
+            runloop_st->secondary_core.retro_run();
+         }
+         rt->worker_flags &= ~RUNAHEAD_WORKER_FLAG_PRESENT;
+      }
+      rt->run_time = cpu_features_get_time_usec() - start - rt->unserialize_time;
+
+      slock_lock(rt->lock);
+      rt->flags &= ~RUNAHEAD_THREAD_FLAG_START;
+      scond_signal(rt->cond);
+   }
+   slock_unlock(rt->lock);
+}
+
+static void runahead_thread_free_options(runahead_thread_t *rt)
+{
+   size_t i;
+   for (i = 0; i < rt->num_options; i++)
+   {
+      free(rt->options[i].key);
+      free(rt->options[i].value);
+   }
+   free(rt->options);
+   rt->options     = NULL;
+   rt->options_src = NULL;
+   rt->num_options = 0;
+}
+
+static void runahead_thread_free(runloop_state_t *runloop_st)
+{
+   runahead_thread_t *rt = runloop_st->runahead_thread;
+   if (!rt)
+      return;
+
+   if (rt->thread)
+   {
+      slock_lock(rt->lock);
+      rt->flags |= RUNAHEAD_THREAD_FLAG_QUIT;
+      scond_signal(rt->cond);
+      slock_unlock(rt->lock);
+      sthread_join(rt->thread);
+   }
+   scond_free(rt->cond);
+   slock_free(rt->lock);
+   mylist_destroy(&rt->input);
+   runahead_thread_free_options(rt);
+   free(rt->frame);
+   free(rt);
+   runloop_st->runahead_thread = NULL;
+}
+
+static runahead_thread_t *runahead_thread_new(runloop_state_t *runloop_st)
+{
+   runahead_thread_t *rt = (runahead_thread_t*)calloc(1, sizeof(*rt));
+   if (!rt)
+      return NULL;
+   runloop_st->runahead_thread = rt;
+   if (     !(rt->lock   = slock_new())
+         || !(rt->cond   = scond_new())
+         || !(rt->thread = sthread_create(runahead_thread_loop, rt)))
+   {
+      runahead_thread_free(runloop_st);
+      return NULL;
+   }
+   return rt;
+}
+
+/* Copies the input the primary's last frame ran with into rt->input,
+ * with the ids the core reads replaced by their current values.
+ * Returns true if any of those changed. */
+static bool runahead_thread_snapshot_input(runloop_state_t *runloop_st,
+      runahead_thread_t *rt)
+{
+   int i;
+   bool changed  = false;
+   my_list *list = runloop_st->input_state_list;
+
+   input_driver_poll();
+
+   if (!rt->input)
+      mylist_create(&rt->input, 16,
+            input_list_element_constructor,
+            input_list_element_destructor);
+   if (!list || !rt->input)
+      return !!list;
+   mylist_resize(rt->input, list->size, true);
+   if (rt->input->size != list->size)
+      return true;
+
+   for (i = 0; i < list->size; i++)
+   {
+      unsigned w, words;
+      input_list_element *src = (input_list_element*)list->data[i];
+      input_list_element *dst = (input_list_element*)rt->input->data[i];
+      if (!src || !dst || !input_list_element_realloc(dst, src->state_size))
+      {
+         changed = true;
+         continue;
+      }
+      dst->port   = src->port;
+      dst->device = src->device;
+      dst->index  = src->index;
+      memcpy(dst->state, src->state, src->state_size * sizeof(int16_t));
+
+      words = (src->state_size + 31) / 32;
+      for (w = 0; w < words; w++)
+      {
+         uint32_t bits = src->requested[w];
+         unsigned b;
+         for (b = 0; bits; b++, bits >>= 1)
+         {
+            unsigned id = w * 32 + b;
+            if (bits & 1)
+            {
+               dst->state[id] = input_driver_state_wrapper(
+                     src->port, src->device, src->index, id);
+               if (dst->state[id] != src->state[id])
+                  changed = true;
+            }
+         }
+      }
+   }
+
+   return changed;
+}
+
+/* Copies the core option values into rt->options, unless the copy
+ * already holds them.  'force' rebuilds it anyway, for when the
+ * options may have been replaced at the same address. */
+static void runahead_thread_snapshot_options(runloop_state_t *runloop_st,
+      runahead_thread_t *rt, bool force)
+{
+   size_t i;
+   core_option_manager_t *opts = runloop_st->core_options;
+
+   if (     !force
+         && opts == rt->options_src
+         && (!opts || opts->size == rt->num_options))
+   {
+      for (i = 0; i < rt->num_options; i++)
+         if (opts->opts[i].index != rt->options[i].index)
+            break;
+      if (i == rt->num_options)
+         return;
+   }
+
+   runahead_thread_free_options(rt);
+   if (!opts || !opts->size)
+      return;
+   if (!(rt->options = (struct runahead_option*)
+            calloc(opts->size, sizeof(*rt->options))))
+      return;
+
+   for (i = 0; i < opts->size; i++)
+   {
+      const char *val       = core_option_manager_get_val(opts, i);
+      rt->options[i].key    = opts->opts[i].key ? strdup(opts->opts[i].key) : NULL;
+      rt->options[i].value  = val ? strdup(val) : NULL;
+      rt->options[i].index  = opts->opts[i].index;
+   }
+   rt->num_options = opts->size;
+   rt->options_src = opts;
+}
+
+/* Whether the primary's frame read the same input as
+ * the secondary's frames were given. */
+static bool runahead_thread_input_matches(runloop_state_t *runloop_st,
+      runahead_thread_t *rt)
+{
+   int i;
+   my_list *list = runloop_st->input_state_list;
+
+   if (!list)
+      return true;
+   if (!rt->input || rt->input->size != list->size)
+      return false;
+
+   for (i = 0; i < list->size; i++)
+   {
+      input_list_element *src = (input_list_element*)list->data[i];
+      input_list_element *dst = (input_list_element*)rt->input->data[i];
+      if (!src)
+         continue;
+      if (     !dst
+            || dst->state_size != src->state_size
+            || memcmp(dst->state, src->state,
+               src->state_size * sizeof(int16_t)))
+         return false;
+   }
+   return true;
+}
+
+static void runahead_thread_set_callbacks(runloop_state_t *runloop_st,
+      bool threaded)
+{
+   struct retro_core_t *core    = &runloop_st->secondary_core;
+   struct retro_callbacks *cbs  = &runloop_st->secondary_callbacks;
+   if (threaded)
+   {
+      core->retro_set_video_refresh(runahead_thread_frame);
+      core->retro_set_audio_sample(runahead_thread_audio_sample);
+      core->retro_set_audio_sample_batch(runahead_thread_audio_sample_batch);
+      core->retro_set_input_poll(secondary_core_input_poll_null);
+      core->retro_set_input_state(runahead_thread_input_state);
+   }
+   else
+   {
+      core->retro_set_video_refresh(cbs->frame_cb);
+      core->retro_set_audio_sample(cbs->sample_cb);
+      core->retro_set_audio_sample_batch(cbs->sample_batch_cb);
+      core->retro_set_input_poll(cbs->poll_cb);
+      core->retro_set_input_state(cbs->state_cb);
+   }
+}
+
+/* Runs the primary core's frame on this thread and the second
+ * instance's frames on the worker.  Returns false, before running
+ * anything, if the core has to run on this thread instead. */
+static bool runahead_run_secondary_threaded(runloop_state_t *runloop_st,
+      int runahead_count)
+{
+   bool dirty;
+   runahead_thread_t *rt          = runloop_st->runahead_thread;
+   video_driver_state_t *video_st = video_state_get_ptr();
+   struct retro_hw_render_callback
+      *hwr                        = VIDEO_DRIVER_GET_HW_CONTEXT_INTERNAL(video_st);
+
+   if (hwr->context_type != RETRO_HW_CONTEXT_NONE)
+      return false;
+   if (!rt && !(rt = runahead_thread_new(runloop_st)))
+      return false;
+   if (rt->flags & RUNAHEAD_THREAD_FLAG_DISABLED)
+      return false;
+
+   dirty = runahead_thread_snapshot_input(runloop_st, rt)
+      || !(rt->flags & RUNAHEAD_THREAD_FLAG_SYNCED)
+      ||  (runloop_st->flags & (RUNLOOP_FLAG_INPUT_IS_DIRTY
+                              | RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY));
+
+   rt->flags        &= ~RUNAHEAD_THREAD_FLAG_SYNCED;
+   rt->worker_flags &= ~(RUNAHEAD_WORKER_FLAG_FRAME
+                       | RUNAHEAD_WORKER_FLAG_LOAD_FAILED);
+   rt->state  = NULL;
+   rt->frames = 1;
+   if (dirty)
+   {
+      /* Not run yet, so this is the state before the real frame */
+      if (!runahead_save_state(runloop_st))
+      {
+         const char *_msg = msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_SAVE_STATE);
+         runloop_msg_queue_push(_msg, strlen(_msg), 0, 3 * 60, true, NULL,
+               MESSAGE_QUEUE_ICON_DEFAULT, MESSAGE_QUEUE_CATEGORY_INFO);
+         RARCH_WARN("[Run-Ahead] %s\n", _msg);
+         return true;
+      }
+      rt->state      = runloop_st->runahead_savestate_info.data_const;
+      rt->state_size = runloop_st->runahead_savestate_info.size;
+      rt->frames     = runahead_count + 1;
+   }
+   runahead_thread_snapshot_options(runloop_st, rt,
+         (runloop_st->flags & RUNLOOP_FLAG_HAS_VARIABLE_UPDATE) ? true : false);
+   if (runloop_st->flags & RUNLOOP_FLAG_HAS_VARIABLE_UPDATE)
+   {
+      runloop_st->flags &= ~RUNLOOP_FLAG_HAS_VARIABLE_UPDATE;
+      rt->worker_flags  |=  RUNAHEAD_WORKER_FLAG_VARIABLE_UPDATE;
+   }
+
+   runahead_thread_set_callbacks(runloop_st, true);
+   slock_lock(rt->lock);
+   rt->flags |= RUNAHEAD_THREAD_FLAG_START | RUNAHEAD_THREAD_FLAG_RUNNING;
+   scond_signal(rt->cond);
+   slock_unlock(rt->lock);
+
+   /* run main core with video suspended */
+   video_st->flags &= ~VIDEO_FLAG_ACTIVE;
+   core_run();
+   if (video_st->flags & VIDEO_FLAG_RUNAHEAD_IS_ACTIVE)
+      video_st->flags |=  VIDEO_FLAG_ACTIVE;
+   else
+      video_st->flags &= ~VIDEO_FLAG_ACTIVE;
+
+   slock_lock(rt->lock);
+   while (rt->flags & RUNAHEAD_THREAD_FLAG_START)
+      scond_wait(rt->cond, rt->lock);
+   rt->flags &= ~RUNAHEAD_THREAD_FLAG_RUNNING;
+   slock_unlock(rt->lock);
+   runahead_thread_set_callbacks(runloop_st, false);
+
+   if (rt->state)
+      runahead_stats_add(runloop_st, RUNAHEAD_STAT_UNSERIALIZE,
+            rt->unserialize_time);
+   if (!(rt->worker_flags & RUNAHEAD_WORKER_FLAG_LOAD_FAILED))
+   {
+      int i;
+      for (i = 0; i < rt->frames; i++)
+         runahead_stats_add(runloop_st, RUNAHEAD_STAT_REPLAY,
+               rt->run_time / rt->frames);
+   }
+
+   runloop_st->flags &= ~(RUNLOOP_FLAG_INPUT_IS_DIRTY
+                        | RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY);
+
+   if (rt->worker_flags & RUNAHEAD_WORKER_FLAG_LOAD_FAILED)
+   {
+      const char *_msg = msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_LOAD_STATE);
+      runloop_st->flags &= ~RUNLOOP_FLAG_RUNAHEAD_SECONDARY_CORE_AVAILABLE;
+      runahead_err(runloop_st);
+      runloop_msg_queue_push(_msg, strlen(_msg), 0, 3 * 60, true, NULL,
+            MESSAGE_QUEUE_ICON_DEFAULT, MESSAGE_QUEUE_CATEGORY_INFO);
+      RARCH_WARN("[Run-Ahead] %s\n", _msg);
+      return true;
+   }
+
+   if (rt->worker_flags & RUNAHEAD_WORKER_FLAG_UNSAFE)
+   {
+      if (rt->unsafe_cmd)
+         RARCH_WARN("[Run-Ahead] Core made environment call %u from the "
+               "second instance thread, running it on the main thread.\n",
+               rt->unsafe_cmd);
+      else
+         RARCH_WARN("[Run-Ahead] Core renders in hardware, running the "
+               "second instance on the main thread.\n");
+      rt->flags         |= RUNAHEAD_THREAD_FLAG_DISABLED;
+      runloop_st->flags |= RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY;
+      return true;
+   }
+
+   /* Input that changed after it was sampled, or that the
+    * core read for the first time, is only seen by the primary */
+   if (runahead_thread_input_matches(runloop_st, rt))
+      rt->flags         |= RUNAHEAD_THREAD_FLAG_SYNCED;
+
+   if (rt->worker_flags & RUNAHEAD_WORKER_FLAG_FRAME)
+      video_driver_frame(rt->frame_dupe ? NULL : rt->frame,
+            rt->frame_width, rt->frame_height, rt->frame_pitch);
+   return true;
+}
+#endif
+
+static void runahead_core_run_use_last_input(runloop_state_t *runloop_st,
+      retro_input_state_t state_cb)
 {
+   retro_time_t start;
    struct retro_callbacks *cbs            = &runloop_st->retro_ctx;
    retro_input_poll_t old_poll_function   = cbs->poll_cb;
    retro_input_state_t old_input_function = cbs->state_cb;
 
    cbs->poll_cb                           = retro_input_poll_null;
-   cbs->state_cb                          = input_state_get_last;
+   cbs->state_cb                          = state_cb;
 
    runloop_st->current_core.retro_set_input_poll(cbs->poll_cb);
    runloop_st->current_core.retro_set_input_state(cbs->state_cb);
 
+   start                                  = cpu_features_get_time_usec();
    runloop_st->current_core.retro_run();
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_REPLAY,
+         cpu_features_get_time_usec() - start);
 
    cbs->poll_cb                           = old_poll_function;
    cbs->state_cb                          = old_input_function;
@@ -1171,12 +1932,316 @@ static void runahead_core_run_use_last_input(runloop_state_t *runloop_st)
    runloop_st->current_core.retro_set_input_state(cbs->state_cb);
 }
 
-void runahead_run(void *data,
+/* Incremental run-ahead
+ *
+ * Regular run-ahead runs the real frame and every predicted frame
+ * again on each frame, although with unchanged input the new real
+ * frame is the one that was predicted first the frame before.
+ * Incremental run-ahead keeps a savestate after the real frame and
+ * after each predicted frame.  While the input stays the same it
+ * only runs the one new prediction on top of the last one: one
+ * retro_run() and one retro_serialize() per frame instead of
+ * runahead_count + 1 runs, for a second retro_unserialize() and
+ * runahead_count + 1 savestate buffers.
+ *
+ * Between frames the core is left at the real state, as with
+ * regular run-ahead, so savestates, rewind and achievements never
+ * see a prediction.  The predictions are thrown away and all frames
+ * run again whenever they may be wrong:
+ * - an input the core asked for differs from the value the
+ *   predictions were made with,
+ * - the core was reset or a state was loaded (see the hooks),
+ * - the core's writable memory changed between frames, going by
+ *   page hashes of its memory map (cheats, memory writes from the
+ *   command interface). */
+
+static size_t runahead_memory_regions(runloop_state_t *runloop_st,
+      const uint8_t **ptrs, size_t *lens)
+{
+   unsigned i, j;
+   size_t count                    = 0;
+   const rarch_memory_map_t *mmaps = &runloop_st->system.mmaps;
+
+   for (i = 0; i < mmaps->num_descriptors && count < RUNAHEAD_MAX_REGIONS; i++)
+   {
+      const struct retro_memory_descriptor *desc = &mmaps->descriptors[i].core;
+      const uint8_t *ptr;
+      if (!desc->ptr || !desc->len || (desc->flags & RETRO_MEMDESC_CONST))
+         continue;
+      ptr = (const uint8_t*)desc->ptr + desc->offset;
+      /* Mirrors of the same memory only need checking once */
+      for (j = 0; j < count; j++)
+         if (ptrs[j] == ptr && lens[j] == desc->len)
+            break;
+      if (j < count)
+         continue;
+      ptrs[count]   = ptr;
+      lens[count++] = desc->len;
+   }
+
+   if (!count && runloop_st->current_core.retro_get_memory_data)
+   {
+      ptrs[0] = (const uint8_t*)runloop_st->current_core.retro_get_memory_data(
+            RETRO_MEMORY_SYSTEM_RAM);
+      lens[0] = runloop_st->current_core.retro_get_memory_size(
+            RETRO_MEMORY_SYSTEM_RAM);
+      if (ptrs[0] && lens[0])
+         count = 1;
+   }
+
+   return count;
+}
+
+static uint64_t runahead_hash_page(const uint8_t *data, size_t len)
+{
+   size_t i;
+   uint64_t h = UINT64_C(0xcbf29ce484222325) ^ len;
+   for (i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t))
+   {
+      uint64_t w;
+      memcpy(&w, data + i, sizeof(w));
+      h  = (h ^ w) * UINT64_C(0x100000001b3);
+      h ^= h >> 29;
+   }
+   for (; i < len; i++)
+      h = (h ^ data[i]) * UINT64_C(0x100000001b3);
+   return h;
+}
+
+/* Stores the page hashes of the core's writable memory, or with
+ * 'compare' checks them against the stored ones.  Returns true if
+ * they differ. */
+static bool runahead_chain_hash_memory(runloop_state_t *runloop_st,
+      runahead_chain_t *chain, bool compare)
+{
+   const uint8_t *ptrs[RUNAHEAD_MAX_REGIONS];
+   size_t lens[RUNAHEAD_MAX_REGIONS];
+   size_t r, off;
+   size_t page    = 0;
+   size_t pages   = 0;
+   size_t regions = runahead_memory_regions(runloop_st, ptrs, lens);
+
+   for (r = 0; r < regions; r++)
+      pages += (lens[r] + RUNAHEAD_PAGE_SIZE - 1) / RUNAHEAD_PAGE_SIZE;
+
+   if (compare)
+   {
+      if (pages != chain->page_count)
+         return true;
+   }
+   else if (pages != chain->page_count)
+   {
+      uint64_t *page_hash = (uint64_t*)realloc(chain->page_hash,
+            pages * sizeof(uint64_t));
+      if (pages && !page_hash)
+      {
+         chain->page_count = 0;
+         return true;
+      }
+      chain->page_hash  = page_hash;
+      chain->page_count = pages;
+   }
+
+   for (r = 0; r < regions; r++)
+   {
+      for (off = 0; off < lens[r]; off += RUNAHEAD_PAGE_SIZE, page++)
+      {
+         uint64_t h = runahead_hash_page(ptrs[r] + off,
+               MIN(RUNAHEAD_PAGE_SIZE, lens[r] - off));
+         if (!compare)
+            chain->page_hash[page] = h;
+         else if (chain->page_hash[page] != h)
+            return true;
+      }
+   }
+
+   return false;
+}
+
+/* Whether any input the core has asked for now has a different
+ * value from the one the predictions were made with. */
+static bool runahead_input_changed(runloop_state_t *runloop_st)
+{
+   int i;
+   my_list *list = runloop_st->input_state_list;
+
+   input_driver_poll();
+
+   if (!list)
+      return false;
+
+   for (i = 0; i < list->size; i++)
+   {
+      unsigned w, words;
+      input_list_element *element = (input_list_element*)list->data[i];
+      if (!element)
+         continue;
+      words = (element->state_size + 31) / 32;
+      for (w = 0; w < words; w++)
+      {
+         uint32_t bits = element->requested[w];
+         unsigned b;
+         for (b = 0; bits; b++, bits >>= 1)
+         {
+            unsigned id = w * 32 + b;
+            if (     (bits & 1)
+                  && input_driver_state_wrapper(element->port,
+                     element->device, element->index, id)
+                     != element->state[id])
+               return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+static bool runahead_chain_init(runloop_state_t *runloop_st, int frames)
+{
+   int i;
+   runahead_chain_t *chain;
+
+   runahead_chain_free(runloop_st);
+   if (     frames <= 0
+         || frames > MAX_RUNAHEAD_FRAMES
+         || !runloop_st->runahead_save_state_size
+         || !(chain = (runahead_chain_t*)calloc(1, sizeof(*chain))))
+      return false;
+
+   runloop_st->runahead_chain = chain;
+   chain->state_size          = runloop_st->runahead_save_state_size;
+   chain->frames              = (uint8_t)frames;
+   for (i = 0; i <= frames; i++)
+      if (!(chain->buffer[i] = malloc(chain->state_size)))
+         return false;
+   return true;
+}
+
+static bool runahead_chain_serialize(runloop_state_t *runloop_st,
+      runahead_chain_t *chain, uint64_t frame)
+{
+   bool ret;
+   retro_time_t start = cpu_features_get_time_usec();
+   performance_counter_init(runahead_serialize_perf, "runahead_serialize");
+   performance_counter_start_plus(runloop_st->perfcnt_enable, runahead_serialize_perf);
+   runloop_st->flags |=  RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
+   ret                = runloop_st->current_core.retro_serialize(
+         chain->buffer[frame % (chain->frames + 1)], chain->state_size);
+   runloop_st->flags &= ~RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
+   performance_counter_stop_plus(runloop_st->perfcnt_enable, runahead_serialize_perf);
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_SERIALIZE,
+         cpu_features_get_time_usec() - start);
+   return ret;
+}
+
+/* Bypasses runahead_unserialize_hook(): loading our own states
+ * does not make the input dirty. */
+static bool runahead_chain_unserialize(runloop_state_t *runloop_st,
+      runahead_chain_t *chain, uint64_t frame)
+{
+   bool ret;
+   runahead_load_state_function unserialize =
+         runloop_st->retro_unserialize_callback_original
+       ? runloop_st->retro_unserialize_callback_original
+       : runloop_st->current_core.retro_unserialize;
+   retro_time_t start = cpu_features_get_time_usec();
+   performance_counter_init(runahead_unserialize_perf, "runahead_unserialize");
+   performance_counter_start_plus(runloop_st->perfcnt_enable, runahead_unserialize_perf);
+   runloop_st->flags |=  RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
+   ret                = unserialize(
+         chain->buffer[frame % (chain->frames + 1)], chain->state_size);
+   runloop_st->flags &= ~RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE;
+   performance_counter_stop_plus(runloop_st->perfcnt_enable, runahead_unserialize_perf);
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_UNSERIALIZE,
+         cpu_features_get_time_usec() - start);
+   return ret;
+}
+
+/* Returns NULL on success, or the message to show on failure. */
+static const char *runahead_chain_run(runloop_state_t *runloop_st,
+      int runahead_count)
+{
+   int frame_number;
+   runahead_chain_t *chain        = runloop_st->runahead_chain;
+   video_driver_state_t *video_st = video_state_get_ptr();
+   audio_driver_state_t *audio_st = audio_state_get_ptr();
+
+   if (!chain || chain->frames != runahead_count)
+   {
+      if (!runahead_chain_init(runloop_st, runahead_count))
+         return msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_SAVE_STATE);
+      chain = runloop_st->runahead_chain;
+   }
+
+   if (     chain->valid
+         && !(runloop_st->flags & (RUNLOOP_FLAG_INPUT_IS_DIRTY
+                                 | RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY))
+         && !runahead_chain_hash_memory(runloop_st, chain, true)
+         && !runahead_input_changed(runloop_st))
+   {
+      /* This real frame was predicted last time;
+       * only the newest prediction needs running. */
+      chain->valid = false;
+      if (!runahead_chain_unserialize(runloop_st, chain,
+               chain->frame + runahead_count))
+         return msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_LOAD_STATE);
+      runahead_core_run_use_last_input(runloop_st,
+            runahead_input_state_get_last_requested);
+      chain->frame++;
+      if (!runahead_chain_serialize(runloop_st, chain,
+               chain->frame + runahead_count))
+         return msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_SAVE_STATE);
+   }
+   else
+   {
+      chain->valid = false;
+      for (frame_number = 0; frame_number <= runahead_count; frame_number++)
+      {
+         bool suspended_frame = frame_number < runahead_count;
+
+         if (suspended_frame)
+         {
+            audio_st->flags     |=  AUDIO_FLAG_SUSPENDED;
+            video_st->flags     &= ~VIDEO_FLAG_ACTIVE;
+         }
+
+         if (frame_number == 0)
+            core_run();
+         else
+            runahead_core_run_use_last_input(runloop_st,
+                  runahead_input_state_get_last_requested);
+
+         if (suspended_frame)
+         {
+            if (video_st->flags & VIDEO_FLAG_RUNAHEAD_IS_ACTIVE)
+               video_st->flags |=  VIDEO_FLAG_ACTIVE;
+            else
+               video_st->flags &= ~VIDEO_FLAG_ACTIVE;
+
+            audio_st->flags    &= ~AUDIO_FLAG_SUSPENDED;
+         }
+
+         if (!runahead_chain_serialize(runloop_st, chain,
+                  chain->frame + 1 + frame_number))
+            return msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_SAVE_STATE);
+      }
+      chain->frame++;
+   }
+
+   if (!runahead_chain_unserialize(runloop_st, chain, chain->frame))
+      return msg_hash_to_str(MSG_RUNAHEAD_FAILED_TO_LOAD_STATE);
+   runahead_chain_hash_memory(runloop_st, chain, false);
+   chain->valid       = true;
+   runloop_st->flags &= ~RUNLOOP_FLAG_INPUT_IS_DIRTY;
+   return NULL;
+}
+
+static void runahead_run_frame(runloop_state_t *runloop_st,
       int runahead_count,
       bool runahead_hide_warnings,
-      bool use_secondary)
+      bool use_secondary,
+      bool incremental)
 {
-   runloop_state_t *runloop_st = (runloop_state_t*)data;
    int frame_number        = 0;
    bool last_frame         = false;
    bool suspended_frame    = false;
@@ -1241,8 +2306,27 @@ void runahead_run(void *data,
          || !have_dynamic
          || !(runloop_st->flags & RUNLOOP_FLAG_RUNAHEAD_SECONDARY_CORE_AVAILABLE))
    {
-      /* TODO: multiple savestates for higher performance
-       * when not using secondary core */
+#ifdef HAVE_CHEATS
+      /* Core cheats change what the predicted frames would do */
+      if (cheat_manager_get_size())
+         incremental = false;
+#endif
+      if (incremental)
+      {
+         const char *_msg = runahead_chain_run(runloop_st, runahead_count);
+         if (_msg)
+         {
+            runahead_err(runloop_st);
+            runloop_msg_queue_push(_msg, strlen(_msg), 0, 3 * 60, true, NULL,
+                  MESSAGE_QUEUE_ICON_DEFAULT, MESSAGE_QUEUE_CATEGORY_INFO);
+            RARCH_WARN("[Run-Ahead] %s\n", _msg);
+            return;
+         }
+         runloop_st->flags &= ~RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY;
+         return;
+      }
+
+      runahead_chain_free(runloop_st);
       for (frame_number = 0; frame_number <= runahead_count; frame_number++)
       {
          last_frame      = frame_number == runahead_count;
@@ -1257,7 +2341,8 @@ void runahead_run(void *data,
          if (frame_number == 0)
             core_run();
          else
-            runahead_core_run_use_last_input(runloop_st);
+            runahead_core_run_use_last_input(runloop_st,
+                  input_state_get_last);
 
          if (suspended_frame)
          {
@@ -1310,6 +2395,18 @@ void runahead_run(void *data,
          goto force_input_dirty;
       }
 
+#ifdef HAVE_THREADS
+      /* Falls through to the serial path for cores that
+       * cannot run on the worker */
+      if (settings->bools.run_ahead_secondary_threaded)
+      {
+         if (runahead_run_secondary_threaded(runloop_st, runahead_count))
+            return;
+      }
+      else
+         runahead_thread_free(runloop_st);
+#endif
+
       /* run main core with video suspended */
       video_st->flags &= ~VIDEO_FLAG_ACTIVE;
       core_run();
@@ -1376,6 +2473,23 @@ force_input_dirty:
    runloop_st->flags |=  RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY;
 }
 
+void runahead_run(void *data,
+      int runahead_count,
+      bool runahead_hide_warnings,
+      bool use_secondary,
+      bool incremental)
+{
+   runloop_state_t *runloop_st = (runloop_state_t*)data;
+   retro_time_t start          = cpu_features_get_time_usec();
+   performance_counter_init(runahead_frame_perf, "runahead_frame");
+   performance_counter_start_plus(runloop_st->perfcnt_enable, runahead_frame_perf);
+   runahead_run_frame(runloop_st, runahead_count, runahead_hide_warnings,
+         use_secondary, incremental);
+   performance_counter_stop_plus(runloop_st->perfcnt_enable, runahead_frame_perf);
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_FRAME,
+         cpu_features_get_time_usec() - start);
+}
+
 /* Preemptive Frames */
 
 static int16_t preempt_input_state(unsigned port,
@@ -1428,6 +2542,7 @@ static const char* preempt_allocate(runloop_state_t *runloop_st,
 
    preempt->state_size = info_size;
    preempt->frames     = frames;
+   preempt->buffers    = frames;
 
    for (i = 0; i < frames; i++)
    {
@@ -1455,7 +2570,7 @@ void preempt_deinit(void *data)
       return;
 
    /* Free memory */
-   for (i = 0; i < preempt->frames; i++)
+   for (i = 0; i < preempt->buffers; i++)
       free(preempt->buffer[i]);
 
    free(preempt);
@@ -1512,6 +2627,7 @@ bool preempt_init(void *data)
    /* Allocate - same 'frames' setting as runahead */
    if ((_msg = preempt_allocate(runloop_st, run_ahead_frames)))
       goto error;
+   runahead_stats_reset(runloop_st);
 
    /* Only poll in preempt_run() */
    runloop_st->current_core.retro_set_input_poll(retro_input_poll_null);
@@ -1669,6 +2785,22 @@ void preempt_run(preempt_t *preempt, void *data)
    settings_t *settings              = config_get_ptr();
    unsigned input_max_users          = settings->uints.input_max_users;
    bool run_ahead_hide_warnings      = settings->bools.run_ahead_hide_warnings;
+   retro_time_t frame_start          = cpu_features_get_time_usec();
+   retro_time_t start;
+
+   if (settings->bools.run_ahead_frames_auto)
+   {
+      unsigned frames = runahead_auto_frames(runloop_st,
+            preempt->buffers, true);
+      /* The saved states are in ring order for the old count,
+       * so start filling them again */
+      if (frames != preempt->frames)
+      {
+         preempt->frames      = frames;
+         preempt->start_ptr   = 0;
+         preempt->frame_count = 0;
+      }
+   }
 
    /* Poll and check for dirty input */
    preempt_input_poll(preempt, runloop_st, input_max_users);
@@ -1682,26 +2814,38 @@ void preempt_run(preempt_t *preempt, void *data)
       audio_st->flags |=  AUDIO_FLAG_SUSPENDED;
       video_st->flags &= ~VIDEO_FLAG_ACTIVE;
 
+      start = cpu_features_get_time_usec();
       if (!current_core->retro_unserialize(
             preempt->buffer[preempt->start_ptr], preempt->state_size))
       {
          _msg = msg_hash_to_str(MSG_PREEMPT_FAILED_TO_LOAD_STATE);
          goto error;
       }
+      runahead_stats_add(runloop_st, RUNAHEAD_STAT_UNSERIALIZE,
+            cpu_features_get_time_usec() - start);
 
+      start = cpu_features_get_time_usec();
       current_core->retro_run();
+      runahead_stats_add(runloop_st, RUNAHEAD_STAT_REPLAY,
+            cpu_features_get_time_usec() - start);
       preempt->replay_ptr = PREEMPT_NEXT_PTR(preempt->start_ptr);
 
       while (preempt->replay_ptr != preempt->start_ptr)
       {
+         start = cpu_features_get_time_usec();
          if (!current_core->retro_serialize(
                preempt->buffer[preempt->replay_ptr], preempt->state_size))
          {
             _msg = msg_hash_to_str(MSG_PREEMPT_FAILED_TO_SAVE_STATE);
             goto error;
          }
+         runahead_stats_add(runloop_st, RUNAHEAD_STAT_SERIALIZE,
+               cpu_features_get_time_usec() - start);
 
+         start = cpu_features_get_time_usec();
          current_core->retro_run();
+         runahead_stats_add(runloop_st, RUNAHEAD_STAT_REPLAY,
+               cpu_features_get_time_usec() - start);
          preempt->replay_ptr = PREEMPT_NEXT_PTR(preempt->replay_ptr);
       }
 
@@ -1710,12 +2854,15 @@ void preempt_run(preempt_t *preempt, void *data)
    }
 
    /* Save current state and set start_ptr to oldest state */
+   start = cpu_features_get_time_usec();
    if (!current_core->retro_serialize(
          preempt->buffer[preempt->start_ptr], preempt->state_size))
    {
       _msg = msg_hash_to_str(MSG_PREEMPT_FAILED_TO_SAVE_STATE);
       goto error;
    }
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_SERIALIZE,
+         cpu_features_get_time_usec() - start);
 
    preempt->start_ptr = PREEMPT_NEXT_PTR(preempt->start_ptr);
    runloop_st->flags &= ~(RUNLOOP_FLAG_REQUEST_SPECIAL_SAVESTATE
@@ -1724,6 +2871,8 @@ void preempt_run(preempt_t *preempt, void *data)
    /* Run normal frame */
    current_core->retro_run();
    preempt->frame_count++;
+   runahead_stats_add(runloop_st, RUNAHEAD_STAT_FRAME,
+         cpu_features_get_time_usec() - frame_start);
    return;
 
 error:
@@ -1750,4 +2899,120 @@ void runahead_clear_variables(void *data)
                                           | RUNLOOP_FLAG_RUNAHEAD_SECONDARY_CORE_AVAILABLE
                                           | RUNLOOP_FLAG_RUNAHEAD_FORCE_INPUT_DIRTY;
    runloop_st->runahead_last_frame_count  = 0;
+   runahead_stats_reset(runloop_st);
+}
+
+void runahead_stats_reset(void *data)
+{
+   runloop_state_t *runloop_st = (runloop_state_t*)data;
+   memset(&runloop_st->runahead_stats, 0, sizeof(runloop_st->runahead_stats));
+}
+
+/* Frames between automatic frame count changes, and the samples
+ * needed before the first one */
+#define RUNAHEAD_AUTO_INTERVAL 64
+
+/* Microseconds the core may use per frame.  With Automatic Frame
+ * Delay the reserve it keeps for everything else is known; without
+ * it, a quarter of the frame is left for the frontend. */
+static retro_time_t runahead_frame_budget(settings_t *settings)
+{
+   video_driver_state_t *video_st = video_state_get_ptr();
+   float refresh_rate             = settings->floats.video_refresh_rate;
+   retro_time_t frame_time_target;
+
+   refresh_rate = refresh_rate
+         / (settings->uints.video_black_frame_insertion + 1.0f)
+         / runloop_get_video_swap_interval(settings->uints.video_swap_interval)
+         / MAX(settings->uints.video_shader_subframes, 1);
+   if (refresh_rate <= 0.0f)
+      return 0;
+   frame_time_target = 1000000.0f / refresh_rate;
+
+   if (     settings->bools.video_frame_delay_auto
+         && video_st->frame_time_reserve > 0
+         && video_st->frame_time_reserve < frame_time_target)
+      return frame_time_target - video_st->frame_time_reserve;
+   return frame_time_target - frame_time_target / 4;
+}
+
+unsigned runahead_auto_frames(void *data, unsigned max_frames, bool preempt)
+{
+   runloop_state_t *runloop_st = (runloop_state_t*)data;
+   runahead_stats_t *stats     = &runloop_st->runahead_stats;
+   unsigned frames             = stats->frames ? stats->frames : 1;
+   retro_time_t budget, fixed, per_frame;
+   unsigned best;
+
+   if (!max_frames)
+      return 0;
+   frames = MIN(frames, max_frames);
+
+   if (     ++stats->tune_frames >= RUNAHEAD_AUTO_INTERVAL
+         && stats->hist[RUNAHEAD_STAT_REPLAY].count >= RUNAHEAD_AUTO_INTERVAL
+         && (budget = runahead_frame_budget(config_get_ptr())) > 0)
+   {
+      /* Worst case, a frame with changed input: a load, the real
+       * frame and one run per frame ahead, each of which is saved
+       * first with preemptive frames.  Single-instance run-ahead
+       * saves once either way. */
+      retro_time_t replay    = runahead_stats_percentile(runloop_st, RUNAHEAD_STAT_REPLAY, 95);
+      retro_time_t save      = runahead_stats_percentile(runloop_st, RUNAHEAD_STAT_SERIALIZE, 95);
+      retro_time_t load      = runahead_stats_percentile(runloop_st, RUNAHEAD_STAT_UNSERIALIZE, 95);
+      retro_time_t frame_p95 = runahead_stats_percentile(runloop_st, RUNAHEAD_STAT_FRAME, 95);
+
+      per_frame = preempt ? replay + save : replay;
+      fixed     = replay + save + load;
+      best      = (budget > fixed && per_frame > 0)
+            ? (unsigned)MIN((budget - fixed) / per_frame, max_frames)
+            : 1;
+      best      = MAX(best, 1);
+
+      stats->tune_frames = 0;
+      if (frame_p95 > budget)
+         best = MIN(best, MAX(frames - 1, 1));
+      else if (best > frames)
+         /* Step up one frame at a time, the estimate is taken
+          * at the current count */
+         best = frames + 1;
+
+      if (best != frames)
+      {
+         RARCH_DBG("[Run-Ahead] Automatic frame count %u -> %u "
+               "(budget %d us, frame p95 %d us).\n",
+               frames, best, (int)budget, (int)frame_p95);
+         memset(&stats->hist[RUNAHEAD_STAT_FRAME], 0,
+               sizeof(stats->hist[RUNAHEAD_STAT_FRAME]));
+         frames = best;
+      }
+   }
+
+   stats->frames = frames;
+   return frames;
+}
+
+size_t runahead_stats_print(void *data, char *s, size_t len)
+{
+   static const char *names[RUNAHEAD_STAT_LAST] = {
+      "Save", "Load", "Replay", "Frame"
+   };
+   runloop_state_t *runloop_st = (runloop_state_t*)data;
+   size_t _len                 = 0;
+   unsigned i;
+
+   for (i = 0; i < RUNAHEAD_STAT_LAST && _len < len; i++)
+   {
+      int ret;
+      if (!runloop_st->runahead_stats.hist[i].count)
+         continue;
+      ret = snprintf(s + _len, len - _len,
+            " - %-7s p50 %5.2f p95 %5.2f ms\n",
+            names[i],
+            runahead_stats_percentile(runloop_st, (enum runahead_stat)i, 50) / 1000.0f,
+            runahead_stats_percentile(runloop_st, (enum runahead_stat)i, 95) / 1000.0f);
+      if (ret < 0)
+         break;
+      _len += MIN((size_t)ret, len - _len - 1);
+   }
+   return _len;
 }
@@ -64,8 +64,70 @@ typedef struct preemptive_frames_data
    uint8_t replay_ptr;
    /* Number of latency frames to remove */
    uint8_t frames;
+   /* Number of buffers allocated, the most 'frames' can be */
+   uint8_t buffers;
 } preempt_t;
 
+/* Incremental run-ahead: states after the real frame and each
+ * predicted frame after it, so predictions can be carried over
+ * to the next frame while the input stays the same. */
+typedef struct runahead_chain_data
+{
+   /* Savestates, indexed by frame number modulo (frames + 1) */
+   void *buffer[MAX_RUNAHEAD_FRAMES + 1];
+   size_t state_size;
+
+   /* Page hashes of the core's writable memory, taken when the
+    * real state was last restored */
+   uint64_t *page_hash;
+   size_t page_count;
+
+   /* Number of the last real frame */
+   uint64_t frame;
+
+   /* Number of predicted frames kept */
+   uint8_t frames;
+   /* Buffers hold the real state and 'frames' predictions */
+   bool valid;
+} runahead_chain_t;
+
+/* Worker thread running the second instance alongside the
+ * primary core (see runahead.c) */
+typedef struct runahead_thread runahead_thread_t;
+
+#define RUNAHEAD_STATS_SAMPLES 128
+#define RUNAHEAD_STATS_BUCKETS 64
+
+enum runahead_stat
+{
+   RUNAHEAD_STAT_SERIALIZE = 0,
+   RUNAHEAD_STAT_UNSERIALIZE,
+   /* Frames run with A/V suspended, to predict or replay */
+   RUNAHEAD_STAT_REPLAY,
+   /* Everything run in place of core_run() */
+   RUNAHEAD_STAT_FRAME,
+   RUNAHEAD_STAT_LAST
+};
+
+/* The last RUNAHEAD_STATS_SAMPLES times in microseconds, and how
+ * many of them fall in each quarter octave */
+typedef struct runahead_histogram
+{
+   uint32_t sample[RUNAHEAD_STATS_SAMPLES];
+   uint16_t bucket[RUNAHEAD_STATS_BUCKETS];
+   uint16_t count;
+   uint16_t next;
+} runahead_histogram_t;
+
+typedef struct runahead_stats
+{
+   runahead_histogram_t hist[RUNAHEAD_STAT_LAST];
+   /* Frames since the frame count was last tuned */
+   uint16_t tune_frames;
+   /* Frame count picked by automatic tuning, 0 until picked */
+   uint8_t frames;
+} runahead_stats_t;
+
 RETRO_BEGIN_DECLS
 
 typedef bool(*runahead_load_state_function)(const void*, size_t);
@@ -74,10 +136,27 @@ void runahead_run(
       void *data,
       int runahead_count,
       bool runahead_hide_warnings,
-      bool use_secondary);
+      bool use_secondary,
+      bool incremental);
 
 void runahead_clear_variables(void *data);
 
+void runahead_stats_reset(void *data);
+
+/**
+ * runahead_auto_frames:
+ * @max_frames : most frames to run ahead
+ * @preempt    : tuning for preemptive frames
+ *
+ * Call once per frame with automatic frame count enabled.
+ *
+ * @return the largest frame count up to @max_frames whose measured
+ * cost fits in the time the core has per frame.
+ **/
+unsigned runahead_auto_frames(void *data, unsigned max_frames, bool preempt);
+
+size_t runahead_stats_print(void *data, char *s, size_t len);
+
 void runahead_remember_controller_port_device(void *data,
       long port, long device);
 void runahead_clear_controller_port_map(void *data);
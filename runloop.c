@@ -7689,12 +7689,17 @@ int runloop_iterate(void)
       want_runahead                     = want_runahead && !netplay_is_enabled;
 #endif
 
+      if (want_runahead && settings->bools.run_ahead_frames_auto)
+         run_ahead_num_frames           = runahead_auto_frames(
+               runloop_st, run_ahead_num_frames, false);
+
       if (want_runahead)
          runahead_run(
                runloop_st,
                run_ahead_num_frames,
                run_ahead_hide_warnings,
-               run_ahead_secondary_instance);
+               run_ahead_secondary_instance,
+               settings->bools.run_ahead_incremental);
       else if (runloop_st->preempt_data)
          preempt_run(runloop_st->preempt_data, runloop_st);
       else
@@ -192,6 +192,9 @@ struct runloop
    retro_ctx_serialize_info_t runahead_savestate_info;
    my_list *input_state_list;
    preempt_t *preempt_data;
+   runahead_chain_t *runahead_chain;
+   runahead_thread_t *runahead_thread;
+   runahead_stats_t runahead_stats;
 #endif
 
 #ifdef HAVE_REWIND
@@ -0,0 +1,331 @@
+/* Benchmark and cross-check for the mixing kernels
+ * (libretro-common/audio/audio_mix.c) and for audio_mixer_mix().
+ *
+ *   audio_mix_bench [seconds]
+ *
+ * Each kernel set this build and CPU support is first checked
+ * against the C one on odd lengths, so every tail is covered.
+ * Then, for 1 to 16 voices, the benchmark times one output block
+ * mixed as the mixer used to, one audio_mix_volume() per voice,
+ * against one audio_mix_volume_batch() over all of them, and
+ * last the whole of audio_mixer_mix() with up to its 8 voices
+ * playing WAV sounds.  Times are ns per output frame.
+ *
+ * Exit status is non-zero if a kernel set strays from the C one
+ * or audio_mixer_mix() mixes differently with it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <audio/audio_mix.h>
+#include <audio/audio_mixer.h>
+
+/* Output block per call, about what a driver asks for, mixed
+ * in pieces the size audio_mixer_mix() uses. */
+#define BLOCK_FRAMES   1024
+#define CHUNK_SAMPLES  512
+#define MAX_SOURCES    16
+#define MIXER_VOICES   8
+/* Samples for the cross-checks; odd, so no kernel ends on a
+ * whole vector. */
+#define CHECK_SAMPLES  1037
+
+/* Kernels may round differently only where the compiler fuses a
+ * multiply and an add on its own, as on ARM. */
+#define MAX_KERNEL_DIFF 1e-6
+
+static float sources[MAX_SOURCES][BLOCK_FRAMES * 2];
+static float gains[MAX_SOURCES];
+static double seconds = 0.2;
+static int failures   = 0;
+
+/* The sounds are played at the mixer's rate, so it never asks
+ * for a resampler, and audio_mix.c's WAV file loader is not
+ * used. */
+bool retro_resampler_realloc(void **re, const retro_resampler_t **backend,
+      const char *ident, enum resampler_quality quality, double ratio)
+{
+   return false;
+}
+
+int64_t filestream_read_file(const char *path, void **buf, int64_t *len)
+{
+   return 0;
+}
+
+static uint32_t rng_state = 0x2545f491u;
+
+static float rng_float(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return (float)(rng_state >> 8) / (float)(1 << 23) * 2.0f - 1.0f;
+}
+
+static double max_diff(const float *a, const float *b, size_t len)
+{
+   size_t i;
+   double diff = 0.0;
+   for (i = 0; i < len; i++)
+      if (fabs((double)a[i] - b[i]) > diff)
+         diff = fabs((double)a[i] - b[i]);
+   return diff;
+}
+
+/* Runs every kernel of the current set and of the C set on the
+ * same input.  Returns the largest difference. */
+static double check_kernels(void)
+{
+   static float ref[CHECK_SAMPLES * 2];
+   static float out[CHECK_SAMPLES * 2];
+   static float base[CHECK_SAMPLES];
+   static int16_t s16[CHECK_SAMPLES * 2];
+   const float *src[MAX_SOURCES];
+   enum audio_mix_impl impl = audio_mix_get_impl();
+   double diff              = 0.0;
+   unsigned count, channels;
+   size_t i;
+
+   for (i = 0; i < CHECK_SAMPLES; i++)
+      base[i] = rng_float() * 1.5f;
+   for (i = 0; i < CHECK_SAMPLES * 2; i++)
+      s16[i]  = (int16_t)(rng_float() * 32767.0f);
+   s16[0] = -32768;
+   s16[1] = 32767;
+   for (count = 0; count < MAX_SOURCES; count++)
+      src[count] = sources[count];
+
+   for (count = 1; count <= MAX_SOURCES; count++)
+   {
+      memcpy(ref, base, sizeof(base));
+      memcpy(out, base, sizeof(base));
+      audio_mix_set_impl(AUDIO_MIX_IMPL_C);
+      audio_mix_volume_batch(ref, src, gains, count, CHECK_SAMPLES);
+      audio_mix_set_impl(impl);
+      audio_mix_volume_batch(out, src, gains, count, CHECK_SAMPLES);
+      diff = MAX(diff, max_diff(ref, out, CHECK_SAMPLES));
+
+      /* The batch must add up like one voice after another. */
+      memcpy(out, base, sizeof(base));
+      for (i = 0; i < count; i++)
+         audio_mix_volume(out, src[i], gains[i], CHECK_SAMPLES);
+      diff = MAX(diff, max_diff(ref, out, CHECK_SAMPLES));
+   }
+
+   memcpy(ref, base, sizeof(base));
+   memcpy(out, base, sizeof(base));
+   audio_mix_set_impl(AUDIO_MIX_IMPL_C);
+   audio_mix_clamp(ref, CHECK_SAMPLES);
+   audio_mix_set_impl(impl);
+   audio_mix_clamp(out, CHECK_SAMPLES);
+   diff = MAX(diff, max_diff(ref, out, CHECK_SAMPLES));
+
+   for (channels = 1; channels <= 2; channels++)
+   {
+      audio_mix_set_impl(AUDIO_MIX_IMPL_C);
+      audio_mix_s16_to_float_stereo(ref, s16, CHECK_SAMPLES, channels);
+      audio_mix_set_impl(impl);
+      audio_mix_s16_to_float_stereo(out, s16, CHECK_SAMPLES, channels);
+      diff = MAX(diff, max_diff(ref, out, CHECK_SAMPLES * 2));
+   }
+
+   return diff;
+}
+
+/* ns per output frame mixing 'count' sources, one call per
+ * source or one batch per chunk. */
+static double time_mix(unsigned count, bool batch)
+{
+   static float out[BLOCK_FRAMES * 2];
+   const float *src[MAX_SOURCES];
+   retro_time_t start   = cpu_features_get_time_usec();
+   retro_time_t elapsed = 0;
+   size_t blocks        = 0;
+   unsigned v;
+
+   do
+   {
+      size_t pos;
+      memset(out, 0, sizeof(out));
+      for (pos = 0; pos < BLOCK_FRAMES * 2; pos += CHUNK_SAMPLES)
+      {
+         if (batch)
+         {
+            for (v = 0; v < count; v++)
+               src[v] = sources[v] + pos;
+            audio_mix_volume_batch(out + pos, src, gains, count,
+                  CHUNK_SAMPLES);
+         }
+         else
+            for (v = 0; v < count; v++)
+               audio_mix_volume(out + pos, sources[v] + pos, gains[v],
+                     CHUNK_SAMPLES);
+      }
+      blocks++;
+      elapsed = cpu_features_get_time_usec() - start;
+   } while (elapsed < seconds * 1000000.0);
+
+   return elapsed * 1000.0 / ((double)blocks * BLOCK_FRAMES);
+}
+
+/* A 48 kHz 16-bit stereo WAV of noise. */
+static void *make_wav(size_t frames, int32_t *size)
+{
+   size_t i;
+   uint32_t data_size = (uint32_t)(frames * 4);
+   uint8_t *wav       = (uint8_t*)malloc(44 + data_size);
+   uint8_t *p         = wav;
+
+   if (!wav)
+      return NULL;
+
+#define PUT32(v) do { uint32_t _v = (v); *p++ = _v & 0xff; *p++ = (_v >> 8) & 0xff; \
+      *p++ = (_v >> 16) & 0xff; *p++ = _v >> 24; } while (0)
+#define PUT16(v) do { unsigned _v = (v); *p++ = _v & 0xff; *p++ = (_v >> 8) & 0xff; } while (0)
+   memcpy(p, "RIFF", 4); p += 4;
+   PUT32(36 + data_size);
+   memcpy(p, "WAVEfmt ", 8); p += 8;
+   PUT32(16);
+   PUT16(1);            /* PCM */
+   PUT16(2);
+   PUT32(48000);
+   PUT32(48000 * 4);
+   PUT16(4);
+   PUT16(16);
+   memcpy(p, "data", 4); p += 4;
+   PUT32(data_size);
+   for (i = 0; i < frames * 2; i++)
+      PUT16((uint16_t)(int16_t)(rng_float() * 16000.0f));
+#undef PUT32
+#undef PUT16
+
+   *size = (int32_t)(44 + data_size);
+   return wav;
+}
+
+/* ns per output frame of audio_mixer_mix() with 'count' voices
+ * on repeat; the first block is kept in 'first' to compare. */
+static double time_mixer(audio_mixer_sound_t **sounds, unsigned count,
+      float *first)
+{
+   static float out[BLOCK_FRAMES * 2];
+   audio_mixer_voice_t *voices[MIXER_VOICES];
+   retro_time_t start, elapsed = 0;
+   size_t blocks               = 0;
+   unsigned v;
+
+   for (v = 0; v < count; v++)
+      voices[v] = audio_mixer_play(sounds[v], true, gains[v], NULL,
+            RESAMPLER_QUALITY_DONTCARE, NULL);
+
+   memset(first, 0, sizeof(out));
+   audio_mixer_mix(first, BLOCK_FRAMES, 0.0f, false);
+
+   start = cpu_features_get_time_usec();
+   do
+   {
+      memset(out, 0, sizeof(out));
+      audio_mixer_mix(out, BLOCK_FRAMES, 0.0f, false);
+      blocks++;
+      elapsed = cpu_features_get_time_usec() - start;
+   } while (elapsed < seconds * 1000000.0);
+
+   for (v = 0; v < count; v++)
+      audio_mixer_stop(voices[v]);
+
+   return elapsed * 1000.0 / ((double)blocks * BLOCK_FRAMES);
+}
+
+int main(int argc, char *argv[])
+{
+   static const unsigned counts[] = { 1, 2, 3, 4, 6, 8, 12, 16 };
+   static float mixer_ref[MIXER_VOICES][BLOCK_FRAMES * 2];
+   static float mixer_out[BLOCK_FRAMES * 2];
+   audio_mixer_sound_t *sounds[MIXER_VOICES];
+   int impl;
+   size_t i;
+   unsigned v;
+
+   if (argc > 2 || (argc == 2 && (seconds = atof(argv[1])) <= 0.0))
+   {
+      fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+      return 1;
+   }
+
+   for (v = 0; v < MAX_SOURCES; v++)
+   {
+      for (i = 0; i < BLOCK_FRAMES * 2; i++)
+         sources[v][i] = rng_float();
+      gains[v] = 0.1f + 0.05f * v;
+   }
+
+   audio_mixer_init(48000);
+   for (v = 0; v < MIXER_VOICES; v++)
+   {
+      int32_t size = 0;
+      /* Over a block long, and different lengths so the voices
+       * loop at different points. */
+      void *wav = make_wav(3 * BLOCK_FRAMES + 333 * v, &size);
+      sounds[v] = audio_mixer_load_wav(wav, size, NULL,
+            RESAMPLER_QUALITY_DONTCARE);
+      free(wav);
+   }
+
+   for (impl = AUDIO_MIX_IMPL_C; impl < AUDIO_MIX_IMPL_LAST; impl++)
+   {
+      const char *name = audio_mix_impl_name((enum audio_mix_impl)impl);
+      unsigned c;
+      double diff;
+
+      if (!audio_mix_set_impl((enum audio_mix_impl)impl))
+      {
+         printf("%s: not supported\n\n", name);
+         continue;
+      }
+
+      diff = check_kernels();
+      printf("%s: max diff from C %.2e%s\n", name, diff,
+            diff > MAX_KERNEL_DIFF ? "   FAIL" : "");
+      if (diff > MAX_KERNEL_DIFF)
+         failures++;
+
+      printf("   voices   per voice      batch  (ns/frame)\n");
+      for (c = 0; c < ARRAY_SIZE(counts); c++)
+         printf("   %6u %11.2f %10.2f\n", counts[c],
+               time_mix(counts[c], false), time_mix(counts[c], true));
+
+      printf("   voices   audio_mixer_mix\n");
+      for (v = 1; v <= MIXER_VOICES; v++)
+      {
+         double ns = time_mixer(sounds, v, mixer_out);
+
+         if (impl == AUDIO_MIX_IMPL_C)
+            memcpy(mixer_ref[v - 1], mixer_out, sizeof(mixer_out));
+         diff = max_diff(mixer_ref[v - 1], mixer_out, BLOCK_FRAMES * 2);
+         printf("   %6u %11.2f%s\n", v, ns,
+               diff > MAX_KERNEL_DIFF ? "   FAIL: differs from C" : "");
+         if (diff > MAX_KERNEL_DIFF)
+            failures++;
+      }
+      printf("\n");
+   }
+
+   for (v = 0; v < MIXER_VOICES; v++)
+      audio_mixer_destroy(sounds[v]);
+   audio_mixer_done();
+
+   if (failures)
+   {
+      printf("%d kernel check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
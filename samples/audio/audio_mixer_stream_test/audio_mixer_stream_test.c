@@ -0,0 +1,411 @@
+/* Test for the decode worker and the PCM cache in
+ * libretro-common/audio/audio_mixer.c.
+ *
+ * FLAC sounds are built in memory out of verbatim subframes, so
+ * the decoded samples are known exactly, and played through the
+ * mixer a few hundred frames per call with a short sleep in
+ * between, as an audio driver would:
+ *   - a long sound, which is streamed through the worker's ring,
+ *   - the same played on repeat until it has looped,
+ *   - a short sound, played on two voices at once, streamed while
+ *     the worker decodes it into the cache, and again from the
+ *     cache after that,
+ *   - short sounds destroyed straight after they are played, while
+ *     the worker may still be decoding them.
+ * Every sample of the pattern is non-zero, so silence in the mix
+ * can only be the worker falling behind.  That is reported but
+ * not a failure; samples lost, duplicated or out of order are.
+ *
+ * Build with SANITIZER=thread to check the worker for races. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <retro_timers.h>
+#include <audio/audio_mixer.h>
+
+#define RATE          48000
+#define MIX_FRAMES    256
+#define FLAC_BLOCK    4096
+
+static int failures = 0;
+
+struct sound_events
+{
+   unsigned finished;
+   unsigned stopped;
+   unsigned repeated;
+};
+
+static struct sound_events events;
+
+/* The rates match, so the mixer never asks for a resampler. */
+bool retro_resampler_realloc(void **re, const retro_resampler_t **backend,
+      const char *ident, enum resampler_quality quality, double ratio)
+{
+   return false;
+}
+
+static int16_t pattern(size_t frame)
+{
+   return (int16_t)(1000 + (frame * 7) % 20000);
+}
+
+struct bits
+{
+   uint8_t *data;
+   size_t len;
+};
+
+static void put_byte(struct bits *b, unsigned v)
+{
+   b->data[b->len++] = (uint8_t)v;
+}
+
+static void put_be(struct bits *b, uint64_t v, unsigned bytes)
+{
+   while (bytes--)
+      put_byte(b, (unsigned)(v >> (8 * bytes)) & 0xff);
+}
+
+static uint8_t crc8(const uint8_t *p, size_t len)
+{
+   uint8_t crc = 0;
+   while (len--)
+   {
+      unsigned i;
+      crc ^= *p++;
+      for (i = 0; i < 8; i++)
+         crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+   }
+   return crc;
+}
+
+static uint16_t crc16(const uint8_t *p, size_t len)
+{
+   uint16_t crc = 0;
+   while (len--)
+   {
+      unsigned i;
+      crc ^= (uint16_t)(*p++ << 8);
+      for (i = 0; i < 8; i++)
+         crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+   }
+   return crc;
+}
+
+/* Frame numbers are coded like UTF-8. */
+static void put_utf8(struct bits *b, uint32_t v)
+{
+   if (v < 0x80)
+      put_byte(b, v);
+   else if (v < 0x800)
+   {
+      put_byte(b, 0xc0 | (v >> 6));
+      put_byte(b, 0x80 | (v & 0x3f));
+   }
+   else
+   {
+      put_byte(b, 0xe0 | (v >> 12));
+      put_byte(b, 0x80 | ((v >> 6) & 0x3f));
+      put_byte(b, 0x80 | (v & 0x3f));
+   }
+}
+
+/* A 48 kHz 16-bit stereo FLAC of 'frames' frames of pattern(). */
+static void *make_flac(size_t frames, int32_t *size)
+{
+   size_t pos;
+   uint32_t frame_number = 0;
+   struct bits b;
+
+   b.len  = 0;
+   b.data = (uint8_t*)malloc(64 + frames * 4
+         + (frames / FLAC_BLOCK + 1) * 32);
+   if (!b.data)
+      return NULL;
+
+   put_be(&b, 0x664c6143, 4);               /* fLaC */
+   put_be(&b, 0x80000022, 4);               /* last block, STREAMINFO */
+   put_be(&b, FLAC_BLOCK, 2);
+   put_be(&b, FLAC_BLOCK, 2);
+   put_be(&b, 0, 3);
+   put_be(&b, 0, 3);
+   /* rate:20 channels-1:3 bits-1:5 total frames:36 */
+   put_be(&b, ((uint64_t)RATE << 44) | ((uint64_t)1 << 41)
+         | ((uint64_t)15 << 36) | frames, 8);
+   put_be(&b, 0, 8);                        /* MD5 not set */
+   put_be(&b, 0, 8);
+
+   for (pos = 0; pos < frames; pos += FLAC_BLOCK, frame_number++)
+   {
+      size_t i, start = b.len;
+      size_t n        = frames - pos < FLAC_BLOCK ? frames - pos : FLAC_BLOCK;
+      int ch;
+
+      put_byte(&b, 0xff);
+      put_byte(&b, 0xf8);                   /* fixed block size */
+      put_byte(&b, 0x7a);                   /* size in header, 48 kHz */
+      put_byte(&b, 0x18);                   /* L/R, 16 bits */
+      put_utf8(&b, frame_number);
+      put_be(&b, n - 1, 2);
+      put_byte(&b, crc8(b.data + start, b.len - start));
+
+      for (ch = 0; ch < 2; ch++)
+      {
+         put_byte(&b, 0x02);                /* verbatim */
+         for (i = 0; i < n; i++)
+         {
+            int16_t v = pattern(pos + i);
+            put_be(&b, (uint16_t)(ch ? -v : v), 2);
+         }
+      }
+
+      put_be(&b, crc16(b.data + start, b.len - start), 2);
+   }
+
+   *size = (int32_t)b.len;
+   return b.data;
+}
+
+static void stop_cb(audio_mixer_sound_t *sound, unsigned reason)
+{
+   switch (reason)
+   {
+      case AUDIO_MIXER_SOUND_FINISHED:
+         events.finished++;
+         break;
+      case AUDIO_MIXER_SOUND_STOPPED:
+         events.stopped++;
+         break;
+      case AUDIO_MIXER_SOUND_REPEATED:
+         events.repeated++;
+         break;
+   }
+}
+
+/* Mixes until 'frames' frames of sound have come out or, when
+ * the voices stop first, until they have.  Each sound frame must be
+ * the pattern at the next position, wrapping at 'length'; several
+ * voices are played at 1/n volume each, which stays under the clip
+ * level.  Returns false on a mismatch. */
+static bool mix_and_check(const char *name, size_t frames,
+      size_t length, unsigned *silent)
+{
+   static float buf[MIX_FRAMES * 2];
+   size_t next     = 0;
+   unsigned idle   = 0;
+
+   *silent = 0;
+
+   while (next < frames && idle < 2000)
+   {
+      size_t i;
+
+      memset(buf, 0, sizeof(buf));
+      audio_mixer_mix(buf, MIX_FRAMES, 0.0f, false);
+
+      for (i = 0; i < MIX_FRAMES && next < frames; i++)
+      {
+         float expect;
+
+         if (buf[2 * i] == 0.0f && buf[2 * i + 1] == 0.0f)
+         {
+            (*silent)++;
+            continue;
+         }
+
+         expect = pattern(next % length) / 32768.0f;
+         if (     fabsf(buf[2 * i]     - expect) > 1e-5f
+               || fabsf(buf[2 * i + 1] + expect) > 1e-5f)
+         {
+            printf("[FAIL] %s: frame %u is %f/%f, expected %f/%f\n",
+                  name, (unsigned)next, buf[2 * i], buf[2 * i + 1],
+                  expect, -expect);
+            failures++;
+            return false;
+         }
+         next++;
+      }
+
+      idle = events.finished ? idle + 1 : 0;
+      retro_sleep(1);
+   }
+
+   if (next < frames)
+   {
+      printf("[FAIL] %s: only %u of %u frames came out\n",
+            name, (unsigned)next, (unsigned)frames);
+      failures++;
+      return false;
+   }
+   return true;
+}
+
+static void test_stream(void)
+{
+   int32_t size;
+   unsigned silent;
+   size_t frames              = 4 * RATE;
+   void *flac                 = make_flac(frames, &size);
+   audio_mixer_sound_t *sound = audio_mixer_load_flac(flac, size);
+
+   memset(&events, 0, sizeof(events));
+   if (!audio_mixer_play(sound, false, 1.0f, NULL,
+            RESAMPLER_QUALITY_DONTCARE, stop_cb))
+   {
+      printf("[FAIL] stream: could not play\n");
+      failures++;
+   }
+   else if (mix_and_check("stream", frames, frames, &silent))
+   {
+      /* One more mix to see the end of the stream. */
+      float buf[MIX_FRAMES * 2];
+      memset(buf, 0, sizeof(buf));
+      audio_mixer_mix(buf, MIX_FRAMES, 0.0f, false);
+      if (events.finished != 1)
+      {
+         printf("[FAIL] stream: finished %u times\n", events.finished);
+         failures++;
+      }
+      else
+         printf("[pass] stream: %u frames, %u frames of underrun\n",
+               (unsigned)frames, silent);
+   }
+
+   audio_mixer_destroy(sound);
+}
+
+static void test_stream_repeat(void)
+{
+   int32_t size;
+   unsigned silent;
+   size_t frames              = 3 * RATE;
+   void *flac                 = make_flac(frames, &size);
+   audio_mixer_sound_t *sound = audio_mixer_load_flac(flac, size);
+   audio_mixer_voice_t *voice;
+
+   memset(&events, 0, sizeof(events));
+   if (!(voice = audio_mixer_play(sound, true, 1.0f, NULL,
+            RESAMPLER_QUALITY_DONTCARE, stop_cb)))
+   {
+      printf("[FAIL] stream repeat: could not play\n");
+      failures++;
+   }
+   else if (mix_and_check("stream repeat", frames + frames / 2,
+            frames, &silent))
+   {
+      audio_mixer_stop(voice);
+      if (!events.repeated || events.finished || events.stopped != 1)
+      {
+         printf("[FAIL] stream repeat: repeated %u, finished %u, "
+               "stopped %u\n", events.repeated, events.finished,
+               events.stopped);
+         failures++;
+      }
+      else
+         printf("[pass] stream repeat: looped %u times, "
+               "%u frames of underrun\n", events.repeated, silent);
+   }
+
+   audio_mixer_destroy(sound);
+}
+
+static void test_cached(void)
+{
+   int32_t size;
+   unsigned silent, round;
+   size_t frames              = RATE / 2;
+   void *flac                 = make_flac(frames, &size);
+   audio_mixer_sound_t *sound = audio_mixer_load_flac(flac, size);
+
+   for (round = 0; round < 2; round++)
+   {
+      unsigned voices = 2 - round;
+      unsigned v;
+      char name[32];
+
+      snprintf(name, sizeof(name), "cached, play %u", round + 1);
+      memset(&events, 0, sizeof(events));
+
+      for (v = 0; v < voices; v++)
+         if (!audio_mixer_play(sound, false, 1.0f / voices, NULL,
+                  RESAMPLER_QUALITY_DONTCARE, stop_cb))
+         {
+            printf("[FAIL] %s: could not play\n", name);
+            failures++;
+            audio_mixer_destroy(sound);
+            return;
+         }
+
+      if (!mix_and_check(name, frames, frames, &silent))
+         break;
+      /* Once in the cache it is played from memory, so there is
+       * never a gap. */
+      if ((round && silent) || events.finished != voices)
+      {
+         printf("[FAIL] %s: %u frames of silence, finished %u times\n",
+               name, silent, events.finished);
+         failures++;
+         break;
+      }
+      printf("[pass] %s: %u voices, %u frames of underrun\n",
+            name, voices, silent);
+   }
+
+   audio_mixer_destroy(sound);
+}
+
+static void test_cached_destroy(void)
+{
+   unsigned i;
+
+   for (i = 0; i < 32; i++)
+   {
+      int32_t size;
+      void *flac                 = make_flac(RATE / 4, &size);
+      audio_mixer_sound_t *sound = audio_mixer_load_flac(flac, size);
+      audio_mixer_voice_t *voice = audio_mixer_play(sound, false, 1.0f,
+            NULL, RESAMPLER_QUALITY_DONTCARE, NULL);
+
+      if (!voice)
+      {
+         printf("[FAIL] cached destroy: could not play\n");
+         failures++;
+         audio_mixer_destroy(sound);
+         return;
+      }
+
+      /* Every other one gets a moment for the worker to start. */
+      if (i & 1)
+         retro_sleep(1);
+      audio_mixer_stop(voice);
+      audio_mixer_destroy(sound);
+   }
+
+   printf("[pass] cached destroy: %u sounds\n", i);
+}
+
+int main(void)
+{
+   audio_mixer_init(RATE);
+
+   test_stream();
+   test_stream_repeat();
+   test_cached();
+   test_cached_destroy();
+
+   audio_mixer_done();
+
+   if (failures)
+   {
+      printf("%d test(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,218 @@
+/* Stress test for the ring between producers and the audio thread
+ * in audio/audio_thread_wrapper.c.
+ *
+ * A stub driver stands in for the real one.  Its write() checks
+ * that the samples arrive as one unbroken count, and every few calls
+ * it sleeps to push back the way a device with a full buffer does.
+ * Two producers are run against it:
+ *   - callback: the core's audio callback writes on the audio thread
+ *     itself, in batches both smaller and larger than the ring, so
+ *     the ring has to be drained from inside write(),
+ *   - main thread: samples are written from another thread, which
+ *     has to wait for the audio thread to make room.
+ * Neither is allowed to lose or reorder samples.  The ring
+ * statistics are printed for each.
+ *
+ * Build with SANITIZER=thread to check the ring handoff for races. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include <retro_timers.h>
+#include <retro_atomic.h>
+
+#include "../../../audio/audio_thread_wrapper.h"
+
+#define OUT_RATE     48000
+#define LATENCY      64
+#define TOTAL_FRAMES (1 << 20)
+
+struct stub
+{
+   retro_atomic_size_t received; /* frames */
+   unsigned writes;
+   int16_t expected;
+   bool mismatch;
+};
+
+static struct stub *current_stub;
+
+static const audio_driver_t *wrapper;
+static void *wrapper_data;
+static bool use_callback;
+static int16_t next_sample;
+static size_t produced;   /* frames */
+static uint32_t rng_state = 0x9e3779b9u;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+/* Writes up to 'frames' frames of the count through the wrapper. */
+static void produce(size_t frames)
+{
+   static int16_t buf[2 * 8192];
+   size_t i;
+
+   if (frames > TOTAL_FRAMES - produced)
+      frames = TOTAL_FRAMES - produced;
+   if (frames > 8192)
+      frames = 8192;
+   for (i = 0; i < frames; i++)
+   {
+      buf[2 * i]     = next_sample;
+      buf[2 * i + 1] = (int16_t)~next_sample;
+      next_sample++;
+   }
+   if (wrapper->write(wrapper_data, buf, frames * 2 * sizeof(int16_t))
+         == (ssize_t)(frames * 2 * sizeof(int16_t)))
+      produced += frames;
+}
+
+/* The parts of audio/audio_driver.c the wrapper calls into. */
+bool audio_driver_callback(void)
+{
+   if (!use_callback)
+      return false;
+   if (produced < TOTAL_FRAMES)
+      produce(64 + rng_next() % 6000);
+   return true;
+}
+
+bool audio_driver_enable_callback(void)  { return true; }
+bool audio_driver_disable_callback(void) { return true; }
+
+static void *stub_init(const char *device, unsigned rate,
+      unsigned latency, unsigned block_frames, unsigned *new_rate)
+{
+   struct stub *stub = (struct stub*)calloc(1, sizeof(*stub));
+   if (stub)
+      retro_atomic_size_init(&stub->received, 0);
+   current_stub = stub;
+   return stub;
+}
+
+static ssize_t stub_write(void *data, const void *buf, size_t len)
+{
+   struct stub *stub = (struct stub*)data;
+   const int16_t *in = (const int16_t*)buf;
+   size_t frames     = len / (2 * sizeof(int16_t));
+   size_t i;
+
+   for (i = 0; i < frames; i++)
+   {
+      if (     in[2 * i]     != stub->expected
+            || in[2 * i + 1] != (int16_t)~stub->expected)
+         stub->mismatch = true;
+      stub->expected++;
+   }
+   if (++stub->writes % 16 == 0)
+      retro_sleep(1);
+   retro_atomic_store_release_size(&stub->received,
+         retro_atomic_load_acquire_size(&stub->received) + frames);
+   return (ssize_t)len;
+}
+
+static bool stub_stop(void *data) { return true; }
+static bool stub_start(void *data, bool is_shutdown) { return true; }
+static bool stub_alive(void *data) { return true; }
+static void stub_set_nonblock_state(void *data, bool state) { }
+static void stub_free(void *data) { free(data); }
+static bool stub_use_float(void *data) { return false; }
+
+static const audio_driver_t stub_driver = {
+   stub_init,
+   stub_write,
+   stub_stop,
+   stub_start,
+   stub_alive,
+   stub_set_nonblock_state,
+   stub_free,
+   stub_use_float,
+   "stub",
+   NULL,
+   NULL,
+   NULL,
+   NULL
+};
+
+static bool run(const char *name, bool callback)
+{
+   audio_thread_stats_t stats;
+   struct stub *stub;
+   unsigned new_rate = 0;
+   unsigned waited   = 0;
+   bool ok;
+
+   use_callback = callback;
+   next_sample  = 0;
+   produced     = 0;
+
+   if (!audio_init_thread(&wrapper, &wrapper_data, NULL, OUT_RATE,
+            &new_rate, LATENCY, 0, &stub_driver))
+   {
+      printf("[FAIL] %s: could not start the audio thread\n", name);
+      return false;
+   }
+   stub = current_stub;
+   wrapper->start(wrapper_data, false);
+
+   if (!callback)
+      while (produced < TOTAL_FRAMES)
+         produce(64 + rng_next() % 6000);
+
+   while (     retro_atomic_load_acquire_size(&stub->received) < TOTAL_FRAMES
+         && waited++ < 30000)
+      retro_sleep(1);
+
+   wrapper->stop(wrapper_data);
+   audio_thread_get_stats(wrapper, wrapper_data, &stats);
+
+   ok =     retro_atomic_load_acquire_size(&stub->received) == TOTAL_FRAMES
+         && !stub->mismatch;
+   printf("[%s] %s: %u frames, ring %u bytes, %u underruns, %u overruns, "
+         "fill %u/%u/%u/%u/%u/%u/%u/%u\n",
+         ok ? "pass" : "FAIL", name,
+         (unsigned)retro_atomic_load_acquire_size(&stub->received),
+         (unsigned)stats.capacity,
+         (unsigned)stats.underruns, (unsigned)stats.overruns,
+         (unsigned)stats.fill[0], (unsigned)stats.fill[1],
+         (unsigned)stats.fill[2], (unsigned)stats.fill[3],
+         (unsigned)stats.fill[4], (unsigned)stats.fill[5],
+         (unsigned)stats.fill[6], (unsigned)stats.fill[7]);
+
+   wrapper->free(wrapper_data);
+   return ok;
+}
+
+int main(void)
+{
+   int failures = 0;
+
+   if (!run("callback", true))
+      failures++;
+   if (!run("main thread", false))
+      failures++;
+
+   if (failures)
+   {
+      printf("%d test(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
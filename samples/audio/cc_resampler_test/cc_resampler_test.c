@@ -0,0 +1,396 @@
+/* Bit-accuracy test and benchmark for the CC resampler kernels
+ * (audio/drivers_resampler/cc_resampler.c).
+ *
+ *   cc_resampler_test [seconds]
+ *
+ * Noise is fed through every kernel this build and CPU support, at
+ * a set of common rate conversions both up and down, in blocks of
+ * changing size and with the ratio wobbling from block to block as
+ * dynamic rate control would.  Every vector kernel has to put out
+ * exactly the same frames as the reference below, down to the last
+ * bit; ns per output frame is reported for each.  The resampler's
+ * own C kernel works partly in double precision, so it only has to
+ * stay within CLOSE_TOLERANCE of the reference.
+ *
+ * Exit status is non-zero if any kernel differs from the reference. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <audio/audio_resampler.h>
+
+/* Largest input block handed to process() per call. */
+#define MAX_BLOCK_FRAMES 2048
+
+/* Largest difference allowed between the C kernel and the
+ * reference, on input in [-1, 1). */
+#define CLOSE_TOLERANCE 1e-5
+
+enum kernel_check
+{
+   /* Defines the expected output */
+   KERNEL_REFERENCE = 0,
+   KERNEL_EXACT,
+   KERNEL_CLOSE
+};
+
+struct kernel
+{
+   const char *name;
+   resampler_simd_mask_t mask;
+   enum kernel_check check;
+};
+
+struct conversion
+{
+   double in_rate;
+   double out_rate;
+};
+
+struct result
+{
+   double ns_per_frame;
+   float *out;
+   size_t out_frames;
+};
+
+typedef void (*cc_process_t)(void *re, struct resampler_data *data);
+
+extern retro_resampler_t CC_resampler;
+
+static const struct kernel kernels[] = {
+   { "ref",  0,                                      KERNEL_REFERENCE },
+   { "C",    0,                                      KERNEL_CLOSE },
+   { "SSE",  RESAMPLER_SIMD_SSE,                     KERNEL_EXACT },
+   { "AVX",  RESAMPLER_SIMD_SSE | RESAMPLER_SIMD_AVX, KERNEL_EXACT },
+   { "NEON", RESAMPLER_SIMD_NEON,                    KERNEL_EXACT }
+};
+
+/* The vector kernels in scalar form, for the default precision
+ * (CC_RESAMPLER_PRECISION 1): single precision, four taps with the
+ * fourth one included even where its weight is always 0, and the
+ * two pairs of taps summed before they are added together. */
+struct ref_resampler
+{
+   cc_process_t process;
+   audio_frame_float_t buffer[4];
+   float distance;
+};
+
+static float ref_int(float x, float b)
+{
+   float val = x * b;
+   float vv  = val * val;
+   vv        = 0.25f * (vv * (3.0f - vv));
+   val       = val * (1.0f - vv);
+   return (val > 0.5f) ? 0.5f : (val < -0.5f) ? -0.5f : val;
+}
+
+#define ref_kernel(x, b) (ref_int((x) + 0.5f, (b)) - ref_int((x) - 0.5f, (b)))
+
+static void ref_downsample(void *re_, struct resampler_data *data)
+{
+   struct ref_resampler *re     = (struct ref_resampler*)re_;
+   const audio_frame_float_t *inp     = (const audio_frame_float_t*)data->data_in;
+   const audio_frame_float_t *inp_max = inp + data->input_frames;
+   audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
+   float                  ratio = 1.0 / data->ratio;
+   float                      b = data->ratio;
+   float               distance = re->distance;
+
+   while (inp != inp_max)
+   {
+      int i;
+
+      for (i = 0; i < 4; i++)
+      {
+         float temp          = ref_kernel(distance - ratio * (float)i, b);
+         re->buffer[i].l    += inp->l * temp;
+         re->buffer[i].r    += inp->r * temp;
+      }
+
+      distance++;
+      inp++;
+
+      if (distance > (ratio + 0.5))
+      {
+         *outp           = re->buffer[0];
+         re->buffer[0]   = re->buffer[1];
+         re->buffer[1]   = re->buffer[2];
+         re->buffer[2]   = re->buffer[3];
+         re->buffer[3].l = 0.0f;
+         re->buffer[3].r = 0.0f;
+         distance       -= ratio;
+         outp++;
+      }
+   }
+
+   re->distance        = distance;
+   data->output_frames = outp - (audio_frame_float_t*)data->data_out;
+}
+
+static void ref_upsample(void *re_, struct resampler_data *data)
+{
+   struct ref_resampler *re     = (struct ref_resampler*)re_;
+   const audio_frame_float_t *inp     = (const audio_frame_float_t*)data->data_in;
+   const audio_frame_float_t *inp_max = inp + data->input_frames;
+   audio_frame_float_t *outp    = (audio_frame_float_t*)data->data_out;
+   float                      b = MIN(data->ratio, 1.00);
+   float                  ratio = 1.0 / data->ratio;
+   float               distance = re->distance;
+
+   while (inp != inp_max)
+   {
+      re->buffer[0] = re->buffer[1];
+      re->buffer[1] = re->buffer[2];
+      re->buffer[2] = re->buffer[3];
+      re->buffer[3] = *inp;
+
+      while (distance < 1.0f)
+      {
+         int i;
+         float w[4];
+
+         for (i = 0; i < 4; i++)
+            w[i] = ref_kernel(distance + (1.0f - (float)i), b);
+
+         outp->l = (re->buffer[0].l * w[0] + re->buffer[2].l * w[2])
+                 + (re->buffer[1].l * w[1] + re->buffer[3].l * w[3]);
+         outp->r = (re->buffer[0].r * w[0] + re->buffer[2].r * w[2])
+                 + (re->buffer[1].r * w[1] + re->buffer[3].r * w[3]);
+
+         distance += ratio;
+         outp++;
+      }
+
+      distance -= 1.0f;
+      inp++;
+   }
+
+   re->distance        = distance;
+   data->output_frames = outp - (audio_frame_float_t*)data->data_out;
+}
+
+/* Same split and start distance as resampler_CC_init(). */
+static void *ref_init(double bandwidth_mod)
+{
+   struct ref_resampler *re = (struct ref_resampler*)
+      calloc(1, sizeof(*re));
+   if (!re)
+      return NULL;
+   if (bandwidth_mod < 0.75)
+      re->process  = ref_downsample;
+   else
+   {
+      re->process  = ref_upsample;
+      re->distance = 2.0f;
+   }
+   return re;
+}
+
+/* 0.75 and up is upsampled, anything under it downsampled. */
+static const struct conversion conversions[] = {
+   { 44100.0, 48000.0 },
+   { 32040.0, 48000.0 },
+   { 22050.0, 48000.0 },
+   { 48000.0, 44100.0 },
+   { 96000.0, 48000.0 },
+   { 88200.0, 48000.0 },
+   {192000.0, 48000.0 }
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+   rng_state = rng_state * 1664525u + 1013904223u;
+   return rng_state >> 8;
+}
+
+/* Returns false if this kernel is not available, or selects a
+ * kernel already in 'seen' (one left out of the build). */
+static bool run(const struct kernel *kernel, const struct conversion *conv,
+      const float *in, size_t in_frames, cc_process_t *seen,
+      struct result *res)
+{
+   size_t pos;
+   unsigned k;
+   cc_process_t process;
+   retro_time_t elapsed       = 0;
+   double ratio               = conv->out_rate / conv->in_rate;
+   resampler_simd_mask_t mask = kernel->mask
+      & (resampler_simd_mask_t)cpu_features_get();
+   void *re;
+
+   if (kernel->mask && mask != kernel->mask)
+      return false;
+   if (kernel->check == KERNEL_REFERENCE)
+   {
+      if (!(re = ref_init(ratio)))
+         return false;
+      process      = *(cc_process_t*)re;
+   }
+   else
+   {
+      if (!(re = CC_resampler.init(NULL, ratio,
+                  RESAMPLER_QUALITY_DONTCARE, mask)))
+         return false;
+
+      /* The kernel picked is the first member of the resampler. */
+      process = *(cc_process_t*)re;
+      for (k = 0; seen[k]; k++)
+      {
+         if (seen[k] == process)
+         {
+            CC_resampler.free(re);
+            return false;
+         }
+      }
+      seen[k]      = process;
+   }
+
+   res->out_frames = 0;
+   res->out        = (float*)malloc(((size_t)(in_frames * ratio * 1.01)
+            + MAX_BLOCK_FRAMES * 4) * 2 * sizeof(float));
+   if (!res->out)
+   {
+      if (kernel->check == KERNEL_REFERENCE)
+         free(re);
+      else
+         CC_resampler.free(re);
+      return false;
+   }
+
+   /* Same block sizes and ratios for every kernel. */
+   rng_state = 12345;
+
+   for (pos = 0; pos < in_frames; )
+   {
+      struct resampler_data data;
+      retro_time_t start;
+      size_t block       = 1 + rng() % MAX_BLOCK_FRAMES;
+
+      data.data_in       = in + pos * 2;
+      data.data_out      = res->out + res->out_frames * 2;
+      data.input_frames  = MIN(block, in_frames - pos);
+      data.output_frames = 0;
+      data.ratio         = ratio
+         * (1.0 + ((int)(rng() % 1001) - 500) * 0.00001);
+
+      start              = cpu_features_get_time_usec();
+      process(re, &data);
+      elapsed           += cpu_features_get_time_usec() - start;
+      res->out_frames   += data.output_frames;
+      pos               += data.input_frames;
+   }
+   if (kernel->check == KERNEL_REFERENCE)
+      free(re);
+   else
+      CC_resampler.free(re);
+
+   res->ns_per_frame = res->out_frames
+      ? (double)elapsed * 1000.0 / (double)res->out_frames : 0;
+   return true;
+}
+
+static int test(const struct conversion *conv, double seconds)
+{
+   unsigned k;
+   size_t i;
+   int failures       = 0;
+   size_t in_frames   = (size_t)(conv->in_rate * seconds);
+   float *in          = (float*)malloc(in_frames * 2 * sizeof(float));
+   cc_process_t seen[ARRAY_SIZE(kernels) + 1] = {0};
+   struct result ref  = {0};
+
+   if (!in)
+      return 1;
+   rng_state = 1;
+   for (i = 0; i < in_frames * 2; i++)
+      in[i] = (float)rng() / (float)(1 << 23) - 1.0f;
+
+   printf("%6.0f -> %6.0f Hz\n", conv->in_rate, conv->out_rate);
+
+   for (k = 0; k < ARRAY_SIZE(kernels); k++)
+   {
+      struct result res;
+
+      if (!run(&kernels[k], conv, in, in_frames, seen, &res))
+         continue;
+
+      printf("   %-5s %8.2f ns/frame", kernels[k].name, res.ns_per_frame);
+
+      if (!ref.out)
+      {
+         ref = res;
+         printf("\n");
+         continue;
+      }
+
+      if (res.out_frames != ref.out_frames)
+      {
+         printf("   FAIL: %u frames, reference put out %u\n",
+               (unsigned)res.out_frames, (unsigned)ref.out_frames);
+         failures++;
+      }
+      else if (kernels[k].check == KERNEL_CLOSE)
+      {
+         double worst = 0.0;
+         for (i = 0; i < res.out_frames * 2; i++)
+            worst = MAX(worst, fabs((double)res.out[i] - ref.out[i]));
+         if (worst > CLOSE_TOLERANCE)
+         {
+            printf("   FAIL: off the reference by up to %.3g\n", worst);
+            failures++;
+         }
+         else
+            printf("   within %.3g of the reference\n", worst);
+      }
+      else if (memcmp(res.out, ref.out,
+               res.out_frames * 2 * sizeof(float)))
+      {
+         for (i = 0; res.out[i] == ref.out[i]; i++);
+         printf("   FAIL: frame %u is %.9g, reference put out %.9g\n",
+               (unsigned)(i / 2), res.out[i], ref.out[i]);
+         failures++;
+      }
+      else
+         printf("   %.2fx reference, bit-exact\n",
+               ref.ns_per_frame / MAX(res.ns_per_frame, 1e-9));
+      free(res.out);
+   }
+
+   free(ref.out);
+   free(in);
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned c;
+   int failures   = 0;
+   double seconds = 2.0;
+
+   if (argc > 2 || (argc == 2 && (seconds = atof(argv[1])) <= 0.0))
+   {
+      fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+      return 1;
+   }
+
+   for (c = 0; c < ARRAY_SIZE(conversions); c++)
+      failures += test(&conversions[c], seconds);
+
+   if (failures)
+   {
+      printf("%d kernel check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,434 @@
+/* Accuracy test and benchmark for the partitioned FFT convolver
+ * (libretro-common/audio/dsp_filters/fft/convolver.c) against the
+ * single-block overlap-add the EQ filter used before it.
+ *
+ *   fft_convolver_bench [seconds]
+ *
+ * Noise is convolved with impulse responses of the EQ's default
+ * length and longer, fed in blocks of changing size.  The reference
+ * is overlap-add over one block as long as the filter, one radix-2
+ * FFT per channel, as eq.c used to do.  Every convolver kernel this
+ * build and CPU support is then run at several partition sizes and
+ * has to put out the same frames within float rounding; ns per frame
+ * and latency in frames are reported for each.
+ *
+ * Last, an impulse goes through the EQ plugin itself with a flat
+ * response, and has to come out as a single impulse.
+ *
+ * Exit status is non-zero if any check fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <libretro_dspfilter.h>
+
+#include "fft/fft.h"
+#include "fft/convolver.h"
+
+/* Largest input block handed over per call. */
+#define MAX_BLOCK_FRAMES 1024
+/* Relative to the output peak. */
+#define MAX_ERROR        1e-5
+
+struct kernel
+{
+   const char *name;
+   dspfilter_simd_mask_t mask;
+};
+
+struct result
+{
+   double ns_per_frame;
+   float *out;
+   size_t out_frames;
+};
+
+static const struct kernel kernels[] = {
+   { "C",    0 },
+   { "SSE",  DSPFILTER_SIMD_SSE },
+   { "AVX",  DSPFILTER_SIMD_SSE | DSPFILTER_SIMD_AVX }
+};
+
+/* Filter lengths are 2^n - 1 taps, as the EQ designs them. */
+static const unsigned filter_log2s[]    = { 8, 10, 12 };
+static const unsigned partition_log2s[] = { 5, 6, 8, 10 };
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+   rng_state = rng_state * 1664525u + 1013904223u;
+   return rng_state >> 8;
+}
+
+static float rng_float(void)
+{
+   return (float)rng() / (float)(1 << 23) - 1.0f;
+}
+
+/* The old eq_process(): one block of 'block' frames, FFT'd at twice
+ * that with the filter zero-padded, and the tail of each block saved
+ * to add into the next. */
+static bool run_reference(const float *ir, unsigned block_log2,
+      const float *in, size_t in_frames, struct result *res)
+{
+   size_t pos;
+   unsigned i, c;
+   unsigned block_ptr      = 0;
+   unsigned block          = 1 << block_log2;
+   retro_time_t elapsed    = 0;
+   fft_t *fft              = fft_new(block_log2 + 1);
+   float *padded           = (float*)calloc(2 * block, sizeof(float));
+   float *buf              = (float*)calloc(2 * block, 2 * sizeof(float));
+   float *save             = (float*)calloc(block, 2 * sizeof(float));
+   fft_complex_t *filter   = (fft_complex_t*)calloc(2 * block, sizeof(*filter));
+   fft_complex_t *fftblock = (fft_complex_t*)calloc(2 * block, sizeof(*fftblock));
+   float *out              = (float*)calloc(2 * block, 2 * sizeof(float));
+   bool ok                 = false;
+
+   res->out        = (float*)malloc((in_frames + block) * 2 * sizeof(float));
+   res->out_frames = 0;
+   if (!fft || !padded || !buf || !save || !filter || !fftblock
+         || !out || !res->out)
+      goto end;
+
+   memcpy(padded, ir, (block - 1) * sizeof(float));
+   fft_process_forward(fft, filter, padded, 1);
+
+   rng_state = 777;
+   for (pos = 0; pos < in_frames; )
+   {
+      retro_time_t start;
+      const float *src  = in + pos * 2;
+      unsigned frames   = (unsigned)MIN(1 + rng() % MAX_BLOCK_FRAMES,
+            in_frames - pos);
+
+      pos              += frames;
+      start             = cpu_features_get_time_usec();
+      while (frames)
+      {
+         unsigned avail = MIN(block - block_ptr, frames);
+
+         memcpy(buf + block_ptr * 2, src, avail * 2 * sizeof(float));
+         src       += avail * 2;
+         frames    -= avail;
+         block_ptr += avail;
+
+         if (block_ptr == block)
+         {
+            for (c = 0; c < 2; c++)
+            {
+               fft_process_forward(fft, fftblock, buf + c, 2);
+               for (i = 0; i < 2 * block; i++)
+                  fftblock[i] = fft_complex_mul(fftblock[i], filter[i]);
+               fft_process_inverse(fft, out + c, fftblock, 2);
+            }
+
+            for (i = 0; i < 2 * block; i++)
+               out[i] += save[i];
+            memcpy(save, out + 2 * block, 2 * block * sizeof(float));
+            memcpy(res->out + res->out_frames * 2, out,
+                  2 * block * sizeof(float));
+
+            res->out_frames += block;
+            block_ptr        = 0;
+         }
+      }
+      elapsed += cpu_features_get_time_usec() - start;
+   }
+
+   res->ns_per_frame = res->out_frames
+      ? (double)elapsed * 1000.0 / (double)res->out_frames : 0;
+   ok = true;
+
+end:
+   fft_free(fft);
+   free(padded);
+   free(buf);
+   free(save);
+   free(filter);
+   free(fftblock);
+   free(out);
+   return ok;
+}
+
+/* Returns false if this kernel is not available, or selects a
+ * kernel already in 'seen' (one left out of the build). */
+static bool run(const struct kernel *kernel, const float *ir,
+      unsigned ir_len, unsigned partition_log2,
+      const float *in, size_t in_frames,
+      const char **seen, struct result *res)
+{
+   size_t pos;
+   unsigned k;
+   const char *name;
+   retro_time_t elapsed        = 0;
+   dspfilter_simd_mask_t mask  = kernel->mask
+      & (dspfilter_simd_mask_t)cpu_features_get();
+   fft_convolver_t *conv;
+
+   if (kernel->mask && mask != kernel->mask)
+      return false;
+   if (!(conv = fft_convolver_new(ir, ir_len, partition_log2, mask)))
+      return false;
+
+   name = fft_convolver_kernel_name(conv);
+   for (k = 0; seen[k]; k++)
+   {
+      if (!strcmp(seen[k], name))
+      {
+         fft_convolver_free(conv);
+         return false;
+      }
+   }
+   seen[k]         = name;
+
+   res->out_frames = 0;
+   res->out        = (float*)malloc((in_frames + MAX_BLOCK_FRAMES)
+         * 2 * sizeof(float));
+   if (!res->out)
+   {
+      fft_convolver_free(conv);
+      return false;
+   }
+
+   /* Same block sizes as the reference. */
+   rng_state = 777;
+   for (pos = 0; pos < in_frames; )
+   {
+      retro_time_t start;
+      unsigned frames  = (unsigned)MIN(1 + rng() % MAX_BLOCK_FRAMES,
+            in_frames - pos);
+
+      start            = cpu_features_get_time_usec();
+      res->out_frames += fft_convolver_process(conv,
+            res->out + res->out_frames * 2, in + pos * 2, frames);
+      elapsed         += cpu_features_get_time_usec() - start;
+      pos             += frames;
+   }
+   fft_convolver_free(conv);
+
+   res->ns_per_frame = res->out_frames
+      ? (double)elapsed * 1000.0 / (double)res->out_frames : 0;
+   return true;
+}
+
+static int test(unsigned filter_log2, double seconds)
+{
+   unsigned k, p;
+   size_t i;
+   int failures      = 0;
+   unsigned ir_len   = (1 << filter_log2) - 1;
+   size_t in_frames  = (size_t)(48000.0 * seconds);
+   float *in         = (float*)malloc(in_frames * 2 * sizeof(float));
+   float *ir         = (float*)malloc(ir_len * sizeof(float));
+   float peak        = 0.0f;
+   struct result ref = {0};
+
+   if (!in || !ir)
+      return 1;
+
+   /* A decaying noise tail, loosely like a room. */
+   rng_state = 1;
+   for (i = 0; i < ir_len; i++)
+      ir[i] = rng_float() * (float)exp(-4.0 * i / ir_len) * 0.1f;
+   for (i = 0; i < in_frames * 2; i++)
+      in[i] = rng_float() * 0.5f;
+
+   printf("%u taps\n", ir_len);
+
+   if (!run_reference(ir, filter_log2, in, in_frames, &ref))
+   {
+      printf("   FAIL: reference out of memory\n");
+      free(ref.out);
+      free(in);
+      free(ir);
+      return 1;
+   }
+   for (i = 0; i < ref.out_frames * 2; i++)
+      peak = MAX(peak, (float)fabs(ref.out[i]));
+
+   printf("   %-24s %8.2f ns/frame %6u frames latency\n",
+         "overlap-add radix-2", ref.ns_per_frame, 1u << filter_log2);
+
+   for (p = 0; p < ARRAY_SIZE(partition_log2s); p++)
+   {
+      const char *seen[ARRAY_SIZE(kernels) + 1] = {0};
+
+      if (partition_log2s[p] > filter_log2)
+         continue;
+
+      for (k = 0; k < ARRAY_SIZE(kernels); k++)
+      {
+         struct result res;
+         size_t frames;
+         float err = 0.0f;
+
+         if (!run(&kernels[k], ir, ir_len, partition_log2s[p],
+                  in, in_frames, seen, &res))
+            continue;
+
+         printf("   partitioned %-5s %5u %8.2f ns/frame %6u frames latency",
+               kernels[k].name, 1u << partition_log2s[p],
+               res.ns_per_frame, 1u << partition_log2s[p]);
+
+         /* Both put out y[0], y[1], ... just in different chunks. */
+         frames = MIN(res.out_frames, ref.out_frames);
+         for (i = 0; i < frames * 2; i++)
+            err = MAX(err, (float)fabs(res.out[i] - ref.out[i]));
+
+         if (res.out_frames + MAX_BLOCK_FRAMES < ref.out_frames)
+         {
+            printf("   FAIL: %u frames, reference put out %u\n",
+                  (unsigned)res.out_frames, (unsigned)ref.out_frames);
+            failures++;
+         }
+         else if (err > MAX_ERROR * peak)
+         {
+            printf("   FAIL: error %.3g\n", err / peak);
+            failures++;
+         }
+         else
+            printf("   %.2fx, error %.1e\n",
+                  ref.ns_per_frame / MAX(res.ns_per_frame, 1e-9),
+                  err / peak);
+         free(res.out);
+      }
+   }
+
+   free(ref.out);
+   free(in);
+   free(ir);
+   return failures;
+}
+
+static int config_get_float(void *userdata, const char *key,
+      float *value, float default_value)
+{
+   *value = default_value;
+   return 0;
+}
+
+static int config_get_int(void *userdata, const char *key,
+      int *value, int default_value)
+{
+   *value = default_value;
+   return 0;
+}
+
+static int config_get_float_array(void *userdata, const char *key,
+      float **values, unsigned *out_num_values,
+      const float *default_values, unsigned num_default_values)
+{
+   *values         = (float*)malloc(num_default_values * sizeof(float));
+   *out_num_values = num_default_values;
+   memcpy(*values, default_values, num_default_values * sizeof(float));
+   return 0;
+}
+
+static int config_get_string(void *userdata, const char *key,
+      char **output, const char *default_output)
+{
+   *output = strdup(default_output);
+   return 0;
+}
+
+/* A flat EQ is a delayed unit impulse: half the filter length, less
+ * the coefficient eq.c drops to make it odd. */
+static int test_eq(void)
+{
+   unsigned i;
+   struct dspfilter_input input;
+   struct dspfilter_output output;
+   struct dspfilter_info info;
+   struct dspfilter_config config;
+   const struct dspfilter_implementation *impl;
+   float *in          = (float*)calloc(1024, 2 * sizeof(float));
+   unsigned frames    = 0;
+   unsigned delay     = (1 << 8) / 2 - 1;
+   float *out         = (float*)calloc(1024, 2 * sizeof(float));
+   int failures       = 0;
+   void *eq;
+
+   memset(&config, 0, sizeof(config));
+   config.get_float       = config_get_float;
+   config.get_int         = config_get_int;
+   config.get_float_array = config_get_float_array;
+   config.get_string      = config_get_string;
+   config.free            = free;
+   info.input_rate        = 48000.0f;
+
+   impl = dspfilter_get_implementation(
+         (dspfilter_simd_mask_t)cpu_features_get());
+   if (!in || !out || !(eq = impl->init(&info, &config, NULL)))
+   {
+      printf("EQ plugin: FAIL: init\n");
+      free(in);
+      free(out);
+      return 1;
+   }
+
+   in[0] = 1.0f;
+   in[1] = -1.0f;
+   for (i = 0; i < 1024; i += 100)
+   {
+      input.samples = in + i * 2;
+      input.frames  = MIN(100, 1024 - i);
+      impl->process(eq, &output, &input);
+      memcpy(out + frames * 2, output.samples,
+            output.frames * 2 * sizeof(float));
+      frames       += output.frames;
+   }
+   impl->free(eq);
+
+   for (i = 0; i < frames; i++)
+   {
+      float want = (i == delay) ? 1.0f : 0.0f;
+      if (     fabs(out[2 * i + 0] - want) > 1e-4
+            || fabs(out[2 * i + 1] + want) > 1e-4)
+      {
+         printf("EQ plugin: FAIL: frame %u is %.6f, %.6f\n",
+               i, out[2 * i], out[2 * i + 1]);
+         failures++;
+         break;
+      }
+   }
+   if (!failures)
+      printf("EQ plugin: flat response OK, %u frames out\n", frames);
+
+   free(in);
+   free(out);
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned f;
+   int failures   = 0;
+   double seconds = 2.0;
+
+   if (argc > 2 || (argc == 2 && (seconds = atof(argv[1])) <= 0.0))
+   {
+      fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+      return 1;
+   }
+
+   for (f = 0; f < ARRAY_SIZE(filter_log2s); f++)
+      failures += test(filter_log2s[f], seconds);
+
+   failures += test_eq();
+
+   if (failures)
+   {
+      printf("%d check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
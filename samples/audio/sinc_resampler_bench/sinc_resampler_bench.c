@@ -0,0 +1,302 @@
+/* Benchmark and cross-check for the sinc resampler kernels
+ * (libretro-common/audio/resampler/drivers/sinc_resampler.c).
+ *
+ *   sinc_resampler_bench [seconds]
+ *
+ * Every quality preset is run at a set of common rate conversions
+ * with each kernel this build and CPU support.  A sine is fed in and
+ * the output is least-squares fitted to a sine of the expected
+ * frequency; whatever the fit does not explain is counted as noise.
+ * For each run the benchmark reports:
+ *   - ns per output frame (time spent in process()),
+ *   - SNR in dB of the output against the fitted sine,
+ *   - for SIMD kernels, the largest difference from the C kernel
+ *     when both use the same number of taps (upsampling).
+ *
+ * Exit status is non-zero if a SIMD kernel strays from the C
+ * kernel, or loses more than 1 dB of SNR against it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+#include <audio/audio_resampler.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Input block handed to process() per call, as the audio driver
+ * would with a core pushing ~1/60 s of audio per frame. */
+#define BLOCK_FRAMES 1024
+
+/* Largest allowed difference from the C kernel output, for a
+ * full-scale input; FMA and summation order change rounding. */
+#define MAX_KERNEL_DIFF 1e-4
+
+struct kernel
+{
+   const char *name;
+   resampler_simd_mask_t mask;
+};
+
+struct conversion
+{
+   double in_rate;
+   double out_rate;
+};
+
+struct result
+{
+   double ns_per_frame;
+   double snr;
+   float *out;
+   size_t out_frames;
+};
+
+static const struct kernel kernels[] = {
+   { "C",       0 },
+   { "SSE",     RESAMPLER_SIMD_SSE },
+   { "AVX",     RESAMPLER_SIMD_SSE | RESAMPLER_SIMD_AVX },
+   { "AVX2",    RESAMPLER_SIMD_SSE | RESAMPLER_SIMD_AVX | RESAMPLER_SIMD_AVX2 },
+   { "AVX-512", RESAMPLER_SIMD_SSE | RESAMPLER_SIMD_AVX | RESAMPLER_SIMD_AVX2
+         | RESAMPLER_SIMD_AVX512 },
+   { "NEON",    RESAMPLER_SIMD_NEON }
+};
+
+static const struct conversion conversions[] = {
+   { 44100.0, 48000.0 },
+   { 32040.0, 48000.0 },
+   { 48000.0, 96000.0 },
+   { 48000.0, 44100.0 },
+   { 96000.0, 48000.0 }
+};
+
+static const char *quality_names[] = {
+   "dontcare", "lowest", "lower", "normal", "higher", "highest"
+};
+
+/* Least-squares fit of a*sin + b*cos + c at the known frequency;
+ * returns the ratio of fitted to residual power in dB. */
+static double measure_snr(const float *out, size_t frames, double w)
+{
+   size_t i;
+   double ss = 0, sc = 0, cc = 0, s1 = 0, c1 = 0, n = (double)frames;
+   double ys = 0, yc = 0, y1 = 0;
+   double m[3][4];
+   double coef[3];
+   double signal = 0, noise = 0;
+   int r, c, k;
+
+   for (i = 0; i < frames; i++)
+   {
+      double s = sin(w * i), co = cos(w * i), y = out[i * 2];
+      ss += s * s; sc += s * co; cc += co * co;
+      s1 += s;     c1 += co;
+      ys += y * s; yc += y * co; y1 += y;
+   }
+
+   m[0][0] = ss; m[0][1] = sc; m[0][2] = s1; m[0][3] = ys;
+   m[1][0] = sc; m[1][1] = cc; m[1][2] = c1; m[1][3] = yc;
+   m[2][0] = s1; m[2][1] = c1; m[2][2] = n;  m[2][3] = y1;
+
+   /* Gaussian elimination, the system is well conditioned */
+   for (r = 0; r < 3; r++)
+   {
+      for (k = r + 1; k < 3; k++)
+      {
+         double f = m[k][r] / m[r][r];
+         for (c = r; c < 4; c++)
+            m[k][c] -= f * m[r][c];
+      }
+   }
+   for (r = 2; r >= 0; r--)
+   {
+      coef[r] = m[r][3];
+      for (c = r + 1; c < 3; c++)
+         coef[r] -= m[r][c] * coef[c];
+      coef[r] /= m[r][r];
+   }
+
+   for (i = 0; i < frames; i++)
+   {
+      double fit = coef[0] * sin(w * i) + coef[1] * cos(w * i) + coef[2];
+      double err = out[i * 2] - fit;
+      signal    += fit * fit;
+      noise     += err * err;
+   }
+
+   if (noise <= 0)
+      return 999.0;
+   return 10.0 * log10(signal / noise);
+}
+
+/* Returns false if this kernel is not available, or selects
+ * a process() already in 'seen' (a kernel left out of the build). */
+static bool run(const struct kernel *kernel, enum resampler_quality quality,
+      const struct conversion *conv, const float *in, size_t in_frames,
+      resampler_process_t *seen, struct result *res)
+{
+   size_t pos;
+   retro_time_t elapsed    = 0;
+   double ratio            = conv->out_rate / conv->in_rate;
+   /* Frequency of the test tone, well inside the passband
+    * of every preset at both rates */
+   double tone             = 997.0;
+   size_t skip;
+   unsigned k;
+   resampler_simd_mask_t mask = kernel->mask
+      & (resampler_simd_mask_t)cpu_features_get();
+   void *re;
+
+   if (kernel->mask && mask != kernel->mask)
+      return false;
+   if (!(re = sinc_resampler.init(NULL, ratio, quality, mask)))
+      return false;
+   for (k = 0; seen[k]; k++)
+   {
+      if (seen[k] == sinc_resampler.process)
+      {
+         sinc_resampler.free(re);
+         return false;
+      }
+   }
+   seen[k]         = sinc_resampler.process;
+
+   res->out_frames = 0;
+   res->out        = (float*)malloc(
+         ((size_t)(in_frames * ratio) + BLOCK_FRAMES * 4) * 2 * sizeof(float));
+   if (!res->out)
+   {
+      sinc_resampler.free(re);
+      return false;
+   }
+
+   for (pos = 0; pos < in_frames; pos += BLOCK_FRAMES)
+   {
+      struct resampler_data data;
+      retro_time_t start;
+
+      data.data_in       = in + pos * 2;
+      data.data_out      = res->out + res->out_frames * 2;
+      data.input_frames  = MIN(BLOCK_FRAMES, in_frames - pos);
+      data.output_frames = 0;
+      data.ratio         = ratio;
+
+      start              = cpu_features_get_time_usec();
+      sinc_resampler.process(re, &data);
+      elapsed           += cpu_features_get_time_usec() - start;
+      res->out_frames   += data.output_frames;
+   }
+   sinc_resampler.free(re);
+
+   /* Leave out the filter warming up */
+   skip              = MIN(res->out_frames / 4, (size_t)4096);
+   res->ns_per_frame = res->out_frames
+      ? (double)elapsed * 1000.0 / (double)res->out_frames : 0;
+   res->snr          = measure_snr(res->out + skip * 2,
+         res->out_frames - skip, 2.0 * M_PI * tone / conv->out_rate);
+   return true;
+}
+
+static int bench(enum resampler_quality quality,
+      const struct conversion *conv, double seconds)
+{
+   unsigned k;
+   size_t i;
+   int failures              = 0;
+   size_t in_frames          = (size_t)(conv->in_rate * seconds);
+   float *in                 = (float*)malloc(in_frames * 2 * sizeof(float));
+   resampler_process_t seen[ARRAY_SIZE(kernels) + 1] = {0};
+   struct result ref         = {0};
+
+   if (!in)
+      return 1;
+   for (i = 0; i < in_frames; i++)
+   {
+      float v       = (float)(0.5 * sin(2.0 * M_PI * 997.0 * i / conv->in_rate));
+      in[i * 2 + 0] = v;
+      in[i * 2 + 1] = -v;
+   }
+
+   printf("%-8s %6.0f -> %6.0f Hz\n", quality_names[quality],
+         conv->in_rate, conv->out_rate);
+
+   for (k = 0; k < ARRAY_SIZE(kernels); k++)
+   {
+      struct result res;
+
+      if (!run(&kernels[k], quality, conv, in, in_frames, seen, &res))
+         continue;
+
+      printf("   %-8s %8.1f ns/frame %7.1f dB SNR", kernels[k].name,
+            res.ns_per_frame, res.snr);
+
+      if (!ref.out)
+      {
+         ref = res;
+         printf("\n");
+         continue;
+      }
+
+      if (res.snr < ref.snr - 1.0)
+      {
+         printf("   FAIL: %.1f dB below C\n", ref.snr - res.snr);
+         failures++;
+      }
+      else if (conv->out_rate >= conv->in_rate)
+      {
+         double diff = 0;
+         size_t n    = MIN(res.out_frames, ref.out_frames) * 2;
+
+         if (res.out_frames != ref.out_frames)
+            diff = HUGE_VAL;
+         for (i = 0; i < n; i++)
+            diff = MAX(diff, fabs((double)res.out[i] - ref.out[i]));
+         printf("   max diff %.2e", diff);
+         if (diff > MAX_KERNEL_DIFF)
+         {
+            printf("   FAIL: differs from C");
+            failures++;
+         }
+         printf("\n");
+      }
+      else
+         printf("\n");
+      free(res.out);
+   }
+
+   free(ref.out);
+   free(in);
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned q, c;
+   int failures   = 0;
+   double seconds = 2.0;
+
+   if (argc > 2 || (argc == 2 && (seconds = atof(argv[1])) <= 0.0))
+   {
+      fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+      return 1;
+   }
+
+   for (q = RESAMPLER_QUALITY_LOWEST; q <= RESAMPLER_QUALITY_HIGHEST; q++)
+      for (c = 0; c < ARRAY_SIZE(conversions); c++)
+         failures += bench((enum resampler_quality)q, &conversions[c], seconds);
+
+   if (failures)
+   {
+      printf("%d kernel check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
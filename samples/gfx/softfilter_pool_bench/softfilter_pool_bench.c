@@ -0,0 +1,347 @@
+/* Benchmark and consistency check for the softfilter worker pool
+ * in gfx/video_filter.c.
+ *
+ *   softfilter_pool_bench <plugin dir> [seconds] [max threads]
+ *
+ * Every .filt in the plugin directory is loaded through
+ * rarch_softfilter_new(), the way the video driver does, once per
+ * input format it takes and once per thread count from 1 up to
+ * 'max threads' (16 by default).  A 256x224 frame of noise is run
+ * through each of them:
+ *   - hot:   frames back to back for 'seconds', as a fast-forwarding
+ *            core would; workers never get to park,
+ *   - paced: a few frames with a sleep in between, as at 60 Hz;
+ *            workers park between frames and have to be woken,
+ *   - async: the same through rarch_softfilter_process_async(), as
+ *            the pipelined video filter does, with the sleep standing
+ *            in for the core; only the time the caller is held up
+ *            counts.
+ * Microseconds per frame are printed for all three.  The first frames
+ * out of each instance, with and without parking in between and
+ * through either entry point, have to come out the same as with one
+ * thread, byte for byte.
+ *
+ * Exit status is non-zero if a filter fails to load or an output
+ * differs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include <boolean.h>
+#include <retro_miscellaneous.h>
+#include <retro_timers.h>
+#include <file/file_path.h>
+#include <lists/dir_list.h>
+#include <lists/string_list.h>
+#include <features/features_cpu.h>
+#include <compat/strl.h>
+
+#include "../../../gfx/video_filter.h"
+
+#define IN_WIDTH      256
+#define IN_HEIGHT     224
+#define PACED_FRAMES  8
+#define CHECK_FRAMES  4
+#define PACED_MSEC    4
+
+/* verbosity.c is not linked. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+/* The plugins are built with the host's extension. */
+size_t frontend_driver_get_core_extension(char *s, size_t len)
+{
+#if defined(_WIN32)
+   return strlcpy(s, "dll", len);
+#elif defined(__APPLE__)
+   return strlcpy(s, "dylib", len);
+#else
+   return strlcpy(s, "so", len);
+#endif
+}
+
+static const unsigned thread_counts[] = { 1, 2, 3, 4, 6, 8, 12, 16 };
+
+struct format
+{
+   const char *name;
+   enum retro_pixel_format fmt;
+   unsigned bpp;
+};
+
+static const struct format formats[] = {
+   { "RGB565",   RETRO_PIXEL_FORMAT_RGB565,   2 },
+   { "XRGB8888", RETRO_PIXEL_FORMAT_XRGB8888, 4 }
+};
+
+struct frame
+{
+   uint8_t *data;
+   size_t stride;
+   size_t size;
+   unsigned width;
+   unsigned height;
+};
+
+static bool frame_alloc(struct frame *frame, rarch_softfilter_t *filt)
+{
+   unsigned bpp;
+
+   rarch_softfilter_get_output_size(filt, &frame->width, &frame->height,
+         IN_WIDTH, IN_HEIGHT);
+   bpp           = rarch_softfilter_get_output_format(filt)
+      == RETRO_PIXEL_FORMAT_RGB565 ? 2 : 4;
+   frame->stride = (size_t)frame->width * bpp;
+   frame->size   = frame->stride * frame->height;
+   frame->data   = (uint8_t*)calloc(1, frame->size ? frame->size : 1);
+   return frame->data != NULL;
+}
+
+/* Flat patches over noise, so that edge-directed filters see both. */
+static void fill_input(uint8_t *in, const struct format *format)
+{
+   unsigned x, y;
+   uint32_t seed = 0x12345678;
+
+   for (y = 0; y < IN_HEIGHT; y++)
+   {
+      for (x = 0; x < IN_WIDTH; x++)
+      {
+         uint32_t c;
+         seed = seed * 1664525u + 1013904223u;
+         c    = ((x / 16 + y / 16) & 1) ? seed >> 8 : (x / 16) * 0x0a1b2c;
+
+         if (format->bpp == 2)
+            ((uint16_t*)in)[y * IN_WIDTH + x] = (uint16_t)c;
+         else
+            ((uint32_t*)in)[y * IN_WIDTH + x] = c & 0xffffff;
+      }
+   }
+}
+
+static void process(rarch_softfilter_t *filt, struct frame *out,
+      const uint8_t *in, const struct format *format)
+{
+   rarch_softfilter_process(filt, out->data, out->stride,
+         in, IN_WIDTH, IN_HEIGHT, IN_WIDTH * format->bpp);
+}
+
+static void process_async(rarch_softfilter_t *filt, struct frame *out,
+      const uint8_t *in, const struct format *format)
+{
+   rarch_softfilter_process_async(filt, out->data, out->stride,
+         in, IN_WIDTH, IN_HEIGHT, IN_WIDTH * format->bpp);
+}
+
+static bool bench_filter(const char *path, const struct format *format,
+      const uint8_t *in, float seconds, unsigned max_threads,
+      bool *supported)
+{
+   unsigned i;
+   double hot[ARRAY_SIZE(thread_counts)];
+   double paced[ARRAY_SIZE(thread_counts)];
+   double async[ARRAY_SIZE(thread_counts)];
+   uint8_t *ref        = NULL;
+   unsigned num_counts = 0;
+   bool ok             = true;
+
+   for (i = 0; i < ARRAY_SIZE(thread_counts); i++)
+   {
+      unsigned frames;
+      retro_time_t start, elapsed;
+      struct frame out;
+      rarch_softfilter_t *filt;
+
+      if (thread_counts[i] > max_threads)
+         break;
+
+      if (!(filt = rarch_softfilter_new(path, thread_counts[i],
+                  format->fmt, IN_WIDTH, IN_HEIGHT)))
+      {
+         /* Not every filter takes both formats. */
+         free(ref);
+         return i == 0;
+      }
+      *supported = true;
+
+      if (     !frame_alloc(&out, filt)
+            || (!ref && !(ref = (uint8_t*)malloc(
+                     CHECK_FRAMES * out.size + 1))))
+      {
+         free(out.data);
+         free(ref);
+         rarch_softfilter_free(filt);
+         return false;
+      }
+
+      /* Some filters change from frame to frame, so it is the first
+       * few frames of a fresh instance that are compared, every other
+       * one after the workers have had time to park.  Past one thread
+       * the second half goes through the async path and still has to
+       * match what the first instance made of them in the foreground. */
+      for (frames = 0; frames < CHECK_FRAMES; frames++)
+      {
+         uint8_t *expected = ref + frames * out.size;
+
+         if (frames & 1)
+            retro_sleep(PACED_MSEC);
+         memset(out.data, 0, out.size);
+         if (i > 0 && frames >= CHECK_FRAMES / 2)
+         {
+            process_async(filt, &out, in, format);
+            rarch_softfilter_wait(filt);
+         }
+         else
+            process(filt, &out, in, format);
+
+         if (i == 0)
+            memcpy(expected, out.data, out.size);
+         else if (memcmp(out.data, expected, out.size))
+         {
+            printf("  MISMATCH: %s %s, frame %u at %u threads\n",
+                  path_basename(path), format->name, frames,
+                  thread_counts[i]);
+            ok = false;
+            break;
+         }
+      }
+
+      frames = 0;
+      start  = cpu_features_get_time_usec();
+      do
+      {
+         process(filt, &out, in, format);
+         frames++;
+         elapsed = cpu_features_get_time_usec() - start;
+      } while (elapsed < (retro_time_t)(seconds * 1000000.0f) || frames < 4);
+      hot[i] = (double)elapsed / frames;
+
+      paced[i] = 0.0;
+      for (frames = 0; frames < PACED_FRAMES; frames++)
+      {
+         retro_sleep(PACED_MSEC);
+         start     = cpu_features_get_time_usec();
+         process(filt, &out, in, format);
+         paced[i] += (double)(cpu_features_get_time_usec() - start);
+      }
+      paced[i] /= PACED_FRAMES;
+
+      async[i] = 0.0;
+      for (frames = 0; frames < PACED_FRAMES; frames++)
+      {
+         start     = cpu_features_get_time_usec();
+         process_async(filt, &out, in, format);
+         async[i] += (double)(cpu_features_get_time_usec() - start);
+         retro_sleep(PACED_MSEC);
+         start     = cpu_features_get_time_usec();
+         rarch_softfilter_wait(filt);
+         async[i] += (double)(cpu_features_get_time_usec() - start);
+      }
+      async[i] /= PACED_FRAMES;
+
+      free(out.data);
+      rarch_softfilter_free(filt);
+      num_counts++;
+   }
+
+   printf("%-44s %-8s hot  ", path_basename(path), format->name);
+   for (i = 0; i < num_counts; i++)
+      printf(" %8.1f", hot[i]);
+   printf("\n%-44s %-8s paced", "", "");
+   for (i = 0; i < num_counts; i++)
+      printf(" %8.1f", paced[i]);
+   printf("\n%-44s %-8s async", "", "");
+   for (i = 0; i < num_counts; i++)
+      printf(" %8.1f", async[i]);
+   printf("\n");
+
+   free(ref);
+   return ok;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i, j;
+   struct string_list *list;
+   uint8_t *in;
+   float seconds        = 0.2f;
+   unsigned max_threads = 16;
+   unsigned failures    = 0;
+   unsigned benched     = 0;
+
+   if (argc < 2)
+   {
+      fprintf(stderr, "Usage: %s <plugin dir> [seconds] [max threads]\n",
+            argv[0]);
+      return 1;
+   }
+   if (argc > 2)
+      seconds = (float)atof(argv[2]);
+   if (argc > 3)
+      max_threads = (unsigned)atoi(argv[3]);
+   if (!max_threads)
+      max_threads = 1;
+
+   if (!(list = dir_list_new(argv[1], "filt", false, false, false, false)))
+   {
+      fprintf(stderr, "No .filt files in %s\n", argv[1]);
+      return 1;
+   }
+   dir_list_sort(list, false);
+
+   in = (uint8_t*)malloc(IN_WIDTH * IN_HEIGHT * 4);
+
+   printf("%u cores, %ux%u input, us per frame\n%-44s %-8s      ",
+         cpu_features_get_core_amount(), IN_WIDTH, IN_HEIGHT,
+         "filter", "format");
+   for (i = 0; i < ARRAY_SIZE(thread_counts)
+         && thread_counts[i] <= max_threads; i++)
+      printf(" %7ut", thread_counts[i]);
+   printf("\n");
+
+   for (i = 0; i < list->size; i++)
+   {
+      bool any = false;
+
+      for (j = 0; j < ARRAY_SIZE(formats); j++)
+      {
+         bool supported = false;
+         fill_input(in, &formats[j]);
+         if (!bench_filter(list->elems[i].data, &formats[j], in,
+                  seconds, max_threads, &supported))
+            failures++;
+         any |= supported;
+      }
+
+      if (any)
+         benched++;
+      else
+      {
+         /* NULL.filt names no filter at all and is meant to fail. */
+         if (!strstr(list->elems[i].data, "NULL.filt"))
+         {
+            printf("%-44s failed to load\n",
+                  path_basename(list->elems[i].data));
+            failures++;
+         }
+      }
+   }
+
+   printf("%u filters benchmarked\n", benched);
+   free(in);
+   string_list_free(list);
+
+   if (failures)
+   {
+      printf("%u FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,349 @@
+/* Golden-image test and benchmark for the vector kernels in
+ * gfx/video_filters.
+ *
+ *   softfilter_simd_test [seconds]
+ *
+ * Scale2x, EPX, LQ2x, 2xSaI, SuperEagle and 2xBR pick their kernels
+ * from the SIMD mask they are created with.  Each of them is run with
+ * an empty mask, which gives the scalar code, and then with every mask
+ * this CPU supports, over a handful of sizes and images: noise, flat,
+ * a three-colour palette (so that the equality tests in the pixel-art
+ * scalers go both ways), gradients and blocks.
+ * The outputs have to match the scalar ones byte for byte, including
+ * the bytes around the image that no filter should write.
+ *
+ * The scalar kernels read a row and a couple of pixels past the edges
+ * of the frame, as they do in RetroArch, so the input has a border of
+ * noise around it.
+ *
+ * Microseconds per 256x224 frame are printed for each mask.  Exit
+ * status is non-zero if an output differs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#include <boolean.h>
+#include <retro_miscellaneous.h>
+#include <features/features_cpu.h>
+
+#include "softfilter.h"
+
+#define BORDER_X      8
+#define BORDER_Y      4
+#define GUARD         64
+#define BENCH_WIDTH   256
+#define BENCH_HEIGHT  224
+
+extern const struct softfilter_implementation *scale2x_get_implementation(softfilter_simd_mask_t simd);
+extern const struct softfilter_implementation *epx_get_implementation(softfilter_simd_mask_t simd);
+extern const struct softfilter_implementation *lq2x_get_implementation(softfilter_simd_mask_t simd);
+extern const struct softfilter_implementation *twoxsai_get_implementation(softfilter_simd_mask_t simd);
+extern const struct softfilter_implementation *supereagle_get_implementation(softfilter_simd_mask_t simd);
+extern const struct softfilter_implementation *twoxbr_get_implementation(softfilter_simd_mask_t simd);
+
+static const softfilter_get_implementation_t filters[] = {
+   scale2x_get_implementation,
+   epx_get_implementation,
+   lq2x_get_implementation,
+   twoxsai_get_implementation,
+   supereagle_get_implementation,
+   twoxbr_get_implementation
+};
+
+struct mask
+{
+   const char *name;
+   softfilter_simd_mask_t simd;
+};
+
+static const struct mask masks[] = {
+   { "sse2", SOFTFILTER_SIMD_SSE2 },
+   { "avx2", SOFTFILTER_SIMD_SSE2 | SOFTFILTER_SIMD_AVX2 }
+};
+
+struct format
+{
+   const char *name;
+   unsigned fmt;
+   unsigned bpp;
+};
+
+static const struct format formats[] = {
+   { "RGB565",   SOFTFILTER_FMT_RGB565,   2 },
+   { "XRGB8888", SOFTFILTER_FMT_XRGB8888, 4 }
+};
+
+static const unsigned sizes[][2] = {
+   { 256, 224 },
+   { 61,  13  },
+   { 17,  3   },
+   { 5,   2   }
+};
+
+enum pattern
+{
+   PATTERN_NOISE = 0,
+   PATTERN_FLAT,
+   PATTERN_PALETTE,
+   PATTERN_GRADIENT,
+   PATTERN_BLOCKS,
+   PATTERN_LAST
+};
+
+static const char *pattern_names[] = {
+   "noise", "flat", "palette", "gradient", "blocks"
+};
+
+static const struct softfilter_config config;
+
+static uint32_t seed = 0x12345678;
+
+static uint32_t rand_u32(void)
+{
+   seed = seed * 1664525u + 1013904223u;
+   return seed ^ (seed >> 15);
+}
+
+static uint32_t pattern_pixel(enum pattern pattern, unsigned x, unsigned y)
+{
+   static const uint32_t palette[] = { 0x102030, 0xf0e0d0, 0x30a050 };
+
+   switch (pattern)
+   {
+      case PATTERN_FLAT:
+         return 0x4080c0;
+      case PATTERN_PALETTE:
+         return palette[rand_u32() % 3];
+      case PATTERN_GRADIENT:
+         return ((x * 4) & 0xff) << 16 | ((y * 4) & 0xff) << 8
+            | ((x + y) & 0xff);
+      case PATTERN_BLOCKS:
+         return ((x / 4 + y / 3) & 1) ? palette[(x / 8) % 3] : rand_u32();
+      default:
+         break;
+   }
+   return rand_u32();
+}
+
+/* Returns the top left pixel of a width x height image inside a
+ * noise border. */
+static uint8_t *make_input(uint8_t *buf, size_t stride,
+      const struct format *format, enum pattern pattern,
+      unsigned width, unsigned height)
+{
+   unsigned x, y;
+   unsigned total_w = width  + 2 * BORDER_X;
+   unsigned total_h = height + 2 * BORDER_Y;
+
+   for (y = 0; y < total_h; y++)
+   {
+      for (x = 0; x < total_w; x++)
+      {
+         bool inside = x >= BORDER_X && x < BORDER_X + width
+            && y >= BORDER_Y && y < BORDER_Y + height;
+         uint32_t c  = inside
+            ? pattern_pixel(pattern, x - BORDER_X, y - BORDER_Y)
+            : rand_u32();
+
+         if (format->bpp == 2)
+            ((uint16_t*)(buf + y * stride))[x] = (uint16_t)
+               (((c >> 8) & 0xf800) | ((c >> 5) & 0x07e0) | ((c >> 3) & 0x001f));
+         else
+            ((uint32_t*)(buf + y * stride))[x] = c & 0xffffff;
+      }
+   }
+
+   return buf + BORDER_Y * stride + BORDER_X * format->bpp;
+}
+
+static void run_filter(const struct softfilter_implementation *impl,
+      void *filt, uint8_t *out, size_t out_stride,
+      const uint8_t *in, unsigned width, unsigned height, size_t in_stride)
+{
+   unsigned i;
+   struct softfilter_work_packet packets[16];
+   unsigned num = impl->query_num_threads(filt);
+
+   impl->get_work_packets(filt, packets, out, out_stride,
+         in, width, height, in_stride);
+   for (i = 0; i < num; i++)
+      packets[i].work(filt, packets[i].thread_data);
+}
+
+/* Runs a filter created with 'simd' over the image into 'out', which
+ * has GUARD bytes of 0xa5 before and after the frame. */
+static bool filter_image(softfilter_get_implementation_t get_impl,
+      softfilter_simd_mask_t simd, const struct format *format,
+      const uint8_t *in, size_t in_stride, unsigned width, unsigned height,
+      uint8_t **out, size_t *out_size)
+{
+   unsigned out_w, out_h;
+   size_t stride;
+   void *filt;
+   const struct softfilter_implementation *impl = get_impl(simd);
+
+   if (!(impl->query_input_formats() & format->fmt))
+      return false;
+   if (!(filt = impl->create(&config, format->fmt, format->fmt,
+               width, height, 1, simd, NULL)))
+      return false;
+
+   impl->query_output_size(filt, &out_w, &out_h, width, height);
+   /* A padded pitch, to catch kernels that assume a packed frame. */
+   stride    = (size_t)(out_w + 2) * format->bpp;
+   *out_size = stride * out_h + 2 * GUARD;
+   *out      = (uint8_t*)malloc(*out_size);
+   memset(*out, 0xa5, *out_size);
+
+   run_filter(impl, filt, *out + GUARD, stride, in, width, height, in_stride);
+   impl->destroy(filt);
+   return true;
+}
+
+static double bench_image(softfilter_get_implementation_t get_impl,
+      softfilter_simd_mask_t simd, const struct format *format,
+      const uint8_t *in, size_t in_stride, float seconds)
+{
+   unsigned out_w, out_h;
+   size_t stride;
+   uint8_t *out;
+   unsigned frames = 0;
+   retro_time_t start, elapsed;
+   const struct softfilter_implementation *impl = get_impl(simd);
+   void *filt = impl->create(&config, format->fmt, format->fmt,
+         BENCH_WIDTH, BENCH_HEIGHT, 1, simd, NULL);
+
+   if (!filt)
+      return 0.0;
+
+   impl->query_output_size(filt, &out_w, &out_h, BENCH_WIDTH, BENCH_HEIGHT);
+   stride = (size_t)out_w * format->bpp;
+   out    = (uint8_t*)calloc(1, stride * out_h);
+
+   start  = cpu_features_get_time_usec();
+   do
+   {
+      run_filter(impl, filt, out, stride, in,
+            BENCH_WIDTH, BENCH_HEIGHT, in_stride);
+      frames++;
+      elapsed = cpu_features_get_time_usec() - start;
+   } while (elapsed < (retro_time_t)(seconds * 1000000.0f) || frames < 4);
+
+   free(out);
+   impl->destroy(filt);
+   return (double)elapsed / frames;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned f, i, j, k, p;
+   struct mask supported[ARRAY_SIZE(masks)];
+   unsigned num_supported = 0;
+   unsigned failures      = 0;
+   unsigned checked       = 0;
+   float seconds          = 0.2f;
+   uint64_t cpu           = cpu_features_get();
+   size_t in_stride       = (BENCH_WIDTH + 2 * BORDER_X) * 4;
+   uint8_t *in_buf        = (uint8_t*)malloc(
+         in_stride * (BENCH_HEIGHT + 2 * BORDER_Y));
+
+   if (argc > 1)
+      seconds = (float)atof(argv[1]);
+
+   /* The filter masks use the same bits as RETRO_SIMD_*. */
+   for (i = 0; i < ARRAY_SIZE(masks); i++)
+      if ((cpu & masks[i].simd) == masks[i].simd)
+         supported[num_supported++] = masks[i];
+
+   printf("Masks:");
+   for (i = 0; i < num_supported; i++)
+      printf(" %s", supported[i].name);
+   printf("%s\n", num_supported ? "" : " none, only the scalar code runs");
+
+   for (f = 0; f < ARRAY_SIZE(filters); f++)
+   {
+      const char *ident = filters[f](0)->short_ident;
+
+      for (j = 0; j < ARRAY_SIZE(formats); j++)
+      {
+         const uint8_t *in;
+         const struct format *format = &formats[j];
+         bool any                    = false;
+
+         for (k = 0; k < ARRAY_SIZE(sizes); k++)
+         {
+            for (p = 0; p < PATTERN_LAST; p++)
+            {
+               uint8_t *ref;
+               size_t ref_size;
+               unsigned width  = sizes[k][0];
+               unsigned height = sizes[k][1];
+
+               seed = 0x12345678 + p;
+               in   = make_input(in_buf, in_stride, format,
+                     (enum pattern)p, width, height);
+
+               if (!filter_image(filters[f], 0, format, in, in_stride,
+                        width, height, &ref, &ref_size))
+                  continue;
+               any = true;
+
+               for (i = 0; i < num_supported; i++)
+               {
+                  uint8_t *out;
+                  size_t out_size;
+
+                  if (!filter_image(filters[f], supported[i].simd, format,
+                           in, in_stride, width, height, &out, &out_size))
+                  {
+                     printf("  FAILED: %s %s %s did not create\n",
+                           ident, format->name, supported[i].name);
+                     failures++;
+                     continue;
+                  }
+
+                  checked++;
+                  if (out_size != ref_size || memcmp(out, ref, ref_size))
+                  {
+                     printf("  MISMATCH: %s %s %s, %ux%u %s\n",
+                           ident, format->name, supported[i].name,
+                           width, height, pattern_names[p]);
+                     failures++;
+                  }
+                  free(out);
+               }
+               free(ref);
+            }
+         }
+
+         if (!any)
+            continue;
+
+         seed = 0x12345678;
+         in   = make_input(in_buf, in_stride, format, PATTERN_PALETTE,
+               BENCH_WIDTH, BENCH_HEIGHT);
+         printf("%-12s %-8s scalar %8.1f us", ident, format->name,
+               bench_image(filters[f], 0, format, in, in_stride, seconds));
+         for (i = 0; i < num_supported; i++)
+            printf("  %s %8.1f us", supported[i].name,
+                  bench_image(filters[f], supported[i].simd, format,
+                     in, in_stride, seconds));
+         printf("\n");
+      }
+   }
+
+   printf("%u comparisons\n", checked);
+   free(in_buf);
+
+   if (failures)
+   {
+      printf("%u FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
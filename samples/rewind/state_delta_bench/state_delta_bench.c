@@ -0,0 +1,512 @@
+/* Microbenchmark and cross-check for the rewind delta scan kernels
+ * (state_manager_raw.c).
+ *
+ *   state_delta_bench [state0 state1 [state2 ...]]
+ *
+ * Every consecutive pair of files is treated as (older, newer)
+ * savestates, exactly as the rewind buffer would see them.  Dumps
+ * from a real session (e.g. several quicksaves taken a few frames
+ * apart) give the most meaningful numbers.  With no arguments a set
+ * of synthetic 4 MB pairs with different change densities is used
+ * instead, which is what CI runs.
+ *
+ * For each pair, each kernel set built into the codec and each
+ * candidate kernel below that this CPU runs, the benchmark:
+ *   - checks that the patch is byte-identical to the C reference,
+ *   - checks that applying it to the newer state yields the older,
+ *   - reports compress throughput in GB/s of state scanned.
+ *
+ * Exit status is non-zero if any kernel disagrees with the C
+ * reference or fails to round-trip.
+ *
+ * The AVX2 and AVX-512 scans live here rather than in the codec:
+ * they measure no faster than SSE2, so they are only plugged in
+ * through state_manager_raw_set_scan() to keep checking that. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <retro_inline.h>
+#include <compat/intrinsics.h>
+#include <features/features_cpu.h>
+
+#include "../../../state_manager_raw.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+#include <immintrin.h>
+#define BENCH_X86_WIDE
+#define BENCH_TARGET_AVX2   __attribute__((target("avx2")))
+#define BENCH_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(_MSC_VER) && _MSC_VER >= 1910
+#include <immintrin.h>
+#define BENCH_X86_WIDE
+#define BENCH_TARGET_AVX2
+#define BENCH_TARGET_AVX512
+#endif
+#endif
+
+#define SYNTH_SIZE (4 * 1024 * 1024)
+
+/* Minimum wall time spent per kernel/pair measurement. */
+#define BENCH_MIN_USEC 200000
+
+struct state_pair
+{
+   char name[64];
+   uint8_t *a;
+   uint8_t *b;
+   size_t len;
+   size_t blocksize;
+};
+
+static uint32_t rng_state = 0x12345678u;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Allocates a block with the padding and sentinel layout that
+ * state_manager_new() sets up. */
+static uint8_t *alloc_block(size_t blocksize, uint16_t uniq)
+{
+   uint8_t *block = (uint8_t*)calloc(
+         blocksize + STATE_MANAGER_RAW_PADDING, 1);
+   if (block)
+      ((uint16_t*)block)[blocksize / sizeof(uint16_t) + 3] = uniq;
+   return block;
+}
+
+static bool pair_init(struct state_pair *pair, const char *name, size_t len)
+{
+   pair->len       = len;
+   pair->blocksize = (len + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
+   pair->a         = alloc_block(pair->blocksize, 0);
+   pair->b         = alloc_block(pair->blocksize, 1);
+   snprintf(pair->name, sizeof(pair->name), "%s", name);
+   return pair->a && pair->b;
+}
+
+static void pair_free(struct state_pair *pair)
+{
+   free(pair->a);
+   free(pair->b);
+}
+
+/* 'density' is roughly the fraction (in 1/1000) of 64-byte
+ * lines touched between the two states; touched lines get a
+ * run of 1..64 changed bytes, like RAM and register writes. */
+static bool pair_synth(struct state_pair *pair, unsigned density)
+{
+   size_t i;
+   char name[64];
+
+   snprintf(name, sizeof(name), "synthetic %u/1000", density);
+   if (!pair_init(pair, name, SYNTH_SIZE))
+      return false;
+
+   for (i = 0; i < pair->len; i++)
+      pair->a[i] = (uint8_t)(rng_next() >> 24);
+   memcpy(pair->b, pair->a, pair->len);
+
+   for (i = 0; i + 64 <= pair->len; i += 64)
+   {
+      if (rng_next() % 1000 < density)
+      {
+         size_t j;
+         size_t start = rng_next() % 64;
+         size_t run   = 1 + rng_next() % (64 - start);
+         for (j = 0; j < run; j++)
+            pair->b[i + start + j] ^= (uint8_t)(1 + rng_next() % 255);
+      }
+   }
+
+   return true;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+   long size;
+   uint8_t *buf = NULL;
+   FILE *fp     = fopen(path, "rb");
+
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+
+   if (size > 0 && (buf = (uint8_t*)malloc((size_t)size)))
+   {
+      if (fread(buf, 1, (size_t)size, fp) != (size_t)size)
+      {
+         free(buf);
+         buf = NULL;
+      }
+   }
+
+   fclose(fp);
+   *len = (size_t)size;
+   return buf;
+}
+
+static bool pair_load(struct state_pair *pair,
+      const char *older, const char *newer)
+{
+   size_t len_a, len_b;
+   const char *base;
+   uint8_t *a = read_file(older, &len_a);
+   uint8_t *b = read_file(newer, &len_b);
+   bool ret   = false;
+
+   if (!a || !b)
+      fprintf(stderr, "Could not read \"%s\" or \"%s\".\n", older, newer);
+   else if (len_a != len_b)
+      fprintf(stderr, "Skipping \"%s\" -> \"%s\": size mismatch.\n",
+            older, newer);
+   else
+   {
+      base = strrchr(newer, '/');
+      if (pair_init(pair, base ? base + 1 : newer, len_a))
+      {
+         memcpy(pair->a, a, len_a);
+         memcpy(pair->b, b, len_b);
+         ret = true;
+      }
+   }
+
+   free(a);
+   free(b);
+   return ret;
+}
+
+#ifdef BENCH_X86_WIDE
+/* 'ret' is the uint16_t offset of the first equal uint32_t;
+ * step back one if the word before it matches as well,
+ * like the codec's find_same_c does. */
+static INLINE size_t find_same_finish(const uint16_t *a,
+      const uint16_t *b, size_t ret)
+{
+   if (ret && a[ret - 1] == b[ret - 1])
+      ret--;
+   return ret;
+}
+
+/* Most runs in a busy state are only a few words long, so the
+ * wide kernels first look at 16 bytes, which is all that most
+ * calls need, and only then move on to wide unrolled loads. */
+BENCH_TARGET_AVX2
+static size_t find_change_avx2(const uint16_t *a, const uint16_t *b)
+{
+   const __m256i *a256;
+   const __m256i *b256;
+   uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)a),
+            _mm_loadu_si128((const __m128i*)b)));
+
+   if (mask != 0xffff)
+      return compat_ctz(~mask) >> 1;
+
+   a256 = (const __m256i*)(a + 8);
+   b256 = (const __m256i*)(b + 8);
+
+   for (;;)
+   {
+      /* Two vectors per iteration; the padding covers the
+       * 64-byte overread past the sentinel. */
+      __m256i c0 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(a256),     _mm256_loadu_si256(b256));
+      __m256i c1 = _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(a256 + 1), _mm256_loadu_si256(b256 + 1));
+
+      if (!_mm256_testc_si256(_mm256_and_si256(c0, c1),
+               _mm256_set1_epi8(-1)))
+      {
+         size_t ret = (const uint8_t*)a256 - (const uint8_t*)a;
+
+         mask       = (uint32_t)_mm256_movemask_epi8(c0);
+         if (mask == 0xffffffffu)
+         {
+            mask = (uint32_t)_mm256_movemask_epi8(c1);
+            ret += sizeof(__m256i);
+         }
+
+         return (ret + compat_ctz(~mask)) >> 1;
+      }
+
+      a256 += 2;
+      b256 += 2;
+   }
+}
+
+BENCH_TARGET_AVX2
+static size_t find_same_avx2(const uint16_t *a, const uint16_t *b)
+{
+   const __m256i *a256;
+   const __m256i *b256;
+   uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i*)a),
+            _mm_loadu_si128((const __m128i*)b))));
+
+   if (mask)
+      return find_same_finish(a, b, compat_ctz(mask) * 2);
+
+   a256 = (const __m256i*)(a + 8);
+   b256 = (const __m256i*)(b + 8);
+
+   for (;;)
+   {
+      __m256i c0 = _mm256_cmpeq_epi32(
+            _mm256_loadu_si256(a256),     _mm256_loadu_si256(b256));
+      __m256i c1 = _mm256_cmpeq_epi32(
+            _mm256_loadu_si256(a256 + 1), _mm256_loadu_si256(b256 + 1));
+
+      if (!_mm256_testz_si256(_mm256_or_si256(c0, c1),
+               _mm256_set1_epi8(-1)))
+      {
+         size_t ret = (const uint16_t*)a256 - a;
+
+         mask       = _mm256_movemask_ps(_mm256_castsi256_ps(c0));
+         if (!mask)
+         {
+            mask = _mm256_movemask_ps(_mm256_castsi256_ps(c1));
+            ret += sizeof(__m256i) / sizeof(uint16_t);
+         }
+
+         return find_same_finish(a, b, ret + compat_ctz(mask) * 2);
+      }
+
+      a256 += 2;
+      b256 += 2;
+   }
+}
+
+/* AVX-512F only has 32/64-bit compares, so the change scan
+ * finds the first differing uint32_t and then checks which
+ * of its two halves differs.  Same 16-byte look first as the
+ * AVX2 kernels. */
+BENCH_TARGET_AVX512
+static size_t find_change_avx512(const uint16_t *a, const uint16_t *b)
+{
+   const __m512i *a512;
+   const __m512i *b512;
+   uint32_t mask16 = _mm_movemask_epi8(_mm_cmpeq_epi8(
+            _mm_loadu_si128((const __m128i*)a),
+            _mm_loadu_si128((const __m128i*)b)));
+
+   if (mask16 != 0xffff)
+      return compat_ctz(~mask16) >> 1;
+
+   a512 = (const __m512i*)(a + 8);
+   b512 = (const __m512i*)(b + 8);
+
+   for (;;)
+   {
+      __mmask16 mask = _mm512_cmpneq_epi32_mask(
+            _mm512_loadu_si512(a512), _mm512_loadu_si512(b512));
+
+      if (mask)
+      {
+         size_t ret = ((const uint16_t*)a512 - a)
+            + compat_ctz(mask) * 2;
+         if (a[ret] == b[ret])
+            ret++;
+         return ret;
+      }
+
+      a512++;
+      b512++;
+   }
+}
+
+BENCH_TARGET_AVX512
+static size_t find_same_avx512(const uint16_t *a, const uint16_t *b)
+{
+   const __m512i *a512;
+   const __m512i *b512;
+   uint32_t mask16 = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i*)a),
+            _mm_loadu_si128((const __m128i*)b))));
+
+   if (mask16)
+      return find_same_finish(a, b, compat_ctz(mask16) * 2);
+
+   a512 = (const __m512i*)(a + 8);
+   b512 = (const __m512i*)(b + 8);
+
+   for (;;)
+   {
+      __mmask16 mask = _mm512_cmpeq_epi32_mask(
+            _mm512_loadu_si512(a512), _mm512_loadu_si512(b512));
+
+      if (mask)
+         return find_same_finish(a, b,
+               ((const uint16_t*)a512 - a) + compat_ctz(mask) * 2);
+
+      a512++;
+      b512++;
+   }
+}
+#endif
+
+struct candidate
+{
+   const char *name;
+   uint64_t cpu;
+   state_manager_raw_scan_t find_change;
+   state_manager_raw_scan_t find_same;
+};
+
+static const struct candidate candidates[] = {
+#ifdef BENCH_X86_WIDE
+   { "AVX2",    RETRO_SIMD_AVX | RETRO_SIMD_AVX2,
+      find_change_avx2,   find_same_avx2 },
+   { "AVX-512", RETRO_SIMD_AVX512,
+      find_change_avx512, find_same_avx512 },
+#endif
+   { NULL, 0, NULL, NULL }
+};
+
+/* Checks and times whatever scan kernels the codec has selected. */
+static int bench_kernel(const struct state_pair *pair, const char *name,
+      const uint8_t *ref, size_t ref_len, uint8_t *patch, uint8_t *restored)
+{
+   size_t patch_len;
+   unsigned iterations = 0;
+   retro_time_t start, elapsed;
+
+   patch_len = state_manager_raw_compress(pair->a, pair->b,
+         pair->blocksize, patch);
+
+   if (patch_len != ref_len || memcmp(patch, ref, ref_len))
+   {
+      printf("   %-8s FAIL: patch differs from C reference\n", name);
+      return 1;
+   }
+
+   memcpy(restored, pair->b, pair->len);
+   state_manager_raw_decompress(patch, restored);
+   if (memcmp(restored, pair->a, pair->len))
+   {
+      printf("   %-8s FAIL: patch does not round-trip\n", name);
+      return 1;
+   }
+
+   start = cpu_features_get_time_usec();
+   do
+   {
+      state_manager_raw_compress(pair->a, pair->b,
+            pair->blocksize, patch);
+      iterations++;
+      elapsed = cpu_features_get_time_usec() - start;
+   } while (elapsed < BENCH_MIN_USEC);
+
+   printf("   %-8s %8.2f GB/s\n", name,
+         (double)pair->len * iterations / (double)elapsed / 1000.0);
+   return 0;
+}
+
+static int bench_pair(const struct state_pair *pair)
+{
+   unsigned impl;
+   const struct candidate *c;
+   int failures      = 0;
+   uint64_t cpu      = cpu_features_get();
+   size_t maxsize    = state_manager_raw_maxsize(pair->len);
+   uint8_t *ref      = (uint8_t*)malloc(maxsize);
+   uint8_t *patch    = (uint8_t*)malloc(maxsize);
+   uint8_t *restored = alloc_block(pair->blocksize, 1);
+   size_t ref_len;
+
+   if (!ref || !patch || !restored)
+   {
+      free(ref);
+      free(patch);
+      free(restored);
+      return 1;
+   }
+
+   state_manager_raw_set_impl(STATE_MANAGER_RAW_IMPL_C);
+   ref_len = state_manager_raw_compress(pair->a, pair->b,
+         pair->blocksize, ref);
+
+   printf("%s: %u bytes, patch %u bytes (%.2f%%)\n",
+         pair->name, (unsigned)pair->len, (unsigned)ref_len,
+         100.0 * (double)ref_len / (double)pair->len);
+
+   for (impl = 0; impl < STATE_MANAGER_RAW_IMPL_LAST; impl++)
+   {
+      if (!state_manager_raw_set_impl((enum state_manager_raw_impl)impl))
+         continue;
+      failures += bench_kernel(pair, state_manager_raw_impl_name(
+               (enum state_manager_raw_impl)impl),
+            ref, ref_len, patch, restored);
+   }
+
+   for (c = candidates; c->name; c++)
+   {
+      if ((cpu & c->cpu) != c->cpu)
+         continue;
+      state_manager_raw_set_scan(c->find_change, c->find_same);
+      failures += bench_kernel(pair, c->name,
+            ref, ref_len, patch, restored);
+   }
+   state_manager_raw_init_simd();
+
+   free(ref);
+   free(patch);
+   free(restored);
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   int i;
+   int failures = 0;
+
+   if (argc == 2)
+   {
+      fprintf(stderr, "Usage: %s [state0 state1 [state2 ...]]\n", argv[0]);
+      return 1;
+   }
+
+   if (argc < 2)
+   {
+      static const unsigned densities[] = { 1, 20, 200, 900 };
+      for (i = 0; i < (int)(sizeof(densities) / sizeof(densities[0])); i++)
+      {
+         struct state_pair pair;
+         if (!pair_synth(&pair, densities[i]))
+            return 1;
+         failures += bench_pair(&pair);
+         pair_free(&pair);
+      }
+   }
+   else
+   {
+      for (i = 1; i + 1 < argc; i++)
+      {
+         struct state_pair pair;
+         if (!pair_load(&pair, argv[i], argv[i + 1]))
+            continue;
+         failures += bench_pair(&pair);
+         pair_free(&pair);
+      }
+   }
+
+   if (failures)
+   {
+      printf("%d kernel check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,561 @@
+/* Offline benchmark for the two savestate pipelines that run every
+ * frame or checkpoint:
+ *
+ *   - rewind:      state_manager_raw_compress() on capture and
+ *                  state_manager_raw_decompress() on rewind
+ *                  (state_manager_raw.c),
+ *   - statestream: bsv_movie_write_deduped_state() when recording a
+ *                  replay checkpoint and bsv_movie_read_deduped_state()
+ *                  when playing it back (input/bsv/bsvstatestream.c).
+ *
+ *   state_replay_bench [directory | state0 state1 ...]
+ *
+ * The states are replayed in order, exactly as a session would have
+ * produced them.  A directory is read in file name order; the easiest
+ * way to get one is to set rewind_dump_directory in retroarch.cfg and
+ * play for a while.  With no arguments two synthetic sequences (one
+ * below and one above the statestream "small state" threshold) are
+ * used instead, which is what CI runs.
+ *
+ * For every push and pop the benchmark reports throughput in MB/s of
+ * state processed and p50/p99 latency, plus the overall compression
+ * ratio.  For rewind it also estimates how much of rewind_buffer_size
+ * a minute of capture at 60 states per second takes.
+ *
+ * Every pop is checked against the original state; exit status is
+ * non-zero if any of them differ. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <dirent.h>
+
+#include <features/features_cpu.h>
+
+#include "../../../state_manager_raw.h"
+#include "../../../input/bsv/bsvmovie.h"
+#include "../../../input/bsv/uint32s_index.h"
+
+#define SYNTH_STATES 240
+
+struct state_seq
+{
+   char name[64];
+   uint8_t **states;
+   size_t count;
+   size_t len;
+};
+
+struct latency
+{
+   retro_time_t *usec;
+   size_t count;
+   retro_time_t total;
+};
+
+static uint32_t rng_state = 0x9e3779b9u;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+static bool latency_init(struct latency *lat, size_t count)
+{
+   lat->usec  = (retro_time_t*)calloc(count ? count : 1, sizeof(*lat->usec));
+   lat->count = 0;
+   lat->total = 0;
+   return lat->usec != NULL;
+}
+
+static void latency_add(struct latency *lat, retro_time_t usec)
+{
+   lat->usec[lat->count++] = usec;
+   lat->total             += usec;
+}
+
+static int latency_cmp(const void *a, const void *b)
+{
+   retro_time_t x = *(const retro_time_t*)a;
+   retro_time_t y = *(const retro_time_t*)b;
+   return (x > y) - (x < y);
+}
+
+static void latency_report(struct latency *lat, const char *what,
+      size_t bytes)
+{
+   retro_time_t p50, p99;
+
+   if (!lat->count)
+      return;
+
+   qsort(lat->usec, lat->count, sizeof(*lat->usec), latency_cmp);
+   p50 = lat->usec[(lat->count - 1) / 2];
+   p99 = lat->usec[(lat->count - 1) * 99 / 100];
+
+   printf("   %-5s %9.1f MB/s   p50 %6lld us   p99 %6lld us\n", what,
+         lat->total ? (double)bytes * lat->count / (double)lat->total : 0.0,
+         (long long)p50, (long long)p99);
+   free(lat->usec);
+   lat->usec = NULL;
+}
+
+/* Each state touches a few runs of bytes relative to the previous
+ * one, plus a frame counter, which is roughly what RAM and register
+ * writes between two captures look like. */
+static bool seq_synth(struct state_seq *seq, size_t len)
+{
+   size_t i;
+
+   snprintf(seq->name, sizeof(seq->name), "synthetic %u KB",
+         (unsigned)(len / 1024));
+   seq->len    = len;
+   seq->count  = SYNTH_STATES;
+   seq->states = (uint8_t**)calloc(seq->count, sizeof(*seq->states));
+   if (!seq->states)
+      return false;
+
+   for (i = 0; i < seq->count; i++)
+   {
+      size_t j;
+      if (!(seq->states[i] = (uint8_t*)malloc(len)))
+         return false;
+
+      if (!i)
+      {
+         /* Half noise, half zero-filled, like most cores' RAM. */
+         for (j = 0; j < len / 2; j++)
+            seq->states[i][j] = (uint8_t)(rng_next() >> 24);
+         memset(seq->states[i] + len / 2, 0, len - len / 2);
+         continue;
+      }
+
+      memcpy(seq->states[i], seq->states[i - 1], len);
+      for (j = rng_next() % 64; j > 0; j--)
+      {
+         size_t run   = 1 + rng_next() % 256;
+         size_t start = rng_next() % (len - run);
+         size_t k;
+         for (k = 0; k < run; k++)
+            seq->states[i][start + k] ^= (uint8_t)(rng_next() >> 24);
+      }
+      memcpy(seq->states[i], &i, sizeof(i));
+   }
+
+   return true;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+   long size;
+   uint8_t *buf = NULL;
+   FILE *fp     = fopen(path, "rb");
+
+   if (!fp)
+      return NULL;
+
+   fseek(fp, 0, SEEK_END);
+   size = ftell(fp);
+   fseek(fp, 0, SEEK_SET);
+
+   if (size > 0 && (buf = (uint8_t*)malloc((size_t)size)))
+   {
+      if (fread(buf, 1, (size_t)size, fp) != (size_t)size)
+      {
+         free(buf);
+         buf = NULL;
+      }
+   }
+
+   fclose(fp);
+   *len = (size_t)size;
+   return buf;
+}
+
+static int path_cmp(const void *a, const void *b)
+{
+   return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/* Expands a single directory argument into its sorted entries. */
+static char **list_dir(const char *dir, size_t *count)
+{
+   struct dirent *ent;
+   char **paths = NULL;
+   size_t cap   = 0;
+   DIR *d       = opendir(dir);
+
+   *count       = 0;
+   if (!d)
+      return NULL;
+
+   while ((ent = readdir(d)))
+   {
+      size_t len;
+      if (ent->d_name[0] == '.')
+         continue;
+      if (*count == cap)
+      {
+         char **grown = (char**)realloc(paths,
+               (cap = cap ? cap * 2 : 256) * sizeof(*paths));
+         if (!grown)
+            break;
+         paths = grown;
+      }
+      len = strlen(dir) + strlen(ent->d_name) + 2;
+      if ((paths[*count] = (char*)malloc(len)))
+         snprintf(paths[(*count)++], len, "%s/%s", dir, ent->d_name);
+   }
+
+   closedir(d);
+   qsort(paths, *count, sizeof(*paths), path_cmp);
+   return paths;
+}
+
+static bool seq_load(struct state_seq *seq, char **paths, size_t count)
+{
+   size_t i;
+
+   snprintf(seq->name, sizeof(seq->name), "%u captured states",
+         (unsigned)count);
+   seq->states = (uint8_t**)calloc(count, sizeof(*seq->states));
+   seq->count  = 0;
+   seq->len    = 0;
+   if (!seq->states)
+      return false;
+
+   for (i = 0; i < count; i++)
+   {
+      size_t len;
+      uint8_t *buf = read_file(paths[i], &len);
+
+      if (!buf)
+      {
+         fprintf(stderr, "Could not read \"%s\".\n", paths[i]);
+         return false;
+      }
+      if (seq->count && len != seq->len)
+      {
+         /* The rewind buffer is reset when the state size
+          * changes, so a sequence stops there too. */
+         fprintf(stderr, "\"%s\" changes state size, stopping there.\n",
+               paths[i]);
+         free(buf);
+         break;
+      }
+      seq->len                   = len;
+      seq->states[seq->count++]  = buf;
+   }
+
+   return seq->count >= 2;
+}
+
+static void seq_free(struct state_seq *seq)
+{
+   size_t i;
+   for (i = 0; i < seq->count; i++)
+      free(seq->states[i]);
+   free(seq->states);
+}
+
+/* Allocates a block with the padding and sentinel layout that
+ * state_manager_new() sets up. */
+static uint8_t *alloc_block(size_t blocksize, uint16_t uniq)
+{
+   uint8_t *block = (uint8_t*)calloc(
+         blocksize + STATE_MANAGER_RAW_PADDING, 1);
+   if (block)
+      ((uint16_t*)block)[blocksize / sizeof(uint16_t) + 3] = uniq;
+   return block;
+}
+
+/* Pushes every state the way the rewind buffer does (diffing the new
+ * state against the previous one), then pops them all back. */
+static int bench_rewind(const struct state_seq *seq)
+{
+   size_t i;
+   struct latency push, pop;
+   int failures     = 0;
+   size_t blocksize = (seq->len + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
+   size_t maxsize   = state_manager_raw_maxsize(seq->len);
+   uint64_t stored  = 0;
+   uint8_t **patches = (uint8_t**)calloc(seq->count, sizeof(*patches));
+   uint8_t *blocks[2];
+   uint8_t *patch   = (uint8_t*)malloc(maxsize);
+
+   blocks[0]        = alloc_block(blocksize, 0);
+   blocks[1]        = alloc_block(blocksize, 1);
+
+   if (     !patches || !patch || !blocks[0] || !blocks[1]
+         || !latency_init(&push, seq->count)
+         || !latency_init(&pop,  seq->count))
+      return 1;
+
+   memcpy(blocks[0], seq->states[0], seq->len);
+
+   for (i = 1; i < seq->count; i++)
+   {
+      size_t len;
+      retro_time_t start;
+      uint8_t *prev = blocks[(i - 1) & 1];
+      uint8_t *cur  = blocks[i & 1];
+
+      /* Stands in for serializing the core into nextblock. */
+      memcpy(cur, seq->states[i], seq->len);
+
+      start = cpu_features_get_time_usec();
+      len   = state_manager_raw_compress(prev, cur, blocksize, patch);
+      latency_add(&push, cpu_features_get_time_usec() - start);
+
+      if ((patches[i] = (uint8_t*)malloc(len)))
+         memcpy(patches[i], patch, len);
+      stored += len + sizeof(size_t) * 2;
+   }
+
+   /* thisblock now holds the newest state; walk back to the first. */
+   memcpy(blocks[0], seq->states[seq->count - 1], seq->len);
+   for (i = seq->count - 1; i > 0; i--)
+   {
+      retro_time_t start;
+
+      if (!patches[i])
+         return 1;
+
+      start = cpu_features_get_time_usec();
+      state_manager_raw_decompress(patches[i], blocks[0]);
+      latency_add(&pop, cpu_features_get_time_usec() - start);
+
+      if (memcmp(blocks[0], seq->states[i - 1], seq->len))
+      {
+         printf("   FAIL: rewind pop %u does not match\n", (unsigned)i);
+         failures++;
+         break;
+      }
+   }
+
+   printf("%s, %u bytes each\n", seq->name, (unsigned)seq->len);
+   printf(" rewind (%s kernels): ratio %.1fx, ~%.1f MB per minute at 60 states/s\n",
+         state_manager_raw_impl_name(state_manager_raw_get_impl()),
+         (double)seq->len * (seq->count - 1) / (double)stored,
+         (double)stored / (seq->count - 1) * 3600.0 / 1000000.0);
+   latency_report(&push, "push", seq->len);
+   latency_report(&pop,  "pop",  seq->len);
+
+   for (i = 0; i < seq->count; i++)
+      free(patches[i]);
+   free(patches);
+   free(patch);
+   free(blocks[0]);
+   free(blocks[1]);
+   return failures;
+}
+
+static bool movie_init(bsv_movie_t *movie, size_t state_size)
+{
+   bool is_small            = state_size < SMALL_STATE_THRESHOLD;
+   uint32_t superblock_size = is_small
+      ? SMALL_SUPERBLOCK_SIZE : DEFAULT_SUPERBLOCK_SIZE;
+   uint32_t block_size      = is_small
+      ? SMALL_BLOCK_SIZE      : DEFAULT_BLOCK_SIZE;
+
+   memset(movie, 0, sizeof(*movie));
+   movie->commit_interval  = REPLAY_DEFAULT_COMMIT_INTERVAL;
+   movie->commit_threshold = REPLAY_DEFAULT_COMMIT_THRESHOLD;
+   movie->superblocks      = uint32s_index_new(superblock_size,
+         movie->commit_interval, movie->commit_threshold);
+   movie->blocks           = uint32s_index_new(block_size / 4,
+         movie->commit_interval, movie->commit_threshold);
+   return movie->superblocks && movie->blocks;
+}
+
+static void movie_deinit(bsv_movie_t *movie)
+{
+   if (movie->superblocks)
+      uint32s_index_free(movie->superblocks);
+   if (movie->blocks)
+      uint32s_index_free(movie->blocks);
+   free(movie->superblock_seq);
+   free(movie->cur_save);
+   free(movie->last_save);
+}
+
+/* Encodes every state as a replay checkpoint, with the same buffer
+ * juggling as bsv_movie_write_checkpoint(), and decodes the stream
+ * again with a second movie, as playback would. */
+static int bench_statestream(const struct state_seq *seq)
+{
+   size_t i;
+   bsv_movie_t writer, reader;
+   struct latency push, pop;
+   int failures      = 0;
+   uint64_t encoded  = 0;
+   size_t capacity   = seq->len + seq->len / 2;
+   uint8_t **frames  = (uint8_t**)calloc(seq->count, sizeof(*frames));
+   size_t *sizes     = (size_t*)calloc(seq->count, sizeof(*sizes));
+   uint8_t *out      = (uint8_t*)malloc(capacity);
+
+   if (     !frames || !sizes || !out
+         || !movie_init(&writer, seq->len)
+         || !movie_init(&reader, seq->len)
+         || !latency_init(&push, seq->count)
+         || !latency_init(&pop,  seq->count))
+      return 1;
+
+   for (i = 0; i < seq->count; i++)
+   {
+      int64_t len;
+      uint8_t *swap;
+      size_t size_swap;
+      retro_time_t start;
+
+      if (writer.cur_save_size < seq->len)
+      {
+         free(writer.cur_save);
+         writer.cur_save = NULL;
+      }
+      if (!writer.cur_save)
+      {
+         writer.cur_save_size  = seq->len;
+         writer.cur_save       = (uint8_t*)malloc(seq->len);
+         writer.cur_save_valid = false;
+      }
+      /* Stands in for core_serialize(). */
+      memcpy(writer.cur_save, seq->states[i], seq->len);
+      writer.frame_counter  = i;
+
+      start = cpu_features_get_time_usec();
+      len   = bsv_movie_write_deduped_state(&writer, writer.cur_save,
+            seq->len, out, capacity);
+      latency_add(&push, cpu_features_get_time_usec() - start);
+
+      if (len <= 0 || !(frames[i] = (uint8_t*)malloc((size_t)len)))
+         return 1;
+      memcpy(frames[i], out, (size_t)len);
+      sizes[i]  = (size_t)len;
+      encoded  += (uint64_t)len;
+
+      size_swap              = writer.cur_save_size;
+      writer.cur_save_size   = writer.last_save_size;
+      writer.last_save_size  = size_swap;
+      swap                   = writer.cur_save;
+      writer.cur_save        = writer.last_save;
+      writer.last_save       = swap;
+      writer.cur_save_valid  = writer.cur_save != NULL;
+   }
+
+   reader.cur_save      = (uint8_t*)malloc(seq->len);
+   reader.cur_save_size = seq->len;
+   for (i = 0; i < seq->count; i++)
+   {
+      bool ok;
+      retro_time_t start;
+
+      reader.frame_counter  = i;
+
+      start = cpu_features_get_time_usec();
+      ok    = bsv_movie_read_deduped_state(&reader, frames[i], sizes[i]);
+      latency_add(&pop, cpu_features_get_time_usec() - start);
+
+      reader.last_save_size = reader.cur_save_size;
+
+      if (!ok || memcmp(reader.cur_save, seq->states[i], seq->len))
+      {
+         printf("   FAIL: statestream checkpoint %u does not decode\n",
+               (unsigned)i);
+         failures++;
+         break;
+      }
+   }
+
+   printf(" statestream: ratio %.1fx, %u distinct blocks\n",
+         (double)seq->len * seq->count / (double)encoded,
+         uint32s_index_count(writer.blocks));
+   latency_report(&push, "push", seq->len);
+   latency_report(&pop,  "pop",  seq->len);
+
+   for (i = 0; i < seq->count; i++)
+      free(frames[i]);
+   free(frames);
+   free(sizes);
+   free(out);
+   movie_deinit(&writer);
+   movie_deinit(&reader);
+   return failures;
+}
+
+static int bench_seq(const struct state_seq *seq)
+{
+   int failures = bench_rewind(seq);
+   failures    += bench_statestream(seq);
+   putchar('\n');
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   int failures = 0;
+
+   state_manager_raw_init_simd();
+
+   if (argc < 2)
+   {
+      static const size_t sizes[] = { 256 * 1024, 4 * 1024 * 1024 };
+      size_t i;
+      for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      {
+         struct state_seq seq;
+         memset(&seq, 0, sizeof(seq));
+         if (!seq_synth(&seq, sizes[i]))
+            return 1;
+         failures += bench_seq(&seq);
+         seq_free(&seq);
+      }
+   }
+   else
+   {
+      struct state_seq seq;
+      size_t count  = 0;
+      char **paths  = NULL;
+
+      memset(&seq, 0, sizeof(seq));
+      if (argc == 2 && (paths = list_dir(argv[1], &count)))
+      {
+         bool ok = seq_load(&seq, paths, count);
+         size_t i;
+         for (i = 0; i < count; i++)
+            free(paths[i]);
+         free(paths);
+         if (!ok)
+            return 1;
+      }
+      else if (!seq_load(&seq, argv + 1, (size_t)(argc - 1)))
+      {
+         fprintf(stderr,
+               "Usage: %s [directory | state0 state1 [state2 ...]]\n",
+               argv[0]);
+         return 1;
+      }
+      failures += bench_seq(&seq);
+      seq_free(&seq);
+   }
+
+   if (failures)
+   {
+      printf("%d check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ *  RetroArch - A frontend for libretro.
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation, either version 3 of the License, or (at your option)
+ *  any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ *  FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ *  more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with RetroArch. If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/* Copy of input/bsv/uint32s_index.h from before the block lookup table moved
+ * to open addressing (rhmap of buckets), kept as the baseline for
+ * uint32s_index_bench.  Symbols carry a legacy_ prefix so both
+ * versions link into the same binary; do not fix or modernise. */
+
+#ifndef __LEGACY_UINT32S_INDEX__H
+#define __LEGACY_UINT32S_INDEX__H
+
+#ifdef HAVE_STATESTREAM
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <boolean.h>
+#include <retro_common_api.h>
+
+struct legacy_uint32s_bucket
+{
+   uint32_t len; /* if < 4, contents is idxs. */
+   union {
+     uint32_t idxs[3];
+     struct {
+       uint32_t cap;
+       uint32_t *idxs;
+     } vec;
+   } contents;
+};
+
+struct legacy_uint32s_frame_addition
+{
+   uint64_t frame_counter;
+   uint32_t first_index; /* lowest index added on this frame */
+};
+
+struct legacy_uint32s_index
+{
+   size_t object_size; /* measured in ints */
+   struct legacy_uint32s_bucket *index; /* an rhmap of buckets for value->index lookup */
+   uint32_t **objects;   /* an rbuf of the actual buffers */
+   uint32_t *counts;   /* an rbuf of the times each object was used */
+   uint32_t *hashes;   /* an rbuf of each object's hash code */
+   struct legacy_uint32s_frame_addition *additions; /* an rbuf of addition info */
+   uint8_t commit_interval, commit_threshold;
+};
+
+typedef struct legacy_uint32s_index legacy_uint32s_index_t;
+
+struct legacy_uint32s_insert_result
+{
+   uint32_t index;
+   bool is_new;
+};
+typedef struct legacy_uint32s_insert_result legacy_uint32s_insert_result_t;
+
+RETRO_BEGIN_DECLS
+
+legacy_uint32s_index_t *legacy_uint32s_index_new(size_t object_size, uint8_t commit_interval, uint8_t commit_threshold);
+/* Does not take ownership of object */
+legacy_uint32s_insert_result_t legacy_uint32s_index_insert(legacy_uint32s_index_t *index, uint32_t *object, uint64_t frame);
+/* Does take ownership, requires idx is the exact next index and object not in index */
+bool legacy_uint32s_index_insert_exact(legacy_uint32s_index_t *index, uint32_t idx, uint32_t *object, uint64_t frame);
+/* Does not grant ownership of return value */
+uint32_t *legacy_uint32s_index_get(legacy_uint32s_index_t *index, uint32_t which);
+/* Just bump the count, don't try to get the results back */
+void legacy_uint32s_index_bump_count(legacy_uint32s_index_t *index, uint32_t which);
+/* Call once the superblocks and blocks are all identified; transient blocks that have not been used this frame will be dropped. */
+void legacy_uint32s_index_commit(legacy_uint32s_index_t *index);
+void legacy_uint32s_index_free(legacy_uint32s_index_t *index);
+
+/* goes backwards from end of additions */
+void legacy_uint32s_index_remove_after(legacy_uint32s_index_t *index, uint64_t frame);
+/* removes all data from index */
+void legacy_uint32s_index_clear(legacy_uint32s_index_t *index);
+uint32_t legacy_uint32s_index_count(legacy_uint32s_index_t *index);
+#if DEBUG
+void legacy_uint32s_index_print_count_data(legacy_uint32s_index_t *index);
+#endif
+RETRO_END_DECLS
+#endif
+
+#endif /* __LEGACY_UINT32S_INDEX__H */
@@ -0,0 +1,276 @@
+/* Benchmark and cross-check for the statestream block index
+ * (input/bsv/uint32s_index.c) against its previous rhmap-of-buckets
+ * implementation (legacy_uint32s_index.c).
+ *
+ *   uint32s_index_bench [frames]
+ *
+ * Both indexes are fed the same operation stream, shaped like
+ * bsv_movie_write_deduped_state() on a replay with high block churn:
+ * every frame a synthetic state is split into blocks which are all
+ * inserted, then the frame is committed so transient blocks are
+ * collected.  A fraction of the changed blocks revert to earlier
+ * contents, so lookups hit as well as miss.  At the end the new
+ * index alone is rewound with uint32s_index_remove_after(); the
+ * previous implementation cannot take part in that, as it loses
+ * track of its buckets when popping blocks that a commit already
+ * collected.
+ *
+ * Every insert result, the final object count and the contents of
+ * every surviving object must agree between the two; exit status is
+ * non-zero otherwise.  Reported times are for the insert calls alone
+ * (block hashing included, since both versions pay it) and for
+ * passes looking every block of the final state up again, repeated
+ * for at least BENCH_MIN_USEC. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <features/features_cpu.h>
+
+#include "../../../input/bsv/bsvmovie.h"
+#include "../../../input/bsv/uint32s_index.h"
+#include "legacy_uint32s_index.h"
+
+#define DEFAULT_FRAMES  600
+
+/* Minimum wall time spent timing lookups. */
+#define BENCH_MIN_USEC  200000
+
+struct bench_config
+{
+   const char *name;
+   size_t object_size;  /* in uint32_t, as uint32s_index_new() */
+   size_t block_count;  /* blocks per state */
+   unsigned churn;      /* blocks changed per frame, in 1/1000 */
+};
+
+static uint32_t rng_state = 0x2545f491u;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+/* Block contents are a pure function of a seed, so a block can
+ * revert to an earlier value just by reusing its seed.  Seed 0 is
+ * the all-zeros block every index starts with. */
+static void fill_block(uint32_t *block, size_t len, uint32_t seed)
+{
+   size_t i;
+   uint32_t x = seed * 2654435761u;
+
+   if (!seed)
+   {
+      memset(block, 0, len * sizeof(*block));
+      return;
+   }
+
+   for (i = 0; i < len; i++)
+   {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      block[i] = x;
+   }
+}
+
+static int bench_config(const struct bench_config *cfg, unsigned frames)
+{
+   size_t b;
+   unsigned f;
+   uint32_t i, count;
+   int failures            = 0;
+   uint64_t frame          = 1;
+   uint32_t next_seed      = 1;
+   uint64_t inserts        = 0;
+   retro_time_t new_usec   = 0;
+   retro_time_t old_usec   = 0;
+   retro_time_t start;
+   unsigned passes;
+   double new_ns, old_ns;
+   uint32_t *seeds         = (uint32_t*)calloc(cfg->block_count, sizeof(*seeds));
+   uint32_t *state         = (uint32_t*)malloc(
+         cfg->block_count * cfg->object_size * sizeof(*state));
+   uint32s_insert_result_t *results = (uint32s_insert_result_t*)malloc(
+         cfg->block_count * sizeof(*results));
+   uint32s_index_t *index  = uint32s_index_new(cfg->object_size,
+         REPLAY_DEFAULT_COMMIT_INTERVAL, REPLAY_DEFAULT_COMMIT_THRESHOLD);
+   legacy_uint32s_index_t *legacy = legacy_uint32s_index_new(
+         cfg->object_size,
+         REPLAY_DEFAULT_COMMIT_INTERVAL, REPLAY_DEFAULT_COMMIT_THRESHOLD);
+
+   if (!seeds || !state || !results || !index || !legacy)
+      return 1;
+
+   /* Start out half zeros, half distinct data. */
+   for (b = cfg->block_count / 2; b < cfg->block_count; b++)
+      seeds[b] = next_seed++;
+   for (b = 0; b < cfg->block_count; b++)
+      fill_block(state + b * cfg->object_size, cfg->object_size, seeds[b]);
+
+   for (f = 0; f < frames && !failures; f++, frame++)
+   {
+      for (b = 0; b < cfg->block_count; b++)
+      {
+         if (rng_next() % 1000 >= cfg->churn)
+            continue;
+         /* A third of the changes go back to an older value. */
+         seeds[b] = (rng_next() % 3 == 0)
+            ? rng_next() % next_seed
+            : next_seed++;
+         fill_block(state + b * cfg->object_size, cfg->object_size, seeds[b]);
+      }
+
+      start = cpu_features_get_time_usec();
+      for (b = 0; b < cfg->block_count; b++)
+         results[b] = uint32s_index_insert(index,
+               state + b * cfg->object_size, frame);
+      uint32s_index_commit(index);
+      new_usec += cpu_features_get_time_usec() - start;
+
+      start = cpu_features_get_time_usec();
+      for (b = 0; b < cfg->block_count; b++)
+      {
+         legacy_uint32s_insert_result_t res = legacy_uint32s_index_insert(
+               legacy, state + b * cfg->object_size, frame);
+         if (     res.index  != results[b].index
+               || res.is_new != results[b].is_new)
+         {
+            printf("   FAIL: frame %u block %u: index %u/%d, legacy %u/%d\n",
+                  f, (unsigned)b, results[b].index, results[b].is_new,
+                  res.index, res.is_new);
+            failures++;
+            break;
+         }
+      }
+      legacy_uint32s_index_commit(legacy);
+      old_usec += cpu_features_get_time_usec() - start;
+      inserts  += cfg->block_count;
+   }
+
+   count = uint32s_index_count(index);
+   if (count != legacy_uint32s_index_count(legacy))
+   {
+      printf("   FAIL: %u objects, legacy %u\n",
+            count, legacy_uint32s_index_count(legacy));
+      failures++;
+   }
+
+   for (i = 0; i < count && !failures; i++)
+   {
+      uint32_t *obj = uint32s_index_get(index, i);
+      uint32_t *ref = legacy_uint32s_index_get(legacy, i);
+      if (     (!obj != !ref)
+            || (obj && memcmp(obj, ref,
+                  cfg->object_size * sizeof(uint32_t))))
+      {
+         printf("   FAIL: object %u differs from legacy\n", i);
+         failures++;
+      }
+   }
+
+   printf("%s: %u x %u-byte blocks, %u frames, %u objects\n",
+         cfg->name, (unsigned)cfg->block_count,
+         (unsigned)(cfg->object_size * sizeof(uint32_t)), frames, count);
+   printf("   insert  open addressing %7.1f ns   rhmap %7.1f ns   (%.2fx)\n",
+         new_usec * 1000.0 / inserts, old_usec * 1000.0 / inserts,
+         new_usec ? (double)old_usec / (double)new_usec : 0.0);
+
+   /* Every block of the final state is live, so this is all
+    * hits: the path taken for unchanged blocks.  One pass is
+    * too short to time, so passes are repeated. */
+   passes = 0;
+   start  = cpu_features_get_time_usec();
+   do
+   {
+      for (b = 0; b < cfg->block_count; b++)
+         uint32s_index_insert(index, state + b * cfg->object_size, frame);
+      passes++;
+      new_usec = cpu_features_get_time_usec() - start;
+   } while (new_usec < BENCH_MIN_USEC);
+   new_ns = new_usec * 1000.0 / ((double)passes * cfg->block_count);
+
+   passes = 0;
+   start  = cpu_features_get_time_usec();
+   do
+   {
+      for (b = 0; b < cfg->block_count; b++)
+         legacy_uint32s_index_insert(legacy,
+               state + b * cfg->object_size, frame);
+      passes++;
+      old_usec = cpu_features_get_time_usec() - start;
+   } while (old_usec < BENCH_MIN_USEC);
+   old_ns = old_usec * 1000.0 / ((double)passes * cfg->block_count);
+
+   printf("   lookup  open addressing %7.1f ns   rhmap %7.1f ns   (%.2fx)\n",
+         new_ns, old_ns, old_ns / new_ns);
+
+   /* Rewind past collected blocks, then replay the final state;
+    * everything dropped must come back as new objects. */
+   uint32s_index_remove_after(index, frame / 2);
+   count = uint32s_index_count(index);
+   for (b = 0; b < cfg->block_count && !failures; b++)
+   {
+      uint32s_insert_result_t res = uint32s_index_insert(index,
+            state + b * cfg->object_size, frame / 2 + 1);
+      uint32_t *obj               = uint32s_index_get(index, res.index);
+      if (     (res.is_new && res.index < count)
+            || !obj || memcmp(obj, state + b * cfg->object_size,
+                  cfg->object_size * sizeof(uint32_t)))
+      {
+         printf("   FAIL: block %u wrong after rewinding to frame %u\n",
+               (unsigned)b, (unsigned)(frame / 2));
+         failures++;
+      }
+   }
+
+   uint32s_index_free(index);
+   legacy_uint32s_index_free(legacy);
+   free(seeds);
+   free(state);
+   free(results);
+   return failures;
+}
+
+int main(int argc, char *argv[])
+{
+   unsigned i;
+   int failures    = 0;
+   unsigned frames = DEFAULT_FRAMES;
+   /* Block sizes as chosen by bsv_movie_write_checkpoint() for
+    * small and regular states; the last one is a large state in
+    * small blocks, whose index of over a million blocks no longer
+    * fits in any cache. */
+   static const struct bench_config configs[] = {
+      { "small state",   SMALL_BLOCK_SIZE / 4,   4096, 50  },
+      { "small, churny", SMALL_BLOCK_SIZE / 4,   4096, 400 },
+      { "large state",   DEFAULT_BLOCK_SIZE / 4, 128,  100 },
+      { "large index",   SMALL_BLOCK_SIZE / 4,   65536, 100 },
+   };
+
+   if (argc > 1)
+      frames = (unsigned)strtoul(argv[1], NULL, 0);
+
+   for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+      failures += bench_config(&configs[i], frames);
+
+   if (failures)
+   {
+      printf("%d check(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
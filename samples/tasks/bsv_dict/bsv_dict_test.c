@@ -0,0 +1,216 @@
+/* Copyright  (C) 2010-2026 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (bsv_dict_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Test for the REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT codec in
+ * input/bsv/bsvdict.c.
+ *
+ * A writer movie compresses a sequence of evolving states, each
+ * against the previous one, and a reader movie decodes them in
+ * order the way playback does.  Every state has to round-trip, the
+ * stream has to be smaller than compressing each state on its own,
+ * a checkpoint must not decode without its reference, and a writer
+ * whose references were truncated away has to fall back to frames
+ * that decode on their own.  Sizes and decode throughput are
+ * printed for comparison. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <zstd.h>
+
+#include "../../../input/bsv/bsvmovie.h"
+
+#define CHECKPOINTS 32
+/* Distance between checkpoint payloads in the pretend file */
+#define SPACING     4096
+
+static uint32_t rng_state = 0x2545f491u;
+static int failures       = 0;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+/* Incompressible on its own, but only a few runs change
+ * between checkpoints, like emulated RAM. */
+static void evolve(uint8_t *state, size_t len)
+{
+   unsigned j;
+   for (j = 1 + rng_next() % (1 + len / 4096); j > 0; j--)
+   {
+      size_t run   = 1 + rng_next() % 256;
+      size_t start = rng_next() % (len - run);
+      size_t k;
+      for (k = 0; k < run; k++)
+         state[start + k] = (uint8_t)(rng_next() >> 24);
+   }
+}
+
+static void fail(const char *what, size_t len, unsigned c)
+{
+   printf("[FAIL] %u bytes: %s (checkpoint %u)\n", (unsigned)len, what, c);
+   failures++;
+}
+
+static void test_size(size_t len)
+{
+   unsigned c;
+   size_t i;
+   bsv_movie_t writer, reader, stranger;
+   size_t capacity     = bsv_movie_dict_bound(len);
+   size_t dict_total   = 0;
+   size_t plain_total  = 0;
+   double decode_secs  = 0;
+   uint8_t *state      = (uint8_t*)malloc(len);
+   uint8_t *out        = (uint8_t*)malloc(len);
+   uint8_t *plain      = (uint8_t*)malloc(ZSTD_compressBound(len));
+   uint8_t **frames    = (uint8_t**)calloc(CHECKPOINTS, sizeof(uint8_t*));
+   int64_t *frame_lens = (int64_t*)calloc(CHECKPOINTS, sizeof(int64_t));
+
+   memset(&writer,   0, sizeof(writer));
+   memset(&reader,   0, sizeof(reader));
+   memset(&stranger, 0, sizeof(stranger));
+
+   if (!state || !out || !plain || !frames || !frame_lens)
+   {
+      fail("out of memory", len, 0);
+      goto end;
+   }
+   for (i = 0; i < len; i++)
+      state[i] = (uint8_t)(rng_next() >> 24);
+
+   for (c = 0; c < CHECKPOINTS; c++)
+   {
+      int64_t pos = (int64_t)(c + 1) * SPACING;
+      clock_t start;
+
+      if (c)
+         evolve(state, len);
+      if (!(frames[c] = (uint8_t*)malloc(capacity)))
+      {
+         fail("out of memory", len, c);
+         goto end;
+      }
+      frame_lens[c] = bsv_movie_dict_compress(&writer, pos, state, len,
+            frames[c], capacity);
+      if (frame_lens[c] <= 0 || !bsv_movie_dict_store(&writer, pos, state, len))
+      {
+         fail("compression failed", len, c);
+         goto end;
+      }
+      dict_total  += (size_t)frame_lens[c];
+      plain_total += ZSTD_compress(plain, ZSTD_compressBound(len),
+            state, len, 3);
+
+      start = clock();
+      if (!bsv_movie_dict_decompress(&reader, frames[c],
+               (size_t)frame_lens[c], out, len))
+      {
+         fail("does not decode", len, c);
+         goto end;
+      }
+      decode_secs += (double)(clock() - start) / CLOCKS_PER_SEC;
+      if (memcmp(out, state, len))
+      {
+         fail("decodes to the wrong state", len, c);
+         goto end;
+      }
+      bsv_movie_dict_store(&reader, pos, out, len);
+   }
+
+   if (dict_total >= plain_total / 4)
+      fail("not much smaller than plain zstd", len, CHECKPOINTS);
+
+   /* Only the first checkpoint stands on its own. */
+   if (!bsv_movie_dict_decompress(&stranger, frames[0],
+            (size_t)frame_lens[0], out, len))
+      fail("first checkpoint needs a reference", len, 0);
+   if (bsv_movie_dict_decompress(&stranger, frames[2],
+            (size_t)frame_lens[2], out, len))
+      fail("decodes without its reference", len, 2);
+
+   /* Rewinding the writer past both references. */
+   bsv_movie_dict_truncate(&writer, (int64_t)(CHECKPOINTS - 1) * SPACING);
+   frame_lens[0] = bsv_movie_dict_compress(&writer,
+         (int64_t)(CHECKPOINTS - 1) * SPACING, state, len, frames[0], capacity);
+   bsv_movie_dict_clear(&stranger);
+   if (     frame_lens[0] <= 0
+         || !bsv_movie_dict_decompress(&stranger, frames[0],
+            (size_t)frame_lens[0], out, len)
+         || memcmp(out, state, len))
+      fail("self-contained checkpoint does not decode", len, CHECKPOINTS - 1);
+
+   printf("[pass] %u bytes: %u checkpoints, %u bytes with references, "
+         "%u bytes plain, decode %.1f MB/s\n",
+         (unsigned)len, CHECKPOINTS, (unsigned)dict_total,
+         (unsigned)plain_total,
+         decode_secs > 0
+         ? (double)len * CHECKPOINTS / decode_secs / (1024.0 * 1024.0) : 0.0);
+
+end:
+   if (frames)
+      for (c = 0; c < CHECKPOINTS; c++)
+         free(frames[c]);
+   free(frames);
+   free(frame_lens);
+   free(state);
+   free(out);
+   free(plain);
+   bsv_movie_dict_free(&writer);
+   bsv_movie_dict_free(&reader);
+   bsv_movie_dict_free(&stranger);
+}
+
+int main(void)
+{
+   unsigned i;
+   static const size_t sizes[] = {
+      4 * 1024,
+      256 * 1024,
+      4 * 1024 * 1024 + 123
+   };
+
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      test_size(sizes[i]);
+
+   if (failures)
+   {
+      printf("%d test(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
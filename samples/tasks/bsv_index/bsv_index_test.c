@@ -0,0 +1,400 @@
+/* Copyright  (C) 2010-2026 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (bsv_index_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Regression test for the replay seek index in
+ * input/bsv/bsvindex.c.
+ *
+ * A synthetic version 2 replay is written with frame records of
+ * random length, some of them checkpoints.  The index must find
+ * every record whether it is built by walking the file
+ * (bsv_movie_index_extend(), as for replays from older sessions) or
+ * pushed record by record (as while recording), survive truncation,
+ * and round-trip through its sidecar file, which must be rejected
+ * once it no longer matches the replay.
+ *
+ * Checkpoint selection for seeks goes through
+ * bsv_movie_find_checkpoint_before(), the lookup behind seeking and
+ * skipping back in a replay, on a fresh index that it has to extend
+ * itself, and is checked against the rule it is meant to follow. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <array/rbuf.h>
+#include <retro_endianness.h>
+#include <retro_miscellaneous.h>
+#include <streams/file_stream.h>
+#include <streams/interface_stream.h>
+#include <file/file_path.h>
+
+#include "../../../input/bsv/bsvmovie.h"
+
+#define RECORDS      2000
+#define MIN_FILE_POS 1234
+#define IDENTIFIER   0x1122334455667788LL
+
+static uint32_t rng_state = 0x9e3779b9u;
+static int failures       = 0;
+
+static int64_t offsets[RECORDS + 1];
+static bool is_checkpoint[RECORDS];
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+#define CHECK(cond, ...) \
+   do { \
+      if (!(cond)) \
+      { \
+         printf("[FAIL] " __VA_ARGS__); \
+         printf("\n"); \
+         failures++; \
+      } \
+   } while (0)
+
+/* Lays out RECORDS frame records after MIN_FILE_POS bytes of
+ * header, filling offsets[] and is_checkpoint[]. */
+static uint8_t *build_replay(size_t *len)
+{
+   unsigned r;
+   size_t cap   = MIN_FILE_POS + RECORDS * 256;
+   uint8_t *buf = (uint8_t*)calloc(1, cap);
+   uint8_t *ptr = buf + MIN_FILE_POS;
+
+   for (r = 0; r < RECORDS; r++)
+   {
+      uint8_t keys    = rng_next() % 3;
+      uint16_t inputs = rng_next() % 6;
+      uint16_t inputs_le = swap_if_big16(inputs);
+
+      offsets[r]       = ptr - buf;
+      is_checkpoint[r] = (rng_next() % 7) == 0;
+
+      ptr += sizeof(uint32_t); /* backref */
+      *ptr++ = keys;
+      ptr += keys * sizeof(bsv_key_data_t);
+      memcpy(ptr, &inputs_le, sizeof(inputs_le));
+      ptr += sizeof(inputs_le);
+      ptr += inputs * sizeof(bsv_input_data_t);
+      if (is_checkpoint[r])
+      {
+         uint32_t payload    = 1 + rng_next() % 64;
+         uint32_t payload_le = swap_if_big32(payload);
+         *ptr++ = REPLAY_TOKEN_CHECKPOINT2_FRAME;
+         *ptr++ = REPLAY_CHECKPOINT2_COMPRESSION_NONE;
+         *ptr++ = REPLAY_CHECKPOINT2_ENCODING_RAW;
+         memcpy(ptr, &payload_le, sizeof(payload_le));
+         ptr += sizeof(payload_le);
+         memcpy(ptr, &payload_le, sizeof(payload_le));
+         ptr += sizeof(payload_le);
+         memcpy(ptr, &payload_le, sizeof(payload_le));
+         ptr += sizeof(payload_le);
+         ptr += payload;
+      }
+      else
+         *ptr++ = REPLAY_TOKEN_REGULAR_FRAME;
+   }
+   offsets[RECORDS] = ptr - buf;
+   *len             = ptr - buf;
+   return buf;
+}
+
+/* The checkpoint a seek to 'frame' should start from: the closest
+ * one before it, or when not paused the one before that if the
+ * closest is under 30 frames back, so that skipping back while
+ * playing does go back. */
+static int64_t expected_checkpoint_before(int64_t frame, bool paused)
+{
+   int64_t r;
+   bool skipped = false;
+   for (r = MIN(frame, RECORDS) - 1; r >= 0; r--)
+   {
+      if (!is_checkpoint[r])
+         continue;
+      if (paused || frame - r >= 30 || skipped)
+         return r;
+      skipped = true;
+   }
+   return -1;
+}
+
+static bool movie_open(bsv_movie_t *movie, const char *path)
+{
+   memset(movie, 0, sizeof(*movie));
+   movie->version      = REPLAY_FORMAT_VERSION;
+   movie->identifier   = IDENTIFIER;
+   movie->min_file_pos = MIN_FILE_POS;
+   movie->file         = intfstream_open_file(path,
+         RETRO_VFS_FILE_ACCESS_READ_WRITE | RETRO_VFS_FILE_ACCESS_UPDATE_EXISTING,
+         RETRO_VFS_FILE_ACCESS_HINT_NONE);
+   bsv_movie_index_clear(movie);
+   return movie->file != NULL;
+}
+
+static void movie_close(bsv_movie_t *movie)
+{
+   bsv_movie_index_free(movie);
+   intfstream_close(movie->file);
+   free(movie->file);
+}
+
+static void check_index(bsv_movie_t *movie, size_t records, const char *what)
+{
+   size_t i, cps = 0;
+   CHECK(RBUF_LEN(movie->record_pos) == records,
+         "%s: %u records, expected %u", what,
+         (unsigned)RBUF_LEN(movie->record_pos), (unsigned)records);
+   CHECK(movie->index_end == offsets[records],
+         "%s: index ends at %lld, expected %lld", what,
+         (long long)movie->index_end, (long long)offsets[records]);
+   for (i = 0; i < records && i < RBUF_LEN(movie->record_pos); i++)
+   {
+      if (movie->record_pos[i] != offsets[i])
+      {
+         CHECK(false, "%s: record %u at %lld, expected %lld", what,
+               (unsigned)i, (long long)movie->record_pos[i],
+               (long long)offsets[i]);
+         return;
+      }
+      if (is_checkpoint[i])
+      {
+         CHECK(     cps < RBUF_LEN(movie->checkpoint_records)
+               && movie->checkpoint_records[cps] == i,
+               "%s: checkpoint %u not indexed", what, (unsigned)i);
+         cps++;
+      }
+   }
+   CHECK(cps == RBUF_LEN(movie->checkpoint_records),
+         "%s: %u checkpoints, expected %u", what,
+         (unsigned)RBUF_LEN(movie->checkpoint_records), (unsigned)cps);
+}
+
+static void test_walk(bsv_movie_t *movie)
+{
+   unsigned r;
+
+   /* Extending stops where asked and leaves the file alone. */
+   intfstream_seek(movie->file, 77, SEEK_SET);
+   CHECK(bsv_movie_index_extend(movie, 100), "extend to 100 records");
+   CHECK(intfstream_tell(movie->file) == 77, "extend moved the file position");
+   check_index(movie, 100, "partial walk");
+
+   CHECK(!bsv_movie_index_extend(movie, UINT64_MAX), "extend past the end");
+   check_index(movie, RECORDS, "full walk");
+
+   for (r = 0; r < RECORDS; r++)
+   {
+      if (     bsv_movie_index_find_record(movie, offsets[r]) != (int64_t)r
+            || bsv_movie_index_find_record(movie, offsets[r] + 1) != -1)
+      {
+         CHECK(false, "record %u not found by offset", r);
+         break;
+      }
+   }
+   CHECK(bsv_movie_index_find_record(movie, offsets[RECORDS]) == -1,
+         "end of file found as a record");
+
+}
+
+static void test_find_checkpoint(const char *path)
+{
+   int64_t f;
+   unsigned p;
+   bsv_movie_t movie;
+
+   /* Walking forwards and then backwards, so the index is
+    * extended bit by bit and then already covers the target. */
+   if (!movie_open(&movie, path))
+   {
+      CHECK(false, "could not reopen replay");
+      return;
+   }
+   for (f = -1; f < RECORDS + 40 && !failures; f++)
+   {
+      for (p = 0; p < 2; p++)
+      {
+         int64_t cp_pos   = -2;
+         int64_t cp_frame = -2;
+         int64_t expected = expected_checkpoint_before(f, p != 0);
+         bool found       = bsv_movie_find_checkpoint_before(&movie, f,
+               p != 0, &cp_pos, &cp_frame);
+         if (     found    != (expected >= 0)
+               || cp_frame != expected
+               || cp_pos   != (expected >= 0 ? offsets[expected] : -1))
+         {
+            CHECK(false, "frame %lld%s: checkpoint %lld at %lld, expected %lld",
+                  (long long)f, p ? " paused" : "", (long long)cp_frame,
+                  (long long)cp_pos, (long long)expected);
+            break;
+         }
+      }
+   }
+   check_index(&movie, RECORDS, "extended by seeks");
+   for (f = RECORDS + 40; f >= -1 && !failures; f--)
+   {
+      int64_t cp_frame = -2;
+      bsv_movie_find_checkpoint_before(&movie, f, false, NULL, &cp_frame);
+      CHECK(cp_frame == expected_checkpoint_before(f, false),
+            "frame %lld backwards: checkpoint %lld, expected %lld",
+            (long long)f, (long long)cp_frame,
+            (long long)expected_checkpoint_before(f, false));
+   }
+   movie_close(&movie);
+}
+
+static void test_truncate(bsv_movie_t *movie)
+{
+   /* Mid-record: that record goes too. */
+   bsv_movie_index_truncate(movie, offsets[1500] + 3);
+   check_index(movie, 1500, "truncated mid-record");
+   /* On a boundary. */
+   bsv_movie_index_truncate(movie, offsets[700]);
+   check_index(movie, 700, "truncated on a record");
+   /* Past the end: nothing to do. */
+   bsv_movie_index_truncate(movie, offsets[RECORDS]);
+   check_index(movie, 700, "truncated past the end");
+
+   bsv_movie_index_extend(movie, UINT64_MAX);
+   check_index(movie, RECORDS, "walk after truncating");
+}
+
+static void test_push(const char *path)
+{
+   unsigned r;
+   bsv_movie_t movie;
+
+   if (!movie_open(&movie, path))
+   {
+      CHECK(false, "could not reopen replay");
+      return;
+   }
+   for (r = 0; r < RECORDS; r++)
+      bsv_movie_index_push(&movie, offsets[r], offsets[r + 1],
+            is_checkpoint[r]);
+   check_index(&movie, RECORDS, "recorded");
+
+   /* Re-recording over the tail, as after a rewind. */
+   for (r = 900; r < RECORDS; r++)
+      bsv_movie_index_push(&movie, offsets[r], offsets[r + 1],
+            is_checkpoint[r]);
+   check_index(&movie, RECORDS, "re-recorded");
+
+   /* A gap leaves the index to be caught up by a walk. */
+   bsv_movie_index_truncate(&movie, offsets[400]);
+   bsv_movie_index_push(&movie, offsets[500], offsets[501], is_checkpoint[500]);
+   check_index(&movie, 400, "pushed past a gap");
+   bsv_movie_index_extend(&movie, UINT64_MAX);
+   check_index(&movie, RECORDS, "walk after a gap");
+   movie_close(&movie);
+}
+
+static void test_sidecar(const char *path, const char *index_path)
+{
+   bsv_movie_t movie;
+
+   if (!movie_open(&movie, path))
+   {
+      CHECK(false, "could not reopen replay");
+      return;
+   }
+   CHECK(!bsv_movie_index_save(&movie, index_path), "saved an empty index");
+   bsv_movie_index_extend(&movie, 10);
+   CHECK(!bsv_movie_index_save(&movie, index_path), "saved a partial index");
+   bsv_movie_index_extend(&movie, UINT64_MAX);
+   CHECK(bsv_movie_index_save(&movie, index_path), "could not save index");
+   movie_close(&movie);
+
+   movie_open(&movie, path);
+   CHECK(bsv_movie_index_load(&movie, index_path), "could not load index");
+   check_index(&movie, RECORDS, "loaded");
+   CHECK(!movie.index_dirty, "loaded index marked dirty");
+   movie_close(&movie);
+
+   /* Another replay with the same size. */
+   movie_open(&movie, path);
+   movie.identifier++;
+   CHECK(!bsv_movie_index_load(&movie, index_path), "loaded a foreign index");
+   check_index(&movie, 0, "rejected foreign index");
+   movie_close(&movie);
+
+   /* The replay grew since the index was written. */
+   movie_open(&movie, path);
+   intfstream_seek(movie.file, 0, SEEK_END);
+   intfstream_write(movie.file, "x", 1);
+   CHECK(!bsv_movie_index_load(&movie, index_path), "loaded a stale index");
+   check_index(&movie, 0, "rejected stale index");
+   movie_close(&movie);
+}
+
+int main(void)
+{
+   size_t len;
+   bsv_movie_t movie;
+   char path[]       = "bsv_index_test.replay";
+   char index_path[] = "bsv_index_test.replay" REPLAY_INDEX_EXTENSION;
+   uint8_t *replay   = build_replay(&len);
+
+   if (!replay || !filestream_write_file(path, replay, len))
+   {
+      printf("[FAIL] could not write %s\n", path);
+      return 1;
+   }
+   free(replay);
+
+   if (!movie_open(&movie, path))
+   {
+      printf("[FAIL] could not open %s\n", path);
+      return 1;
+   }
+   test_walk(&movie);
+   test_truncate(&movie);
+   movie_close(&movie);
+
+   test_find_checkpoint(path);
+   test_push(path);
+   test_sidecar(path, index_path);
+
+   filestream_delete(path);
+   filestream_delete(index_path);
+
+   if (failures)
+   {
+      printf("%d test(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
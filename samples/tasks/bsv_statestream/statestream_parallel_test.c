@@ -0,0 +1,255 @@
+/* Copyright  (C) 2010-2026 The RetroArch team
+ *
+ * ---------------------------------------------------------------------------------------
+ * The following license statement only applies to this file (statestream_parallel_test.c).
+ * ---------------------------------------------------------------------------------------
+ *
+ * Permission is hereby granted, free of charge,
+ * to any person obtaining a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+ * INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/* Regression test for the parallel block hashing in
+ * input/bsv/bsvstatestream.c::bsv_movie_write_deduped_state().
+ *
+ * States of PARALLEL_HASH_THRESHOLD bytes or more have every block
+ * compared against the previous checkpoint and hashed on
+ * movie->hash_pool before the results are merged into the block
+ * index in order.  The encoded checkpoint must not depend on that:
+ * a replay recorded with a pool has to be byte-identical to one
+ * recorded without, or replays would differ between machines.
+ *
+ * Two writer movies, one with a pool and one without, encode the
+ * same sequence of evolving states and every checkpoint is compared
+ * byte for byte.  The pooled stream is then decoded by a reader
+ * movie to check it still round-trips.  State sizes cover a whole
+ * number of superblocks, a partial last superblock and a partial
+ * last block, so the padding paths are exercised too. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <rthreads/tpool.h>
+
+#include "../../../input/bsv/bsvmovie.h"
+#include "../../../input/bsv/uint32s_index.h"
+
+#define CHECKPOINTS 24
+
+static uint32_t rng_state = 0x7f4a7c15u;
+static int failures       = 0;
+
+static uint32_t rng_next(void)
+{
+   rng_state ^= rng_state << 13;
+   rng_state ^= rng_state >> 17;
+   rng_state ^= rng_state << 5;
+   return rng_state;
+}
+
+/* Log sinks for the frontend code linked in. */
+void RARCH_LOG(const char *fmt, ...) { }
+void RARCH_DBG(const char *fmt, ...) { }
+void RARCH_WARN(const char *fmt, ...) { }
+void RARCH_ERR(const char *fmt, ...) { }
+
+static bool movie_init(bsv_movie_t *movie, size_t state_size,
+      tpool_t *pool)
+{
+   bool is_small            = state_size < SMALL_STATE_THRESHOLD;
+   uint32_t superblock_size = is_small
+      ? SMALL_SUPERBLOCK_SIZE : DEFAULT_SUPERBLOCK_SIZE;
+   uint32_t block_size      = is_small
+      ? SMALL_BLOCK_SIZE      : DEFAULT_BLOCK_SIZE;
+
+   memset(movie, 0, sizeof(*movie));
+   movie->commit_interval  = REPLAY_DEFAULT_COMMIT_INTERVAL;
+   movie->commit_threshold = REPLAY_DEFAULT_COMMIT_THRESHOLD;
+   movie->superblocks      = uint32s_index_new(superblock_size,
+         movie->commit_interval, movie->commit_threshold);
+   movie->blocks           = uint32s_index_new(block_size / 4,
+         movie->commit_interval, movie->commit_threshold);
+   movie->hash_pool        = pool;
+   return movie->superblocks && movie->blocks;
+}
+
+static void movie_deinit(bsv_movie_t *movie)
+{
+   uint32s_index_free(movie->superblocks);
+   uint32s_index_free(movie->blocks);
+   free(movie->superblock_seq);
+   free(movie->cur_save);
+   free(movie->last_save);
+}
+
+/* Encodes 'state' with the buffer juggling of
+ * bsv_movie_write_checkpoint(). */
+static int64_t movie_write(bsv_movie_t *movie, const uint8_t *state,
+      size_t len, uint64_t frame, uint8_t *out, size_t capacity)
+{
+   int64_t encoded;
+   uint8_t *swap;
+   size_t size_swap;
+
+   if (movie->cur_save_size < len)
+   {
+      free(movie->cur_save);
+      movie->cur_save = NULL;
+   }
+   if (!movie->cur_save)
+   {
+      movie->cur_save_size  = len;
+      movie->cur_save       = (uint8_t*)malloc(len);
+      movie->cur_save_valid = false;
+   }
+   memcpy(movie->cur_save, state, len);
+   movie->frame_counter = frame;
+
+   encoded = bsv_movie_write_deduped_state(movie, movie->cur_save,
+         len, out, capacity);
+
+   size_swap             = movie->cur_save_size;
+   movie->cur_save_size  = movie->last_save_size;
+   movie->last_save_size = size_swap;
+   swap                  = movie->cur_save;
+   movie->cur_save       = movie->last_save;
+   movie->last_save      = swap;
+   movie->cur_save_valid = movie->cur_save != NULL;
+   return encoded;
+}
+
+/* Changes a handful of byte runs, and once in a while reverts a
+ * region to zeros so that dedup hits old blocks as well. */
+static void evolve(uint8_t *state, size_t len)
+{
+   unsigned j;
+   for (j = rng_next() % 48; j > 0; j--)
+   {
+      size_t run   = 1 + rng_next() % 512;
+      size_t start = rng_next() % (len - run);
+      size_t k;
+      for (k = 0; k < run; k++)
+         state[start + k] ^= (uint8_t)(1 + rng_next() % 255);
+   }
+   if (rng_next() % 4 == 0)
+   {
+      size_t run   = rng_next() % (len / 8);
+      size_t start = rng_next() % (len - run);
+      memset(state + start, 0, run);
+   }
+}
+
+static void test_size(tpool_t *pool, size_t len)
+{
+   unsigned c;
+   size_t i;
+   bsv_movie_t serial, parallel, reader;
+   size_t capacity  = len + len / 2;
+   uint8_t *state   = (uint8_t*)malloc(len);
+   uint8_t *out_a   = (uint8_t*)malloc(capacity);
+   uint8_t *out_b   = (uint8_t*)malloc(capacity);
+
+   if (     !state || !out_a || !out_b
+         || !movie_init(&serial,   len, NULL)
+         || !movie_init(&parallel, len, pool)
+         || !movie_init(&reader,   len, NULL))
+   {
+      printf("[FAIL] %u bytes: out of memory\n", (unsigned)len);
+      failures++;
+      return;
+   }
+
+   for (i = 0; i < len / 2; i++)
+      state[i] = (uint8_t)(rng_next() >> 24);
+   memset(state + len / 2, 0, len - len / 2);
+
+   reader.cur_save      = (uint8_t*)malloc(len);
+   reader.cur_save_size = len;
+
+   for (c = 0; c < CHECKPOINTS; c++)
+   {
+      int64_t len_a, len_b;
+
+      if (c)
+         evolve(state, len);
+
+      len_a = movie_write(&serial,   state, len, c, out_a, capacity);
+      len_b = movie_write(&parallel, state, len, c, out_b, capacity);
+
+      if (len_a <= 0 || len_a != len_b || memcmp(out_a, out_b, (size_t)len_a))
+      {
+         printf("[FAIL] %u bytes: checkpoint %u differs "
+               "(serial %lld bytes, pooled %lld bytes)\n",
+               (unsigned)len, c, (long long)len_a, (long long)len_b);
+         failures++;
+         break;
+      }
+
+      reader.frame_counter = c;
+      if (     !bsv_movie_read_deduped_state(&reader, out_b, (size_t)len_b)
+            || memcmp(reader.cur_save, state, len))
+      {
+         printf("[FAIL] %u bytes: checkpoint %u does not decode\n",
+               (unsigned)len, c);
+         failures++;
+         break;
+      }
+      reader.last_save_size = reader.cur_save_size;
+   }
+
+   if (c == CHECKPOINTS)
+      printf("[pass] %u bytes: %u identical checkpoints\n",
+            (unsigned)len, c);
+
+   movie_deinit(&serial);
+   movie_deinit(&parallel);
+   movie_deinit(&reader);
+   free(state);
+   free(out_a);
+   free(out_b);
+}
+
+int main(void)
+{
+   unsigned i;
+   static const size_t sizes[] = {
+      8 * 1024 * 1024,                     /* whole superblocks */
+      PARALLEL_HASH_THRESHOLD + 5 * 16384, /* partial superblock */
+      3 * 1024 * 1024 + 1234,              /* partial last block */
+      256 * 1024                           /* below the threshold */
+   };
+   tpool_t *pool = tpool_create(4);
+
+   if (!pool)
+   {
+      printf("[FAIL] could not create thread pool\n");
+      return 1;
+   }
+
+   for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+      test_size(pool, sizes[i]);
+
+   tpool_destroy(pool);
+
+   if (failures)
+   {
+      printf("%d test(s) FAILED\n", failures);
+      return 1;
+   }
+
+   printf("ALL OK\n");
+   return 0;
+}
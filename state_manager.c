@@ -25,9 +25,12 @@
 
 #include <retro_inline.h>
 #include <compat/strl.h>
-#include <compat/intrinsics.h>
+#include <file/file_path.h>
+#include <streams/file_stream.h>
+#include <string/stdstring.h>
 
 #include "state_manager.h"
+#include "state_manager_raw.h"
 #include "msg_hash.h"
 #include "core.h"
 #include "core_info.h"
@@ -40,321 +43,570 @@
 #include "network/netplay/netplay.h"
 #endif
 
+#ifdef HAVE_REWIND_COLD_TIER
+#include <zstd.h>
+
+/* Share of the rewind buffer kept as raw patches when the
+ * cold tier is on; the rest holds zstd-compressed patches. */
+#define STATE_MANAGER_HOT_DIVISOR 4
+/* Recompression runs behind the core on a worker, but has
+ * to keep up with one patch per frame on large states. */
+#define STATE_MANAGER_COLD_LEVEL  1
+#endif
+
 /* This makes Valgrind throw errors if a core overflows its savestate size. */
 /* Keep it off unless you're chasing a core bug, it slows things down. */
 #define STRICT_BUF_SIZE 0
 
-#ifndef UINT16_MAX
-#define UINT16_MAX 0xffff
-#endif
+/* The start offsets point to 'nextstart' of any given compressed frame.
+ * Each uint16 is stored native endian; anything that claims any other
+ * endianness refers to the endianness of this specific item.
+ * The uint32 is stored little endian.
+ *
+ * Each size value is stored native endian if alignment is not enforced;
+ * if it is, they're little endian.
+ *
+ * The start of the buffer contains a size pointing to the end of the
+ * buffer; the end points to its start.
+ *
+ * Wrapping is handled by returning to the start of the buffer if the
+ * compressed data could potentially hit the edge;
+ *
+ * if the compressed data could potentially overwrite the tail pointer,
+ * the tail retreats until it can no longer collide.
+ *
+ * This means that on average, ~2 * maxcompsize is
+ * unused at any given moment. */
 
-#ifndef UINT32_MAX
-#define UINT32_MAX 0xffffffffu
-#endif
+/* These are called very few constant times per frame,
+ * keep it as simple as possible. */
+static INLINE void write_size_t(void *ptr, size_t val)
+{
+   memcpy(ptr, &val, sizeof(val));
+}
 
-#if defined(__x86_64__) || defined(__i386__) || defined(__i486__) || defined(__i686__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
-#define CPU_X86
-#endif
+static INLINE size_t read_size_t(const void *ptr)
+{
+   size_t ret;
 
-/* Other arches SIGBUS (usually) on unaligned accesses. */
-#ifndef CPU_X86
-#define NO_UNALIGNED_MEM
-#endif
+   memcpy(&ret, ptr, sizeof(ret));
+   return ret;
+}
 
-#if __SSE2__
-#include <emmintrin.h>
-#endif
+/* Bytes currently occupied in a ring. */
+static INLINE size_t ring_used(const uint8_t *data,
+      const uint8_t *head, const uint8_t *tail, size_t capacity)
+{
+   return ((size_t)(head - data) + capacity
+         - (size_t)(tail - data)) % capacity;
+}
 
-/* There's no equivalent in libc, you'd think so ...
- * std::mismatch exists, but it's not optimized at all. */
-static size_t find_change(const uint16_t *a, const uint16_t *b)
+/* Forgets keyframes whose entries fell off the tail. */
+static void state_manager_keyframes_drop_old(state_manager_t *state)
 {
-#if __SSE2__
-   const __m128i *a128 = (const __m128i*)a;
-   const __m128i *b128 = (const __m128i*)b;
+   uint64_t oldest = state->serial - state->ring_entries + 1;
 
-   for (;;)
+   while (state->keyframe_count)
    {
-      __m128i v0    = _mm_loadu_si128(a128);
-      __m128i v1    = _mm_loadu_si128(b128);
-      __m128i c     = _mm_cmpeq_epi8(v0, v1);
-      uint32_t mask = _mm_movemask_epi8(c);
-
-      if (mask != 0xffff) /* Something has changed, figure out where. */
-      {
-         /* calculate the real offset to the differing byte */
-         size_t ret = (((uint8_t*)a128 - (uint8_t*)a) |
-               (compat_ctz(~mask)));
-
-         /* and convert that to the uint16_t offset */
-         return (ret >> 1);
-      }
-
-      a128++;
-      b128++;
+      if (     state->ring_entries
+            && state->keyframes[state->keyframe_first].serial >= oldest)
+         break;
+      state->keyframe_first = (state->keyframe_first + 1)
+         % state->keyframe_capacity;
+      state->keyframe_count--;
    }
-#else
-   const uint16_t *a_org = a;
-#ifdef NO_UNALIGNED_MEM
-   while (((uintptr_t)a & (sizeof(size_t) - 1)) && *a == *b)
+}
+
+/* Forgets keyframes whose entries were popped off the head. */
+static void state_manager_keyframes_drop_new(state_manager_t *state)
+{
+   while (state->keyframe_count)
    {
-      a++;
-      b++;
+      size_t last = (state->keyframe_first + state->keyframe_count - 1)
+         % state->keyframe_capacity;
+      if (state->keyframes[last].serial <= state->serial)
+         break;
+      state->keyframe_count--;
    }
-   if (*a == *b)
-#endif
-   {
-      const size_t *a_big = (const size_t*)a;
-      const size_t *b_big = (const size_t*)b;
+}
 
-      while (*a_big == *b_big)
-      {
-         a_big++;
-         b_big++;
-      }
-      a = (const uint16_t*)a_big;
-      b = (const uint16_t*)b_big;
+/* Returns the oldest keyframe at or after 'serial', or NULL. */
+static const struct state_manager_keyframe *state_manager_keyframe_find(
+      const state_manager_t *state, uint64_t serial)
+{
+   size_t lo = 0;
+   size_t hi = state->keyframe_count;
 
-      while (*a == *b)
-      {
-         a++;
-         b++;
-      }
+   while (lo < hi)
+   {
+      size_t mid = lo + (hi - lo) / 2;
+      if (state->keyframes[(state->keyframe_first + mid)
+            % state->keyframe_capacity].serial < serial)
+         lo      = mid + 1;
+      else
+         hi      = mid;
    }
-   return a - a_org;
-#endif
+
+   if (lo == state->keyframe_count)
+      return NULL;
+   return &state->keyframes[(state->keyframe_first + lo)
+      % state->keyframe_capacity];
 }
 
-static size_t find_same(const uint16_t *a, const uint16_t *b)
+#ifdef HAVE_REWIND_COLD_TIER
+static void state_manager_cold_reset(struct state_manager_cold *cold)
 {
-   const uint16_t *a_org = a;
-#ifdef NO_UNALIGNED_MEM
-   if (((uintptr_t)a & (sizeof(uint32_t) - 1)) && *a != *b)
-   {
-      a++;
-      b++;
-   }
-   if (*a != *b)
-#endif
-   {
-      /* With this, it's random whether two consecutive identical
-       * words are caught.
-       *
-       * Luckily, compression rate is the same for both cases, and
-       * three is always caught.
-       *
-       * (We prefer to miss two-word blocks, anyways; fewer iterations
-       * of the outer loop, as well as in the decompressor.) */
-      const uint32_t *a_big = (const uint32_t*)a;
-      const uint32_t *b_big = (const uint32_t*)b;
+   cold->head       = cold->data + sizeof(size_t);
+   cold->tail       = cold->data + sizeof(size_t);
+   cold->raw_bytes  = 0;
+   cold->comp_bytes = 0;
+   cold->entries    = 0;
+   cold->shared     = 0;
+}
 
-      while (*a_big != *b_big)
-      {
-         a_big++;
-         b_big++;
-      }
-      a = (const uint16_t*)a_big;
-      b = (const uint16_t*)b_big;
+static void state_manager_cold_drop_tail(struct state_manager_cold *cold)
+{
+   const uint8_t *entry = cold->tail + sizeof(size_t);
 
-      if (a != a_org && a[-1] == b[-1])
-      {
-         a--;
-         b--;
-      }
-   }
-   return a - a_org;
+   cold->comp_bytes    -= read_size_t(entry);
+   cold->raw_bytes     -= read_size_t(entry + sizeof(size_t));
+   cold->tail           = cold->data + read_size_t(cold->tail);
+   cold->entries--;
 }
 
-/* Returns the maximum compressed size of a savestate.
- * It is very likely to compress to far less. */
-static size_t state_manager_raw_maxsize(size_t uncomp)
+/* Unlinks the newest entry and returns its payload. */
+static const uint8_t *state_manager_cold_drop_head(
+      struct state_manager_cold *cold)
 {
-   /* bytes covered by a compressed block */
-   const int maxcblkcover = UINT16_MAX * sizeof(uint16_t);
-   /* uncompressed size, rounded to 16 bits */
-   size_t uncomp16        = (uncomp + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
-   /* number of blocks */
-   size_t maxcblks        = (uncomp + maxcblkcover - 1) / maxcblkcover;
-   return uncomp16 + maxcblks * sizeof(uint16_t) * 2 /* two u16 overhead per block */ + sizeof(uint16_t) *
-      3; /* three u16 to end it */
+   const uint8_t *entry;
+
+   cold->head           = cold->data
+      + read_size_t(cold->head - sizeof(size_t));
+   entry                = cold->head + sizeof(size_t);
+   cold->comp_bytes    -= read_size_t(entry);
+   cold->raw_bytes     -= read_size_t(entry + sizeof(size_t));
+   cold->entries--;
+   return entry;
 }
 
-/*
- * Takes two savestates and creates a patch that turns 'src' into 'dst'.
- *
- * 'patch' must be size 'state_manager_raw_maxsize(len)' or more.
- * Returns the number of bytes actually written to 'patch'.
- */
-static size_t state_manager_raw_compress(const void *src,
-      const void *dst, size_t len, void *patch)
+/* Appends one zstd-compressed patch, evicting the oldest
+ * cold entries as needed. Fails rather than evict entries
+ * that are still shared with the hot ring; that can only
+ * happen with nearly incompressible states. */
+static bool state_manager_cold_append(struct state_manager_cold *cold,
+      const uint8_t *zdata, size_t zlen, size_t rawlen)
 {
-   const uint16_t  *old16 = (const uint16_t*)src;
-   const uint16_t  *new16 = (const uint16_t*)dst;
-   uint16_t *compressed16 = (uint16_t*)patch;
-   size_t          num16s = (len + sizeof(uint16_t) - 1)
-      / sizeof(uint16_t);
+   uint8_t *end;
+   size_t headpos, tailpos, remaining;
 
-   while (num16s)
+   for (;;)
    {
-      size_t i, changed;
-      size_t skip = find_change(old16, new16);
+      headpos   = cold->head - cold->data;
+      tailpos   = cold->tail - cold->data;
+      remaining = (tailpos + cold->capacity -
+            sizeof(size_t) - headpos - 1) % cold->capacity + 1;
 
-      if (skip >= num16s)
+      if (remaining > cold->maxsize)
          break;
+      if (cold->entries <= cold->shared)
+         return false;
+      state_manager_cold_drop_tail(cold);
+   }
 
-      old16  += skip;
-      new16  += skip;
-      num16s -= skip;
+   end               = cold->head + sizeof(size_t);
+   write_size_t(end, zlen);
+   end              += sizeof(size_t);
+   write_size_t(end, rawlen);
+   end              += sizeof(size_t);
+   memcpy(end, zdata, zlen);
+   end              += zlen;
 
-      if (skip > UINT16_MAX)
+   if (end - cold->data + cold->maxsize > cold->capacity)
+   {
+      end            = cold->data;
+      if (cold->tail == cold->data + sizeof(size_t))
       {
-         /* This will make it scan the entire thing again,
-          * but it only hits on 8GB unchanged data anyways,
-          * and if you're doing that, you've got bigger problems. */
-         if (skip > UINT32_MAX)
-            skip         = UINT32_MAX;
-
-         *compressed16++ = 0;
-         *compressed16++ = skip;
-         *compressed16++ = skip >> 16;
-         continue;
+         if (cold->entries <= cold->shared)
+            return false;
+         state_manager_cold_drop_tail(cold);
       }
-
-      changed = find_same(old16, new16);
-      if (changed > UINT16_MAX)
-         changed = UINT16_MAX;
-
-      *compressed16++ = changed;
-      *compressed16++ = skip;
-
-      for (i = 0; i < changed; i++)
-         compressed16[i] = old16[i];
-
-      old16        += changed;
-      new16        += changed;
-      num16s       -= changed;
-      compressed16 += changed;
    }
+   write_size_t(end, cold->head - cold->data);
+   end              += sizeof(size_t);
+   write_size_t(cold->head, end - cold->data);
+   cold->head        = end;
+
+   cold->comp_bytes += zlen;
+   cold->raw_bytes  += rawlen;
+   cold->entries++;
+   return true;
+}
 
-   compressed16[0]  = 0;
-   compressed16[1]  = 0;
-   compressed16[2]  = 0;
+/* Only recompress once the hot ring is half full, so short
+ * rewinds never touch zstd at all. Called with the lock held. */
+static bool state_manager_cold_has_work(const state_manager_t *state)
+{
+   const struct state_manager_cold *cold = state->cold;
 
-   return (uint8_t*)(compressed16 + 3) - (uint8_t*)patch;
+   if (cold->stalled || cold->cursor == state->head)
+      return false;
+   return ring_used(state->data, state->head, state->tail,
+         state->capacity) > state->capacity / 2;
 }
 
-/*
- * Takes 'patch' from a previous call to 'state_manager_raw_compress'
- * and applies it to 'data' ('src' from that call),
- * yielding 'dst' in that call.
- *
- * If the given arguments do not match a previous call to
- * state_manager_raw_compress(), anything at all can happen.
- */
-static void state_manager_raw_decompress(const void *patch, void *data)
+static void state_manager_cold_thread(void *data)
 {
-   uint16_t         *out16 = (uint16_t*)data;
-   const uint16_t *patch16 = (const uint16_t*)patch;
+   state_manager_t *state          = (state_manager_t*)data;
+   struct state_manager_cold *cold = state->cold;
+
+   slock_lock(cold->lock);
 
    for (;;)
    {
-      uint16_t numchanged  = *(patch16++);
-
-      if (numchanged)
-      {
-         uint16_t i;
+      size_t rawlen, zlen;
+      const uint8_t *patch;
 
-         out16       += *patch16++;
+      while (!cold->quit && !state_manager_cold_has_work(state))
+         scond_wait(cold->cond, cold->lock);
 
-         /* We could do memcpy, but it seems that memcpy has a
-          * constant-per-call overhead that actually shows up.
-          *
-          * Our average size in here seems to be 8 or something.
-          * Therefore, we do something with lower overhead. */
-         for (i = 0; i < numchanged; i++)
-            out16[i]  = patch16[i];
+      if (cold->quit)
+         break;
 
-         patch16     += numchanged;
-         out16       += numchanged;
-      }
-      else
+      /* The hot tail never passes the cursor while we are
+       * busy, so the patch stays intact without the lock. */
+      patch      = cold->cursor + sizeof(size_t);
+      cold->busy = true;
+      slock_unlock(cold->lock);
+
+      rawlen     = state_manager_raw_patch_size(patch);
+      zlen       = ZSTD_compressCCtx((ZSTD_CCtx*)cold->cctx,
+            cold->scratch, cold->scratch_size, patch, rawlen,
+            STATE_MANAGER_COLD_LEVEL);
+
+      slock_lock(cold->lock);
+      cold->busy = false;
+      if (     !ZSTD_isError(zlen)
+            && state_manager_cold_append(cold, cold->scratch, zlen, rawlen))
       {
-         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
-
-         if (!numunchanged)
-            break;
-         patch16 += 2;
-         out16   += numunchanged;
+         cold->cursor = state->data + read_size_t(cold->cursor);
+         cold->shared++;
       }
+      else
+         cold->stalled = true;
+      scond_broadcast(cold->cond);
    }
+
+   slock_unlock(cold->lock);
 }
 
-/* The start offsets point to 'nextstart' of any given compressed frame.
- * Each uint16 is stored native endian; anything that claims any other
- * endianness refers to the endianness of this specific item.
- * The uint32 is stored little endian.
- *
- * Each size value is stored native endian if alignment is not enforced;
- * if it is, they're little endian.
- *
- * The start of the buffer contains a size pointing to the end of the
- * buffer; the end points to its start.
- *
- * Wrapping is handled by returning to the start of the buffer if the
- * compressed data could potentially hit the edge;
- *
- * if the compressed data could potentially overwrite the tail pointer,
- * the tail retreats until it can no longer collide.
- *
- * This means that on average, ~2 * maxcompsize is
- * unused at any given moment. */
+static void state_manager_cold_free(struct state_manager_cold *cold)
+{
+   if (cold->thread)
+   {
+      slock_lock(cold->lock);
+      cold->quit = true;
+      scond_broadcast(cold->cond);
+      slock_unlock(cold->lock);
+      sthread_join(cold->thread);
+   }
+   if (cold->cond)
+      scond_free(cold->cond);
+   if (cold->lock)
+      slock_free(cold->lock);
+   if (cold->cctx)
+      ZSTD_freeCCtx((ZSTD_CCtx*)cold->cctx);
+   free(cold->scratch);
+   free(cold->data);
+   free(cold);
+}
 
-/* These are called very few constant times per frame,
- * keep it as simple as possible. */
-static INLINE void write_size_t(void *ptr, size_t val)
+static struct state_manager_cold *state_manager_cold_new(
+      state_manager_t *state, size_t buffer_size)
 {
-   memcpy(ptr, &val, sizeof(val));
+   size_t raw_maxsize              = state_manager_raw_maxsize(state->blocksize);
+   struct state_manager_cold *cold = (struct state_manager_cold*)
+      calloc(1, sizeof(*cold));
+
+   if (!cold)
+      return NULL;
+
+   cold->scratch_size = ZSTD_compressBound(raw_maxsize);
+   /* next/prev offsets, both sizes, and the frame itself */
+   cold->maxsize      = cold->scratch_size + sizeof(size_t) * 4;
+   cold->capacity     = buffer_size;
+   cold->cursor       = state->head;
+
+   if (     cold->capacity < cold->maxsize * 2
+         || !(cold->data    = (uint8_t*)malloc(buffer_size))
+         || !(cold->scratch = (uint8_t*)malloc(cold->scratch_size))
+         || !(cold->cctx    = ZSTD_createCCtx())
+         || !(cold->lock    = slock_new())
+         || !(cold->cond    = scond_new()))
+   {
+      state_manager_cold_free(cold);
+      return NULL;
+   }
+
+   state_manager_cold_reset(cold);
+   state->cold        = cold;
+
+   if (!(cold->thread = sthread_create(state_manager_cold_thread, state)))
+   {
+      state->cold     = NULL;
+      state_manager_cold_free(cold);
+      return NULL;
+   }
+
+   return cold;
 }
+#endif
 
-static INLINE size_t read_size_t(const void *ptr)
+#ifdef HAVE_THREADS
+/* Blocks until the worker has drained every queued block.
+ * Only needed before the main thread touches thisblock or
+ * the ring itself, i.e. when popping. */
+static void state_manager_sync(state_manager_t *state)
 {
-   size_t ret;
+   if (!state->async)
+      return;
 
-   memcpy(&ret, ptr, sizeof(ret));
-   return ret;
+   slock_lock(state->lock);
+   while (state->pending_count || state->busy)
+      scond_wait(state->cond, state->lock);
+   slock_unlock(state->lock);
 }
+#endif
 
 static void state_manager_free(state_manager_t *state)
 {
    if (!state)
       return;
 
-   if (state->data)
-      free(state->data);
-   /* thisblock and nextblock share a single allocation;
-    * after pointer swaps, either could point to the base.
-    * Free whichever has the lower address. */
-   if (state->thisblock || state->nextblock)
+#ifdef HAVE_REWIND_COLD_TIER
+   if (state->cold)
+      state_manager_cold_free(state->cold);
+   state->cold       = NULL;
+#endif
+
+#ifdef HAVE_THREADS
+   if (state->thread)
    {
-      uint8_t *base = state->thisblock;
-      if (state->nextblock && (!base || state->nextblock < base))
-         base = state->nextblock;
-      free(base);
+      slock_lock(state->lock);
+      state->quit = true;
+      scond_broadcast(state->cond);
+      slock_unlock(state->lock);
+      sthread_join(state->thread);
    }
+   if (state->cond)
+      scond_free(state->cond);
+   if (state->lock)
+      slock_free(state->lock);
+   state->thread     = NULL;
+   state->cond       = NULL;
+   state->lock       = NULL;
+#endif
+
+   if (state->data)
+      free(state->data);
+   if (state->keyframes)
+      free(state->keyframes);
+   state->keyframes  = NULL;
+   /* thisblock, nextblock and the staging pool all
+    * live in this single allocation. */
+   if (state->blocks)
+      free(state->blocks);
 #if STRICT_BUF_SIZE
    if (state->debugblock)
       free(state->debugblock);
    state->debugblock = NULL;
 #endif
    state->data       = NULL;
+   state->blocks     = NULL;
    state->thisblock  = NULL;
    state->nextblock  = NULL;
 }
 
+/* Drops the oldest hot entry to make room. With the cold
+ * tier on, its compressed copy normally lives on there. */
+static void state_manager_drop_tail(state_manager_t *state)
+{
+#ifdef HAVE_REWIND_COLD_TIER
+   struct state_manager_cold *cold = state->cold;
+
+   if (cold)
+   {
+      slock_lock(cold->lock);
+      /* Don't pull the entry out from under the worker. */
+      while (cold->busy && cold->cursor == state->tail)
+         scond_wait(cold->cond, cold->lock);
+
+      if (cold->cursor == state->tail)
+      {
+         /* Recompression fell behind. Losing this entry
+          * breaks the patch chain, so the older cold
+          * history has to go as well. */
+         state_manager_cold_reset(cold);
+         state->tail   = state->data + read_size_t(state->tail);
+         cold->cursor  = state->tail;
+      }
+      else
+      {
+         state->tail   = state->data + read_size_t(state->tail);
+         cold->shared--;
+      }
+      cold->stalled    = false;
+      slock_unlock(cold->lock);
+   }
+   else
+#endif
+      state->tail      = state->data + read_size_t(state->tail);
+
+   state->entries--;
+   state->ring_entries--;
+   state_manager_keyframes_drop_old(state);
+}
+
+/* Diffs 'newb' against thisblock and appends the resulting
+ * patch to the ring. Returns false if the ring cannot hold
+ * even a single patch, in which case nothing is written. */
+static bool state_manager_push_patch(state_manager_t *state,
+      const uint8_t *newb)
+{
+   uint8_t *compressed;
+   uint8_t *keyframe = NULL;
+   size_t headpos, tailpos, remaining;
+
+   if (state->capacity < sizeof(size_t) + state->maxcompsize)
+   {
+      RARCH_ERR("[Rewind] %s.\n",
+            msg_hash_to_str(MSG_REWIND_BUFFER_CAPACITY_INSUFFICIENT));
+      return false;
+   }
+
+recheckcapacity:;
+   headpos   = state->head - state->data;
+   tailpos   = state->tail - state->data;
+   remaining = (tailpos + state->capacity -
+         sizeof(size_t) - headpos - 1) % state->capacity + 1;
+
+   if (remaining <= state->maxcompsize)
+   {
+      state_manager_drop_tail(state);
+      goto recheckcapacity;
+   }
+
+   compressed        = state->head + sizeof(size_t);
+
+   compressed       += state_manager_raw_compress(state->thisblock, newb,
+         state->blocksize, compressed);
+
+   if (     state->keyframes
+         && (state->serial + 1) % state->keyframe_interval == 0)
+   {
+      keyframe          = compressed;
+      memcpy(compressed, newb, state->blocksize);
+      compressed       += state->blocksize;
+   }
+
+   if (compressed - state->data + state->maxcompsize > state->capacity)
+   {
+      compressed     = state->data;
+      if (state->tail == state->data + sizeof(size_t))
+         state_manager_drop_tail(state);
+   }
+   write_size_t(compressed, state->head-state->data);
+   compressed       += sizeof(size_t);
+   write_size_t(state->head, compressed-state->data);
+
+   state->serial++;
+   state->ring_entries++;
+
+   if (keyframe)
+   {
+      struct state_manager_keyframe *entry;
+
+      /* Only ever full if the ring holds nothing but
+       * keyframes; the oldest one is stale by then. */
+      if (state->keyframe_count == state->keyframe_capacity)
+      {
+         state->keyframe_first = (state->keyframe_first + 1)
+            % state->keyframe_capacity;
+         state->keyframe_count--;
+      }
+
+      entry             = &state->keyframes[(state->keyframe_first
+            + state->keyframe_count++) % state->keyframe_capacity];
+      entry->serial     = state->serial;
+      entry->offset     = state->head - state->data;
+      entry->data       = keyframe - state->data;
+   }
+
+#ifdef HAVE_REWIND_COLD_TIER
+   if (state->cold)
+   {
+      slock_lock(state->cold->lock);
+      state->head    = compressed;
+      scond_broadcast(state->cold->cond);
+      slock_unlock(state->cold->lock);
+      return true;
+   }
+#endif
+
+   state->head       = compressed;
+   return true;
+}
+
+#ifdef HAVE_THREADS
+static void state_manager_thread(void *data)
+{
+   state_manager_t *state = (state_manager_t*)data;
+
+   slock_lock(state->lock);
+
+   for (;;)
+   {
+      uint8_t *block;
+
+      while (!state->quit && !state->pending_count)
+         scond_wait(state->cond, state->lock);
+
+      if (state->quit)
+         break;
+
+      block                    = state->pending_blocks[0];
+      state->pending_blocks[0] = state->pending_blocks[1];
+      state->pending_count--;
+      state->busy              = true;
+      slock_unlock(state->lock);
+
+      /* The main thread never touches thisblock or the
+       * ring while we are busy, so no lock is needed here. */
+      if (state_manager_push_patch(state, block))
+      {
+         uint8_t *swap         = state->thisblock;
+         state->thisblock      = block;
+         block                 = swap;
+         state->entries++;
+      }
+
+      slock_lock(state->lock);
+      state->free_blocks[state->free_count++] = block;
+      state->busy              = false;
+      scond_broadcast(state->cond);
+   }
+
+   slock_unlock(state->lock);
+}
+#endif
+
 static state_manager_t *state_manager_new(
-      size_t state_size, size_t buffer_size)
+      size_t state_size, size_t buffer_size, bool async, bool compress,
+      unsigned keyframe_interval)
 {
+   unsigned i;
    size_t max_comp_size, block_size, alloc_size, single_block_alloc;
+   size_t hot_size        = buffer_size;
+   unsigned num_blocks    = 2;
    uint8_t *block_buf     = NULL;
    uint8_t *state_data    = NULL;
    state_manager_t *state = (state_manager_t*)calloc(1, sizeof(*state));
@@ -362,46 +614,135 @@ static state_manager_t *state_manager_new(
    if (!state)
       return NULL;
 
+#ifdef HAVE_THREADS
+   /* thisblock plus a double-buffered staging pool */
+   if (async)
+      num_blocks      = 3;
+#else
+   async              = false;
+#endif
+
+   state_manager_raw_init_simd();
+
    block_size         = (state_size + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
    /* the compressed data is surrounded by pointers to the other side */
    max_comp_size      = state_manager_raw_maxsize(state_size) + sizeof(size_t) * 2;
-   state_data         = (uint8_t*)malloc(buffer_size);
+
+   /* Keyframes have to leave room for a good number of
+    * plain patches, otherwise they cost more than they save. */
+   if (     keyframe_interval
+         && buffer_size / 16 < max_comp_size + block_size)
+   {
+      RARCH_WARN("[Rewind] Buffer too small for keyframes.\n");
+      keyframe_interval = 0;
+   }
+   if (keyframe_interval)
+      max_comp_size  += block_size;
+
+#ifdef HAVE_REWIND_COLD_TIER
+   /* Keep a few raw patches around at the very least,
+    * otherwise the split is not worth it. */
+   if (     compress
+         && buffer_size / STATE_MANAGER_HOT_DIVISOR
+            >= sizeof(size_t) + max_comp_size * 4)
+      hot_size        = buffer_size / STATE_MANAGER_HOT_DIVISOR;
+   else
+#endif
+      compress        = false;
+
+   state_data         = (uint8_t*)malloc(hot_size);
 
    if (!state_data)
       goto error;
 
-   /* Combine thisblock and nextblock into a single allocation.
+   /* Combine all blocks into a single allocation.
     * Each block needs: block_size rounded to uint16_t alignment,
-    * plus padding (4 uint16_t + 16 bytes).
-    * We allocate one contiguous buffer and split it in two. */
-   single_block_alloc = block_size + sizeof(uint16_t) * 4 + 16;
-   alloc_size         = single_block_alloc * 2;
+    * plus the padding the delta scan kernels rely on.
+    * We allocate one contiguous buffer and split it up. */
+   single_block_alloc = block_size + STATE_MANAGER_RAW_PADDING;
+   alloc_size         = single_block_alloc * num_blocks;
    block_buf          = (uint8_t*)calloc(alloc_size, 1);
 
    if (!block_buf)
       goto error;
 
    /* Set up sentinel bytes.
-    * thisblock gets uniq=0 (already zero from calloc).
-    * nextblock gets uniq=1. */
-   ((uint16_t*)block_buf)[block_size / sizeof(uint16_t) + 3] = 0;
-   ((uint16_t*)(block_buf + single_block_alloc))[block_size / sizeof(uint16_t) + 3] = 1;
+    * Every block gets a distinct uniq value so that
+    * find_change terminates for any pair of blocks. */
+   for (i = 0; i < num_blocks; i++)
+      ((uint16_t*)(block_buf + single_block_alloc * i))
+         [block_size / sizeof(uint16_t) + 3] = i;
 
    state->blocksize   = block_size;
    state->maxcompsize = max_comp_size;
    state->data        = state_data;
+   state->blocks      = block_buf;
    state->thisblock   = block_buf;
    state->nextblock   = block_buf + single_block_alloc;
-   state->capacity    = buffer_size;
+   state->capacity    = hot_size;
 
    state->head        = state->data + sizeof(size_t);
    state->tail        = state->data + sizeof(size_t);
 
+#ifdef HAVE_REWIND_COLD_TIER
+   if (compress && !state_manager_cold_new(state, buffer_size - hot_size))
+   {
+      /* Fall back to a single raw ring of the full size. */
+      uint8_t *grown  = (uint8_t*)realloc(state->data, buffer_size);
+
+      RARCH_WARN("[Rewind] Could not set up compressed rewind buffer.\n");
+
+      if (grown)
+      {
+         state->data     = grown;
+         state->capacity = buffer_size;
+         state->head     = state->data + sizeof(size_t);
+         state->tail     = state->data + sizeof(size_t);
+      }
+   }
+#endif
+
+   if (keyframe_interval)
+   {
+      /* Every keyframe takes up a full block in the ring. */
+      state->keyframe_capacity = state->capacity / block_size + 1;
+      state->keyframe_interval = keyframe_interval;
+      state->keyframes         = (struct state_manager_keyframe*)malloc(
+            state->keyframe_capacity * sizeof(*state->keyframes));
+
+      if (!state->keyframes)
+      {
+         RARCH_WARN("[Rewind] Could not allocate keyframe index.\n");
+         state->maxcompsize   -= block_size;
+      }
+   }
+
 #if STRICT_BUF_SIZE
    state->debugsize   = state_size;
    state->debugblock  = (uint8_t*)malloc(state_size);
 #endif
 
+#ifdef HAVE_THREADS
+   if (async)
+   {
+      state->free_blocks[0] = state->nextblock;
+      state->free_blocks[1] = block_buf + single_block_alloc * 2;
+      state->free_count     = 2;
+      state->nextblock      = NULL;
+      state->async          = true;
+
+      if (     !(state->lock   = slock_new())
+            || !(state->cond   = scond_new())
+            || !(state->thread = sthread_create(
+                  state_manager_thread, state)))
+      {
+         state_manager_free(state);
+         free(state);
+         return NULL;
+      }
+   }
+#endif
+
    return state;
 
 error:
@@ -414,6 +755,64 @@ error:
    return NULL;
 }
 
+#ifdef HAVE_REWIND_COLD_TIER
+static bool state_manager_pop_tiered(state_manager_t *state)
+{
+   bool ret                        = false;
+   struct state_manager_cold *cold = state->cold;
+
+   slock_lock(cold->lock);
+   while (cold->busy)
+      scond_wait(cold->cond, cold->lock);
+
+   if (state->head != state->tail)
+   {
+      /* If the newest hot entry was already recompressed,
+       * its cold copy is the cold head; drop that too. */
+      bool shared   = (cold->cursor == state->head);
+      size_t start  = read_size_t(state->head - sizeof(size_t));
+
+      if (shared)
+      {
+         state_manager_cold_drop_head(cold);
+         cold->shared--;
+      }
+
+      state->head   = state->data + start;
+      if (shared)
+         cold->cursor = state->head;
+
+      state_manager_raw_decompress(state->data + start + sizeof(size_t),
+            state->thisblock);
+      state->entries--;
+      state->serial--;
+      state->ring_entries--;
+      state_manager_keyframes_drop_new(state);
+      ret           = true;
+   }
+   else if (cold->head != cold->tail)
+   {
+      /* Hot ring is exhausted, continue into the cold one. */
+      const uint8_t *entry = state_manager_cold_drop_head(cold);
+      size_t zlen          = read_size_t(entry);
+      size_t rawlen        = ZSTD_decompress(cold->scratch,
+            cold->scratch_size, entry + sizeof(size_t) * 2, zlen);
+
+      if (!ZSTD_isError(rawlen))
+      {
+         state_manager_raw_decompress(cold->scratch, state->thisblock);
+         ret               = true;
+      }
+      else
+         state_manager_cold_reset(cold);
+   }
+
+   cold->stalled    = false;
+   slock_unlock(cold->lock);
+   return ret;
+}
+#endif
+
 static bool state_manager_pop(state_manager_t *state, const void **data)
 {
    size_t start;
@@ -422,6 +821,10 @@ static bool state_manager_pop(state_manager_t *state, const void **data)
 
    *data                        = NULL;
 
+#ifdef HAVE_THREADS
+   state_manager_sync(state);
+#endif
+
    if (state->thisblock_valid)
    {
       state->thisblock_valid    = false;
@@ -431,6 +834,12 @@ static bool state_manager_pop(state_manager_t *state, const void **data)
    }
 
    *data                        = state->thisblock;
+
+#ifdef HAVE_REWIND_COLD_TIER
+   if (state->cold)
+      return state_manager_pop_tiered(state);
+#endif
+
    if (state->head == state->tail)
       return false;
 
@@ -442,9 +851,123 @@ static bool state_manager_pop(state_manager_t *state, const void **data)
    state_manager_raw_decompress(compressed, out);
 
    state->entries--;
+   state->serial--;
+   state->ring_entries--;
+   state_manager_keyframes_drop_new(state);
    return true;
 }
 
+/* Steps back 'count' entries within the raw ring, starting
+ * from the nearest keyframe at or after the target if there
+ * is one. 'count' must not exceed ring_entries. */
+static void state_manager_seek_ring(state_manager_t *state, unsigned count)
+{
+   size_t start;
+   uint64_t at;
+   uint64_t target = state->serial - count;
+   const struct state_manager_keyframe *keyframe =
+      state_manager_keyframe_find(state, target);
+#ifdef HAVE_REWIND_COLD_TIER
+   struct state_manager_cold *cold = state->cold;
+   bool drop_shared                = false;
+
+   if (cold)
+   {
+      unsigned unshared;
+
+      slock_lock(cold->lock);
+      while (cold->busy)
+         scond_wait(cold->cond, cold->lock);
+
+      /* Cold copies of the entries we skip over have to go too. */
+      unshared = state->ring_entries - cold->shared;
+      if (count > unshared)
+      {
+         unsigned i;
+         for (i = unshared; i < count; i++)
+            state_manager_cold_drop_head(cold);
+         cold->shared -= count - unshared;
+         drop_shared   = true;
+      }
+   }
+#endif
+
+   if (keyframe)
+   {
+      memcpy(state->thisblock, state->data + keyframe->data,
+            state->blocksize);
+      at          = keyframe->serial;
+      start       = keyframe->offset;
+      state->head = state->data + read_size_t(state->data + start);
+   }
+   else
+   {
+      at          = state->serial;
+      start       = read_size_t(state->head - sizeof(size_t));
+   }
+
+   while (at > target)
+   {
+      state_manager_raw_decompress(state->data + start + sizeof(size_t),
+            state->thisblock);
+      state->head = state->data + start;
+      if (--at > target)
+         start    = read_size_t(state->data + start - sizeof(size_t));
+   }
+
+   state->serial        = target;
+   state->ring_entries -= count;
+   state->entries      -= count;
+   state_manager_keyframes_drop_new(state);
+
+#ifdef HAVE_REWIND_COLD_TIER
+   if (cold)
+   {
+      if (drop_shared)
+         cold->cursor = state->head;
+      cold->stalled   = false;
+      slock_unlock(cold->lock);
+   }
+#endif
+}
+
+/* Same as calling state_manager_pop() 'count' times; returns
+ * how many of those would have succeeded. */
+static unsigned state_manager_seek(state_manager_t *state,
+      unsigned count, const void **data)
+{
+   unsigned steps = 0;
+
+#ifdef HAVE_THREADS
+   state_manager_sync(state);
+#endif
+
+   *data          = state->thisblock;
+
+   if (count && state->thisblock_valid)
+   {
+      state->thisblock_valid = false;
+      state->entries--;
+      steps++;
+   }
+
+   if (steps < count && state->ring_entries)
+   {
+      unsigned ring_steps = count - steps;
+      if (ring_steps > state->ring_entries)
+         ring_steps       = state->ring_entries;
+      state_manager_seek_ring(state, ring_steps);
+      steps              += ring_steps;
+   }
+
+   /* Whatever is left lives in the compressed tier,
+    * which has no keyframes. */
+   while (steps < count && state_manager_pop(state, data))
+      steps++;
+
+   return steps;
+}
+
 static void state_manager_push_where(state_manager_t *state, void **data)
 {
    /* We need to ensure we have an uncompressed copy of the last
@@ -461,6 +984,19 @@ static void state_manager_push_where(state_manager_t *state, void **data)
       }
    }
 
+#ifdef HAVE_THREADS
+   /* Grab a staging block; this only waits if the worker
+    * is more than one push behind. */
+   if (state->async && !state->nextblock)
+   {
+      slock_lock(state->lock);
+      while (!state->free_count)
+         scond_wait(state->cond, state->lock);
+      state->nextblock = state->free_blocks[--state->free_count];
+      slock_unlock(state->lock);
+   }
+#endif
+
    *data = state->nextblock;
 #if STRICT_BUF_SIZE
    *data = state->debugblock;
@@ -475,48 +1011,36 @@ static void state_manager_push_do(state_manager_t *state)
    memcpy(state->nextblock, state->debugblock, state->debugsize);
 #endif
 
-   if (state->thisblock_valid)
+#ifdef HAVE_THREADS
+   if (state->async)
    {
-      uint8_t *compressed;
-      const uint8_t *oldb, *newb;
-      size_t headpos, tailpos, remaining;
-      if (state->capacity < sizeof(size_t) + state->maxcompsize)
+      slock_lock(state->lock);
+      if (state->thisblock_valid)
       {
-         RARCH_ERR("[Rewind] %s.\n",
-               msg_hash_to_str(MSG_REWIND_BUFFER_CAPACITY_INSUFFICIENT));
-         return;
+         /* Hand the block over; the worker diffs it and
+          * recycles whichever block it replaces. */
+         state->pending_blocks[state->pending_count++] = state->nextblock;
+         scond_broadcast(state->cond);
       }
-
-recheckcapacity:;
-      headpos   = state->head - state->data;
-      tailpos   = state->tail - state->data;
-      remaining = (tailpos + state->capacity -
-            sizeof(size_t) - headpos - 1) % state->capacity + 1;
-
-      if (remaining <= state->maxcompsize)
+      else
       {
-         state->tail = state->data + read_size_t(state->tail);
-         state->entries--;
-         goto recheckcapacity;
+         /* Nothing to diff against yet (first push, or the
+          * ring was emptied by popping); the worker is idle. */
+         state->free_blocks[state->free_count++] = state->thisblock;
+         state->thisblock       = state->nextblock;
+         state->thisblock_valid = true;
+         state->entries++;
       }
+      state->nextblock = NULL;
+      slock_unlock(state->lock);
+      return;
+   }
+#endif
 
-      oldb              = state->thisblock;
-      newb              = state->nextblock;
-      compressed        = state->head + sizeof(size_t);
-
-      compressed       += state_manager_raw_compress(oldb, newb,
-            state->blocksize, compressed);
-
-      if (compressed - state->data + state->maxcompsize > state->capacity)
-      {
-         compressed     = state->data;
-         if (state->tail == state->data + sizeof(size_t))
-            state->tail = state->data + read_size_t(state->tail);
-      }
-      write_size_t(compressed, state->head-state->data);
-      compressed       += sizeof(size_t);
-      write_size_t(state->head, compressed-state->data);
-      state->head       = compressed;
+   if (state->thisblock_valid)
+   {
+      if (!state_manager_push_patch(state, state->nextblock))
+         return;
    }
    else
       state->thisblock_valid = true;
@@ -528,9 +1052,32 @@ recheckcapacity:;
    state->entries++;
 }
 
+/* Writes a captured state out for offline benchmarking
+ * (see samples/rewind/state_replay_bench). Gives up on
+ * the first failure rather than retrying every frame. */
+static void state_manager_dump_state(
+      struct state_manager_rewind_state *rewind_st, const void *data)
+{
+   char name[32];
+   char path[PATH_MAX_LENGTH];
+
+   snprintf(name, sizeof(name), "%08u.state", rewind_st->dump_count++);
+   fill_pathname_join_special(path, rewind_st->dump_dir, name, sizeof(path));
+
+   if (!filestream_write_file(path, data, rewind_st->size))
+   {
+      RARCH_WARN("[Rewind] Could not dump state to \"%s\", "
+            "disabling state dumps.\n", path);
+      free(rewind_st->dump_dir);
+      rewind_st->dump_dir = NULL;
+   }
+}
+
 void state_manager_event_init(
       struct state_manager_rewind_state *rewind_st,
-      unsigned rewind_buffer_size)
+      unsigned rewind_buffer_size, bool rewind_async,
+      bool rewind_compress, unsigned rewind_keyframe_interval,
+      const char *rewind_dump_dir)
 {
    core_info_t *core_info = NULL;
    void *state            = NULL;
@@ -585,16 +1132,31 @@ void state_manager_event_init(
          (unsigned)(rewind_buffer_size / 1000000));
 
    rewind_st->state = state_manager_new(rewind_st->size,
-         rewind_buffer_size);
+         rewind_buffer_size, rewind_async, rewind_compress,
+         rewind_keyframe_interval);
 
    if (!rewind_st->state)
+   {
       RARCH_WARN("[Rewind] %s.\n",
             msg_hash_to_str(MSG_REWIND_INIT_FAILED));
+      return;
+   }
+
+   if (!string_is_empty(rewind_dump_dir))
+   {
+      RARCH_LOG("[Rewind] Dumping captured states to \"%s\".\n",
+            rewind_dump_dir);
+      rewind_st->dump_dir   = strdup(rewind_dump_dir);
+      rewind_st->dump_count = 0;
+   }
 
    state_manager_push_where(rewind_st->state, &state);
 
    content_serialize_state_rewind(state, rewind_st->size);
 
+   if (rewind_st->dump_dir)
+      state_manager_dump_state(rewind_st, state);
+
    state_manager_push_do(rewind_st->state);
 }
 
@@ -614,12 +1176,29 @@ void state_manager_event_deinit(
 
    if (rewind_st->state)
    {
+#ifdef HAVE_REWIND_COLD_TIER
+      struct state_manager_stats stats;
+      if (     state_manager_get_stats(rewind_st, &stats)
+            && stats.cold_capacity)
+         RARCH_LOG("[Rewind] Compressed buffer: %u entries, "
+               "%u KB -> %u KB (%.2fx).\n",
+               stats.cold_entries,
+               (unsigned)(stats.cold_raw_bytes  / 1024),
+               (unsigned)(stats.cold_comp_bytes / 1024),
+               stats.cold_comp_bytes
+               ? (double)stats.cold_raw_bytes / stats.cold_comp_bytes
+               : 0.0);
+#endif
       state_manager_free(rewind_st->state);
       free(rewind_st->state);
    }
 
-   rewind_st->state  = NULL;
-   rewind_st->size   = 0;
+   if (rewind_st->dump_dir)
+      free(rewind_st->dump_dir);
+
+   rewind_st->state    = NULL;
+   rewind_st->dump_dir = NULL;
+   rewind_st->size     = 0;
    rewind_st->flags &= ~(
                           STATE_MGR_REWIND_ST_FLAG_FRAME_IS_REVERSED
                         | STATE_MGR_REWIND_ST_FLAG_HOTKEY_WAS_CHECKED
@@ -639,6 +1218,75 @@ void state_manager_event_deinit(
    }
 }
 
+bool state_manager_get_stats(struct state_manager_rewind_state *rewind_st,
+      struct state_manager_stats *stats)
+{
+   state_manager_t *state = rewind_st ? rewind_st->state : NULL;
+
+   memset(stats, 0, sizeof(*stats));
+
+   if (!state)
+      return false;
+
+#ifdef HAVE_THREADS
+   state_manager_sync(state);
+#endif
+
+#ifdef HAVE_REWIND_COLD_TIER
+   if (state->cold)
+      slock_lock(state->cold->lock);
+#endif
+
+   stats->hot_used        = ring_used(state->data,
+         state->head, state->tail, state->capacity);
+   stats->hot_capacity    = state->capacity;
+   stats->entries         = state->entries;
+   stats->keyframes       = (unsigned)state->keyframe_count;
+
+#ifdef HAVE_REWIND_COLD_TIER
+   if (state->cold)
+   {
+      struct state_manager_cold *cold = state->cold;
+
+      stats->cold_used       = ring_used(cold->data,
+            cold->head, cold->tail, cold->capacity);
+      stats->cold_capacity   = cold->capacity;
+      stats->cold_raw_bytes  = cold->raw_bytes;
+      stats->cold_comp_bytes = cold->comp_bytes;
+      stats->cold_entries    = cold->entries;
+      /* Shared entries are already counted on the hot side. */
+      stats->entries        += cold->entries - cold->shared;
+      slock_unlock(cold->lock);
+   }
+#endif
+
+   return true;
+}
+
+unsigned state_manager_seek_rewind(
+      struct state_manager_rewind_state *rewind_st, unsigned steps)
+{
+   unsigned ret;
+   const void *buf = NULL;
+#ifdef HAVE_BSV_MOVIE
+   input_driver_state_t *input_st = input_state_get_ptr();
+#endif
+
+   if (!rewind_st || !rewind_st->state || !steps)
+      return 0;
+
+#ifdef HAVE_BSV_MOVIE
+   /* The movie can only follow the rewind buffer frame by frame. */
+   if (BSV_MOVIE_IS_PLAYBACK_ON() || BSV_MOVIE_IS_RECORDING())
+      return 0;
+#endif
+
+   if ((ret = state_manager_seek(rewind_st->state, steps, &buf)))
+      content_deserialize_state(buf, rewind_st->size);
+
+   return ret;
+}
+
 /**
  * check_rewind:
  * @pressed              : was rewind key pressed or held?
@@ -772,6 +1420,9 @@ bool state_manager_check_rewind(
 
          content_serialize_state_rewind(state, rewind_st->size);
 
+         if (rewind_st->dump_dir)
+            state_manager_dump_state(rewind_st, state);
+
          state_manager_push_do(rewind_st->state);
       }
    }
@@ -24,6 +24,14 @@
 #include <boolean.h>
 #include <retro_common_api.h>
 
+#ifdef HAVE_THREADS
+#include <rthreads/rthreads.h>
+#endif
+
+#if defined(HAVE_THREADS) && defined(HAVE_ZSTD)
+#define HAVE_REWIND_COLD_TIER
+#endif
+
 #include "dynamic.h"
 
 RETRO_BEGIN_DECLS
@@ -36,9 +44,78 @@ enum state_manager_rewind_st_flags
    STATE_MGR_REWIND_ST_FLAG_HOTKEY_WAS_PRESSED    = (1 << 3)
 };
 
+#ifdef HAVE_REWIND_COLD_TIER
+/* Second tier of the rewind buffer. Patches that age out of
+ * the hot ring are recompressed with zstd on a worker thread
+ * and appended here, using the same ring layout as the hot
+ * ring. Each entry holds the zstd frame size and the raw patch
+ * size (both size_t), followed by the zstd frame. */
+struct state_manager_cold
+{
+   uint8_t *data;
+   uint8_t *head;
+   uint8_t *tail;
+   /* First hot entry without a cold copy. The hot tail can
+    * advance up to here without losing any history. */
+   uint8_t *cursor;
+   /* zstd output on the worker, zstd input when popping. */
+   uint8_t *scratch;
+   void *cctx;
+
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+
+   size_t capacity;
+   size_t maxsize;
+   size_t scratch_size;
+   /* Raw and compressed size of everything in the ring. */
+   uint64_t raw_bytes;
+   uint64_t comp_bytes;
+
+   unsigned entries;
+   /* Newest cold entries that still have a raw copy in the
+    * hot ring, i.e. the hot entries between tail and cursor. */
+   unsigned shared;
+   /* Set when an append failed; cleared once the hot
+    * ring changes so the worker doesn't spin on it. */
+   bool stalled;
+   bool busy;
+   bool quit;
+};
+#endif
+
+/* A full copy of a state, stored right after the patch of
+ * the entry it belongs to. Seeking only has to replay the
+ * patches between the nearest keyframe and the target. */
+struct state_manager_keyframe
+{
+   /* Serial number of the entry; see state_manager.serial. */
+   uint64_t serial;
+   /* Offsets of the entry and of the state copy in the ring. */
+   size_t offset;
+   size_t data;
+};
+
+struct state_manager_stats
+{
+   size_t hot_used;
+   size_t hot_capacity;
+   size_t cold_used;
+   size_t cold_capacity;
+   uint64_t cold_raw_bytes;
+   uint64_t cold_comp_bytes;
+   unsigned entries;
+   unsigned cold_entries;
+   unsigned keyframes;
+};
+
 struct state_manager
 {
    uint8_t *data;
+   /* Single allocation backing thisblock, nextblock
+    * and (in async mode) the staging pool. */
+   uint8_t *blocks;
    /* Reading and writing is done here here. */
    uint8_t *head;
    /* If head comes close to this, discard a frame. */
@@ -59,8 +136,45 @@ struct state_manager
     * (yes, the math is a bit ugly). */
    size_t maxcompsize;
 
+#ifdef HAVE_THREADS
+   /* Async (pipelined) capture. The main thread only
+    * serializes into a free staging block; the worker
+    * diffs queued blocks against thisblock and appends
+    * the patches to the ring. Everything below, as well
+    * as thisblock/head/tail/entries while the worker is
+    * busy, is protected by 'lock'. */
+   sthread_t *thread;
+   slock_t *lock;
+   scond_t *cond;
+   uint8_t *free_blocks[2];
+   uint8_t *pending_blocks[2];
+   unsigned free_count;
+   unsigned pending_count;
+   bool busy;
+   bool quit;
+#endif
+
+#ifdef HAVE_REWIND_COLD_TIER
+   struct state_manager_cold *cold;
+#endif
+
+   /* Keyframe index, oldest first, as a circular array
+    * sized for as many keyframes as the ring can hold. */
+   struct state_manager_keyframe *keyframes;
+   size_t keyframe_first;
+   size_t keyframe_count;
+   size_t keyframe_capacity;
+   unsigned keyframe_interval;
+
+   /* Serial number of the newest ring entry. Entries are
+    * numbered consecutively, so the tail entry is
+    * serial - ring_entries + 1. */
+   uint64_t serial;
+   unsigned ring_entries;
+
    unsigned entries;
    bool thisblock_valid;
+   bool async;
 };
 
 typedef struct state_manager state_manager_t;
@@ -70,6 +184,10 @@ struct state_manager_rewind_state
    /* Rewind support. */
    state_manager_t *state;
    size_t size;
+   /* Debug aid: if set, every captured state is also
+    * written to this directory as <dump_count>.state. */
+   char *dump_dir;
+   unsigned dump_count;
    uint8_t flags;
 };
 
@@ -80,7 +198,35 @@ void state_manager_event_deinit(
       struct retro_core_t *current_core);
 
 void state_manager_event_init(struct state_manager_rewind_state *rewind_st,
-      unsigned rewind_buffer_size);
+      unsigned rewind_buffer_size, bool rewind_async,
+      bool rewind_compress, unsigned rewind_keyframe_interval,
+      const char *rewind_dump_dir);
+
+/**
+ * state_manager_seek_rewind:
+ * @rewind_st            : rewind state.
+ * @steps                : number of rewind buffer entries to go back.
+ *
+ * Jumps back @steps entries at once and loads the resulting
+ * state into the core. Equivalent to rewinding @steps times,
+ * but only replays patches from the nearest keyframe.
+ * The skipped-over history is discarded.
+ *
+ * Returns: number of entries actually gone back, which is
+ * smaller than @steps if the buffer does not reach that far.
+ **/
+unsigned state_manager_seek_rewind(
+      struct state_manager_rewind_state *rewind_st, unsigned steps);
+
+/**
+ * state_manager_get_stats:
+ * @rewind_st            : rewind state.
+ * @stats                : filled with the current buffer usage.
+ *
+ * Returns: false if the rewind buffer is not initialised.
+ **/
+bool state_manager_get_stats(struct state_manager_rewind_state *rewind_st,
+      struct state_manager_stats *stats);
 
 /**
  * check_rewind:
@@ -0,0 +1,384 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *  Copyright (C) 2014-2017 - Alfred Agrell
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <retro_inline.h>
+#include <compat/intrinsics.h>
+
+#include "state_manager_raw.h"
+
+#ifndef UINT16_MAX
+#define UINT16_MAX 0xffff
+#endif
+
+#ifndef UINT32_MAX
+#define UINT32_MAX 0xffffffffu
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__i486__) || defined(__i686__) || defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#define CPU_X86
+#endif
+
+/* Other arches SIGBUS (usually) on unaligned accesses. */
+#ifndef CPU_X86
+#define NO_UNALIGNED_MEM
+#endif
+
+#if __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* There's no equivalent in libc, you'd think so ...
+ * std::mismatch exists, but it's not optimized at all. */
+static size_t find_change_c(const uint16_t *a, const uint16_t *b)
+{
+   const uint16_t *a_org = a;
+#ifdef NO_UNALIGNED_MEM
+   while (((uintptr_t)a & (sizeof(size_t) - 1)) && *a == *b)
+   {
+      a++;
+      b++;
+   }
+   if (*a == *b)
+#endif
+   {
+      const size_t *a_big = (const size_t*)a;
+      const size_t *b_big = (const size_t*)b;
+
+      while (*a_big == *b_big)
+      {
+         a_big++;
+         b_big++;
+      }
+      a = (const uint16_t*)a_big;
+      b = (const uint16_t*)b_big;
+
+      while (*a == *b)
+      {
+         a++;
+         b++;
+      }
+   }
+   return a - a_org;
+}
+
+static size_t find_same_c(const uint16_t *a, const uint16_t *b)
+{
+   const uint16_t *a_org = a;
+#ifdef NO_UNALIGNED_MEM
+   if (((uintptr_t)a & (sizeof(uint32_t) - 1)) && *a != *b)
+   {
+      a++;
+      b++;
+   }
+   if (*a != *b)
+#endif
+   {
+      /* With this, it's random whether two consecutive identical
+       * words are caught.
+       *
+       * Luckily, compression rate is the same for both cases, and
+       * three is always caught.
+       *
+       * (We prefer to miss two-word blocks, anyways; fewer iterations
+       * of the outer loop, as well as in the decompressor.) */
+      const uint32_t *a_big = (const uint32_t*)a;
+      const uint32_t *b_big = (const uint32_t*)b;
+
+      while (*a_big != *b_big)
+      {
+         a_big++;
+         b_big++;
+      }
+      a = (const uint16_t*)a_big;
+      b = (const uint16_t*)b_big;
+
+      if (a != a_org && a[-1] == b[-1])
+      {
+         a--;
+         b--;
+      }
+   }
+   return a - a_org;
+}
+
+/* 'ret' is the uint16_t offset of the first equal uint32_t;
+ * step back one if the word before it matches as well,
+ * like find_same_c does. */
+static INLINE size_t find_same_finish(const uint16_t *a,
+      const uint16_t *b, size_t ret)
+{
+   if (ret && a[ret - 1] == b[ret - 1])
+      ret--;
+   return ret;
+}
+
+#if __SSE2__
+static size_t find_change_sse2(const uint16_t *a, const uint16_t *b)
+{
+   const __m128i *a128 = (const __m128i*)a;
+   const __m128i *b128 = (const __m128i*)b;
+
+   for (;;)
+   {
+      __m128i v0    = _mm_loadu_si128(a128);
+      __m128i v1    = _mm_loadu_si128(b128);
+      __m128i c     = _mm_cmpeq_epi8(v0, v1);
+      uint32_t mask = _mm_movemask_epi8(c);
+
+      if (mask != 0xffff) /* Something has changed, figure out where. */
+      {
+         /* calculate the real offset to the differing byte */
+         size_t ret = (((uint8_t*)a128 - (uint8_t*)a) |
+               (compat_ctz(~mask)));
+
+         /* and convert that to the uint16_t offset */
+         return (ret >> 1);
+      }
+
+      a128++;
+      b128++;
+   }
+}
+
+static size_t find_same_sse2(const uint16_t *a, const uint16_t *b)
+{
+   const __m128i *a128 = (const __m128i*)a;
+   const __m128i *b128 = (const __m128i*)b;
+
+   for (;;)
+   {
+      __m128i c     = _mm_cmpeq_epi32(
+            _mm_loadu_si128(a128), _mm_loadu_si128(b128));
+      uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(c));
+
+      if (mask)
+         return find_same_finish(a, b,
+               ((const uint16_t*)a128 - a) + compat_ctz(mask) * 2);
+
+      a128++;
+      b128++;
+   }
+}
+#endif
+
+static enum state_manager_raw_impl raw_impl_current =
+#if __SSE2__
+   STATE_MANAGER_RAW_IMPL_SSE2;
+static state_manager_raw_scan_t find_change = find_change_sse2;
+static state_manager_raw_scan_t find_same   = find_same_sse2;
+#else
+   STATE_MANAGER_RAW_IMPL_C;
+static state_manager_raw_scan_t find_change = find_change_c;
+static state_manager_raw_scan_t find_same   = find_same_c;
+#endif
+
+bool state_manager_raw_set_impl(enum state_manager_raw_impl impl)
+{
+   switch (impl)
+   {
+      case STATE_MANAGER_RAW_IMPL_C:
+         find_change = find_change_c;
+         find_same   = find_same_c;
+         break;
+#if __SSE2__
+      case STATE_MANAGER_RAW_IMPL_SSE2:
+         find_change = find_change_sse2;
+         find_same   = find_same_sse2;
+         break;
+#endif
+      default:
+         return false;
+   }
+
+   raw_impl_current = impl;
+   return true;
+}
+
+enum state_manager_raw_impl state_manager_raw_get_impl(void)
+{
+   return raw_impl_current;
+}
+
+const char *state_manager_raw_impl_name(enum state_manager_raw_impl impl)
+{
+   switch (impl)
+   {
+      case STATE_MANAGER_RAW_IMPL_C:
+         return "C";
+      case STATE_MANAGER_RAW_IMPL_SSE2:
+         return "SSE2";
+      default:
+         break;
+   }
+   return "unknown";
+}
+
+void state_manager_raw_set_scan(state_manager_raw_scan_t change,
+      state_manager_raw_scan_t same)
+{
+   find_change = change;
+   find_same   = same;
+}
+
+void state_manager_raw_init_simd(void)
+{
+   /* The scan is bound by memory bandwidth and by the per-run
+    * call cost, so wider kernels measure no faster than SSE2
+    * (see samples/rewind/state_delta_bench). */
+   if (state_manager_raw_set_impl(STATE_MANAGER_RAW_IMPL_SSE2))
+      return;
+   state_manager_raw_set_impl(STATE_MANAGER_RAW_IMPL_C);
+}
+
+size_t state_manager_raw_maxsize(size_t uncomp)
+{
+   /* bytes covered by a compressed block */
+   const int maxcblkcover = UINT16_MAX * sizeof(uint16_t);
+   /* uncompressed size, rounded to 16 bits */
+   size_t uncomp16        = (uncomp + sizeof(uint16_t) - 1) & -sizeof(uint16_t);
+   /* number of blocks */
+   size_t maxcblks        = (uncomp + maxcblkcover - 1) / maxcblkcover;
+   return uncomp16 + maxcblks * sizeof(uint16_t) * 2 /* two u16 overhead per block */ + sizeof(uint16_t) *
+      3; /* three u16 to end it */
+}
+
+size_t state_manager_raw_compress(const void *src,
+      const void *dst, size_t len, void *patch)
+{
+   const uint16_t  *old16 = (const uint16_t*)src;
+   const uint16_t  *new16 = (const uint16_t*)dst;
+   uint16_t *compressed16 = (uint16_t*)patch;
+   size_t          num16s = (len + sizeof(uint16_t) - 1)
+      / sizeof(uint16_t);
+
+   while (num16s)
+   {
+      size_t i, changed;
+      size_t skip = find_change(old16, new16);
+
+      if (skip >= num16s)
+         break;
+
+      old16  += skip;
+      new16  += skip;
+      num16s -= skip;
+
+      if (skip > UINT16_MAX)
+      {
+         /* This will make it scan the entire thing again,
+          * but it only hits on 8GB unchanged data anyways,
+          * and if you're doing that, you've got bigger problems. */
+         if (skip > UINT32_MAX)
+            skip         = UINT32_MAX;
+
+         *compressed16++ = 0;
+         *compressed16++ = skip;
+         *compressed16++ = skip >> 16;
+         continue;
+      }
+
+      changed = find_same(old16, new16);
+      if (changed > UINT16_MAX)
+         changed = UINT16_MAX;
+
+      *compressed16++ = changed;
+      *compressed16++ = skip;
+
+      for (i = 0; i < changed; i++)
+         compressed16[i] = old16[i];
+
+      old16        += changed;
+      new16        += changed;
+      num16s       -= changed;
+      compressed16 += changed;
+   }
+
+   compressed16[0]  = 0;
+   compressed16[1]  = 0;
+   compressed16[2]  = 0;
+
+   return (uint8_t*)(compressed16 + 3) - (uint8_t*)patch;
+}
+
+void state_manager_raw_decompress(const void *patch, void *data)
+{
+   uint16_t         *out16 = (uint16_t*)data;
+   const uint16_t *patch16 = (const uint16_t*)patch;
+
+   for (;;)
+   {
+      uint16_t numchanged  = *(patch16++);
+
+      if (numchanged)
+      {
+         uint16_t i;
+
+         out16       += *patch16++;
+
+         /* We could do memcpy, but it seems that memcpy has a
+          * constant-per-call overhead that actually shows up.
+          *
+          * Our average size in here seems to be 8 or something.
+          * Therefore, we do something with lower overhead. */
+         for (i = 0; i < numchanged; i++)
+            out16[i]  = patch16[i];
+
+         patch16     += numchanged;
+         out16       += numchanged;
+      }
+      else
+      {
+         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
+
+         if (!numunchanged)
+            break;
+         patch16 += 2;
+         out16   += numunchanged;
+      }
+   }
+}
+
+size_t state_manager_raw_patch_size(const void *patch)
+{
+   const uint16_t *patch16 = (const uint16_t*)patch;
+
+   for (;;)
+   {
+      uint16_t numchanged  = *(patch16++);
+
+      if (numchanged)
+         patch16 += 1 + numchanged;
+      else
+      {
+         uint32_t numunchanged = patch16[0] | (patch16[1] << 16);
+
+         patch16 += 2;
+         if (!numunchanged)
+            break;
+      }
+   }
+
+   return (const uint8_t*)patch16 - (const uint8_t*)patch;
+}
@@ -0,0 +1,123 @@
+/*  RetroArch - A frontend for libretro.
+ *  Copyright (C) 2010-2014 - Hans-Kristian Arntzen
+ *  Copyright (C) 2011-2017 - Daniel De Matteis
+ *  Copyright (C) 2014-2017 - Alfred Agrell
+ *
+ *  RetroArch is free software: you can redistribute it and/or modify it under the terms
+ *  of the GNU General Public License as published by the Free Software Found-
+ *  ation, either version 3 of the License, or (at your option) any later version.
+ *
+ *  RetroArch is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+ *  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ *  PURPOSE.  See the GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along with RetroArch.
+ *  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __STATE_MANAGER_RAW_H
+#define __STATE_MANAGER_RAW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boolean.h>
+#include <retro_common_api.h>
+
+RETRO_BEGIN_DECLS
+
+/* Delta codec used by the rewind buffer.
+ *
+ * Both inputs to state_manager_raw_compress() must be
+ * followed by STATE_MANAGER_RAW_PADDING bytes laid out as:
+ *   - three zero uint16_t (terminates the 'same' scan),
+ *   - one uint16_t that differs between the two blocks
+ *     (terminates the 'change' scan),
+ *   - slack for the widest vector kernel to overread. */
+#define STATE_MANAGER_RAW_PADDING (sizeof(uint16_t) * 4 + 64)
+
+enum state_manager_raw_impl
+{
+   STATE_MANAGER_RAW_IMPL_C = 0,
+   STATE_MANAGER_RAW_IMPL_SSE2,
+   STATE_MANAGER_RAW_IMPL_LAST
+};
+
+/**
+ * state_manager_raw_init_simd:
+ *
+ * Selects the fastest scan kernels supported by both
+ * the build and the host CPU (see cpu_features_get()).
+ * On x86 that is SSE2.
+ * Safe to call more than once.
+ **/
+void state_manager_raw_init_simd(void);
+
+/**
+ * state_manager_raw_set_impl:
+ * @impl                 : kernel set to use.
+ *
+ * Forces a specific kernel set. Mostly useful for
+ * benchmarking and testing.
+ *
+ * Returns: false if @impl was not compiled in or is
+ * not supported by the host CPU, in which case the
+ * current selection is left untouched.
+ **/
+bool state_manager_raw_set_impl(enum state_manager_raw_impl impl);
+
+enum state_manager_raw_impl state_manager_raw_get_impl(void);
+
+const char *state_manager_raw_impl_name(enum state_manager_raw_impl impl);
+
+/* Each scan walks until it finds a matching/differing
+ * uint16_t; termination is guaranteed by the sentinels in
+ * the block padding. Every kernel must return exactly what
+ * the C version returns, so that patches are identical no
+ * matter which one ran. */
+typedef size_t (*state_manager_raw_scan_t)(const uint16_t *a,
+      const uint16_t *b);
+
+/**
+ * state_manager_raw_set_scan:
+ * @find_change          : returns the offset of the first differing uint16_t.
+ * @find_same            : returns the offset of the first run of equal ones.
+ *
+ * Plugs in scan kernels from outside, so that benchmarks can
+ * try candidates without building them into the codec. The
+ * caller checks that the host CPU runs them;
+ * state_manager_raw_set_impl() goes back to a built-in set.
+ **/
+void state_manager_raw_set_scan(state_manager_raw_scan_t find_change,
+      state_manager_raw_scan_t find_same);
+
+/* Returns the maximum compressed size of a savestate.
+ * It is very likely to compress to far less. */
+size_t state_manager_raw_maxsize(size_t uncomp);
+
+/*
+ * Takes two savestates and creates a patch that turns 'dst' into 'src'.
+ *
+ * 'patch' must be size 'state_manager_raw_maxsize(len)' or more.
+ * Returns the number of bytes actually written to 'patch'.
+ */
+size_t state_manager_raw_compress(const void *src,
+      const void *dst, size_t len, void *patch);
+
+/*
+ * Takes 'patch' from a previous call to 'state_manager_raw_compress'
+ * and applies it to 'data' ('dst' from that call),
+ * yielding 'src' in that call.
+ *
+ * If the given arguments do not match a previous call to
+ * state_manager_raw_compress(), anything at all can happen.
+ */
+void state_manager_raw_decompress(const void *patch, void *data);
+
+/* Returns the size in bytes of a patch produced by
+ * state_manager_raw_compress(), terminator included. */
+size_t state_manager_raw_patch_size(const void *patch);
+
+RETRO_END_DECLS
+
+#endif
@@ -25,6 +25,10 @@
 #include <file/file_path.h>
 #include <streams/file_stream.h>
 #include <retro_endianness.h>
+#include <features/features_cpu.h>
+#if defined(HAVE_STATESTREAM) && defined(HAVE_THREADS)
+#include <rthreads/tpool.h>
+#endif
 
 #ifdef _WIN32
 #include <direct.h>
@@ -49,18 +53,6 @@
 #if DEBUG
 #include "input/bsv/uint32s_index.h"
 #endif
-
-#define REPLAY_DEFAULT_COMMIT_INTERVAL 4
-#define REPLAY_DEFAULT_COMMIT_THRESHOLD 2
-
-/* Superblock and block sizes for incremental savestates. */
-#define DEFAULT_SUPERBLOCK_SIZE 16  /* measured in blocks */
-#define DEFAULT_BLOCK_SIZE      16384 /* measured in bytes  */
-
-#define SMALL_STATE_THRESHOLD (1<<20) /* states < 1MB are "small" and are tuned differently */
-#define SMALL_SUPERBLOCK_SIZE 16  /* measured in blocks */
-#define SMALL_BLOCK_SIZE      128 /* measured in bytes  */
-
 #endif
 
 /* Forward declaration */
@@ -152,6 +144,10 @@ static bool bsv_movie_init_record(
 #else
       {}
 #endif
+#ifdef HAVE_ZSTD
+   if (settings->bools.replay_checkpoint_dictionary)
+      handle->checkpoint_compression = REPLAY_CHECKPOINT2_COMPRESSION_ZSTD_DICT;
+#endif
 
    content_crc              = content_get_crc();
 
@@ -177,7 +173,8 @@ static bool bsv_movie_init_record(
 #else
    header[REPLAY_HEADER_BLOCK_SIZE_INDEX]      = 0;
    header[REPLAY_HEADER_SUPERBLOCK_SIZE_INDEX] = 0;
-   header[REPLAY_HEADER_CHECKPOINT_CONFIG_INDEX] = 0;
+   header[REPLAY_HEADER_CHECKPOINT_CONFIG_INDEX] =
+      ((uint32_t)handle->checkpoint_compression) << 8;
 #endif
    handle->identifier       = (int64_t)t;
    *((int64_t *)(header+REPLAY_HEADER_IDENTIFIER_INDEX)) = time_lil;
@@ -186,6 +183,15 @@ static bool bsv_movie_init_record(
 #ifdef HAVE_STATESTREAM
    handle->superblocks      = uint32s_index_new(superblock_size, handle->commit_interval, handle->commit_threshold);
    handle->blocks           = uint32s_index_new(block_size/4, handle->commit_interval, handle->commit_threshold);
+#ifdef HAVE_THREADS
+   if (info_size >= PARALLEL_HASH_THRESHOLD)
+   {
+      unsigned threads = MIN(cpu_features_get_core_amount(),
+            PARALLEL_HASH_MAX_THREADS);
+      if (threads > 1)
+         handle->hash_pool = tpool_create(threads);
+   }
+#endif
 #endif
    if (state_size)
       return bsv_movie_reset_recording(handle);
@@ -197,6 +203,13 @@ static bool bsv_movie_init_record(
 
 void bsv_movie_free(bsv_movie_t *handle)
 {
+   if (handle->file && handle->index_path)
+      bsv_movie_index_save(handle, handle->index_path);
+   bsv_movie_index_free(handle);
+#ifdef HAVE_ZSTD
+   bsv_movie_dict_free(handle);
+#endif
+
    intfstream_close(handle->file);
    free(handle->file);
 
@@ -206,6 +219,10 @@ void bsv_movie_free(bsv_movie_t *handle)
    uint32s_index_free(handle->superblocks);
    uint32s_index_free(handle->blocks);
    free(handle->superblock_seq);
+#ifdef HAVE_THREADS
+   if (handle->hash_pool)
+      tpool_destroy(handle->hash_pool);
+#endif
 #endif
    if (handle->last_save)
       free(handle->last_save);
@@ -217,6 +234,7 @@ void bsv_movie_free(bsv_movie_t *handle)
 
 static bsv_movie_t *bsv_movie_init_internal(const char *path, enum rarch_movie_type type)
 {
+   size_t _len;
    size_t *frame_pos   = NULL;
    bsv_movie_t *handle = (bsv_movie_t*)calloc(1, sizeof(*handle));
 
@@ -241,6 +259,18 @@ static bsv_movie_t *bsv_movie_init_internal(const char *path, enum rarch_movie_t
 
    handle->frame_pos[0]    = handle->min_file_pos;
 
+   /* Playback can start from the index of an earlier session;
+    * otherwise it is built as the replay is recorded or seeked. */
+   _len = strlen(path) + sizeof(REPLAY_INDEX_EXTENSION);
+   if ((handle->index_path = (char*)malloc(_len)))
+   {
+      strlcpy(handle->index_path, path, _len);
+      strlcat(handle->index_path, REPLAY_INDEX_EXTENSION, _len);
+   }
+   bsv_movie_index_clear(handle);
+   if (type == RARCH_MOVIE_PLAYBACK && handle->index_path)
+      bsv_movie_index_load(handle, handle->index_path);
+
    return handle;
 
 error: